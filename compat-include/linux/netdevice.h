@@ -81,4 +81,11 @@ static inline void batadv_netif_trans_update(struct net_device *dev)
 
 #endif /* < KERNEL_VERSION(4, 11, 9) */
 
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 9, 0)
+
+/* GRO handlers are called without recursion limit before 4.9 */
+#define call_gro_receive(cb, head, skb) cb(head, skb)
+
+#endif /* < KERNEL_VERSION(4, 9, 0) */
+
 #endif	/* _NET_BATMAN_ADV_COMPAT_LINUX_NETDEVICE_H_ */
@@ -40,6 +40,12 @@
 /* wild hack for batadv_getlink_net only */
 #define get_link_net get_xstats_size || 1 ? fallback_net : (struct net*)netdev->rtnl_link_ops->get_xstats_size
 
+/* eth_gro_receive() and eth_gro_complete() are not exported: batman-adv
+ * packets are passed on without being merged by GRO
+ */
+#define eth_gro_receive(head, skb) (NAPI_GRO_CB(skb)->flush = 1, NULL)
+#define eth_gro_complete(skb, nhoff) (-EINVAL)
+
 #endif /* < KERNEL_VERSION(4, 0, 0) */
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(4, 3, 0)
@@ -45,6 +45,9 @@ gen_config() {
 		echo "#define __enabled_${KEY} 0"
 		echo "#define __enabled_${KEY}_MODULE 0"
 		;;
+	[0-9]*)
+		echo "#define ${KEY} ${VALUE}"
+		;;
 	*)
 		echo "#define ${KEY} \"${VALUE}\""
 		;;
@@ -59,6 +62,10 @@ gen_config 'CONFIG_BATMAN_ADV_DAT' ${CONFIG_BATMAN_ADV_DAT:="y"} >> "${TMP}"
 gen_config 'CONFIG_BATMAN_ADV_MCAST' ${CONFIG_BATMAN_ADV_MCAST:="y"} >> "${TMP}"
 gen_config 'CONFIG_BATMAN_ADV_NC' ${CONFIG_BATMAN_ADV_NC:="n"} >> "${TMP}"
 gen_config 'CONFIG_BATMAN_ADV_BATMAN_V' ${CONFIG_BATMAN_ADV_BATMAN_V:="y"} >> "${TMP}"
+gen_config 'CONFIG_BATMAN_ADV_TRACING' ${CONFIG_BATMAN_ADV_TRACING:="n"} >> "${TMP}"
+gen_config 'CONFIG_BATMAN_ADV_INJECT' ${CONFIG_BATMAN_ADV_INJECT:="n"} >> "${TMP}"
+gen_config 'CONFIG_BATMAN_ADV_TT_COMPACT' ${CONFIG_BATMAN_ADV_TT_COMPACT:="n"} >> "${TMP}"
+gen_config 'CONFIG_BATMAN_ADV_BCAST_WINDOW_SHIFT' ${CONFIG_BATMAN_ADV_BCAST_WINDOW_SHIFT:="6"} >> "${TMP}"
 
 # only regenerate compat-autoconf.h when config was changed
 diff "${TMP}" "${TARGET}" > /dev/null 2>&1 || cp "${TMP}" "${TARGET}"
@@ -38,6 +38,9 @@
  * @BATADV_CODED: network coded packets
  * @BATADV_ELP: echo location packets for B.A.T.M.A.N. V
  * @BATADV_OGM2: originator messages for B.A.T.M.A.N. V
+ * @BATADV_UNICAST_AGG: several unicast packets for the same next hop carried
+ *     in one frame
+ * @BATADV_CODED_MULTI: network coded packets combining more than two packets
  *
  * @BATADV_UNICAST: unicast packets carrying unicast payload traffic
  * @BATADV_UNICAST_FRAG: unicast packets carrying a fragment of the original
@@ -54,6 +57,8 @@ enum batadv_packettype {
 	BATADV_CODED            = 0x02,
 	BATADV_ELP		= 0x03,
 	BATADV_OGM2		= 0x04,
+	BATADV_UNICAST_AGG	= 0x05,
+	BATADV_CODED_MULTI	= 0x06,
 	/* 0x40 - 0x7f: unicast */
 #define BATADV_UNICAST_MIN     0x40
 	BATADV_UNICAST          = 0x40,
@@ -127,6 +132,15 @@ enum batadv_mcast_flags {
 	BATADV_MCAST_WANT_ALL_IPV6		= 1UL << 2,
 };
 
+/**
+ * enum batadv_dat_flags - flags announced in the distributed arp table tvlv
+ * @BATADV_DAT_FLAG_ND: IPv6 neighbor discovery messages are cached and
+ *  answered in addition to ARP
+ */
+enum batadv_dat_flags {
+	BATADV_DAT_FLAG_ND	= 1UL << 0,
+};
+
 /* tt data subtypes */
 #define BATADV_TT_DATA_TYPE_MASK 0x0F
 
@@ -136,12 +150,23 @@ enum batadv_mcast_flags {
  * @BATADV_TT_REQUEST: TT request message
  * @BATADV_TT_RESPONSE: TT response message
  * @BATADV_TT_FULL_TABLE: contains full table to replace existing table
+ * @BATADV_TT_CHUNKED: the vlan data is followed by a batadv_tvlv_tt_chunk.
+ *  Set in requests of nodes which accept full tables split in chunks
  */
 enum batadv_tt_data_flags {
 	BATADV_TT_OGM_DIFF   = 1UL << 0,
 	BATADV_TT_REQUEST    = 1UL << 1,
 	BATADV_TT_RESPONSE   = 1UL << 2,
 	BATADV_TT_FULL_TABLE = 1UL << 4,
+	BATADV_TT_CHUNKED    = 1UL << 5,
+};
+
+/**
+ * enum batadv_tt_chunk_flags - flags for tt full table chunks
+ * @BATADV_TT_CHUNK_LAST: last chunk of the full table
+ */
+enum batadv_tt_chunk_flags {
+	BATADV_TT_CHUNK_LAST = 1UL << 0,
 };
 
 /**
@@ -159,6 +184,7 @@ enum batadv_vlan_flags {
  * @BATADV_CLAIM_TYPE_ANNOUNCE: announcement of backbone with current crc
  * @BATADV_CLAIM_TYPE_REQUEST: request of full claim table
  * @BATADV_CLAIM_TYPE_LOOPDETECT: mesh-traversing loop detect packet
+ * @BATADV_CLAIM_TYPE_CLAIM_LIST: claims of several client mac addresses
  */
 enum batadv_bla_claimframe {
 	BATADV_CLAIM_TYPE_CLAIM		= 0x00,
@@ -166,8 +192,15 @@ enum batadv_bla_claimframe {
 	BATADV_CLAIM_TYPE_ANNOUNCE	= 0x02,
 	BATADV_CLAIM_TYPE_REQUEST	= 0x03,
 	BATADV_CLAIM_TYPE_LOOPDETECT	= 0x04,
+	BATADV_CLAIM_TYPE_CLAIM_LIST	= 0x05,
 };
 
+/* marks the data appended to the ARP header of a claim frame */
+#define BATADV_BLA_EXT_MAGIC 0x4305
+
+/* number of buckets the claim crc of a backbone gw is split into */
+#define BATADV_BLA_CRC_BUCKETS 16
+
 /**
  * enum batadv_tvlv_type - tvlv type definitions
  * @BATADV_TVLV_GW: gateway tvlv
@@ -176,6 +209,8 @@ enum batadv_bla_claimframe {
  * @BATADV_TVLV_TT: translation table tvlv
  * @BATADV_TVLV_ROAM: roaming advertisement tvlv
  * @BATADV_TVLV_MCAST: multicast capability tvlv
+ * @BATADV_TVLV_UNICAST_AGG: unicast aggregation capability tvlv
+ * @BATADV_TVLV_PATH_MTU: path MTU tvlv
  */
 enum batadv_tvlv_type {
 	BATADV_TVLV_GW		= 0x01,
@@ -184,6 +219,8 @@ enum batadv_tvlv_type {
 	BATADV_TVLV_TT		= 0x04,
 	BATADV_TVLV_ROAM	= 0x05,
 	BATADV_TVLV_MCAST	= 0x06,
+	BATADV_TVLV_UNICAST_AGG	= 0x07,
+	BATADV_TVLV_PATH_MTU	= 0x08,
 };
 
 #pragma pack(2)
@@ -196,6 +233,41 @@ struct batadv_bla_claim_dst {
 	__be16 group;		/* group id */
 };
 
+/**
+ * struct batadv_bla_announce_ext - crcs appended to an ANNOUNCE frame
+ * @magic: BATADV_BLA_EXT_MAGIC
+ * @crc: crc16 checksums over the claims of each bucket
+ *
+ * The crc of the backbone gw is the XOR of all bucket crcs. A claim belongs to
+ * the bucket selected by the upper bits of the crc16 of its mac address.
+ */
+struct batadv_bla_announce_ext {
+	__be16 magic;
+	__be16 crc[BATADV_BLA_CRC_BUCKETS];
+};
+
+/**
+ * struct batadv_bla_request_ext - bucket selection appended to a REQUEST frame
+ * @magic: BATADV_BLA_EXT_MAGIC
+ * @buckets: bitmap of the claim buckets which have to be repeated
+ *
+ * The requested claims are repeated using CLAIM_LIST frames.
+ */
+struct batadv_bla_request_ext {
+	__be16 magic;
+	__be16 buckets;
+};
+
+/**
+ * struct batadv_bla_claim_list - header appended to a CLAIM_LIST frame
+ * @magic: BATADV_BLA_EXT_MAGIC
+ * @num_claims: number of claimed client mac addresses following this header
+ */
+struct batadv_bla_claim_list {
+	__be16 magic;
+	__be16 num_claims;
+};
+
 /**
  * struct batadv_ogm_packet - ogm (routing protocol) packet
  * @packet_type: batman-adv packet type, part of the general header
@@ -332,6 +404,9 @@ struct batadv_icmp_packet {
  *  TP_MSG and echoed back in the next TP_ACK so that the sender can compute the
  *  RTT. Since it is read only by the host which wrote it, there is no need to
  *  store it using network order
+ *
+ * A TP_ACK can be followed by a list of &struct batadv_icmp_tp_sack in
+ * ascending order which describe data received after a gap.
  */
 struct batadv_icmp_tp_packet {
 	__u8   packet_type;
@@ -347,6 +422,16 @@ struct batadv_icmp_tp_packet {
 	__be32 timestamp;
 };
 
+/**
+ * struct batadv_icmp_tp_sack - TP Meter selective acknowledgment block
+ * @start: sequence number of the first byte received after a gap
+ * @end: sequence number following the last byte of the block
+ */
+struct batadv_icmp_tp_sack {
+	__be32 start;
+	__be32 end;
+};
+
 /**
  * enum batadv_icmp_tp_subtype - ICMP TP Meter packet subtypes
  * @BATADV_TP_MSG: Msg from sender to receiver
@@ -468,6 +553,26 @@ struct batadv_frag_packet {
 	__be16 total_size;
 };
 
+/**
+ * struct batadv_unicast_agg_packet - aggregate of unicast packets which are
+ *  sent to the same neighbor
+ * @packet_type: batman-adv packet type, part of the general header
+ * @version: batman-adv protocol version, part of the genereal header
+ * @num_packets: number of packets carried in this aggregate
+ * @reserved: reserved byte for alignment
+ *
+ * The header is followed by @num_packets entries, each made of the length of
+ * the carried batman-adv packet (__be16) and the packet itself. The aggregate
+ * is only valid for a single hop - the receiver handles every carried packet
+ * as if it had been received on its own.
+ */
+struct batadv_unicast_agg_packet {
+	__u8   packet_type;
+	__u8   version;  /* batman version field */
+	__u8   num_packets;
+	__u8   reserved;
+};
+
 /**
  * struct batadv_bcast_packet - broadcast packet for network payload
  * @packet_type: batman-adv packet type, part of the general header
@@ -524,6 +629,46 @@ struct batadv_coded_packet {
 	__be16 coded_len;
 };
 
+/**
+ * struct batadv_coded_multi_entry - description of one packet included in a
+ *  multi coded packet
+ * @dest: receiver of this packet (next hop of the coding relay)
+ * @source: sender of this packet to the coding relay
+ * @orig_dest: original destination of this packet
+ * @crc: checksum of this packet
+ * @ttl: ttl of this packet
+ * @ttvn: tt version number of this packet
+ * @len: length of the payload of this packet
+ */
+struct batadv_coded_multi_entry {
+	__u8   dest[ETH_ALEN];
+	__u8   source[ETH_ALEN];
+	__u8   orig_dest[ETH_ALEN];
+	__be32 crc;
+	__u8   ttl;
+	__u8   ttvn;
+	__be16 len;
+};
+
+/**
+ * struct batadv_coded_multi_packet - network coded packet combining more than
+ *  two packets
+ * @packet_type: batman-adv packet type, part of the general header
+ * @version: batman-adv protocol version, part of the genereal header
+ * @num_packets: number of packets coded into this packet
+ * @reserved: reserved byte for alignment
+ *
+ * The header is followed by @num_packets entries of struct
+ * batadv_coded_multi_entry and the XOR of the payloads of all included
+ * packets. Every receiver needs all but its own packet to decode it.
+ */
+struct batadv_coded_multi_packet {
+	__u8   packet_type;
+	__u8   version;  /* batman version field */
+	__u8   num_packets;
+	__u8   reserved;
+};
+
 /**
  * struct batadv_unicast_tvlv_packet - generic unicast packet with tvlv payload
  * @packet_type: batman-adv packet type, part of the general header
@@ -595,6 +740,19 @@ struct batadv_tvlv_tt_vlan_data {
 	__u16  reserved;
 };
 
+/**
+ * struct batadv_tvlv_tt_chunk - position of a chunk of a full table transfer
+ * @offset: number of table entries sent before this chunk. In requests the
+ *  number of entries the requester already received
+ * @flags: chunk flags (see batadv_tt_chunk_flags)
+ * @reserved: unused, useful for alignment purposes
+ */
+struct batadv_tvlv_tt_chunk {
+	__be32 offset;
+	__u8   flags;
+	__u8   reserved[3];
+};
+
 /**
  * struct batadv_tvlv_tt_change - translation table diff data
  * @flags: status indicators concerning the non-mesh client (see
@@ -630,6 +788,29 @@ struct batadv_tvlv_mcast_data {
 	__u8 reserved[3];
 };
 
+/**
+ * struct batadv_tvlv_dat_data - payload of a distributed arp table tvlv
+ * @flags: DAT flags announced by the orig node (see &enum batadv_dat_flags)
+ * @reserved: reserved field
+ *
+ * Nodes only announcing an empty DAT tvlv support ARP only.
+ */
+struct batadv_tvlv_dat_data {
+	__u8 flags;
+	__u8 reserved[3];
+};
+
+/**
+ * struct batadv_tvlv_path_mtu - payload of a path MTU tvlv
+ * @mtu: smallest MTU of the mesh interfaces the OGM passed so far, lowered by
+ *  every node receiving the OGM before it is processed and forwarded
+ * @reserved: reserved field
+ */
+struct batadv_tvlv_path_mtu {
+	__be16 mtu;
+	__be16 reserved;
+};
+
 #pragma pack()
 
 #endif /* _UAPI_LINUX_BATADV_PACKET_H_ */
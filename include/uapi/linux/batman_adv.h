@@ -25,9 +25,12 @@
 #ifndef _UAPI_LINUX_BATMAN_ADV_H_
 #define _UAPI_LINUX_BATMAN_ADV_H_
 
+#include <linux/types.h>
+
 #define BATADV_NL_NAME "batadv"
 
 #define BATADV_NL_MCAST_GROUP_TPMETER	"tpmeter"
+#define BATADV_NL_MCAST_GROUP_EVENTS	"events"
 
 /**
  * enum batadv_tt_client_flags - TT client specific flags
@@ -344,6 +347,210 @@ enum batadv_nl_attrs {
 	 */
 	BATADV_ATTR_MCAST_FLAGS_PRIV,
 
+	/**
+	 * @BATADV_ATTR_TPMETER_STREAMS: number of parallel tp meter streams
+	 *  towards the same destination (1 to 4)
+	 */
+	BATADV_ATTR_TPMETER_STREAMS,
+
+	/**
+	 * @BATADV_ATTR_TPMETER_PACKET_LEN: length of the client frames
+	 *  simulated by the tp meter, including the ethernet header
+	 */
+	BATADV_ATTR_TPMETER_PACKET_LEN,
+
+	/**
+	 * @BATADV_ATTR_TPMETER_LATENCY: flag to run a latency test which keeps
+	 *  a single message per stream in flight
+	 */
+	BATADV_ATTR_TPMETER_LATENCY,
+
+	/**
+	 * @BATADV_ATTR_TPMETER_RTT_MIN: smallest RTT (msec) of the run
+	 */
+	BATADV_ATTR_TPMETER_RTT_MIN,
+
+	/**
+	 * @BATADV_ATTR_TPMETER_RTT_AVG: average RTT (msec) of the run
+	 */
+	BATADV_ATTR_TPMETER_RTT_AVG,
+
+	/**
+	 * @BATADV_ATTR_TPMETER_RTT_P99: 99th percentile of the RTT (msec) of
+	 *  the run
+	 */
+	BATADV_ATTR_TPMETER_RTT_P99,
+
+	/**
+	 * @BATADV_ATTR_TPMETER_JITTER: mean deviation (msec) of consecutive
+	 *  RTT samples of the run
+	 */
+	BATADV_ATTR_TPMETER_JITTER,
+
+	/**
+	 * @BATADV_ATTR_TPMETER_REORDERED: number of ACKs of the run which were
+	 *  overtaken by a newer ACK
+	 */
+	BATADV_ATTR_TPMETER_REORDERED,
+
+	/**
+	 * @BATADV_ATTR_STATS_NAME: name of a statistics counter
+	 */
+	BATADV_ATTR_STATS_NAME,
+
+	/**
+	 * @BATADV_ATTR_STATS_VALUE: value of a statistics counter
+	 */
+	BATADV_ATTR_STATS_VALUE,
+
+	/**
+	 * @BATADV_ATTR_TT_GENERATION: generation of the global translation
+	 *  table. Requests only dump the changes since this generation, replies
+	 *  carry the generation to use for the next request
+	 */
+	BATADV_ATTR_TT_GENERATION,
+
+	/**
+	 * @BATADV_ATTR_TT_DELETED: flag indicating that the client was removed
+	 *  from the global translation table
+	 */
+	BATADV_ATTR_TT_DELETED,
+
+	/**
+	 * @BATADV_ATTR_EVENT: type of a mesh state change (see
+	 *  &enum batadv_nl_event)
+	 */
+	BATADV_ATTR_EVENT,
+
+	/**
+	 * @BATADV_ATTR_DAT_CACHE_IP6ADDRESS: IPv6 address of a DAT cache entry,
+	 *  used instead of @BATADV_ATTR_DAT_CACHE_IP4ADDRESS for entries
+	 *  learned via neighbor discovery
+	 */
+	BATADV_ATTR_DAT_CACHE_IP6ADDRESS,
+
+	/**
+	 * @BATADV_ATTR_INJECT_FRAME: ethernet frame carrying a batman-adv
+	 *  packet, may be given multiple times
+	 */
+	BATADV_ATTR_INJECT_FRAME,
+
+	/**
+	 * @BATADV_ATTR_INJECT_COUNT: number of times the injected frames are
+	 *  received
+	 */
+	BATADV_ATTR_INJECT_COUNT,
+
+	/**
+	 * @BATADV_ATTR_TT_CHANGE: translation table client in the format of
+	 *  &struct batadv_tvlv_tt_change, may be given multiple times
+	 */
+	BATADV_ATTR_TT_CHANGE,
+
+	/**
+	 * @BATADV_ATTR_PATH_MTU: smallest MTU of the mesh interfaces on the
+	 *  path towards an originator
+	 */
+	BATADV_ATTR_PATH_MTU,
+
+	/**
+	 * @BATADV_ATTR_PING_TIMEOUT: time in milliseconds to wait for the
+	 *  replies of a ping batch
+	 */
+	BATADV_ATTR_PING_TIMEOUT,
+
+	/**
+	 * @BATADV_ATTR_PING_TTL: TTL of an echo request of a ping batch
+	 */
+	BATADV_ATTR_PING_TTL,
+
+	/**
+	 * @BATADV_ATTR_PING_TRACEROUTE: flag indicating that one echo request
+	 *  per TTL up to BATADV_ATTR_PING_TTL is sent to each originator
+	 */
+	BATADV_ATTR_PING_TRACEROUTE,
+
+	/**
+	 * @BATADV_ATTR_PING_STATUS: result of an echo request, see
+	 *  &enum batadv_ping_status
+	 */
+	BATADV_ATTR_PING_STATUS,
+
+	/**
+	 * @BATADV_ATTR_PING_RTT: round trip time of an echo request in
+	 *  microseconds
+	 */
+	BATADV_ATTR_PING_RTT,
+
+	/**
+	 * @BATADV_ATTR_PING_RESPONDER: address of the originator which answered
+	 *  an echo request
+	 */
+	BATADV_ATTR_PING_RESPONDER,
+
+	/**
+	 * @BATADV_ATTR_OFFLOAD_STABLE: time in milliseconds the route towards
+	 *  a client must not have changed before it is offered for offloading
+	 */
+	BATADV_ATTR_OFFLOAD_STABLE,
+
+	/**
+	 * @BATADV_ATTR_NEIGH_TX_BYTES: unicast bytes sent to a neighbor
+	 */
+	BATADV_ATTR_NEIGH_TX_BYTES,
+
+	/**
+	 * @BATADV_ATTR_NEIGH_TX_PACKETS: unicast packets sent to a neighbor
+	 */
+	BATADV_ATTR_NEIGH_TX_PACKETS,
+
+	/**
+	 * @BATADV_ATTR_NEIGH_TX_DROPPED: unicast packets to a neighbor which
+	 *  were dropped on transmission
+	 */
+	BATADV_ATTR_NEIGH_TX_DROPPED,
+
+	/**
+	 * @BATADV_ATTR_NEIGH_TX_RETRIES: retransmissions to a neighbor as
+	 *  reported by the wifi driver
+	 */
+	BATADV_ATTR_NEIGH_TX_RETRIES,
+
+	/**
+	 * @BATADV_ATTR_NEIGH_TX_FAILED: failed transmissions to a neighbor as
+	 *  reported by the wifi driver
+	 */
+	BATADV_ATTR_NEIGH_TX_FAILED,
+
+	/**
+	 * @BATADV_ATTR_NEIGH_UTILIZATION: share (in percent) of the link
+	 *  throughput used by the unicast traffic to a neighbor
+	 */
+	BATADV_ATTR_NEIGH_UTILIZATION,
+
+	/**
+	 * @BATADV_ATTR_NEIGH_CAPACITY: link throughput left over by the unicast
+	 *  traffic to a neighbor (in units of kbit/s)
+	 */
+	BATADV_ATTR_NEIGH_CAPACITY,
+
+	/**
+	 * @BATADV_ATTR_CONFIG: nested setting of a BATADV_CMD_SET_CONFIG
+	 *  request, holding BATADV_ATTR_CONFIG_NAME, BATADV_ATTR_CONFIG_VALUE
+	 *  and for VLAN settings BATADV_ATTR_TT_VID
+	 */
+	BATADV_ATTR_CONFIG,
+
+	/**
+	 * @BATADV_ATTR_CONFIG_NAME: name of a setting, same as its sysfs file
+	 */
+	BATADV_ATTR_CONFIG_NAME,
+
+	/**
+	 * @BATADV_ATTR_CONFIG_VALUE: new value of a setting
+	 */
+	BATADV_ATTR_CONFIG_VALUE,
+
 	/* add attributes above here, update the policy in netlink.c */
 
 	/**
@@ -443,6 +650,61 @@ enum batadv_nl_commands {
 	 */
 	BATADV_CMD_GET_MCAST_FLAGS,
 
+	/**
+	 * @BATADV_CMD_GET_STATS: Query list of mesh and hard interface
+	 *  statistics counters
+	 */
+	BATADV_CMD_GET_STATS,
+
+	/**
+	 * @BATADV_CMD_EVENT: Notification about a mesh state change, sent to
+	 *  the events multicast group
+	 */
+	BATADV_CMD_EVENT,
+
+	/**
+	 * @BATADV_CMD_GET_NEXTHOPS: Query the selected router towards every
+	 *  originator
+	 */
+	BATADV_CMD_GET_NEXTHOPS,
+
+	/**
+	 * @BATADV_CMD_INJECT: Feed synthetic frames into the receive path of a
+	 *  hard interface (only available with CONFIG_BATMAN_ADV_INJECT)
+	 */
+	BATADV_CMD_INJECT,
+
+	/**
+	 * @BATADV_CMD_RESTORE_TT: Restore the global translation table of an
+	 *  originator which was saved before a restart. Clients are given as
+	 *  BATADV_ATTR_TT_CHANGE or with the BATADV_ATTR_TT_ADDRESS,
+	 *  BATADV_ATTR_TT_VID and BATADV_ATTR_TT_FLAGS of the
+	 *  BATADV_CMD_GET_TRANSTABLE_GLOBAL dump
+	 */
+	BATADV_CMD_RESTORE_TT,
+
+	/**
+	 * @BATADV_CMD_PING: Send echo requests to a batch of originators. The
+	 *  results are returned as one multipart message when all requests
+	 *  were answered or the timeout expired
+	 */
+	BATADV_CMD_PING,
+
+	/**
+	 * @BATADV_CMD_GET_OFFLOAD_FLOWS: Query the resolved unicast forwarding
+	 *  state (originator, ttvn, router, outgoing interface) of every global
+	 *  client whose route is stable
+	 */
+	BATADV_CMD_GET_OFFLOAD_FLOWS,
+
+	/**
+	 * @BATADV_CMD_SET_CONFIG: Apply a set of settings and hard interfaces
+	 *  to a mesh interface (created if needed) with a single request. On
+	 *  failure the settings are reset and the added interfaces removed, a
+	 *  created mesh interface is deleted again
+	 */
+	BATADV_CMD_SET_CONFIG,
+
 	/* add new commands above here */
 
 	/**
@@ -505,4 +767,294 @@ enum batadv_tp_meter_reason {
 	BATADV_TP_REASON_TOO_MANY		= 133,
 };
 
+/**
+ * enum batadv_ping_status - result of an echo request of a ping batch
+ */
+enum batadv_ping_status {
+	/**
+	 * @BATADV_PING_TIMEOUT: no answer was received before the timeout
+	 */
+	BATADV_PING_TIMEOUT,
+
+	/**
+	 * @BATADV_PING_REPLY: the destination answered with an echo reply
+	 */
+	BATADV_PING_REPLY,
+
+	/**
+	 * @BATADV_PING_UNREACHABLE: no route towards the destination is known
+	 */
+	BATADV_PING_UNREACHABLE,
+
+	/**
+	 * @BATADV_PING_TTL_EXCEEDED: the responder dropped the request because
+	 *  its TTL ran out
+	 */
+	BATADV_PING_TTL_EXCEEDED,
+};
+
+/**
+ * enum batadv_nl_event - mesh state changes reported by BATADV_CMD_EVENT
+ */
+enum batadv_nl_event {
+	/**
+	 * @BATADV_EVENT_UNSPEC: unspecified event to catch errors
+	 */
+	BATADV_EVENT_UNSPEC,
+
+	/**
+	 * @BATADV_EVENT_ORIG_ADD: originator was added
+	 */
+	BATADV_EVENT_ORIG_ADD,
+
+	/**
+	 * @BATADV_EVENT_ORIG_DEL: originator was removed
+	 */
+	BATADV_EVENT_ORIG_DEL,
+
+	/**
+	 * @BATADV_EVENT_ORIG_ROUTER: router towards an originator was added,
+	 *  changed or removed (no BATADV_ATTR_ROUTER)
+	 */
+	BATADV_EVENT_ORIG_ROUTER,
+
+	/**
+	 * @BATADV_EVENT_TT_LOCAL_ADD: local client was added or its flags
+	 *  changed
+	 */
+	BATADV_EVENT_TT_LOCAL_ADD,
+
+	/**
+	 * @BATADV_EVENT_TT_LOCAL_DEL: local client was removed
+	 */
+	BATADV_EVENT_TT_LOCAL_DEL,
+
+	/**
+	 * @BATADV_EVENT_TT_GLOBAL_ADD: global client was added or updated by
+	 *  an originator
+	 */
+	BATADV_EVENT_TT_GLOBAL_ADD,
+
+	/**
+	 * @BATADV_EVENT_TT_GLOBAL_DEL: global client was removed
+	 */
+	BATADV_EVENT_TT_GLOBAL_DEL,
+
+	/**
+	 * @BATADV_EVENT_TT_ROAM: global client roamed away from its last
+	 *  originator
+	 */
+	BATADV_EVENT_TT_ROAM,
+
+	/**
+	 * @BATADV_EVENT_GW_ADD: gateway was added
+	 */
+	BATADV_EVENT_GW_ADD,
+
+	/**
+	 * @BATADV_EVENT_GW_DEL: gateway was removed
+	 */
+	BATADV_EVENT_GW_DEL,
+
+	/**
+	 * @BATADV_EVENT_GW_SELECT: another gateway was selected, no
+	 *  BATADV_ATTR_ORIG_ADDRESS when none is selected anymore
+	 */
+	BATADV_EVENT_GW_SELECT,
+
+	/**
+	 * @BATADV_EVENT_BLA_CLAIM_ADD: claim was added or moved to another
+	 *  backbone gateway
+	 */
+	BATADV_EVENT_BLA_CLAIM_ADD,
+
+	/**
+	 * @BATADV_EVENT_BLA_CLAIM_DEL: claim was removed
+	 */
+	BATADV_EVENT_BLA_CLAIM_DEL,
+};
+
+/* "BATS" in the first four bytes of a mesh state snapshot */
+#define BATADV_SNAPSHOT_MAGIC	0x42415453
+#define BATADV_SNAPSHOT_VERSION	1
+
+/**
+ * enum batadv_snapshot_type - tables stored in a mesh state snapshot
+ */
+enum batadv_snapshot_type {
+	/**
+	 * @BATADV_SNAPSHOT_ORIGINATORS: &struct batadv_snapshot_orig entries
+	 */
+	BATADV_SNAPSHOT_ORIGINATORS = 1,
+
+	/**
+	 * @BATADV_SNAPSHOT_NEIGHBORS: &struct batadv_snapshot_neigh entries
+	 */
+	BATADV_SNAPSHOT_NEIGHBORS,
+
+	/**
+	 * @BATADV_SNAPSHOT_TRANSTABLE_LOCAL: &struct batadv_snapshot_tt_local
+	 *  entries
+	 */
+	BATADV_SNAPSHOT_TRANSTABLE_LOCAL,
+
+	/**
+	 * @BATADV_SNAPSHOT_TRANSTABLE_GLOBAL: &struct
+	 *  batadv_snapshot_tt_global entries, one per announcing originator
+	 */
+	BATADV_SNAPSHOT_TRANSTABLE_GLOBAL,
+
+	/**
+	 * @BATADV_SNAPSHOT_BLA_CLAIMS: &struct batadv_snapshot_bla_claim
+	 *  entries
+	 */
+	BATADV_SNAPSHOT_BLA_CLAIMS,
+
+	/**
+	 * @BATADV_SNAPSHOT_DAT_CACHE: &struct batadv_snapshot_dat entries
+	 */
+	BATADV_SNAPSHOT_DAT_CACHE,
+
+	/**
+	 * @BATADV_SNAPSHOT_GATEWAYS: &struct batadv_snapshot_gw entries
+	 */
+	BATADV_SNAPSHOT_GATEWAYS,
+};
+
+/**
+ * struct batadv_snapshot_hdr - header of a mesh state snapshot
+ * @magic: BATADV_SNAPSHOT_MAGIC
+ * @version: BATADV_SNAPSHOT_VERSION
+ * @num_sections: number of &struct batadv_snapshot_section following
+ * @time_msecs: uptime of the node in milliseconds when the snapshot was taken
+ * @reserved: reserved for future use, always 0
+ *
+ * All fields of the snapshot are in host byte order unless noted otherwise.
+ */
+struct batadv_snapshot_hdr {
+	__u32 magic;
+	__u16 version;
+	__u16 num_sections;
+	__u32 time_msecs;
+	__u32 reserved;
+};
+
+/**
+ * struct batadv_snapshot_section - header of a table in a snapshot
+ * @type: type of the table (see &enum batadv_snapshot_type)
+ * @entry_len: length of each entry, unknown trailing fields must be skipped
+ * @num_entries: number of entries following this header
+ */
+struct batadv_snapshot_section {
+	__u16 type;
+	__u16 entry_len;
+	__u32 num_entries;
+};
+
+/**
+ * struct batadv_snapshot_orig - originator in a snapshot
+ * @orig: address of the originator
+ * @router: address of the next hop towards the originator
+ * @router_ifindex: index of the interface the router is reached through
+ * @last_seen_msecs: time since the originator was seen the last time
+ */
+struct batadv_snapshot_orig {
+	__u8 orig[6];
+	__u8 router[6];
+	__u32 router_ifindex;
+	__u32 last_seen_msecs;
+};
+
+/**
+ * struct batadv_snapshot_neigh - single hop neighbor in a snapshot
+ * @addr: address of the neighbor
+ * @reserved: reserved for future use, always 0
+ * @ifindex: index of the interface the neighbor is reached through
+ * @last_seen_msecs: time since the neighbor was seen the last time
+ */
+struct batadv_snapshot_neigh {
+	__u8 addr[6];
+	__u16 reserved;
+	__u32 ifindex;
+	__u32 last_seen_msecs;
+};
+
+/**
+ * struct batadv_snapshot_tt_local - local client in a snapshot
+ * @addr: address of the client
+ * @vid: VLAN identifier
+ * @flags: TT client flags (see &enum batadv_tt_client_flags)
+ * @reserved: reserved for future use, always 0
+ * @last_seen_msecs: time since the client was seen the last time
+ */
+struct batadv_snapshot_tt_local {
+	__u8 addr[6];
+	__u16 vid;
+	__u16 flags;
+	__u16 reserved;
+	__u32 last_seen_msecs;
+};
+
+/**
+ * struct batadv_snapshot_tt_global - global client in a snapshot
+ * @addr: address of the client
+ * @vid: VLAN identifier
+ * @orig: address of the originator announcing the client
+ * @ttvn: translation table version of the announcement
+ * @reserved: reserved for future use, always 0
+ * @flags: TT client flags (see &enum batadv_tt_client_flags)
+ * @reserved2: reserved for future use, always 0
+ */
+struct batadv_snapshot_tt_global {
+	__u8 addr[6];
+	__u16 vid;
+	__u8 orig[6];
+	__u8 ttvn;
+	__u8 reserved;
+	__u16 flags;
+	__u16 reserved2;
+};
+
+/**
+ * struct batadv_snapshot_bla_claim - bridge loop avoidance claim in a snapshot
+ * @addr: address of the claimed client
+ * @vid: VLAN identifier
+ * @backbone: address of the backbone gateway owning the claim
+ * @reserved: reserved for future use, always 0
+ */
+struct batadv_snapshot_bla_claim {
+	__u8 addr[6];
+	__u16 vid;
+	__u8 backbone[6];
+	__u16 reserved;
+};
+
+/**
+ * struct batadv_snapshot_dat - DAT cache entry in a snapshot
+ * @ip: IPv4 address (network byte order)
+ * @mac: MAC address associated with @ip
+ * @vid: VLAN identifier
+ * @last_seen_msecs: time since the entry was refreshed the last time
+ */
+struct batadv_snapshot_dat {
+	__be32 ip;
+	__u8 mac[6];
+	__u16 vid;
+	__u32 last_seen_msecs;
+};
+
+/**
+ * struct batadv_snapshot_gw - gateway in a snapshot
+ * @orig: address of the gateway originator
+ * @reserved: reserved for future use, always 0
+ * @bandwidth_down: announced download bandwidth (in 100 kbit/s)
+ * @bandwidth_up: announced upload bandwidth (in 100 kbit/s)
+ */
+struct batadv_snapshot_gw {
+	__u8 orig[6];
+	__u16 reserved;
+	__u32 bandwidth_down;
+	__u32 bandwidth_up;
+};
+
 #endif /* _UAPI_LINUX_BATMAN_ADV_H_ */
@@ -25,9 +25,11 @@
 #include <linux/bug.h>
 #include <linux/byteorder/generic.h>
 #include <linux/cache.h>
+#include <linux/compiler.h>
 #include <linux/errno.h>
 #include <linux/etherdevice.h>
 #include <linux/gfp.h>
+#include <linux/idr.h>
 #include <linux/if_ether.h>
 #include <linux/init.h>
 #include <linux/jiffies.h>
@@ -57,6 +59,7 @@
 
 #include "bat_algo.h"
 #include "bitarray.h"
+#include "fragmentation.h"
 #include "gateway_client.h"
 #include "hard-interface.h"
 #include "hash.h"
@@ -66,10 +69,12 @@
 #include "originator.h"
 #include "routing.h"
 #include "send.h"
+#include "trace.h"
 #include "translation-table.h"
 #include "tvlv.h"
 
-static void batadv_iv_send_outstanding_bat_ogm_packet(struct work_struct *work);
+static void
+batadv_iv_send_outstanding_ogm_packet(struct batadv_forw_packet *forw_packet);
 
 /**
  * enum batadv_dup_status - duplicate status
@@ -138,166 +143,289 @@ static u8 batadv_ring_buffer_avg(const u8 lq_recv[])
 }
 
 /**
- * batadv_iv_ogm_orig_free() - free the private resources allocated for this
- *  orig_node
- * @orig_node: the orig_node for which the resources have to be free'd
+ * batadv_iv_ogm_own_slots_free_rcu() - free the own OGM counters of a
+ *  hard-interface
+ * @rcu: rcu pointer of the own slots
  */
-static void batadv_iv_ogm_orig_free(struct batadv_orig_node *orig_node)
+static void batadv_iv_ogm_own_slots_free_rcu(struct rcu_head *rcu)
 {
-	kfree(orig_node->bat_iv.bcast_own);
-	kfree(orig_node->bat_iv.bcast_own_sum);
+	struct batadv_iv_own_slots *own_slots;
+	unsigned int i;
+
+	own_slots = container_of(rcu, struct batadv_iv_own_slots, rcu);
+
+	for (i = 0; i < own_slots->num_chunks; i++)
+		kfree(own_slots->chunks[i]);
+
+	kfree(own_slots);
 }
 
 /**
- * batadv_iv_ogm_orig_add_if() - change the private structures of the orig_node
- *  to include the new hard-interface
- * @orig_node: the orig_node that has to be changed
- * @max_if_num: the current amount of interfaces
+ * batadv_iv_ogm_own_slots_resize() - provide a number of own OGM counter
+ *  chunks on a hard-interface
+ * @bat_priv: the bat priv with all the soft interface information
+ * @hard_iface: the interface which has to be resized
+ * @num_chunks: the number of chunks the interface has to provide
+ * @gfp: allocation flags
+ *
+ * Only the (small) table of chunk pointers is reallocated, the counters
+ * themselves are never moved.
  *
  * Return: 0 on success, a negative error code otherwise.
  */
-static int batadv_iv_ogm_orig_add_if(struct batadv_orig_node *orig_node,
-				     unsigned int max_if_num)
+static int batadv_iv_ogm_own_slots_resize(struct batadv_priv *bat_priv,
+					  struct batadv_hard_iface *hard_iface,
+					  unsigned int num_chunks, gfp_t gfp)
 {
-	void *data_ptr;
-	size_t old_size;
-	int ret = -ENOMEM;
+	spinlock_t *lock = &bat_priv->bat_iv.own_slots_lock; /* resize lock */
+	struct batadv_iv_own_slots *own_slots, *own_slots_old;
+	unsigned int i, num_old = 0;
 
-	spin_lock_bh(&orig_node->bat_iv.ogm_cnt_lock);
+	lockdep_assert_held(lock);
 
-	old_size = (max_if_num - 1) * sizeof(unsigned long) * BATADV_NUM_WORDS;
-	data_ptr = kmalloc_array(max_if_num,
-				 BATADV_NUM_WORDS * sizeof(unsigned long),
-				 GFP_ATOMIC);
-	if (!data_ptr)
-		goto unlock;
+	own_slots_old = rcu_dereference_protected(hard_iface->bat_iv.own_slots,
+						  lockdep_is_held(lock));
+	if (own_slots_old)
+		num_old = own_slots_old->num_chunks;
 
-	memcpy(data_ptr, orig_node->bat_iv.bcast_own, old_size);
-	kfree(orig_node->bat_iv.bcast_own);
-	orig_node->bat_iv.bcast_own = data_ptr;
+	if (own_slots_old && num_old >= num_chunks)
+		return 0;
 
-	data_ptr = kmalloc_array(max_if_num, sizeof(u8), GFP_ATOMIC);
-	if (!data_ptr)
-		goto unlock;
+	own_slots = kmalloc(sizeof(*own_slots) +
+			    num_chunks * sizeof(own_slots->chunks[0]), gfp);
+	if (!own_slots)
+		return -ENOMEM;
 
-	memcpy(data_ptr, orig_node->bat_iv.bcast_own_sum,
-	       (max_if_num - 1) * sizeof(u8));
-	kfree(orig_node->bat_iv.bcast_own_sum);
-	orig_node->bat_iv.bcast_own_sum = data_ptr;
+	own_slots->num_chunks = num_chunks;
 
-	ret = 0;
+	for (i = 0; i < num_old; i++)
+		own_slots->chunks[i] = own_slots_old->chunks[i];
 
-unlock:
-	spin_unlock_bh(&orig_node->bat_iv.ogm_cnt_lock);
+	for (i = num_old; i < num_chunks; i++) {
+		own_slots->chunks[i] = kzalloc(sizeof(*own_slots->chunks[i]),
+					       gfp);
+		if (!own_slots->chunks[i])
+			goto err;
+	}
 
-	return ret;
+	rcu_assign_pointer(hard_iface->bat_iv.own_slots, own_slots);
+
+	if (own_slots_old)
+		kfree_rcu(own_slots_old, rcu);
+
+	return 0;
+
+err:
+	while (i-- > num_old)
+		kfree(own_slots->chunks[i]);
+
+	kfree(own_slots);
+
+	return -ENOMEM;
 }
 
 /**
- * batadv_iv_ogm_drop_bcast_own_entry() - drop section of bcast_own
- * @orig_node: the orig_node that has to be changed
- * @max_if_num: the current amount of interfaces
- * @del_if_num: the index of the interface being removed
+ * batadv_iv_ogm_own_slot_get() - assign own OGM counters to an orig_node
+ * @bat_priv: the bat priv with all the soft interface information
+ * @orig_node: the orig_node which needs the counters
+ *
+ * The counters of the new slot are cleared on all hard-interfaces of the mesh
+ * and all of them are grown when the slot does not fit in the current chunks.
+ *
+ * Return: 0 on success, a negative error code otherwise.
  */
-static void
-batadv_iv_ogm_drop_bcast_own_entry(struct batadv_orig_node *orig_node,
-				   unsigned int max_if_num,
-				   unsigned int del_if_num)
+static int batadv_iv_ogm_own_slot_get(struct batadv_priv *bat_priv,
+				      struct batadv_orig_node *orig_node)
 {
-	size_t chunk_size;
-	size_t if_offset;
-	void *data_ptr;
+	struct batadv_iv_own_slots *own_slots;
+	struct batadv_hard_iface *hard_iface;
+	struct batadv_iv_own_chunk *chunk;
+	unsigned int num_chunks, idx;
+	int slot, ret = 0;
 
-	lockdep_assert_held(&orig_node->bat_iv.ogm_cnt_lock);
+	slot = ida_simple_get(&bat_priv->bat_iv.own_slot_ida, 0, 0,
+			      GFP_ATOMIC);
+	if (slot < 0)
+		return slot;
 
-	chunk_size = sizeof(unsigned long) * BATADV_NUM_WORDS;
-	data_ptr = kmalloc_array(max_if_num, chunk_size, GFP_ATOMIC);
-	if (!data_ptr)
-		/* use old buffer when new one could not be allocated */
-		data_ptr = orig_node->bat_iv.bcast_own;
+	num_chunks = slot / BATADV_IV_OWN_CHUNK_SLOTS + 1;
+	idx = slot % BATADV_IV_OWN_CHUNK_SLOTS;
 
-	/* copy first part */
-	memmove(data_ptr, orig_node->bat_iv.bcast_own, del_if_num * chunk_size);
+	spin_lock_bh(&bat_priv->bat_iv.own_slots_lock);
+	rcu_read_lock();
+	list_for_each_entry_rcu(hard_iface, &batadv_hardif_list, list) {
+		if (hard_iface->soft_iface != bat_priv->soft_iface)
+			continue;
+
+		if (!rcu_access_pointer(hard_iface->bat_iv.own_slots))
+			continue;
+
+		ret = batadv_iv_ogm_own_slots_resize(bat_priv, hard_iface,
+						     num_chunks, GFP_ATOMIC);
+		if (ret < 0)
+			break;
 
-	/* copy second part */
-	if_offset = (del_if_num + 1) * chunk_size;
-	memmove((char *)data_ptr + del_if_num * chunk_size,
-		(uint8_t *)orig_node->bat_iv.bcast_own + if_offset,
-		(max_if_num - del_if_num) * chunk_size);
+		own_slots = rcu_dereference(hard_iface->bat_iv.own_slots);
+		chunk = own_slots->chunks[num_chunks - 1];
 
-	/* bcast_own was shrunk down in new buffer; free old one */
-	if (orig_node->bat_iv.bcast_own != data_ptr) {
-		kfree(orig_node->bat_iv.bcast_own);
-		orig_node->bat_iv.bcast_own = data_ptr;
+		/* the slot may have been used by an already freed orig_node */
+		bitmap_zero(chunk->bcast_own[idx], BATADV_TQ_LOCAL_WINDOW_SIZE);
+		chunk->bcast_own_sum[idx] = 0;
+		chunk->bcast_own_seqno[idx] = 0;
 	}
+	rcu_read_unlock();
+
+	if (ret == 0 && num_chunks > bat_priv->bat_iv.own_chunks)
+		bat_priv->bat_iv.own_chunks = num_chunks;
+	spin_unlock_bh(&bat_priv->bat_iv.own_slots_lock);
+
+	if (ret < 0) {
+		ida_simple_remove(&bat_priv->bat_iv.own_slot_ida, slot);
+		return ret;
+	}
+
+	orig_node->bat_iv.own_slot = slot;
+
+	return 0;
 }
 
 /**
- * batadv_iv_ogm_drop_bcast_own_sum_entry() - drop section of bcast_own_sum
- * @orig_node: the orig_node that has to be changed
- * @max_if_num: the current amount of interfaces
- * @del_if_num: the index of the interface being removed
+ * batadv_iv_ogm_own_chunk() - get the own OGM counter chunk of an orig_node
+ * @orig_node: the orig_node owning the counters
+ * @hard_iface: the interface the counters belong to
+ *
+ * Has to be called with rcu_read_lock held.
+ *
+ * Return: the chunk holding the counters of @orig_node on @hard_iface or NULL
+ * when the interface provides none.
  */
-static void
-batadv_iv_ogm_drop_bcast_own_sum_entry(struct batadv_orig_node *orig_node,
-				       unsigned int max_if_num,
-				       unsigned int del_if_num)
+static struct batadv_iv_own_chunk *
+batadv_iv_ogm_own_chunk(struct batadv_orig_node *orig_node,
+			struct batadv_hard_iface *hard_iface)
 {
-	size_t if_offset;
-	void *data_ptr;
+	struct batadv_iv_own_slots *own_slots;
+	unsigned int chunk;
 
-	lockdep_assert_held(&orig_node->bat_iv.ogm_cnt_lock);
+	own_slots = rcu_dereference(hard_iface->bat_iv.own_slots);
+	if (!own_slots)
+		return NULL;
 
-	data_ptr = kmalloc_array(max_if_num, sizeof(u8), GFP_ATOMIC);
-	if (!data_ptr)
-		/* use old buffer when new one could not be allocated */
-		data_ptr = orig_node->bat_iv.bcast_own_sum;
+	chunk = orig_node->bat_iv.own_slot / BATADV_IV_OWN_CHUNK_SLOTS;
+	if (chunk >= own_slots->num_chunks)
+		return NULL;
 
-	memmove(data_ptr, orig_node->bat_iv.bcast_own_sum,
-		del_if_num * sizeof(u8));
+	return own_slots->chunks[chunk];
+}
 
-	if_offset = (del_if_num + 1) * sizeof(u8);
-	memmove((char *)data_ptr + del_if_num * sizeof(u8),
-		orig_node->bat_iv.bcast_own_sum + if_offset,
-		(max_if_num - del_if_num) * sizeof(u8));
+/**
+ * batadv_iv_ogm_own_window_sync() - apply the pending shifts to an own OGM
+ *  broadcast window
+ * @chunk: the own OGM counter chunk holding the window
+ * @idx: index of the window in @chunk
+ * @hard_iface: the interface the window belongs to
+ *
+ * The own OGM broadcast windows of the originators are not shifted each time
+ * an OGM is scheduled on @hard_iface. Instead the window is shifted by the
+ * number of OGMs sent since its last access and bcast_own_sum is updated
+ * accordingly.
+ */
+static void
+batadv_iv_ogm_own_window_sync(struct batadv_iv_own_chunk *chunk,
+			      unsigned int idx,
+			      struct batadv_hard_iface *hard_iface)
+{
+	unsigned long *word = chunk->bcast_own[idx];
+	u32 seqno, diff;
 
-	/* bcast_own_sum was shrunk down in new buffer; free old one */
-	if (orig_node->bat_iv.bcast_own_sum != data_ptr) {
-		kfree(orig_node->bat_iv.bcast_own_sum);
-		orig_node->bat_iv.bcast_own_sum = data_ptr;
-	}
+	seqno = (u32)atomic_read(&hard_iface->bat_iv.ogm_seqno);
+	diff = seqno - chunk->bcast_own_seqno[idx];
+	if (diff == 0)
+		return;
+
+	if (diff < BATADV_TQ_LOCAL_WINDOW_SIZE)
+		bitmap_shift_left(word, word, diff,
+				  BATADV_TQ_LOCAL_WINDOW_SIZE);
+	else
+		bitmap_zero(word, BATADV_TQ_LOCAL_WINDOW_SIZE);
+
+	chunk->bcast_own_seqno[idx] = seqno;
+	chunk->bcast_own_sum[idx] = bitmap_weight(word,
+						  BATADV_TQ_LOCAL_WINDOW_SIZE);
 }
 
 /**
- * batadv_iv_ogm_orig_del_if() - change the private structures of the orig_node
- *  to exclude the removed interface
- * @orig_node: the orig_node that has to be changed
- * @max_if_num: the current amount of interfaces
- * @del_if_num: the index of the interface being removed
+ * batadv_iv_ogm_own_sum() - get the number of own OGMs rebroadcasted back
+ * @orig_node: the orig_node which rebroadcasted the OGMs
+ * @hard_iface: the interface the OGMs were sent on
  *
- * Return: 0 on success, a negative error code otherwise.
+ * Return: the number of own OGMs in the current window which were
+ * rebroadcasted by @orig_node and received on @hard_iface
  */
-static int batadv_iv_ogm_orig_del_if(struct batadv_orig_node *orig_node,
-				     unsigned int max_if_num,
-				     unsigned int del_if_num)
+static u8 batadv_iv_ogm_own_sum(struct batadv_orig_node *orig_node,
+				struct batadv_hard_iface *hard_iface)
 {
-	spin_lock_bh(&orig_node->bat_iv.ogm_cnt_lock);
+	struct batadv_iv_own_chunk *chunk;
+	unsigned int idx;
+	u8 sum = 0;
 
-	if (max_if_num == 0) {
-		kfree(orig_node->bat_iv.bcast_own);
-		kfree(orig_node->bat_iv.bcast_own_sum);
-		orig_node->bat_iv.bcast_own = NULL;
-		orig_node->bat_iv.bcast_own_sum = NULL;
-	} else {
-		batadv_iv_ogm_drop_bcast_own_entry(orig_node, max_if_num,
-						   del_if_num);
-		batadv_iv_ogm_drop_bcast_own_sum_entry(orig_node, max_if_num,
-						       del_if_num);
+	lockdep_assert_held(&orig_node->bat_iv.ogm_cnt_lock);
+
+	rcu_read_lock();
+	chunk = batadv_iv_ogm_own_chunk(orig_node, hard_iface);
+	if (chunk) {
+		idx = orig_node->bat_iv.own_slot % BATADV_IV_OWN_CHUNK_SLOTS;
+		batadv_iv_ogm_own_window_sync(chunk, idx, hard_iface);
+		sum = chunk->bcast_own_sum[idx];
 	}
+	rcu_read_unlock();
 
-	spin_unlock_bh(&orig_node->bat_iv.ogm_cnt_lock);
+	return sum;
+}
 
-	return 0;
+/**
+ * batadv_iv_ogm_own_mark() - mark an own OGM as rebroadcasted back
+ * @orig_node: the orig_node which rebroadcasted the OGM
+ * @hard_iface: the interface the OGM was sent on
+ * @bit_pos: position of the OGM in the own OGM broadcast window
+ */
+static void batadv_iv_ogm_own_mark(struct batadv_orig_node *orig_node,
+				   struct batadv_hard_iface *hard_iface,
+				   s32 bit_pos)
+{
+	struct batadv_iv_own_chunk *chunk;
+	unsigned long *word;
+	unsigned int idx;
+
+	lockdep_assert_held(&orig_node->bat_iv.ogm_cnt_lock);
+
+	rcu_read_lock();
+	chunk = batadv_iv_ogm_own_chunk(orig_node, hard_iface);
+	if (!chunk)
+		goto out;
+
+	idx = orig_node->bat_iv.own_slot % BATADV_IV_OWN_CHUNK_SLOTS;
+	batadv_iv_ogm_own_window_sync(chunk, idx, hard_iface);
+
+	word = chunk->bcast_own[idx];
+	batadv_set_bit(word, bit_pos);
+	chunk->bcast_own_sum[idx] = bitmap_weight(word,
+						  BATADV_TQ_LOCAL_WINDOW_SIZE);
+out:
+	rcu_read_unlock();
+}
+
+/**
+ * batadv_iv_ogm_orig_free() - free the private resources allocated for this
+ *  orig_node
+ * @orig_node: the orig_node for which the resources have to be free'd
+ */
+static void batadv_iv_ogm_orig_free(struct batadv_orig_node *orig_node)
+{
+	struct batadv_priv *bat_priv = orig_node->bat_priv;
+
+	if (orig_node->bat_iv.own_slot >= 0)
+		ida_simple_remove(&bat_priv->bat_iv.own_slot_ida,
+				  orig_node->bat_iv.own_slot);
 }
 
 /**
@@ -315,7 +443,6 @@ batadv_iv_ogm_orig_get(struct batadv_priv *bat_priv, const u8 *addr)
 {
 	struct batadv_orig_node *orig_node;
 	int hash_added;
-	size_t size;
 
 	orig_node = batadv_orig_hash_find(bat_priv, addr);
 	if (orig_node)
@@ -326,15 +453,9 @@ batadv_iv_ogm_orig_get(struct batadv_priv *bat_priv, const u8 *addr)
 		return NULL;
 
 	spin_lock_init(&orig_node->bat_iv.ogm_cnt_lock);
+	orig_node->bat_iv.own_slot = -1;
 
-	size = bat_priv->num_ifaces * sizeof(unsigned long) * BATADV_NUM_WORDS;
-	orig_node->bat_iv.bcast_own = kzalloc(size, GFP_ATOMIC);
-	if (!orig_node->bat_iv.bcast_own)
-		goto free_orig_node;
-
-	size = bat_priv->num_ifaces * sizeof(u8);
-	orig_node->bat_iv.bcast_own_sum = kzalloc(size, GFP_ATOMIC);
-	if (!orig_node->bat_iv.bcast_own_sum)
+	if (batadv_iv_ogm_own_slot_get(bat_priv, orig_node) < 0)
 		goto free_orig_node;
 
 	kref_get(&orig_node->refcount);
@@ -344,6 +465,10 @@ batadv_iv_ogm_orig_get(struct batadv_priv *bat_priv, const u8 *addr)
 	if (hash_added != 0)
 		goto free_orig_node_hash;
 
+	batadv_orig_dat_ring_schedule(bat_priv);
+	batadv_netlink_notify_orig(bat_priv, BATADV_EVENT_ORIG_ADD,
+				   orig_node->orig, NULL);
+
 	return orig_node;
 
 free_orig_node_hash:
@@ -375,9 +500,11 @@ out:
 
 static int batadv_iv_ogm_iface_enable(struct batadv_hard_iface *hard_iface)
 {
+	struct batadv_priv *bat_priv = netdev_priv(hard_iface->soft_iface);
 	struct batadv_ogm_packet *batadv_ogm_packet;
 	unsigned char *ogm_buff;
 	u32 random_seqno;
+	int ret;
 
 	/* randomize initial seqno to avoid collision */
 	get_random_bytes(&random_seqno, sizeof(random_seqno));
@@ -398,13 +525,36 @@ static int batadv_iv_ogm_iface_enable(struct batadv_hard_iface *hard_iface)
 	batadv_ogm_packet->reserved = 0;
 	batadv_ogm_packet->tq = BATADV_TQ_MAX_VALUE;
 
-	return 0;
+	spin_lock_bh(&bat_priv->bat_iv.own_slots_lock);
+	ret = batadv_iv_ogm_own_slots_resize(bat_priv, hard_iface,
+					     bat_priv->bat_iv.own_chunks,
+					     GFP_ATOMIC);
+	spin_unlock_bh(&bat_priv->bat_iv.own_slots_lock);
+
+	if (ret < 0) {
+		kfree(hard_iface->bat_iv.ogm_buff);
+		hard_iface->bat_iv.ogm_buff = NULL;
+	}
+
+	return ret;
 }
 
 static void batadv_iv_ogm_iface_disable(struct batadv_hard_iface *hard_iface)
 {
+	struct batadv_priv *bat_priv = netdev_priv(hard_iface->soft_iface);
+	struct batadv_iv_own_slots *own_slots;
+
 	kfree(hard_iface->bat_iv.ogm_buff);
 	hard_iface->bat_iv.ogm_buff = NULL;
+
+	spin_lock_bh(&bat_priv->bat_iv.own_slots_lock);
+	own_slots = rcu_dereference_protected(hard_iface->bat_iv.own_slots,
+					      true);
+	RCU_INIT_POINTER(hard_iface->bat_iv.own_slots, NULL);
+	spin_unlock_bh(&bat_priv->bat_iv.own_slots_lock);
+
+	if (own_slots)
+		call_rcu(&own_slots->rcu, batadv_iv_ogm_own_slots_free_rcu);
 }
 
 static void batadv_iv_ogm_iface_update_mac(struct batadv_hard_iface *hard_iface)
@@ -429,13 +579,27 @@ batadv_iv_ogm_primary_iface_set(struct batadv_hard_iface *hard_iface)
 	batadv_ogm_packet->ttl = BATADV_TTL;
 }
 
+/**
+ * batadv_iv_ogm_rearm() - send the queued own OGMs within orig_interval
+ * @bat_priv: the bat priv with all the soft interface information
+ */
+static void batadv_iv_ogm_rearm(struct batadv_priv *bat_priv)
+{
+	unsigned int msecs = atomic_read(&bat_priv->orig_interval);
+
+	batadv_forw_packet_ogmv1_advance(bat_priv,
+					 jiffies + msecs_to_jiffies(msecs));
+}
+
 /* when do we schedule our own ogm to be sent */
 static unsigned long
-batadv_iv_ogm_emit_send_time(const struct batadv_priv *bat_priv)
+batadv_iv_ogm_emit_send_time(struct batadv_priv *bat_priv,
+			     struct batadv_hard_iface *hard_iface)
 {
 	unsigned int msecs;
 
-	msecs = atomic_read(&bat_priv->orig_interval) - BATADV_JITTER;
+	msecs = batadv_ogm_interval(bat_priv, &hard_iface->bat_iv.ogm_backoff);
+	msecs -= BATADV_JITTER;
 	msecs += prandom_u32() % (2 * BATADV_JITTER);
 
 	return jiffies + msecs_to_jiffies(msecs);
@@ -672,10 +836,30 @@ out:
 	return res;
 }
 
+/**
+ * batadv_iv_ogm_put() - append an OGM to an aggregated packet
+ * @skb: the aggregated packet
+ * @packet_buff: pointer to the OGM header
+ * @tvlv_buff: pointer to the tvlv data of the OGM
+ * @packet_len: (total) length of the OGM
+ *
+ * The OGM header and its tvlv data don't have to be stored next to each other.
+ * This allows to forward a received OGM with a modified header without copying
+ * the whole packet first.
+ */
+static void batadv_iv_ogm_put(struct sk_buff *skb,
+			      const unsigned char *packet_buff,
+			      const unsigned char *tvlv_buff, int packet_len)
+{
+	skb_put_data(skb, packet_buff, BATADV_OGM_HLEN);
+	skb_put_data(skb, tvlv_buff, packet_len - BATADV_OGM_HLEN);
+}
+
 /**
  * batadv_iv_ogm_aggregate_new() - create a new aggregated packet and add this
  *  packet to it.
- * @packet_buff: pointer to the OGM
+ * @packet_buff: pointer to the OGM header
+ * @tvlv_buff: pointer to the tvlv data of the OGM
  * @packet_len: (total) length of the OGM
  * @send_time: timestamp (jiffies) when the packet is to be sent
  * @direct_link: whether this OGM has direct link status
@@ -684,6 +868,7 @@ out:
  * @own_packet: true if it is a self-generated ogm
  */
 static void batadv_iv_ogm_aggregate_new(const unsigned char *packet_buff,
+					const unsigned char *tvlv_buff,
 					int packet_len, unsigned long send_time,
 					bool direct_link,
 					struct batadv_hard_iface *if_incoming,
@@ -693,7 +878,6 @@ static void batadv_iv_ogm_aggregate_new(const unsigned char *packet_buff,
 	struct batadv_priv *bat_priv = netdev_priv(if_incoming->soft_iface);
 	struct batadv_forw_packet *forw_packet_aggr;
 	struct sk_buff *skb;
-	unsigned char *skb_buff;
 	unsigned int skb_size;
 	atomic_t *queue_left = own_packet ? NULL : &bat_priv->batman_queue_left;
 
@@ -719,9 +903,9 @@ static void batadv_iv_ogm_aggregate_new(const unsigned char *packet_buff,
 	forw_packet_aggr->skb->priority = TC_PRIO_CONTROL;
 	skb_reserve(forw_packet_aggr->skb, ETH_HLEN);
 
-	skb_buff = skb_put(forw_packet_aggr->skb, packet_len);
+	batadv_iv_ogm_put(forw_packet_aggr->skb, packet_buff, tvlv_buff,
+			  packet_len);
 	forw_packet_aggr->packet_len = packet_len;
-	memcpy(skb_buff, packet_buff, packet_len);
 
 	forw_packet_aggr->own = own_packet;
 	forw_packet_aggr->direct_link_flags = BATADV_NO_FLAGS;
@@ -731,8 +915,15 @@ static void batadv_iv_ogm_aggregate_new(const unsigned char *packet_buff,
 	if (direct_link)
 		forw_packet_aggr->direct_link_flags |= 1;
 
-	INIT_DELAYED_WORK(&forw_packet_aggr->delayed_work,
-			  batadv_iv_send_outstanding_bat_ogm_packet);
+	forw_packet_aggr->send = batadv_iv_send_outstanding_ogm_packet;
+
+	/* further OGMs can be aggregated into it until it is due */
+	if (!own_packet && atomic_read(&bat_priv->aggregated_ogms)) {
+		spin_lock_bh(&bat_priv->forw_bat.lock);
+		list_add_tail(&forw_packet_aggr->aggr_list,
+			      &if_outgoing->bat_iv.aggr_list);
+		spin_unlock_bh(&bat_priv->forw_bat.lock);
+	}
 
 	batadv_forw_packet_ogmv1_queue(bat_priv, forw_packet_aggr, send_time);
 }
@@ -740,11 +931,13 @@ static void batadv_iv_ogm_aggregate_new(const unsigned char *packet_buff,
 /* aggregate a new packet into the existing ogm packet */
 static void batadv_iv_ogm_aggregate(struct batadv_forw_packet *forw_packet_aggr,
 				    const unsigned char *packet_buff,
+				    const unsigned char *tvlv_buff,
 				    int packet_len, bool direct_link)
 {
 	unsigned long new_direct_link_flag;
 
-	skb_put_data(forw_packet_aggr->skb, packet_buff, packet_len);
+	batadv_iv_ogm_put(forw_packet_aggr->skb, packet_buff, tvlv_buff,
+			  packet_len);
 	forw_packet_aggr->packet_len += packet_len;
 	forw_packet_aggr->num_packets++;
 
@@ -758,7 +951,8 @@ static void batadv_iv_ogm_aggregate(struct batadv_forw_packet *forw_packet_aggr,
 /**
  * batadv_iv_ogm_queue_add() - queue up an OGM for transmission
  * @bat_priv: the bat priv with all the soft interface information
- * @packet_buff: pointer to the OGM
+ * @packet_buff: pointer to the OGM header
+ * @tvlv_buff: pointer to the tvlv data of the OGM
  * @packet_len: (total) length of the OGM
  * @if_incoming: interface where the packet was received
  * @if_outgoing: interface for which the retransmission should be considered
@@ -767,6 +961,7 @@ static void batadv_iv_ogm_aggregate(struct batadv_forw_packet *forw_packet_aggr,
  */
 static void batadv_iv_ogm_queue_add(struct batadv_priv *bat_priv,
 				    unsigned char *packet_buff,
+				    const unsigned char *tvlv_buff,
 				    int packet_len,
 				    struct batadv_hard_iface *if_incoming,
 				    struct batadv_hard_iface *if_outgoing,
@@ -785,12 +980,15 @@ static void batadv_iv_ogm_queue_add(struct batadv_priv *bat_priv,
 	direct_link = !!(batadv_ogm_packet->flags & BATADV_DIRECTLINK);
 	max_aggregation_jiffies = msecs_to_jiffies(BATADV_MAX_AGGREGATION_MS);
 
-	/* find position for the packet in the forward queue */
-	spin_lock_bh(&bat_priv->forw_bat_list_lock);
+	/* only the pending aggregates of the outgoing interface have to be
+	 * checked, newest first
+	 */
+	spin_lock_bh(&bat_priv->forw_bat.lock);
 	/* own packets are not to be aggregated */
 	if (atomic_read(&bat_priv->aggregated_ogms) && !own_packet) {
-		hlist_for_each_entry(forw_packet_pos,
-				     &bat_priv->forw_bat_list, list) {
+		list_for_each_entry_reverse(forw_packet_pos,
+					    &if_outgoing->bat_iv.aggr_list,
+					    aggr_list) {
 			if (batadv_iv_ogm_can_aggregate(batadv_ogm_packet,
 							bat_priv, packet_len,
 							send_time, direct_link,
@@ -808,7 +1006,7 @@ static void batadv_iv_ogm_queue_add(struct batadv_priv *bat_priv,
 	 */
 	if (!forw_packet_aggr) {
 		/* the following section can run without the lock */
-		spin_unlock_bh(&bat_priv->forw_bat_list_lock);
+		spin_unlock_bh(&bat_priv->forw_bat.lock);
 
 		/* if we could not aggregate this packet with one of the others
 		 * we hold it back for a while, so that it might be aggregated
@@ -817,20 +1015,21 @@ static void batadv_iv_ogm_queue_add(struct batadv_priv *bat_priv,
 		if (!own_packet && atomic_read(&bat_priv->aggregated_ogms))
 			send_time += max_aggregation_jiffies;
 
-		batadv_iv_ogm_aggregate_new(packet_buff, packet_len,
+		batadv_iv_ogm_aggregate_new(packet_buff, tvlv_buff, packet_len,
 					    send_time, direct_link,
 					    if_incoming, if_outgoing,
 					    own_packet);
 	} else {
 		batadv_iv_ogm_aggregate(forw_packet_aggr, packet_buff,
-					packet_len, direct_link);
-		spin_unlock_bh(&bat_priv->forw_bat_list_lock);
+					tvlv_buff, packet_len, direct_link);
+		spin_unlock_bh(&bat_priv->forw_bat.lock);
 	}
 }
 
 static void batadv_iv_ogm_forward(struct batadv_orig_node *orig_node,
 				  const struct ethhdr *ethhdr,
 				  struct batadv_ogm_packet *batadv_ogm_packet,
+				  const unsigned char *tvlv_buff,
 				  bool is_single_hop_neigh,
 				  bool is_from_best_next_hop,
 				  struct batadv_hard_iface *if_incoming,
@@ -857,6 +1056,14 @@ static void batadv_iv_ogm_forward(struct batadv_orig_node *orig_node,
 			return;
 	}
 
+	if (!batadv_ogm_fisheye_forward(bat_priv, orig_node,
+					batadv_ogm_packet->ttl,
+					ntohl(batadv_ogm_packet->seqno))) {
+		batadv_dbg(BATADV_DBG_BATMAN, bat_priv,
+			   "Drop packet: originator outside of fisheye scope\n");
+		return;
+	}
+
 	tvlv_len = ntohs(batadv_ogm_packet->tvlv_len);
 
 	batadv_ogm_packet->ttl--;
@@ -876,48 +1083,11 @@ static void batadv_iv_ogm_forward(struct batadv_orig_node *orig_node,
 		batadv_ogm_packet->flags &= ~BATADV_DIRECTLINK;
 
 	batadv_iv_ogm_queue_add(bat_priv, (unsigned char *)batadv_ogm_packet,
-				BATADV_OGM_HLEN + tvlv_len,
+				tvlv_buff, BATADV_OGM_HLEN + tvlv_len,
 				if_incoming, if_outgoing, 0,
 				batadv_iv_ogm_fwd_send_time());
 }
 
-/**
- * batadv_iv_ogm_slide_own_bcast_window() - bitshift own OGM broadcast windows
- *  for the given interface
- * @hard_iface: the interface for which the windows have to be shifted
- */
-static void
-batadv_iv_ogm_slide_own_bcast_window(struct batadv_hard_iface *hard_iface)
-{
-	struct batadv_priv *bat_priv = netdev_priv(hard_iface->soft_iface);
-	struct batadv_hashtable *hash = bat_priv->orig_hash;
-	struct hlist_head *head;
-	struct batadv_orig_node *orig_node;
-	unsigned long *word;
-	u32 i;
-	size_t word_index;
-	u8 *w;
-	unsigned int if_num;
-
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-
-		rcu_read_lock();
-		hlist_for_each_entry_rcu(orig_node, head, hash_entry) {
-			spin_lock_bh(&orig_node->bat_iv.ogm_cnt_lock);
-			word_index = hard_iface->if_num * BATADV_NUM_WORDS;
-			word = &orig_node->bat_iv.bcast_own[word_index];
-
-			batadv_bit_get_packet(bat_priv, word, 1, 0);
-			if_num = hard_iface->if_num;
-			w = &orig_node->bat_iv.bcast_own_sum[if_num];
-			*w = bitmap_weight(word, BATADV_TQ_LOCAL_WINDOW_SIZE);
-			spin_unlock_bh(&orig_node->bat_iv.ogm_cnt_lock);
-		}
-		rcu_read_unlock();
-	}
-}
-
 static void batadv_iv_ogm_schedule(struct batadv_hard_iface *hard_iface)
 {
 	struct batadv_priv *bat_priv = netdev_priv(hard_iface->soft_iface);
@@ -962,16 +1132,16 @@ static void batadv_iv_ogm_schedule(struct batadv_hard_iface *hard_iface)
 	batadv_ogm_packet->seqno = htonl(seqno);
 	atomic_inc(&hard_iface->bat_iv.ogm_seqno);
 
-	batadv_iv_ogm_slide_own_bcast_window(hard_iface);
-
-	send_time = batadv_iv_ogm_emit_send_time(bat_priv);
+	send_time = batadv_iv_ogm_emit_send_time(bat_priv, hard_iface);
 
 	if (hard_iface != primary_if) {
 		/* OGMs from secondary interfaces are only scheduled on their
 		 * respective interfaces.
 		 */
-		batadv_iv_ogm_queue_add(bat_priv, *ogm_buff, *ogm_buff_len,
-					hard_iface, hard_iface, 1, send_time);
+		batadv_iv_ogm_queue_add(bat_priv, *ogm_buff,
+					*ogm_buff + BATADV_OGM_HLEN,
+					*ogm_buff_len, hard_iface, hard_iface,
+					1, send_time);
 		goto out;
 	}
 
@@ -987,6 +1157,7 @@ static void batadv_iv_ogm_schedule(struct batadv_hard_iface *hard_iface)
 			continue;
 
 		batadv_iv_ogm_queue_add(bat_priv, *ogm_buff,
+					*ogm_buff + BATADV_OGM_HLEN,
 					*ogm_buff_len, hard_iface,
 					tmp_hard_iface, 1, send_time);
 
@@ -1027,7 +1198,6 @@ batadv_iv_ogm_orig_update(struct batadv_priv *bat_priv,
 	struct batadv_neigh_node *tmp_neigh_node = NULL;
 	struct batadv_neigh_node *router = NULL;
 	struct batadv_orig_node *orig_node_tmp;
-	unsigned int if_num;
 	u8 sum_orig, sum_neigh;
 	u8 *neigh_addr;
 	u8 tq_avg;
@@ -1134,14 +1304,14 @@ batadv_iv_ogm_orig_update(struct batadv_priv *bat_priv,
 	    neigh_ifinfo->bat_iv.tq_avg == router_ifinfo->bat_iv.tq_avg) {
 		orig_node_tmp = router->orig_node;
 		spin_lock_bh(&orig_node_tmp->bat_iv.ogm_cnt_lock);
-		if_num = router->if_incoming->if_num;
-		sum_orig = orig_node_tmp->bat_iv.bcast_own_sum[if_num];
+		sum_orig = batadv_iv_ogm_own_sum(orig_node_tmp,
+						 router->if_incoming);
 		spin_unlock_bh(&orig_node_tmp->bat_iv.ogm_cnt_lock);
 
 		orig_node_tmp = neigh_node->orig_node;
 		spin_lock_bh(&orig_node_tmp->bat_iv.ogm_cnt_lock);
-		if_num = neigh_node->if_incoming->if_num;
-		sum_neigh = orig_node_tmp->bat_iv.bcast_own_sum[if_num];
+		sum_neigh = batadv_iv_ogm_own_sum(orig_node_tmp,
+						  neigh_node->if_incoming);
 		spin_unlock_bh(&orig_node_tmp->bat_iv.ogm_cnt_lock);
 
 		if (sum_orig >= sum_neigh)
@@ -1186,7 +1356,6 @@ static bool batadv_iv_ogm_calc_tq(struct batadv_orig_node *orig_node,
 	u8 total_count;
 	u8 orig_eq_count, neigh_rq_count, neigh_rq_inv, tq_own;
 	unsigned int neigh_rq_inv_cube, neigh_rq_max_cube;
-	unsigned int if_num;
 	unsigned int tq_asym_penalty, inv_asym_penalty;
 	unsigned int combined_tq;
 	unsigned int tq_iface_penalty;
@@ -1228,8 +1397,7 @@ static bool batadv_iv_ogm_calc_tq(struct batadv_orig_node *orig_node,
 
 	/* find packet count of corresponding one hop neighbor */
 	spin_lock_bh(&orig_neigh_node->bat_iv.ogm_cnt_lock);
-	if_num = if_incoming->if_num;
-	orig_eq_count = orig_neigh_node->bat_iv.bcast_own_sum[if_num];
+	orig_eq_count = batadv_iv_ogm_own_sum(orig_neigh_node, if_incoming);
 	neigh_ifinfo = batadv_neigh_ifinfo_new(neigh_node, if_outgoing);
 	if (neigh_ifinfo) {
 		neigh_rq_count = neigh_ifinfo->bat_iv.real_packet_count;
@@ -1436,25 +1604,24 @@ batadv_iv_ogm_process_per_outif(const struct sk_buff *skb, int ogm_offset,
 	struct batadv_orig_ifinfo *orig_ifinfo;
 	struct batadv_neigh_node *orig_neigh_router = NULL;
 	struct batadv_neigh_ifinfo *router_ifinfo = NULL;
-	struct batadv_ogm_packet *ogm_packet;
+	struct batadv_ogm_packet *ogm_packet, ogm_packet_tmp;
+	struct batadv_ogm_packet *skb_ogm_packet;
 	enum batadv_dup_status dup_status;
 	bool is_from_best_next_hop = false;
 	bool is_single_hop_neigh = false;
 	bool sameseq, similar_ttl;
-	struct sk_buff *skb_priv;
 	struct ethhdr *ethhdr;
 	u8 *prev_sender;
 	bool is_bidirect;
 
-	/* create a private copy of the skb, as some functions change tq value
-	 * and/or flags.
+	/* some functions change tq value and/or flags - only the header is
+	 * copied for that. The tvlv data is read from the skb and copied only
+	 * when the OGM gets forwarded.
 	 */
-	skb_priv = skb_copy(skb, GFP_ATOMIC);
-	if (!skb_priv)
-		return;
-
-	ethhdr = eth_hdr(skb_priv);
-	ogm_packet = (struct batadv_ogm_packet *)(skb_priv->data + ogm_offset);
+	ethhdr = eth_hdr(skb);
+	skb_ogm_packet = (struct batadv_ogm_packet *)(skb->data + ogm_offset);
+	memcpy(&ogm_packet_tmp, skb_ogm_packet, sizeof(ogm_packet_tmp));
+	ogm_packet = &ogm_packet_tmp;
 
 	dup_status = batadv_iv_ogm_update_seqnos(ethhdr, ogm_packet,
 						 if_incoming, if_outgoing);
@@ -1505,7 +1672,7 @@ batadv_iv_ogm_process_per_outif(const struct sk_buff *skb, int ogm_offset,
 	}
 
 	if (if_outgoing == BATADV_IF_DEFAULT)
-		batadv_tvlv_ogm_receive(bat_priv, ogm_packet, orig_node);
+		batadv_tvlv_ogm_receive(bat_priv, skb_ogm_packet, orig_node);
 
 	/* if sender is a direct neighbor the sender mac equals
 	 * originator mac
@@ -1575,6 +1742,7 @@ batadv_iv_ogm_process_per_outif(const struct sk_buff *skb, int ogm_offset,
 		}
 		/* mark direct link on incoming interface */
 		batadv_iv_ogm_forward(orig_node, ethhdr, ogm_packet,
+				      (unsigned char *)(skb_ogm_packet + 1),
 				      is_single_hop_neigh,
 				      is_from_best_next_hop, if_incoming,
 				      if_outgoing);
@@ -1600,6 +1768,7 @@ batadv_iv_ogm_process_per_outif(const struct sk_buff *skb, int ogm_offset,
 	batadv_dbg(BATADV_DBG_BATMAN, bat_priv,
 		   "Forwarding packet: rebroadcast originator packet\n");
 	batadv_iv_ogm_forward(orig_node, ethhdr, ogm_packet,
+			      (unsigned char *)(skb_ogm_packet + 1),
 			      is_single_hop_neigh, is_from_best_next_hop,
 			      if_incoming, if_outgoing);
 
@@ -1617,8 +1786,6 @@ out:
 		batadv_neigh_node_put(orig_neigh_router);
 	if (hardif_neigh)
 		batadv_hardif_neigh_put(hardif_neigh);
-
-	consume_skb(skb_priv);
 }
 
 /**
@@ -1627,7 +1794,7 @@ out:
  * @ogm_offset: offset to the OGM which should be processed (for aggregates)
  * @if_incoming: the interface where this packet was receved
  */
-static void batadv_iv_ogm_process(const struct sk_buff *skb, int ogm_offset,
+static void batadv_iv_ogm_process(struct sk_buff *skb, int ogm_offset,
 				  struct batadv_hard_iface *if_incoming)
 {
 	struct batadv_priv *bat_priv = netdev_priv(if_incoming->soft_iface);
@@ -1705,11 +1872,7 @@ static void batadv_iv_ogm_process(const struct sk_buff *skb, int ogm_offset,
 	}
 
 	if (is_my_orig) {
-		unsigned long *word;
-		size_t offset;
 		s32 bit_pos;
-		unsigned int if_num;
-		u8 *weight;
 
 		orig_neigh_node = batadv_iv_ogm_orig_get(bat_priv,
 							 ethhdr->h_source);
@@ -1723,17 +1886,12 @@ static void batadv_iv_ogm_process(const struct sk_buff *skb, int ogm_offset,
 		if (has_directlink_flag &&
 		    batadv_compare_eth(if_incoming->net_dev->dev_addr,
 				       ogm_packet->orig)) {
-			if_num = if_incoming->if_num;
-			offset = if_num * BATADV_NUM_WORDS;
-
-			spin_lock_bh(&orig_neigh_node->bat_iv.ogm_cnt_lock);
-			word = &orig_neigh_node->bat_iv.bcast_own[offset];
 			bit_pos = if_incoming_seqno - 2;
 			bit_pos -= ntohl(ogm_packet->seqno);
-			batadv_set_bit(word, bit_pos);
-			weight = &orig_neigh_node->bat_iv.bcast_own_sum[if_num];
-			*weight = bitmap_weight(word,
-						BATADV_TQ_LOCAL_WINDOW_SIZE);
+
+			spin_lock_bh(&orig_neigh_node->bat_iv.ogm_cnt_lock);
+			batadv_iv_ogm_own_mark(orig_neigh_node, if_incoming,
+					       bit_pos);
 			spin_unlock_bh(&orig_neigh_node->bat_iv.ogm_cnt_lock);
 		}
 
@@ -1761,6 +1919,12 @@ static void batadv_iv_ogm_process(const struct sk_buff *skb, int ogm_offset,
 	if (!orig_node)
 		return;
 
+	/* the skb was made writable by batadv_check_management_packet() */
+	batadv_frag_path_mtu_ogm_update(orig_node, ethhdr->h_source,
+					(u8 *)(ogm_packet + 1),
+					ntohs(ogm_packet->tvlv_len),
+					if_incoming);
+
 	batadv_iv_ogm_process_per_outif(skb, ogm_offset, orig_node,
 					if_incoming, BATADV_IF_DEFAULT);
 
@@ -1785,16 +1949,12 @@ static void batadv_iv_ogm_process(const struct sk_buff *skb, int ogm_offset,
 	batadv_orig_node_put(orig_node);
 }
 
-static void batadv_iv_send_outstanding_bat_ogm_packet(struct work_struct *work)
+static void
+batadv_iv_send_outstanding_ogm_packet(struct batadv_forw_packet *forw_packet)
 {
-	struct delayed_work *delayed_work;
-	struct batadv_forw_packet *forw_packet;
 	struct batadv_priv *bat_priv;
 	bool dropped = false;
 
-	delayed_work = to_delayed_work(work);
-	forw_packet = container_of(delayed_work, struct batadv_forw_packet,
-				   delayed_work);
 	bat_priv = netdev_priv(forw_packet->if_incoming->soft_iface);
 
 	if (atomic_read(&bat_priv->mesh_state) == BATADV_MESH_DEACTIVATING) {
@@ -1818,8 +1978,7 @@ static void batadv_iv_send_outstanding_bat_ogm_packet(struct work_struct *work)
 
 out:
 	/* do we get something for free()? */
-	if (batadv_forw_packet_steal(forw_packet,
-				     &bat_priv->forw_bat_list_lock))
+	if (batadv_forw_packet_steal(forw_packet, &bat_priv->forw_bat.lock))
 		batadv_forw_packet_free(forw_packet, dropped);
 }
 
@@ -1832,6 +1991,7 @@ static int batadv_iv_ogm_receive(struct sk_buff *skb,
 	int ogm_offset;
 	bool res;
 	int ret = NET_RX_DROP;
+	u64 start;
 
 	res = batadv_check_management_packet(skb, if_incoming, BATADV_OGM_HLEN);
 	if (!res)
@@ -1853,8 +2013,15 @@ static int batadv_iv_ogm_receive(struct sk_buff *skb,
 	/* unpack the aggregated packets and process them one by one */
 	while (batadv_iv_ogm_aggr_packet(ogm_offset, skb_headlen(skb),
 					 ogm_packet->tvlv_len)) {
+		start = 0;
+		if (trace_batadv_iv_ogm_process_enabled())
+			start = batadv_trace_clock();
+
 		batadv_iv_ogm_process(skb, ogm_offset, if_incoming);
 
+		trace_batadv_iv_ogm_process(if_incoming->net_dev,
+					    ogm_packet->orig, start);
+
 		ogm_offset += BATADV_OGM_HLEN;
 		ogm_offset += ntohs(ogm_packet->tvlv_len);
 
@@ -1926,10 +2093,9 @@ static void batadv_iv_ogm_orig_print(struct batadv_priv *bat_priv,
 	seq_puts(seq,
 		 "  Originator      last-seen (#/255)           Nexthop [outgoingIF]:   Potential nexthops ...\n");
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-
+	for (i = 0; i < batadv_hash_size(hash); i++) {
 		rcu_read_lock();
+		head = batadv_hash_bucket_rcu(hash, i);
 		hlist_for_each_entry_rcu(orig_node, head, hash_entry) {
 			neigh_node = batadv_orig_router_get(orig_node,
 							    if_outgoing);
@@ -2024,6 +2190,7 @@ batadv_iv_ogm_orig_dump_subentry(struct sk_buff *msg, u32 portid, u32 seq,
 	void *hdr;
 	u8 tq_avg;
 	unsigned int last_seen_msecs;
+	u16 path_mtu;
 
 	last_seen_msecs = jiffies_to_msecs(jiffies - orig_node->last_seen);
 
@@ -2053,6 +2220,11 @@ batadv_iv_ogm_orig_dump_subentry(struct sk_buff *msg, u32 portid, u32 seq,
 	if (best && nla_put_flag(msg, BATADV_ATTR_FLAG_BEST))
 		goto nla_put_failure;
 
+	path_mtu = READ_ONCE(orig_node->path_mtu);
+	if (best && path_mtu &&
+	    nla_put_u16(msg, BATADV_ATTR_PATH_MTU, path_mtu))
+		goto nla_put_failure;
+
 	genlmsg_end(msg, hdr);
 	return 0;
 
@@ -2131,7 +2303,8 @@ batadv_iv_ogm_orig_dump_entry(struct sk_buff *msg, u32 portid, u32 seq,
  * @seq: Sequence number of netlink message
  * @bat_priv: The bat priv with all the soft interface information
  * @if_outgoing: Limit dump to entries with this outgoing interface
- * @head: Bucket to be dumped
+ * @hash: Hash table to dump
+ * @bucket: Index of the bucket to be dumped
  * @idx_s: Number of entries to be skipped
  * @sub: Number of sub entries to be skipped
  *
@@ -2141,12 +2314,15 @@ static int
 batadv_iv_ogm_orig_dump_bucket(struct sk_buff *msg, u32 portid, u32 seq,
 			       struct batadv_priv *bat_priv,
 			       struct batadv_hard_iface *if_outgoing,
-			       struct hlist_head *head, int *idx_s, int *sub)
+			       struct batadv_hashtable *hash, u32 bucket,
+			       int *idx_s, int *sub)
 {
 	struct batadv_orig_node *orig_node;
+	struct hlist_head *head;
 	int idx = 0;
 
 	rcu_read_lock();
+	head = batadv_hash_bucket_rcu(hash, bucket);
 	hlist_for_each_entry_rcu(orig_node, head, hash_entry) {
 		if (idx++ < *idx_s)
 			continue;
@@ -2179,24 +2355,26 @@ batadv_iv_ogm_orig_dump(struct sk_buff *msg, struct netlink_callback *cb,
 			struct batadv_hard_iface *if_outgoing)
 {
 	struct batadv_hashtable *hash = bat_priv->orig_hash;
-	struct hlist_head *head;
 	int bucket = cb->args[0];
 	int idx = cb->args[1];
 	int sub = cb->args[2];
 	int portid = NETLINK_CB(cb->skb).portid;
+	int start = msg->len;
 
-	while (bucket < hash->size) {
-		head = &hash->table[bucket];
+	cb->seq = batadv_hash_generation(hash) << 1 | 1;
 
+	while (bucket < batadv_hash_size(hash)) {
 		if (batadv_iv_ogm_orig_dump_bucket(msg, portid,
 						   cb->nlh->nlmsg_seq,
-						   bat_priv, if_outgoing, head,
-						   &idx, &sub))
+						   bat_priv, if_outgoing, hash,
+						   bucket, &idx, &sub))
 			break;
 
 		bucket++;
 	}
 
+	batadv_netlink_dump_check(msg, cb, start);
+
 	cb->args[0] = bucket;
 	cb->args[1] = idx;
 	cb->args[2] = sub;
@@ -2485,6 +2663,29 @@ batadv_iv_ogm_neigh_is_sob(struct batadv_neigh_node *neigh1,
 	return ret;
 }
 
+/**
+ * batadv_iv_ogm_neigh_metric() - get the tq of the path via a neighbor
+ * @neigh: the neighbor object
+ * @if_outgoing: outgoing interface for the neighbor
+ *
+ * Return: the average tq via neigh or 0 if none is known
+ */
+static u32 batadv_iv_ogm_neigh_metric(struct batadv_neigh_node *neigh,
+				      struct batadv_hard_iface *if_outgoing)
+{
+	struct batadv_neigh_ifinfo *neigh_ifinfo;
+	u32 metric;
+
+	neigh_ifinfo = batadv_neigh_ifinfo_get(neigh, if_outgoing);
+	if (!neigh_ifinfo)
+		return 0;
+
+	metric = neigh_ifinfo->bat_iv.tq_avg;
+	batadv_neigh_ifinfo_put(neigh_ifinfo);
+
+	return metric;
+}
+
 static void batadv_iv_iface_activate(struct batadv_hard_iface *hard_iface)
 {
 	/* begin scheduling originator messages on that interface */
@@ -2501,153 +2702,99 @@ static void batadv_iv_init_sel_class(struct batadv_priv *bat_priv)
 	atomic_set(&bat_priv->gw.sel_class, 20);
 }
 
-static struct batadv_gw_node *
-batadv_iv_gw_get_best_gw_node(struct batadv_priv *bat_priv)
+/**
+ * batadv_iv_gw_metric() - compute the ranking of a GW node
+ * @bat_priv: the bat priv with all the soft interface information
+ * @gw_node: the GW to compute the ranking for
+ *
+ * The "fast connection" class ranks the gateways by a combination of TQ and
+ * advertised download bandwidth and only falls back to the TQ for equally
+ * ranked gateways. All the other classes use the best statistic, which is
+ * the TQ towards the gateway.
+ *
+ * Return: the ranking of gw_node, 0 if it cannot be reached
+ */
+static u64 batadv_iv_gw_metric(struct batadv_priv *bat_priv,
+			       struct batadv_gw_node *gw_node)
 {
-	struct batadv_neigh_node *router;
 	struct batadv_neigh_ifinfo *router_ifinfo;
-	struct batadv_gw_node *gw_node, *curr_gw = NULL;
-	u64 max_gw_factor = 0;
-	u64 tmp_gw_factor = 0;
-	u8 max_tq = 0;
+	struct batadv_neigh_node *router;
+	u64 gw_factor;
 	u8 tq_avg;
-	struct batadv_orig_node *orig_node;
-
-	rcu_read_lock();
-	hlist_for_each_entry_rcu(gw_node, &bat_priv->gw.gateway_list, list) {
-		orig_node = gw_node->orig_node;
-		router = batadv_orig_router_get(orig_node, BATADV_IF_DEFAULT);
-		if (!router)
-			continue;
 
-		router_ifinfo = batadv_neigh_ifinfo_get(router,
-							BATADV_IF_DEFAULT);
-		if (!router_ifinfo)
-			goto next;
-
-		if (!kref_get_unless_zero(&gw_node->refcount))
-			goto next;
-
-		tq_avg = router_ifinfo->bat_iv.tq_avg;
-
-		switch (atomic_read(&bat_priv->gw.sel_class)) {
-		case 1: /* fast connection */
-			tmp_gw_factor = tq_avg * tq_avg;
-			tmp_gw_factor *= gw_node->bandwidth_down;
-			tmp_gw_factor *= 100 * 100;
-			tmp_gw_factor >>= 18;
-
-			if (tmp_gw_factor > max_gw_factor ||
-			    (tmp_gw_factor == max_gw_factor &&
-			     tq_avg > max_tq)) {
-				if (curr_gw)
-					batadv_gw_node_put(curr_gw);
-				curr_gw = gw_node;
-				kref_get(&curr_gw->refcount);
-			}
-			break;
+	router = batadv_orig_router_get(gw_node->orig_node, BATADV_IF_DEFAULT);
+	if (!router)
+		return 0;
 
-		default: /* 2:  stable connection (use best statistic)
-			  * 3:  fast-switch (use best statistic but change as
-			  *     soon as a better gateway appears)
-			  * XX: late-switch (use best statistic but change as
-			  *     soon as a better gateway appears which has
-			  *     $routing_class more tq points)
-			  */
-			if (tq_avg > max_tq) {
-				if (curr_gw)
-					batadv_gw_node_put(curr_gw);
-				curr_gw = gw_node;
-				kref_get(&curr_gw->refcount);
-			}
-			break;
-		}
+	router_ifinfo = batadv_neigh_ifinfo_get(router, BATADV_IF_DEFAULT);
+	batadv_neigh_node_put(router);
+	if (!router_ifinfo)
+		return 0;
 
-		if (tq_avg > max_tq)
-			max_tq = tq_avg;
+	tq_avg = router_ifinfo->bat_iv.tq_avg;
+	batadv_neigh_ifinfo_put(router_ifinfo);
 
-		if (tmp_gw_factor > max_gw_factor)
-			max_gw_factor = tmp_gw_factor;
+	switch (atomic_read(&bat_priv->gw.sel_class)) {
+	case 1: /* fast connection */
+		gw_factor = tq_avg * tq_avg;
+		gw_factor *= gw_node->bandwidth_down;
+		gw_factor *= 100 * 100;
+		gw_factor >>= 18;
 
-		batadv_gw_node_put(gw_node);
+		return gw_factor << 8 | tq_avg;
 
-next:
-		batadv_neigh_node_put(router);
-		if (router_ifinfo)
-			batadv_neigh_ifinfo_put(router_ifinfo);
+	default: /* 2:  stable connection (use best statistic)
+		  * 3:  fast-switch (use best statistic but change as
+		  *     soon as a better gateway appears)
+		  * XX: late-switch (use best statistic but change as
+		  *     soon as a better gateway appears which has
+		  *     $routing_class more tq points)
+		  */
+		return tq_avg;
 	}
-	rcu_read_unlock();
-
-	return curr_gw;
 }
 
+/**
+ * batadv_iv_gw_is_eligible() - check if a GW node would replace the current GW
+ * @bat_priv: the bat priv with all the soft interface information
+ * @curr_gw: the currently selected GW
+ * @gw_node: the best ranked GW
+ *
+ * Return: true if gw_node can be selected as current GW, false otherwise
+ */
 static bool batadv_iv_gw_is_eligible(struct batadv_priv *bat_priv,
-				     struct batadv_orig_node *curr_gw_orig,
-				     struct batadv_orig_node *orig_node)
+				     struct batadv_gw_node *curr_gw,
+				     struct batadv_gw_node *gw_node)
 {
-	struct batadv_neigh_ifinfo *router_orig_ifinfo = NULL;
-	struct batadv_neigh_ifinfo *router_gw_ifinfo = NULL;
-	struct batadv_neigh_node *router_gw = NULL;
-	struct batadv_neigh_node *router_orig = NULL;
 	u8 gw_tq_avg, orig_tq_avg;
-	bool ret = false;
 
 	/* dynamic re-election is performed only on fast or late switch */
 	if (atomic_read(&bat_priv->gw.sel_class) <= 2)
 		return false;
 
-	router_gw = batadv_orig_router_get(curr_gw_orig, BATADV_IF_DEFAULT);
-	if (!router_gw) {
-		ret = true;
-		goto out;
-	}
+	/* the ranking of these classes is the TQ towards the gateway */
+	gw_tq_avg = READ_ONCE(curr_gw->metric);
+	if (gw_tq_avg == 0)
+		return true;
 
-	router_gw_ifinfo = batadv_neigh_ifinfo_get(router_gw,
-						   BATADV_IF_DEFAULT);
-	if (!router_gw_ifinfo) {
-		ret = true;
-		goto out;
-	}
-
-	router_orig = batadv_orig_router_get(orig_node, BATADV_IF_DEFAULT);
-	if (!router_orig)
-		goto out;
-
-	router_orig_ifinfo = batadv_neigh_ifinfo_get(router_orig,
-						     BATADV_IF_DEFAULT);
-	if (!router_orig_ifinfo)
-		goto out;
-
-	gw_tq_avg = router_gw_ifinfo->bat_iv.tq_avg;
-	orig_tq_avg = router_orig_ifinfo->bat_iv.tq_avg;
+	orig_tq_avg = READ_ONCE(gw_node->metric);
 
 	/* the TQ value has to be better */
 	if (orig_tq_avg < gw_tq_avg)
-		goto out;
+		return false;
 
 	/* if the routing class is greater than 3 the value tells us how much
 	 * greater the TQ value of the new gateway must be
 	 */
 	if ((atomic_read(&bat_priv->gw.sel_class) > 3) &&
 	    (orig_tq_avg - gw_tq_avg < atomic_read(&bat_priv->gw.sel_class)))
-		goto out;
+		return false;
 
 	batadv_dbg(BATADV_DBG_BATMAN, bat_priv,
 		   "Restarting gateway selection: better gateway found (tq curr: %i, tq new: %i)\n",
 		   gw_tq_avg, orig_tq_avg);
 
-	ret = true;
-out:
-	if (router_gw_ifinfo)
-		batadv_neigh_ifinfo_put(router_gw_ifinfo);
-	if (router_orig_ifinfo)
-		batadv_neigh_ifinfo_put(router_orig_ifinfo);
-	if (router_gw)
-		batadv_neigh_node_put(router_gw);
-	if (router_orig)
-		batadv_neigh_node_put(router_orig);
-
-	return ret;
+	return true;
 }
 
 #ifdef CONFIG_BATMAN_ADV_DEBUGFS
@@ -2830,10 +2977,12 @@ static struct batadv_algo_ops batadv_batman_iv __read_mostly = {
 		.disable = batadv_iv_ogm_iface_disable,
 		.update_mac = batadv_iv_ogm_iface_update_mac,
 		.primary_set = batadv_iv_ogm_primary_iface_set,
+		.ogm_rearm = batadv_iv_ogm_rearm,
 	},
 	.neigh = {
 		.cmp = batadv_iv_ogm_neigh_cmp,
 		.is_similar_or_better = batadv_iv_ogm_neigh_is_sob,
+		.metric = batadv_iv_ogm_neigh_metric,
 #ifdef CONFIG_BATMAN_ADV_DEBUGFS
 		.print = batadv_iv_neigh_print,
 #endif
@@ -2845,12 +2994,11 @@ static struct batadv_algo_ops batadv_batman_iv __read_mostly = {
 #endif
 		.dump = batadv_iv_ogm_orig_dump,
 		.free = batadv_iv_ogm_orig_free,
-		.add_if = batadv_iv_ogm_orig_add_if,
-		.del_if = batadv_iv_ogm_orig_del_if,
+		.get = batadv_iv_ogm_orig_get,
 	},
 	.gw = {
 		.init_sel_class = batadv_iv_init_sel_class,
-		.get_best_gw_node = batadv_iv_gw_get_best_gw_node,
+		.metric = batadv_iv_gw_metric,
 		.is_eligible = batadv_iv_gw_is_eligible,
 #ifdef CONFIG_BATMAN_ADV_DEBUGFS
 		.print = batadv_iv_gw_print,
@@ -2859,6 +3007,28 @@ static struct batadv_algo_ops batadv_batman_iv __read_mostly = {
 	},
 };
 
+/**
+ * batadv_iv_mesh_init() - initialize the B.A.T.M.A.N. IV private resources for
+ *  a mesh
+ * @bat_priv: the object representing the mesh interface to initialise
+ */
+void batadv_iv_mesh_init(struct batadv_priv *bat_priv)
+{
+	ida_init(&bat_priv->bat_iv.own_slot_ida);
+	bat_priv->bat_iv.own_chunks = 0;
+	spin_lock_init(&bat_priv->bat_iv.own_slots_lock);
+}
+
+/**
+ * batadv_iv_mesh_free() - free the B.A.T.M.A.N. IV private resources for a
+ *  mesh
+ * @bat_priv: the object representing the mesh interface to free
+ */
+void batadv_iv_mesh_free(struct batadv_priv *bat_priv)
+{
+	ida_destroy(&bat_priv->bat_iv.own_slot_ida);
+}
+
 /**
  * batadv_iv_init() - B.A.T.M.A.N. IV initialization function
  *
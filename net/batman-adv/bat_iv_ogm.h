@@ -21,6 +21,10 @@
 
 #include "main.h"
 
+struct batadv_priv;
+
 int batadv_iv_init(void);
+void batadv_iv_mesh_init(struct batadv_priv *bat_priv);
+void batadv_iv_mesh_free(struct batadv_priv *bat_priv);
 
 #endif /* _NET_BATMAN_ADV_BAT_IV_OGM_H_ */
@@ -21,6 +21,7 @@
 
 #include <linux/atomic.h>
 #include <linux/cache.h>
+#include <linux/compiler.h>
 #include <linux/errno.h>
 #include <linux/if_ether.h>
 #include <linux/init.h>
@@ -32,6 +33,8 @@
 #include <linux/rculist.h>
 #include <linux/rcupdate.h>
 #include <linux/seq_file.h>
+#include <linux/skbuff.h>
+#include <linux/spinlock.h>
 #include <linux/stddef.h>
 #include <linux/types.h>
 #include <linux/workqueue.h>
@@ -90,6 +93,7 @@ static int batadv_v_iface_enable(struct batadv_hard_iface *hard_iface)
 
 static void batadv_v_iface_disable(struct batadv_hard_iface *hard_iface)
 {
+	batadv_v_ogm_iface_disable(hard_iface);
 	batadv_v_elp_iface_disable(hard_iface);
 }
 
@@ -125,6 +129,9 @@ static void
 batadv_v_hardif_neigh_init(struct batadv_hardif_neigh_node *hardif_neigh)
 {
 	ewma_throughput_init(&hardif_neigh->bat_v.throughput);
+	ewma_throughput_dev_init(&hardif_neigh->bat_v.throughput_dev);
+	ewma_throughput_init(&hardif_neigh->bat_v.tx_rate);
+	hardif_neigh->bat_v.capacity_time = jiffies;
 	INIT_WORK(&hardif_neigh->bat_v.metric_work,
 		  batadv_v_elp_throughput_metric_update);
 }
@@ -228,13 +235,15 @@ static int
 batadv_v_neigh_dump_neigh(struct sk_buff *msg, u32 portid, u32 seq,
 			  struct batadv_hardif_neigh_node *hardif_neigh)
 {
+	struct batadv_hardif_neigh_node_bat_v *bat_v = &hardif_neigh->bat_v;
 	void *hdr;
 	unsigned int last_seen_msecs;
-	u32 throughput;
+	u32 throughput, capacity;
 
 	last_seen_msecs = jiffies_to_msecs(jiffies - hardif_neigh->last_seen);
-	throughput = ewma_throughput_read(&hardif_neigh->bat_v.throughput);
+	throughput = ewma_throughput_read(&bat_v->throughput);
 	throughput = throughput * 100;
+	capacity = READ_ONCE(bat_v->capacity) * 100;
 
 	hdr = genlmsg_put(msg, portid, seq, &batadv_netlink_family, NLM_F_MULTI,
 			  BATADV_CMD_GET_NEIGHBORS);
@@ -247,7 +256,23 @@ batadv_v_neigh_dump_neigh(struct sk_buff *msg, u32 portid, u32 seq,
 			hardif_neigh->if_incoming->net_dev->ifindex) ||
 	    nla_put_u32(msg, BATADV_ATTR_LAST_SEEN_MSECS,
 			last_seen_msecs) ||
-	    nla_put_u32(msg, BATADV_ATTR_THROUGHPUT, throughput))
+	    nla_put_u32(msg, BATADV_ATTR_THROUGHPUT, throughput) ||
+	    nla_put_u64_64bit(msg, BATADV_ATTR_NEIGH_TX_BYTES,
+			      atomic64_read(&bat_v->tx_bytes),
+			      BATADV_ATTR_PAD) ||
+	    nla_put_u64_64bit(msg, BATADV_ATTR_NEIGH_TX_PACKETS,
+			      atomic64_read(&bat_v->tx_packets),
+			      BATADV_ATTR_PAD) ||
+	    nla_put_u64_64bit(msg, BATADV_ATTR_NEIGH_TX_DROPPED,
+			      atomic64_read(&bat_v->tx_dropped),
+			      BATADV_ATTR_PAD) ||
+	    nla_put_u32(msg, BATADV_ATTR_NEIGH_TX_RETRIES,
+			READ_ONCE(bat_v->tx_retries)) ||
+	    nla_put_u32(msg, BATADV_ATTR_NEIGH_TX_FAILED,
+			READ_ONCE(bat_v->tx_failed)) ||
+	    nla_put_u8(msg, BATADV_ATTR_NEIGH_UTILIZATION,
+		       READ_ONCE(bat_v->utilization)) ||
+	    nla_put_u32(msg, BATADV_ATTR_NEIGH_CAPACITY, capacity))
 		goto nla_put_failure;
 
 	genlmsg_end(msg, hdr);
@@ -371,10 +396,9 @@ static void batadv_v_orig_print(struct batadv_priv *bat_priv,
 	seq_puts(seq,
 		 "  Originator      last-seen ( throughput)           Nexthop [outgoingIF]:   Potential nexthops ...\n");
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-
+	for (i = 0; i < batadv_hash_size(hash); i++) {
 		rcu_read_lock();
+		head = batadv_hash_bucket_rcu(hash, i);
 		hlist_for_each_entry_rcu(orig_node, head, hash_entry) {
 			neigh_node = batadv_orig_router_get(orig_node,
 							    if_outgoing);
@@ -440,6 +464,7 @@ batadv_v_orig_dump_subentry(struct sk_buff *msg, u32 portid, u32 seq,
 	struct batadv_neigh_ifinfo *n_ifinfo;
 	unsigned int last_seen_msecs;
 	u32 throughput;
+	u16 path_mtu;
 	void *hdr;
 
 	n_ifinfo = batadv_neigh_ifinfo_get(neigh_node, if_outgoing);
@@ -474,6 +499,11 @@ batadv_v_orig_dump_subentry(struct sk_buff *msg, u32 portid, u32 seq,
 	if (best && nla_put_flag(msg, BATADV_ATTR_FLAG_BEST))
 		goto nla_put_failure;
 
+	path_mtu = READ_ONCE(orig_node->path_mtu);
+	if (best && path_mtu &&
+	    nla_put_u16(msg, BATADV_ATTR_PATH_MTU, path_mtu))
+		goto nla_put_failure;
+
 	genlmsg_end(msg, hdr);
 	return 0;
 
@@ -542,7 +572,8 @@ batadv_v_orig_dump_entry(struct sk_buff *msg, u32 portid, u32 seq,
  * @seq: Sequence number of netlink message
  * @bat_priv: The bat priv with all the soft interface information
  * @if_outgoing: Limit dump to entries with this outgoing interface
- * @head: Bucket to be dumped
+ * @hash: Hash table to dump
+ * @bucket: Index of the bucket to be dumped
  * @idx_s: Number of entries to be skipped
  * @sub: Number of sub entries to be skipped
  *
@@ -552,12 +583,15 @@ static int
 batadv_v_orig_dump_bucket(struct sk_buff *msg, u32 portid, u32 seq,
 			  struct batadv_priv *bat_priv,
 			  struct batadv_hard_iface *if_outgoing,
-			  struct hlist_head *head, int *idx_s, int *sub)
+			  struct batadv_hashtable *hash, u32 bucket,
+			  int *idx_s, int *sub)
 {
 	struct batadv_orig_node *orig_node;
+	struct hlist_head *head;
 	int idx = 0;
 
 	rcu_read_lock();
+	head = batadv_hash_bucket_rcu(hash, bucket);
 	hlist_for_each_entry_rcu(orig_node, head, hash_entry) {
 		if (idx++ < *idx_s)
 			continue;
@@ -589,24 +623,26 @@ batadv_v_orig_dump(struct sk_buff *msg, struct netlink_callback *cb,
 		   struct batadv_hard_iface *if_outgoing)
 {
 	struct batadv_hashtable *hash = bat_priv->orig_hash;
-	struct hlist_head *head;
 	int bucket = cb->args[0];
 	int idx = cb->args[1];
 	int sub = cb->args[2];
 	int portid = NETLINK_CB(cb->skb).portid;
+	int start = msg->len;
 
-	while (bucket < hash->size) {
-		head = &hash->table[bucket];
+	cb->seq = batadv_hash_generation(hash) << 1 | 1;
 
+	while (bucket < batadv_hash_size(hash)) {
 		if (batadv_v_orig_dump_bucket(msg, portid,
 					      cb->nlh->nlmsg_seq,
-					      bat_priv, if_outgoing, head, &idx,
-					      &sub))
+					      bat_priv, if_outgoing, hash,
+					      bucket, &idx, &sub))
 			break;
 
 		bucket++;
 	}
 
+	batadv_netlink_dump_check(msg, cb, start);
+
 	cb->args[0] = bucket;
 	cb->args[1] = idx;
 	cb->args[2] = sub;
@@ -642,8 +678,9 @@ static bool batadv_v_neigh_is_sob(struct batadv_neigh_node *neigh1,
 				  struct batadv_neigh_node *neigh2,
 				  struct batadv_hard_iface *if_outgoing2)
 {
+	struct batadv_hardif_neigh_node_bat_v *neigh_bat_v;
 	struct batadv_neigh_ifinfo *ifinfo1, *ifinfo2;
-	u32 threshold;
+	u32 threshold, deviation;
 	bool ret = false;
 
 	ifinfo1 = batadv_neigh_ifinfo_get(neigh1, if_outgoing1);
@@ -654,7 +691,14 @@ static bool batadv_v_neigh_is_sob(struct batadv_neigh_node *neigh1,
 	if (!ifinfo2)
 		goto err_ifinfo2;
 
-	threshold = ifinfo1->bat_v.throughput / 4;
+	/* neighbours within the noise of the link towards neigh1 are just as
+	 * good
+	 */
+	neigh_bat_v = &neigh1->hardif_neigh->bat_v;
+	deviation = ewma_throughput_dev_read(&neigh_bat_v->throughput_dev);
+
+	threshold = max(ifinfo1->bat_v.throughput / 4, deviation);
+	threshold = min(threshold, ifinfo1->bat_v.throughput);
 	threshold = ifinfo1->bat_v.throughput - threshold;
 
 	ret = ifinfo2->bat_v.throughput > threshold;
@@ -666,6 +710,29 @@ err_ifinfo1:
 	return ret;
 }
 
+/**
+ * batadv_v_neigh_metric() - get the throughput of the path via a neighbor
+ * @neigh: the neighbor object
+ * @if_outgoing: outgoing interface for the neighbor
+ *
+ * Return: the throughput via neigh or 0 if none is known
+ */
+static u32 batadv_v_neigh_metric(struct batadv_neigh_node *neigh,
+				 struct batadv_hard_iface *if_outgoing)
+{
+	struct batadv_neigh_ifinfo *neigh_ifinfo;
+	u32 metric;
+
+	neigh_ifinfo = batadv_neigh_ifinfo_get(neigh, if_outgoing);
+	if (!neigh_ifinfo)
+		return 0;
+
+	metric = neigh_ifinfo->bat_v.throughput;
+	batadv_neigh_ifinfo_put(neigh_ifinfo);
+
+	return metric;
+}
+
 /**
  * batadv_v_init_sel_class() - initialize GW selection class
  * @bat_priv: the bat priv with all the soft interface information
@@ -689,8 +756,10 @@ static ssize_t batadv_v_store_sel_class(struct batadv_priv *bat_priv,
 	old_class = atomic_read(&bat_priv->gw.sel_class);
 	atomic_set(&bat_priv->gw.sel_class, class);
 
-	if (old_class != class)
+	if (old_class != class) {
+		batadv_gw_rank_refresh(bat_priv);
 		batadv_gw_reselect(bat_priv);
+	}
 
 	return count;
 }
@@ -746,97 +815,55 @@ out:
 }
 
 /**
- * batadv_v_gw_get_best_gw_node() - retrieve the best GW node
+ * batadv_v_gw_metric() - compute the ranking of a GW node
  * @bat_priv: the bat priv with all the soft interface information
+ * @gw_node: the GW to compute the ranking for
  *
- * Return: the GW node having the best GW-metric, NULL if no GW is known
+ * Return: the GW-metric of gw_node, 0 if it cannot be reached
  */
-static struct batadv_gw_node *
-batadv_v_gw_get_best_gw_node(struct batadv_priv *bat_priv)
+static u64 batadv_v_gw_metric(struct batadv_priv *bat_priv,
+			      struct batadv_gw_node *gw_node)
 {
-	struct batadv_gw_node *gw_node, *curr_gw = NULL;
-	u32 max_bw = 0, bw;
-
-	rcu_read_lock();
-	hlist_for_each_entry_rcu(gw_node, &bat_priv->gw.gateway_list, list) {
-		if (!kref_get_unless_zero(&gw_node->refcount))
-			continue;
+	u32 bw;
 
-		if (batadv_v_gw_throughput_get(gw_node, &bw) < 0)
-			goto next;
-
-		if (curr_gw && bw <= max_bw)
-			goto next;
-
-		if (curr_gw)
-			batadv_gw_node_put(curr_gw);
-
-		curr_gw = gw_node;
-		kref_get(&curr_gw->refcount);
-		max_bw = bw;
-
-next:
-		batadv_gw_node_put(gw_node);
-	}
-	rcu_read_unlock();
+	if (batadv_v_gw_throughput_get(gw_node, &bw) < 0)
+		return 0;
 
-	return curr_gw;
+	return bw;
 }
 
 /**
- * batadv_v_gw_is_eligible() - check if a originator would be selected as GW
+ * batadv_v_gw_is_eligible() - check if a GW node would replace the current GW
  * @bat_priv: the bat priv with all the soft interface information
- * @curr_gw_orig: originator representing the currently selected GW
- * @orig_node: the originator representing the new candidate
+ * @curr_gw: the currently selected GW
+ * @gw_node: the best ranked GW
  *
- * Return: true if orig_node can be selected as current GW, false otherwise
+ * Return: true if gw_node can be selected as current GW, false otherwise
  */
 static bool batadv_v_gw_is_eligible(struct batadv_priv *bat_priv,
-				    struct batadv_orig_node *curr_gw_orig,
-				    struct batadv_orig_node *orig_node)
+				    struct batadv_gw_node *curr_gw,
+				    struct batadv_gw_node *gw_node)
 {
-	struct batadv_gw_node *curr_gw, *orig_gw = NULL;
 	u32 gw_throughput, orig_throughput, threshold;
-	bool ret = false;
 
 	threshold = atomic_read(&bat_priv->gw.sel_class);
 
-	curr_gw = batadv_gw_node_get(bat_priv, curr_gw_orig);
-	if (!curr_gw) {
-		ret = true;
-		goto out;
-	}
-
-	if (batadv_v_gw_throughput_get(curr_gw, &gw_throughput) < 0) {
-		ret = true;
-		goto out;
-	}
-
-	orig_gw = batadv_gw_node_get(bat_priv, orig_node);
-	if (!orig_gw)
-		goto out;
-
-	if (batadv_v_gw_throughput_get(orig_gw, &orig_throughput) < 0)
-		goto out;
+	gw_throughput = READ_ONCE(curr_gw->metric);
+	if (gw_throughput == 0)
+		return true;
 
+	orig_throughput = READ_ONCE(gw_node->metric);
 	if (orig_throughput < gw_throughput)
-		goto out;
+		return false;
 
 	if ((orig_throughput - gw_throughput) < threshold)
-		goto out;
+		return false;
 
 	batadv_dbg(BATADV_DBG_BATMAN, bat_priv,
 		   "Restarting gateway selection: better gateway found (throughput curr: %u, throughput new: %u)\n",
 		   gw_throughput, orig_throughput);
 
-	ret = true;
-out:
-	if (curr_gw)
-		batadv_gw_node_put(curr_gw);
-	if (orig_gw)
-		batadv_gw_node_put(orig_gw);
-
-	return ret;
+	return true;
 }
 
 #ifdef CONFIG_BATMAN_ADV_DEBUGFS
@@ -1045,11 +1072,13 @@ static struct batadv_algo_ops batadv_batman_v __read_mostly = {
 		.disable = batadv_v_iface_disable,
 		.update_mac = batadv_v_iface_update_mac,
 		.primary_set = batadv_v_primary_iface_set,
+		.ogm_rearm = batadv_v_ogm_rearm,
 	},
 	.neigh = {
 		.hardif_init = batadv_v_hardif_neigh_init,
 		.cmp = batadv_v_neigh_cmp,
 		.is_similar_or_better = batadv_v_neigh_is_sob,
+		.metric = batadv_v_neigh_metric,
 #ifdef CONFIG_BATMAN_ADV_DEBUGFS
 		.print = batadv_v_neigh_print,
 #endif
@@ -1060,12 +1089,13 @@ static struct batadv_algo_ops batadv_batman_v __read_mostly = {
 		.print = batadv_v_orig_print,
 #endif
 		.dump = batadv_v_orig_dump,
+		.get = batadv_v_ogm_orig_get,
 	},
 	.gw = {
 		.init_sel_class = batadv_v_init_sel_class,
 		.store_sel_class = batadv_v_store_sel_class,
 		.show_sel_class = batadv_v_show_sel_class,
-		.get_best_gw_node = batadv_v_gw_get_best_gw_node,
+		.metric = batadv_v_gw_metric,
 		.is_eligible = batadv_v_gw_is_eligible,
 #ifdef CONFIG_BATMAN_ADV_DEBUGFS
 		.print = batadv_v_gw_print,
@@ -1086,6 +1116,12 @@ void batadv_v_hardif_init(struct batadv_hard_iface *hard_iface)
 	 */
 	atomic_set(&hard_iface->bat_v.throughput_override, 0);
 	atomic_set(&hard_iface->bat_v.elp_interval, 500);
+
+	hard_iface->bat_v.aggr_len = 0;
+	skb_queue_head_init(&hard_iface->bat_v.aggr_list);
+	spin_lock_init(&hard_iface->bat_v.aggr_list_lock);
+	INIT_DELAYED_WORK(&hard_iface->bat_v.aggr_wq,
+			  batadv_v_ogm_aggr_work);
 }
 
 /**
@@ -22,6 +22,7 @@
 #include <linux/atomic.h>
 #include <linux/bitops.h>
 #include <linux/byteorder/generic.h>
+#include <linux/compiler.h>
 #include <linux/errno.h>
 #include <linux/etherdevice.h>
 #include <linux/ethtool.h>
@@ -30,6 +31,7 @@
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
 #include <linux/kref.h>
+#include <linux/math64.h>
 #include <linux/netdevice.h>
 #include <linux/nl80211.h>
 #include <linux/random.h>
@@ -58,15 +60,93 @@
  */
 static void batadv_v_elp_start_timer(struct batadv_hard_iface *hard_iface)
 {
+	struct batadv_priv *bat_priv = netdev_priv(hard_iface->soft_iface);
 	unsigned int msecs;
 
 	msecs = atomic_read(&hard_iface->bat_v.elp_interval) - BATADV_JITTER;
 	msecs += prandom_u32() % (2 * BATADV_JITTER);
 
-	queue_delayed_work(batadv_event_workqueue, &hard_iface->bat_v.elp_wq,
+	hard_iface->bat_v.elp_due = jiffies + msecs_to_jiffies(msecs);
+	queue_delayed_work(bat_priv->ctrl_wq, &hard_iface->bat_v.elp_wq,
 			   msecs_to_jiffies(msecs));
 }
 
+/**
+ * batadv_v_elp_get_link_throughput() - get the throughput of a wired link
+ * @hard_iface: the interface to query via ethtool
+ *
+ * The link settings are the same for all neighbours of an interface. They are
+ * therefore only queried (under rtnl) once per ELP interval and shared by the
+ * metric updates of all neighbours of this interface.
+ *
+ * Return: The throughput of the link in multiples of 100kpbs or 0 if the
+ * device provides no usable link settings.
+ */
+static u32
+batadv_v_elp_get_link_throughput(struct batadv_hard_iface *hard_iface)
+{
+	struct batadv_hard_iface_bat_v *bat_v = &hard_iface->bat_v;
+	struct ethtool_link_ksettings link_settings;
+	u32 interval = atomic_read(&bat_v->elp_interval);
+	u32 throughput = 0;
+	int ret;
+
+	if (READ_ONCE(bat_v->link_valid)) {
+		smp_rmb(); /* read link_valid before the cached values */
+		if (!batadv_has_timed_out(READ_ONCE(bat_v->link_updated),
+					  interval))
+			return READ_ONCE(bat_v->link_throughput);
+	}
+
+	memset(&link_settings, 0, sizeof(link_settings));
+	rtnl_lock();
+
+	/* another neighbour may have refreshed it while waiting for rtnl */
+	if (bat_v->link_valid &&
+	    !batadv_has_timed_out(bat_v->link_updated, interval)) {
+		throughput = bat_v->link_throughput;
+		goto unlock;
+	}
+
+	ret = __ethtool_get_link_ksettings(hard_iface->net_dev, &link_settings);
+
+	/* Virtual interface drivers such as tun / tap interfaces, VLAN, etc
+	 * tend to initialize the interface throughput with some value for the
+	 * sake of having a throughput number to export via ethtool. This
+	 * exported throughput leaves batman-adv to conclude the interface
+	 * throughput is genuine (reflecting reality), thus no measurements
+	 * are necessary.
+	 *
+	 * Based on the observation that those interface types also tend to set
+	 * the link auto-negotiation to 'off', batman-adv shall check this
+	 * setting to differentiate between genuine link throughput information
+	 * and placeholders installed by virtual interfaces.
+	 */
+	if (ret == 0 && link_settings.base.autoneg == AUTONEG_ENABLE) {
+		/* link characteristics might change over time */
+		if (link_settings.base.duplex == DUPLEX_FULL)
+			bat_v->flags |= BATADV_FULL_DUPLEX;
+		else
+			bat_v->flags &= ~BATADV_FULL_DUPLEX;
+
+		throughput = link_settings.base.speed;
+		if (throughput && throughput != SPEED_UNKNOWN)
+			throughput *= 10;
+		else
+			throughput = 0;
+	}
+
+	WRITE_ONCE(bat_v->link_throughput, throughput);
+	WRITE_ONCE(bat_v->link_updated, jiffies);
+	smp_wmb(); /* publish the cached values before link_valid */
+	WRITE_ONCE(bat_v->link_valid, true);
+
+unlock:
+	rtnl_unlock();
+
+	return throughput;
+}
+
 /**
  * batadv_v_elp_get_throughput() - get the throughput towards a neighbour
  * @neigh: the neighbour for which the throughput has to be obtained
@@ -77,7 +157,6 @@ static void batadv_v_elp_start_timer(struct batadv_hard_iface *hard_iface)
 static u32 batadv_v_elp_get_throughput(struct batadv_hardif_neigh_node *neigh)
 {
 	struct batadv_hard_iface *hard_iface = neigh->if_incoming;
-	struct ethtool_link_ksettings link_settings;
 	struct net_device *real_netdev;
 	struct station_info sinfo;
 	u32 throughput;
@@ -114,6 +193,13 @@ static u32 batadv_v_elp_get_throughput(struct batadv_hardif_neigh_node *neigh)
 		}
 		if (ret)
 			goto default_throughput;
+
+		/* retransmissions hint at a link operating at its limit */
+		if (sinfo.filled & BIT(NL80211_STA_INFO_TX_RETRIES))
+			WRITE_ONCE(neigh->bat_v.tx_retries, sinfo.tx_retries);
+		if (sinfo.filled & BIT(NL80211_STA_INFO_TX_FAILED))
+			WRITE_ONCE(neigh->bat_v.tx_failed, sinfo.tx_failed);
+
 		if (!(sinfo.filled & BIT(NL80211_STA_INFO_EXPECTED_THROUGHPUT)))
 			goto default_throughput;
 
@@ -123,34 +209,9 @@ static u32 batadv_v_elp_get_throughput(struct batadv_hardif_neigh_node *neigh)
 	/* if not a wifi interface, check if this device provides data via
 	 * ethtool (e.g. an Ethernet adapter)
 	 */
-	memset(&link_settings, 0, sizeof(link_settings));
-	rtnl_lock();
-	ret = __ethtool_get_link_ksettings(hard_iface->net_dev, &link_settings);
-	rtnl_unlock();
-
-	/* Virtual interface drivers such as tun / tap interfaces, VLAN, etc
-	 * tend to initialize the interface throughput with some value for the
-	 * sake of having a throughput number to export via ethtool. This
-	 * exported throughput leaves batman-adv to conclude the interface
-	 * throughput is genuine (reflecting reality), thus no measurements
-	 * are necessary.
-	 *
-	 * Based on the observation that those interface types also tend to set
-	 * the link auto-negotiation to 'off', batman-adv shall check this
-	 * setting to differentiate between genuine link throughput information
-	 * and placeholders installed by virtual interfaces.
-	 */
-	if (ret == 0 && link_settings.base.autoneg == AUTONEG_ENABLE) {
-		/* link characteristics might change over time */
-		if (link_settings.base.duplex == DUPLEX_FULL)
-			hard_iface->bat_v.flags |= BATADV_FULL_DUPLEX;
-		else
-			hard_iface->bat_v.flags &= ~BATADV_FULL_DUPLEX;
-
-		throughput = link_settings.base.speed;
-		if (throughput && throughput != SPEED_UNKNOWN)
-			return throughput * 10;
-	}
+	throughput = batadv_v_elp_get_link_throughput(hard_iface);
+	if (throughput)
+		return throughput;
 
 default_throughput:
 	if (!(hard_iface->bat_v.flags & BATADV_WARNING_DEFAULT)) {
@@ -166,6 +227,76 @@ default_throughput:
 	return BATADV_THROUGHPUT_DEFAULT_VALUE;
 }
 
+/**
+ * batadv_v_elp_capacity_update() - estimate the capacity left over on the link
+ *  towards a single hop neighbour
+ * @neigh: the neighbour to update
+ * @throughput: the current link throughput towards the neighbour (in multiples
+ *  of 100kbps)
+ *
+ * The estimation is based on the unicast traffic which was actually forwarded
+ * to the neighbour since the previous update and therefore does not need any
+ * additional probe traffic.
+ */
+static void
+batadv_v_elp_capacity_update(struct batadv_hardif_neigh_node *neigh,
+			     u32 throughput)
+{
+	struct batadv_hardif_neigh_node_bat_v *bat_v = &neigh->bat_v;
+	unsigned long now = jiffies;
+	unsigned int msecs;
+	u32 utilization = 0;
+	u64 bytes, rate;
+
+	msecs = jiffies_to_msecs(now - bat_v->capacity_time);
+	if (!msecs)
+		return;
+
+	/* bytes per millisecond * 8 equals kbps */
+	bytes = atomic64_read(&bat_v->tx_bytes);
+	rate = div64_u64((bytes - bat_v->capacity_bytes) * 8, (u64)msecs * 100);
+	bat_v->capacity_bytes = bytes;
+	bat_v->capacity_time = now;
+
+	ewma_throughput_add(&bat_v->tx_rate, min_t(u64, rate, U32_MAX));
+	rate = min_t(u64, ewma_throughput_read(&bat_v->tx_rate), throughput);
+
+	if (throughput)
+		utilization = div_u64(rate * 100, throughput);
+
+	WRITE_ONCE(bat_v->utilization, utilization);
+	WRITE_ONCE(bat_v->capacity, throughput - rate);
+}
+
+/**
+ * batadv_v_elp_link_throughput() - get the link throughput towards a neighbour
+ *  as advertised by BATMAN V
+ * @bat_priv: the bat priv with all the soft interface information
+ * @neigh: the neighbour for which the throughput has to be obtained
+ *
+ * With passive_capacity enabled only the throughput left over by the traffic
+ * forwarded to this neighbour is advertised. It never drops below
+ * BATADV_CAPACITY_MIN_SHARE percent of the link throughput to keep the routes
+ * from oscillating between links which only look saturated by their own
+ * traffic.
+ *
+ * Return: The link throughput in multiples of 100kbps.
+ */
+u32 batadv_v_elp_link_throughput(struct batadv_priv *bat_priv,
+				 struct batadv_hardif_neigh_node *neigh)
+{
+	u32 throughput = ewma_throughput_read(&neigh->bat_v.throughput);
+	u32 min_throughput;
+
+	if (!atomic_read(&bat_priv->passive_capacity))
+		return throughput;
+
+	min_throughput = div_u64((u64)throughput * BATADV_CAPACITY_MIN_SHARE,
+				 100);
+
+	return max_t(u32, READ_ONCE(neigh->bat_v.capacity), min_throughput);
+}
+
 /**
  * batadv_v_elp_throughput_metric_update() - worker updating the throughput
  *  metric of a single hop neighbour
@@ -175,14 +306,28 @@ void batadv_v_elp_throughput_metric_update(struct work_struct *work)
 {
 	struct batadv_hardif_neigh_node_bat_v *neigh_bat_v;
 	struct batadv_hardif_neigh_node *neigh;
+	u32 throughput, mean;
 
 	neigh_bat_v = container_of(work, struct batadv_hardif_neigh_node_bat_v,
 				   metric_work);
 	neigh = container_of(neigh_bat_v, struct batadv_hardif_neigh_node,
 			     bat_v);
 
-	ewma_throughput_add(&neigh->bat_v.throughput,
-			    batadv_v_elp_get_throughput(neigh));
+	throughput = batadv_v_elp_get_throughput(neigh);
+
+	/* track how far the samples scatter around the mean, starting with the
+	 * second sample (the first one is the mean)
+	 */
+	mean = ewma_throughput_read(&neigh->bat_v.throughput);
+	if (mean)
+		ewma_throughput_dev_add(&neigh->bat_v.throughput_dev,
+					max(throughput, mean) -
+					min(throughput, mean));
+
+	ewma_throughput_add(&neigh->bat_v.throughput, throughput);
+
+	mean = ewma_throughput_read(&neigh->bat_v.throughput);
+	batadv_v_elp_capacity_update(neigh, mean);
 
 	/* decrement refcounter to balance increment performed before scheduling
 	 * this task
@@ -199,6 +344,10 @@ void batadv_v_elp_throughput_metric_update(struct work_struct *work)
  * Packets are sent only if there there is not enough payload unicast traffic
  * towards this neighbour..
  *
+ * The probes only differ in their destination, so each of them is a plain copy
+ * of the prepared elp_probe_skb which already has its final size and enough
+ * headroom to not be reallocated again on transmission.
+ *
  * Return: True on success and false in case of error during skb preparation.
  */
 static bool
@@ -208,8 +357,7 @@ batadv_v_elp_wifi_neigh_probe(struct batadv_hardif_neigh_node *neigh)
 	struct batadv_priv *bat_priv = netdev_priv(hard_iface->soft_iface);
 	unsigned long last_tx_diff;
 	struct sk_buff *skb;
-	int probe_len, i;
-	int elp_skb_len;
+	int i;
 
 	/* this probing routine is for Wifi neighbours only */
 	if (!batadv_is_wifi_hardif(hard_iface))
@@ -226,23 +374,11 @@ batadv_v_elp_wifi_neigh_probe(struct batadv_hardif_neigh_node *neigh)
 	if (last_tx_diff <= BATADV_ELP_PROBE_MAX_TX_DIFF)
 		return true;
 
-	probe_len = max_t(int, sizeof(struct batadv_elp_packet),
-			  BATADV_ELP_MIN_PROBE_SIZE);
-
 	for (i = 0; i < BATADV_ELP_PROBES_PER_NODE; i++) {
-		elp_skb_len = hard_iface->bat_v.elp_skb->len;
-		skb = skb_copy_expand(hard_iface->bat_v.elp_skb, 0,
-				      probe_len - elp_skb_len,
-				      GFP_ATOMIC);
+		skb = skb_copy(hard_iface->bat_v.elp_probe_skb, GFP_ATOMIC);
 		if (!skb)
 			return false;
 
-		/* Tell the skb to get as big as the allocated space (we want
-		 * the packet to be exactly of that size to make the link
-		 * throughput estimation effective.
-		 */
-		skb_put(skb, probe_len - hard_iface->bat_v.elp_skb->len);
-
 		batadv_dbg(BATADV_DBG_BATMAN, bat_priv,
 			   "Sending unicast (probe) ELP packet on interface %s to %pM\n",
 			   hard_iface->net_dev->name, neigh->addr);
@@ -285,6 +421,8 @@ static void batadv_v_elp_periodic_work(struct work_struct *work)
 	if (hard_iface->if_status != BATADV_IF_ACTIVE)
 		goto restart_timer;
 
+	batadv_send_delay_add(bat_priv, BATADV_CNT_CTRL_DELAY, bat_v->elp_due);
+
 	skb = skb_copy(hard_iface->bat_v.elp_skb, GFP_ATOMIC);
 	if (!skb)
 		goto restart_timer;
@@ -327,10 +465,14 @@ static void batadv_v_elp_periodic_work(struct work_struct *work)
 
 		/* Reading the estimated throughput from cfg80211 is a task that
 		 * may sleep and that is not allowed in an rcu protected
-		 * context. Therefore schedule a task for that.
+		 * context. Therefore schedule a task for that. It runs on its
+		 * own queue to not stall the periodic tasks of the mesh while a
+		 * driver is slow to answer. An update which is still pending
+		 * already holds a reference.
 		 */
-		queue_work(batadv_event_workqueue,
-			   &hardif_neigh->bat_v.metric_work);
+		if (!queue_work(bat_priv->metric_wq,
+				&hardif_neigh->bat_v.metric_work))
+			batadv_hardif_neigh_put(hardif_neigh);
 	}
 	rcu_read_unlock();
 
@@ -350,7 +492,9 @@ int batadv_v_elp_iface_enable(struct batadv_hard_iface *hard_iface)
 {
 	struct batadv_elp_packet *elp_packet;
 	unsigned char *elp_buff;
+	unsigned int headroom;
 	u32 random_seqno;
+	size_t probe_len;
 	size_t size;
 	int res = -ENOMEM;
 
@@ -366,10 +510,27 @@ int batadv_v_elp_iface_enable(struct batadv_hard_iface *hard_iface)
 	elp_packet->packet_type = BATADV_ELP;
 	elp_packet->version = BATADV_COMPAT_VERSION;
 
+	/* The probes are padded to exactly this size to make the link
+	 * throughput estimation effective
+	 */
+	probe_len = max_t(size_t, BATADV_ELP_HLEN, BATADV_ELP_MIN_PROBE_SIZE);
+	headroom = ETH_HLEN + NET_IP_ALIGN;
+	headroom += hard_iface->net_dev->needed_headroom;
+	hard_iface->bat_v.elp_probe_skb = dev_alloc_skb(headroom + probe_len);
+	if (!hard_iface->bat_v.elp_probe_skb)
+		goto free_elp_skb;
+
+	skb_reserve(hard_iface->bat_v.elp_probe_skb, headroom);
+	elp_buff = skb_put_zero(hard_iface->bat_v.elp_probe_skb, probe_len);
+	memcpy(elp_buff, elp_packet, BATADV_ELP_HLEN);
+
 	/* randomize initial seqno to avoid collision */
 	get_random_bytes(&random_seqno, sizeof(random_seqno));
 	atomic_set(&hard_iface->bat_v.elp_seqno, random_seqno);
 
+	/* query the link settings again on the next metric update */
+	hard_iface->bat_v.link_valid = false;
+
 	/* assume full-duplex by default */
 	hard_iface->bat_v.flags |= BATADV_FULL_DUPLEX;
 
@@ -383,7 +544,11 @@ int batadv_v_elp_iface_enable(struct batadv_hard_iface *hard_iface)
 			  batadv_v_elp_periodic_work);
 	batadv_v_elp_start_timer(hard_iface);
 	res = 0;
+	goto out;
 
+free_elp_skb:
+	dev_kfree_skb(hard_iface->bat_v.elp_skb);
+	hard_iface->bat_v.elp_skb = NULL;
 out:
 	return res;
 }
@@ -398,6 +563,9 @@ void batadv_v_elp_iface_disable(struct batadv_hard_iface *hard_iface)
 
 	dev_kfree_skb(hard_iface->bat_v.elp_skb);
 	hard_iface->bat_v.elp_skb = NULL;
+
+	dev_kfree_skb(hard_iface->bat_v.elp_probe_skb);
+	hard_iface->bat_v.elp_probe_skb = NULL;
 }
 
 /**
@@ -419,6 +587,11 @@ void batadv_v_elp_iface_activate(struct batadv_hard_iface *primary_iface,
 	elp_packet = (struct batadv_elp_packet *)skb->data;
 	ether_addr_copy(elp_packet->orig,
 			primary_iface->net_dev->dev_addr);
+
+	skb = hard_iface->bat_v.elp_probe_skb;
+	elp_packet = (struct batadv_elp_packet *)skb->data;
+	ether_addr_copy(elp_packet->orig,
+			primary_iface->net_dev->dev_addr);
 }
 
 /**
@@ -21,6 +21,8 @@
 
 #include "main.h"
 
+#include <linux/types.h>
+
 struct sk_buff;
 struct work_struct;
 
@@ -32,5 +34,7 @@ void batadv_v_elp_primary_iface_set(struct batadv_hard_iface *primary_iface);
 int batadv_v_elp_packet_recv(struct sk_buff *skb,
 			     struct batadv_hard_iface *if_incoming);
 void batadv_v_elp_throughput_metric_update(struct work_struct *work);
+u32 batadv_v_elp_link_throughput(struct batadv_priv *bat_priv,
+				 struct batadv_hardif_neigh_node *neigh);
 
 #endif /* _NET_BATMAN_ADV_BAT_V_ELP_H_ */
@@ -21,6 +21,7 @@
 
 #include <linux/atomic.h>
 #include <linux/byteorder/generic.h>
+#include <linux/compiler.h>
 #include <linux/errno.h>
 #include <linux/etherdevice.h>
 #include <linux/gfp.h>
@@ -29,12 +30,14 @@
 #include <linux/kernel.h>
 #include <linux/kref.h>
 #include <linux/list.h>
+#include <linux/lockdep.h>
 #include <linux/netdevice.h>
 #include <linux/random.h>
 #include <linux/rculist.h>
 #include <linux/rcupdate.h>
 #include <linux/skbuff.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/stddef.h>
 #include <linux/string.h>
 #include <linux/types.h>
@@ -42,12 +45,16 @@
 #include <uapi/linux/batadv_packet.h>
 
 #include "bat_algo.h"
+#include "bat_v_elp.h"
+#include "fragmentation.h"
 #include "hard-interface.h"
 #include "hash.h"
 #include "log.h"
+#include "netlink.h"
 #include "originator.h"
 #include "routing.h"
 #include "send.h"
+#include "trace.h"
 #include "translation-table.h"
 #include "tvlv.h"
 
@@ -82,9 +89,13 @@ struct batadv_orig_node *batadv_v_ogm_orig_get(struct batadv_priv *bat_priv,
 		/* remove refcnt for newly created orig_node and hash entry */
 		batadv_orig_node_put(orig_node);
 		batadv_orig_node_put(orig_node);
-		orig_node = NULL;
+		return NULL;
 	}
 
+	batadv_orig_dat_ring_schedule(bat_priv);
+	batadv_netlink_notify_orig(bat_priv, BATADV_EVENT_ORIG_ADD,
+				   orig_node->orig, NULL);
+
 	return orig_node;
 }
 
@@ -101,12 +112,43 @@ static void batadv_v_ogm_start_timer(struct batadv_priv *bat_priv)
 	if (delayed_work_pending(&bat_priv->bat_v.ogm_wq))
 		return;
 
-	msecs = atomic_read(&bat_priv->orig_interval) - BATADV_JITTER;
+	msecs = batadv_ogm_interval(bat_priv, &bat_priv->bat_v.ogm_backoff);
+	msecs -= BATADV_JITTER;
 	msecs += prandom_u32() % (2 * BATADV_JITTER);
-	queue_delayed_work(batadv_event_workqueue, &bat_priv->bat_v.ogm_wq,
+	bat_priv->bat_v.ogm_due = jiffies + msecs_to_jiffies(msecs);
+	queue_delayed_work(bat_priv->ctrl_wq, &bat_priv->bat_v.ogm_wq,
 			   msecs_to_jiffies(msecs));
 }
 
+/**
+ * batadv_v_ogm_rearm() - send the next OGM within orig_interval
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * The OGM timer is only pulled in when it is running. batadv_v_ogm_free()
+ * waits for an RCU grace period after the mesh was deactivated, the timer is
+ * therefore never restarted after it was cancelled.
+ */
+void batadv_v_ogm_rearm(struct batadv_priv *bat_priv)
+{
+	unsigned int msecs = atomic_read(&bat_priv->orig_interval);
+	unsigned long delay = msecs_to_jiffies(msecs);
+
+	rcu_read_lock();
+	if (atomic_read(&bat_priv->mesh_state) != BATADV_MESH_ACTIVE)
+		goto unlock;
+
+	if (!delayed_work_pending(&bat_priv->bat_v.ogm_wq))
+		goto unlock;
+
+	if (!time_after(READ_ONCE(bat_priv->bat_v.ogm_due), jiffies + delay))
+		goto unlock;
+
+	WRITE_ONCE(bat_priv->bat_v.ogm_due, jiffies + delay);
+	mod_delayed_work(bat_priv->ctrl_wq, &bat_priv->bat_v.ogm_wq, delay);
+unlock:
+	rcu_read_unlock();
+}
+
 /**
  * batadv_v_ogm_send_to_if() - send a batman ogm using a given interface
  * @skb: the OGM to send
@@ -127,6 +169,129 @@ static void batadv_v_ogm_send_to_if(struct sk_buff *skb,
 	batadv_send_broadcast_skb(skb, hard_iface);
 }
 
+/**
+ * batadv_v_ogm_len() - OGMv2 packet length
+ * @skb: the OGM to check
+ *
+ * Return: Length of the given OGMv2 packet, including tvlv length, excluding
+ * ethernet header length.
+ */
+static unsigned int batadv_v_ogm_len(struct sk_buff *skb)
+{
+	struct batadv_ogm2_packet *ogm_packet;
+
+	ogm_packet = (struct batadv_ogm2_packet *)skb->data;
+	return BATADV_OGM2_HLEN + ntohs(ogm_packet->tvlv_len);
+}
+
+/**
+ * batadv_v_ogm_queue_left() - check if given OGM still fits aggregation queue
+ * @skb: the OGM to check
+ * @hard_iface: the interface to use to send the OGM
+ *
+ * Caller needs to hold the hard_iface->bat_v.aggr_list_lock.
+ *
+ * Return: True, if the given OGMv2 packet still fits, false otherwise.
+ */
+static bool batadv_v_ogm_queue_left(struct sk_buff *skb,
+				    struct batadv_hard_iface *hard_iface)
+{
+	unsigned int max = min_t(unsigned int, hard_iface->net_dev->mtu,
+				 BATADV_MAX_AGGREGATION_BYTES);
+	unsigned int ogm_len = batadv_v_ogm_len(skb);
+
+	lockdep_assert_held(&hard_iface->bat_v.aggr_list_lock);
+
+	return hard_iface->bat_v.aggr_len + ogm_len <= max;
+}
+
+/**
+ * batadv_v_ogm_aggr_list_free() - free all elements in an aggregation queue
+ * @hard_iface: the interface holding the aggregation queue
+ *
+ * Empties the OGMv2 aggregation queue and frees all the skbs it contains.
+ *
+ * Caller needs to hold the hard_iface->bat_v.aggr_list_lock.
+ */
+static void batadv_v_ogm_aggr_list_free(struct batadv_hard_iface *hard_iface)
+{
+	lockdep_assert_held(&hard_iface->bat_v.aggr_list_lock);
+
+	__skb_queue_purge(&hard_iface->bat_v.aggr_list);
+	hard_iface->bat_v.aggr_len = 0;
+}
+
+/**
+ * batadv_v_ogm_aggr_send() - flush & send aggregation queue
+ * @hard_iface: the interface with the aggregation queue to flush
+ *
+ * Aggregates all OGMv2 packets currently in the aggregation queue into a
+ * single OGMv2 packet and transmits this aggregate.
+ *
+ * The aggregation queue is empty after this call.
+ *
+ * Caller needs to hold the hard_iface->bat_v.aggr_list_lock.
+ */
+static void batadv_v_ogm_aggr_send(struct batadv_hard_iface *hard_iface)
+{
+	unsigned int aggr_len = hard_iface->bat_v.aggr_len;
+	struct sk_buff *skb_aggr;
+	unsigned int ogm_len;
+	struct sk_buff *skb;
+
+	lockdep_assert_held(&hard_iface->bat_v.aggr_list_lock);
+
+	if (!aggr_len)
+		return;
+
+	skb_aggr = dev_alloc_skb(aggr_len + ETH_HLEN + NET_IP_ALIGN);
+	if (!skb_aggr) {
+		batadv_v_ogm_aggr_list_free(hard_iface);
+		return;
+	}
+
+	skb_reserve(skb_aggr, ETH_HLEN + NET_IP_ALIGN);
+	skb_reset_network_header(skb_aggr);
+
+	while ((skb = __skb_dequeue(&hard_iface->bat_v.aggr_list))) {
+		ogm_len = batadv_v_ogm_len(skb);
+		hard_iface->bat_v.aggr_len -= ogm_len;
+
+		skb_put_data(skb_aggr, skb->data, ogm_len);
+		consume_skb(skb);
+	}
+
+	batadv_v_ogm_send_to_if(skb_aggr, hard_iface);
+}
+
+/**
+ * batadv_v_ogm_queue_on_if() - queue a batman ogm on a given interface
+ * @skb: the OGM to queue
+ * @hard_iface: the interface to queue the OGM on
+ *
+ * The OGM is transmitted right away when OGM aggregation is disabled.
+ * Otherwise it is appended to the aggregation queue of the interface, which
+ * is flushed first when the OGM would not fit into it anymore.
+ */
+static void batadv_v_ogm_queue_on_if(struct sk_buff *skb,
+				     struct batadv_hard_iface *hard_iface)
+{
+	struct batadv_priv *bat_priv = netdev_priv(hard_iface->soft_iface);
+
+	if (!atomic_read(&bat_priv->aggregated_ogms)) {
+		batadv_v_ogm_send_to_if(skb, hard_iface);
+		return;
+	}
+
+	spin_lock_bh(&hard_iface->bat_v.aggr_list_lock);
+	if (!batadv_v_ogm_queue_left(skb, hard_iface))
+		batadv_v_ogm_aggr_send(hard_iface);
+
+	hard_iface->bat_v.aggr_len += batadv_v_ogm_len(skb);
+	__skb_queue_tail(&hard_iface->bat_v.aggr_list, skb);
+	spin_unlock_bh(&hard_iface->bat_v.aggr_list_lock);
+}
+
 /**
  * batadv_v_ogm_send() - periodic worker broadcasting the own OGM
  * @work: work queue item
@@ -149,6 +314,8 @@ static void batadv_v_ogm_send(struct work_struct *work)
 	if (atomic_read(&bat_priv->mesh_state) == BATADV_MESH_DEACTIVATING)
 		goto out;
 
+	batadv_send_delay_add(bat_priv, BATADV_CNT_CTRL_DELAY, bat_v->ogm_due);
+
 	ogm_buff = bat_priv->bat_v.ogm_buff;
 	ogm_buff_len = bat_priv->bat_v.ogm_buff_len;
 	/* tt changes have to be committed before the tvlv data is
@@ -215,14 +382,14 @@ static void batadv_v_ogm_send(struct work_struct *work)
 			   hard_iface->net_dev->name,
 			   hard_iface->net_dev->dev_addr);
 
-		/* this skb gets consumed by batadv_v_ogm_send_to_if() */
+		/* this skb gets consumed by batadv_v_ogm_queue_on_if() */
 		skb_tmp = skb_clone(skb, GFP_ATOMIC);
 		if (!skb_tmp) {
 			batadv_hardif_put(hard_iface);
 			break;
 		}
 
-		batadv_v_ogm_send_to_if(skb_tmp, hard_iface);
+		batadv_v_ogm_queue_on_if(skb_tmp, hard_iface);
 		batadv_hardif_put(hard_iface);
 	}
 	rcu_read_unlock();
@@ -235,6 +402,42 @@ out:
 	return;
 }
 
+/**
+ * batadv_v_ogm_start_queue_timer() - restart the OGM aggregation timer
+ * @hard_iface: the interface to use to send the OGM
+ */
+static void batadv_v_ogm_start_queue_timer(struct batadv_hard_iface *hard_iface)
+{
+	struct batadv_priv *bat_priv = netdev_priv(hard_iface->soft_iface);
+	unsigned int msecs = BATADV_MAX_AGGREGATION_MS * 1000;
+
+	/* msecs * [0.9, 1.1] */
+	msecs += prandom_u32() % (msecs / 5) - (msecs / 10);
+	queue_delayed_work(bat_priv->ctrl_wq, &hard_iface->bat_v.aggr_wq,
+			   msecs_to_jiffies(msecs / 1000));
+}
+
+/**
+ * batadv_v_ogm_aggr_work() - OGM queue periodic task per interface
+ * @work: work queue item
+ *
+ * Emits aggregated OGM messages in regular intervals.
+ */
+void batadv_v_ogm_aggr_work(struct work_struct *work)
+{
+	struct batadv_hard_iface_bat_v *batv;
+	struct batadv_hard_iface *hard_iface;
+
+	batv = container_of(work, struct batadv_hard_iface_bat_v, aggr_wq.work);
+	hard_iface = container_of(batv, struct batadv_hard_iface, bat_v);
+
+	spin_lock_bh(&hard_iface->bat_v.aggr_list_lock);
+	batadv_v_ogm_aggr_send(hard_iface);
+	spin_unlock_bh(&hard_iface->bat_v.aggr_list_lock);
+
+	batadv_v_ogm_start_queue_timer(hard_iface);
+}
+
 /**
  * batadv_v_ogm_iface_enable() - prepare an interface for B.A.T.M.A.N. V
  * @hard_iface: the interface to prepare
@@ -247,11 +450,25 @@ int batadv_v_ogm_iface_enable(struct batadv_hard_iface *hard_iface)
 {
 	struct batadv_priv *bat_priv = netdev_priv(hard_iface->soft_iface);
 
+	batadv_v_ogm_start_queue_timer(hard_iface);
 	batadv_v_ogm_start_timer(bat_priv);
 
 	return 0;
 }
 
+/**
+ * batadv_v_ogm_iface_disable() - release OGM interface private resources
+ * @hard_iface: interface for which the resources have to be released
+ */
+void batadv_v_ogm_iface_disable(struct batadv_hard_iface *hard_iface)
+{
+	cancel_delayed_work_sync(&hard_iface->bat_v.aggr_wq);
+
+	spin_lock_bh(&hard_iface->bat_v.aggr_list_lock);
+	batadv_v_ogm_aggr_list_free(hard_iface);
+	spin_unlock_bh(&hard_iface->bat_v.aggr_list_lock);
+}
+
 /**
  * batadv_v_ogm_primary_iface_set() - set a new primary interface
  * @primary_iface: the new primary interface
@@ -369,6 +586,13 @@ static void batadv_v_ogm_forward(struct batadv_priv *bat_priv,
 		goto out;
 	}
 
+	if (!batadv_ogm_fisheye_forward(bat_priv, orig_node, ogm_received->ttl,
+					ntohl(ogm_received->seqno))) {
+		batadv_dbg(BATADV_DBG_BATMAN, bat_priv,
+			   "Drop packet: originator outside of fisheye scope\n");
+		goto out;
+	}
+
 	neigh_ifinfo = batadv_neigh_ifinfo_get(neigh_node, if_outgoing);
 	if (!neigh_ifinfo)
 		goto out;
@@ -394,7 +618,7 @@ static void batadv_v_ogm_forward(struct batadv_priv *bat_priv,
 		   if_outgoing->net_dev->name, ntohl(ogm_forward->throughput),
 		   ogm_forward->ttl, if_incoming->net_dev->name);
 
-	batadv_v_ogm_send_to_if(skb, if_outgoing);
+	batadv_v_ogm_queue_on_if(skb, if_outgoing);
 
 out:
 	if (orig_ifinfo)
@@ -490,6 +714,31 @@ out:
 	return ret;
 }
 
+/**
+ * batadv_v_ogm_route_hysteresis() - get the gain needed to replace a router
+ * @router: the currently selected router
+ * @throughput: the path throughput via @router
+ *
+ * A new router has to be better than the current one by more than the noise
+ * of the route. Otherwise routes flap between similar paths whenever their
+ * throughput estimations fluctuate.
+ *
+ * Return: the larger of BATADV_V_ROUTE_HYSTERESIS percent of @throughput and
+ * the deviation of the link throughput towards @router
+ */
+static u32 batadv_v_ogm_route_hysteresis(struct batadv_neigh_node *router,
+					 u32 throughput)
+{
+	struct batadv_hardif_neigh_node_bat_v *neigh_bat_v;
+	u32 deviation;
+
+	neigh_bat_v = &router->hardif_neigh->bat_v;
+	deviation = ewma_throughput_dev_read(&neigh_bat_v->throughput_dev);
+
+	return max_t(u32, throughput / 100 * BATADV_V_ROUTE_HYSTERESIS,
+		     deviation);
+}
+
 /**
  * batadv_v_ogm_route_update() - update routes based on OGM
  * @bat_priv: the bat priv with all the soft interface information
@@ -515,6 +764,7 @@ static bool batadv_v_ogm_route_update(struct batadv_priv *bat_priv,
 	struct batadv_neigh_node *orig_neigh_router = NULL;
 	struct batadv_neigh_ifinfo *router_ifinfo = NULL, *neigh_ifinfo = NULL;
 	u32 router_throughput, neigh_throughput;
+	u32 hysteresis;
 	u32 router_last_seqno;
 	u32 neigh_last_seqno;
 	s32 neigh_seq_diff;
@@ -551,7 +801,8 @@ static bool batadv_v_ogm_route_update(struct batadv_priv *bat_priv,
 	if (router == neigh_node)
 		goto out;
 
-	/* don't consider neighbours with worse throughput.
+	/* don't consider neighbours which are not clearly better than the
+	 * current router (see batadv_v_ogm_route_hysteresis()).
 	 * also switch route if this seqno is BATADV_V_MAX_ORIGDIFF newer than
 	 * the last received seqno from our best next hop.
 	 */
@@ -569,8 +820,12 @@ static bool batadv_v_ogm_route_update(struct batadv_priv *bat_priv,
 		router_throughput = router_ifinfo->bat_v.throughput;
 		neigh_throughput = neigh_ifinfo->bat_v.throughput;
 
+		hysteresis = batadv_v_ogm_route_hysteresis(router,
+							   router_throughput);
+
 		if (neigh_seq_diff < BATADV_OGM_MAX_ORIGDIFF &&
-		    router_throughput >= neigh_throughput)
+		    (router_throughput >= neigh_throughput ||
+		     neigh_throughput - router_throughput <= hysteresis))
 			goto out;
 	}
 
@@ -723,10 +978,15 @@ static void batadv_v_ogm_process(const struct sk_buff *skb, int ogm_offset,
 	 *  - For OGMs traversing more than hop the path throughput metric is
 	 *    the smaller of the path throughput and the link throughput.
 	 */
-	link_throughput = ewma_throughput_read(&hardif_neigh->bat_v.throughput);
+	link_throughput = batadv_v_elp_link_throughput(bat_priv, hardif_neigh);
 	path_throughput = min_t(u32, link_throughput, ogm_throughput);
 	ogm_packet->throughput = htonl(path_throughput);
 
+	batadv_frag_path_mtu_ogm_update(orig_node, ethhdr->h_source,
+					(u8 *)(ogm_packet + 1),
+					ntohs(ogm_packet->tvlv_len),
+					if_incoming);
+
 	batadv_v_ogm_process_per_outif(bat_priv, ethhdr, ogm_packet, orig_node,
 				       neigh_node, if_incoming,
 				       BATADV_IF_DEFAULT);
@@ -804,6 +1064,7 @@ int batadv_v_ogm_packet_recv(struct sk_buff *skb,
 	int ogm_offset;
 	u8 *packet_pos;
 	int ret = NET_RX_DROP;
+	u64 start;
 
 	/* did we receive a OGM2 packet on an interface that does not have
 	 * B.A.T.M.A.N. V enabled ?
@@ -831,8 +1092,15 @@ int batadv_v_ogm_packet_recv(struct sk_buff *skb,
 
 	while (batadv_v_ogm_aggr_packet(ogm_offset, skb_headlen(skb),
 					ogm_packet->tvlv_len)) {
+		start = 0;
+		if (trace_batadv_v_ogm_process_enabled())
+			start = batadv_trace_clock();
+
 		batadv_v_ogm_process(skb, ogm_offset, if_incoming);
 
+		trace_batadv_v_ogm_process(if_incoming->net_dev,
+					   ogm_packet->orig, start);
+
 		ogm_offset += BATADV_OGM2_HLEN;
 		ogm_offset += ntohs(ogm_packet->tvlv_len);
 
@@ -890,6 +1158,8 @@ int batadv_v_ogm_init(struct batadv_priv *bat_priv)
  */
 void batadv_v_ogm_free(struct batadv_priv *bat_priv)
 {
+	/* wait for batadv_v_ogm_rearm() calls which saw the mesh active */
+	synchronize_rcu();
 	cancel_delayed_work_sync(&bat_priv->bat_v.ogm_wq);
 
 	kfree(bat_priv->bat_v.ogm_buff);
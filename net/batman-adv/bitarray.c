@@ -19,7 +19,10 @@
 #include "bitarray.h"
 #include "main.h"
 
+#include <linux/atomic.h>
 #include <linux/bitmap.h>
+#include <linux/bug.h>
+#include <linux/log2.h>
 
 #include "log.h"
 
@@ -99,3 +102,94 @@ bool batadv_bit_get_packet(void *priv, unsigned long *seq_bits,
 
 	return true;
 }
+
+/**
+ * batadv_seqno_window_reset() - forget all received sequence numbers
+ * @win: the window to reset
+ * @seqno: sequence number the window should end at
+ *
+ * Every slot is set to a sequence number which maps to it but lies before the
+ * new window, so no sequence number of the window is seen as received.
+ */
+void batadv_seqno_window_reset(struct batadv_seqno_window *win, u32 seqno)
+{
+	u32 base;
+	int i;
+
+	BUILD_BUG_ON_NOT_POWER_OF_2(BATADV_BCAST_MAX_AGE);
+
+	base = (seqno & ~(BATADV_BCAST_MAX_AGE - 1)) - 2 * BATADV_BCAST_MAX_AGE;
+
+	for (i = 0; i < BATADV_BCAST_MAX_AGE; i++)
+		atomic_set(&win->seqnos[i], base + i);
+
+	atomic_set(&win->last_seqno, seqno);
+}
+
+/**
+ * batadv_seqno_window_mark() - mark a sequence number as received
+ * @win: the window to update
+ * @seqno: the received sequence number
+ *
+ * Each slot of the window only ever moves forward to newer sequence numbers,
+ * so concurrent callers agree on exactly one of them receiving a sequence
+ * number first, without taking a lock.
+ *
+ * Return: BATADV_SEQNO_NEW if seqno was not received before and is now marked,
+ *  BATADV_SEQNO_DUP if it was already received, or BATADV_SEQNO_OLD if it is
+ *  too old or too new for the window and was not marked.
+ */
+enum batadv_seqno_state
+batadv_seqno_window_mark(struct batadv_seqno_window *win, u32 seqno)
+{
+	atomic_t *slot = &win->seqnos[seqno % BATADV_BCAST_MAX_AGE];
+	u32 last, old, prev;
+	s32 seq_diff;
+
+	last = atomic_read(&win->last_seqno);
+	seq_diff = seqno - last;
+	if (seq_diff <= -BATADV_BCAST_MAX_AGE ||
+	    seq_diff >= BATADV_EXPECTED_SEQNO_RANGE)
+		return BATADV_SEQNO_OLD;
+
+	old = atomic_read(slot);
+	while (old != seqno) {
+		/* a newer sequence number took over the slot already */
+		if ((s32)(seqno - old) < 0)
+			return BATADV_SEQNO_OLD;
+
+		prev = atomic_cmpxchg(slot, old, seqno);
+		if (prev == old)
+			goto move_window;
+
+		old = prev;
+	}
+
+	return BATADV_SEQNO_DUP;
+
+move_window:
+	while ((s32)(seqno - last) > 0) {
+		prev = atomic_cmpxchg(&win->last_seqno, last, seqno);
+		if (prev == last)
+			break;
+
+		last = prev;
+	}
+
+	return BATADV_SEQNO_NEW;
+}
+
+/**
+ * batadv_seqno_window_seen() - check whether a sequence number was received
+ * @win: the window to check
+ * @seqno: the sequence number to check for
+ *
+ * Return: true if seqno was received and its slot was not reused for a newer
+ *  sequence number yet
+ */
+bool batadv_seqno_window_seen(struct batadv_seqno_window *win, u32 seqno)
+{
+	atomic_t *slot = &win->seqnos[seqno % BATADV_BCAST_MAX_AGE];
+
+	return (u32)atomic_read(slot) == seqno;
+}
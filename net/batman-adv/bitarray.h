@@ -26,6 +26,8 @@
 #include <linux/stddef.h>
 #include <linux/types.h>
 
+struct batadv_seqno_window;
+
 /**
  * batadv_test_bit() - check if bit is set in the current window
  *
@@ -62,7 +64,25 @@ static inline void batadv_set_bit(unsigned long *seq_bits, s32 n)
 	set_bit(n, seq_bits); /* turn the position on */
 }
 
+/**
+ * enum batadv_seqno_state - result of marking a sequence number as received
+ */
+enum batadv_seqno_state {
+	/** @BATADV_SEQNO_NEW: sequence number was not received before */
+	BATADV_SEQNO_NEW,
+
+	/** @BATADV_SEQNO_DUP: sequence number was already received */
+	BATADV_SEQNO_DUP,
+
+	/** @BATADV_SEQNO_OLD: sequence number is outside of the window */
+	BATADV_SEQNO_OLD,
+};
+
 bool batadv_bit_get_packet(void *priv, unsigned long *seq_bits,
 			   s32 seq_num_diff, int set_mark);
+void batadv_seqno_window_reset(struct batadv_seqno_window *win, u32 seqno);
+enum batadv_seqno_state
+batadv_seqno_window_mark(struct batadv_seqno_window *win, u32 seqno);
+bool batadv_seqno_window_seen(struct batadv_seqno_window *win, u32 seqno);
 
 #endif /* _NET_BATMAN_ADV_BITARRAY_H_ */
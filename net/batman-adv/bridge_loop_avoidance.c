@@ -20,7 +20,9 @@
 #include "main.h"
 
 #include <linux/atomic.h>
+#include <linux/bitops.h>
 #include <linux/byteorder/generic.h>
+#include <linux/cache.h>
 #include <linux/compiler.h>
 #include <linux/crc16.h>
 #include <linux/errno.h>
@@ -40,6 +42,7 @@
 #include <linux/rculist.h>
 #include <linux/rcupdate.h>
 #include <linux/seq_file.h>
+#include <linux/seqlock.h>
 #include <linux/skbuff.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
@@ -64,6 +67,8 @@
 
 static const u8 batadv_announce_mac[4] = {0x43, 0x05, 0x43, 0x05};
 
+static struct kmem_cache *batadv_claim_cache __read_mostly;
+
 static void batadv_bla_periodic_work(struct work_struct *work);
 static void
 batadv_bla_send_announce(struct batadv_priv *bat_priv,
@@ -105,6 +110,41 @@ static inline u32 batadv_choose_backbone_gw(const void *data, u32 size)
 	return hash % size;
 }
 
+/**
+ * batadv_choose_claim_node() - choose the right bucket for a stored claim
+ * @node: hash_entry of the claim
+ * @size: size of the hash table
+ *
+ * Return: the hash index of the claim
+ */
+static u32 batadv_choose_claim_node(const struct hlist_node *node, u32 size)
+{
+	const struct batadv_bla_claim *claim;
+
+	claim = container_of(node, struct batadv_bla_claim, hash_entry);
+
+	return batadv_choose_claim(claim, size);
+}
+
+/**
+ * batadv_choose_backbone_gw_node() - choose the right bucket for a stored
+ *  backbone gateway
+ * @node: hash_entry of the backbone gateway
+ * @size: size of the hash table
+ *
+ * Return: the hash index of the backbone gateway
+ */
+static u32 batadv_choose_backbone_gw_node(const struct hlist_node *node,
+					  u32 size)
+{
+	const struct batadv_bla_backbone_gw *backbone_gw;
+
+	backbone_gw = container_of(node, struct batadv_bla_backbone_gw,
+				   hash_entry);
+
+	return batadv_choose_backbone_gw(backbone_gw, size);
+}
+
 /**
  * batadv_compare_backbone_gw() - compare address and vid of two backbone gws
  * @node: list node of the first entry to compare
@@ -178,6 +218,46 @@ static void batadv_backbone_gw_put(struct batadv_bla_backbone_gw *backbone_gw)
 	kref_put(&backbone_gw->refcount, batadv_backbone_gw_release);
 }
 
+/**
+ * batadv_bla_crc_bucket() - get the crc bucket of a claim
+ * @crc: crc16 checksum of the claimed mac address
+ *
+ * Return: index of the bucket in &batadv_bla_backbone_gw.crc_buckets
+ */
+static unsigned int batadv_bla_crc_bucket(u16 crc)
+{
+	return crc / (BIT(16) / BATADV_BLA_CRC_BUCKETS);
+}
+
+/**
+ * batadv_bla_crc_toggle() - add or remove a claim from the crc of a backbone gw
+ * @backbone_gw: the backbone gateway owning the claim
+ * @addr: the mac address of the claim
+ */
+static void batadv_bla_crc_toggle(struct batadv_bla_backbone_gw *backbone_gw,
+				  const u8 *addr)
+{
+	u16 crc = crc16(0, addr, ETH_ALEN);
+
+	spin_lock_bh(&backbone_gw->crc_lock);
+	backbone_gw->crc ^= crc;
+	backbone_gw->crc_buckets[batadv_bla_crc_bucket(crc)] ^= crc;
+	spin_unlock_bh(&backbone_gw->crc_lock);
+}
+
+/**
+ * batadv_claim_free_rcu() - free the claim
+ * @rcu: rcu pointer of the claim
+ */
+static void batadv_claim_free_rcu(struct rcu_head *rcu)
+{
+	struct batadv_bla_claim *claim;
+
+	claim = container_of(rcu, struct batadv_bla_claim, rcu);
+
+	kmem_cache_free(batadv_claim_cache, claim);
+}
+
 /**
  * batadv_claim_release() - release claim from lists and queue for free after
  *  rcu grace period
@@ -192,16 +272,13 @@ static void batadv_claim_release(struct kref *ref)
 
 	spin_lock_bh(&claim->backbone_lock);
 	old_backbone_gw = claim->backbone_gw;
-	claim->backbone_gw = NULL;
+	WRITE_ONCE(claim->backbone_gw, NULL);
 	spin_unlock_bh(&claim->backbone_lock);
 
-	spin_lock_bh(&old_backbone_gw->crc_lock);
-	old_backbone_gw->crc ^= crc16(0, claim->addr, ETH_ALEN);
-	spin_unlock_bh(&old_backbone_gw->crc_lock);
-
+	batadv_bla_crc_toggle(old_backbone_gw, claim->addr);
 	batadv_backbone_gw_put(old_backbone_gw);
 
-	kfree_rcu(claim, rcu);
+	call_rcu(&claim->rcu, batadv_claim_free_rcu);
 }
 
 /**
@@ -214,61 +291,89 @@ static void batadv_claim_put(struct batadv_bla_claim *claim)
 }
 
 /**
- * batadv_claim_hash_find() - looks for a claim in the claim hash
+ * batadv_claim_hash_find_rcu() - looks for a claim in the claim hash without
+ *  taking a reference
  * @bat_priv: the bat priv with all the soft interface information
  * @data: search data (may be local/static data)
  *
+ * The caller must hold the rcu_read_lock and may only use the returned claim
+ * until it is released.
+ *
  * Return: claim if found or NULL otherwise.
  */
 static struct batadv_bla_claim *
-batadv_claim_hash_find(struct batadv_priv *bat_priv,
-		       struct batadv_bla_claim *data)
+batadv_claim_hash_find_rcu(struct batadv_priv *bat_priv,
+			   struct batadv_bla_claim *data)
 {
 	struct batadv_hashtable *hash = bat_priv->bla.claim_hash;
 	struct hlist_head *head;
 	struct batadv_bla_claim *claim;
 	struct batadv_bla_claim *claim_tmp = NULL;
-	int index;
+	unsigned int seq;
 
 	if (!hash)
 		return NULL;
 
-	index = batadv_choose_claim(data, hash->size);
-	head = &hash->table[index];
+	do {
+		seq = batadv_hash_read_begin(hash);
+		head = batadv_hash_head_rcu(hash, batadv_choose_claim, data);
 
-	rcu_read_lock();
-	hlist_for_each_entry_rcu(claim, head, hash_entry) {
-		if (!batadv_compare_claim(&claim->hash_entry, data))
-			continue;
+		hlist_for_each_entry_rcu(claim, head, hash_entry) {
+			if (!batadv_compare_claim(&claim->hash_entry, data))
+				continue;
 
-		if (!kref_get_unless_zero(&claim->refcount))
-			continue;
+			claim_tmp = claim;
+			break;
+		}
+	} while (!claim_tmp && batadv_hash_read_retry(hash, seq));
 
-		claim_tmp = claim;
-		break;
-	}
+	return claim_tmp;
+}
+
+/**
+ * batadv_claim_hash_find() - looks for a claim in the claim hash
+ * @bat_priv: the bat priv with all the soft interface information
+ * @data: search data (may be local/static data)
+ *
+ * Return: claim if found or NULL otherwise.
+ */
+static struct batadv_bla_claim *
+batadv_claim_hash_find(struct batadv_priv *bat_priv,
+		       struct batadv_bla_claim *data)
+{
+	struct batadv_bla_claim *claim;
+
+	rcu_read_lock();
+	claim = batadv_claim_hash_find_rcu(bat_priv, data);
+	if (claim && !kref_get_unless_zero(&claim->refcount))
+		claim = NULL;
 	rcu_read_unlock();
 
-	return claim_tmp;
+	return claim;
 }
 
 /**
- * batadv_backbone_hash_find() - looks for a backbone gateway in the hash
+ * batadv_backbone_hash_find_rcu() - looks for a backbone gateway in the hash
+ *  without taking a reference
  * @bat_priv: the bat priv with all the soft interface information
  * @addr: the address of the originator
  * @vid: the VLAN ID
  *
+ * The caller must hold the rcu_read_lock and may only use the returned
+ * backbone gateway until it is released.
+ *
  * Return: backbone gateway if found or NULL otherwise
  */
 static struct batadv_bla_backbone_gw *
-batadv_backbone_hash_find(struct batadv_priv *bat_priv, u8 *addr,
-			  unsigned short vid)
+batadv_backbone_hash_find_rcu(struct batadv_priv *bat_priv, u8 *addr,
+			      unsigned short vid)
 {
 	struct batadv_hashtable *hash = bat_priv->bla.backbone_hash;
 	struct hlist_head *head;
 	struct batadv_bla_backbone_gw search_entry, *backbone_gw;
 	struct batadv_bla_backbone_gw *backbone_gw_tmp = NULL;
-	int index;
+	struct hlist_node *node;
+	unsigned int seq;
 
 	if (!hash)
 		return NULL;
@@ -276,37 +381,62 @@ batadv_backbone_hash_find(struct batadv_priv *bat_priv, u8 *addr,
 	ether_addr_copy(search_entry.orig, addr);
 	search_entry.vid = vid;
 
-	index = batadv_choose_backbone_gw(&search_entry, hash->size);
-	head = &hash->table[index];
+	do {
+		seq = batadv_hash_read_begin(hash);
+		head = batadv_hash_head_rcu(hash, batadv_choose_backbone_gw,
+					    &search_entry);
 
-	rcu_read_lock();
-	hlist_for_each_entry_rcu(backbone_gw, head, hash_entry) {
-		if (!batadv_compare_backbone_gw(&backbone_gw->hash_entry,
-						&search_entry))
-			continue;
+		hlist_for_each_entry_rcu(backbone_gw, head, hash_entry) {
+			node = &backbone_gw->hash_entry;
+			if (!batadv_compare_backbone_gw(node, &search_entry))
+				continue;
 
-		if (!kref_get_unless_zero(&backbone_gw->refcount))
-			continue;
+			backbone_gw_tmp = backbone_gw;
+			break;
+		}
+	} while (!backbone_gw_tmp && batadv_hash_read_retry(hash, seq));
 
-		backbone_gw_tmp = backbone_gw;
-		break;
-	}
+	return backbone_gw_tmp;
+}
+
+/**
+ * batadv_backbone_hash_find() - looks for a backbone gateway in the hash
+ * @bat_priv: the bat priv with all the soft interface information
+ * @addr: the address of the originator
+ * @vid: the VLAN ID
+ *
+ * Return: backbone gateway if found or NULL otherwise
+ */
+static struct batadv_bla_backbone_gw *
+batadv_backbone_hash_find(struct batadv_priv *bat_priv, u8 *addr,
+			  unsigned short vid)
+{
+	struct batadv_bla_backbone_gw *backbone_gw;
+
+	rcu_read_lock();
+	backbone_gw = batadv_backbone_hash_find_rcu(bat_priv, addr, vid);
+	if (backbone_gw && !kref_get_unless_zero(&backbone_gw->refcount))
+		backbone_gw = NULL;
 	rcu_read_unlock();
 
-	return backbone_gw_tmp;
+	return backbone_gw;
 }
 
 /**
- * batadv_bla_del_backbone_claims() - delete all claims for a backbone
+ * batadv_bla_del_backbone_buckets() - delete the claims of some crc buckets of
+ *  a backbone
  * @backbone_gw: backbone gateway where the claims should be removed
+ * @buckets: bitmap of the crc buckets whose claims should be removed
  */
 static void
-batadv_bla_del_backbone_claims(struct batadv_bla_backbone_gw *backbone_gw)
+batadv_bla_del_backbone_buckets(struct batadv_bla_backbone_gw *backbone_gw,
+				u16 buckets)
 {
 	struct batadv_hashtable *hash;
 	struct hlist_node *node_tmp;
 	struct hlist_head *head;
 	struct batadv_bla_claim *claim;
+	unsigned int bucket;
 	int i;
 	spinlock_t *list_lock;	/* protects write access to the hash lists */
 
@@ -314,22 +444,46 @@ batadv_bla_del_backbone_claims(struct batadv_bla_backbone_gw *backbone_gw)
 	if (!hash)
 		return;
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-		list_lock = &hash->list_locks[i];
-
-		spin_lock_bh(list_lock);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
+		head = batadv_hash_lock_bucket(hash, i, &list_lock);
 		hlist_for_each_entry_safe(claim, node_tmp,
 					  head, hash_entry) {
 			if (claim->backbone_gw != backbone_gw)
 				continue;
 
+			bucket = batadv_bla_crc_bucket(crc16(0, claim->addr,
+							     ETH_ALEN));
+			if (!(buckets & BIT(bucket)))
+				continue;
+
 			batadv_claim_put(claim);
-			hlist_del_rcu(&claim->hash_entry);
+			batadv_hash_del(hash, &claim->hash_entry);
 		}
-		spin_unlock_bh(list_lock);
+		batadv_hash_unlock_bucket(hash, list_lock);
 	}
 
+	/* claims of these buckets gone, initialize their CRCs */
+	spin_lock_bh(&backbone_gw->crc_lock);
+	for (i = 0; i < BATADV_BLA_CRC_BUCKETS; i++) {
+		if (!(buckets & BIT(i)))
+			continue;
+
+		backbone_gw->crc ^= backbone_gw->crc_buckets[i];
+		backbone_gw->crc_buckets[i] = 0;
+	}
+	spin_unlock_bh(&backbone_gw->crc_lock);
+}
+
+/**
+ * batadv_bla_del_backbone_claims() - delete all claims for a backbone
+ * @backbone_gw: backbone gateway where the claims should be removed
+ */
+static void
+batadv_bla_del_backbone_claims(struct batadv_bla_backbone_gw *backbone_gw)
+{
+	batadv_bla_del_backbone_buckets(backbone_gw,
+					BATADV_BLA_CRC_BUCKETS_ALL);
+
 	/* all claims gone, initialize CRC */
 	spin_lock_bh(&backbone_gw->crc_lock);
 	backbone_gw->crc = BATADV_BLA_CRC_INIT;
@@ -337,14 +491,18 @@ batadv_bla_del_backbone_claims(struct batadv_bla_backbone_gw *backbone_gw)
 }
 
 /**
- * batadv_bla_send_claim() - sends a claim frame according to the provided info
+ * batadv_bla_send_claim_ext() - sends a claim frame with data appended to the
+ *  ARP header
  * @bat_priv: the bat priv with all the soft interface information
  * @mac: the mac address to be announced within the claim
  * @vid: the VLAN ID
  * @claimtype: the type of the claim (CLAIM, UNCLAIM, ANNOUNCE, ...)
+ * @ext: data to append to the ARP header (may be NULL)
+ * @ext_len: length of @ext
  */
-static void batadv_bla_send_claim(struct batadv_priv *bat_priv, u8 *mac,
-				  unsigned short vid, int claimtype)
+static void batadv_bla_send_claim_ext(struct batadv_priv *bat_priv, u8 *mac,
+				      unsigned short vid, int claimtype,
+				      const void *ext, unsigned int ext_len)
 {
 	struct sk_buff *skb;
 	struct ethhdr *ethhdr;
@@ -383,6 +541,16 @@ static void batadv_bla_send_claim(struct batadv_priv *bat_priv, u8 *mac,
 	if (!skb)
 		goto out;
 
+	if (ext_len) {
+		if (skb_tailroom(skb) < ext_len &&
+		    pskb_expand_head(skb, 0, ext_len, GFP_ATOMIC) < 0) {
+			kfree_skb(skb);
+			goto out;
+		}
+
+		skb_put_data(skb, ext, ext_len);
+	}
+
 	ethhdr = (struct ethhdr *)skb->data;
 	hw_src = (u8 *)ethhdr + ETH_HLEN + sizeof(struct arphdr);
 
@@ -435,6 +603,14 @@ static void batadv_bla_send_claim(struct batadv_priv *bat_priv, u8 *mac,
 			   batadv_print_vid(vid));
 
 		break;
+	case BATADV_CLAIM_TYPE_CLAIM_LIST:
+		/* list of claims
+		 * the clients macs follow the ARP header
+		 */
+		batadv_dbg(BATADV_DBG_BLA, bat_priv,
+			   "%s(): CLAIM_LIST of %pM on vid %d\n", __func__,
+			   ethhdr->h_source, batadv_print_vid(vid));
+		break;
 	}
 
 	if (vid & BATADV_VLAN_HAS_TAG) {
@@ -456,6 +632,19 @@ out:
 		batadv_hardif_put(primary_if);
 }
 
+/**
+ * batadv_bla_send_claim() - sends a claim frame according to the provided info
+ * @bat_priv: the bat priv with all the soft interface information
+ * @mac: the mac address to be announced within the claim
+ * @vid: the VLAN ID
+ * @claimtype: the type of the claim (CLAIM, UNCLAIM, ANNOUNCE, ...)
+ */
+static void batadv_bla_send_claim(struct batadv_priv *bat_priv, u8 *mac,
+				  unsigned short vid, int claimtype)
+{
+	batadv_bla_send_claim_ext(bat_priv, mac, vid, claimtype, NULL, 0);
+}
+
 /**
  * batadv_bla_loopdetect_report() - worker for reporting the loop
  * @work: work queue item
@@ -573,11 +762,23 @@ batadv_bla_update_own_backbone_gw(struct batadv_priv *bat_priv,
 				  struct batadv_hard_iface *primary_if,
 				  unsigned short vid)
 {
+	u8 *own_addr = primary_if->net_dev->dev_addr;
 	struct batadv_bla_backbone_gw *backbone_gw;
+	bool found = false;
 
-	backbone_gw = batadv_bla_get_backbone_gw(bat_priv,
-						 primary_if->net_dev->dev_addr,
-						 vid, true);
+	/* fast path: our own backbone gw usually exists already */
+	rcu_read_lock();
+	backbone_gw = batadv_backbone_hash_find_rcu(bat_priv, own_addr, vid);
+	if (backbone_gw) {
+		backbone_gw->lasttime = jiffies;
+		found = true;
+	}
+	rcu_read_unlock();
+
+	if (likely(found))
+		return;
+
+	backbone_gw = batadv_bla_get_backbone_gw(bat_priv, own_addr, vid, true);
 	if (unlikely(!backbone_gw))
 		return;
 
@@ -585,28 +786,56 @@ batadv_bla_update_own_backbone_gw(struct batadv_priv *bat_priv,
 	batadv_backbone_gw_put(backbone_gw);
 }
 
+/**
+ * batadv_bla_send_claim_list() - send the claims of a CLAIM_LIST frame
+ * @bat_priv: the bat priv with all the soft interface information
+ * @backbone_gw: our backbone gateway owning the claims
+ * @list: the claim list header followed by the client addresses
+ * @num_claims: number of client addresses in @list
+ */
+static void
+batadv_bla_send_claim_list(struct batadv_priv *bat_priv,
+			   struct batadv_bla_backbone_gw *backbone_gw,
+			   struct batadv_bla_claim_list *list,
+			   unsigned int num_claims)
+{
+	list->magic = htons(BATADV_BLA_EXT_MAGIC);
+	list->num_claims = htons(num_claims);
+
+	batadv_bla_send_claim_ext(bat_priv, backbone_gw->orig, backbone_gw->vid,
+				  BATADV_CLAIM_TYPE_CLAIM_LIST, list,
+				  sizeof(*list) + num_claims * ETH_ALEN);
+}
+
 /**
  * batadv_bla_answer_request() - answer a bla request by sending own claims
  * @bat_priv: the bat priv with all the soft interface information
  * @primary_if: interface where the request came on
  * @vid: the vid where the request came on
+ * @buckets: bitmap of the requested crc buckets, 0 if all claims have to be
+ *  repeated in separate CLAIM frames
  *
- * Repeat all of our own claims, and finally send an ANNOUNCE frame
- * to allow the requester another check if the CRC is correct now.
+ * Repeat our own claims, and finally send an ANNOUNCE frame to allow the
+ * requester another check if the CRC is correct now. If only some buckets were
+ * requested, their claims are packed into CLAIM_LIST frames.
  */
 static void batadv_bla_answer_request(struct batadv_priv *bat_priv,
 				      struct batadv_hard_iface *primary_if,
-				      unsigned short vid)
+				      unsigned short vid, u16 buckets)
 {
+	struct batadv_bla_claim_list *list = NULL;
 	struct hlist_head *head;
 	struct batadv_hashtable *hash;
 	struct batadv_bla_claim *claim;
 	struct batadv_bla_backbone_gw *backbone_gw;
+	unsigned int num_claims = 0;
+	unsigned int bucket;
+	u8 *list_addr = NULL;
 	int i;
 
 	batadv_dbg(BATADV_DBG_BLA, bat_priv,
-		   "%s(): received a claim request, send all of our own claims again\n",
-		   __func__);
+		   "%s(): received a claim request, send our own claims again (buckets %#.4x)\n",
+		   __func__, buckets);
 
 	backbone_gw = batadv_backbone_hash_find(bat_priv,
 						primary_if->net_dev->dev_addr,
@@ -614,21 +843,59 @@ static void batadv_bla_answer_request(struct batadv_priv *bat_priv,
 	if (!backbone_gw)
 		return;
 
-	hash = bat_priv->bla.claim_hash;
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
+	/* fall back to CLAIM frames when no list can be built */
+	if (buckets) {
+		list = kmalloc(sizeof(*list) +
+			       BATADV_BLA_CLAIM_LIST_MAX * ETH_ALEN,
+			       GFP_ATOMIC);
+		if (list)
+			list_addr = (u8 *)(list + 1);
+		else
+			buckets = 0;
+	}
 
+	hash = bat_priv->bla.claim_hash;
+	batadv_hash_walk_begin(hash);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
 		rcu_read_lock();
+		head = batadv_hash_bucket_rcu(hash, i);
 		hlist_for_each_entry_rcu(claim, head, hash_entry) {
 			/* only own claims are interesting */
 			if (claim->backbone_gw != backbone_gw)
 				continue;
 
-			batadv_bla_send_claim(bat_priv, claim->addr, claim->vid,
-					      BATADV_CLAIM_TYPE_CLAIM);
+			if (!buckets) {
+				batadv_bla_send_claim(bat_priv, claim->addr,
+						      claim->vid,
+						      BATADV_CLAIM_TYPE_CLAIM);
+				continue;
+			}
+
+			bucket = batadv_bla_crc_bucket(crc16(0, claim->addr,
+							     ETH_ALEN));
+			if (!(buckets & BIT(bucket)))
+				continue;
+
+			ether_addr_copy(list_addr + num_claims * ETH_ALEN,
+					claim->addr);
+			num_claims++;
+
+			if (num_claims < BATADV_BLA_CLAIM_LIST_MAX)
+				continue;
+
+			batadv_bla_send_claim_list(bat_priv, backbone_gw, list,
+						   num_claims);
+			num_claims = 0;
 		}
 		rcu_read_unlock();
 	}
+	batadv_hash_walk_end(hash);
+
+	if (num_claims)
+		batadv_bla_send_claim_list(bat_priv, backbone_gw, list,
+					   num_claims);
+
+	kfree(list);
 
 	/* finally, send an announcement frame */
 	batadv_bla_send_announce(bat_priv, backbone_gw);
@@ -638,22 +905,43 @@ static void batadv_bla_answer_request(struct batadv_priv *bat_priv,
 /**
  * batadv_bla_send_request() - send a request to repeat claims
  * @backbone_gw: the backbone gateway from whom we are out of sync
+ * @buckets: bitmap of the mismatching crc buckets, 0 if the backbone gateway
+ *  did not announce the crcs of its buckets
  *
- * When the crc is wrong, ask the backbone gateway for a full table update.
- * After the request, it will repeat all of his own claims and finally
- * send an announcement claim with which we can check again.
+ * When the crc is wrong, ask the backbone gateway for an update of the
+ * mismatching buckets (or the full table if they are unknown). After the
+ * request, it will repeat these claims and finally send an announcement
+ * claim with which we can check again.
  */
-static void batadv_bla_send_request(struct batadv_bla_backbone_gw *backbone_gw)
+static void
+batadv_bla_send_request(struct batadv_bla_backbone_gw *backbone_gw,
+			u16 buckets)
 {
+	struct batadv_bla_request_ext request;
+
 	/* first, remove all old entries */
-	batadv_bla_del_backbone_claims(backbone_gw);
+	if (buckets)
+		batadv_bla_del_backbone_buckets(backbone_gw, buckets);
+	else
+		batadv_bla_del_backbone_claims(backbone_gw);
 
 	batadv_dbg(BATADV_DBG_BLA, backbone_gw->bat_priv,
-		   "Sending REQUEST to %pM\n", backbone_gw->orig);
+		   "Sending REQUEST to %pM (buckets %#.4x)\n",
+		   backbone_gw->orig, buckets);
 
 	/* send request */
-	batadv_bla_send_claim(backbone_gw->bat_priv, backbone_gw->orig,
-			      backbone_gw->vid, BATADV_CLAIM_TYPE_REQUEST);
+	if (buckets) {
+		request.magic = htons(BATADV_BLA_EXT_MAGIC);
+		request.buckets = htons(buckets);
+		batadv_bla_send_claim_ext(backbone_gw->bat_priv,
+					  backbone_gw->orig, backbone_gw->vid,
+					  BATADV_CLAIM_TYPE_REQUEST, &request,
+					  sizeof(request));
+	} else {
+		batadv_bla_send_claim(backbone_gw->bat_priv, backbone_gw->orig,
+				      backbone_gw->vid,
+				      BATADV_CLAIM_TYPE_REQUEST);
+	}
 
 	/* no local broadcasts should be sent or received, for now. */
 	if (!atomic_read(&backbone_gw->request_sent)) {
@@ -670,17 +958,24 @@ static void batadv_bla_send_request(struct batadv_bla_backbone_gw *backbone_gw)
 static void batadv_bla_send_announce(struct batadv_priv *bat_priv,
 				     struct batadv_bla_backbone_gw *backbone_gw)
 {
+	struct batadv_bla_announce_ext announce;
 	u8 mac[ETH_ALEN];
 	__be16 crc;
+	int i;
 
 	memcpy(mac, batadv_announce_mac, 4);
+	announce.magic = htons(BATADV_BLA_EXT_MAGIC);
 	spin_lock_bh(&backbone_gw->crc_lock);
 	crc = htons(backbone_gw->crc);
+	for (i = 0; i < BATADV_BLA_CRC_BUCKETS; i++)
+		announce.crc[i] = htons(backbone_gw->crc_buckets[i]);
 	spin_unlock_bh(&backbone_gw->crc_lock);
 	memcpy(&mac[4], &crc, 2);
 
-	batadv_bla_send_claim(bat_priv, mac, backbone_gw->vid,
-			      BATADV_CLAIM_TYPE_ANNOUNCE);
+	/* older backbone gws only look at the crc in the ARP header */
+	batadv_bla_send_claim_ext(bat_priv, mac, backbone_gw->vid,
+				  BATADV_CLAIM_TYPE_ANNOUNCE, &announce,
+				  sizeof(announce));
 }
 
 /**
@@ -706,7 +1001,7 @@ static void batadv_bla_add_claim(struct batadv_priv *bat_priv,
 
 	/* create a new claim entry if it does not exist yet. */
 	if (!claim) {
-		claim = kzalloc(sizeof(*claim), GFP_ATOMIC);
+		claim = kmem_cache_zalloc(batadv_claim_cache, GFP_ATOMIC);
 		if (!claim)
 			return;
 
@@ -730,7 +1025,7 @@ static void batadv_bla_add_claim(struct batadv_priv *bat_priv,
 
 		if (unlikely(hash_added != 0)) {
 			/* only local changes happened. */
-			kfree(claim);
+			kmem_cache_free(batadv_claim_cache, claim);
 			return;
 		}
 	} else {
@@ -751,24 +1046,23 @@ static void batadv_bla_add_claim(struct batadv_priv *bat_priv,
 	spin_lock_bh(&claim->backbone_lock);
 	old_backbone_gw = claim->backbone_gw;
 	kref_get(&backbone_gw->refcount);
-	claim->backbone_gw = backbone_gw;
+	WRITE_ONCE(claim->backbone_gw, backbone_gw);
 	spin_unlock_bh(&claim->backbone_lock);
 
 	if (remove_crc) {
 		/* remove claim address from old backbone_gw */
-		spin_lock_bh(&old_backbone_gw->crc_lock);
-		old_backbone_gw->crc ^= crc16(0, claim->addr, ETH_ALEN);
-		spin_unlock_bh(&old_backbone_gw->crc_lock);
+		batadv_bla_crc_toggle(old_backbone_gw, claim->addr);
 	}
 
 	batadv_backbone_gw_put(old_backbone_gw);
 
 	/* add claim address to new backbone_gw */
-	spin_lock_bh(&backbone_gw->crc_lock);
-	backbone_gw->crc ^= crc16(0, claim->addr, ETH_ALEN);
-	spin_unlock_bh(&backbone_gw->crc_lock);
+	batadv_bla_crc_toggle(backbone_gw, claim->addr);
 	backbone_gw->lasttime = jiffies;
 
+	batadv_netlink_notify_claim(bat_priv, BATADV_EVENT_BLA_CLAIM_ADD, mac,
+				    vid, backbone_gw->orig);
+
 claim_free_ref:
 	batadv_claim_put(claim);
 }
@@ -793,6 +1087,30 @@ batadv_bla_claim_get_backbone_gw(struct batadv_bla_claim *claim)
 	return backbone_gw;
 }
 
+/**
+ * batadv_bla_claim_is_own() - check if a claim belongs to our own backbone gw
+ * @claim: the claim to check
+ * @primary_if: the selected primary interface
+ *
+ * Has to be called with rcu_read_lock held. A claim which is currently
+ * released has already lost its backbone gw and is not considered ours.
+ *
+ * Return: true if the claim is owned by our own backbone gw, false otherwise
+ */
+static bool batadv_bla_claim_is_own(struct batadv_bla_claim *claim,
+				    struct batadv_hard_iface *primary_if)
+{
+	struct batadv_bla_backbone_gw *backbone_gw;
+
+	/* backbone gws are freed after an RCU grace period */
+	backbone_gw = READ_ONCE(claim->backbone_gw);
+	if (!backbone_gw)
+		return false;
+
+	return batadv_compare_eth(backbone_gw->orig,
+				  primary_if->net_dev->dev_addr);
+}
+
 /**
  * batadv_bla_del_claim() - delete a claim from the claim hash
  * @bat_priv: the bat priv with all the soft interface information
@@ -803,6 +1121,7 @@ static void batadv_bla_del_claim(struct batadv_priv *bat_priv,
 				 const u8 *mac, const unsigned short vid)
 {
 	struct batadv_bla_claim search_claim, *claim;
+	struct batadv_bla_backbone_gw *backbone_gw;
 
 	ether_addr_copy(search_claim.addr, mac);
 	search_claim.vid = vid;
@@ -817,21 +1136,60 @@ static void batadv_bla_del_claim(struct batadv_priv *bat_priv,
 			   batadv_choose_claim, claim);
 	batadv_claim_put(claim); /* reference from the hash is gone */
 
+	backbone_gw = batadv_bla_claim_get_backbone_gw(claim);
+	batadv_netlink_notify_claim(bat_priv, BATADV_EVENT_BLA_CLAIM_DEL, mac,
+				    vid, backbone_gw->orig);
+	batadv_backbone_gw_put(backbone_gw);
+
 	/* don't need the reference from hash_find() anymore */
 	batadv_claim_put(claim);
 }
 
+/**
+ * batadv_bla_crc_mismatch() - find the crc buckets which are out of sync
+ * @backbone_gw: the backbone gateway which sent the ANNOUNCE frame
+ * @skb: the ANNOUNCE frame
+ * @ext_offset: offset of the data appended to the ARP header
+ *
+ * Return: bitmap of the mismatching crc buckets, 0 if the frame carries no
+ * bucket crcs
+ */
+static u16 batadv_bla_crc_mismatch(struct batadv_bla_backbone_gw *backbone_gw,
+				   struct sk_buff *skb, int ext_offset)
+{
+	struct batadv_bla_announce_ext announce_buf, *announce;
+	u16 buckets = 0;
+	int i;
+
+	announce = skb_header_pointer(skb, ext_offset, sizeof(*announce),
+				      &announce_buf);
+	if (!announce || announce->magic != htons(BATADV_BLA_EXT_MAGIC))
+		return 0;
+
+	spin_lock_bh(&backbone_gw->crc_lock);
+	for (i = 0; i < BATADV_BLA_CRC_BUCKETS; i++) {
+		if (backbone_gw->crc_buckets[i] != ntohs(announce->crc[i]))
+			buckets |= BIT(i);
+	}
+	spin_unlock_bh(&backbone_gw->crc_lock);
+
+	return buckets;
+}
+
 /**
  * batadv_handle_announce() - check for ANNOUNCE frame
  * @bat_priv: the bat priv with all the soft interface information
  * @an_addr: announcement mac address (ARP Sender HW address)
  * @backbone_addr: originator address of the sender (Ethernet source MAC)
  * @vid: the VLAN ID of the frame
+ * @skb: the ANNOUNCE frame
+ * @ext_offset: offset of the data appended to the ARP header
  *
  * Return: true if handled
  */
 static bool batadv_handle_announce(struct batadv_priv *bat_priv, u8 *an_addr,
-				   u8 *backbone_addr, unsigned short vid)
+				   u8 *backbone_addr, unsigned short vid,
+				   struct sk_buff *skb, int ext_offset)
 {
 	struct batadv_bla_backbone_gw *backbone_gw;
 	u16 backbone_crc, crc;
@@ -864,7 +1222,10 @@ static bool batadv_handle_announce(struct batadv_priv *bat_priv, u8 *an_addr,
 			   batadv_print_vid(backbone_gw->vid),
 			   backbone_crc, crc);
 
-		batadv_bla_send_request(backbone_gw);
+		batadv_bla_send_request(backbone_gw,
+					batadv_bla_crc_mismatch(backbone_gw,
+								skb,
+								ext_offset));
 	} else {
 		/* if we have sent a request and the crc was OK,
 		 * we can allow traffic again.
@@ -886,14 +1247,20 @@ static bool batadv_handle_announce(struct batadv_priv *bat_priv, u8 *an_addr,
  * @backbone_addr: backbone address to be requested (ARP sender HW MAC)
  * @ethhdr: ethernet header of a packet
  * @vid: the VLAN ID of the frame
+ * @skb: the REQUEST frame
+ * @ext_offset: offset of the data appended to the ARP header
  *
  * Return: true if handled
  */
 static bool batadv_handle_request(struct batadv_priv *bat_priv,
 				  struct batadv_hard_iface *primary_if,
 				  u8 *backbone_addr, struct ethhdr *ethhdr,
-				  unsigned short vid)
+				  unsigned short vid, struct sk_buff *skb,
+				  int ext_offset)
 {
+	struct batadv_bla_request_ext request_buf, *request;
+	u16 buckets = 0;
+
 	/* check for REQUEST frame */
 	if (!batadv_compare_eth(backbone_addr, ethhdr->h_dest))
 		return false;
@@ -908,7 +1275,13 @@ static bool batadv_handle_request(struct batadv_priv *bat_priv,
 		   "%s(): REQUEST vid %d (sent by %pM)...\n",
 		   __func__, batadv_print_vid(vid), ethhdr->h_source);
 
-	batadv_bla_answer_request(bat_priv, primary_if, vid);
+	/* only some buckets are requested by newer backbone gws */
+	request = skb_header_pointer(skb, ext_offset, sizeof(*request),
+				     &request_buf);
+	if (request && request->magic == htons(BATADV_BLA_EXT_MAGIC))
+		buckets = ntohs(request->buckets) & BATADV_BLA_CRC_BUCKETS_ALL;
+
+	batadv_bla_answer_request(bat_priv, primary_if, vid, buckets);
 	return true;
 }
 
@@ -987,6 +1360,60 @@ static bool batadv_handle_claim(struct batadv_priv *bat_priv,
 	return true;
 }
 
+/**
+ * batadv_handle_claim_list() - check for CLAIM_LIST frame
+ * @bat_priv: the bat priv with all the soft interface information
+ * @primary_if: the primary hard interface of this batman soft interface
+ * @backbone_addr: originator address of the backbone (ARP sender HW MAC)
+ * @vid: the VLAN ID of the frame
+ * @skb: the CLAIM_LIST frame
+ * @ext_offset: offset of the data appended to the ARP header
+ *
+ * Return: true if handled
+ */
+static bool batadv_handle_claim_list(struct batadv_priv *bat_priv,
+				     struct batadv_hard_iface *primary_if,
+				     u8 *backbone_addr, unsigned short vid,
+				     struct sk_buff *skb, int ext_offset)
+{
+	struct batadv_bla_claim_list list_buf, *list;
+	struct batadv_bla_backbone_gw *backbone_gw;
+	u8 addr_buf[ETH_ALEN], *addr;
+	unsigned int num_claims, i;
+	int offset;
+
+	list = skb_header_pointer(skb, ext_offset, sizeof(*list), &list_buf);
+	if (!list || list->magic != htons(BATADV_BLA_EXT_MAGIC))
+		return false;
+
+	/* our own claims are not learned from the backbone */
+	if (batadv_compare_eth(backbone_addr, primary_if->net_dev->dev_addr))
+		return true;
+
+	backbone_gw = batadv_bla_get_backbone_gw(bat_priv, backbone_addr, vid,
+						 false);
+	if (unlikely(!backbone_gw))
+		return true;
+
+	num_claims = ntohs(list->num_claims);
+
+	batadv_dbg(BATADV_DBG_BLA, bat_priv,
+		   "%s(): CLAIM_LIST of %u clients on vid %d (sent by %pM)...\n",
+		   __func__, num_claims, batadv_print_vid(vid), backbone_addr);
+
+	offset = ext_offset + sizeof(*list);
+	for (i = 0; i < num_claims; i++, offset += ETH_ALEN) {
+		addr = skb_header_pointer(skb, offset, ETH_ALEN, addr_buf);
+		if (!addr)
+			break;
+
+		batadv_bla_add_claim(bat_priv, addr, vid, backbone_gw);
+	}
+
+	batadv_backbone_gw_put(backbone_gw);
+	return true;
+}
+
 /**
  * batadv_check_claim_group() - check for claim group membership
  * @bat_priv: the bat priv with all the soft interface information
@@ -1082,6 +1509,7 @@ static bool batadv_bla_process_claim(struct batadv_priv *bat_priv,
 	struct arphdr *arphdr;
 	unsigned short vid;
 	int vlan_depth = 0;
+	int ext_offset;
 	__be16 proto;
 	int headlen;
 	int ret;
@@ -1140,6 +1568,7 @@ static bool batadv_bla_process_claim(struct batadv_priv *bat_priv,
 	hw_dst = hw_src + ETH_ALEN + 4;
 	bla_dst = (struct batadv_bla_claim_dst *)hw_dst;
 	bla_dst_own = &bat_priv->bla.claim_dest;
+	ext_offset = headlen + arp_hdr_len(skb->dev);
 
 	/* check if it is a claim frame in general */
 	if (memcmp(bla_dst->magic, bla_dst_own->magic,
@@ -1187,12 +1616,17 @@ static bool batadv_bla_process_claim(struct batadv_priv *bat_priv,
 
 	case BATADV_CLAIM_TYPE_ANNOUNCE:
 		if (batadv_handle_announce(bat_priv, hw_src, ethhdr->h_source,
-					   vid))
+					   vid, skb, ext_offset))
 			return true;
 		break;
 	case BATADV_CLAIM_TYPE_REQUEST:
 		if (batadv_handle_request(bat_priv, primary_if, hw_src, ethhdr,
-					  vid))
+					  vid, skb, ext_offset))
+			return true;
+		break;
+	case BATADV_CLAIM_TYPE_CLAIM_LIST:
+		if (batadv_handle_claim_list(bat_priv, primary_if, hw_src, vid,
+					     skb, ext_offset))
 			return true;
 		break;
 	}
@@ -1220,24 +1654,28 @@ static void batadv_bla_purge_backbone_gw(struct batadv_priv *bat_priv, int now)
 	struct hlist_head *head;
 	struct batadv_hashtable *hash;
 	spinlock_t *list_lock;	/* protects write access to the hash lists */
+	unsigned int timeout = BATADV_BLA_BACKBONE_TIMEOUT;
+	unsigned long lasttime;
 	int i;
 
 	hash = bat_priv->bla.backbone_hash;
 	if (!hash)
 		return;
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-		list_lock = &hash->list_locks[i];
+	if (!now && !batadv_hash_age_purge_begin(hash, timeout))
+		return;
 
-		spin_lock_bh(list_lock);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
+		head = batadv_hash_lock_bucket(hash, i, &list_lock);
 		hlist_for_each_entry_safe(backbone_gw, node_tmp,
 					  head, hash_entry) {
 			if (now)
 				goto purge_now;
-			if (!batadv_has_timed_out(backbone_gw->lasttime,
-						  BATADV_BLA_BACKBONE_TIMEOUT))
+			lasttime = backbone_gw->lasttime;
+			if (!batadv_has_timed_out(lasttime, timeout)) {
+				batadv_hash_age_note(hash, lasttime);
 				continue;
+			}
 
 			batadv_dbg(BATADV_DBG_BLA, backbone_gw->bat_priv,
 				   "%s(): backbone gw %pM timed out\n",
@@ -1250,10 +1688,10 @@ purge_now:
 
 			batadv_bla_del_backbone_claims(backbone_gw);
 
-			hlist_del_rcu(&backbone_gw->hash_entry);
+			batadv_hash_del(hash, &backbone_gw->hash_entry);
 			batadv_backbone_gw_put(backbone_gw);
 		}
-		spin_unlock_bh(list_lock);
+		batadv_hash_unlock_bucket(hash, list_lock);
 	}
 }
 
@@ -1280,10 +1718,14 @@ static void batadv_bla_purge_claims(struct batadv_priv *bat_priv,
 	if (!hash)
 		return;
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
+	/* only the claims of the own backbone gw expire */
+	if (!now &&
+	    !batadv_hash_age_purge_begin(hash, BATADV_BLA_CLAIM_TIMEOUT))
+		return;
 
+	for (i = 0; i < batadv_hash_size(hash); i++) {
 		rcu_read_lock();
+		head = batadv_hash_bucket_rcu(hash, i);
 		hlist_for_each_entry_rcu(claim, head, hash_entry) {
 			backbone_gw = batadv_bla_claim_get_backbone_gw(claim);
 			if (now)
@@ -1294,8 +1736,10 @@ static void batadv_bla_purge_claims(struct batadv_priv *bat_priv,
 				goto skip;
 
 			if (!batadv_has_timed_out(claim->lasttime,
-						  BATADV_BLA_CLAIM_TIMEOUT))
+						  BATADV_BLA_CLAIM_TIMEOUT)) {
+				batadv_hash_age_note(hash, claim->lasttime);
 				goto skip;
+			}
 
 			batadv_dbg(BATADV_DBG_BLA, bat_priv,
 				   "%s(): timed out.\n", __func__);
@@ -1350,10 +1794,10 @@ void batadv_bla_update_orig_address(struct batadv_priv *bat_priv,
 	if (!hash)
 		return;
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-
+	batadv_hash_walk_begin(hash);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
 		rcu_read_lock();
+		head = batadv_hash_bucket_rcu(hash, i);
 		hlist_for_each_entry_rcu(backbone_gw, head, hash_entry) {
 			/* own orig still holds the old value. */
 			if (!batadv_compare_eth(backbone_gw->orig,
@@ -1369,6 +1813,7 @@ void batadv_bla_update_orig_address(struct batadv_priv *bat_priv,
 		}
 		rcu_read_unlock();
 	}
+	batadv_hash_walk_end(hash);
 }
 
 /**
@@ -1464,10 +1909,9 @@ static void batadv_bla_periodic_work(struct work_struct *work)
 	if (!hash)
 		goto out;
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-
+	for (i = 0; i < batadv_hash_size(hash); i++) {
 		rcu_read_lock();
+		head = batadv_hash_bucket_rcu(hash, i);
 		hlist_for_each_entry_rcu(backbone_gw, head, hash_entry) {
 			if (!batadv_compare_eth(backbone_gw->orig,
 						primary_if->net_dev->dev_addr))
@@ -1504,7 +1948,7 @@ out:
 	if (primary_if)
 		batadv_hardif_put(primary_if);
 
-	queue_delayed_work(batadv_event_workqueue, &bat_priv->bla.work,
+	queue_delayed_work(bat_priv->event_wq, &bat_priv->bla.work,
 			   msecs_to_jiffies(BATADV_BLA_PERIOD_LENGTH));
 }
 
@@ -1516,6 +1960,37 @@ out:
 static struct lock_class_key batadv_claim_hash_lock_class_key;
 static struct lock_class_key batadv_backbone_hash_lock_class_key;
 
+/**
+ * batadv_bla_duplist_new() - allocate and initialize the broadcast duplicate
+ *  list
+ *
+ * Return: the new list or NULL on allocation failure
+ */
+static struct batadv_bcast_duplist_bucket *batadv_bla_duplist_new(void)
+{
+	struct batadv_bcast_duplist_bucket *duplist;
+	unsigned long entrytime;
+	int i, j;
+
+	duplist = kcalloc(BATADV_DUPLIST_BUCKETS, sizeof(*duplist),
+			  GFP_ATOMIC);
+	if (!duplist)
+		return NULL;
+
+	/* mark all entries as timed out */
+	entrytime = jiffies - msecs_to_jiffies(BATADV_DUPLIST_TIMEOUT);
+
+	for (i = 0; i < BATADV_DUPLIST_BUCKETS; i++) {
+		seqcount_init(&duplist[i].seq);
+		spin_lock_init(&duplist[i].lock);
+
+		for (j = 0; j < BATADV_DUPLIST_WAYS; j++)
+			duplist[i].entries[j].entrytime = entrytime;
+	}
+
+	return duplist;
+}
+
 /**
  * batadv_bla_init() - initialize all bla structures
  * @bat_priv: the bat priv with all the soft interface information
@@ -1524,13 +1999,9 @@ static struct lock_class_key batadv_backbone_hash_lock_class_key;
  */
 int batadv_bla_init(struct batadv_priv *bat_priv)
 {
-	int i;
 	u8 claim_dest[ETH_ALEN] = {0xff, 0x43, 0x05, 0x00, 0x00, 0x00};
 	struct batadv_hard_iface *primary_if;
 	u16 crc;
-	unsigned long entrytime;
-
-	spin_lock_init(&bat_priv->bla.bcast_duplist_lock);
 
 	batadv_dbg(BATADV_DBG_BLA, bat_priv, "bla hash registering\n");
 
@@ -1546,20 +2017,20 @@ int batadv_bla_init(struct batadv_priv *bat_priv)
 		bat_priv->bla.claim_dest.group = 0; /* will be set later */
 	}
 
-	/* initialize the duplicate list */
-	entrytime = jiffies - msecs_to_jiffies(BATADV_DUPLIST_TIMEOUT);
-	for (i = 0; i < BATADV_DUPLIST_SIZE; i++)
-		bat_priv->bla.bcast_duplist[i].entrytime = entrytime;
-	bat_priv->bla.bcast_duplist_curr = 0;
-
 	atomic_set(&bat_priv->bla.loopdetect_next,
 		   BATADV_BLA_LOOPDETECT_PERIODS);
 
 	if (bat_priv->bla.claim_hash)
 		return 0;
 
-	bat_priv->bla.claim_hash = batadv_hash_new(128);
-	bat_priv->bla.backbone_hash = batadv_hash_new(32);
+	bat_priv->bla.bcast_duplist = batadv_bla_duplist_new();
+	if (!bat_priv->bla.bcast_duplist)
+		return -ENOMEM;
+
+	bat_priv->bla.claim_hash = batadv_hash_new(128,
+						   batadv_choose_claim_node);
+	bat_priv->bla.backbone_hash =
+		batadv_hash_new(32, batadv_choose_backbone_gw_node);
 
 	if (!bat_priv->bla.claim_hash || !bat_priv->bla.backbone_hash)
 		return -ENOMEM;
@@ -1573,11 +2044,82 @@ int batadv_bla_init(struct batadv_priv *bat_priv)
 
 	INIT_DELAYED_WORK(&bat_priv->bla.work, batadv_bla_periodic_work);
 
-	queue_delayed_work(batadv_event_workqueue, &bat_priv->bla.work,
+	queue_delayed_work(bat_priv->event_wq, &bat_priv->bla.work,
 			   msecs_to_jiffies(BATADV_BLA_PERIOD_LENGTH));
 	return 0;
 }
 
+/**
+ * batadv_bla_duplist_match() - search a duplicate list bucket for a broadcast
+ *  of another originator
+ * @bucket: bucket selected by the crc of the broadcast
+ * @crc: crc32 checksum of the broadcast payload
+ * @orig: mac address of the originator of the broadcast
+ *
+ * Can be called without holding the bucket lock, but the result is only valid
+ * when the seqcount of the bucket did not change in the meantime.
+ *
+ * Return: true if an entry with the same crc from another originator which
+ * did not time out yet is found, false otherwise.
+ */
+static bool
+batadv_bla_duplist_match(const struct batadv_bcast_duplist_bucket *bucket,
+			 __be32 crc, const u8 *orig)
+{
+	const struct batadv_bcast_duplist_entry *entry;
+	int i;
+
+	for (i = 0; i < BATADV_DUPLIST_WAYS; i++) {
+		entry = &bucket->entries[i];
+
+		if (entry->crc != crc)
+			continue;
+
+		if (batadv_has_timed_out(READ_ONCE(entry->entrytime),
+					 BATADV_DUPLIST_TIMEOUT))
+			continue;
+
+		if (batadv_compare_eth(entry->orig, orig))
+			continue;
+
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * batadv_bla_duplist_slot() - select the bucket entry for a new broadcast
+ * @bucket: bucket selected by the crc of the broadcast
+ * @crc: crc32 checksum of the broadcast payload
+ * @orig: mac address of the originator of the broadcast
+ *
+ * Caller must hold the bucket lock.
+ *
+ * Return: the entry of the same broadcast of the same originator if present,
+ * the oldest entry of the bucket otherwise.
+ */
+static struct batadv_bcast_duplist_entry *
+batadv_bla_duplist_slot(struct batadv_bcast_duplist_bucket *bucket,
+			__be32 crc, const u8 *orig)
+{
+	struct batadv_bcast_duplist_entry *oldest = &bucket->entries[0];
+	struct batadv_bcast_duplist_entry *entry;
+	int i;
+
+	for (i = 0; i < BATADV_DUPLIST_WAYS; i++) {
+		entry = &bucket->entries[i];
+
+		if (entry->crc == crc && batadv_compare_eth(entry->orig, orig))
+			return entry;
+
+		if (time_before(entry->entrytime, oldest->entrytime))
+			oldest = entry;
+	}
+
+	return oldest;
+}
+
 /**
  * batadv_bla_check_bcast_duplist() - Check if a frame is in the broadcast dup.
  * @bat_priv: the bat priv with all the soft interface information
@@ -1597,56 +2139,55 @@ int batadv_bla_init(struct batadv_priv *bat_priv)
 bool batadv_bla_check_bcast_duplist(struct batadv_priv *bat_priv,
 				    struct sk_buff *skb)
 {
-	int i, curr;
-	__be32 crc;
-	struct batadv_bcast_packet *bcast_packet;
+	struct batadv_bcast_duplist_bucket *bucket;
 	struct batadv_bcast_duplist_entry *entry;
-	bool ret = false;
+	struct batadv_bcast_packet *bcast_packet;
+	unsigned int seq;
+	bool ret;
+	u32 idx;
+	__be32 crc;
+
+	if (!bat_priv->bla.bcast_duplist)
+		return false;
 
 	bcast_packet = (struct batadv_bcast_packet *)skb->data;
 
 	/* calculate the crc ... */
 	crc = batadv_skb_crc32(skb, (u8 *)(bcast_packet + 1));
 
-	spin_lock_bh(&bat_priv->bla.bcast_duplist_lock);
+	/* ... which is already well distributed to select the bucket */
+	idx = (__force u32)crc & (BATADV_DUPLIST_BUCKETS - 1);
+	bucket = &bat_priv->bla.bcast_duplist[idx];
 
-	for (i = 0; i < BATADV_DUPLIST_SIZE; i++) {
-		curr = (bat_priv->bla.bcast_duplist_curr + i);
-		curr %= BATADV_DUPLIST_SIZE;
-		entry = &bat_priv->bla.bcast_duplist[curr];
+	/* duplicates can be dropped without touching the bucket lock */
+	do {
+		seq = read_seqcount_begin(&bucket->seq);
+		ret = batadv_bla_duplist_match(bucket, crc, bcast_packet->orig);
+	} while (read_seqcount_retry(&bucket->seq, seq));
 
-		/* we can stop searching if the entry is too old ;
-		 * later entries will be even older
-		 */
-		if (batadv_has_timed_out(entry->entrytime,
-					 BATADV_DUPLIST_TIMEOUT))
-			break;
-
-		if (entry->crc != crc)
-			continue;
+	if (ret)
+		return true;
 
-		if (batadv_compare_eth(entry->orig, bcast_packet->orig))
-			continue;
+	spin_lock_bh(&bucket->lock);
 
-		/* this entry seems to match: same crc, not too old,
-		 * and from another gw. therefore return true to forbid it.
-		 */
-		ret = true;
+	/* another gateway's copy might have been added in the meantime */
+	ret = batadv_bla_duplist_match(bucket, crc, bcast_packet->orig);
+	if (ret)
 		goto out;
-	}
+
 	/* not found, add a new entry (overwrite the oldest entry)
 	 * and allow it, its the first occurrence.
 	 */
-	curr = (bat_priv->bla.bcast_duplist_curr + BATADV_DUPLIST_SIZE - 1);
-	curr %= BATADV_DUPLIST_SIZE;
-	entry = &bat_priv->bla.bcast_duplist[curr];
+	entry = batadv_bla_duplist_slot(bucket, crc, bcast_packet->orig);
+
+	write_seqcount_begin(&bucket->seq);
 	entry->crc = crc;
-	entry->entrytime = jiffies;
+	WRITE_ONCE(entry->entrytime, jiffies);
 	ether_addr_copy(entry->orig, bcast_packet->orig);
-	bat_priv->bla.bcast_duplist_curr = curr;
+	write_seqcount_end(&bucket->seq);
 
 out:
-	spin_unlock_bh(&bat_priv->bla.bcast_duplist_lock);
+	spin_unlock_bh(&bucket->lock);
 
 	return ret;
 }
@@ -1666,6 +2207,7 @@ bool batadv_bla_is_backbone_gw_orig(struct batadv_priv *bat_priv, u8 *orig,
 	struct batadv_hashtable *hash = bat_priv->bla.backbone_hash;
 	struct hlist_head *head;
 	struct batadv_bla_backbone_gw *backbone_gw;
+	unsigned int seq;
 	int i;
 
 	if (!atomic_read(&bat_priv->bridge_loop_avoidance))
@@ -1674,19 +2216,25 @@ bool batadv_bla_is_backbone_gw_orig(struct batadv_priv *bat_priv, u8 *orig,
 	if (!hash)
 		return false;
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-
-		rcu_read_lock();
-		hlist_for_each_entry_rcu(backbone_gw, head, hash_entry) {
-			if (batadv_compare_eth(backbone_gw->orig, orig) &&
-			    backbone_gw->vid == vid) {
-				rcu_read_unlock();
-				return true;
+	/* a gateway moved by a resize may be missed, search again then */
+	do {
+		seq = batadv_hash_read_begin(hash);
+
+		for (i = 0; i < batadv_hash_size(hash); i++) {
+			rcu_read_lock();
+			head = batadv_hash_bucket_rcu(hash, i);
+			hlist_for_each_entry_rcu(backbone_gw, head,
+						 hash_entry) {
+				if (batadv_compare_eth(backbone_gw->orig,
+						       orig) &&
+				    backbone_gw->vid == vid) {
+					rcu_read_unlock();
+					return true;
+				}
 			}
+			rcu_read_unlock();
 		}
-		rcu_read_unlock();
-	}
+	} while (batadv_hash_read_retry(hash, seq));
 
 	return false;
 }
@@ -1748,6 +2296,10 @@ void batadv_bla_free(struct batadv_priv *bat_priv)
 		batadv_hash_destroy(bat_priv->bla.backbone_hash);
 		bat_priv->bla.backbone_hash = NULL;
 	}
+
+	kfree(bat_priv->bla.bcast_duplist);
+	bat_priv->bla.bcast_duplist = NULL;
+
 	if (primary_if)
 		batadv_hardif_put(primary_if);
 }
@@ -1795,7 +2347,7 @@ batadv_bla_loopdetect_check(struct batadv_priv *bat_priv, struct sk_buff *skb,
 	if (unlikely(!backbone_gw))
 		return true;
 
-	queue_work(batadv_event_workqueue, &backbone_gw->report_work);
+	queue_work(bat_priv->event_wq, &backbone_gw->report_work);
 	/* backbone_gw is unreferenced in the report work function function */
 
 	return true;
@@ -1820,11 +2372,11 @@ batadv_bla_loopdetect_check(struct batadv_priv *bat_priv, struct sk_buff *skb,
 bool batadv_bla_rx(struct batadv_priv *bat_priv, struct sk_buff *skb,
 		   unsigned short vid, bool is_bcast)
 {
-	struct batadv_bla_backbone_gw *backbone_gw;
 	struct ethhdr *ethhdr;
-	struct batadv_bla_claim search_claim, *claim = NULL;
+	struct batadv_bla_claim search_claim, *claim;
 	struct batadv_hard_iface *primary_if;
-	bool own_claim;
+	bool own_claim = false;
+	bool claimed = false;
 	bool ret;
 
 	ethhdr = eth_hdr(skb);
@@ -1846,9 +2398,21 @@ bool batadv_bla_rx(struct batadv_priv *bat_priv, struct sk_buff *skb,
 
 	ether_addr_copy(search_claim.addr, ethhdr->h_source);
 	search_claim.vid = vid;
-	claim = batadv_claim_hash_find(bat_priv, &search_claim);
 
-	if (!claim) {
+	/* the claim is only inspected here - no reference is needed */
+	rcu_read_lock();
+	claim = batadv_claim_hash_find_rcu(bat_priv, &search_claim);
+	if (claim) {
+		claimed = true;
+		own_claim = batadv_bla_claim_is_own(claim, primary_if);
+
+		/* our own claims are refreshed by the traffic of the client */
+		if (own_claim)
+			claim->lasttime = jiffies;
+	}
+	rcu_read_unlock();
+
+	if (!claimed) {
 		/* possible optimization: race for a claim */
 		/* No claim exists yet, claim it for us!
 		 */
@@ -1866,14 +2430,8 @@ bool batadv_bla_rx(struct batadv_priv *bat_priv, struct sk_buff *skb,
 	}
 
 	/* if it is our own claim ... */
-	backbone_gw = batadv_bla_claim_get_backbone_gw(claim);
-	own_claim = batadv_compare_eth(backbone_gw->orig,
-				       primary_if->net_dev->dev_addr);
-	batadv_backbone_gw_put(backbone_gw);
-
 	if (own_claim) {
 		/* ... allow it in any case */
-		claim->lasttime = jiffies;
 		goto allow;
 	}
 
@@ -1902,14 +2460,13 @@ allow:
 	goto out;
 
 handled:
+	batadv_inc_counter(bat_priv, BATADV_CNT_BLA_DROP);
 	kfree_skb(skb);
 	ret = true;
 
 out:
 	if (primary_if)
 		batadv_hardif_put(primary_if);
-	if (claim)
-		batadv_claim_put(claim);
 	return ret;
 }
 
@@ -1934,10 +2491,11 @@ bool batadv_bla_tx(struct batadv_priv *bat_priv, struct sk_buff *skb,
 		   unsigned short vid)
 {
 	struct ethhdr *ethhdr;
-	struct batadv_bla_claim search_claim, *claim = NULL;
-	struct batadv_bla_backbone_gw *backbone_gw;
+	struct batadv_bla_claim search_claim, *claim;
 	struct batadv_hard_iface *primary_if;
-	bool client_roamed;
+	bool client_roamed = false;
+	bool claimed = false;
+	unsigned long lasttime = 0;
 	bool ret = false;
 
 	primary_if = batadv_primary_if_get_selected(bat_priv);
@@ -1960,23 +2518,27 @@ bool batadv_bla_tx(struct batadv_priv *bat_priv, struct sk_buff *skb,
 	ether_addr_copy(search_claim.addr, ethhdr->h_source);
 	search_claim.vid = vid;
 
-	claim = batadv_claim_hash_find(bat_priv, &search_claim);
+	/* the claim is only inspected here - no reference is needed */
+	rcu_read_lock();
+	claim = batadv_claim_hash_find_rcu(bat_priv, &search_claim);
+	if (claim) {
+		claimed = true;
+
+		/* check if we are responsible. */
+		client_roamed = batadv_bla_claim_is_own(claim, primary_if);
+		lasttime = claim->lasttime;
+	}
+	rcu_read_unlock();
 
 	/* if no claim exists, allow it. */
-	if (!claim)
+	if (!claimed)
 		goto allow;
 
-	/* check if we are responsible. */
-	backbone_gw = batadv_bla_claim_get_backbone_gw(claim);
-	client_roamed = batadv_compare_eth(backbone_gw->orig,
-					   primary_if->net_dev->dev_addr);
-	batadv_backbone_gw_put(backbone_gw);
-
 	if (client_roamed) {
 		/* if yes, the client has roamed and we have
 		 * to unclaim it.
 		 */
-		if (batadv_has_timed_out(claim->lasttime, 100)) {
+		if (batadv_has_timed_out(lasttime, 100)) {
 			/* only unclaim if the last claim entry is
 			 * older than 100 ms to make sure we really
 			 * have a roaming client here.
@@ -2011,12 +2573,11 @@ allow:
 	ret = false;
 	goto out;
 handled:
+	batadv_inc_counter(bat_priv, BATADV_CNT_BLA_DROP);
 	ret = true;
 out:
 	if (primary_if)
 		batadv_hardif_put(primary_if);
-	if (claim)
-		batadv_claim_put(claim);
 	return ret;
 }
 
@@ -2053,10 +2614,9 @@ int batadv_bla_claim_table_seq_print_text(struct seq_file *seq, void *offset)
 		   ntohs(bat_priv->bla.claim_dest.group));
 	seq_puts(seq,
 		 "   Client               VID      Originator        [o] (CRC   )\n");
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-
+	for (i = 0; i < batadv_hash_size(hash); i++) {
 		rcu_read_lock();
+		head = batadv_hash_bucket_rcu(hash, i);
 		hlist_for_each_entry_rcu(claim, head, hash_entry) {
 			backbone_gw = batadv_bla_claim_get_backbone_gw(claim);
 
@@ -2149,7 +2709,8 @@ out:
  * @portid: netlink port
  * @seq: Sequence number of netlink message
  * @primary_if: primary interface
- * @head: bucket to dump
+ * @hash: hash to dump
+ * @bucket: bucket index to dump
  * @idx_skip: How many entries to skip
  *
  * Return: always 0.
@@ -2157,13 +2718,16 @@ out:
 static int
 batadv_bla_claim_dump_bucket(struct sk_buff *msg, u32 portid, u32 seq,
 			     struct batadv_hard_iface *primary_if,
-			     struct hlist_head *head, int *idx_skip)
+			     struct batadv_hashtable *hash, u32 bucket,
+			     int *idx_skip)
 {
 	struct batadv_bla_claim *claim;
+	struct hlist_head *head;
 	int idx = 0;
 	int ret = 0;
 
 	rcu_read_lock();
+	head = batadv_hash_bucket_rcu(hash, bucket);
 	hlist_for_each_entry_rcu(claim, head, hash_entry) {
 		if (idx++ < *idx_skip)
 			continue;
@@ -2198,8 +2762,8 @@ int batadv_bla_claim_dump(struct sk_buff *msg, struct netlink_callback *cb)
 	struct batadv_hashtable *hash;
 	struct batadv_priv *bat_priv;
 	int bucket = cb->args[0];
-	struct hlist_head *head;
 	int idx = cb->args[1];
+	int start = msg->len;
 	int ifindex;
 	int ret = 0;
 
@@ -2223,16 +2787,19 @@ int batadv_bla_claim_dump(struct sk_buff *msg, struct netlink_callback *cb)
 		goto out;
 	}
 
-	while (bucket < hash->size) {
-		head = &hash->table[bucket];
+	cb->seq = batadv_hash_generation(hash) << 1 | 1;
 
+	while (bucket < batadv_hash_size(hash)) {
 		if (batadv_bla_claim_dump_bucket(msg, portid,
 						 cb->nlh->nlmsg_seq,
-						 primary_if, head, &idx))
+						 primary_if, hash, bucket,
+						 &idx))
 			break;
 		bucket++;
 	}
 
+	batadv_netlink_dump_check(msg, cb, start);
+
 	cb->args[0] = bucket;
 	cb->args[1] = idx;
 
@@ -2281,10 +2848,9 @@ int batadv_bla_backbone_table_seq_print_text(struct seq_file *seq, void *offset)
 		   net_dev->name, primary_addr,
 		   ntohs(bat_priv->bla.claim_dest.group));
 	seq_puts(seq, "   Originator           VID   last seen (CRC   )\n");
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-
+	for (i = 0; i < batadv_hash_size(hash); i++) {
 		rcu_read_lock();
+		head = batadv_hash_bucket_rcu(hash, i);
 		hlist_for_each_entry_rcu(backbone_gw, head, hash_entry) {
 			msecs = jiffies_to_msecs(jiffies -
 						 backbone_gw->lasttime);
@@ -2382,7 +2948,8 @@ out:
  * @portid: netlink port
  * @seq: Sequence number of netlink message
  * @primary_if: primary interface
- * @head: bucket to dump
+ * @hash: hash to dump
+ * @bucket: bucket index to dump
  * @idx_skip: How many entries to skip
  *
  * Return: always 0.
@@ -2390,13 +2957,16 @@ out:
 static int
 batadv_bla_backbone_dump_bucket(struct sk_buff *msg, u32 portid, u32 seq,
 				struct batadv_hard_iface *primary_if,
-				struct hlist_head *head, int *idx_skip)
+				struct batadv_hashtable *hash, u32 bucket,
+				int *idx_skip)
 {
 	struct batadv_bla_backbone_gw *backbone_gw;
+	struct hlist_head *head;
 	int idx = 0;
 	int ret = 0;
 
 	rcu_read_lock();
+	head = batadv_hash_bucket_rcu(hash, bucket);
 	hlist_for_each_entry_rcu(backbone_gw, head, hash_entry) {
 		if (idx++ < *idx_skip)
 			continue;
@@ -2431,7 +3001,6 @@ int batadv_bla_backbone_dump(struct sk_buff *msg, struct netlink_callback *cb)
 	struct batadv_hashtable *hash;
 	struct batadv_priv *bat_priv;
 	int bucket = cb->args[0];
-	struct hlist_head *head;
 	int idx = cb->args[1];
 	int ifindex;
 	int ret = 0;
@@ -2456,12 +3025,11 @@ int batadv_bla_backbone_dump(struct sk_buff *msg, struct netlink_callback *cb)
 		goto out;
 	}
 
-	while (bucket < hash->size) {
-		head = &hash->table[bucket];
-
+	while (bucket < batadv_hash_size(hash)) {
 		if (batadv_bla_backbone_dump_bucket(msg, portid,
 						    cb->nlh->nlmsg_seq,
-						    primary_if, head, &idx))
+						    primary_if, hash, bucket,
+						    &idx))
 			break;
 		bucket++;
 	}
@@ -2529,3 +3097,29 @@ bool batadv_bla_check_claim(struct batadv_priv *bat_priv,
 	return ret;
 }
 #endif
+
+/**
+ * batadv_bla_cache_init() - Initialize BLA claim memory object cache
+ *
+ * Return: 0 on success or negative error number in case of failure.
+ */
+int __init batadv_bla_cache_init(void)
+{
+	size_t size = sizeof(struct batadv_bla_claim);
+
+	batadv_claim_cache =
+		kmem_cache_create("batadv_bla_claim_cache", size, 0,
+				  SLAB_HWCACHE_ALIGN, NULL);
+	if (!batadv_claim_cache)
+		return -ENOMEM;
+
+	return 0;
+}
+
+/**
+ * batadv_bla_cache_destroy() - Destroy BLA claim memory object cache
+ */
+void batadv_bla_cache_destroy(void)
+{
+	kmem_cache_destroy(batadv_claim_cache);
+}
@@ -43,6 +43,7 @@
 #include "multicast.h"
 #include "network-coding.h"
 #include "originator.h"
+#include "snapshot.h"
 #include "translation-table.h"
 
 static struct dentry *batadv_debugfs;
@@ -169,6 +170,22 @@ static int batadv_mcast_flags_open(struct inode *inode, struct file *file)
 }
 #endif
 
+/**
+ * batadv_snapshot_open() - prepare file handler for reads from snapshot
+ * @inode: inode which was opened
+ * @file: file handle to be initialized
+ *
+ * Return: 0 on success or negative error number in case of failure
+ */
+static int batadv_snapshot_open(struct inode *inode, struct file *file)
+{
+	struct net_device *net_dev = (struct net_device *)inode->i_private;
+	struct batadv_priv *bat_priv = netdev_priv(net_dev);
+
+	return single_open_size(file, batadv_snapshot_seq_print, net_dev,
+				batadv_snapshot_size(bat_priv));
+}
+
 #define BATADV_DEBUGINFO(_name, _mode, _open)		\
 struct batadv_debuginfo batadv_debuginfo_##_name = {	\
 	.attr = {					\
@@ -214,6 +231,7 @@ static BATADV_DEBUGINFO(nc_nodes, 0444, batadv_nc_nodes_open);
 #ifdef CONFIG_BATMAN_ADV_MCAST
 static BATADV_DEBUGINFO(mcast_flags, 0444, batadv_mcast_flags_open);
 #endif
+static BATADV_DEBUGINFO(snapshot, 0400, batadv_snapshot_open);
 
 static struct batadv_debuginfo *batadv_mesh_debuginfos[] = {
 	&batadv_debuginfo_neighbors,
@@ -234,6 +252,7 @@ static struct batadv_debuginfo *batadv_mesh_debuginfos[] = {
 #ifdef CONFIG_BATMAN_ADV_MCAST
 	&batadv_debuginfo_mcast_flags,
 #endif
+	&batadv_debuginfo_snapshot,
 	NULL,
 };
 
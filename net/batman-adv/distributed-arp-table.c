@@ -22,6 +22,7 @@
 #include <linux/atomic.h>
 #include <linux/bitops.h>
 #include <linux/byteorder/generic.h>
+#include <linux/cache.h>
 #include <linux/errno.h>
 #include <linux/etherdevice.h>
 #include <linux/gfp.h>
@@ -29,6 +30,8 @@
 #include <linux/if_ether.h>
 #include <linux/if_vlan.h>
 #include <linux/in.h>
+#include <linux/in6.h>
+#include <linux/ipv6.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
 #include <linux/kref.h>
@@ -36,15 +39,20 @@
 #include <linux/netlink.h>
 #include <linux/rculist.h>
 #include <linux/rcupdate.h>
+#include <linux/sched.h>
 #include <linux/seq_file.h>
 #include <linux/skbuff.h>
 #include <linux/slab.h>
+#include <linux/socket.h>
 #include <linux/spinlock.h>
 #include <linux/stddef.h>
 #include <linux/string.h>
 #include <linux/workqueue.h>
 #include <net/arp.h>
 #include <net/genetlink.h>
+#include <net/ip6_checksum.h>
+#include <net/ipv6.h>
+#include <net/ndisc.h>
 #include <net/netlink.h>
 #include <net/sock.h>
 #include <uapi/linux/batman_adv.h>
@@ -57,9 +65,12 @@
 #include "originator.h"
 #include "send.h"
 #include "soft-interface.h"
+#include "trace.h"
 #include "translation-table.h"
 #include "tvlv.h"
 
+static struct kmem_cache *batadv_dat_cache __read_mostly;
+
 static void batadv_dat_purge(struct work_struct *work);
 
 /**
@@ -69,10 +80,23 @@ static void batadv_dat_purge(struct work_struct *work);
 static void batadv_dat_start_timer(struct batadv_priv *bat_priv)
 {
 	INIT_DELAYED_WORK(&bat_priv->dat.work, batadv_dat_purge);
-	queue_delayed_work(batadv_event_workqueue, &bat_priv->dat.work,
+	queue_delayed_work(bat_priv->event_wq, &bat_priv->dat.work,
 			   msecs_to_jiffies(10000));
 }
 
+/**
+ * batadv_dat_entry_free_rcu() - free the dat_entry
+ * @rcu: rcu pointer of the dat_entry
+ */
+static void batadv_dat_entry_free_rcu(struct rcu_head *rcu)
+{
+	struct batadv_dat_entry *dat_entry;
+
+	dat_entry = container_of(rcu, struct batadv_dat_entry, rcu);
+
+	kmem_cache_free(batadv_dat_cache, dat_entry);
+}
+
 /**
  * batadv_dat_entry_release() - release dat_entry from lists and queue for free
  *  after rcu grace period
@@ -84,7 +108,7 @@ static void batadv_dat_entry_release(struct kref *ref)
 
 	dat_entry = container_of(ref, struct batadv_dat_entry, refcount);
 
-	kfree_rcu(dat_entry, rcu);
+	call_rcu(&dat_entry->rcu, batadv_dat_entry_free_rcu);
 }
 
 /**
@@ -123,32 +147,125 @@ static bool batadv_dat_to_purge(struct batadv_dat_entry *dat_entry)
 static void __batadv_dat_purge(struct batadv_priv *bat_priv,
 			       bool (*to_purge)(struct batadv_dat_entry *))
 {
+	struct batadv_hashtable *hash = bat_priv->dat.hash;
 	spinlock_t *list_lock; /* protects write access to the hash lists */
 	struct batadv_dat_entry *dat_entry;
 	struct hlist_node *node_tmp;
 	struct hlist_head *head;
 	u32 i;
 
-	if (!bat_priv->dat.hash)
+	if (!hash)
 		return;
 
-	for (i = 0; i < bat_priv->dat.hash->size; i++) {
-		head = &bat_priv->dat.hash->table[i];
-		list_lock = &bat_priv->dat.hash->list_locks[i];
-
-		spin_lock_bh(list_lock);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
+		head = batadv_hash_lock_bucket(hash, i, &list_lock);
 		hlist_for_each_entry_safe(dat_entry, node_tmp, head,
 					  hash_entry) {
 			/* if a helper function has been passed as parameter,
 			 * ask it if the entry has to be purged or not
 			 */
-			if (to_purge && !to_purge(dat_entry))
+			if (to_purge && !to_purge(dat_entry)) {
+				batadv_hash_age_note(hash,
+						     dat_entry->last_update);
+				continue;
+			}
+
+			batadv_hash_del(hash, &dat_entry->hash_entry);
+			batadv_dat_entry_put(dat_entry);
+		}
+		batadv_hash_unlock_bucket(hash, list_lock);
+	}
+}
+
+/**
+ * batadv_dat_entry_dbg() - print a debug message about a dat_entry
+ * @bat_priv: the bat priv with all the soft interface information
+ * @msg: message to print together with the entry
+ * @dat_entry: the entry to print
+ */
+static void batadv_dat_entry_dbg(struct batadv_priv *bat_priv, const char *msg,
+				 const struct batadv_dat_entry *dat_entry)
+{
+	if (dat_entry->family == AF_INET6)
+		batadv_dbg(BATADV_DBG_DAT, bat_priv,
+			   "%s: %pI6c %pM (vid: %d)\n", msg, &dat_entry->ip6,
+			   dat_entry->mac_addr,
+			   batadv_print_vid(dat_entry->vid));
+	else
+		batadv_dbg(BATADV_DBG_DAT, bat_priv,
+			   "%s: %pI4 %pM (vid: %d)\n", msg, &dat_entry->ip,
+			   dat_entry->mac_addr,
+			   batadv_print_vid(dat_entry->vid));
+}
+
+/**
+ * batadv_dat_evict() - remove one rarely used entry from the local DAT storage
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * Implements a CLOCK approximation of LRU: the buckets are visited round-robin
+ * starting at &batadv_priv_dat.clock_hand. Referenced entries get a second
+ * chance by clearing their referenced flag, the first entry which was not
+ * used since the last visit is removed.
+ *
+ * Return: true if an entry was removed, false otherwise
+ */
+static bool batadv_dat_evict(struct batadv_priv *bat_priv)
+{
+	struct batadv_hashtable *hash = bat_priv->dat.hash;
+	spinlock_t *list_lock; /* protects write access to the hash lists */
+	struct batadv_dat_entry *dat_entry;
+	struct hlist_head *head;
+	bool evicted = false;
+	u32 size, i, n;
+
+	size = batadv_hash_size(hash);
+
+	/* the second round finds the entries unreferenced by the first one */
+	for (n = 0; n < 2 * size && !evicted; n++) {
+		i = (u32)atomic_inc_return(&bat_priv->dat.clock_hand) % size;
+
+		head = batadv_hash_lock_bucket(hash, i, &list_lock);
+		hlist_for_each_entry(dat_entry, head, hash_entry) {
+			if (READ_ONCE(dat_entry->referenced)) {
+				WRITE_ONCE(dat_entry->referenced, false);
 				continue;
+			}
 
-			hlist_del_rcu(&dat_entry->hash_entry);
+			batadv_dat_entry_dbg(bat_priv, "Entry evicted",
+					     dat_entry);
+
+			batadv_hash_del(hash, &dat_entry->hash_entry);
 			batadv_dat_entry_put(dat_entry);
+			evicted = true;
+			break;
 		}
-		spin_unlock_bh(list_lock);
+		batadv_hash_unlock_bucket(hash, list_lock);
+	}
+
+	if (evicted)
+		batadv_inc_counter(bat_priv, BATADV_CNT_DAT_CACHE_EVICT);
+
+	return evicted;
+}
+
+/**
+ * batadv_dat_shrink() - evict entries until the local DAT storage is within
+ *  its configured maximum size again
+ * @bat_priv: the bat priv with all the soft interface information
+ */
+static void batadv_dat_shrink(struct batadv_priv *bat_priv)
+{
+	struct batadv_hashtable *hash = bat_priv->dat.hash;
+	int max_entries = atomic_read(&bat_priv->dat.max_entries);
+
+	if (max_entries == 0)
+		return;
+
+	while (atomic_read(&hash->count) > max_entries) {
+		if (!batadv_dat_evict(bat_priv))
+			break;
+
+		cond_resched();
 	}
 }
 
@@ -162,15 +279,45 @@ static void batadv_dat_purge(struct work_struct *work)
 	struct delayed_work *delayed_work;
 	struct batadv_priv_dat *priv_dat;
 	struct batadv_priv *bat_priv;
+	u64 start = 0;
+
+	if (trace_batadv_purge_dat_enabled())
+		start = batadv_trace_clock();
 
 	delayed_work = to_delayed_work(work);
 	priv_dat = container_of(delayed_work, struct batadv_priv_dat, work);
 	bat_priv = container_of(priv_dat, struct batadv_priv, dat);
 
-	__batadv_dat_purge(bat_priv, batadv_dat_to_purge);
+	if (batadv_hash_age_purge_begin(bat_priv->dat.hash,
+					BATADV_DAT_ENTRY_TIMEOUT))
+		__batadv_dat_purge(bat_priv, batadv_dat_to_purge);
+
+	/* adding only evicts one entry, catch up after the limit was lowered */
+	batadv_dat_shrink(bat_priv);
+
+	trace_batadv_purge_dat(bat_priv->soft_iface, start);
 	batadv_dat_start_timer(bat_priv);
 }
 
+/**
+ * batadv_dat_entry_match() - check whether a dat_entry stores a given address
+ * @dat_entry: the entry to check
+ * @key: entry holding the address family and IP address to look for
+ *
+ * Return: true if both refer to the same IP address, false otherwise.
+ */
+static bool batadv_dat_entry_match(const struct batadv_dat_entry *dat_entry,
+				   const struct batadv_dat_entry *key)
+{
+	if (dat_entry->family != key->family)
+		return false;
+
+	if (key->family == AF_INET6)
+		return ipv6_addr_equal(&dat_entry->ip6, &key->ip6);
+
+	return dat_entry->ip == key->ip;
+}
+
 /**
  * batadv_compare_dat() - comparing function used in the local DAT hash table
  * @node: node in the local table
@@ -180,10 +327,11 @@ static void batadv_dat_purge(struct work_struct *work)
  */
 static bool batadv_compare_dat(const struct hlist_node *node, const void *data2)
 {
-	const void *data1 = container_of(node, struct batadv_dat_entry,
-					 hash_entry);
+	const struct batadv_dat_entry *data1;
+
+	data1 = container_of(node, struct batadv_dat_entry, hash_entry);
 
-	return memcmp(data1, data2, sizeof(__be32)) == 0;
+	return batadv_dat_entry_match(data1, data2);
 }
 
 /**
@@ -244,6 +392,9 @@ static __be32 batadv_arp_ip_dst(struct sk_buff *skb, int hdr_size)
  * @data: data to hash
  * @size: size of the hash table
  *
+ * IPv4 addresses are hashed exactly as by nodes without neighbor discovery
+ * support, all nodes have to agree on the DHT address of a key.
+ *
  * Return: the selected index in the hash table for the given data.
  */
 static u32 batadv_hash_dat(const void *data, u32 size)
@@ -251,10 +402,18 @@ static u32 batadv_hash_dat(const void *data, u32 size)
 	u32 hash = 0;
 	const struct batadv_dat_entry *dat = data;
 	const unsigned char *key;
+	size_t key_len;
 	u32 i;
 
-	key = (const unsigned char *)&dat->ip;
-	for (i = 0; i < sizeof(dat->ip); i++) {
+	if (dat->family == AF_INET6) {
+		key = (const unsigned char *)&dat->ip6;
+		key_len = sizeof(dat->ip6);
+	} else {
+		key = (const unsigned char *)&dat->ip;
+		key_len = sizeof(dat->ip);
+	}
+
+	for (i = 0; i < key_len; i++) {
 		hash += key[i];
 		hash += (hash << 10);
 		hash ^= (hash >> 6);
@@ -274,6 +433,92 @@ static u32 batadv_hash_dat(const void *data, u32 size)
 	return hash % size;
 }
 
+/**
+ * batadv_hash_dat_node() - compute the hash value for a stored dat entry
+ * @node: hash_entry of the dat entry
+ * @size: size of the hash table
+ *
+ * Return: the selected index in the hash table for the given dat entry.
+ */
+static u32 batadv_hash_dat_node(const struct hlist_node *node, u32 size)
+{
+	const struct batadv_dat_entry *dat_entry;
+
+	dat_entry = container_of(node, struct batadv_dat_entry, hash_entry);
+
+	return batadv_hash_dat(dat_entry, size);
+}
+
+/**
+ * batadv_dat_key_ip4() - initialise the lookup key of an IPv4 address
+ * @key: the key to initialise
+ * @ip: the IPv4 address
+ * @vid: VLAN identifier
+ */
+static void batadv_dat_key_ip4(struct batadv_dat_entry *key, __be32 ip,
+			       unsigned short vid)
+{
+	key->family = AF_INET;
+	key->ip = ip;
+	key->vid = vid;
+}
+
+/**
+ * batadv_dat_key_ip6() - initialise the lookup key of an IPv6 address
+ * @key: the key to initialise
+ * @ip6: the IPv6 address
+ * @vid: VLAN identifier
+ */
+static void batadv_dat_key_ip6(struct batadv_dat_entry *key,
+			       const struct in6_addr *ip6, unsigned short vid)
+{
+	key->family = AF_INET6;
+	key->ip6 = *ip6;
+	key->vid = vid;
+}
+
+/**
+ * __batadv_dat_entry_hash_find() - look for a given dat_entry in the local
+ *  hash table
+ * @bat_priv: the bat priv with all the soft interface information
+ * @to_find: search key initialised by batadv_dat_key_ip4() or
+ *  batadv_dat_key_ip6()
+ *
+ * Return: the dat_entry if found, NULL otherwise.
+ */
+static struct batadv_dat_entry *
+__batadv_dat_entry_hash_find(struct batadv_priv *bat_priv,
+			     const struct batadv_dat_entry *to_find)
+{
+	struct hlist_head *head;
+	struct batadv_dat_entry *dat_entry, *dat_entry_tmp = NULL;
+	struct batadv_hashtable *hash = bat_priv->dat.hash;
+	unsigned int seq;
+
+	if (!hash)
+		return NULL;
+
+	rcu_read_lock();
+	do {
+		seq = batadv_hash_read_begin(hash);
+		head = batadv_hash_head_rcu(hash, batadv_hash_dat, to_find);
+
+		hlist_for_each_entry_rcu(dat_entry, head, hash_entry) {
+			if (!batadv_dat_entry_match(dat_entry, to_find))
+				continue;
+
+			if (!kref_get_unless_zero(&dat_entry->refcount))
+				continue;
+
+			dat_entry_tmp = dat_entry;
+			break;
+		}
+	} while (!dat_entry_tmp && batadv_hash_read_retry(hash, seq));
+	rcu_read_unlock();
+
+	return dat_entry_tmp;
+}
+
 /**
  * batadv_dat_entry_hash_find() - look for a given dat_entry in the local hash
  * table
@@ -287,68 +532,152 @@ static struct batadv_dat_entry *
 batadv_dat_entry_hash_find(struct batadv_priv *bat_priv, __be32 ip,
 			   unsigned short vid)
 {
-	struct hlist_head *head;
-	struct batadv_dat_entry to_find, *dat_entry, *dat_entry_tmp = NULL;
-	struct batadv_hashtable *hash = bat_priv->dat.hash;
-	u32 index;
+	struct batadv_dat_entry to_find;
 
-	if (!hash)
-		return NULL;
+	batadv_dat_key_ip4(&to_find, ip, vid);
 
-	to_find.ip = ip;
-	to_find.vid = vid;
+	return __batadv_dat_entry_hash_find(bat_priv, &to_find);
+}
 
-	index = batadv_hash_dat(&to_find, hash->size);
-	head = &hash->table[index];
+/**
+ * batadv_dat_entry6_hash_find() - look for the dat_entry of an IPv6 address
+ *  in the local hash table
+ * @bat_priv: the bat priv with all the soft interface information
+ * @ip6: search key
+ * @vid: VLAN identifier
+ *
+ * Return: the dat_entry if found, NULL otherwise.
+ */
+static struct batadv_dat_entry *
+batadv_dat_entry6_hash_find(struct batadv_priv *bat_priv,
+			    const struct in6_addr *ip6, unsigned short vid)
+{
+	struct batadv_dat_entry to_find;
 
-	rcu_read_lock();
-	hlist_for_each_entry_rcu(dat_entry, head, hash_entry) {
-		if (dat_entry->ip != ip)
-			continue;
+	batadv_dat_key_ip6(&to_find, ip6, vid);
 
-		if (!kref_get_unless_zero(&dat_entry->refcount))
-			continue;
+	return __batadv_dat_entry_hash_find(bat_priv, &to_find);
+}
 
-		dat_entry_tmp = dat_entry;
-		break;
+/**
+ * __batadv_dat_entry_lookup() - look up the dat_entry used to answer an ARP
+ *  request or a neighbor solicitation
+ * @bat_priv: the bat priv with all the soft interface information
+ * @to_find: search key initialised by batadv_dat_key_ip4() or
+ *  batadv_dat_key_ip6()
+ *
+ * In contrast to __batadv_dat_entry_hash_find(), the entry is marked as used
+ * for the eviction and the lookup is accounted in the cache hit/miss counters.
+ *
+ * Return: the dat_entry if found, NULL otherwise.
+ */
+static struct batadv_dat_entry *
+__batadv_dat_entry_lookup(struct batadv_priv *bat_priv,
+			  const struct batadv_dat_entry *to_find)
+{
+	struct batadv_dat_entry *dat_entry;
+
+	dat_entry = __batadv_dat_entry_hash_find(bat_priv, to_find);
+	if (!dat_entry) {
+		batadv_inc_counter(bat_priv, BATADV_CNT_DAT_CACHE_MISS);
+		return NULL;
 	}
-	rcu_read_unlock();
 
-	return dat_entry_tmp;
+	if (!READ_ONCE(dat_entry->referenced))
+		WRITE_ONCE(dat_entry->referenced, true);
+
+	batadv_inc_counter(bat_priv, BATADV_CNT_DAT_CACHE_HIT);
+
+	return dat_entry;
 }
 
 /**
- * batadv_dat_entry_add() - add a new dat entry or update it if already exists
+ * batadv_dat_entry_lookup() - look up the dat_entry used to answer an ARP
+ *  request
  * @bat_priv: the bat priv with all the soft interface information
- * @ip: ipv4 to add/edit
- * @mac_addr: mac address to assign to the given ipv4
+ * @ip: search key
  * @vid: VLAN identifier
+ *
+ * Return: the dat_entry if found, NULL otherwise.
  */
-static void batadv_dat_entry_add(struct batadv_priv *bat_priv, __be32 ip,
-				 u8 *mac_addr, unsigned short vid)
+static struct batadv_dat_entry *
+batadv_dat_entry_lookup(struct batadv_priv *bat_priv, __be32 ip,
+			unsigned short vid)
+{
+	struct batadv_dat_entry to_find;
+
+	batadv_dat_key_ip4(&to_find, ip, vid);
+
+	return __batadv_dat_entry_lookup(bat_priv, &to_find);
+}
+
+/**
+ * batadv_dat_entry6_lookup() - look up the dat_entry used to answer a neighbor
+ *  solicitation
+ * @bat_priv: the bat priv with all the soft interface information
+ * @ip6: search key
+ * @vid: VLAN identifier
+ *
+ * Return: the dat_entry if found, NULL otherwise.
+ */
+static struct batadv_dat_entry *
+batadv_dat_entry6_lookup(struct batadv_priv *bat_priv,
+			 const struct in6_addr *ip6, unsigned short vid)
+{
+	struct batadv_dat_entry to_find;
+
+	batadv_dat_key_ip6(&to_find, ip6, vid);
+
+	return __batadv_dat_entry_lookup(bat_priv, &to_find);
+}
+
+/**
+ * __batadv_dat_entry_add() - add a new dat entry or update it if already exists
+ * @bat_priv: the bat priv with all the soft interface information
+ * @key: IP address to add/edit, initialised by batadv_dat_key_ip4() or
+ *  batadv_dat_key_ip6()
+ * @mac_addr: mac address to assign to the given IP address
+ * @router: the owner of an IPv6 address announced itself as router
+ */
+static void __batadv_dat_entry_add(struct batadv_priv *bat_priv,
+				   const struct batadv_dat_entry *key,
+				   u8 *mac_addr, bool router)
 {
 	struct batadv_dat_entry *dat_entry;
+	int max_entries;
 	int hash_added;
 
-	dat_entry = batadv_dat_entry_hash_find(bat_priv, ip, vid);
+	dat_entry = __batadv_dat_entry_hash_find(bat_priv, key);
 	/* if this entry is already known, just update it */
 	if (dat_entry) {
 		if (!batadv_compare_eth(dat_entry->mac_addr, mac_addr))
 			ether_addr_copy(dat_entry->mac_addr, mac_addr);
+		dat_entry->router = router;
 		dat_entry->last_update = jiffies;
-		batadv_dbg(BATADV_DBG_DAT, bat_priv,
-			   "Entry updated: %pI4 %pM (vid: %d)\n",
-			   &dat_entry->ip, dat_entry->mac_addr,
-			   batadv_print_vid(vid));
+		batadv_dat_entry_dbg(bat_priv, "Entry updated", dat_entry);
 		goto out;
 	}
 
-	dat_entry = kmalloc(sizeof(*dat_entry), GFP_ATOMIC);
+	max_entries = atomic_read(&bat_priv->dat.max_entries);
+	if (max_entries > 0 &&
+	    atomic_read(&bat_priv->dat.hash->count) >= max_entries)
+		batadv_dat_evict(bat_priv);
+
+	dat_entry = kmem_cache_alloc(batadv_dat_cache, GFP_ATOMIC);
 	if (!dat_entry)
 		goto out;
 
-	dat_entry->ip = ip;
-	dat_entry->vid = vid;
+	dat_entry->family = key->family;
+	if (key->family == AF_INET6) {
+		dat_entry->ip = 0;
+		dat_entry->ip6 = key->ip6;
+	} else {
+		dat_entry->ip = key->ip;
+		memset(&dat_entry->ip6, 0, sizeof(dat_entry->ip6));
+	}
+	dat_entry->vid = key->vid;
+	dat_entry->router = router;
+	dat_entry->referenced = false;
 	ether_addr_copy(dat_entry->mac_addr, mac_addr);
 	dat_entry->last_update = jiffies;
 	kref_init(&dat_entry->refcount);
@@ -364,14 +693,48 @@ static void batadv_dat_entry_add(struct batadv_priv *bat_priv, __be32 ip,
 		goto out;
 	}
 
-	batadv_dbg(BATADV_DBG_DAT, bat_priv, "New entry added: %pI4 %pM (vid: %d)\n",
-		   &dat_entry->ip, dat_entry->mac_addr, batadv_print_vid(vid));
+	batadv_dat_entry_dbg(bat_priv, "New entry added", dat_entry);
 
 out:
 	if (dat_entry)
 		batadv_dat_entry_put(dat_entry);
 }
 
+/**
+ * batadv_dat_entry_add() - add a new dat entry or update it if already exists
+ * @bat_priv: the bat priv with all the soft interface information
+ * @ip: ipv4 to add/edit
+ * @mac_addr: mac address to assign to the given ipv4
+ * @vid: VLAN identifier
+ */
+static void batadv_dat_entry_add(struct batadv_priv *bat_priv, __be32 ip,
+				 u8 *mac_addr, unsigned short vid)
+{
+	struct batadv_dat_entry key;
+
+	batadv_dat_key_ip4(&key, ip, vid);
+	__batadv_dat_entry_add(bat_priv, &key, mac_addr, false);
+}
+
+/**
+ * batadv_dat_entry6_add() - add a new IPv6 dat entry or update it if already
+ *  exists
+ * @bat_priv: the bat priv with all the soft interface information
+ * @ip6: IPv6 address to add/edit
+ * @mac_addr: mac address to assign to the given IPv6 address
+ * @vid: VLAN identifier
+ * @router: the owner of @ip6 announced itself as router
+ */
+static void batadv_dat_entry6_add(struct batadv_priv *bat_priv,
+				  const struct in6_addr *ip6, u8 *mac_addr,
+				  unsigned short vid, bool router)
+{
+	struct batadv_dat_entry key;
+
+	batadv_dat_key_ip6(&key, ip6, vid);
+	__batadv_dat_entry_add(bat_priv, &key, mac_addr, router);
+}
+
 #ifdef CONFIG_BATMAN_ADV_DEBUG
 
 /**
@@ -457,144 +820,61 @@ static void batadv_dbg_arp(struct batadv_priv *bat_priv, struct sk_buff *skb,
 #endif /* CONFIG_BATMAN_ADV_DEBUG */
 
 /**
- * batadv_is_orig_node_eligible() - check whether a node can be a DHT candidate
- * @res: the array with the already selected candidates
- * @select: number of already selected candidates
- * @tmp_max: address of the currently evaluated node
- * @max: current round max address
- * @last_max: address of the last selected candidate
- * @candidate: orig_node under evaluation
- * @max_orig_node: last selected candidate
- *
- * Return: true if the node has been elected as next candidate or false
- * otherwise.
- */
-static bool batadv_is_orig_node_eligible(struct batadv_dat_candidate *res,
-					 int select, batadv_dat_addr_t tmp_max,
-					 batadv_dat_addr_t max,
-					 batadv_dat_addr_t last_max,
-					 struct batadv_orig_node *candidate,
-					 struct batadv_orig_node *max_orig_node)
-{
-	bool ret = false;
-	int j;
-
-	/* check if orig node candidate is running DAT */
-	if (!test_bit(BATADV_ORIG_CAPA_HAS_DAT, &candidate->capabilities))
-		goto out;
-
-	/* Check if this node has already been selected... */
-	for (j = 0; j < select; j++)
-		if (res[j].orig_node == candidate)
-			break;
-	/* ..and possibly skip it */
-	if (j < select)
-		goto out;
-	/* sanity check: has it already been selected? This should not happen */
-	if (tmp_max > last_max)
-		goto out;
-	/* check if during this iteration an originator with a closer dht
-	 * address has already been found
-	 */
-	if (tmp_max < max)
-		goto out;
-	/* this is an hash collision with the temporary selected node. Choose
-	 * the one with the lowest address
-	 */
-	if (tmp_max == max && max_orig_node &&
-	    batadv_compare_eth(candidate->orig, max_orig_node->orig))
-		goto out;
-
-	ret = true;
-out:
-	return ret;
-}
-
-/**
- * batadv_choose_next_candidate() - select the next DHT candidate
- * @bat_priv: the bat priv with all the soft interface information
- * @cands: candidates array
- * @select: number of candidates already present in the array
+ * batadv_dat_ring_first() - find the first originator of the DHT ring at or
+ *  after a given DHT address
+ * @ring: DHT address sorted originator index
  * @ip_key: key to look up in the DHT
- * @last_max: pointer where the address of the selected candidate will be saved
+ *
+ * Return: index of the first originator in @ring with a DHT address larger or
+ * equal to @ip_key or 0 when the lookup has to wrap around.
  */
-static void batadv_choose_next_candidate(struct batadv_priv *bat_priv,
-					 struct batadv_dat_candidate *cands,
-					 int select, batadv_dat_addr_t ip_key,
-					 batadv_dat_addr_t *last_max)
+static u32 batadv_dat_ring_first(const struct batadv_orig_dat_ring *ring,
+				 batadv_dat_addr_t ip_key)
 {
-	batadv_dat_addr_t max = 0;
-	batadv_dat_addr_t tmp_max = 0;
-	struct batadv_orig_node *orig_node, *max_orig_node = NULL;
-	struct batadv_hashtable *hash = bat_priv->orig_hash;
-	struct hlist_head *head;
-	int i;
-
-	/* if no node is eligible as candidate, leave the candidate type as
-	 * NOT_FOUND
-	 */
-	cands[select].type = BATADV_DAT_CANDIDATE_NOT_FOUND;
+	u32 low = 0;
+	u32 high = ring->num;
+	u32 mid;
 
-	/* iterate over the originator list and find the node with the closest
-	 * dat_address which has not been selected yet
-	 */
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
+	while (low < high) {
+		mid = low + (high - low) / 2;
 
-		rcu_read_lock();
-		hlist_for_each_entry_rcu(orig_node, head, hash_entry) {
-			/* the dht space is a ring using unsigned addresses */
-			tmp_max = BATADV_DAT_ADDR_MAX - orig_node->dat_addr +
-				  ip_key;
-
-			if (!batadv_is_orig_node_eligible(cands, select,
-							  tmp_max, max,
-							  *last_max, orig_node,
-							  max_orig_node))
-				continue;
+		if (ring->nodes[mid]->dat_addr < ip_key)
+			low = mid + 1;
+		else
+			high = mid;
+	}
 
-			if (!kref_get_unless_zero(&orig_node->refcount))
-				continue;
+	if (low == ring->num)
+		low = 0;
 
-			max = tmp_max;
-			if (max_orig_node)
-				batadv_orig_node_put(max_orig_node);
-			max_orig_node = orig_node;
-		}
-		rcu_read_unlock();
-	}
-	if (max_orig_node) {
-		cands[select].type = BATADV_DAT_CANDIDATE_ORIG;
-		cands[select].orig_node = max_orig_node;
-		batadv_dbg(BATADV_DBG_DAT, bat_priv,
-			   "dat_select_candidates() %d: selected %pM addr=%u dist=%u\n",
-			   select, max_orig_node->orig, max_orig_node->dat_addr,
-			   max);
-	}
-	*last_max = max;
+	return low;
 }
 
 /**
  * batadv_dat_select_candidates() - select the nodes which the DHT message has
  *  to be sent to
  * @bat_priv: the bat priv with all the soft interface information
- * @ip_dst: ipv4 to look up in the DHT
- * @vid: VLAN identifier
+ * @key: IP address to look up in the DHT, initialised by batadv_dat_key_ip4()
+ *  or batadv_dat_key_ip6()
  *
  * An originator O is selected if and only if its DHT_ID value is one of three
  * closest values (from the LEFT, with wrap around if needed) then the hash
- * value of the key. ip_dst is the key.
+ * value of the key. IPv6 keys only select originators which announced
+ * neighbor discovery support.
  *
  * Return: the candidate array of size BATADV_DAT_CANDIDATE_NUM.
  */
 static struct batadv_dat_candidate *
-batadv_dat_select_candidates(struct batadv_priv *bat_priv, __be32 ip_dst,
-			     unsigned short vid)
+batadv_dat_select_candidates(struct batadv_priv *bat_priv,
+			     const struct batadv_dat_entry *key)
 {
-	int select;
-	batadv_dat_addr_t last_max = BATADV_DAT_ADDR_MAX, ip_key;
+	struct batadv_orig_dat_ring *ring;
+	struct batadv_orig_node *orig_node;
 	struct batadv_dat_candidate *res;
-	struct batadv_dat_entry dat;
+	batadv_dat_addr_t ip_key, dist;
+	int capa = BATADV_ORIG_CAPA_HAS_DAT;
+	int select = 0;
+	u32 first, i;
 
 	if (!bat_priv->orig_hash)
 		return NULL;
@@ -604,28 +884,69 @@ batadv_dat_select_candidates(struct batadv_priv *bat_priv, __be32 ip_dst,
 	if (!res)
 		return NULL;
 
-	dat.ip = ip_dst;
-	dat.vid = vid;
-	ip_key = (batadv_dat_addr_t)batadv_hash_dat(&dat,
-						    BATADV_DAT_ADDR_MAX);
+	ip_key = (batadv_dat_addr_t)batadv_hash_dat(key, BATADV_DAT_ADDR_MAX);
 
-	batadv_dbg(BATADV_DBG_DAT, bat_priv,
-		   "%s(): IP=%pI4 hash(IP)=%u\n", __func__, &ip_dst,
-		   ip_key);
+	if (key->family == AF_INET6) {
+		capa = BATADV_ORIG_CAPA_HAS_DAT_ND;
+		batadv_dbg(BATADV_DBG_DAT, bat_priv,
+			   "%s(): IP=%pI6c hash(IP)=%u\n", __func__, &key->ip6,
+			   ip_key);
+	} else {
+		batadv_dbg(BATADV_DBG_DAT, bat_priv,
+			   "%s(): IP=%pI4 hash(IP)=%u\n", __func__, &key->ip,
+			   ip_key);
+	}
+
+	/* the DHT space is a ring using unsigned addresses: walk the sorted
+	 * originators starting at the closest address to the key (from the
+	 * LEFT) and pick the first ones running DAT
+	 */
+	rcu_read_lock();
+	ring = rcu_dereference(bat_priv->dat.ring);
+	if (!ring || ring->num == 0)
+		goto unlock;
 
-	for (select = 0; select < BATADV_DAT_CANDIDATES_NUM; select++)
-		batadv_choose_next_candidate(bat_priv, res, select, ip_key,
-					     &last_max);
+	first = batadv_dat_ring_first(ring, ip_key);
+
+	for (i = 0; i < ring->num; i++) {
+		if (select == BATADV_DAT_CANDIDATES_NUM)
+			break;
+
+		orig_node = ring->nodes[(first + i) % ring->num];
+
+		if (!test_bit(capa, &orig_node->capabilities))
+			continue;
+
+		if (!kref_get_unless_zero(&orig_node->refcount))
+			continue;
+
+		res[select].type = BATADV_DAT_CANDIDATE_ORIG;
+		res[select].orig_node = orig_node;
+
+		dist = BATADV_DAT_ADDR_MAX - orig_node->dat_addr + ip_key;
+		batadv_dbg(BATADV_DBG_DAT, bat_priv,
+			   "dat_select_candidates() %d: selected %pM addr=%u dist=%u\n",
+			   select, orig_node->orig, orig_node->dat_addr, dist);
+		select++;
+	}
+unlock:
+	rcu_read_unlock();
+
+	/* if no more nodes are eligible as candidates, leave the remaining
+	 * candidate types as NOT_FOUND
+	 */
+	for (; select < BATADV_DAT_CANDIDATES_NUM; select++)
+		res[select].type = BATADV_DAT_CANDIDATE_NOT_FOUND;
 
 	return res;
 }
 
 /**
- * batadv_dat_send_data() - send a payload to the selected candidates
+ * __batadv_dat_send_data() - send a payload to the selected candidates
  * @bat_priv: the bat priv with all the soft interface information
  * @skb: payload to send
- * @ip: the DHT key
- * @vid: VLAN identifier
+ * @key: the DHT key, initialised by batadv_dat_key_ip4() or
+ *  batadv_dat_key_ip6()
  * @packet_subtype: unicast4addr packet subtype to use
  *
  * This function copies the skb with pskb_copy() and is sent as unicast packet
@@ -634,9 +955,10 @@ batadv_dat_select_candidates(struct batadv_priv *bat_priv, __be32 ip_dst,
  * Return: true if the packet is sent to at least one candidate, false
  * otherwise.
  */
-static bool batadv_dat_send_data(struct batadv_priv *bat_priv,
-				 struct sk_buff *skb, __be32 ip,
-				 unsigned short vid, int packet_subtype)
+static bool __batadv_dat_send_data(struct batadv_priv *bat_priv,
+				   struct sk_buff *skb,
+				   const struct batadv_dat_entry *key,
+				   int packet_subtype)
 {
 	int i;
 	bool ret = false;
@@ -645,11 +967,16 @@ static bool batadv_dat_send_data(struct batadv_priv *bat_priv,
 	struct sk_buff *tmp_skb;
 	struct batadv_dat_candidate *cand;
 
-	cand = batadv_dat_select_candidates(bat_priv, ip, vid);
+	cand = batadv_dat_select_candidates(bat_priv, key);
 	if (!cand)
 		goto out;
 
-	batadv_dbg(BATADV_DBG_DAT, bat_priv, "DHT_SEND for %pI4\n", &ip);
+	if (key->family == AF_INET6)
+		batadv_dbg(BATADV_DBG_DAT, bat_priv, "DHT_SEND for %pI6c\n",
+			   &key->ip6);
+	else
+		batadv_dbg(BATADV_DBG_DAT, bat_priv, "DHT_SEND for %pI4\n",
+			   &key->ip);
 
 	for (i = 0; i < BATADV_DAT_CANDIDATES_NUM; i++) {
 		if (cand[i].type == BATADV_DAT_CANDIDATE_NOT_FOUND)
@@ -696,6 +1023,52 @@ out:
 	return ret;
 }
 
+/**
+ * batadv_dat_send_data() - send a payload to the candidates of an IPv4 address
+ * @bat_priv: the bat priv with all the soft interface information
+ * @skb: payload to send
+ * @ip: the DHT key
+ * @vid: VLAN identifier
+ * @packet_subtype: unicast4addr packet subtype to use
+ *
+ * Return: true if the packet is sent to at least one candidate, false
+ * otherwise.
+ */
+static bool batadv_dat_send_data(struct batadv_priv *bat_priv,
+				 struct sk_buff *skb, __be32 ip,
+				 unsigned short vid, int packet_subtype)
+{
+	struct batadv_dat_entry key;
+
+	batadv_dat_key_ip4(&key, ip, vid);
+
+	return __batadv_dat_send_data(bat_priv, skb, &key, packet_subtype);
+}
+
+/**
+ * batadv_dat_send_data6() - send a payload to the candidates of an IPv6
+ *  address
+ * @bat_priv: the bat priv with all the soft interface information
+ * @skb: payload to send
+ * @ip6: the DHT key
+ * @vid: VLAN identifier
+ * @packet_subtype: unicast4addr packet subtype to use
+ *
+ * Return: true if the packet is sent to at least one candidate, false
+ * otherwise.
+ */
+static bool batadv_dat_send_data6(struct batadv_priv *bat_priv,
+				  struct sk_buff *skb,
+				  const struct in6_addr *ip6,
+				  unsigned short vid, int packet_subtype)
+{
+	struct batadv_dat_entry key;
+
+	batadv_dat_key_ip6(&key, ip6, vid);
+
+	return __batadv_dat_send_data(bat_priv, skb, &key, packet_subtype);
+}
+
 /**
  * batadv_dat_tvlv_container_update() - update the dat tvlv container after dat
  *  setting change
@@ -703,6 +1076,7 @@ out:
  */
 static void batadv_dat_tvlv_container_update(struct batadv_priv *bat_priv)
 {
+	struct batadv_tvlv_dat_data dat_data;
 	char dat_mode;
 
 	dat_mode = atomic_read(&bat_priv->distributed_arp_table);
@@ -712,8 +1086,11 @@ static void batadv_dat_tvlv_container_update(struct batadv_priv *bat_priv)
 		batadv_tvlv_container_unregister(bat_priv, BATADV_TVLV_DAT, 1);
 		break;
 	case 1:
+		dat_data.flags = BATADV_DAT_FLAG_ND;
+		memset(dat_data.reserved, 0, sizeof(dat_data.reserved));
+
 		batadv_tvlv_container_register(bat_priv, BATADV_TVLV_DAT, 1,
-					       NULL, 0);
+					       &dat_data, sizeof(dat_data));
 		break;
 	}
 }
@@ -735,18 +1112,34 @@ void batadv_dat_status_update(struct net_device *net_dev)
  * @bat_priv: the bat priv with all the soft interface information
  * @orig: the orig_node of the ogm
  * @flags: flags indicating the tvlv state (see batadv_tvlv_handler_flags)
- * @tvlv_value: tvlv buffer containing the gateway data
+ * @tvlv_value: tvlv buffer containing the dat data
  * @tvlv_value_len: tvlv buffer length
+ *
+ * Nodes announcing an empty container only support ARP.
  */
 static void batadv_dat_tvlv_ogm_handler_v1(struct batadv_priv *bat_priv,
 					   struct batadv_orig_node *orig,
 					   u8 flags,
 					   void *tvlv_value, u16 tvlv_value_len)
 {
-	if (flags & BATADV_TVLV_HANDLER_OGM_CIFNOTFND)
+	struct batadv_tvlv_dat_data *dat_data = tvlv_value;
+	bool nd = false;
+
+	if (flags & BATADV_TVLV_HANDLER_OGM_CIFNOTFND) {
 		clear_bit(BATADV_ORIG_CAPA_HAS_DAT, &orig->capabilities);
+		clear_bit(BATADV_ORIG_CAPA_HAS_DAT_ND, &orig->capabilities);
+		return;
+	}
+
+	set_bit(BATADV_ORIG_CAPA_HAS_DAT, &orig->capabilities);
+
+	if (tvlv_value_len >= sizeof(*dat_data))
+		nd = dat_data->flags & BATADV_DAT_FLAG_ND;
+
+	if (nd)
+		set_bit(BATADV_ORIG_CAPA_HAS_DAT_ND, &orig->capabilities);
 	else
-		set_bit(BATADV_ORIG_CAPA_HAS_DAT, &orig->capabilities);
+		clear_bit(BATADV_ORIG_CAPA_HAS_DAT_ND, &orig->capabilities);
 }
 
 /**
@@ -776,7 +1169,7 @@ int batadv_dat_init(struct batadv_priv *bat_priv)
 	if (bat_priv->dat.hash)
 		return 0;
 
-	bat_priv->dat.hash = batadv_hash_new(1024);
+	bat_priv->dat.hash = batadv_hash_new(256, batadv_hash_dat_node);
 
 	if (!bat_priv->dat.hash)
 		return -ENOMEM;
@@ -832,10 +1225,9 @@ int batadv_dat_cache_seq_print_text(struct seq_file *seq, void *offset)
 	seq_puts(seq,
 		 "          IPv4             MAC        VID   last-seen\n");
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-
+	for (i = 0; i < batadv_hash_size(hash); i++) {
 		rcu_read_lock();
+		head = batadv_hash_bucket_rcu(hash, i);
 		hlist_for_each_entry_rcu(dat_entry, head, hash_entry) {
 			last_seen_jiffies = jiffies - dat_entry->last_update;
 			last_seen_msecs = jiffies_to_msecs(last_seen_jiffies);
@@ -843,10 +1235,16 @@ int batadv_dat_cache_seq_print_text(struct seq_file *seq, void *offset)
 			last_seen_msecs = last_seen_msecs % 60000;
 			last_seen_secs = last_seen_msecs / 1000;
 
-			seq_printf(seq, " * %15pI4 %pM %4i %6i:%02i\n",
-				   &dat_entry->ip, dat_entry->mac_addr,
-				   batadv_print_vid(dat_entry->vid),
-				   last_seen_mins, last_seen_secs);
+			if (dat_entry->family == AF_INET6)
+				seq_printf(seq, " * %pI6c %pM %4i %6i:%02i\n",
+					   &dat_entry->ip6, dat_entry->mac_addr,
+					   batadv_print_vid(dat_entry->vid),
+					   last_seen_mins, last_seen_secs);
+			else
+				seq_printf(seq, " * %15pI4 %pM %4i %6i:%02i\n",
+					   &dat_entry->ip, dat_entry->mac_addr,
+					   batadv_print_vid(dat_entry->vid),
+					   last_seen_mins, last_seen_secs);
 		}
 		rcu_read_unlock();
 	}
@@ -882,18 +1280,28 @@ batadv_dat_cache_dump_entry(struct sk_buff *msg, u32 portid, u32 seq,
 
 	msecs = jiffies_to_msecs(jiffies - dat_entry->last_update);
 
-	if (nla_put_in_addr(msg, BATADV_ATTR_DAT_CACHE_IP4ADDRESS,
-			    dat_entry->ip) ||
-	    nla_put(msg, BATADV_ATTR_DAT_CACHE_HWADDRESS, ETH_ALEN,
+	if (dat_entry->family == AF_INET6) {
+		if (nla_put_in6_addr(msg, BATADV_ATTR_DAT_CACHE_IP6ADDRESS,
+				     &dat_entry->ip6))
+			goto nla_put_failure;
+	} else {
+		if (nla_put_in_addr(msg, BATADV_ATTR_DAT_CACHE_IP4ADDRESS,
+				    dat_entry->ip))
+			goto nla_put_failure;
+	}
+
+	if (nla_put(msg, BATADV_ATTR_DAT_CACHE_HWADDRESS, ETH_ALEN,
 		    dat_entry->mac_addr) ||
 	    nla_put_u16(msg, BATADV_ATTR_DAT_CACHE_VID, dat_entry->vid) ||
-	    nla_put_u32(msg, BATADV_ATTR_LAST_SEEN_MSECS, msecs)) {
-		genlmsg_cancel(msg, hdr);
-		return -EMSGSIZE;
-	}
+	    nla_put_u32(msg, BATADV_ATTR_LAST_SEEN_MSECS, msecs))
+		goto nla_put_failure;
 
 	genlmsg_end(msg, hdr);
 	return 0;
+
+ nla_put_failure:
+	genlmsg_cancel(msg, hdr);
+	return -EMSGSIZE;
 }
 
 /**
@@ -902,19 +1310,23 @@ batadv_dat_cache_dump_entry(struct sk_buff *msg, u32 portid, u32 seq,
  * @msg: buffer for the message
  * @portid: netlink port
  * @seq: Sequence number of netlink message
- * @head: bucket to dump
+ * @hash: hash to dump
+ * @bucket: bucket index to dump
  * @idx_skip: How many entries to skip
  *
  * Return: 0 or error code.
  */
 static int
 batadv_dat_cache_dump_bucket(struct sk_buff *msg, u32 portid, u32 seq,
-			     struct hlist_head *head, int *idx_skip)
+			     struct batadv_hashtable *hash, u32 bucket,
+			     int *idx_skip)
 {
 	struct batadv_dat_entry *dat_entry;
+	struct hlist_head *head;
 	int idx = 0;
 
 	rcu_read_lock();
+	head = batadv_hash_bucket_rcu(hash, bucket);
 	hlist_for_each_entry_rcu(dat_entry, head, hash_entry) {
 		if (idx < *idx_skip)
 			goto skip;
@@ -951,7 +1363,6 @@ int batadv_dat_cache_dump(struct sk_buff *msg, struct netlink_callback *cb)
 	struct batadv_hashtable *hash;
 	struct batadv_priv *bat_priv;
 	int bucket = cb->args[0];
-	struct hlist_head *head;
 	int idx = cb->args[1];
 	int ifindex;
 	int ret = 0;
@@ -976,12 +1387,10 @@ int batadv_dat_cache_dump(struct sk_buff *msg, struct netlink_callback *cb)
 		goto out;
 	}
 
-	while (bucket < hash->size) {
-		head = &hash->table[bucket];
-
+	while (bucket < batadv_hash_size(hash)) {
 		if (batadv_dat_cache_dump_bucket(msg, portid,
-						 cb->nlh->nlmsg_seq, head,
-						 &idx))
+						 cb->nlh->nlmsg_seq, hash,
+						 bucket, &idx))
 			break;
 
 		bucket++;
@@ -1014,12 +1423,19 @@ out:
 static u16 batadv_arp_get_type(struct batadv_priv *bat_priv,
 			       struct sk_buff *skb, int hdr_size)
 {
+	struct batadv_skb_cb *cb;
 	struct arphdr *arphdr;
 	struct ethhdr *ethhdr;
 	__be32 ip_src, ip_dst;
 	u8 *hw_src, *hw_dst;
 	u16 type = 0;
 
+	/* frames classified as anything but untagged ARP can be skipped */
+	cb = batadv_skb_cb_classified(skb, hdr_size);
+	if (cb && (cb->network_offset != ETH_HLEN ||
+		   cb->l3_proto != htons(ETH_P_ARP)))
+		goto out;
+
 	/* pull the ethernet header */
 	if (unlikely(!pskb_may_pull(skb, hdr_size + ETH_HLEN)))
 		goto out;
@@ -1181,7 +1597,7 @@ bool batadv_dat_snoop_outgoing_arp_request(struct batadv_priv *bat_priv,
 
 	batadv_dat_entry_add(bat_priv, ip_src, hw_src, vid);
 
-	dat_entry = batadv_dat_entry_hash_find(bat_priv, ip_dst, vid);
+	dat_entry = batadv_dat_entry_lookup(bat_priv, ip_dst, vid);
 	if (dat_entry) {
 		/* If the ARP request is destined for a local client the local
 		 * client will answer itself. DAT would only generate a
@@ -1274,7 +1690,7 @@ bool batadv_dat_snoop_incoming_arp_request(struct batadv_priv *bat_priv,
 
 	batadv_dat_entry_add(bat_priv, ip_src, hw_src, vid);
 
-	dat_entry = batadv_dat_entry_hash_find(bat_priv, ip_dst, vid);
+	dat_entry = batadv_dat_entry_lookup(bat_priv, ip_dst, vid);
 	if (!dat_entry)
 		goto out;
 
@@ -1436,8 +1852,551 @@ out:
 }
 
 /**
- * batadv_dat_drop_broadcast_packet() - check if an ARP request has to be
- *  dropped (because the node has already obtained the reply via DAT) or not
+ * batadv_nd_ip6hdr() - extract the IPv6 header of a neighbor discovery packet
+ * @skb: neighbor discovery packet
+ * @hdr_size: size of the possible header before the ethernet frame
+ *
+ * Return: the IPv6 header of the packet.
+ */
+static struct ipv6hdr *batadv_nd_ip6hdr(struct sk_buff *skb, int hdr_size)
+{
+	return (struct ipv6hdr *)(skb->data + hdr_size + ETH_HLEN);
+}
+
+/**
+ * batadv_nd_msg() - extract the ICMPv6 message of a neighbor discovery packet
+ * @skb: neighbor discovery packet
+ * @hdr_size: size of the possible header before the ethernet frame
+ *
+ * Return: the neighbor solicitation or advertisement of the packet.
+ */
+static struct nd_msg *batadv_nd_msg(struct sk_buff *skb, int hdr_size)
+{
+	return (struct nd_msg *)(batadv_nd_ip6hdr(skb, hdr_size) + 1);
+}
+
+/**
+ * batadv_nd_lladdr() - find a link-layer address option of a neighbor
+ *  discovery packet
+ * @skb: neighbor discovery packet, pulled up to the end of its options
+ * @hdr_size: size of the possible header before the ethernet frame
+ * @opt_type: ND_OPT_SOURCE_LL_ADDR or ND_OPT_TARGET_LL_ADDR
+ *
+ * Return: the link-layer address carried by the option or NULL if the packet
+ * doesn't have a well formed option of this type.
+ */
+static u8 *batadv_nd_lladdr(struct sk_buff *skb, int hdr_size, u8 opt_type)
+{
+	struct ipv6hdr *ip6h = batadv_nd_ip6hdr(skb, hdr_size);
+	struct nd_opt_hdr *opt;
+	u8 *pos, *end;
+	int opt_len;
+
+	pos = (u8 *)(batadv_nd_msg(skb, hdr_size) + 1);
+	end = (u8 *)(ip6h + 1) + ntohs(ip6h->payload_len);
+
+	while (pos + sizeof(*opt) <= end) {
+		opt = (struct nd_opt_hdr *)pos;
+		opt_len = opt->nd_opt_len << 3;
+
+		if (opt_len == 0 || pos + opt_len > end)
+			return NULL;
+
+		if (opt->nd_opt_type == opt_type &&
+		    opt_len >= sizeof(*opt) + ETH_ALEN)
+			return pos + sizeof(*opt);
+
+		pos += opt_len;
+	}
+
+	return NULL;
+}
+
+/**
+ * batadv_nd_get_type() - parse a neighbor discovery packet and get the type
+ * @bat_priv: the bat priv with all the soft interface information
+ * @skb: packet to analyse
+ * @hdr_size: size of the possible header before the ethernet frame in the skb
+ *
+ * Only neighbor solicitations carrying a source link-layer address option and
+ * neighbor advertisements carrying a target link-layer address option are
+ * accepted, the options are the only source of the link-layer addresses DAT
+ * caches. Duplicate address detection probes are ignored because they have to
+ * reach the owner of the address.
+ *
+ * Return: NDISC_NEIGHBOUR_SOLICITATION or NDISC_NEIGHBOUR_ADVERTISEMENT if the
+ * skb contains a valid neighbor discovery packet, 0 otherwise.
+ */
+static u8 batadv_nd_get_type(struct batadv_priv *bat_priv,
+			     struct sk_buff *skb, int hdr_size)
+{
+	struct ethhdr *ethhdr;
+	struct ipv6hdr *ip6h;
+	struct nd_msg *msg;
+	int nd_offset;
+	u8 *lladdr;
+	u16 len;
+	u8 type = 0;
+
+	/* pull the ethernet header */
+	if (unlikely(!pskb_may_pull(skb, hdr_size + ETH_HLEN)))
+		goto out;
+
+	ethhdr = (struct ethhdr *)(skb->data + hdr_size);
+
+	if (ethhdr->h_proto != htons(ETH_P_IPV6))
+		goto out;
+
+	nd_offset = hdr_size + ETH_HLEN + sizeof(*ip6h);
+	if (unlikely(!pskb_may_pull(skb, nd_offset + sizeof(*msg))))
+		goto out;
+
+	ip6h = batadv_nd_ip6hdr(skb, hdr_size);
+
+	/* neighbor discovery messages never leave the link */
+	if (ip6h->version != 6 || ip6h->nexthdr != IPPROTO_ICMPV6 ||
+	    ip6h->hop_limit != 255)
+		goto out;
+
+	/* pull the options as well, they are parsed in place */
+	len = ntohs(ip6h->payload_len);
+	if (len < sizeof(*msg))
+		goto out;
+
+	if (unlikely(!pskb_may_pull(skb, nd_offset + len)))
+		goto out;
+
+	ip6h = batadv_nd_ip6hdr(skb, hdr_size);
+	msg = batadv_nd_msg(skb, hdr_size);
+
+	if (msg->icmph.icmp6_code != 0)
+		goto out;
+
+	if (ipv6_addr_any(&msg->target) ||
+	    ipv6_addr_is_multicast(&msg->target) ||
+	    ipv6_addr_loopback(&msg->target))
+		goto out;
+
+	switch (msg->icmph.icmp6_type) {
+	case NDISC_NEIGHBOUR_SOLICITATION:
+		if (ipv6_addr_any(&ip6h->saddr) ||
+		    ipv6_addr_is_multicast(&ip6h->saddr))
+			goto out;
+
+		lladdr = batadv_nd_lladdr(skb, hdr_size,
+					  ND_OPT_SOURCE_LL_ADDR);
+		break;
+	case NDISC_NEIGHBOUR_ADVERTISEMENT:
+		lladdr = batadv_nd_lladdr(skb, hdr_size,
+					  ND_OPT_TARGET_LL_ADDR);
+		break;
+	default:
+		goto out;
+	}
+
+	if (!lladdr || is_zero_ether_addr(lladdr) ||
+	    is_multicast_ether_addr(lladdr))
+		goto out;
+
+	type = msg->icmph.icmp6_type;
+out:
+	return type;
+}
+
+/**
+ * batadv_dat_nd_create_reply() - create a neighbor advertisement
+ * @bat_priv: the bat priv with all the soft interface information
+ * @ip6_src: IPv6 source and advertised target address
+ * @ip6_dst: IPv6 destination address
+ * @hw_src: Ethernet source and target link-layer address
+ * @hw_dst: Ethernet destination
+ * @router: set the router flag of the advertisement
+ * @vid: VLAN identifier (optional, set to zero otherwise)
+ *
+ * Creates a solicited neighbor advertisement from the given values, optionally
+ * encapsulated in a VLAN header. Like any proxy advertisement, it doesn't set
+ * the override flag.
+ *
+ * Return: An skb containing a neighbor advertisement.
+ */
+static struct sk_buff *
+batadv_dat_nd_create_reply(struct batadv_priv *bat_priv,
+			   const struct in6_addr *ip6_src,
+			   const struct in6_addr *ip6_dst, u8 *hw_src,
+			   u8 *hw_dst, bool router, unsigned short vid)
+{
+	struct net_device *soft_iface = bat_priv->soft_iface;
+	struct nd_opt_hdr *opt;
+	struct ethhdr *ethhdr;
+	struct ipv6hdr *ip6h;
+	struct sk_buff *skb;
+	struct nd_msg *msg;
+	int len;
+
+	len = sizeof(*msg) + sizeof(*opt) + ETH_ALEN;
+
+	skb = netdev_alloc_skb_ip_align(soft_iface,
+					ETH_HLEN + sizeof(*ip6h) + len);
+	if (!skb)
+		return NULL;
+
+	skb_reset_mac_header(skb);
+	skb->protocol = htons(ETH_P_IPV6);
+
+	ethhdr = skb_put(skb, ETH_HLEN);
+	ether_addr_copy(ethhdr->h_dest, hw_dst);
+	ether_addr_copy(ethhdr->h_source, hw_src);
+	ethhdr->h_proto = htons(ETH_P_IPV6);
+
+	ip6h = skb_put_zero(skb, sizeof(*ip6h));
+	ip6h->version = 6;
+	ip6h->payload_len = htons(len);
+	ip6h->nexthdr = IPPROTO_ICMPV6;
+	ip6h->hop_limit = 255;
+	ip6h->saddr = *ip6_src;
+	ip6h->daddr = *ip6_dst;
+
+	msg = skb_put_zero(skb, len);
+	msg->icmph.icmp6_type = NDISC_NEIGHBOUR_ADVERTISEMENT;
+	msg->icmph.icmp6_router = router;
+	msg->icmph.icmp6_solicited = 1;
+	msg->target = *ip6_src;
+
+	opt = (struct nd_opt_hdr *)msg->opt;
+	opt->nd_opt_type = ND_OPT_TARGET_LL_ADDR;
+	opt->nd_opt_len = (sizeof(*opt) + ETH_ALEN) >> 3;
+	ether_addr_copy((u8 *)(opt + 1), hw_src);
+
+	msg->icmph.icmp6_cksum = csum_ipv6_magic(ip6_src, ip6_dst, len,
+						 IPPROTO_ICMPV6,
+						 csum_partial(msg, len, 0));
+
+	if (vid & BATADV_VLAN_HAS_TAG)
+		skb = vlan_insert_tag(skb, htons(ETH_P_8021Q),
+				      vid & VLAN_VID_MASK);
+
+	return skb;
+}
+
+/**
+ * batadv_dat_snoop_outgoing_nd_request() - snoop the neighbor solicitation and
+ *  try to answer using DAT
+ * @bat_priv: the bat priv with all the soft interface information
+ * @skb: packet to check
+ *
+ * Neighbor solicitations don't fill the local DAT storage: only the
+ * advertisements carry the router flag which has to be repeated in the
+ * answers.
+ *
+ * Return: true if the message has been sent to the dht candidates, false
+ * otherwise. In case of a positive return value the message has to be enqueued
+ * to permit the fallback.
+ */
+bool batadv_dat_snoop_outgoing_nd_request(struct batadv_priv *bat_priv,
+					  struct sk_buff *skb)
+{
+	struct net_device *soft_iface = bat_priv->soft_iface;
+	struct batadv_dat_entry *dat_entry = NULL;
+	struct in6_addr *target;
+	struct ipv6hdr *ip6h;
+	struct sk_buff *skb_new;
+	unsigned short vid;
+	int hdr_size = 0;
+	bool ret = false;
+	u8 *hw_src;
+	u8 type;
+
+	if (!atomic_read(&bat_priv->distributed_arp_table))
+		goto out;
+
+	vid = batadv_dat_get_vid(skb, &hdr_size);
+
+	type = batadv_nd_get_type(bat_priv, skb, hdr_size);
+	if (type != NDISC_NEIGHBOUR_SOLICITATION)
+		goto out;
+
+	ip6h = batadv_nd_ip6hdr(skb, hdr_size);
+	target = &batadv_nd_msg(skb, hdr_size)->target;
+	hw_src = batadv_nd_lladdr(skb, hdr_size, ND_OPT_SOURCE_LL_ADDR);
+
+	batadv_dbg(BATADV_DBG_DAT, bat_priv,
+		   "Parsing outgoing NS: %pM-%pI6c asks for %pI6c\n",
+		   hw_src, &ip6h->saddr, target);
+
+	dat_entry = batadv_dat_entry6_lookup(bat_priv, target, vid);
+	if (dat_entry) {
+		/* a local client answers by itself, see the ARP counterpart */
+		if (batadv_is_my_client(bat_priv, dat_entry->mac_addr, vid)) {
+			ret = true;
+			goto out;
+		}
+
+		if (!batadv_bla_check_claim(bat_priv,
+					    dat_entry->mac_addr, vid)) {
+			batadv_dbg(BATADV_DBG_DAT, bat_priv,
+				   "Device %pM claimed by another backbone gw. Don't send NA!",
+				   dat_entry->mac_addr);
+			ret = true;
+			goto out;
+		}
+
+		skb_new = batadv_dat_nd_create_reply(bat_priv, target,
+						     &ip6h->saddr,
+						     dat_entry->mac_addr,
+						     hw_src, dat_entry->router,
+						     vid);
+		if (!skb_new)
+			goto out;
+
+		skb_new->protocol = eth_type_trans(skb_new, soft_iface);
+
+		batadv_inc_counter(bat_priv, BATADV_CNT_RX);
+		batadv_add_counter(bat_priv, BATADV_CNT_RX_BYTES,
+				   skb_new->len + ETH_HLEN);
+
+		netif_rx(skb_new);
+		batadv_dbg(BATADV_DBG_DAT, bat_priv, "NS replied locally\n");
+		ret = true;
+	} else {
+		/* Send the request to the DHT */
+		ret = batadv_dat_send_data6(bat_priv, skb, target, vid,
+					    BATADV_P_DAT_DHT_GET);
+	}
+out:
+	if (dat_entry)
+		batadv_dat_entry_put(dat_entry);
+	return ret;
+}
+
+/**
+ * batadv_dat_snoop_incoming_nd_request() - snoop the neighbor solicitation and
+ *  try to answer using the local DAT storage
+ * @bat_priv: the bat priv with all the soft interface information
+ * @skb: packet to check
+ * @hdr_size: size of the encapsulation header
+ *
+ * Return: true if the request has been answered, false otherwise.
+ */
+bool batadv_dat_snoop_incoming_nd_request(struct batadv_priv *bat_priv,
+					  struct sk_buff *skb, int hdr_size)
+{
+	struct batadv_dat_entry *dat_entry = NULL;
+	struct in6_addr *target;
+	struct sk_buff *skb_new;
+	struct ipv6hdr *ip6h;
+	unsigned short vid;
+	bool ret = false;
+	u8 *hw_src;
+	u8 type;
+	int err;
+
+	if (!atomic_read(&bat_priv->distributed_arp_table))
+		goto out;
+
+	vid = batadv_dat_get_vid(skb, &hdr_size);
+
+	type = batadv_nd_get_type(bat_priv, skb, hdr_size);
+	if (type != NDISC_NEIGHBOUR_SOLICITATION)
+		goto out;
+
+	ip6h = batadv_nd_ip6hdr(skb, hdr_size);
+	target = &batadv_nd_msg(skb, hdr_size)->target;
+	hw_src = batadv_nd_lladdr(skb, hdr_size, ND_OPT_SOURCE_LL_ADDR);
+
+	batadv_dbg(BATADV_DBG_DAT, bat_priv,
+		   "Parsing incoming NS: %pM-%pI6c asks for %pI6c\n",
+		   hw_src, &ip6h->saddr, target);
+
+	dat_entry = batadv_dat_entry6_lookup(bat_priv, target, vid);
+	if (!dat_entry)
+		goto out;
+
+	skb_new = batadv_dat_nd_create_reply(bat_priv, target, &ip6h->saddr,
+					     dat_entry->mac_addr, hw_src,
+					     dat_entry->router, vid);
+	if (!skb_new)
+		goto out;
+
+	/* keep the outgoing format of the request, see the ARP counterpart */
+	if (hdr_size == sizeof(struct batadv_unicast_4addr_packet))
+		err = batadv_send_skb_via_tt_4addr(bat_priv, skb_new,
+						   BATADV_P_DAT_CACHE_REPLY,
+						   NULL, vid);
+	else
+		err = batadv_send_skb_via_tt(bat_priv, skb_new, NULL, vid);
+
+	if (err != NET_XMIT_DROP) {
+		batadv_inc_counter(bat_priv, BATADV_CNT_DAT_CACHED_REPLY_TX);
+		ret = true;
+	}
+out:
+	if (dat_entry)
+		batadv_dat_entry_put(dat_entry);
+	if (ret)
+		kfree_skb(skb);
+	return ret;
+}
+
+/**
+ * batadv_dat_snoop_outgoing_nd_reply() - snoop the neighbor advertisement and
+ *  fill the DHT
+ * @bat_priv: the bat priv with all the soft interface information
+ * @skb: packet to check
+ */
+void batadv_dat_snoop_outgoing_nd_reply(struct batadv_priv *bat_priv,
+					struct sk_buff *skb)
+{
+	struct in6_addr *target;
+	struct nd_msg *msg;
+	unsigned short vid;
+	int hdr_size = 0;
+	u8 *hw_target;
+	u8 type;
+
+	if (!atomic_read(&bat_priv->distributed_arp_table))
+		return;
+
+	vid = batadv_dat_get_vid(skb, &hdr_size);
+
+	type = batadv_nd_get_type(bat_priv, skb, hdr_size);
+	if (type != NDISC_NEIGHBOUR_ADVERTISEMENT)
+		return;
+
+	msg = batadv_nd_msg(skb, hdr_size);
+	target = &msg->target;
+	hw_target = batadv_nd_lladdr(skb, hdr_size, ND_OPT_TARGET_LL_ADDR);
+
+	batadv_dbg(BATADV_DBG_DAT, bat_priv,
+		   "Parsing outgoing NA: %pI6c is at %pM\n", target, hw_target);
+
+	batadv_dat_entry6_add(bat_priv, target, hw_target, vid,
+			      msg->icmph.icmp6_router);
+
+	batadv_dat_send_data6(bat_priv, skb, target, vid, BATADV_P_DAT_DHT_PUT);
+}
+
+/**
+ * batadv_dat_snoop_incoming_nd_reply() - snoop the neighbor advertisement and
+ *  fill the local DAT storage only
+ * @bat_priv: the bat priv with all the soft interface information
+ * @skb: packet to check
+ * @hdr_size: size of the encapsulation header
+ *
+ * Return: true if the packet was snooped and consumed by DAT. False if the
+ * packet has to be delivered to the interface
+ */
+bool batadv_dat_snoop_incoming_nd_reply(struct batadv_priv *bat_priv,
+					struct sk_buff *skb, int hdr_size)
+{
+	struct batadv_dat_entry *dat_entry = NULL;
+	u8 *hw_target, *hw_dst;
+	struct in6_addr *target;
+	struct nd_msg *msg;
+	bool dropped = false;
+	unsigned short vid;
+	u8 type;
+
+	if (!atomic_read(&bat_priv->distributed_arp_table))
+		goto out;
+
+	vid = batadv_dat_get_vid(skb, &hdr_size);
+
+	type = batadv_nd_get_type(bat_priv, skb, hdr_size);
+	if (type != NDISC_NEIGHBOUR_ADVERTISEMENT)
+		goto out;
+
+	msg = batadv_nd_msg(skb, hdr_size);
+	target = &msg->target;
+	hw_target = batadv_nd_lladdr(skb, hdr_size, ND_OPT_TARGET_LL_ADDR);
+	hw_dst = ((struct ethhdr *)(skb->data + hdr_size))->h_dest;
+
+	batadv_dbg(BATADV_DBG_DAT, bat_priv,
+		   "Parsing incoming NA: %pI6c is at %pM\n", target, hw_target);
+
+	/* unsolicited advertisements are meant for all nodes */
+	if (is_multicast_ether_addr(hw_dst)) {
+		batadv_dat_entry6_add(bat_priv, target, hw_target, vid,
+				      msg->icmph.icmp6_router);
+		goto out;
+	}
+
+	/* drop the most probably doubled advertisement, see the ARP
+	 * counterpart
+	 */
+	dat_entry = batadv_dat_entry6_hash_find(bat_priv, target, vid);
+	if (dat_entry && batadv_compare_eth(hw_target, dat_entry->mac_addr) &&
+	    dat_entry->router == msg->icmph.icmp6_router) {
+		batadv_dbg(BATADV_DBG_DAT, bat_priv,
+			   "Doubled NA removed: %pI6c is at %pM\n", target,
+			   hw_target);
+		dropped = true;
+		goto out;
+	}
+
+	batadv_dat_entry6_add(bat_priv, target, hw_target, vid,
+			      msg->icmph.icmp6_router);
+
+	if (!batadv_bla_check_claim(bat_priv, hw_target, vid)) {
+		batadv_dbg(BATADV_DBG_DAT, bat_priv,
+			   "Device %pM claimed by another backbone gw. Drop NA.\n",
+			   hw_target);
+		dropped = true;
+		goto out;
+	}
+
+	/* deliver only to a client of mine, which didn't send the NA itself */
+	dropped = !batadv_is_my_client(bat_priv, hw_dst, vid);
+	dropped |= batadv_is_my_client(bat_priv, hw_target, vid);
+out:
+	if (dropped)
+		kfree_skb(skb);
+	if (dat_entry)
+		batadv_dat_entry_put(dat_entry);
+	/* if dropped == false -> deliver to the interface */
+	return dropped;
+}
+
+/**
+ * batadv_dat_drop_broadcast_nd() - check if a broadcasted neighbor
+ *  solicitation has to be dropped because DAT already knows the answer
+ * @bat_priv: the bat priv with all the soft interface information
+ * @skb: the broadcast packet
+ * @hdr_size: size of the broadcast header, including a possible VLAN header
+ * @vid: VLAN identifier
+ *
+ * Return: true if the node can drop the packet, false otherwise.
+ */
+static bool batadv_dat_drop_broadcast_nd(struct batadv_priv *bat_priv,
+					 struct sk_buff *skb, int hdr_size,
+					 unsigned short vid)
+{
+	struct batadv_dat_entry *dat_entry;
+	struct in6_addr *target;
+	u8 type;
+
+	type = batadv_nd_get_type(bat_priv, skb, hdr_size);
+	if (type != NDISC_NEIGHBOUR_SOLICITATION)
+		return false;
+
+	target = &batadv_nd_msg(skb, hdr_size)->target;
+	dat_entry = batadv_dat_entry6_hash_find(bat_priv, target, vid);
+	if (!dat_entry) {
+		batadv_dbg(BATADV_DBG_DAT, bat_priv,
+			   "NS for %pI6c: fallback\n", target);
+		return false;
+	}
+
+	batadv_dbg(BATADV_DBG_DAT, bat_priv,
+		   "NS for %pI6c: fallback prevented\n", target);
+	batadv_dat_entry_put(dat_entry);
+
+	return true;
+}
+
+/**
+ * batadv_dat_drop_broadcast_packet() - check if an ARP request or a neighbor
+ *  solicitation has to be dropped (because the node has already obtained the
+ *  reply via DAT) or not
  * @bat_priv: the bat priv with all the soft interface information
  * @forw_packet: the broadcast packet
  *
@@ -1465,8 +2424,11 @@ bool batadv_dat_drop_broadcast_packet(struct batadv_priv *bat_priv,
 	vid = batadv_dat_get_vid(forw_packet->skb, &hdr_size);
 
 	type = batadv_arp_get_type(bat_priv, forw_packet->skb, hdr_size);
-	if (type != ARPOP_REQUEST)
+	if (type != ARPOP_REQUEST) {
+		ret = batadv_dat_drop_broadcast_nd(bat_priv, forw_packet->skb,
+						   hdr_size, vid);
 		goto out;
+	}
 
 	ip_dst = batadv_arp_ip_dst(forw_packet->skb, hdr_size);
 	dat_entry = batadv_dat_entry_hash_find(bat_priv, ip_dst, vid);
@@ -1486,3 +2448,29 @@ out:
 		batadv_dat_entry_put(dat_entry);
 	return ret;
 }
+
+/**
+ * batadv_dat_cache_init() - Initialize DAT entry memory object cache
+ *
+ * Return: 0 on success or negative error number in case of failure.
+ */
+int __init batadv_dat_cache_init(void)
+{
+	size_t size = sizeof(struct batadv_dat_entry);
+
+	batadv_dat_cache =
+		kmem_cache_create("batadv_dat_cache", size, 0,
+				  SLAB_HWCACHE_ALIGN, NULL);
+	if (!batadv_dat_cache)
+		return -ENOMEM;
+
+	return 0;
+}
+
+/**
+ * batadv_dat_cache_destroy() - Destroy DAT entry memory object cache
+ */
+void batadv_dat_cache_destroy(void)
+{
+	kmem_cache_destroy(batadv_dat_cache);
+}
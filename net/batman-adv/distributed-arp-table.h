@@ -46,8 +46,18 @@ void batadv_dat_snoop_outgoing_arp_reply(struct batadv_priv *bat_priv,
 					 struct sk_buff *skb);
 bool batadv_dat_snoop_incoming_arp_reply(struct batadv_priv *bat_priv,
 					 struct sk_buff *skb, int hdr_size);
+bool batadv_dat_snoop_outgoing_nd_request(struct batadv_priv *bat_priv,
+					  struct sk_buff *skb);
+bool batadv_dat_snoop_incoming_nd_request(struct batadv_priv *bat_priv,
+					  struct sk_buff *skb, int hdr_size);
+void batadv_dat_snoop_outgoing_nd_reply(struct batadv_priv *bat_priv,
+					struct sk_buff *skb);
+bool batadv_dat_snoop_incoming_nd_reply(struct batadv_priv *bat_priv,
+					struct sk_buff *skb, int hdr_size);
 bool batadv_dat_drop_broadcast_packet(struct batadv_priv *bat_priv,
 				      struct batadv_forw_packet *forw_packet);
+int batadv_dat_cache_init(void);
+void batadv_dat_cache_destroy(void);
 
 /**
  * batadv_dat_init_orig_node_addr() - assign a DAT address to the orig_node
@@ -140,6 +150,33 @@ batadv_dat_snoop_incoming_arp_reply(struct batadv_priv *bat_priv,
 	return false;
 }
 
+static inline bool
+batadv_dat_snoop_outgoing_nd_request(struct batadv_priv *bat_priv,
+				     struct sk_buff *skb)
+{
+	return false;
+}
+
+static inline bool
+batadv_dat_snoop_incoming_nd_request(struct batadv_priv *bat_priv,
+				     struct sk_buff *skb, int hdr_size)
+{
+	return false;
+}
+
+static inline void
+batadv_dat_snoop_outgoing_nd_reply(struct batadv_priv *bat_priv,
+				   struct sk_buff *skb)
+{
+}
+
+static inline bool
+batadv_dat_snoop_incoming_nd_reply(struct batadv_priv *bat_priv,
+				   struct sk_buff *skb, int hdr_size)
+{
+	return false;
+}
+
 static inline bool
 batadv_dat_drop_broadcast_packet(struct batadv_priv *bat_priv,
 				 struct batadv_forw_packet *forw_packet)
@@ -171,6 +208,15 @@ static inline void batadv_dat_free(struct batadv_priv *bat_priv)
 {
 }
 
+static inline int batadv_dat_cache_init(void)
+{
+	return 0;
+}
+
+static inline void batadv_dat_cache_destroy(void)
+{
+}
+
 static inline int
 batadv_dat_cache_dump(struct sk_buff *msg, struct netlink_callback *cb)
 {
@@ -21,14 +21,19 @@
 
 #include <linux/atomic.h>
 #include <linux/byteorder/generic.h>
+#include <linux/cache.h>
 #include <linux/errno.h>
 #include <linux/etherdevice.h>
 #include <linux/gfp.h>
 #include <linux/if_ether.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
+#include <linux/list.h>
 #include <linux/lockdep.h>
+#include <linux/mm.h>
 #include <linux/netdevice.h>
+#include <linux/rculist.h>
+#include <linux/rcupdate.h>
 #include <linux/skbuff.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
@@ -40,6 +45,9 @@
 #include "routing.h"
 #include "send.h"
 #include "soft-interface.h"
+#include "tvlv.h"
+
+static struct kmem_cache *batadv_frag_cache __read_mostly;
 
 /**
  * batadv_frag_clear_chain() - delete entries in the fragment buffer chain
@@ -61,32 +69,145 @@ static void batadv_frag_clear_chain(struct hlist_head *head, bool dropped)
 		else
 			consume_skb(entry->skb);
 
-		kfree(entry);
+		kmem_cache_free(batadv_frag_cache, entry);
+	}
+}
+
+/**
+ * batadv_frag_reset_chain() - drop all fragments of a fragment chain
+ * @bat_priv: the bat priv with all the soft interface information
+ * @chain: chain in fragments table to reset
+ * @dropped: whether the chain is cleared because all fragments are dropped
+ *
+ * Caller must hold orig_node->frag_lock.
+ */
+static void batadv_frag_reset_chain(struct batadv_priv *bat_priv,
+				    struct batadv_frag_table_entry *chain,
+				    bool dropped)
+{
+	batadv_frag_clear_chain(&chain->fragment_list, dropped);
+	atomic_sub(chain->truesize, &bat_priv->frag_mem);
+	chain->truesize = 0;
+	chain->size = 0;
+}
+
+/**
+ * batadv_frag_table_alloc() - allocate a fragment buffer table
+ * @num_chains: number of fragment chains in the table
+ *
+ * Return: the new table or NULL on allocation failure
+ */
+static struct batadv_frag_table *batadv_frag_table_alloc(u16 num_chains)
+{
+	struct batadv_frag_table *table;
+	u16 i;
+
+	table = kzalloc(sizeof(*table) + num_chains * sizeof(table->chains[0]),
+			GFP_ATOMIC);
+	if (!table)
+		return NULL;
+
+	table->num_chains = num_chains;
+	for (i = 0; i < num_chains; i++)
+		INIT_HLIST_HEAD(&table->chains[i].fragment_list);
+
+	return table;
+}
+
+/**
+ * batadv_frag_table_grow() - double the number of fragment chains
+ * @orig_node: originator owning the fragment buffer table
+ *
+ * Sequence numbers which are different modulo the old number of chains are
+ * also different modulo the new one. All chains in use can therefore be moved
+ * without any collision. Unused chains are skipped, their (stale) sequence
+ * number could point to the slot of a chain in use.
+ *
+ * Caller must hold orig_node->frag_lock.
+ *
+ * Return: true if the table was replaced by a larger one
+ */
+static bool batadv_frag_table_grow(struct batadv_orig_node *orig_node)
+{
+	struct batadv_frag_table *old = orig_node->frag_table;
+	struct batadv_frag_table_entry *src, *dst;
+	struct batadv_frag_table *table;
+	u16 i;
+
+	lockdep_assert_held(&orig_node->frag_lock);
+
+	if (old->num_chains >= BATADV_FRAG_BUFFER_MAX)
+		return false;
+
+	table = batadv_frag_table_alloc(old->num_chains * 2);
+	if (!table)
+		return false;
+
+	for (i = 0; i < old->num_chains; i++) {
+		src = &old->chains[i];
+		if (hlist_empty(&src->fragment_list))
+			continue;
+
+		dst = &table->chains[src->seqno % table->num_chains];
+
+		hlist_move_list(&src->fragment_list, &dst->fragment_list);
+		dst->timestamp = src->timestamp;
+		dst->truesize = src->truesize;
+		dst->seqno = src->seqno;
+		dst->size = src->size;
+		dst->total_size = src->total_size;
 	}
+
+	table->timestamp = old->timestamp;
+	orig_node->frag_table = table;
+	kfree(old);
+
+	return true;
 }
 
 /**
  * batadv_frag_purge_orig() - free fragments associated to an orig
  * @orig_node: originator to free fragments from
  * @check_cb: optional function to tell if an entry should be purged
+ *
+ * The fragment buffer table itself is released when all fragments are purged
+ * or no fragment was received for BATADV_FRAG_TIMEOUT.
  */
 void batadv_frag_purge_orig(struct batadv_orig_node *orig_node,
 			    bool (*check_cb)(struct batadv_frag_table_entry *))
 {
+	struct batadv_priv *bat_priv = orig_node->bat_priv;
 	struct batadv_frag_table_entry *chain;
-	u8 i;
+	struct batadv_frag_table *table;
+	bool unused = true;
+	u16 i;
 
-	for (i = 0; i < BATADV_FRAG_BUFFER_COUNT; i++) {
-		chain = &orig_node->fragments[i];
-		spin_lock_bh(&chain->lock);
+	spin_lock_bh(&orig_node->frag_lock);
 
-		if (!check_cb || check_cb(chain)) {
-			batadv_frag_clear_chain(&chain->fragment_list, true);
-			chain->size = 0;
-		}
+	table = orig_node->frag_table;
+	if (!table)
+		goto unlock;
+
+	for (i = 0; i < table->num_chains; i++) {
+		chain = &table->chains[i];
+
+		if (!check_cb || check_cb(chain))
+			batadv_frag_reset_chain(bat_priv, chain, true);
 
-		spin_unlock_bh(&chain->lock);
+		if (!hlist_empty(&chain->fragment_list))
+			unused = false;
 	}
+
+	if (check_cb &&
+	    (!unused ||
+	     !batadv_has_timed_out(table->timestamp, BATADV_FRAG_TIMEOUT)))
+		goto unlock;
+
+	orig_node->frag_table = NULL;
+	kfree(table);
+
+unlock:
+	spin_unlock_bh(&orig_node->frag_lock);
 }
 
 /**
@@ -106,34 +227,84 @@ static int batadv_frag_size_limit(void)
 
 /**
  * batadv_frag_init_chain() - check and prepare fragment chain for new fragment
+ * @orig_node: originator owning the fragment buffer table
  * @chain: chain in fragments table to init
  * @seqno: sequence number of the received fragment
  *
  * Make chain ready for a fragment with sequence number "seqno". Delete existing
  * entries if they have an "old" sequence number.
  *
- * Caller must hold chain->lock.
+ * Caller must hold orig_node->frag_lock.
  *
  * Return: true if chain is empty and caller can just insert the new fragment
  * without searching for the right position.
  */
-static bool batadv_frag_init_chain(struct batadv_frag_table_entry *chain,
+static bool batadv_frag_init_chain(struct batadv_orig_node *orig_node,
+				   struct batadv_frag_table_entry *chain,
 				   u16 seqno)
 {
-	lockdep_assert_held(&chain->lock);
+	struct batadv_priv *bat_priv = orig_node->bat_priv;
+
+	lockdep_assert_held(&orig_node->frag_lock);
 
 	if (chain->seqno == seqno)
 		return false;
 
-	if (!hlist_empty(&chain->fragment_list))
-		batadv_frag_clear_chain(&chain->fragment_list, true);
+	/* an incomplete chain which is still waiting for fragments */
+	if (!hlist_empty(&chain->fragment_list) &&
+	    !batadv_frag_check_entry(chain))
+		batadv_inc_counter(bat_priv, BATADV_CNT_FRAG_EVICT);
 
-	chain->size = 0;
+	batadv_frag_reset_chain(bat_priv, chain, true);
 	chain->seqno = seqno;
 
 	return true;
 }
 
+/**
+ * batadv_frag_get_chain() - select the fragment chain for a sequence number
+ * @orig_node: originator that the fragment was received from
+ * @seqno: sequence number of the received fragment
+ *
+ * The fragment buffer table is allocated when the first fragment of an
+ * originator is received. It grows when an incomplete chain would otherwise
+ * be evicted by a newer sequence number.
+ *
+ * Caller must hold orig_node->frag_lock.
+ *
+ * Return: the chain for seqno or NULL if no table could be allocated
+ */
+static struct batadv_frag_table_entry *
+batadv_frag_get_chain(struct batadv_orig_node *orig_node, u16 seqno)
+{
+	struct batadv_frag_table_entry *chain;
+	struct batadv_frag_table *table;
+
+	lockdep_assert_held(&orig_node->frag_lock);
+
+	if (!orig_node->frag_table) {
+		table = batadv_frag_table_alloc(BATADV_FRAG_BUFFER_COUNT);
+		if (!table)
+			return NULL;
+
+		orig_node->frag_table = table;
+	}
+
+	do {
+		table = orig_node->frag_table;
+		chain = &table->chains[seqno % table->num_chains];
+
+		if (chain->seqno == seqno ||
+		    hlist_empty(&chain->fragment_list) ||
+		    batadv_frag_check_entry(chain))
+			break;
+	} while (batadv_frag_table_grow(orig_node));
+
+	table->timestamp = jiffies;
+
+	return chain;
+}
+
 /**
  * batadv_frag_insert_packet() - insert a fragment into a fragment chain
  * @orig_node: originator that the fragment was received from
@@ -142,6 +313,8 @@ static bool batadv_frag_init_chain(struct batadv_frag_table_entry *chain,
  *
  * Insert a new fragment into the reverse ordered chain in the right table
  * entry. The hash table entry is cleared if "old" fragments exist in it.
+ * Fragments are sent starting with number 0, so in order fragments are always
+ * added in front of the first entry without walking the chain.
  *
  * Return: true if skb is buffered, false on error. If the chain has all the
  * fragments needed to merge the packet, the chain is moved to the passed head
@@ -151,26 +324,33 @@ static bool batadv_frag_insert_packet(struct batadv_orig_node *orig_node,
 				      struct sk_buff *skb,
 				      struct hlist_head *chain_out)
 {
+	struct batadv_priv *bat_priv = orig_node->bat_priv;
 	struct batadv_frag_table_entry *chain;
 	struct batadv_frag_list_entry *frag_entry_new = NULL, *frag_entry_curr;
 	struct batadv_frag_list_entry *frag_entry_last = NULL;
 	struct batadv_frag_packet *frag_packet;
-	u8 bucket;
+	unsigned int truesize = skb->truesize;
 	u16 seqno, hdr_size = sizeof(struct batadv_frag_packet);
 	bool ret = false;
 
-	/* Linearize packet to avoid linearizing 16 packets in a row when doing
-	 * the later merge. Non-linear merge should be added to remove this
-	 * linearization.
+	/* only the fragment header has to be linear, the payload is chained
+	 * as it is by batadv_frag_merge_packets()
 	 */
-	if (skb_linearize(skb) < 0)
+	if (!pskb_may_pull(skb, hdr_size))
 		goto err;
 
+	/* the limit is not enforced atomically with the later accounting, it
+	 * can only be exceeded by the fragments processed concurrently
+	 */
+	if (atomic_read(&bat_priv->frag_mem) + truesize > BATADV_FRAG_MEM_MAX) {
+		batadv_inc_counter(bat_priv, BATADV_CNT_FRAG_MEM_DROP);
+		goto err;
+	}
+
 	frag_packet = (struct batadv_frag_packet *)skb->data;
 	seqno = ntohs(frag_packet->seqno);
-	bucket = seqno % BATADV_FRAG_BUFFER_COUNT;
 
-	frag_entry_new = kmalloc(sizeof(*frag_entry_new), GFP_ATOMIC);
+	frag_entry_new = kmem_cache_alloc(batadv_frag_cache, GFP_ATOMIC);
 	if (!frag_entry_new)
 		goto err;
 
@@ -181,9 +361,12 @@ static bool batadv_frag_insert_packet(struct batadv_orig_node *orig_node,
 	 * with another sequence number. batadv_frag_init_chain() returns true,
 	 * if the list is empty at return.
 	 */
-	chain = &orig_node->fragments[bucket];
-	spin_lock_bh(&chain->lock);
-	if (batadv_frag_init_chain(chain, seqno)) {
+	spin_lock_bh(&orig_node->frag_lock);
+	chain = batadv_frag_get_chain(orig_node, seqno);
+	if (!chain)
+		goto err_unlock;
+
+	if (batadv_frag_init_chain(orig_node, chain, seqno)) {
 		hlist_add_head(&frag_entry_new->list, &chain->fragment_list);
 		chain->size = skb->len - hdr_size;
 		chain->timestamp = jiffies;
@@ -221,6 +404,11 @@ static bool batadv_frag_insert_packet(struct batadv_orig_node *orig_node,
 	}
 
 out:
+	if (ret) {
+		chain->truesize += truesize;
+		atomic_add(truesize, &bat_priv->frag_mem);
+	}
+
 	if (chain->size > batadv_frag_size_limit() ||
 	    chain->total_size != ntohs(frag_packet->total_size) ||
 	    chain->total_size > batadv_frag_size_limit()) {
@@ -228,20 +416,22 @@ out:
 		 * exceeds the maximum size of one merged packet. Don't allow
 		 * packets to have different total_size.
 		 */
-		batadv_frag_clear_chain(&chain->fragment_list, true);
-		chain->size = 0;
+		batadv_frag_reset_chain(bat_priv, chain, true);
 	} else if (ntohs(frag_packet->total_size) == chain->size) {
 		/* All fragments received. Hand over chain to caller. */
 		hlist_move_list(&chain->fragment_list, chain_out);
+		atomic_sub(chain->truesize, &bat_priv->frag_mem);
+		chain->truesize = 0;
 		chain->size = 0;
 	}
 
 err_unlock:
-	spin_unlock_bh(&chain->lock);
+	spin_unlock_bh(&orig_node->frag_lock);
 
 err:
 	if (!ret) {
-		kfree(frag_entry_new);
+		if (frag_entry_new)
+			kmem_cache_free(batadv_frag_cache, frag_entry_new);
 		kfree_skb(skb);
 	}
 
@@ -252,17 +442,17 @@ err:
  * batadv_frag_merge_packets() - merge a chain of fragments
  * @chain: head of chain with fragments
  *
- * Expand the first skb in the chain and copy the content of the remaining
- * skb's into the expanded one. After doing so, clear the chain.
+ * Strip the fragment headers and attach the remaining skbs to the frag_list
+ * of the first skb in the chain. The payload is never copied. After doing so,
+ * clear the chain.
  *
  * Return: the merged skb or NULL on error.
  */
 static struct sk_buff *
 batadv_frag_merge_packets(struct hlist_head *chain)
 {
-	struct batadv_frag_packet *packet;
 	struct batadv_frag_list_entry *entry;
-	struct sk_buff *skb_out;
+	struct sk_buff *skb_out, *skb, **tail;
 	int size, hdr_size = sizeof(struct batadv_frag_packet);
 	bool dropped = false;
 
@@ -272,13 +462,10 @@ batadv_frag_merge_packets(struct hlist_head *chain)
 	entry = hlist_entry(chain->first, struct batadv_frag_list_entry, list);
 	hlist_del(&entry->list);
 	skb_out = entry->skb;
-	kfree(entry);
+	kmem_cache_free(batadv_frag_cache, entry);
 
-	packet = (struct batadv_frag_packet *)skb_out->data;
-	size = ntohs(packet->total_size);
-
-	/* Make room for the rest of the fragments. */
-	if (pskb_expand_head(skb_out, 0, size - skb_out->len, GFP_ATOMIC) < 0) {
+	/* The MAC header of the first fragment is modified below */
+	if (skb_unclone(skb_out, GFP_ATOMIC) < 0) {
 		kfree_skb(skb_out);
 		skb_out = NULL;
 		dropped = true;
@@ -295,11 +482,26 @@ batadv_frag_merge_packets(struct hlist_head *chain)
 	skb_reset_network_header(skb_out);
 	skb_reset_transport_header(skb_out);
 
-	/* Copy the payload of the each fragment into the last skb */
+	/* Append the payload of each fragment behind the first one */
+	tail = &skb_shinfo(skb_out)->frag_list;
+	while (*tail)
+		tail = &(*tail)->next;
+
 	hlist_for_each_entry(entry, chain, list) {
-		size = entry->skb->len - hdr_size;
-		skb_put_data(skb_out, entry->skb->data + hdr_size, size);
+		skb = entry->skb;
+		entry->skb = NULL;
+
+		skb_pull(skb, hdr_size);
+		size = skb->len;
+
+		*tail = skb;
+		tail = &skb->next;
+
+		skb_out->len += size;
+		skb_out->data_len += size;
+		skb_out->truesize += skb->truesize;
 	}
+	*tail = NULL;
 
 free:
 	/* Locking is not needed, because 'chain' is not part of any orig. */
@@ -375,7 +577,7 @@ bool batadv_frag_skb_fwd(struct sk_buff *skb,
 	if (!orig_node_dst)
 		goto out;
 
-	neigh_node = batadv_find_router(bat_priv, orig_node_dst, recv_if);
+	neigh_node = batadv_find_router(bat_priv, orig_node_dst, recv_if, skb);
 	if (!neigh_node)
 		goto out;
 
@@ -401,6 +603,76 @@ out:
 	return ret;
 }
 
+/**
+ * batadv_frag_can_share_head() - check if the linear tail of skb can be
+ *  attached to a fragment as page fragment
+ * @skb: skb to create fragment from
+ * @pos: offset in skb at which the fragment starts
+ *
+ * Return: true if batadv_frag_split_head() can be used, false if the linear
+ * tail has to be copied by skb_split()
+ */
+static bool batadv_frag_can_share_head(struct sk_buff *skb, unsigned int pos)
+{
+	if (!skb->head_frag)
+		return false;
+
+	if (pos >= skb_headlen(skb))
+		return false;
+
+	/* the frags of a clone are shared with e.g. a TCP retransmit queue */
+	if (skb_cloned(skb))
+		return false;
+
+	if (skb_shinfo(skb)->nr_frags >= MAX_SKB_FRAGS)
+		return false;
+
+	/* user pages must not be referenced behind the owner's back */
+	if (skb_shinfo(skb)->tx_flags & SKBTX_DEV_ZEROCOPY)
+		return false;
+
+	return true;
+}
+
+/**
+ * batadv_frag_split_head() - move the data behind pos to a new fragment
+ * @skb: skb to create fragment from, with a page backed linear part
+ * @skb_fragment: new fragment without any data
+ * @pos: offset in skb at which the fragment starts
+ *
+ * Like skb_split() but the linear tail of skb is referenced as first page
+ * fragment of skb_fragment instead of being copied.
+ */
+static void batadv_frag_split_head(struct sk_buff *skb,
+				   struct sk_buff *skb_fragment,
+				   unsigned int pos)
+{
+	struct page *page = virt_to_head_page(skb->head);
+	unsigned int len = skb_headlen(skb) - pos;
+	unsigned int offset;
+	int i;
+
+	offset = skb->data + pos - (unsigned char *)page_address(page);
+
+	get_page(page);
+	__skb_fill_page_desc(skb_fragment, 0, page, offset, len);
+
+	for (i = 0; i < skb_shinfo(skb)->nr_frags; i++)
+		skb_shinfo(skb_fragment)->frags[i + 1] =
+			skb_shinfo(skb)->frags[i];
+
+	skb_shinfo(skb_fragment)->nr_frags = skb_shinfo(skb)->nr_frags + 1;
+	skb_shinfo(skb_fragment)->tx_flags |= skb_shinfo(skb)->tx_flags &
+					      SKBTX_SHARED_FRAG;
+	skb_fragment->len = skb->len - pos;
+	skb_fragment->data_len = skb_fragment->len;
+
+	skb_shinfo(skb)->nr_frags = 0;
+	skb->data_len = 0;
+	skb->len = pos;
+	skb_set_tail_pointer(skb, pos);
+}
+
 /**
  * batadv_frag_create() - create a fragment from skb
  * @skb: skb to create fragment from
@@ -409,7 +681,8 @@ out:
  *
  * Split the passed skb into two fragments: A new one with size matching the
  * passed mtu and the old one with the rest. The new skb contains data from the
- * tail of the old skb.
+ * tail of the old skb. The payload is shared with the old skb whenever it is
+ * stored in pages, only the fragment header is written to the new skb.
  *
  * Return: the new fragment, NULL on error.
  */
@@ -419,17 +692,35 @@ static struct sk_buff *batadv_frag_create(struct sk_buff *skb,
 {
 	struct sk_buff *skb_fragment;
 	unsigned int header_size = sizeof(*frag_head);
-	unsigned int mtu = fragment_size + header_size;
+	unsigned int pos = skb->len - fragment_size;
+	unsigned int linear = 0;
+	bool share_head;
 
-	skb_fragment = netdev_alloc_skb(NULL, mtu + ETH_HLEN);
+	/* only the part of the linear data which can't be referenced has to
+	 * be copied to the new fragment
+	 */
+	share_head = batadv_frag_can_share_head(skb, pos);
+	if (!share_head && pos < skb_headlen(skb))
+		linear = skb_headlen(skb) - pos;
+
+	skb_fragment = netdev_alloc_skb(NULL, linear + header_size + ETH_HLEN);
 	if (!skb_fragment)
 		goto err;
 
 	skb_fragment->priority = skb->priority;
 
+	/* keep all fragments of a flow on the same transmit queue */
+	if (skb->l4_hash)
+		skb_set_hash(skb_fragment, skb->hash, PKT_HASH_TYPE_L4);
+	else if (skb->hash)
+		skb_set_hash(skb_fragment, skb->hash, PKT_HASH_TYPE_L3);
+
 	/* Eat the last mtu-bytes of the skb */
 	skb_reserve(skb_fragment, header_size + ETH_HLEN);
-	skb_split(skb, skb_fragment, skb->len - fragment_size);
+	if (share_head)
+		batadv_frag_split_head(skb, skb_fragment, pos);
+	else
+		skb_split(skb, skb_fragment, pos);
 
 	/* Add the header */
 	skb_push(skb_fragment, header_size);
@@ -439,6 +730,140 @@ err:
 	return skb_fragment;
 }
 
+/**
+ * batadv_frag_path_mtu() - get the largest packet which reaches an originator
+ *  without being fragmented
+ * @orig_node: final destination of the packet
+ * @neigh_node: next-hop of the packet
+ *
+ * Return: the MTU of the outgoing interface, lowered to the path MTU learned
+ * from the OGMs of @orig_node if known
+ */
+unsigned int batadv_frag_path_mtu(struct batadv_orig_node *orig_node,
+				  struct batadv_neigh_node *neigh_node)
+{
+	unsigned int mtu = neigh_node->if_incoming->net_dev->mtu;
+	u16 path_mtu = READ_ONCE(orig_node->path_mtu);
+
+	if (path_mtu)
+		mtu = min_t(unsigned int, mtu, path_mtu);
+
+	return mtu;
+}
+
+/**
+ * batadv_frag_path_mtu_announce() - announce the smallest MTU of the active
+ *  hard interfaces as start value of the path MTU
+ * @bat_priv: the bat priv with all the soft interface information
+ */
+void batadv_frag_path_mtu_announce(struct batadv_priv *bat_priv)
+{
+	struct batadv_tvlv_path_mtu tvlv_path_mtu;
+	struct batadv_hard_iface *hard_iface;
+	unsigned int mtu = U16_MAX;
+	bool active = false;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(hard_iface, &batadv_hardif_list, list) {
+		if (hard_iface->if_status != BATADV_IF_ACTIVE &&
+		    hard_iface->if_status != BATADV_IF_TO_BE_ACTIVATED)
+			continue;
+
+		if (hard_iface->soft_iface != bat_priv->soft_iface)
+			continue;
+
+		mtu = min_t(unsigned int, mtu, hard_iface->net_dev->mtu);
+		active = true;
+	}
+	rcu_read_unlock();
+
+	if (!active) {
+		batadv_tvlv_container_unregister(bat_priv,
+						 BATADV_TVLV_PATH_MTU, 1);
+		return;
+	}
+
+	tvlv_path_mtu.mtu = htons(mtu);
+	tvlv_path_mtu.reserved = 0;
+
+	batadv_tvlv_container_register(bat_priv, BATADV_TVLV_PATH_MTU, 1,
+				       &tvlv_path_mtu, sizeof(tvlv_path_mtu));
+}
+
+/**
+ * batadv_frag_path_mtu_ogm_update() - lower and learn the path MTU of an OGM
+ * @orig_node: the originator which emitted the OGM
+ * @neigh_addr: address of the neighbor the OGM was received from
+ * @tvlv_value: tvlv buffer of the OGM
+ * @tvlv_value_len: length of @tvlv_value
+ * @if_incoming: interface the OGM was received on
+ *
+ * The path MTU in the OGM is lowered to the MTU of @if_incoming before the OGM
+ * is processed, so that forwarded copies carry the smallest MTU of the path
+ * they took, like the throughput metric of B.A.T.M.A.N. V. The result becomes
+ * the path MTU of @orig_node when the OGM came from the best next hop towards
+ * it or no next hop was selected yet. Such an OGM without path MTU container
+ * makes the path MTU of @orig_node unknown again.
+ *
+ * The caller has to make sure that @tvlv_value is writable, e.g. via
+ * batadv_check_management_packet().
+ */
+void batadv_frag_path_mtu_ogm_update(struct batadv_orig_node *orig_node,
+				     const u8 *neigh_addr, u8 *tvlv_value,
+				     u16 tvlv_value_len,
+				     struct batadv_hard_iface *if_incoming)
+{
+	struct batadv_tvlv_path_mtu *path_mtu = NULL;
+	struct batadv_neigh_node *router;
+	struct batadv_tvlv_hdr *tvlv_hdr;
+	u16 tvlv_value_cont_len;
+	unsigned int mtu;
+
+	while (tvlv_value_len >= sizeof(*tvlv_hdr)) {
+		tvlv_hdr = (struct batadv_tvlv_hdr *)tvlv_value;
+		tvlv_value_cont_len = ntohs(tvlv_hdr->len);
+		tvlv_value += sizeof(*tvlv_hdr);
+		tvlv_value_len -= sizeof(*tvlv_hdr);
+
+		if (tvlv_value_cont_len > tvlv_value_len)
+			return;
+
+		if (tvlv_hdr->type == BATADV_TVLV_PATH_MTU &&
+		    tvlv_hdr->version == 1 &&
+		    tvlv_value_cont_len >= sizeof(*path_mtu)) {
+			path_mtu = (struct batadv_tvlv_path_mtu *)tvlv_value;
+			break;
+		}
+
+		tvlv_value += tvlv_value_cont_len;
+		tvlv_value_len -= tvlv_value_cont_len;
+	}
+
+	if (path_mtu) {
+		mtu = min_t(unsigned int, ntohs(path_mtu->mtu),
+			    if_incoming->net_dev->mtu);
+		path_mtu->mtu = htons(mtu);
+
+		/* don't let a bogus announcement make the originator
+		 * unreachable
+		 */
+		if (mtu < ETH_MIN_MTU)
+			return;
+	} else {
+		mtu = 0;
+	}
+
+	router = batadv_orig_router_get(orig_node, BATADV_IF_DEFAULT);
+	if (router && !batadv_compare_eth(router->addr, neigh_addr))
+		goto out;
+
+	WRITE_ONCE(orig_node->path_mtu, mtu);
+
+out:
+	if (router)
+		batadv_neigh_node_put(router);
+}
+
 /**
  * batadv_frag_send_packet() - create up to 16 fragments from the passed skb
  * @skb: skb to create fragments from
@@ -455,13 +880,13 @@ int batadv_frag_send_packet(struct sk_buff *skb,
 	struct batadv_hard_iface *primary_if = NULL;
 	struct batadv_frag_packet frag_header;
 	struct sk_buff *skb_fragment;
-	unsigned int mtu = neigh_node->if_incoming->net_dev->mtu;
+	unsigned int mtu = batadv_frag_path_mtu(orig_node, neigh_node);
 	unsigned int header_size = sizeof(frag_header);
 	unsigned int max_fragment_size, num_fragments;
 	int ret;
 
 	/* To avoid merge and refragmentation at next-hops we never send
-	 * fragments larger than BATADV_FRAG_MAX_FRAG_SIZE
+	 * fragments larger than BATADV_FRAG_MAX_FRAG_SIZE or the path MTU
 	 */
 	mtu = min_t(unsigned int, mtu, BATADV_FRAG_MAX_FRAG_SIZE);
 	max_fragment_size = mtu - header_size;
@@ -485,6 +910,24 @@ int batadv_frag_send_packet(struct sk_buff *skb,
 		goto free_skb;
 	}
 
+	/* skb_split() only handles page fragments */
+	if (skb_has_frag_list(skb) && __skb_linearize(skb) < 0) {
+		ret = -ENOMEM;
+		goto put_primary_if;
+	}
+
+	/* splitting rewrites the frags of skb which a clone would share */
+	if (skb_unclone(skb, GFP_ATOMIC) < 0) {
+		ret = -ENOMEM;
+		goto put_primary_if;
+	}
+
+	/* the fragments can't carry an offloaded checksum of the payload */
+	if (skb->ip_summed == CHECKSUM_PARTIAL && skb_checksum_help(skb) < 0) {
+		ret = -ENOMEM;
+		goto put_primary_if;
+	}
+
 	/* Create one header to be copied to all fragments */
 	frag_header.packet_type = BATADV_UNICAST_FRAG;
 	frag_header.version = BATADV_COMPAT_VERSION;
@@ -534,9 +977,12 @@ int batadv_frag_send_packet(struct sk_buff *skb,
 		frag_header.no++;
 	}
 
-	/* Make room for the fragment header. */
-	if (batadv_skb_head_push(skb, header_size) < 0 ||
-	    pskb_expand_head(skb, header_size + ETH_HLEN, 0, GFP_ATOMIC) < 0) {
+	/* Make room for the fragment header. The headroom for the ethernet
+	 * header is ensured by batadv_send_skb_packet() without copying the
+	 * remaining payload again.
+	 */
+	if (batadv_skb_head_push(bat_priv, skb, header_size,
+				 BATADV_CNT_HEADROOM_ENCAP) < 0) {
 		ret = -ENOMEM;
 		goto put_primary_if;
 	}
@@ -558,3 +1004,29 @@ free_skb:
 
 	return ret;
 }
+
+/**
+ * batadv_frag_cache_init() - Initialize fragment memory object cache
+ *
+ * Return: 0 on success or negative error number in case of failure.
+ */
+int __init batadv_frag_cache_init(void)
+{
+	size_t size = sizeof(struct batadv_frag_list_entry);
+
+	batadv_frag_cache =
+		kmem_cache_create("batadv_frag_cache", size, 0,
+				  SLAB_HWCACHE_ALIGN, NULL);
+	if (!batadv_frag_cache)
+		return -ENOMEM;
+
+	return 0;
+}
+
+/**
+ * batadv_frag_cache_destroy() - Destroy fragment memory object cache
+ */
+void batadv_frag_cache_destroy(void)
+{
+	kmem_cache_destroy(batadv_frag_cache);
+}
@@ -35,9 +35,18 @@ bool batadv_frag_skb_fwd(struct sk_buff *skb,
 			 struct batadv_orig_node *orig_node_src);
 bool batadv_frag_skb_buffer(struct sk_buff **skb,
 			    struct batadv_orig_node *orig_node);
+int batadv_frag_cache_init(void);
+void batadv_frag_cache_destroy(void);
 int batadv_frag_send_packet(struct sk_buff *skb,
 			    struct batadv_orig_node *orig_node,
 			    struct batadv_neigh_node *neigh_node);
+unsigned int batadv_frag_path_mtu(struct batadv_orig_node *orig_node,
+				  struct batadv_neigh_node *neigh_node);
+void batadv_frag_path_mtu_announce(struct batadv_priv *bat_priv);
+void batadv_frag_path_mtu_ogm_update(struct batadv_orig_node *orig_node,
+				     const u8 *neigh_addr, u8 *tvlv_value,
+				     u16 tvlv_value_len,
+				     struct batadv_hard_iface *if_incoming);
 
 /**
  * batadv_frag_check_entry() - check if a list of fragments has timed out
@@ -21,6 +21,7 @@
 
 #include <linux/atomic.h>
 #include <linux/byteorder/generic.h>
+#include <linux/compiler.h>
 #include <linux/errno.h>
 #include <linux/etherdevice.h>
 #include <linux/gfp.h>
@@ -29,9 +30,11 @@
 #include <linux/in.h>
 #include <linux/ip.h>
 #include <linux/ipv6.h>
+#include <linux/jhash.h>
 #include <linux/kernel.h>
 #include <linux/kref.h>
 #include <linux/list.h>
+#include <linux/lockdep.h>
 #include <linux/netdevice.h>
 #include <linux/netlink.h>
 #include <linux/rculist.h>
@@ -117,38 +120,6 @@ out:
 	return gw_node;
 }
 
-/**
- * batadv_gw_get_selected_orig() - Get originator of currently selected gateway
- * @bat_priv: the bat priv with all the soft interface information
- *
- * Return: orig_node of selected gateway (with increased refcnt), NULL on errors
- */
-struct batadv_orig_node *
-batadv_gw_get_selected_orig(struct batadv_priv *bat_priv)
-{
-	struct batadv_gw_node *gw_node;
-	struct batadv_orig_node *orig_node = NULL;
-
-	gw_node = batadv_gw_get_selected_gw_node(bat_priv);
-	if (!gw_node)
-		goto out;
-
-	rcu_read_lock();
-	orig_node = gw_node->orig_node;
-	if (!orig_node)
-		goto unlock;
-
-	if (!kref_get_unless_zero(&orig_node->refcount))
-		orig_node = NULL;
-
-unlock:
-	rcu_read_unlock();
-out:
-	if (gw_node)
-		batadv_gw_node_put(gw_node);
-	return orig_node;
-}
-
 static void batadv_gw_select(struct batadv_priv *bat_priv,
 			     struct batadv_gw_node *new_gw_node)
 {
@@ -162,10 +133,14 @@ static void batadv_gw_select(struct batadv_priv *bat_priv,
 	curr_gw_node = rcu_dereference_protected(bat_priv->gw.curr_gw, 1);
 	rcu_assign_pointer(bat_priv->gw.curr_gw, new_gw_node);
 
+	spin_unlock_bh(&bat_priv->gw.list_lock);
+
+	if (curr_gw_node != new_gw_node)
+		batadv_netlink_notify_gw(bat_priv, BATADV_EVENT_GW_SELECT,
+					 new_gw_node);
+
 	if (curr_gw_node)
 		batadv_gw_node_put(curr_gw_node);
-
-	spin_unlock_bh(&bat_priv->gw.list_lock);
 }
 
 /**
@@ -184,6 +159,234 @@ void batadv_gw_reselect(struct batadv_priv *bat_priv)
 	atomic_set(&bat_priv->gw.reselect, 1);
 }
 
+/**
+ * batadv_gw_rank_best() - find the gateway with the highest metric
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * Only the metrics cached in the gateway nodes are compared, no router lookup
+ * is performed. The caller must hold the gw.list_lock.
+ *
+ * Return: the best ranked gateway (without increased refcnt), NULL if none of
+ * the gateways can be selected
+ */
+static struct batadv_gw_node *batadv_gw_rank_best(struct batadv_priv *bat_priv)
+{
+	struct batadv_gw_node *gw_node, *best_gw = NULL;
+
+	lockdep_assert_held(&bat_priv->gw.list_lock);
+
+	hlist_for_each_entry(gw_node, &bat_priv->gw.gateway_list, list) {
+		if (gw_node->metric == 0)
+			continue;
+
+		if (best_gw && gw_node->metric <= best_gw->metric)
+			continue;
+
+		best_gw = gw_node;
+	}
+
+	return best_gw;
+}
+
+/**
+ * batadv_gw_rank_set() - replace the best ranked gateway
+ * @bat_priv: the bat priv with all the soft interface information
+ * @best_gw: the new best ranked gateway (may be NULL)
+ *
+ * The caller must hold the gw.list_lock and has to release the returned
+ * gateway node after the lock was dropped.
+ *
+ * Return: the previous best ranked gateway (with increased refcnt), NULL if
+ * none was set
+ */
+static struct batadv_gw_node *
+batadv_gw_rank_set(struct batadv_priv *bat_priv,
+		   struct batadv_gw_node *best_gw)
+{
+	struct batadv_gw_node *old_gw;
+
+	lockdep_assert_held(&bat_priv->gw.list_lock);
+
+	if (best_gw)
+		kref_get(&best_gw->refcount);
+
+	old_gw = rcu_dereference_protected(bat_priv->gw.best_gw, 1);
+	rcu_assign_pointer(bat_priv->gw.best_gw, best_gw);
+
+	return old_gw;
+}
+
+/**
+ * batadv_gw_rank_update() - update the ranking with the metric of a gateway
+ * @bat_priv: the bat priv with all the soft interface information
+ * @gw_node: the gateway which has to be ranked again
+ *
+ * The list of gateways only has to be searched again when the best ranked
+ * gateway got worse. Otherwise the new metric is only compared against the
+ * one of the best ranked gateway.
+ */
+static void batadv_gw_rank_update(struct batadv_priv *bat_priv,
+				  struct batadv_gw_node *gw_node)
+{
+	struct batadv_gw_node *best_gw, *old_gw = NULL;
+	u64 metric, old_metric;
+
+	metric = bat_priv->algo_ops->gw.metric(bat_priv, gw_node);
+
+	spin_lock_bh(&bat_priv->gw.list_lock);
+
+	/* the gateway was removed in the meantime */
+	if (hlist_unhashed(&gw_node->list))
+		goto unlock;
+
+	old_metric = gw_node->metric;
+	WRITE_ONCE(gw_node->metric, metric);
+
+	best_gw = rcu_dereference_protected(bat_priv->gw.best_gw, 1);
+	if (best_gw == gw_node) {
+		if (metric < old_metric) {
+			best_gw = batadv_gw_rank_best(bat_priv);
+			old_gw = batadv_gw_rank_set(bat_priv, best_gw);
+		}
+	} else if (metric != 0 && (!best_gw || metric > best_gw->metric)) {
+		old_gw = batadv_gw_rank_set(bat_priv, gw_node);
+	}
+
+unlock:
+	spin_unlock_bh(&bat_priv->gw.list_lock);
+
+	if (old_gw)
+		batadv_gw_node_put(old_gw);
+}
+
+/**
+ * batadv_gw_rank_refresh() - compute the metric of all gateways again
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * Has to be called when the ranking rules changed (e.g. the selection class)
+ * since the cached metrics are otherwise only refreshed by the OGMs of the
+ * gateways.
+ */
+void batadv_gw_rank_refresh(struct batadv_priv *bat_priv)
+{
+	struct batadv_gw_node *gw_node, *old_gw;
+	u64 metric;
+
+	if (!bat_priv->algo_ops->gw.metric)
+		return;
+
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(gw_node, &bat_priv->gw.gateway_list, list) {
+		metric = bat_priv->algo_ops->gw.metric(bat_priv, gw_node);
+		WRITE_ONCE(gw_node->metric, metric);
+	}
+	rcu_read_unlock();
+
+	spin_lock_bh(&bat_priv->gw.list_lock);
+	old_gw = batadv_gw_rank_set(bat_priv, batadv_gw_rank_best(bat_priv));
+	spin_unlock_bh(&bat_priv->gw.list_lock);
+
+	if (old_gw)
+		batadv_gw_node_put(old_gw);
+}
+
+/**
+ * batadv_gw_get_best_gw_node() - get the best ranked gateway
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * Return: best ranked gateway (with increased refcnt), NULL if none is known
+ */
+static struct batadv_gw_node *
+batadv_gw_get_best_gw_node(struct batadv_priv *bat_priv)
+{
+	struct batadv_gw_node *gw_node;
+
+	rcu_read_lock();
+	gw_node = rcu_dereference(bat_priv->gw.best_gw);
+	if (gw_node && !kref_get_unless_zero(&gw_node->refcount))
+		gw_node = NULL;
+	rcu_read_unlock();
+
+	return gw_node;
+}
+
+/**
+ * batadv_gw_get_client_gw_node() - get the gateway serving a DHCP client
+ * @bat_priv: the bat priv with all the soft interface information
+ * @client: MAC address of the DHCP client
+ *
+ * If gw.balance is set to more than one, the clients are spread across that
+ * many best ranked gateways by a hash of their address. Each gateway gets a
+ * share of the clients proportional to its advertised download bandwidth.
+ * Otherwise all clients are served by the selected gateway.
+ *
+ * Return: gateway node (with increased refcnt), NULL if none is available
+ */
+struct batadv_gw_node *
+batadv_gw_get_client_gw_node(struct batadv_priv *bat_priv, const u8 *client)
+{
+	struct batadv_gw_node *top_gw[BATADV_GW_BALANCE_MAX];
+	u64 top_metric[BATADV_GW_BALANCE_MAX];
+	struct batadv_gw_node *gw_node;
+	u32 weight, total = 0, point;
+	int balance, count = 0, i;
+	u64 metric;
+
+	balance = atomic_read(&bat_priv->gw.balance);
+	if (balance <= 1)
+		return batadv_gw_get_selected_gw_node(bat_priv);
+
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(gw_node, &bat_priv->gw.gateway_list, list) {
+		metric = READ_ONCE(gw_node->metric);
+		if (metric == 0)
+			continue;
+
+		if (count == balance && metric <= top_metric[count - 1])
+			continue;
+
+		if (count < balance)
+			count++;
+
+		/* keep the best ranked gateways sorted by their metric */
+		for (i = count - 1; i > 0 && top_metric[i - 1] < metric; i--) {
+			top_gw[i] = top_gw[i - 1];
+			top_metric[i] = top_metric[i - 1];
+		}
+
+		top_gw[i] = gw_node;
+		top_metric[i] = metric;
+	}
+
+	if (count == 0) {
+		rcu_read_unlock();
+		return batadv_gw_get_selected_gw_node(bat_priv);
+	}
+
+	/* the weights are capped to prevent an overflow of the sum */
+	for (i = 0; i < count; i++)
+		total += min_t(u32, top_gw[i]->bandwidth_down,
+			       U32_MAX / BATADV_GW_BALANCE_MAX);
+
+	point = reciprocal_scale(jhash(client, ETH_ALEN, 0), total);
+
+	for (i = 0; i < count - 1; i++) {
+		weight = min_t(u32, top_gw[i]->bandwidth_down,
+			       U32_MAX / BATADV_GW_BALANCE_MAX);
+		if (point < weight)
+			break;
+
+		point -= weight;
+	}
+
+	gw_node = top_gw[i];
+	if (!kref_get_unless_zero(&gw_node->refcount))
+		gw_node = NULL;
+	rcu_read_unlock();
+
+	return gw_node;
+}
+
 /**
  * batadv_gw_check_client_stop() - check if client mode has been switched off
  * @bat_priv: the bat priv with all the soft interface information
@@ -231,7 +434,7 @@ void batadv_gw_election(struct batadv_priv *bat_priv)
 	if (atomic_read(&bat_priv->gw.mode) != BATADV_GW_MODE_CLIENT)
 		goto out;
 
-	if (!bat_priv->algo_ops->gw.get_best_gw_node)
+	if (!bat_priv->algo_ops->gw.metric)
 		goto out;
 
 	curr_gw = batadv_gw_get_selected_gw_node(bat_priv);
@@ -241,9 +444,9 @@ void batadv_gw_election(struct batadv_priv *bat_priv)
 
 	/* if gw.reselect is set to 1 it means that a previous call to
 	 * gw.is_eligible() said that we have a new best GW, therefore it can
-	 * now be picked from the list and selected
+	 * now be picked from the ranking and selected
 	 */
-	next_gw = bat_priv->algo_ops->gw.get_best_gw_node(bat_priv);
+	next_gw = batadv_gw_get_best_gw_node(bat_priv);
 
 	if (curr_gw == next_gw)
 		goto out;
@@ -254,6 +457,8 @@ void batadv_gw_election(struct batadv_priv *bat_priv)
 		router = batadv_orig_router_get(next_gw->orig_node,
 						BATADV_IF_DEFAULT);
 		if (!router) {
+			/* the cached metric is outdated - rank it again */
+			batadv_gw_rank_update(bat_priv, next_gw);
 			batadv_gw_reselect(bat_priv);
 			goto out;
 		}
@@ -309,14 +514,12 @@ out:
 }
 
 /**
- * batadv_gw_check_election() - Elect orig node as best gateway when eligible
+ * batadv_gw_check_election() - Elect best ranked gateway when eligible
  * @bat_priv: the bat priv with all the soft interface information
- * @orig_node: orig node which is to be checked
  */
-void batadv_gw_check_election(struct batadv_priv *bat_priv,
-			      struct batadv_orig_node *orig_node)
+void batadv_gw_check_election(struct batadv_priv *bat_priv)
 {
-	struct batadv_orig_node *curr_gw_orig;
+	struct batadv_gw_node *curr_gw, *best_gw = NULL;
 
 	/* abort immediately if the routing algorithm does not support gateway
 	 * election
@@ -324,23 +527,28 @@ void batadv_gw_check_election(struct batadv_priv *bat_priv,
 	if (!bat_priv->algo_ops->gw.is_eligible)
 		return;
 
-	curr_gw_orig = batadv_gw_get_selected_orig(bat_priv);
-	if (!curr_gw_orig)
+	curr_gw = batadv_gw_get_selected_gw_node(bat_priv);
+	if (!curr_gw)
 		goto reselect;
 
-	/* this node already is the gateway */
-	if (curr_gw_orig == orig_node)
+	best_gw = batadv_gw_get_best_gw_node(bat_priv);
+	if (!best_gw)
 		goto out;
 
-	if (!bat_priv->algo_ops->gw.is_eligible(bat_priv, curr_gw_orig,
-						orig_node))
+	/* the best ranked node already is the gateway */
+	if (best_gw == curr_gw)
+		goto out;
+
+	if (!bat_priv->algo_ops->gw.is_eligible(bat_priv, curr_gw, best_gw))
 		goto out;
 
 reselect:
 	batadv_gw_reselect(bat_priv);
 out:
-	if (curr_gw_orig)
-		batadv_orig_node_put(curr_gw_orig);
+	if (curr_gw)
+		batadv_gw_node_put(curr_gw);
+	if (best_gw)
+		batadv_gw_node_put(best_gw);
 }
 
 /**
@@ -382,6 +590,10 @@ static void batadv_gw_node_add(struct batadv_priv *bat_priv,
 		   ntohl(gateway->bandwidth_up) / 10,
 		   ntohl(gateway->bandwidth_up) % 10);
 
+	batadv_netlink_notify_gw(bat_priv, BATADV_EVENT_GW_ADD, gw_node);
+
+	batadv_gw_rank_update(bat_priv, gw_node);
+
 	/* don't return reference to new gw_node */
 	batadv_gw_node_put(gw_node);
 }
@@ -426,7 +638,9 @@ void batadv_gw_node_update(struct batadv_priv *bat_priv,
 			   struct batadv_orig_node *orig_node,
 			   struct batadv_tvlv_gateway_data *gateway)
 {
-	struct batadv_gw_node *gw_node, *curr_gw = NULL;
+	struct batadv_gw_node *gw_node, *curr_gw = NULL, *old_gw = NULL;
+	struct batadv_gw_node *best_gw;
+	bool removed = false;
 
 	gw_node = batadv_gw_node_get(bat_priv, orig_node);
 	if (!gw_node) {
@@ -436,7 +650,7 @@ void batadv_gw_node_update(struct batadv_priv *bat_priv,
 
 	if (gw_node->bandwidth_down == ntohl(gateway->bandwidth_down) &&
 	    gw_node->bandwidth_up == ntohl(gateway->bandwidth_up))
-		goto out;
+		goto rank;
 
 	batadv_dbg(BATADV_DBG_BATMAN, bat_priv,
 		   "Gateway bandwidth of originator %pM changed from %u.%u/%u.%u MBit to %u.%u/%u.%u MBit\n",
@@ -465,17 +679,35 @@ void batadv_gw_node_update(struct batadv_priv *bat_priv,
 		if (!hlist_unhashed(&gw_node->list)) {
 			hlist_del_init_rcu(&gw_node->list);
 			batadv_gw_node_put(gw_node);
+			removed = true;
+		}
+
+		best_gw = rcu_dereference_protected(bat_priv->gw.best_gw, 1);
+		if (gw_node == best_gw) {
+			best_gw = batadv_gw_rank_best(bat_priv);
+			old_gw = batadv_gw_rank_set(bat_priv, best_gw);
 		}
 		spin_unlock_bh(&bat_priv->gw.list_lock);
 
+		if (old_gw)
+			batadv_gw_node_put(old_gw);
+
+		if (removed)
+			batadv_netlink_notify_gw(bat_priv, BATADV_EVENT_GW_DEL,
+						 gw_node);
+
 		curr_gw = batadv_gw_get_selected_gw_node(bat_priv);
 		if (gw_node == curr_gw)
 			batadv_gw_reselect(bat_priv);
 
 		if (curr_gw)
 			batadv_gw_node_put(curr_gw);
+
+		goto out;
 	}
 
+rank:
+	batadv_gw_rank_update(bat_priv, gw_node);
 out:
 	if (gw_node)
 		batadv_gw_node_put(gw_node);
@@ -503,16 +735,20 @@ void batadv_gw_node_delete(struct batadv_priv *bat_priv,
  */
 void batadv_gw_node_free(struct batadv_priv *bat_priv)
 {
-	struct batadv_gw_node *gw_node;
+	struct batadv_gw_node *gw_node, *old_gw;
 	struct hlist_node *node_tmp;
 
 	spin_lock_bh(&bat_priv->gw.list_lock);
+	old_gw = batadv_gw_rank_set(bat_priv, NULL);
 	hlist_for_each_entry_safe(gw_node, node_tmp,
 				  &bat_priv->gw.gateway_list, list) {
 		hlist_del_init_rcu(&gw_node->list);
 		batadv_gw_node_put(gw_node);
 	}
 	spin_unlock_bh(&bat_priv->gw.list_lock);
+
+	if (old_gw)
+		batadv_gw_node_put(old_gw);
 }
 
 #ifdef CONFIG_BATMAN_ADV_DEBUGFS
@@ -626,6 +862,7 @@ batadv_gw_dhcp_recipient_get(struct sk_buff *skb, unsigned int *header_len,
 			     u8 *chaddr)
 {
 	enum batadv_dhcp_recipient ret = BATADV_DHCP_NO;
+	struct batadv_skb_cb *cb;
 	struct ethhdr *ethhdr;
 	struct iphdr *iphdr;
 	struct ipv6hdr *ipv6hdr;
@@ -635,6 +872,17 @@ batadv_gw_dhcp_recipient_get(struct sk_buff *skb, unsigned int *header_len,
 	__be16 proto;
 	u8 *p;
 
+	/* reuse the headers parsed by batadv_skb_classify() */
+	cb = batadv_skb_cb_classified(skb, *header_len);
+	if (cb) {
+		if (!cb->transport_offset || cb->l4_proto != IPPROTO_UDP)
+			return BATADV_DHCP_NO;
+
+		proto = cb->l3_proto;
+		*header_len += cb->transport_offset;
+		goto udp;
+	}
+
 	/* check for ethernet header */
 	if (!pskb_may_pull(skb, *header_len + ETH_HLEN))
 		return BATADV_DHCP_NO;
@@ -683,6 +931,7 @@ batadv_gw_dhcp_recipient_get(struct sk_buff *skb, unsigned int *header_len,
 		return BATADV_DHCP_NO;
 	}
 
+udp:
 	if (!pskb_may_pull(skb, *header_len + sizeof(*udphdr)))
 		return BATADV_DHCP_NO;
 
@@ -777,7 +1026,8 @@ bool batadv_gw_out_of_range(struct batadv_priv *bat_priv,
 		curr_tq_avg = BATADV_TQ_MAX_VALUE;
 		break;
 	case BATADV_GW_MODE_CLIENT:
-		curr_gw = batadv_gw_get_selected_gw_node(bat_priv);
+		curr_gw = batadv_gw_get_client_gw_node(bat_priv,
+							ethhdr->h_source);
 		if (!curr_gw)
 			goto out;
 
@@ -790,7 +1040,7 @@ bool batadv_gw_out_of_range(struct batadv_priv *bat_priv,
 		 * reliable enough
 		 */
 		neigh_curr = batadv_find_router(bat_priv, curr_gw->orig_node,
-						NULL);
+						NULL, NULL);
 		if (!neigh_curr)
 			goto out;
 
@@ -808,7 +1058,7 @@ bool batadv_gw_out_of_range(struct batadv_priv *bat_priv,
 		goto out;
 	}
 
-	neigh_old = batadv_find_router(bat_priv, orig_dst_node, NULL);
+	neigh_old = batadv_find_router(bat_priv, orig_dst_node, NULL, NULL);
 	if (!neigh_old)
 		goto out;
 
@@ -31,10 +31,8 @@ struct sk_buff;
 void batadv_gw_check_client_stop(struct batadv_priv *bat_priv);
 void batadv_gw_reselect(struct batadv_priv *bat_priv);
 void batadv_gw_election(struct batadv_priv *bat_priv);
-struct batadv_orig_node *
-batadv_gw_get_selected_orig(struct batadv_priv *bat_priv);
-void batadv_gw_check_election(struct batadv_priv *bat_priv,
-			      struct batadv_orig_node *orig_node);
+void batadv_gw_check_election(struct batadv_priv *bat_priv);
+void batadv_gw_rank_refresh(struct batadv_priv *bat_priv);
 void batadv_gw_node_update(struct batadv_priv *bat_priv,
 			   struct batadv_orig_node *orig_node,
 			   struct batadv_tvlv_gateway_data *gateway);
@@ -44,6 +42,8 @@ void batadv_gw_node_free(struct batadv_priv *bat_priv);
 void batadv_gw_node_put(struct batadv_gw_node *gw_node);
 struct batadv_gw_node *
 batadv_gw_get_selected_gw_node(struct batadv_priv *bat_priv);
+struct batadv_gw_node *
+batadv_gw_get_client_gw_node(struct batadv_priv *bat_priv, const u8 *client);
 int batadv_gw_client_seq_print_text(struct seq_file *seq, void *offset);
 int batadv_gw_dump(struct sk_buff *msg, struct netlink_callback *cb);
 bool batadv_gw_out_of_range(struct batadv_priv *bat_priv, struct sk_buff *skb);
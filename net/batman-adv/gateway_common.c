@@ -254,7 +254,7 @@ static void batadv_gw_tvlv_ogm_handler_v1(struct batadv_priv *bat_priv,
 	/* restart gateway selection */
 	if (gateway.bandwidth_down != 0 &&
 	    atomic_read(&bat_priv->gw.mode) == BATADV_GW_MODE_CLIENT)
-		batadv_gw_check_election(bat_priv, orig);
+		batadv_gw_check_election(bat_priv);
 }
 
 /**
@@ -268,9 +268,13 @@ void batadv_gw_init(struct batadv_priv *bat_priv)
 	else
 		atomic_set(&bat_priv->gw.sel_class, 1);
 
+	/* the metric of a gateway changes with the OGMs even when its
+	 * announcement stays the same, the ranking needs every OGM
+	 */
 	batadv_tvlv_handler_register(bat_priv, batadv_gw_tvlv_ogm_handler_v1,
 				     NULL, BATADV_TVLV_GW, 1,
-				     BATADV_TVLV_HANDLER_OGM_CIFNOTFND);
+				     BATADV_TVLV_HANDLER_OGM_CIFNOTFND |
+				     BATADV_TVLV_HANDLER_OGM_ALWAYS);
 }
 
 /**
@@ -22,8 +22,12 @@
 #include <linux/atomic.h>
 #include <linux/bug.h>
 #include <linux/byteorder/generic.h>
+#include <linux/compiler.h>
+#include <linux/device.h>
 #include <linux/errno.h>
+#include <linux/etherdevice.h>
 #include <linux/gfp.h>
+#include <linux/hashtable.h>
 #include <linux/if.h>
 #include <linux/if_arp.h>
 #include <linux/if_ether.h>
@@ -31,8 +35,10 @@
 #include <linux/kref.h>
 #include <linux/list.h>
 #include <linux/netdevice.h>
+#include <linux/percpu.h>
 #include <linux/printk.h>
 #include <linux/rculist.h>
+#include <linux/rcupdate.h>
 #include <linux/rtnetlink.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
@@ -44,6 +50,7 @@
 #include "bridge_loop_avoidance.h"
 #include "debugfs.h"
 #include "distributed-arp-table.h"
+#include "fragmentation.h"
 #include "gateway_client.h"
 #include "log.h"
 #include "originator.h"
@@ -52,6 +59,19 @@
 #include "sysfs.h"
 #include "translation-table.h"
 
+/**
+ * batadv_hardif_free_rcu() - free the hard interface and its counters
+ * @rcu: rcu pointer of the hard interface
+ */
+static void batadv_hardif_free_rcu(struct rcu_head *rcu)
+{
+	struct batadv_hard_iface *hard_iface;
+
+	hard_iface = container_of(rcu, struct batadv_hard_iface, rcu);
+	free_percpu(hard_iface->counters);
+	kfree(hard_iface);
+}
+
 /**
  * batadv_hardif_release() - release hard interface from lists and queue for
  *  free after rcu grace period
@@ -64,7 +84,7 @@ void batadv_hardif_release(struct kref *ref)
 	hard_iface = container_of(ref, struct batadv_hard_iface, refcount);
 	dev_put(hard_iface->net_dev);
 
-	kfree_rcu(hard_iface, rcu);
+	call_rcu(&hard_iface->rcu, batadv_hardif_free_rcu);
 }
 
 /**
@@ -434,6 +454,32 @@ out:
 	return ret;
 }
 
+/**
+ * batadv_hardif_num_bcasts() - get the number of broadcast transmissions on an
+ *  interface
+ * @hard_iface: the interface to transmit the broadcast on
+ *
+ * The configured &batadv_hard_iface.num_bcasts retransmissions are meant as
+ * ARQ for sparse neighborhoods. In dense ones, the neighbors rebroadcasting
+ * the packet provide this redundancy already: every BATADV_NUM_BCASTS_NEIGHS
+ * neighbors save one transmission, down to a single one.
+ *
+ * Return: the number of transmissions of a broadcast on this interface.
+ */
+u8 batadv_hardif_num_bcasts(struct batadv_hard_iface *hard_iface)
+{
+	int num_bcasts = hard_iface->num_bcasts;
+	int num_neighs;
+
+	if (num_bcasts <= 1)
+		return num_bcasts;
+
+	num_neighs = atomic_read(&hard_iface->num_neighs);
+	num_bcasts -= num_neighs / BATADV_NUM_BCASTS_NEIGHS;
+
+	return max(num_bcasts, 1);
+}
+
 static struct batadv_hard_iface *
 batadv_hardif_get_active(const struct net_device *soft_iface)
 {
@@ -490,6 +536,8 @@ static void batadv_primary_if_select(struct batadv_priv *bat_priv,
 
 	bat_priv->algo_ops->iface.primary_set(new_hard_iface);
 	batadv_primary_if_update_addr(bat_priv, curr_hard_iface);
+	batadv_mesh_set_numa_node(bat_priv,
+				  dev_to_node(&new_hard_iface->net_dev->dev));
 
 out:
 	if (curr_hard_iface)
@@ -535,11 +583,13 @@ static void batadv_check_known_mac_addr(const struct net_device *net_dev)
  */
 static void batadv_hardif_recalc_extra_skbroom(struct net_device *soft_iface)
 {
+	struct batadv_priv *bat_priv = netdev_priv(soft_iface);
 	const struct batadv_hard_iface *hard_iface;
 	unsigned short lower_header_len = ETH_HLEN;
 	unsigned short lower_headroom = 0;
 	unsigned short lower_tailroom = 0;
 	unsigned short needed_headroom;
+	unsigned short fwd_headroom;
 
 	rcu_read_lock();
 	list_for_each_entry_rcu(hard_iface, &batadv_hardif_list, list) {
@@ -563,8 +613,24 @@ static void batadv_hardif_recalc_extra_skbroom(struct net_device *soft_iface)
 	needed_headroom = lower_headroom + (lower_header_len - ETH_HLEN);
 	needed_headroom += batadv_max_header_len();
 
+	/* the header of the last fragment is pushed in front of the unicast
+	 * header of the original packet
+	 */
+	needed_headroom += sizeof(struct batadv_frag_packet);
+
 	soft_iface->needed_headroom = needed_headroom;
 	soft_iface->needed_tailroom = lower_tailroom;
+
+	/* forwarded packets start at their unicast header and may get a
+	 * fragment or network coding header before the hard interface header
+	 */
+	fwd_headroom = sizeof(struct batadv_frag_packet);
+#ifdef CONFIG_BATMAN_ADV_NC
+	fwd_headroom = max_t(unsigned short, fwd_headroom,
+			     sizeof(struct batadv_coded_packet));
+#endif
+	fwd_headroom += lower_headroom + lower_header_len;
+	WRITE_ONCE(bat_priv->fwd_headroom, fwd_headroom);
 }
 
 /**
@@ -627,7 +693,16 @@ out:
  */
 void batadv_update_min_mtu(struct net_device *soft_iface)
 {
+	struct batadv_priv *bat_priv = netdev_priv(soft_iface);
+
+	/* a single recalculation follows at the end of the batch */
+	if (READ_ONCE(bat_priv->config_batch)) {
+		WRITE_ONCE(bat_priv->config_mtu_pending, true);
+		return;
+	}
+
 	soft_iface->mtu = batadv_hardif_min_mtu(soft_iface);
+	batadv_frag_path_mtu_announce(bat_priv);
 
 	/* Check if the local translate table should be cleaned up to match a
 	 * new (and smaller) MTU.
@@ -635,6 +710,88 @@ void batadv_update_min_mtu(struct net_device *soft_iface)
 	batadv_tt_local_resize_to_mtu(soft_iface);
 }
 
+/**
+ * batadv_hardif_update_addrs() - rebuild the set of own addresses of a mesh
+ * @soft_iface: soft interface whose address set has to be rebuilt
+ *
+ * Has to be called with RTNL held whenever a hard interface of @soft_iface
+ * starts or stops being used or changes its MAC address. When the new set
+ * cannot be allocated, batadv_is_my_mac() falls back to walking the list of
+ * hard interfaces.
+ *
+ * Interfaces which are getting activated are already added: they become
+ * active without RTNL when their first OGM is scheduled.
+ * batadv_is_my_mac() checks the state of the interface of a matching entry.
+ */
+static void batadv_hardif_update_addrs(struct net_device *soft_iface)
+{
+	struct batadv_priv *bat_priv = netdev_priv(soft_iface);
+	struct batadv_hardif_addrs *addrs = NULL, *addrs_old;
+	struct batadv_hard_iface *hard_iface;
+	struct batadv_hardif_addr *entry;
+	unsigned int num = 0;
+	u32 index;
+
+	ASSERT_RTNL();
+
+	list_for_each_entry(hard_iface, &batadv_hardif_list, list) {
+		if (hard_iface->soft_iface != soft_iface)
+			continue;
+
+		if (batadv_hardif_is_my_addr(hard_iface) ||
+		    hard_iface->if_status == BATADV_IF_TO_BE_ACTIVATED)
+			num++;
+	}
+
+	if (num)
+		addrs = kmalloc(sizeof(*addrs) + num * sizeof(*entry),
+				GFP_KERNEL);
+
+	if (addrs) {
+		for (index = 0; index < BATADV_HARDIF_ADDR_BUCKETS; index++)
+			INIT_HLIST_HEAD(&addrs->table[index]);
+
+		entry = addrs->entries;
+		list_for_each_entry(hard_iface, &batadv_hardif_list, list) {
+			if (hard_iface->soft_iface != soft_iface)
+				continue;
+
+			if (!batadv_hardif_is_my_addr(hard_iface) &&
+			    hard_iface->if_status != BATADV_IF_TO_BE_ACTIVATED)
+				continue;
+
+			entry->hard_iface = hard_iface;
+			ether_addr_copy(entry->addr,
+					hard_iface->net_dev->dev_addr);
+			index = batadv_choose_orig(entry->addr,
+						   BATADV_HARDIF_ADDR_BUCKETS);
+			hlist_add_head(&entry->list, &addrs->table[index]);
+			entry++;
+		}
+	}
+
+	addrs_old = rtnl_dereference(bat_priv->hardif_addrs);
+	rcu_assign_pointer(bat_priv->hardif_addrs, addrs);
+
+	if (addrs_old)
+		kfree_rcu(addrs_old, rcu);
+}
+
+/**
+ * batadv_hardif_addrs_free() - free the set of own addresses of a mesh
+ * @bat_priv: the bat priv with all the soft interface information
+ */
+void batadv_hardif_addrs_free(struct batadv_priv *bat_priv)
+{
+	struct batadv_hardif_addrs *addrs;
+
+	addrs = rcu_dereference_protected(bat_priv->hardif_addrs, 1);
+	RCU_INIT_POINTER(bat_priv->hardif_addrs, NULL);
+
+	if (addrs)
+		kfree_rcu(addrs, rcu);
+}
+
 static void
 batadv_hardif_activate_interface(struct batadv_hard_iface *hard_iface)
 {
@@ -648,6 +805,7 @@ batadv_hardif_activate_interface(struct batadv_hard_iface *hard_iface)
 
 	bat_priv->algo_ops->iface.update_mac(hard_iface);
 	hard_iface->if_status = BATADV_IF_TO_BE_ACTIVATED;
+	batadv_hardif_update_addrs(hard_iface->soft_iface);
 
 	/* the first active interface becomes our primary interface or
 	 * the next active interface after the old primary interface was removed
@@ -677,6 +835,7 @@ batadv_hardif_deactivate_interface(struct batadv_hard_iface *hard_iface)
 		return;
 
 	hard_iface->if_status = BATADV_IF_INACTIVE;
+	batadv_hardif_update_addrs(hard_iface->soft_iface);
 
 	batadv_info(hard_iface->soft_iface, "Interface deactivated: %s\n",
 		    hard_iface->net_dev->name);
@@ -852,7 +1011,12 @@ void batadv_hardif_disable_interface(struct batadv_hard_iface *hard_iface,
 
 	batadv_info(hard_iface->soft_iface, "Removing interface: %s\n",
 		    hard_iface->net_dev->name);
-	dev_remove_pack(&hard_iface->batman_adv_ptype);
+	__dev_remove_pack(&hard_iface->batman_adv_ptype);
+	/* receivers which still see the packet type may steer a packet to the
+	 * backlog, wait for them before the backlog is flushed
+	 */
+	synchronize_net();
+	batadv_rx_backlog_flush();
 	batadv_hardif_put(hard_iface);
 
 	bat_priv->num_ifaces--;
@@ -913,9 +1077,15 @@ batadv_hardif_add_interface(struct net_device *net_dev)
 	if (!hard_iface)
 		goto release_dev;
 
+	hard_iface->counters = __alloc_percpu(sizeof(u64) *
+					      BATADV_HARDIF_CNT_NUM,
+					      __alignof__(u64));
+	if (!hard_iface->counters)
+		goto free_if;
+
 	ret = batadv_sysfs_add_hardif(&hard_iface->hardif_obj, net_dev);
 	if (ret)
-		goto free_if;
+		goto free_counters;
 
 	hard_iface->if_num = 0;
 	hard_iface->net_dev = net_dev;
@@ -928,8 +1098,11 @@ batadv_hardif_add_interface(struct net_device *net_dev)
 
 	INIT_LIST_HEAD(&hard_iface->list);
 	INIT_HLIST_HEAD(&hard_iface->neigh_list);
+	INIT_LIST_HEAD(&hard_iface->bat_iv.aggr_list);
+	hash_init(hard_iface->neigh_hash);
 
 	spin_lock_init(&hard_iface->neigh_list_lock);
+	atomic_set(&hard_iface->num_neighs, 0);
 	kref_init(&hard_iface->refcount);
 
 	hard_iface->num_bcasts = BATADV_NUM_BCASTS_DEFAULT;
@@ -947,6 +1120,8 @@ batadv_hardif_add_interface(struct net_device *net_dev)
 
 free_sysfs:
 	batadv_sysfs_del_hardif(&hard_iface->hardif_obj);
+free_counters:
+	free_percpu(hard_iface->counters);
 free_if:
 	kfree(hard_iface);
 release_dev:
@@ -1060,6 +1235,7 @@ static int batadv_hard_if_event(struct notifier_block *this,
 
 		bat_priv = netdev_priv(hard_iface->soft_iface);
 		bat_priv->algo_ops->iface.update_mac(hard_iface);
+		batadv_hardif_update_addrs(hard_iface->soft_iface);
 
 		primary_if = batadv_primary_if_get_selected(bat_priv);
 		if (!primary_if)
@@ -24,6 +24,7 @@
 #include <linux/compiler.h>
 #include <linux/kref.h>
 #include <linux/notifier.h>
+#include <linux/percpu.h>
 #include <linux/rcupdate.h>
 #include <linux/stddef.h>
 #include <linux/types.h>
@@ -119,6 +120,21 @@ void batadv_update_min_mtu(struct net_device *soft_iface);
 void batadv_hardif_release(struct kref *ref);
 int batadv_hardif_no_broadcast(struct batadv_hard_iface *if_outgoing,
 			       u8 *orig_addr, u8 *orig_neigh);
+u8 batadv_hardif_num_bcasts(struct batadv_hard_iface *hard_iface);
+void batadv_hardif_addrs_free(struct batadv_priv *bat_priv);
+
+/**
+ * batadv_hardif_is_my_addr() - check whether the address of a hard interface
+ *  is considered to be an address of its mesh
+ * @hard_iface: the hard interface to check
+ *
+ * Return: true if the interface is active
+ */
+static inline bool
+batadv_hardif_is_my_addr(const struct batadv_hard_iface *hard_iface)
+{
+	return hard_iface->if_status == BATADV_IF_ACTIVE;
+}
 
 /**
  * batadv_hardif_put() - decrement the hard interface refcounter and possibly
@@ -130,6 +146,28 @@ static inline void batadv_hardif_put(struct batadv_hard_iface *hard_iface)
 	kref_put(&hard_iface->refcount, batadv_hardif_release);
 }
 
+/**
+ * batadv_hardif_add_counter() - Add to per cpu statistics counter of hard
+ *  interface
+ * @hard_iface: the hard interface which transmitted or received the traffic
+ * @idx: counter index which should be modified
+ * @count: value to increase counter by
+ */
+static inline void
+batadv_hardif_add_counter(struct batadv_hard_iface *hard_iface, size_t idx,
+			  size_t count)
+{
+	this_cpu_add(hard_iface->counters[idx], count);
+}
+
+/**
+ * batadv_hardif_inc_counter() - Increase per cpu statistics counter of hard
+ *  interface
+ * @h: the hard interface which transmitted or received the traffic
+ * @i: counter index which should be modified
+ */
+#define batadv_hardif_inc_counter(h, i) batadv_hardif_add_counter(h, i, 1)
+
 /**
  * batadv_primary_if_get_selected() - Get reference to primary interface
  * @bat_priv: the bat priv with all the soft interface information
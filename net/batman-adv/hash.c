@@ -19,19 +19,258 @@
 #include "hash.h"
 #include "main.h"
 
+#include <linux/atomic.h>
+#include <linux/cache.h>
+#include <linux/cpumask.h>
 #include <linux/gfp.h>
+#include <linux/jiffies.h>
+#include <linux/kernel.h>
+#include <linux/list.h>
 #include <linux/lockdep.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/numa.h>
+#include <linux/rculist.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/seqlock.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 
-/* clears the hash */
-static void batadv_hash_init(struct batadv_hashtable *hash)
+/* stripe locks per possible CPU of newly allocated bucket arrays */
+static unsigned int batadv_hash_locks_per_cpu = BATADV_HASH_LOCKS_PER_CPU;
+module_param_named(hash_locks_per_cpu, batadv_hash_locks_per_cpu, uint, 0644);
+MODULE_PARM_DESC(hash_locks_per_cpu,
+		 "Bucket stripe locks per possible CPU of each hash table");
+
+/**
+ * batadv_hash_lock_count() - Get number of stripe locks for a bucket array
+ * @size: number of buckets of the bucket array, a power of two
+ *
+ * The hash_locks_per_cpu module parameter only affects bucket arrays which are
+ * allocated after it was changed, i.e. new tables and tables which grow.
+ *
+ * Return: number of stripe locks, a power of two not larger than the number of
+ *  cache lines used by the bucket heads (but at least one)
+ */
+static u32 batadv_hash_lock_count(u32 size)
+{
+	u32 lines = size * sizeof(struct hlist_head) / L1_CACHE_BYTES;
+	u64 count;
+
+	count = (u64)num_possible_cpus() * READ_ONCE(batadv_hash_locks_per_cpu);
+	count = min_t(u64, count, lines);
+
+	return roundup_pow_of_two(max_t(u32, count, 1));
+}
+
+/**
+ * batadv_hash_array_alloc() - Allocate memory for a bucket related array
+ * @n: number of array members
+ * @size: size of each array member
+ * @flags: the type of memory to allocate
+ * @node: NUMA node to allocate the memory on
+ *
+ * Large arrays allocated from process context fall back to vmalloc when no
+ * physically contiguous memory is available.
+ *
+ * Return: pointer to the allocated array, NULL on errors
+ */
+static void *batadv_hash_array_alloc(u32 n, size_t size, gfp_t flags,
+				     int node)
+{
+	void *array;
+
+	if (!gfpflags_allow_blocking(flags))
+		return kmalloc_array_node(n, size, flags, node);
+
+	array = kmalloc_array_node(n, size, flags | __GFP_NOWARN, node);
+	if (array)
+		return array;
+
+	if (size && n > SIZE_MAX / size)
+		return NULL;
+
+	return vmalloc_node(n * size, node);
+}
+
+/**
+ * batadv_hash_buckets_free() - Free a bucket array
+ * @buckets: bucket array to free
+ */
+static void batadv_hash_buckets_free(struct batadv_hash_buckets *buckets)
 {
+	kvfree(buckets->locks);
+	kvfree(buckets->table);
+	kfree(buckets);
+}
+
+/**
+ * batadv_hash_buckets_new() - Allocate and clear a bucket array
+ * @size: number of hash buckets to allocate
+ * @key: lockdep class key address for the stripe spinlocks, NULL for the
+ *  default class
+ * @flags: the type of memory to allocate
+ * @node: NUMA node to allocate the bucket array on
+ *
+ * Return: newly allocated bucket array, NULL on errors
+ */
+static struct batadv_hash_buckets *
+batadv_hash_buckets_new(u32 size, struct lock_class_key *key, gfp_t flags,
+			int node)
+{
+	u32 num_locks = batadv_hash_lock_count(size);
+	struct batadv_hash_buckets *buckets;
 	u32 i;
 
-	for (i = 0; i < hash->size; i++) {
-		INIT_HLIST_HEAD(&hash->table[i]);
-		spin_lock_init(&hash->list_locks[i]);
+	buckets = kmalloc_node(sizeof(*buckets), flags, node);
+	if (!buckets)
+		return NULL;
+
+	buckets->table = batadv_hash_array_alloc(size, sizeof(*buckets->table),
+						 flags, node);
+	if (!buckets->table)
+		goto free_buckets;
+
+	/* a power of two number of cache lines, kmalloc keeps them aligned */
+	buckets->locks = batadv_hash_array_alloc(num_locks,
+						 sizeof(*buckets->locks),
+						 flags, node);
+	if (!buckets->locks)
+		goto free_table;
+
+	buckets->lock_mask = num_locks - 1;
+	buckets->size = size;
+	buckets->node = node;
+	RCU_INIT_POINTER(buckets->future, NULL);
+
+	for (i = 0; i < size; i++)
+		INIT_HLIST_HEAD(&buckets->table[i]);
+
+	for (i = 0; i < num_locks; i++) {
+		spin_lock_init(&buckets->locks[i].lock);
+		buckets->locks[i].moved = false;
+		if (key)
+			lockdep_set_class(&buckets->locks[i].lock, key);
+	}
+
+	return buckets;
+
+free_table:
+	kvfree(buckets->table);
+free_buckets:
+	kfree(buckets);
+	return NULL;
+}
+
+/**
+ * batadv_hash_move_stripe() - Move the elements of a stripe to a new bucket
+ *  array
+ * @hash: hash table being resized
+ * @buckets_old: bucket array containing the stripe
+ * @stripe_index: index of the stripe in @buckets_old
+ *
+ * Only the old stripe lock is held: the buckets of the new bucket array which
+ * receive the elements are not used by writers before the stripe is marked as
+ * moved.
+ */
+static void batadv_hash_move_stripe(struct batadv_hashtable *hash,
+				    struct batadv_hash_buckets *buckets_old,
+				    u32 stripe_index)
+{
+	struct batadv_hash_lock *stripe = &buckets_old->locks[stripe_index];
+	struct batadv_hash_buckets *buckets;
+	struct hlist_node *node, *node_tmp;
+	u32 index, i;
+
+	buckets = rcu_dereference_protected(buckets_old->future, 1);
+
+	write_lock_bh(&hash->walk_lock);
+	spin_lock(&stripe->lock);
+	write_seqcount_begin(&hash->resize_seq);
+
+	for (i = stripe_index; i < buckets_old->size;
+	     i += buckets_old->lock_mask + 1) {
+		hlist_for_each_safe(node, node_tmp, &buckets_old->table[i]) {
+			index = hash->choose(node, buckets->size);
+
+			hlist_del_rcu(node);
+			hlist_add_head_rcu(node, &buckets->table[index]);
+		}
+	}
+
+	/* pairs with smp_load_acquire() in batadv_hash_moved_rcu() */
+	smp_store_release(&stripe->moved, true);
+	write_seqcount_end(&hash->resize_seq);
+	atomic_inc(&hash->generation);
+
+	spin_unlock(&stripe->lock);
+	write_unlock_bh(&hash->walk_lock);
+}
+
+/**
+ * batadv_hash_resize() - Move all elements of a hash to a bigger bucket array
+ *  or to a bucket array on another NUMA node
+ * @work: work queue item
+ *
+ * The elements are moved one stripe at a time, only writers of the stripe
+ * being moved have to wait. Writers and lockless readers of stripes which
+ * were moved already continue in the new bucket array. Lookups which missed
+ * their element retry when the resize sequence counter changed in between.
+ * Walks over all buckets which must not see an element twice or miss it keep
+ * stripes from being moved with batadv_hash_walk_begin().
+ */
+static void batadv_hash_resize(struct work_struct *work)
+{
+	struct batadv_hash_buckets *buckets, *buckets_old;
+	struct batadv_hashtable *hash;
+	u32 size, i;
+	int numa_node;
+
+	hash = container_of(work, struct batadv_hashtable, resize_work);
+
+	size = READ_ONCE(hash->size);
+	while (size < BATADV_HASH_MAX_SIZE &&
+	       atomic_read(&hash->count) > size * BATADV_HASH_MAX_LOAD)
+		size *= 2;
+
+	size = min_t(u32, size, BATADV_HASH_MAX_SIZE);
+
+	/* only this work replaces the buckets, no lock needed to read them */
+	buckets_old = rcu_dereference_protected(hash->buckets, 1);
+	numa_node = READ_ONCE(hash->node);
+	if (size <= hash->size && numa_node == buckets_old->node)
+		return;
+
+	buckets = batadv_hash_buckets_new(size, hash->lock_class, GFP_KERNEL,
+					  numa_node);
+	if (!buckets)
+		return;
+
+	rcu_assign_pointer(buckets_old->future, buckets);
+
+	/* the buckets beyond the old bucket array can be accessed from now on.
+	 * Pairs with smp_load_acquire() in batadv_hash_size()
+	 */
+	smp_store_release(&hash->size, buckets->size);
+
+	for (i = 0; i <= buckets_old->lock_mask; i++) {
+		batadv_hash_move_stripe(hash, buckets_old, i);
+		cond_resched();
 	}
+
+	rcu_assign_pointer(hash->buckets, buckets);
+
+	/* wait for lockless readers and writers of the old buckets before they
+	 * are freed and before the elements may be moved again by the next
+	 * resize
+	 */
+	synchronize_rcu();
+	batadv_hash_buckets_free(buckets_old);
 }
 
 /**
@@ -40,55 +279,86 @@ static void batadv_hash_init(struct batadv_hashtable *hash)
  */
 void batadv_hash_destroy(struct batadv_hashtable *hash)
 {
-	kfree(hash->list_locks);
-	kfree(hash->table);
+	cancel_work_sync(&hash->resize_work);
+	batadv_hash_buckets_free(rcu_dereference_protected(hash->buckets, 1));
 	kfree(hash);
 }
 
 /**
  * batadv_hash_new() - Allocates and clears the hashtable
- * @size: number of hash buckets to allocate
+ * @size: number of hash buckets to allocate initially
+ * @choose: callback calculating the hash index of a stored element when the
+ *  hashtable is grown
  *
  * Return: newly allocated hashtable, NULL on errors
  */
-struct batadv_hashtable *batadv_hash_new(u32 size)
+struct batadv_hashtable *batadv_hash_new(u32 size,
+					 batadv_hashnode_choose_cb choose)
 {
+	struct batadv_hash_buckets *buckets;
 	struct batadv_hashtable *hash;
 
 	hash = kmalloc(sizeof(*hash), GFP_ATOMIC);
 	if (!hash)
 		return NULL;
 
-	hash->table = kmalloc_array(size, sizeof(*hash->table), GFP_ATOMIC);
-	if (!hash->table)
+	buckets = batadv_hash_buckets_new(size, NULL, GFP_ATOMIC, NUMA_NO_NODE);
+	if (!buckets)
 		goto free_hash;
 
-	hash->list_locks = kmalloc_array(size, sizeof(*hash->list_locks),
-					 GFP_ATOMIC);
-	if (!hash->list_locks)
-		goto free_table;
-
+	RCU_INIT_POINTER(hash->buckets, buckets);
 	hash->size = size;
-	batadv_hash_init(hash);
+	atomic_set(&hash->count, 0);
+	atomic_set(&hash->generation, 0);
+	hash->oldest = jiffies;
+	rwlock_init(&hash->walk_lock);
+	seqcount_init(&hash->resize_seq);
+	hash->choose = choose;
+	hash->lock_class = NULL;
+	hash->node = NUMA_NO_NODE;
+	INIT_WORK(&hash->resize_work, batadv_hash_resize);
+
 	return hash;
 
-free_table:
-	kfree(hash->table);
 free_hash:
 	kfree(hash);
 	return NULL;
 }
 
+/**
+ * batadv_hash_set_node() - Move the buckets of a hash to another NUMA node
+ * @hash: hash object to modify
+ * @node: NUMA node to allocate the bucket arrays on
+ *
+ * The current bucket array is replaced in the background. Bucket arrays
+ * allocated when the hashtable grows are also placed on @node.
+ */
+void batadv_hash_set_node(struct batadv_hashtable *hash, int node)
+{
+	if (READ_ONCE(hash->node) == node)
+		return;
+
+	WRITE_ONCE(hash->node, node);
+	queue_work(batadv_event_workqueue, &hash->resize_work);
+}
+
 /**
  * batadv_hash_set_lock_class() - Set specific lockdep class for hash spinlocks
  * @hash: hash object to modify
  * @key: lockdep class key address
+ *
+ * The class is also used for the spinlocks of bucket arrays allocated when
+ * the hashtable grows.
  */
 void batadv_hash_set_lock_class(struct batadv_hashtable *hash,
 				struct lock_class_key *key)
 {
+	struct batadv_hash_buckets *buckets;
 	u32 i;
 
-	for (i = 0; i < hash->size; i++)
-		lockdep_set_class(&hash->list_locks[i], key);
+	buckets = rcu_dereference_protected(hash->buckets, 1);
+	hash->lock_class = key;
+
+	for (i = 0; i <= buckets->lock_mask; i++)
+		lockdep_set_class(&buckets->locks[i].lock, key);
 }
@@ -21,12 +21,20 @@
 
 #include "main.h"
 
+#include <linux/atomic.h>
+#include <linux/cache.h>
 #include <linux/compiler.h>
+#include <linux/jiffies.h>
+#include <linux/kernel.h>
 #include <linux/list.h>
+#include <linux/lockdep.h>
 #include <linux/rculist.h>
+#include <linux/rcupdate.h>
+#include <linux/seqlock.h>
 #include <linux/spinlock.h>
 #include <linux/stddef.h>
 #include <linux/types.h>
+#include <linux/workqueue.h>
 
 struct lock_class_key;
 
@@ -39,6 +47,9 @@ typedef bool (*batadv_hashdata_compare_cb)(const struct hlist_node *,
 					   const void *);
 
 /* the hashfunction
+ *
+ * The key hash has to be reduced modulo the size, a resize relies on the
+ * elements of bucket i ending up in the buckets i + n * (old size).
  *
  * Return: an index based on the key in the data of the first argument and the
  * size the second
@@ -46,30 +57,529 @@ typedef bool (*batadv_hashdata_compare_cb)(const struct hlist_node *,
 typedef u32 (*batadv_hashdata_choose_cb)(const void *, u32);
 typedef void (*batadv_hashdata_free_cb)(struct hlist_node *, void *);
 
+/* the hashfunction applied to an element already stored in the hash
+ *
+ * Return: an index based on the key of the element the first argument is
+ * embedded in and the size the second
+ */
+typedef u32 (*batadv_hashnode_choose_cb)(const struct hlist_node *, u32);
+
 /**
- * struct batadv_hashtable - Wrapper of simple hlist based hashtable
+ * struct batadv_hash_lock - Spinlock of a stripe of hash buckets
+ *
+ * A bucket lock is never taken while another bucket lock of the same table is
+ * held, so buckets can share a lock without deadlocks. All stripe locks of a
+ * table share one lockdep class and are taken without a nesting annotation:
+ * lockdep reports any code which starts to nest them as recursive locking.
+ * Bucket locks of different tables (orig_hash -> tt.global_hash,
+ * bla.backbone_hash -> bla.claim_hash) do nest, these tables therefore have
+ * their own classes set via batadv_hash_set_lock_class().
+ *
+ * Each lock sits on its own cache line, so that writers of different stripes
+ * do not bounce the same line between CPUs. The number of stripes is limited
+ * to one per cache line of bucket heads, the locks therefore never take more
+ * memory than the bucket array itself.
  */
-struct batadv_hashtable {
+struct batadv_hash_lock {
+	/** @lock: protects all buckets of the stripe */
+	spinlock_t lock;
+
+	/**
+	 * @moved: the elements of the stripe were moved to the future bucket
+	 *  array by a resize, set while @lock is held
+	 */
+	bool moved;
+} ____cacheline_aligned_in_smp;
+
+/**
+ * struct batadv_hash_buckets - Bucket array of a batadv_hashtable
+ *
+ * The list heads are packed densely, so that lookups only touch the cache line
+ * of their bucket. Writers additionally take the lock of the stripe the bucket
+ * belongs to; bucket i belongs to stripe (i & @lock_mask).
+ *
+ * A resize moves the elements to @future one stripe at a time. Until the stripe
+ * of bucket i is marked as moved, its lock also protects the buckets
+ * i + n * @size of @future, which only receive elements from bucket i.
+ */
+struct batadv_hash_buckets {
 	/** @table: the hashtable itself with the buckets */
 	struct hlist_head *table;
 
-	/** @list_locks: spinlock for each hash list entry */
-	spinlock_t *list_locks;
+	/** @locks: spinlocks of the bucket stripes */
+	struct batadv_hash_lock *locks;
+
+	/** @lock_mask: number of @locks minus one */
+	u32 lock_mask;
+
+	/** @size: number of buckets in @table */
+	u32 size;
+
+	/** @node: NUMA node the arrays were allocated on */
+	int node;
+
+	/**
+	 * @future: bucket array the elements are moved to by a running
+	 *  resize, NULL before the resize started
+	 */
+	struct batadv_hash_buckets __rcu *future;
+};
+
+/**
+ * struct batadv_hashtable - Wrapper of simple hlist based hashtable
+ *
+ * The bucket array is replaced by a bigger one when the number of stored
+ * elements exceeds BATADV_HASH_MAX_LOAD elements per bucket. The table never
+ * shrinks, an index smaller than batadv_hash_size() therefore always refers
+ * to a valid bucket.
+ */
+struct batadv_hashtable {
+	/** @buckets: currently used bucket array */
+	struct batadv_hash_buckets __rcu *buckets;
 
-	/** @size: size of hashtable */
+	/**
+	 * @size: number of buckets which can be accessed, already the size of
+	 *  the future bucket array while a resize is running
+	 */
 	u32 size;
+
+	/** @count: number of elements stored in the hash */
+	atomic_t count;
+
+	/**
+	 * @generation: increased whenever elements are added, removed or moved
+	 *  to other buckets
+	 */
+	atomic_t generation;
+
+	/**
+	 * @walk_lock: read locked by walks which must see every element exactly
+	 *  once, write locked while the elements of a stripe are moved to a new
+	 *  bucket array
+	 */
+	rwlock_t walk_lock;
+
+	/**
+	 * @resize_seq: allows lockless readers to detect that an element was
+	 *  moved while they were searching for it
+	 */
+	seqcount_t resize_seq;
+
+	/** @choose: hash function used to move elements on resize */
+	batadv_hashnode_choose_cb choose;
+
+	/** @lock_class: lockdep class of the stripe spinlocks */
+	struct lock_class_key *lock_class;
+
+	/**
+	 * @node: NUMA node the bucket arrays should be allocated on, the
+	 *  buckets are moved there by @resize_work
+	 */
+	int node;
+
+	/** @resize_work: work item growing or moving the bucket array */
+	struct work_struct resize_work;
+
+	/**
+	 * @oldest: lower bound of the (jiffies) timestamps the expiry of the
+	 *  stored elements is based on, see batadv_hash_age_note()
+	 */
+	unsigned long oldest;
 };
 
 /* allocates and clears the hash */
-struct batadv_hashtable *batadv_hash_new(u32 size);
+struct batadv_hashtable *batadv_hash_new(u32 size,
+					 batadv_hashnode_choose_cb choose);
 
 /* set class key for all locks */
 void batadv_hash_set_lock_class(struct batadv_hashtable *hash,
 				struct lock_class_key *key);
 
+/* move the buckets to another NUMA node */
+void batadv_hash_set_node(struct batadv_hashtable *hash, int node);
+
 /* free only the hashtable and the hash itself. */
 void batadv_hash_destroy(struct batadv_hashtable *hash);
 
+/**
+ * batadv_hash_size() - Get number of buckets of a hashtable
+ * @hash: hash table
+ *
+ * Return: number of buckets which can be accessed via
+ *  batadv_hash_bucket_rcu() or batadv_hash_lock_bucket()
+ */
+static inline u32 batadv_hash_size(struct batadv_hashtable *hash)
+{
+	/* pairs with smp_store_release() in batadv_hash_resize() */
+	return smp_load_acquire(&hash->size);
+}
+
+/**
+ * batadv_hash_mem() - Estimate the memory used by a hashtable
+ * @hash: hash table
+ * @entry_size: size of each stored element
+ *
+ * Return: bytes used by the bucket array and the stored elements
+ */
+static inline u64 batadv_hash_mem(struct batadv_hashtable *hash,
+				  size_t entry_size)
+{
+	struct batadv_hash_buckets *buckets;
+	u64 mem;
+
+	rcu_read_lock();
+	buckets = rcu_dereference(hash->buckets);
+	mem = (u64)buckets->size * sizeof(*buckets->table) +
+	      (u64)(buckets->lock_mask + 1) * sizeof(*buckets->locks);
+	rcu_read_unlock();
+
+	return mem + (u64)atomic_read(&hash->count) * entry_size;
+}
+
+/**
+ * batadv_hash_generation() - Get the current generation of a hashtable
+ * @hash: hash table
+ *
+ * Dumps which are resumed by bucket and index within the bucket may skip or
+ * duplicate elements when the generation changed in between.
+ *
+ * Return: generation of @hash
+ */
+static inline u32 batadv_hash_generation(struct batadv_hashtable *hash)
+{
+	return (u32)atomic_read(&hash->generation);
+}
+
+/**
+ * batadv_hash_age_note() - Record the timestamp of an element which may expire
+ * @hash: hash table containing the element
+ * @stamp: jiffies timestamp the expiry of the element is based on
+ *
+ * Has to be called for every element which is kept by a purge run started
+ * with batadv_hash_age_purge_begin() and whenever the timestamp of an element
+ * is set to a value older than the time it got stored in the hash. Refreshing
+ * a timestamp to the current time doesn't need to be recorded.
+ */
+static inline void batadv_hash_age_note(struct batadv_hashtable *hash,
+					unsigned long stamp)
+{
+	unsigned long oldest = READ_ONCE(hash->oldest);
+	unsigned long prev;
+
+	while (time_before(stamp, oldest)) {
+		prev = cmpxchg(&hash->oldest, oldest, stamp);
+		if (prev == oldest)
+			break;
+
+		oldest = prev;
+	}
+}
+
+/**
+ * batadv_hash_age_purge_begin() - Check whether elements of a hash may have
+ *  expired and start a new purge run
+ * @hash: hash table to check
+ * @timeout: shortest timeout of the elements (in milliseconds)
+ *
+ * Periodic purge runs use this to skip walking the whole table when none of
+ * the elements can have timed out yet. When true is returned, the caller has
+ * to visit all elements and batadv_hash_age_note() the ones it keeps.
+ *
+ * Return: true if a purge run has to be done, false otherwise
+ */
+static inline bool batadv_hash_age_purge_begin(struct batadv_hashtable *hash,
+					       unsigned int timeout)
+{
+	if (!batadv_has_timed_out(READ_ONCE(hash->oldest), timeout))
+		return false;
+
+	/* elements stored from now on are newer than this anyway */
+	xchg(&hash->oldest, jiffies);
+
+	return true;
+}
+
+/**
+ * batadv_hash_stripe() - Get the stripe a bucket belongs to
+ * @buckets: bucket array containing the bucket
+ * @index: index of the bucket
+ *
+ * Return: lock of the stripe
+ */
+static inline struct batadv_hash_lock *
+batadv_hash_stripe(struct batadv_hash_buckets *buckets, u32 index)
+{
+	return &buckets->locks[index & buckets->lock_mask];
+}
+
+/**
+ * batadv_hash_moved_rcu() - Check whether a resize moved a bucket already
+ * @buckets: bucket array containing the bucket
+ * @index: index of the bucket
+ *
+ * Has to be called with rcu_read_lock held. The stripe is only looked at while
+ * a resize is running.
+ *
+ * Return: true if the elements of the bucket are stored in @buckets->future
+ */
+static inline bool batadv_hash_moved_rcu(struct batadv_hash_buckets *buckets,
+					 u32 index)
+{
+	if (!rcu_access_pointer(buckets->future))
+		return false;
+
+	/* pairs with smp_store_release() in batadv_hash_move_stripe() */
+	return smp_load_acquire(&batadv_hash_stripe(buckets, index)->moved);
+}
+
+/**
+ * batadv_hash_bucket_rcu() - Get a bucket for lockless reading
+ * @hash: hash table
+ * @index: index of the bucket, smaller than batadv_hash_size()
+ *
+ * Has to be called with rcu_read_lock held. The returned list may only be
+ * traversed while the RCU read lock is still held.
+ *
+ * Return: list head of the bucket
+ */
+static inline struct hlist_head *
+batadv_hash_bucket_rcu(struct batadv_hashtable *hash, u32 index)
+{
+	struct batadv_hash_buckets *buckets = rcu_dereference(hash->buckets);
+
+	if (index >= buckets->size || batadv_hash_moved_rcu(buckets, index))
+		buckets = rcu_dereference(buckets->future);
+
+	return &buckets->table[index];
+}
+
+/**
+ * batadv_hash_head_rcu() - Get the bucket some data is stored in
+ * @hash: hash table
+ * @choose: callback calculating the hash index
+ * @data: data passed to @choose as argument
+ *
+ * Has to be called with rcu_read_lock held. Lookups which did not find their
+ * element have to be repeated when batadv_hash_read_retry() reports a
+ * concurrent resize.
+ *
+ * Return: list head of the bucket
+ */
+static inline struct hlist_head *
+batadv_hash_head_rcu(struct batadv_hashtable *hash,
+		     batadv_hashdata_choose_cb choose, const void *data)
+{
+	struct batadv_hash_buckets *buckets = rcu_dereference(hash->buckets);
+	u32 index = choose(data, buckets->size);
+
+	if (batadv_hash_moved_rcu(buckets, index)) {
+		buckets = rcu_dereference(buckets->future);
+		index = choose(data, buckets->size);
+	}
+
+	return &buckets->table[index];
+}
+
+/**
+ * batadv_hash_read_begin() - Start a lockless lookup
+ * @hash: hash table
+ *
+ * Return: sequence number to pass to batadv_hash_read_retry()
+ */
+static inline unsigned int batadv_hash_read_begin(struct batadv_hashtable *hash)
+{
+	return raw_seqcount_begin(&hash->resize_seq);
+}
+
+/**
+ * batadv_hash_read_retry() - Check whether a lockless lookup raced with resize
+ * @hash: hash table
+ * @seq: sequence number returned by batadv_hash_read_begin()
+ *
+ * Return: true when elements were moved during the lookup and a miss has to
+ *  be confirmed by searching again
+ */
+static inline bool batadv_hash_read_retry(struct batadv_hashtable *hash,
+					  unsigned int seq)
+{
+	return read_seqcount_retry(&hash->resize_seq, seq);
+}
+
+/**
+ * batadv_hash_walk_begin() - Keep the elements of a hash in their buckets
+ * @hash: hash table
+ *
+ * Lockless walks over all buckets may see an element twice or miss it while a
+ * resize moves the elements of a stripe to a new bucket array. Walks which need
+ * every element exactly once, e.g. to build a table announced to other nodes or
+ * to resize per originator state, keep the stripes from being moved until
+ * batadv_hash_walk_end(). Stripes moved before are found at the same indexes
+ * in the new bucket array, the walk therefore has to bound its index with
+ * batadv_hash_size() again for every bucket.
+ *
+ * Writers are not blocked and bottom halves are disabled in between. The walk
+ * must not call batadv_hash_walk_begin() for the same hash again: the read
+ * lock is not recursive once a resize waits for it. Bucket locks and
+ * batadv_hash_add()/batadv_hash_remove() can be used inside the walk.
+ *
+ * Periodic purges and the debugfs tables tolerate the rare inconsistency and
+ * the netlink dumps flag it with NLM_F_DUMP_INTR via batadv_hash_generation().
+ */
+static inline void batadv_hash_walk_begin(struct batadv_hashtable *hash)
+{
+	read_lock_bh(&hash->walk_lock);
+}
+
+/**
+ * batadv_hash_walk_end() - Allow resizes blocked by batadv_hash_walk_begin()
+ * @hash: hash table
+ */
+static inline void batadv_hash_walk_end(struct batadv_hashtable *hash)
+{
+	read_unlock_bh(&hash->walk_lock);
+}
+
+/**
+ * batadv_hash_lock_stripe() - Lock a stripe which was not moved by a resize
+ * @buckets: bucket array containing the stripe
+ * @index: index of a bucket of the stripe
+ *
+ * Return: the locked stripe, NULL when its elements are stored in
+ *  @buckets->future
+ */
+static inline struct batadv_hash_lock *
+batadv_hash_lock_stripe(struct batadv_hash_buckets *buckets, u32 index)
+{
+	struct batadv_hash_lock *stripe = batadv_hash_stripe(buckets, index);
+
+	spin_lock_bh(&stripe->lock);
+	if (likely(!stripe->moved))
+		return stripe;
+
+	spin_unlock_bh(&stripe->lock);
+	return NULL;
+}
+
+/**
+ * batadv_hash_lock_bucket() - Lock a bucket for modification
+ * @hash: hash table
+ * @index: index of the bucket, smaller than batadv_hash_size()
+ * @list_lock: returns the spinlock which has to be passed to
+ *  batadv_hash_unlock_bucket()
+ *
+ * The elements of the bucket cannot be moved by a resize until the bucket is
+ * unlocked again.
+ *
+ * Return: list head of the locked bucket
+ */
+static inline struct hlist_head *
+batadv_hash_lock_bucket(struct batadv_hashtable *hash, u32 index,
+			spinlock_t **list_lock)
+{
+	struct batadv_hash_buckets *buckets;
+	struct batadv_hash_lock *stripe;
+
+	rcu_read_lock();
+	buckets = rcu_dereference(hash->buckets);
+
+	for (;;) {
+		stripe = batadv_hash_lock_stripe(buckets, index % buckets->size);
+		if (stripe)
+			break;
+
+		buckets = rcu_dereference(buckets->future);
+	}
+
+	/* buckets beyond the old bucket array of a running resize are
+	 * protected by the stripe they receive their elements from
+	 */
+	if (index >= buckets->size)
+		buckets = rcu_dereference(buckets->future);
+
+	*list_lock = &stripe->lock;
+
+	return &buckets->table[index];
+}
+
+/**
+ * batadv_hash_unlock_bucket() - Unlock a bucket locked by
+ *  batadv_hash_lock_bucket()
+ * @hash: hash table
+ * @list_lock: spinlock returned by batadv_hash_lock_bucket()
+ */
+static inline void batadv_hash_unlock_bucket(struct batadv_hashtable *hash,
+					     spinlock_t *list_lock)
+{
+	spin_unlock_bh(list_lock);
+	rcu_read_unlock();
+}
+
+/**
+ * batadv_hash_lock_head() - Lock the bucket some data is stored in
+ * @hash: hash table
+ * @choose: callback calculating the hash index
+ * @data: data passed to @choose as argument
+ * @list_lock: returns the locked spinlock
+ *
+ * Has to be called with rcu_read_lock held.
+ *
+ * Return: list head of the locked bucket
+ */
+static inline struct hlist_head *
+batadv_hash_lock_head(struct batadv_hashtable *hash,
+		      batadv_hashdata_choose_cb choose, const void *data,
+		      spinlock_t **list_lock)
+{
+	struct batadv_hash_buckets *buckets = rcu_dereference(hash->buckets);
+	struct batadv_hash_lock *stripe;
+	u32 index;
+
+	for (;;) {
+		index = choose(data, buckets->size);
+		stripe = batadv_hash_lock_stripe(buckets, index);
+		if (stripe)
+			break;
+
+		buckets = rcu_dereference(buckets->future);
+	}
+
+	*list_lock = &stripe->lock;
+
+	return &buckets->table[index];
+}
+
+/**
+ * batadv_hash_del() - Remove an element from its locked bucket
+ * @hash: hash table
+ * @node: element to remove
+ */
+static inline void batadv_hash_del(struct batadv_hashtable *hash,
+				   struct hlist_node *node)
+{
+	/* keep hlist_unhashed() usable to detect removed elements */
+	hlist_del_init_rcu(node);
+	atomic_dec(&hash->count);
+	atomic_inc(&hash->generation);
+}
+
+/**
+ * batadv_hash_grow_check() - Schedule growing of the hash when overloaded
+ * @hash: hash table
+ * @size: number of buckets of the hash, see batadv_hash_size()
+ * @count: number of elements in the hash
+ */
+static inline void batadv_hash_grow_check(struct batadv_hashtable *hash,
+					  u32 size, int count)
+{
+	if (size >= BATADV_HASH_MAX_SIZE)
+		return;
+
+	if (count <= size * BATADV_HASH_MAX_LOAD)
+		return;
+
+	queue_work(batadv_event_workqueue, &hash->resize_work);
+}
+
 /**
  *	batadv_hash_add() - adds data to the hashtable
  *	@hash: storage hash table
@@ -87,8 +597,8 @@ static inline int batadv_hash_add(struct batadv_hashtable *hash,
 				  const void *data,
 				  struct hlist_node *data_node)
 {
-	u32 index;
 	int ret = -1;
+	int count;
 	struct hlist_head *head;
 	struct hlist_node *node;
 	spinlock_t *list_lock; /* spinlock to protect write access */
@@ -96,11 +606,8 @@ static inline int batadv_hash_add(struct batadv_hashtable *hash,
 	if (!hash)
 		goto out;
 
-	index = choose(data, hash->size);
-	head = &hash->table[index];
-	list_lock = &hash->list_locks[index];
-
-	spin_lock_bh(list_lock);
+	rcu_read_lock();
+	head = batadv_hash_lock_head(hash, choose, data, &list_lock);
 
 	hlist_for_each(node, head) {
 		if (!compare(node, data))
@@ -112,11 +619,15 @@ static inline int batadv_hash_add(struct batadv_hashtable *hash,
 
 	/* no duplicate found in list, add new element */
 	hlist_add_head_rcu(data_node, head);
+	count = atomic_inc_return(&hash->count);
+	atomic_inc(&hash->generation);
+	batadv_hash_grow_check(hash, batadv_hash_size(hash), count);
 
 	ret = 0;
 
 unlock:
 	spin_unlock_bh(list_lock);
+	rcu_read_unlock();
 out:
 	return ret;
 }
@@ -139,24 +650,24 @@ static inline void *batadv_hash_remove(struct batadv_hashtable *hash,
 				       batadv_hashdata_choose_cb choose,
 				       void *data)
 {
-	u32 index;
 	struct hlist_node *node;
 	struct hlist_head *head;
+	spinlock_t *list_lock; /* spinlock to protect write access */
 	void *data_save = NULL;
 
-	index = choose(data, hash->size);
-	head = &hash->table[index];
+	rcu_read_lock();
+	head = batadv_hash_lock_head(hash, choose, data, &list_lock);
 
-	spin_lock_bh(&hash->list_locks[index]);
 	hlist_for_each(node, head) {
 		if (!compare(node, data))
 			continue;
 
 		data_save = node;
-		hlist_del_rcu(node);
+		batadv_hash_del(hash, node);
 		break;
 	}
-	spin_unlock_bh(&hash->list_locks[index]);
+	spin_unlock_bh(list_lock);
+	rcu_read_unlock();
 
 	return data_save;
 }
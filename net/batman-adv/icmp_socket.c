@@ -52,7 +52,8 @@
 #include "originator.h"
 #include "send.h"
 
-static struct batadv_socket_client *batadv_socket_client_hash[256];
+static struct batadv_socket_client *
+batadv_socket_client_hash[BATADV_ICMP_UID_PING];
 
 static void batadv_socket_add_packet(struct batadv_socket_client *socket_client,
 				     struct batadv_icmp_header *icmph,
@@ -412,6 +413,9 @@ void batadv_socket_receive_packet(struct batadv_icmp_header *icmph,
 {
 	struct batadv_socket_client *hash;
 
+	if (icmph->uid >= ARRAY_SIZE(batadv_socket_client_hash))
+		return;
+
 	hash = batadv_socket_client_hash[icmph->uid];
 	if (hash)
 		batadv_socket_add_packet(hash, icmph, icmp_len);
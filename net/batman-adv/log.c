@@ -19,7 +19,9 @@
 #include "log.h"
 #include "main.h"
 
+#include <linux/atomic.h>
 #include <linux/compiler.h>
+#include <linux/cpumask.h>
 #include <linux/debugfs.h>
 #include <linux/errno.h>
 #include <linux/eventpoll.h>
@@ -27,85 +29,73 @@
 #include <linux/fcntl.h>
 #include <linux/fs.h>
 #include <linux/gfp.h>
+#include <linux/irqflags.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
 #include <linux/poll.h>
 #include <linux/sched.h> /* for linux/wait.h */
 #include <linux/slab.h>
-#include <linux/spinlock.h>
 #include <linux/stddef.h>
+#include <linux/string.h>
 #include <linux/types.h>
 #include <linux/uaccess.h>
 #include <linux/wait.h>
+#include <asm/barrier.h>
 #include <stdarg.h>
 
-#define BATADV_LOG_BUFF_MASK (batadv_log_buff_len - 1)
-
-static const int batadv_log_buff_len = BATADV_LOG_BUF_LEN;
-
-static char *batadv_log_char_addr(struct batadv_priv_debug_log *debug_log,
-				  size_t idx)
-{
-	return &debug_log->log_buff[idx & BATADV_LOG_BUFF_MASK];
-}
-
-static void batadv_emit_log_char(struct batadv_priv_debug_log *debug_log,
-				 char c)
-{
-	char *char_addr;
-
-	char_addr = batadv_log_char_addr(debug_log, debug_log->log_end);
-	*char_addr = c;
-	debug_log->log_end++;
-
-	if (debug_log->log_end - debug_log->log_start > batadv_log_buff_len)
-		debug_log->log_start = debug_log->log_end - batadv_log_buff_len;
-}
-
-__printf(2, 3)
-static int batadv_fdebug_log(struct batadv_priv_debug_log *debug_log,
-			     const char *fmt, ...)
-{
-	va_list args;
-	static char debug_log_buf[256];
-	char *p;
-
-	if (!debug_log)
-		return 0;
-
-	spin_lock_bh(&debug_log->lock);
-	va_start(args, fmt);
-	vscnprintf(debug_log_buf, sizeof(debug_log_buf), fmt, args);
-	va_end(args);
-
-	for (p = debug_log_buf; *p != 0; p++)
-		batadv_emit_log_char(debug_log, *p);
-
-	spin_unlock_bh(&debug_log->lock);
-
-	wake_up(&debug_log->queue_wait);
-
-	return 0;
-}
+#define BATADV_LOG_ENTRIES_MASK (BATADV_LOG_ENTRIES - 1)
 
 /**
  * batadv_debug_log() - Add debug log entry
  * @bat_priv: the bat priv with all the soft interface information
  * @fmt: format string
  *
+ * The record is written into the ring of the local cpu without taking any
+ * shared lock. Only interrupts are disabled to keep the ring consistent
+ * against writers interrupting us on the same cpu.
+ *
  * Return: 0 on success or negative error number in case of failure
  */
 int batadv_debug_log(struct batadv_priv *bat_priv, const char *fmt, ...)
 {
+	struct batadv_priv_debug_log *debug_log = bat_priv->debug_log;
+	struct batadv_debug_log_entry *entry;
+	struct batadv_debug_log_ring *ring;
+	unsigned long flags;
 	va_list args;
-	char tmp_log_buf[256];
+
+	if (!debug_log)
+		return 0;
+
+	local_irq_save(flags);
+
+	ring = this_cpu_ptr(debug_log->rings);
+	entry = &ring->entries[ring->head & BATADV_LOG_ENTRIES_MASK];
+
+	/* invalidate slot for readers which are still copying the old record */
+	WRITE_ONCE(entry->seq, 0);
+	smp_wmb();
 
 	va_start(args, fmt);
-	vscnprintf(tmp_log_buf, sizeof(tmp_log_buf), fmt, args);
-	batadv_fdebug_log(bat_priv->debug_log, "[%10u] %s",
-			  jiffies_to_msecs(jiffies), tmp_log_buf);
+	entry->len = vscnprintf(entry->msg, sizeof(entry->msg), fmt, args);
 	va_end(args);
+	entry->time = jiffies_to_msecs(jiffies);
+
+	smp_wmb();
+	WRITE_ONCE(entry->seq, atomic64_inc_return(&debug_log->seq));
+
+	/* publish record */
+	smp_store_release(&ring->head, ring->head + 1);
+
+	local_irq_restore(flags);
+
+	/* pairs with the barrier in wait_event_interruptible() */
+	smp_mb();
+	if (waitqueue_active(&debug_log->queue_wait))
+		wake_up(&debug_log->queue_wait);
 
 	return 0;
 }
@@ -128,7 +118,114 @@ static int batadv_log_release(struct inode *inode, struct file *file)
 
 static bool batadv_log_empty(struct batadv_priv_debug_log *debug_log)
 {
-	return !(debug_log->log_start - debug_log->log_end);
+	struct batadv_debug_log_ring *ring;
+	int cpu;
+
+	if (READ_ONCE(debug_log->read_off) != READ_ONCE(debug_log->read_len))
+		return false;
+
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(debug_log->rings, cpu);
+
+		if (smp_load_acquire(&ring->head) != READ_ONCE(ring->tail))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * batadv_log_oldest() - Find ring with the oldest unread record
+ * @debug_log: debug log to search
+ *
+ * Records which were already overwritten by their writer are skipped.
+ *
+ * Return: ring holding the oldest unread record at its tail or NULL when no
+ *  unread record is left
+ */
+static struct batadv_debug_log_ring *
+batadv_log_oldest(struct batadv_priv_debug_log *debug_log)
+{
+	struct batadv_debug_log_ring *oldest = NULL;
+	struct batadv_debug_log_entry *entry;
+	struct batadv_debug_log_ring *ring;
+	u64 oldest_seq = 0;
+	unsigned long head;
+	u64 seq = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(debug_log->rings, cpu);
+
+		head = smp_load_acquire(&ring->head);
+		if (head - ring->tail > BATADV_LOG_ENTRIES)
+			ring->tail = head - BATADV_LOG_ENTRIES;
+
+		while (ring->tail != head) {
+			entry = &ring->entries[ring->tail &
+					       BATADV_LOG_ENTRIES_MASK];
+			seq = READ_ONCE(entry->seq);
+			if (seq)
+				break;
+
+			/* writer lapped the reader and is overwriting it */
+			ring->tail++;
+		}
+
+		if (ring->tail == head)
+			continue;
+
+		if (oldest && seq >= oldest_seq)
+			continue;
+
+		oldest = ring;
+		oldest_seq = seq;
+	}
+
+	return oldest;
+}
+
+/**
+ * batadv_log_fetch() - Move oldest unread record to the read buffer
+ * @debug_log: debug log to fetch the record from
+ *
+ * Caller must hold debug_log->read_lock.
+ *
+ * Return: true when a record was put in the read buffer, false otherwise
+ */
+static bool batadv_log_fetch(struct batadv_priv_debug_log *debug_log)
+{
+	struct batadv_debug_log_entry *entry;
+	struct batadv_debug_log_ring *ring;
+	char msg[sizeof(entry->msg)];
+	u64 seq;
+	u32 time;
+	u16 len;
+
+	while ((ring = batadv_log_oldest(debug_log))) {
+		entry = &ring->entries[ring->tail & BATADV_LOG_ENTRIES_MASK];
+		ring->tail++;
+
+		seq = READ_ONCE(entry->seq);
+		smp_rmb();
+
+		time = entry->time;
+		len = min_t(u16, entry->len, sizeof(msg));
+		memcpy(msg, entry->msg, len);
+
+		/* drop record when it was overwritten while copying it */
+		smp_rmb();
+		if (!seq || READ_ONCE(entry->seq) != seq)
+			continue;
+
+		debug_log->read_len = scnprintf(debug_log->read_buf,
+						sizeof(debug_log->read_buf),
+						"[%10u] %.*s", time, len, msg);
+		debug_log->read_off = 0;
+		return true;
+	}
+
+	return false;
 }
 
 static ssize_t batadv_log_read(struct file *file, char __user *buf,
@@ -136,9 +233,8 @@ static ssize_t batadv_log_read(struct file *file, char __user *buf,
 {
 	struct batadv_priv *bat_priv = file->private_data;
 	struct batadv_priv_debug_log *debug_log = bat_priv->debug_log;
-	int error, i = 0;
-	char *char_addr;
-	char c;
+	size_t len, i = 0;
+	int error;
 
 	if ((file->f_flags & O_NONBLOCK) && batadv_log_empty(debug_log))
 		return -EAGAIN;
@@ -158,27 +254,26 @@ static ssize_t batadv_log_read(struct file *file, char __user *buf,
 	if (error)
 		return error;
 
-	spin_lock_bh(&debug_log->lock);
-
-	while ((!error) && (i < count) &&
-	       (debug_log->log_start != debug_log->log_end)) {
-		char_addr = batadv_log_char_addr(debug_log,
-						 debug_log->log_start);
-		c = *char_addr;
-
-		debug_log->log_start++;
-
-		spin_unlock_bh(&debug_log->lock);
+	mutex_lock(&debug_log->read_lock);
 
-		error = __put_user(c, buf);
+	while (i < count) {
+		if (debug_log->read_off == debug_log->read_len &&
+		    !batadv_log_fetch(debug_log))
+			break;
 
-		spin_lock_bh(&debug_log->lock);
+		len = min(count - i, debug_log->read_len - debug_log->read_off);
+		if (__copy_to_user(buf + i,
+				   debug_log->read_buf + debug_log->read_off,
+				   len)) {
+			error = -EFAULT;
+			break;
+		}
 
-		buf++;
-		i++;
+		debug_log->read_off += len;
+		i += len;
 	}
 
-	spin_unlock_bh(&debug_log->lock);
+	mutex_unlock(&debug_log->read_lock);
 
 	if (!error)
 		return i;
@@ -224,7 +319,12 @@ int batadv_debug_log_setup(struct batadv_priv *bat_priv)
 	if (!bat_priv->debug_log)
 		goto err;
 
-	spin_lock_init(&bat_priv->debug_log->lock);
+	bat_priv->debug_log->rings = alloc_percpu(struct batadv_debug_log_ring);
+	if (!bat_priv->debug_log->rings)
+		goto free_log;
+
+	atomic64_set(&bat_priv->debug_log->seq, 0);
+	mutex_init(&bat_priv->debug_log->read_lock);
 	init_waitqueue_head(&bat_priv->debug_log->queue_wait);
 
 	d = debugfs_create_file("log", 0400, bat_priv->debug_dir, bat_priv,
@@ -234,6 +334,9 @@ int batadv_debug_log_setup(struct batadv_priv *bat_priv)
 
 	return 0;
 
+free_log:
+	kfree(bat_priv->debug_log);
+	bat_priv->debug_log = NULL;
 err:
 	return -ENOMEM;
 }
@@ -244,6 +347,9 @@ err:
  */
 void batadv_debug_log_cleanup(struct batadv_priv *bat_priv)
 {
+	if (bat_priv->debug_log)
+		free_percpu(bat_priv->debug_log->rings);
+
 	kfree(bat_priv->debug_log);
 	bat_priv->debug_log = NULL;
 }
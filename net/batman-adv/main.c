@@ -19,30 +19,42 @@
 #include "main.h"
 
 #include <linux/atomic.h>
+#include <linux/bottom_half.h>
 #include <linux/build_bug.h>
 #include <linux/byteorder/generic.h>
+#include <linux/cpumask.h>
 #include <linux/crc32c.h>
 #include <linux/errno.h>
+#include <linux/etherdevice.h>
 #include <linux/genetlink.h>
 #include <linux/gfp.h>
+#include <linux/hashtable.h>
 #include <linux/if_ether.h>
+#include <linux/if_packet.h>
 #include <linux/if_vlan.h>
 #include <linux/init.h>
 #include <linux/ip.h>
 #include <linux/ipv6.h>
+#include <linux/jhash.h>
 #include <linux/kernel.h>
 #include <linux/kref.h>
 #include <linux/list.h>
 #include <linux/module.h>
 #include <linux/netdevice.h>
+#include <linux/numa.h>
+#include <linux/percpu.h>
 #include <linux/printk.h>
 #include <linux/rculist.h>
 #include <linux/rcupdate.h>
+#include <linux/reciprocal_div.h>
+#include <linux/sched.h>
 #include <linux/seq_file.h>
 #include <linux/skbuff.h>
+#include <linux/smp.h>
 #include <linux/spinlock.h>
 #include <linux/stddef.h>
 #include <linux/string.h>
+#include <linux/topology.h>
 #include <linux/workqueue.h>
 #include <net/dsfield.h>
 #include <net/rtnetlink.h>
@@ -55,20 +67,25 @@
 #include "bridge_loop_avoidance.h"
 #include "debugfs.h"
 #include "distributed-arp-table.h"
+#include "fragmentation.h"
 #include "gateway_client.h"
 #include "gateway_common.h"
 #include "hard-interface.h"
+#include "hash.h"
 #include "icmp_socket.h"
 #include "log.h"
 #include "multicast.h"
 #include "netlink.h"
 #include "network-coding.h"
 #include "originator.h"
+#include "ping.h"
 #include "routing.h"
 #include "send.h"
 #include "soft-interface.h"
 #include "tp_meter.h"
+#include "trace.h"
 #include "translation-table.h"
+#include "tvlv.h"
 
 /* List manipulations on hardif_list have to be rtnl_lock()'ed,
  * list traversals just rcu-locked
@@ -81,9 +98,18 @@ unsigned char batadv_broadcast_addr[] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
 
 struct workqueue_struct *batadv_event_workqueue;
 
+static DEFINE_PER_CPU(struct batadv_rx_backlog, batadv_rx_backlog);
+
 static void batadv_recv_handler_init(void);
+static void batadv_rx_backlog_init(void);
+static struct packet_offload batadv_packet_offload;
 
-static int __init batadv_init(void)
+/**
+ * batadv_caches_init() - Initialize all memory object caches of the module
+ *
+ * Return: 0 on success or negative error number in case of failure
+ */
+static int __init batadv_caches_init(void)
 {
 	int ret;
 
@@ -91,15 +117,86 @@ static int __init batadv_init(void)
 	if (ret < 0)
 		return ret;
 
+	ret = batadv_orig_cache_init();
+	if (ret < 0)
+		goto err_orig;
+
+	ret = batadv_forw_packet_cache_init();
+	if (ret < 0)
+		goto err_forw_packet;
+
+	ret = batadv_frag_cache_init();
+	if (ret < 0)
+		goto err_frag;
+
+	ret = batadv_nc_cache_init();
+	if (ret < 0)
+		goto err_nc;
+
+	ret = batadv_dat_cache_init();
+	if (ret < 0)
+		goto err_dat;
+
+	ret = batadv_bla_cache_init();
+	if (ret < 0)
+		goto err_bla;
+
+	ret = batadv_tp_cache_init();
+	if (ret < 0)
+		goto err_tp;
+
+	return 0;
+
+err_tp:
+	batadv_bla_cache_destroy();
+err_bla:
+	batadv_dat_cache_destroy();
+err_dat:
+	batadv_nc_cache_destroy();
+err_nc:
+	batadv_frag_cache_destroy();
+err_frag:
+	batadv_forw_packet_cache_destroy();
+err_forw_packet:
+	batadv_orig_cache_destroy();
+err_orig:
+	batadv_tt_cache_destroy();
+
+	return ret;
+}
+
+/**
+ * batadv_caches_destroy() - Destroy all memory object caches of the module
+ */
+static void batadv_caches_destroy(void)
+{
+	batadv_tp_cache_destroy();
+	batadv_bla_cache_destroy();
+	batadv_dat_cache_destroy();
+	batadv_nc_cache_destroy();
+	batadv_frag_cache_destroy();
+	batadv_forw_packet_cache_destroy();
+	batadv_orig_cache_destroy();
+	batadv_tt_cache_destroy();
+}
+
+static int __init batadv_init(void)
+{
+	int ret;
+
+	ret = batadv_caches_init();
+	if (ret < 0)
+		return ret;
+
 	INIT_LIST_HEAD(&batadv_hardif_list);
 	batadv_algo_init();
 
 	batadv_recv_handler_init();
+	batadv_rx_backlog_init();
 
 	batadv_v_init();
 	batadv_iv_init();
 	batadv_nc_init();
-	batadv_tp_meter_init();
 
 	batadv_event_workqueue = create_singlethread_workqueue("bat_events");
 	if (!batadv_event_workqueue)
@@ -108,6 +205,7 @@ static int __init batadv_init(void)
 	batadv_socket_init();
 	batadv_debugfs_init();
 
+	dev_add_offload(&batadv_packet_offload);
 	register_netdevice_notifier(&batadv_hard_if_notifier);
 	rtnl_link_register(&batadv_link_ops);
 	batadv_netlink_register();
@@ -118,7 +216,7 @@ static int __init batadv_init(void)
 	return 0;
 
 err_create_wq:
-	batadv_tt_cache_destroy();
+	batadv_caches_destroy();
 
 	return -ENOMEM;
 }
@@ -129,6 +227,7 @@ static void __exit batadv_exit(void)
 	batadv_netlink_unregister();
 	rtnl_link_unregister(&batadv_link_ops);
 	unregister_netdevice_notifier(&batadv_hard_if_notifier);
+	dev_remove_offload(&batadv_packet_offload);
 	batadv_hardif_remove_interfaces();
 
 	flush_workqueue(batadv_event_workqueue);
@@ -137,7 +236,7 @@ static void __exit batadv_exit(void)
 
 	rcu_barrier();
 
-	batadv_tt_cache_destroy();
+	batadv_caches_destroy();
 }
 
 /**
@@ -151,13 +250,42 @@ int batadv_mesh_init(struct net_device *soft_iface)
 	struct batadv_priv *bat_priv = netdev_priv(soft_iface);
 	int ret;
 
-	spin_lock_init(&bat_priv->forw_bat_list_lock);
-	spin_lock_init(&bat_priv->forw_bcast_list_lock);
+	/* serialize the periodic tasks of a mesh without delaying the tasks of
+	 * other meshes
+	 */
+	bat_priv->event_wq = alloc_ordered_workqueue("bat_events_%s",
+						     WQ_MEM_RECLAIM,
+						     soft_iface->name);
+	if (!bat_priv->event_wq)
+		return -ENOMEM;
+
+	bat_priv->metric_wq = alloc_workqueue("bat_metric_%s",
+					      WQ_UNBOUND | WQ_MEM_RECLAIM, 0,
+					      soft_iface->name);
+	if (!bat_priv->metric_wq) {
+		destroy_workqueue(bat_priv->event_wq);
+		bat_priv->event_wq = NULL;
+		return -ENOMEM;
+	}
+
+	/* keep the routing protocol messages away from the bulk tasks */
+	bat_priv->ctrl_wq = alloc_ordered_workqueue("bat_ctrl_%s",
+						    WQ_MEM_RECLAIM | WQ_HIGHPRI,
+						    soft_iface->name);
+	if (!bat_priv->ctrl_wq) {
+		destroy_workqueue(bat_priv->metric_wq);
+		bat_priv->metric_wq = NULL;
+		destroy_workqueue(bat_priv->event_wq);
+		bat_priv->event_wq = NULL;
+		return -ENOMEM;
+	}
+
 	spin_lock_init(&bat_priv->tt.changes_list_lock);
 	spin_lock_init(&bat_priv->tt.req_list_lock);
 	spin_lock_init(&bat_priv->tt.roam_list_lock);
 	spin_lock_init(&bat_priv->tt.last_changeset_lock);
 	spin_lock_init(&bat_priv->tt.commit_lock);
+	spin_lock_init(&bat_priv->tt.tombstones_lock);
 	spin_lock_init(&bat_priv->gw.list_lock);
 #ifdef CONFIG_BATMAN_ADV_MCAST
 	spin_lock_init(&bat_priv->mcast.want_lists_lock);
@@ -166,9 +294,12 @@ int batadv_mesh_init(struct net_device *soft_iface)
 	spin_lock_init(&bat_priv->tvlv.handler_list_lock);
 	spin_lock_init(&bat_priv->softif_vlan_list_lock);
 	spin_lock_init(&bat_priv->tp_list_lock);
+	spin_lock_init(&bat_priv->ping_list_lock);
 
-	INIT_HLIST_HEAD(&bat_priv->forw_bat_list);
-	INIT_HLIST_HEAD(&bat_priv->forw_bcast_list);
+	batadv_forw_sched_init(bat_priv, &bat_priv->forw_bat,
+			       bat_priv->ctrl_wq, BATADV_CNT_CTRL_DELAY);
+	batadv_forw_sched_init(bat_priv, &bat_priv->forw_bcast,
+			       bat_priv->event_wq, BATADV_CNT_BCAST_DELAY);
 	INIT_HLIST_HEAD(&bat_priv->gw.gateway_list);
 #ifdef CONFIG_BATMAN_ADV_MCAST
 	INIT_HLIST_HEAD(&bat_priv->mcast.want_all_unsnoopables_list);
@@ -176,15 +307,24 @@ int batadv_mesh_init(struct net_device *soft_iface)
 	INIT_HLIST_HEAD(&bat_priv->mcast.want_all_ipv6_list);
 #endif
 	INIT_LIST_HEAD(&bat_priv->tt.changes_list);
-	INIT_HLIST_HEAD(&bat_priv->tt.req_list);
+	hash_init(bat_priv->tt.changes_hash);
+	INIT_LIST_HEAD(&bat_priv->tt.req_list);
+	hash_init(bat_priv->tt.req_hash);
 	INIT_LIST_HEAD(&bat_priv->tt.roam_list);
+	hash_init(bat_priv->tt.roam_hash);
 #ifdef CONFIG_BATMAN_ADV_MCAST
-	INIT_HLIST_HEAD(&bat_priv->mcast.mla_list);
+	hash_init(bat_priv->mcast.mla_list);
 #endif
 	INIT_HLIST_HEAD(&bat_priv->tvlv.container_list);
 	INIT_HLIST_HEAD(&bat_priv->tvlv.handler_list);
+	bat_priv->tvlv.blob_dirty = true;
 	INIT_HLIST_HEAD(&bat_priv->softif_vlan_list);
+	hash_init(bat_priv->softif_vlan_hash);
 	INIT_HLIST_HEAD(&bat_priv->tp_list);
+	INIT_HLIST_HEAD(&bat_priv->ping_list);
+	bat_priv->numa_node = NUMA_NO_NODE;
+
+	batadv_iv_mesh_init(bat_priv);
 
 	ret = batadv_v_mesh_init(bat_priv);
 	if (ret < 0)
@@ -211,7 +351,11 @@ int batadv_mesh_init(struct net_device *soft_iface)
 		goto err;
 
 	batadv_gw_init(bat_priv);
-	batadv_mcast_init(bat_priv);
+	batadv_send_unicast_agg_init(bat_priv);
+
+	ret = batadv_mcast_init(bat_priv);
+	if (ret < 0)
+		goto err;
 
 	atomic_set(&bat_priv->gw.reselect, 0);
 	atomic_set(&bat_priv->mesh_state, BATADV_MESH_ACTIVE);
@@ -234,8 +378,10 @@ void batadv_mesh_free(struct net_device *soft_iface)
 	atomic_set(&bat_priv->mesh_state, BATADV_MESH_DEACTIVATING);
 
 	batadv_purge_outstanding_packets(bat_priv, NULL);
+	batadv_ping_free(bat_priv);
 
 	batadv_gw_node_free(bat_priv);
+	batadv_send_unicast_agg_free(bat_priv);
 
 	batadv_v_mesh_free(bat_priv);
 	batadv_nc_mesh_free(bat_priv);
@@ -256,8 +402,29 @@ void batadv_mesh_free(struct net_device *soft_iface)
 	 * accessing the TT data are scheduled for later execution.
 	 */
 	batadv_originator_free(bat_priv);
+	batadv_iv_mesh_free(bat_priv);
 
 	batadv_gw_free(bat_priv);
+	batadv_hardif_addrs_free(bat_priv);
+	batadv_tvlv_free(bat_priv);
+
+	/* all periodic tasks were cancelled above, only run the remaining
+	 * one-shot tasks (e.g. BLA reports) before the queue is gone
+	 */
+	if (bat_priv->event_wq) {
+		destroy_workqueue(bat_priv->event_wq);
+		bat_priv->event_wq = NULL;
+	}
+
+	if (bat_priv->metric_wq) {
+		destroy_workqueue(bat_priv->metric_wq);
+		bat_priv->metric_wq = NULL;
+	}
+
+	if (bat_priv->ctrl_wq) {
+		destroy_workqueue(bat_priv->ctrl_wq);
+		bat_priv->ctrl_wq = NULL;
+	}
 
 	free_percpu(bat_priv->bat_counters);
 	bat_priv->bat_counters = NULL;
@@ -265,6 +432,37 @@ void batadv_mesh_free(struct net_device *soft_iface)
 	atomic_set(&bat_priv->mesh_state, BATADV_MESH_INACTIVE);
 }
 
+/**
+ * batadv_mesh_set_numa_node() - Place the tables of a mesh on a NUMA node
+ * @bat_priv: the bat priv with all the soft interface information
+ * @node: NUMA node of the primary interface
+ *
+ * The bucket arrays of all tables are moved in the background, new entries
+ * are allocated on @node right away.
+ */
+void batadv_mesh_set_numa_node(struct batadv_priv *bat_priv, int node)
+{
+	if (bat_priv->numa_node == node)
+		return;
+
+	WRITE_ONCE(bat_priv->numa_node, node);
+
+	batadv_hash_set_node(bat_priv->orig_hash, node);
+	batadv_hash_set_node(bat_priv->tt.local_hash, node);
+	batadv_hash_set_node(bat_priv->tt.global_hash, node);
+#ifdef CONFIG_BATMAN_ADV_BLA
+	batadv_hash_set_node(bat_priv->bla.claim_hash, node);
+	batadv_hash_set_node(bat_priv->bla.backbone_hash, node);
+#endif
+#ifdef CONFIG_BATMAN_ADV_DAT
+	batadv_hash_set_node(bat_priv->dat.hash, node);
+#endif
+#ifdef CONFIG_BATMAN_ADV_NC
+	batadv_hash_set_node(bat_priv->nc.coding_hash, node);
+	batadv_hash_set_node(bat_priv->nc.decoding_hash, node);
+#endif
+}
+
 /**
  * batadv_is_my_mac() - check if the given mac address belongs to any of the
  *  real interfaces in the current mesh
@@ -276,11 +474,30 @@ void batadv_mesh_free(struct net_device *soft_iface)
 bool batadv_is_my_mac(struct batadv_priv *bat_priv, const u8 *addr)
 {
 	const struct batadv_hard_iface *hard_iface;
+	const struct batadv_hardif_addrs *addrs;
+	const struct batadv_hardif_addr *entry;
 	bool is_my_mac = false;
+	u32 index;
 
 	rcu_read_lock();
+	addrs = rcu_dereference(bat_priv->hardif_addrs);
+	if (addrs) {
+		index = batadv_choose_orig(addr, BATADV_HARDIF_ADDR_BUCKETS);
+		hlist_for_each_entry(entry, &addrs->table[index], list) {
+			if (!batadv_compare_eth(entry->addr, addr))
+				continue;
+
+			if (batadv_hardif_is_my_addr(entry->hard_iface)) {
+				is_my_mac = true;
+				break;
+			}
+		}
+
+		goto out;
+	}
+
 	list_for_each_entry_rcu(hard_iface, &batadv_hardif_list, list) {
-		if (hard_iface->if_status != BATADV_IF_ACTIVE)
+		if (!batadv_hardif_is_my_addr(hard_iface))
 			continue;
 
 		if (hard_iface->soft_iface != bat_priv->soft_iface)
@@ -291,6 +508,7 @@ bool batadv_is_my_mac(struct batadv_priv *bat_priv, const u8 *addr)
 			break;
 		}
 	}
+out:
 	rcu_read_unlock();
 	return is_my_mac;
 }
@@ -358,6 +576,88 @@ int batadv_max_header_len(void)
 	return header_len + ETH_HLEN;
 }
 
+/**
+ * batadv_skb_classify() - parse the headers of a client frame once
+ * @skb: the frame to classify, skb->data and the mac header pointing to the
+ *  ethernet header
+ *
+ * Stores the VLAN identifier, the ethertype, the 802.1d priority and the
+ * offsets of the network and transport header in the control buffer. The
+ * features hooked into the tx and rx path of the soft interface can then
+ * retrieve them via batadv_skb_cb_classified() instead of walking the headers
+ * again. The ethernet and VLAN header are guaranteed to be in the linear part
+ * of the skb when the classification succeeded, the IPv4/IPv6 header when the
+ * transport offset is set. Otherwise the frame is left unclassified and the
+ * consumers parse it on their own.
+ *
+ * This call might reallocate skb data.
+ */
+void batadv_skb_classify(struct sk_buff *skb)
+{
+	struct batadv_skb_cb *cb = BATADV_SKB_CB(skb);
+	struct vlan_ethhdr *vhdr;
+	struct ipv6hdr *ip6hdr;
+	struct iphdr *iphdr;
+	unsigned int offset;
+	u16 tci;
+
+	cb->classified = 0;
+	cb->has_prio = 0;
+	cb->l4_proto = 0;
+	cb->vid = BATADV_NO_FLAGS;
+	cb->transport_offset = 0;
+
+	if (!pskb_may_pull(skb, ETH_HLEN))
+		return;
+
+	cb->l3_proto = eth_hdr(skb)->h_proto;
+	offset = ETH_HLEN;
+
+	if (cb->l3_proto == htons(ETH_P_8021Q)) {
+		if (!pskb_may_pull(skb, VLAN_ETH_HLEN))
+			return;
+
+		vhdr = vlan_eth_hdr(skb);
+		tci = ntohs(vhdr->h_vlan_TCI);
+		cb->vid = (tci & VLAN_VID_MASK) | BATADV_VLAN_HAS_TAG;
+		cb->prio = (tci & VLAN_PRIO_MASK) >> VLAN_PRIO_SHIFT;
+		cb->has_prio = 1;
+		cb->l3_proto = vhdr->h_vlan_encapsulated_proto;
+		offset = VLAN_ETH_HLEN;
+	}
+
+	cb->network_offset = offset;
+
+	switch (cb->l3_proto) {
+	case htons(ETH_P_IP):
+		if (!pskb_may_pull(skb, offset + sizeof(*iphdr)))
+			break;
+
+		iphdr = (struct iphdr *)(skb->data + offset);
+		cb->l4_proto = iphdr->protocol;
+		cb->transport_offset = offset + iphdr->ihl * 4;
+		if (!cb->has_prio) {
+			cb->prio = (ipv4_get_dsfield(iphdr) & 0xfc) >> 5;
+			cb->has_prio = 1;
+		}
+		break;
+	case htons(ETH_P_IPV6):
+		if (!pskb_may_pull(skb, offset + sizeof(*ip6hdr)))
+			break;
+
+		ip6hdr = (struct ipv6hdr *)(skb->data + offset);
+		cb->l4_proto = ip6hdr->nexthdr;
+		cb->transport_offset = offset + sizeof(*ip6hdr);
+		if (!cb->has_prio) {
+			cb->prio = (ipv6_get_dsfield(ip6hdr) & 0xfc) >> 5;
+			cb->has_prio = 1;
+		}
+		break;
+	}
+
+	cb->classified = 1;
+}
+
 /**
  * batadv_skb_set_priority() - sets skb priority according to packet content
  * @skb: the packet to be sent
@@ -372,20 +672,28 @@ void batadv_skb_set_priority(struct sk_buff *skb, int offset)
 	struct ipv6hdr ip6_hdr_tmp, *ip6_hdr;
 	struct ethhdr ethhdr_tmp, *ethhdr;
 	struct vlan_ethhdr *vhdr, vhdr_tmp;
+	struct batadv_skb_cb *cb;
 	u32 prio;
 
 	/* already set, do nothing */
 	if (skb->priority >= 256 && skb->priority <= 263)
 		return;
 
+	cb = batadv_skb_cb_classified(skb, offset);
+	if (cb) {
+		if (cb->has_prio)
+			skb->priority = cb->prio + 256;
+		return;
+	}
+
 	ethhdr = skb_header_pointer(skb, offset, sizeof(*ethhdr), &ethhdr_tmp);
 	if (!ethhdr)
 		return;
 
 	switch (ethhdr->h_proto) {
 	case htons(ETH_P_8021Q):
-		vhdr = skb_header_pointer(skb, offset + sizeof(*vhdr),
-					  sizeof(*vhdr), &vhdr_tmp);
+		vhdr = skb_header_pointer(skb, offset, sizeof(*vhdr),
+					  &vhdr_tmp);
 		if (!vhdr)
 			return;
 		prio = ntohs(vhdr->h_vlan_TCI) & VLAN_PRIO_MASK;
@@ -412,6 +720,71 @@ void batadv_skb_set_priority(struct sk_buff *skb, int offset)
 	skb->priority = prio + 256;
 }
 
+/**
+ * batadv_skb_set_flow_hash() - sets skb flow hash according to packet content
+ * @skb: the packet to be forwarded
+ * @offset: offset to the packet content
+ *
+ * The flow hash of a received batman-adv packet only covers the outer
+ * headers (if any) and would therefore send all forwarded traffic through the
+ * same transmit queue of the outgoing interface. Replace it with a hash of
+ * the encapsulated ethernet and IP addresses to spread the flows over the
+ * queues of multi-queue devices.
+ */
+void batadv_skb_set_flow_hash(struct sk_buff *skb, int offset)
+{
+	struct iphdr ip_hdr_tmp, *ip_hdr;
+	struct ipv6hdr ip6_hdr_tmp, *ip6_hdr;
+	struct ethhdr ethhdr_tmp, *ethhdr;
+	struct vlan_ethhdr *vhdr, vhdr_tmp;
+	enum pkt_hash_types type = PKT_HASH_TYPE_L2;
+	__be16 proto;
+	u32 hash;
+
+	ethhdr = skb_header_pointer(skb, offset, sizeof(*ethhdr), &ethhdr_tmp);
+	if (!ethhdr)
+		return;
+
+	hash = jhash(ethhdr, 2 * ETH_ALEN, 0);
+	proto = ethhdr->h_proto;
+	offset += ETH_HLEN;
+
+	if (proto == htons(ETH_P_8021Q)) {
+		vhdr = skb_header_pointer(skb, offset - ETH_HLEN, sizeof(*vhdr),
+					  &vhdr_tmp);
+		if (!vhdr)
+			goto out;
+
+		proto = vhdr->h_vlan_encapsulated_proto;
+		offset += VLAN_HLEN;
+	}
+
+	switch (proto) {
+	case htons(ETH_P_IP):
+		ip_hdr = skb_header_pointer(skb, offset, sizeof(*ip_hdr),
+					    &ip_hdr_tmp);
+		if (!ip_hdr)
+			break;
+
+		hash = jhash_2words((__force u32)ip_hdr->saddr,
+				    (__force u32)ip_hdr->daddr, hash);
+		type = PKT_HASH_TYPE_L3;
+		break;
+	case htons(ETH_P_IPV6):
+		ip6_hdr = skb_header_pointer(skb, offset, sizeof(*ip6_hdr),
+					     &ip6_hdr_tmp);
+		if (!ip6_hdr)
+			break;
+
+		hash = jhash(&ip6_hdr->saddr, 2 * sizeof(ip6_hdr->saddr), hash);
+		type = PKT_HASH_TYPE_L3;
+		break;
+	}
+
+out:
+	skb_set_hash(skb, hash, type);
+}
+
 static int batadv_recv_unhandled_packet(struct sk_buff *skb,
 					struct batadv_hard_iface *recv_if)
 {
@@ -420,27 +793,243 @@ static int batadv_recv_unhandled_packet(struct sk_buff *skb,
 	return NET_RX_DROP;
 }
 
-/* incoming packets with the batman ethertype received on any active hard
- * interface
+/**
+ * batadv_rx_drop_counter() - get the counter for packets dropped by a receive
+ *  handler
+ * @packet_type: batman-adv packet type of the dropped packet
+ *
+ * Return: index of the matching BATADV_CNT_RX_DROP_* counter
  */
+static size_t batadv_rx_drop_counter(u8 packet_type)
+{
+	switch (packet_type) {
+	case BATADV_IV_OGM:
+		return BATADV_CNT_RX_DROP_OGM;
+	case BATADV_BCAST:
+		return BATADV_CNT_RX_DROP_BCAST;
+	case BATADV_CODED:
+	case BATADV_CODED_MULTI:
+		return BATADV_CNT_RX_DROP_CODED;
+	case BATADV_ELP:
+		return BATADV_CNT_RX_DROP_ELP;
+	case BATADV_OGM2:
+		return BATADV_CNT_RX_DROP_OGM2;
+	case BATADV_UNICAST:
+		return BATADV_CNT_RX_DROP_UNICAST;
+	case BATADV_UNICAST_FRAG:
+		return BATADV_CNT_RX_DROP_UNICAST_FRAG;
+	case BATADV_UNICAST_4ADDR:
+		return BATADV_CNT_RX_DROP_UNICAST_4ADDR;
+	case BATADV_ICMP:
+		return BATADV_CNT_RX_DROP_ICMP;
+	case BATADV_UNICAST_TVLV:
+		return BATADV_CNT_RX_DROP_UNICAST_TVLV;
+	case BATADV_UNICAST_AGG:
+		return BATADV_CNT_RX_DROP_UNICAST_AGG;
+	default:
+		return BATADV_CNT_RX_DROP_UNKNOWN;
+	}
+}
 
 /**
- * batadv_batman_skb_recv() - Handle incoming message from an hard interface
+ * batadv_rx_backlog_work() - process the packets steered to this CPU
+ * @work: work queue item of the &batadv_rx_backlog
+ */
+static void batadv_rx_backlog_work(struct work_struct *work)
+{
+	struct batadv_hard_iface *hard_iface;
+	struct batadv_rx_backlog *backlog;
+	struct batadv_priv *bat_priv;
+	struct sk_buff *skb;
+	int budget;
+
+	backlog = container_of(work, struct batadv_rx_backlog, work);
+
+	while (!skb_queue_empty(&backlog->queue)) {
+		local_bh_disable();
+		rcu_read_lock();
+
+		for (budget = BATADV_RX_BACKLOG_BUDGET; budget > 0; budget--) {
+			skb = skb_dequeue(&backlog->queue);
+			if (!skb)
+				break;
+
+			hard_iface = BATADV_SKB_CB(skb)->recv_if;
+
+			/* the interface may have left the mesh meanwhile */
+			if (hard_iface->if_status != BATADV_IF_ACTIVE ||
+			    !hard_iface->soft_iface) {
+				kfree_skb(skb);
+				batadv_hardif_put(hard_iface);
+				continue;
+			}
+
+			bat_priv = netdev_priv(hard_iface->soft_iface);
+			if (atomic_read(&bat_priv->mesh_state) ==
+			    BATADV_MESH_ACTIVE)
+				batadv_recv_handler_call(skb, hard_iface);
+			else
+				kfree_skb(skb);
+
+			batadv_hardif_put(hard_iface);
+		}
+
+		rcu_read_unlock();
+		local_bh_enable();
+
+		cond_resched();
+	}
+}
+
+/**
+ * batadv_rx_backlog_init() - initialize the per CPU receive backlogs
+ */
+static void __init batadv_rx_backlog_init(void)
+{
+	struct batadv_rx_backlog *backlog;
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		backlog = per_cpu_ptr(&batadv_rx_backlog, cpu);
+		skb_queue_head_init(&backlog->queue);
+		INIT_WORK(&backlog->work, batadv_rx_backlog_work);
+		backlog->cpu = cpu;
+	}
+}
+
+/**
+ * batadv_rx_backlog_flush() - wait until all steered packets were processed
+ *
+ * Has to be called after an interface stopped receiving packets and before it
+ * leaves its mesh.
+ */
+void batadv_rx_backlog_flush(void)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu)
+		flush_work(&per_cpu_ptr(&batadv_rx_backlog, cpu)->work);
+}
+
+/**
+ * batadv_rx_steer_cpu() - choose the CPU processing the packets of an
+ *  originator
+ * @bat_priv: the bat priv with all the soft interface information
+ * @hash: hash of the originator address
+ *
+ * The CPUs of the NUMA node of the primary interface are preferred, so that
+ * the tables of the mesh are accessed from the node they are allocated on.
+ *
+ * Return: the chosen CPU
+ */
+static unsigned int batadv_rx_steer_cpu(struct batadv_priv *bat_priv,
+					u32 hash)
+{
+	int node = READ_ONCE(bat_priv->numa_node);
+	unsigned int cpus;
+
+	if (node == NUMA_NO_NODE)
+		return reciprocal_scale(hash, nr_cpu_ids);
+
+	cpus = cpumask_weight(cpumask_of_node(node));
+	if (!cpus)
+		return reciprocal_scale(hash, nr_cpu_ids);
+
+	return cpumask_local_spread(reciprocal_scale(hash, cpus), node);
+}
+
+/**
+ * batadv_rx_steer() - queue a packet on the CPU responsible for its originator
+ * @bat_priv: the bat priv with all the soft interface information
  * @skb: the received packet
- * @dev: the net device that the packet was received on
- * @ptype: packet type of incoming packet (ETH_P_BATMAN)
- * @orig_dev: the original receive net device (e.g. bonded device)
+ * @hard_iface: the interface the packet was received on
  *
- * Return: NET_RX_SUCCESS on success or NET_RX_DROP in case of failure
+ * OGMs and broadcasts of the same originator update the same originator
+ * state. Processing them on one CPU, chosen by the originator address, keeps
+ * the locks of that state from bouncing between the CPUs which happened to
+ * receive them. Aggregated OGMs are steered by their first originator.
+ *
+ * Return: true if the packet and the reference to @hard_iface were handed
+ * over to another CPU, false if the packet has to be processed right away
  */
-int batadv_batman_skb_recv(struct sk_buff *skb, struct net_device *dev,
-			   struct packet_type *ptype,
-			   struct net_device *orig_dev)
+static bool batadv_rx_steer(struct batadv_priv *bat_priv, struct sk_buff *skb,
+			    struct batadv_hard_iface *hard_iface)
+{
+	struct batadv_rx_backlog *backlog;
+	struct batadv_bcast_packet *packet;
+	unsigned int cpu;
+	u32 hash;
+
+	BUILD_BUG_ON(offsetof(struct batadv_ogm_packet, orig) !=
+		     offsetof(struct batadv_bcast_packet, orig));
+	BUILD_BUG_ON(offsetof(struct batadv_ogm2_packet, orig) !=
+		     offsetof(struct batadv_bcast_packet, orig));
+
+	if (!atomic_read(&bat_priv->rx_steering))
+		return false;
+
+	switch (skb->data[0]) {
+	case BATADV_IV_OGM:
+	case BATADV_OGM2:
+	case BATADV_BCAST:
+		break;
+	default:
+		return false;
+	}
+
+	if (!pskb_may_pull(skb, sizeof(*packet)))
+		return false;
+
+	packet = (struct batadv_bcast_packet *)skb->data;
+	hash = jhash(packet->orig, ETH_ALEN, 0);
+	cpu = batadv_rx_steer_cpu(bat_priv, hash);
+
+	if (cpu == smp_processor_id() || !cpu_online(cpu))
+		return false;
+
+	backlog = per_cpu_ptr(&batadv_rx_backlog, cpu);
+	if (skb_queue_len(&backlog->queue) >= BATADV_RX_BACKLOG_LEN)
+		return false;
+
+	BATADV_SKB_CB(skb)->recv_if = hard_iface;
+	skb_queue_tail(&backlog->queue, skb);
+	queue_work_on(backlog->cpu, system_highpri_wq, &backlog->work);
+
+	return true;
+}
+
+/**
+ * batadv_recv_handler_call() - pass a packet to the receive handler of its type
+ * @skb: the packet to handle, starting with the batman-adv header
+ * @hard_iface: the interface the packet was received on
+ *
+ * The skb is consumed.
+ */
+void batadv_recv_handler_call(struct sk_buff *skb,
+			      struct batadv_hard_iface *hard_iface)
+{
+	struct batadv_priv *bat_priv = netdev_priv(hard_iface->soft_iface);
+	u8 idx = skb->data[0];
+
+	/* reset control block to avoid left overs from previous users */
+	memset(skb->cb, 0, sizeof(struct batadv_skb_cb));
+
+	if ((*batadv_rx_handler[idx])(skb, hard_iface) == NET_RX_DROP)
+		batadv_inc_counter(bat_priv, batadv_rx_drop_counter(idx));
+}
+
+/* incoming packets with the batman ethertype received on any active hard
+ * interface
+ */
+
+static int __batadv_batman_skb_recv(struct sk_buff *skb,
+				    struct net_device *dev,
+				    struct packet_type *ptype,
+				    struct net_device *orig_dev)
 {
 	struct batadv_priv *bat_priv;
 	struct batadv_ogm_packet *batadv_ogm_packet;
 	struct batadv_hard_iface *hard_iface;
-	u8 idx;
 
 	hard_iface = container_of(ptype, struct batadv_hard_iface,
 				  batman_adv_ptype);
@@ -458,6 +1047,10 @@ int batadv_batman_skb_recv(struct sk_buff *skb, struct net_device *dev,
 	if (!skb)
 		goto err_put;
 
+	batadv_hardif_inc_counter(hard_iface, BATADV_HARDIF_CNT_RX);
+	batadv_hardif_add_counter(hard_iface, BATADV_HARDIF_CNT_RX_BYTES,
+				  skb->len + ETH_HLEN);
+
 	/* packet should hold at least type and version */
 	if (unlikely(!pskb_may_pull(skb, 2)))
 		goto err_free;
@@ -484,14 +1077,15 @@ int batadv_batman_skb_recv(struct sk_buff *skb, struct net_device *dev,
 		batadv_dbg(BATADV_DBG_BATMAN, bat_priv,
 			   "Drop packet: incompatible batman version (%i)\n",
 			   batadv_ogm_packet->version);
+		batadv_inc_counter(bat_priv, BATADV_CNT_RX_DROP_VERSION);
 		goto err_free;
 	}
 
-	/* reset control block to avoid left overs from previous users */
-	memset(skb->cb, 0, sizeof(struct batadv_skb_cb));
+	/* the reference to hard_iface is released by the steering CPU */
+	if (batadv_rx_steer(bat_priv, skb, hard_iface))
+		return NET_RX_SUCCESS;
 
-	idx = batadv_ogm_packet->packet_type;
-	(*batadv_rx_handler[idx])(skb, hard_iface);
+	batadv_recv_handler_call(skb, hard_iface);
 
 	batadv_hardif_put(hard_iface);
 
@@ -509,6 +1103,117 @@ err_out:
 	return NET_RX_DROP;
 }
 
+/**
+ * batadv_batman_skb_recv() - Handle incoming message from an hard interface
+ * @skb: the received packet
+ * @dev: the net device that the packet was received on
+ * @ptype: packet type of incoming packet (ETH_P_BATMAN)
+ * @orig_dev: the original receive net device (e.g. bonded device)
+ *
+ * Return: NET_RX_SUCCESS on success or NET_RX_DROP in case of failure
+ */
+int batadv_batman_skb_recv(struct sk_buff *skb, struct net_device *dev,
+			   struct packet_type *ptype,
+			   struct net_device *orig_dev)
+{
+	unsigned int len = skb->len;
+	u64 start = 0;
+	int ret;
+
+	if (trace_batadv_skb_recv_enabled())
+		start = batadv_trace_clock();
+
+	ret = __batadv_batman_skb_recv(skb, dev, ptype, orig_dev);
+
+	trace_batadv_skb_recv(dev, len, start);
+
+	return ret;
+}
+
+/**
+ * batadv_gro_receive() - Merge unicast packets of the same flow
+ * @head: list of packets held back by GRO
+ * @skb: received packet
+ *
+ * Only plain unicast packets addressed to this host at the link layer are
+ * merged: fragments, broadcasts and management packets carry per packet state
+ * and overheard packets may be needed for network decoding. The batman-adv
+ * headers of merged packets are identical, the encapsulated ethernet frames
+ * are merged by the GRO handlers of their payload.
+ *
+ * Return: the packet which has to be completed, NULL otherwise
+ */
+static struct sk_buff **batadv_gro_receive(struct sk_buff **head,
+					   struct sk_buff *skb)
+{
+	struct batadv_unicast_packet *unicast_packet;
+	unsigned int hdr_len = sizeof(*unicast_packet);
+	unsigned int off = skb_gro_offset(skb);
+	struct sk_buff **pp = NULL;
+	struct sk_buff *p;
+	int flush = 1;
+
+	if (skb->pkt_type != PACKET_HOST)
+		goto out;
+
+	unicast_packet = skb_gro_header_fast(skb, off);
+	if (skb_gro_header_hard(skb, off + hdr_len)) {
+		unicast_packet = skb_gro_header_slow(skb, off + hdr_len, off);
+		if (!unicast_packet)
+			goto out;
+	}
+
+	if (unicast_packet->packet_type != BATADV_UNICAST ||
+	    unicast_packet->version != BATADV_COMPAT_VERSION)
+		goto out;
+
+	flush = 0;
+
+	for (p = *head; p; p = p->next) {
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		/* held packets were pulled into the linear part already */
+		if (memcmp(unicast_packet, p->data + off, hdr_len) != 0)
+			NAPI_GRO_CB(p)->same_flow = 0;
+	}
+
+	skb_gro_pull(skb, hdr_len);
+	skb_gro_postpull_rcsum(skb, unicast_packet, hdr_len);
+	pp = call_gro_receive(eth_gro_receive, head, skb);
+
+out:
+	NAPI_GRO_CB(skb)->flush |= flush;
+
+	return pp;
+}
+
+/**
+ * batadv_gro_complete() - Finish a packet merged by batadv_gro_receive()
+ * @skb: merged packet
+ * @nhoff: offset of the batman-adv header
+ *
+ * The merged packet keeps a single batman-adv header and is handed to
+ * batadv_batman_skb_recv() as GSO packet. It is delivered to the soft
+ * interface in one piece or segmented again by batadv_send_skb_to_orig() when
+ * it is forwarded.
+ *
+ * Return: 0 on success or negative error number in case of failure
+ */
+static int batadv_gro_complete(struct sk_buff *skb, int nhoff)
+{
+	return eth_gro_complete(skb,
+				nhoff + sizeof(struct batadv_unicast_packet));
+}
+
+static struct packet_offload batadv_packet_offload = {
+	.type = cpu_to_be16(ETH_P_BATMAN),
+	.callbacks = {
+		.gro_receive = batadv_gro_receive,
+		.gro_complete = batadv_gro_complete,
+	},
+};
+
 static void batadv_recv_handler_init(void)
 {
 	int i;
@@ -529,7 +1234,10 @@ static void batadv_recv_handler_init(void)
 	BUILD_BUG_ON(sizeof(struct batadv_unicast_4addr_packet) != 18);
 	BUILD_BUG_ON(sizeof(struct batadv_frag_packet) != 20);
 	BUILD_BUG_ON(sizeof(struct batadv_bcast_packet) != 14);
+	BUILD_BUG_ON(sizeof(struct batadv_unicast_agg_packet) != 4);
 	BUILD_BUG_ON(sizeof(struct batadv_coded_packet) != 46);
+	BUILD_BUG_ON(sizeof(struct batadv_coded_multi_entry) != 26);
+	BUILD_BUG_ON(sizeof(struct batadv_coded_multi_packet) != 4);
 	BUILD_BUG_ON(sizeof(struct batadv_unicast_tvlv_packet) != 20);
 	BUILD_BUG_ON(sizeof(struct batadv_tvlv_hdr) != 4);
 	BUILD_BUG_ON(sizeof(struct batadv_tvlv_gateway_data) != 8);
@@ -542,6 +1250,8 @@ static void batadv_recv_handler_init(void)
 
 	/* broadcast packet */
 	batadv_rx_handler[BATADV_BCAST] = batadv_recv_bcast_packet;
+	/* aggregate of unicast packets for this node */
+	batadv_rx_handler[BATADV_UNICAST_AGG] = batadv_recv_unicast_agg_packet;
 
 	/* unicast packets ... */
 	/* unicast with 4 addresses packet */
@@ -633,9 +1343,14 @@ __be32 batadv_skb_crc32(struct sk_buff *skb, u8 *payload_ptr)
 unsigned short batadv_get_vid(struct sk_buff *skb, size_t header_len)
 {
 	struct ethhdr *ethhdr = (struct ethhdr *)(skb->data + header_len);
+	struct batadv_skb_cb *cb;
 	struct vlan_ethhdr *vhdr;
 	unsigned short vid;
 
+	cb = batadv_skb_cb_classified(skb, header_len);
+	if (cb)
+		return cb->vid;
+
 	if (ethhdr->h_proto != htons(ETH_P_8021Q))
 		return BATADV_NO_FLAGS;
 
@@ -38,7 +38,7 @@
 #define BATADV_TTL 50
 
 /* maximum sequence number age of broadcast messages */
-#define BATADV_BCAST_MAX_AGE 64
+#define BATADV_BCAST_MAX_AGE (1 << CONFIG_BATMAN_ADV_BCAST_WINDOW_SHIFT)
 
 /* purge originators after time in seconds if no valid packet comes in
  * -> TODO: check influence on BATADV_TQ_LOCAL_WINDOW_SIZE
@@ -49,7 +49,13 @@
 #define BATADV_TT_CLIENT_TEMP_TIMEOUT 600000 /* in milliseconds */
 #define BATADV_TT_WORK_PERIOD 5000 /* 5 seconds */
 #define BATADV_ORIG_WORK_PERIOD 1000 /* 1 second */
+/* number of work item runs a purge sweep over the orig_hash is split into */
+#define BATADV_ORIG_PURGE_SLICES 8
 #define BATADV_MCAST_WORK_PERIOD 500 /* 0.5 seconds */
+#define BATADV_MCAST_WORK_PERIOD_MAX 4000 /* 4 seconds */
+#define BATADV_MCAST_TRIGGER_DELAY 10 /* in milliseconds */
+/* number of multicast groups whose TT listener count is cached per CPU */
+#define BATADV_MCAST_CACHE_SIZE 16
 #define BATADV_DAT_ENTRY_TIMEOUT (5 * 60000) /* 5 mins in milliseconds */
 /* sliding packet range of received originator messages in sequence numbers
  * (should be a multiple of our word size)
@@ -62,6 +68,10 @@
 #define BATADV_TQ_LOCAL_BIDRECT_SEND_MINIMUM 1
 #define BATADV_TQ_LOCAL_BIDRECT_RECV_MINIMUM 1
 #define BATADV_TQ_TOTAL_BIDRECT_LIMIT 1
+/* maximum age of the precomputed bonding candidates in milliseconds */
+#define BATADV_BONDING_SET_MAX_AGE 1000
+/* originator slots per chunk of per-interface own OGM counters */
+#define BATADV_IV_OWN_CHUNK_SLOTS 64
 
 /* B.A.T.M.A.N. V */
 #define BATADV_THROUGHPUT_DEFAULT_VALUE 10 /* 1 Mbps */
@@ -69,9 +79,69 @@
 #define BATADV_ELP_MIN_PROBE_SIZE 200 /* bytes */
 #define BATADV_ELP_PROBE_MAX_TX_DIFF 100 /* milliseconds */
 #define BATADV_ELP_MAX_AGE 64
+#define BATADV_CAPACITY_MIN_SHARE 25 /* percent of the link throughput */
 #define BATADV_OGM_MAX_ORIGDIFF 5
+/* distant originators get at least every 2^BATADV_FISHEYE_MAX_SHIFT-th OGM */
+#define BATADV_FISHEYE_MAX_SHIFT 3
+/* minimum throughput gain (in percent) needed to switch to another router */
+#define BATADV_V_ROUTE_HYSTERESIS 10
 #define BATADV_OGM_MAX_AGE 64
 
+/* per-CPU cached translation table lookups (has to be a power of 2) */
+#define BATADV_TT_TX_CACHE_SIZE 16
+
+/* number of global tt deletions remembered for delta dumps */
+#define BATADV_TT_TOMBSTONES 256
+
+/* number of counters of the TT bloom filters (has to be a power of 2) */
+#define BATADV_TT_BLOOM_SIZE 4096
+
+/* number of buckets of the multicast listener address sets (as power of 2) */
+#define BATADV_MCAST_MLA_HASH_BITS 6
+
+/* number of buckets of the hard interface neighbor index (as power of 2) */
+#define BATADV_HARDIF_NEIGH_HASH_BITS 5
+
+/* number of buckets of the VLAN index of a mesh interface (as power of 2) */
+#define BATADV_SOFTIF_VLAN_HASH_BITS 6
+
+/* number of buckets of the VLAN index of an originator (as power of 2) */
+#define BATADV_ORIG_VLAN_HASH_BITS 3
+
+/* number of buckets of the NC coding opportunity index (as power of 2) */
+#define BATADV_NC_INDEX_HASH_BITS 6
+
+/* maximum number of packets coded into a single network coded packet */
+#define BATADV_NC_MULTI_MAX 4
+
+/* number of buckets of the local TT changes hash (as power of 2) */
+#define BATADV_TT_CHANGES_HASH_BITS 7
+
+/* number of buckets of the pending TT requests hash (as power of 2) */
+#define BATADV_TT_REQ_HASH_BITS 6
+
+/* number of buckets of the roaming clients hash (as power of 2) */
+#define BATADV_TT_ROAM_HASH_BITS 8
+
+/* number of hashed orig_list locks in compact TT mode (as power of 2) */
+#define BATADV_TT_LIST_LOCK_BITS 8
+
+/* maximum size of a chunk of a full table TT response */
+#define BATADV_TT_CHUNK_SIZE ETH_DATA_LEN
+
+/* number of clients restored before the TT lock of an originator is dropped */
+#define BATADV_TT_RESTORE_BATCH 64
+
+/* maximum time an unchanged TT tvlv is accepted without checking the CRCs
+ * again (in milliseconds)
+ */
+#define BATADV_TT_OGM_RECHECK_TIMEOUT 10000
+
+/* time after which an originator with more global TT entries than allowed by
+ * tt_global_max_entries is asked for its full table again (in milliseconds)
+ */
+#define BATADV_TT_OVER_LIMIT_RETRY 60000
+
 /* number of OGMs sent with the last tt diff */
 #define BATADV_TT_OGM_APPEND_MAX 3
 
@@ -95,15 +165,43 @@
 
 #define BATADV_NUM_WORDS BITS_TO_LONGS(BATADV_TQ_LOCAL_WINDOW_SIZE)
 
+/* maximum payload of a netlink mesh state change notification */
+#define BATADV_NL_EVENT_SIZE 128
+
+/* tvlv types/versions which are looked up by direct indexing instead of
+ * walking the tvlv handler list
+ */
+#define BATADV_TVLV_DISPATCH_TYPES 8
+#define BATADV_TVLV_DISPATCH_VERSIONS 4
+
 #define BATADV_LOG_BUF_LEN 8192	  /* has to be a power of 2 */
+#define BATADV_LOG_ENTRY_LEN 256  /* has to be a power of 2 */
+/* number of debug log records in each per cpu ring */
+#define BATADV_LOG_ENTRIES (BATADV_LOG_BUF_LEN / BATADV_LOG_ENTRY_LEN)
 
 /* number of packets to send for broadcasts on different interface types */
 #define BATADV_NUM_BCASTS_DEFAULT 1
 #define BATADV_NUM_BCASTS_WIRELESS 3
-#define BATADV_NUM_BCASTS_MAX 3
+/* every further this many neighbors on an interface, which rebroadcast as
+ * well, make one of the own broadcast retransmissions redundant
+ */
+#define BATADV_NUM_BCASTS_NEIGHS 4
+
+/* number of recently flooded broadcasts remembered for the suppression of
+ * repeated ones, has to be a power of 2
+ */
+#define BATADV_BCAST_SUPPRESS_SLOTS 64
+/* longest configurable suppression window in milliseconds */
+#define BATADV_BCAST_SUPPRESS_WINDOW_MAX 10000
 
-/* length of the single packet used by the TP meter */
+/* default length of the single packet used by the TP meter */
 #define BATADV_TP_PACKET_LEN ETH_DATA_LEN
+/* smallest packet which can carry the TP meter header */
+#define BATADV_TP_MIN_PACKET_LEN (ETH_HLEN + \
+				  sizeof(struct batadv_unicast_packet) + \
+				  sizeof(struct batadv_icmp_tp_packet))
+/* largest packet the TP meter can simulate (jumbo frame) */
+#define BATADV_TP_MAX_PACKET_LEN 9000
 
 /* msecs after which an ARP_REQUEST is sent in broadcast as fallback */
 #define ARP_REQ_DELAY 250
@@ -121,14 +219,23 @@
 #define BATADV_MAX_AGGREGATION_BYTES 512
 #define BATADV_MAX_AGGREGATION_MS 100
 
+/* only unicast packets up to this size wait for others to aggregate with */
+#define BATADV_UNICAST_AGG_PACKET_MAX 256
+/* longest configurable unicast aggregation delay in milliseconds */
+#define BATADV_UNICAST_AGG_DELAY_MAX 20
+
 #define BATADV_BLA_PERIOD_LENGTH	10000	/* 10 seconds */
 #define BATADV_BLA_BACKBONE_TIMEOUT	(BATADV_BLA_PERIOD_LENGTH * 6)
 #define BATADV_BLA_CLAIM_TIMEOUT	(BATADV_BLA_PERIOD_LENGTH * 10)
 #define BATADV_BLA_WAIT_PERIODS		3
 #define BATADV_BLA_LOOPDETECT_PERIODS	6
 #define BATADV_BLA_LOOPDETECT_TIMEOUT	3000	/* 3 seconds */
+#define BATADV_BLA_CRC_BUCKETS_ALL	(BIT(BATADV_BLA_CRC_BUCKETS) - 1)
+/* client addresses packed into one CLAIM_LIST frame (fits into ETH_DATA_LEN) */
+#define BATADV_BLA_CLAIM_LIST_MAX	240
 
-#define BATADV_DUPLIST_SIZE		16
+#define BATADV_DUPLIST_BUCKETS		64 /* power of 2 */
+#define BATADV_DUPLIST_WAYS		4
 #define BATADV_DUPLIST_TIMEOUT		500	/* 500 ms */
 /* don't reset again within 30 seconds */
 #define BATADV_RESET_PROTECTION_MS 30000
@@ -136,10 +243,80 @@
 
 #define BATADV_NC_NODE_TIMEOUT 10000 /* Milliseconds */
 
+/* average number of elements per bucket before a hash table is grown */
+#define BATADV_HASH_MAX_LOAD 2
+/* maximum number of buckets a hash table is grown to */
+#define BATADV_HASH_MAX_SIZE 65536
+/* default of the hash_locks_per_cpu module parameter (lock striping) */
+#define BATADV_HASH_LOCKS_PER_CPU 4
+
+/* number of buckets of the per mesh set of own hard interface addresses */
+#define BATADV_HARDIF_ADDR_BUCKETS 16
+
 /**
  * BATADV_TP_MAX_NUM - maximum number of simultaneously active tp sessions
  */
-#define BATADV_TP_MAX_NUM 5
+#define BATADV_TP_MAX_NUM 16
+
+/**
+ * BATADV_TP_MAX_STREAMS - maximum number of parallel streams of one tp meter
+ *  test. Receivers only know single streams and older ones accept at most 5
+ *  sessions, a test must fit in there next to another session
+ */
+#define BATADV_TP_MAX_STREAMS 4
+
+/**
+ * BATADV_TP_RTT_HIST_LEN - number of 1 msec buckets of the tp meter RTT
+ *  histogram. The last bucket collects all longer RTT samples
+ */
+#define BATADV_TP_RTT_HIST_LEN 256
+
+/**
+ * BATADV_TP_SACK_BLOCKS - maximum number of selective acknowledgment blocks
+ *  appended to a tp meter ACK
+ */
+#define BATADV_TP_SACK_BLOCKS 4
+
+/**
+ * BATADV_PING_MAX_NUM - maximum number of simultaneously running ping batches
+ */
+#define BATADV_PING_MAX_NUM 8
+
+/**
+ * BATADV_PING_MAX_PROBES - maximum number of echo requests of one ping batch
+ */
+#define BATADV_PING_MAX_PROBES 4096
+
+/**
+ * BATADV_PING_DEF_TIMEOUT - default time in milliseconds to wait for the
+ *  replies of a ping batch
+ */
+#define BATADV_PING_DEF_TIMEOUT 1000
+
+/**
+ * BATADV_PING_MAX_TIMEOUT - maximum time in milliseconds to wait for the
+ *  replies of a ping batch
+ */
+#define BATADV_PING_MAX_TIMEOUT 30000
+
+/**
+ * BATADV_OFFLOAD_STABLE_TIME - default time in milliseconds the route towards
+ *  a client must not have changed before it is offered for offloading
+ */
+#define BATADV_OFFLOAD_STABLE_TIME 10000
+
+/**
+ * BATADV_PRIO_CONTROL - skb priority of the mesh management frames, 802.1d
+ *  network control (AC_VO on WMM links) which also puts them in the first
+ *  band of pfifo_fast
+ */
+#define BATADV_PRIO_CONTROL (256 + 7)
+
+/**
+ * BATADV_ICMP_UID_PING - ICMP uid of the echo requests of ping batches, the
+ *  icmp sockets only use the uids below it
+ */
+#define BATADV_ICMP_UID_PING 255
 
 /**
  * enum batadv_mesh_state - State of a soft interface
@@ -158,6 +335,12 @@ enum batadv_mesh_state {
 #define BATADV_BCAST_QUEUE_LEN		256
 #define BATADV_BATMAN_QUEUE_LEN	256
 
+/* packets queued on another CPU by the originator steering before they are
+ * processed on the receiving CPU again
+ */
+#define BATADV_RX_BACKLOG_LEN		1000
+#define BATADV_RX_BACKLOG_BUDGET	64
+
 /**
  * enum batadv_uev_action - action type of uevent
  */
@@ -196,8 +379,15 @@ enum batadv_uev_type {
 
 #define BATADV_GW_THRESHOLD	50
 
-/* Number of fragment chains for each orig_node */
+/* maximum number of gateways the DHCP clients can be spread across */
+#define BATADV_GW_BALANCE_MAX	8
+
+/* Initial number of fragment chains for each orig_node */
 #define BATADV_FRAG_BUFFER_COUNT 8
+/* Maximum number of fragment chains for each orig_node */
+#define BATADV_FRAG_BUFFER_MAX 64
+/* Maximum memory used to buffer fragments of all originators of a mesh */
+#define BATADV_FRAG_MEM_MAX (4 * 1024 * 1024)
 /* Maximum number of fragments for one packet */
 #define BATADV_FRAG_MAX_FRAGMENTS 16
 /* Maxumim size of each fragment */
@@ -222,6 +412,8 @@ enum batadv_uev_type {
 #include <linux/if_vlan.h>
 #include <linux/jiffies.h>
 #include <linux/percpu.h>
+#include <linux/skbuff.h>
+#include <linux/slab.h>
 #include <linux/types.h>
 #include <uapi/linux/batadv_packet.h>
 
@@ -249,18 +441,27 @@ static inline int batadv_print_vid(unsigned short vid)
 extern struct list_head batadv_hardif_list;
 
 extern unsigned char batadv_broadcast_addr[];
+
+/* workqueue for tasks which are not bound to a single mesh interface, the
+ * periodic tasks of a mesh run on &batadv_priv.event_wq
+ */
 extern struct workqueue_struct *batadv_event_workqueue;
 
 int batadv_mesh_init(struct net_device *soft_iface);
 void batadv_mesh_free(struct net_device *soft_iface);
+void batadv_mesh_set_numa_node(struct batadv_priv *bat_priv, int node);
 bool batadv_is_my_mac(struct batadv_priv *bat_priv, const u8 *addr);
 struct batadv_hard_iface *
 batadv_seq_print_text_primary_if_get(struct seq_file *seq);
 int batadv_max_header_len(void);
 void batadv_skb_set_priority(struct sk_buff *skb, int offset);
+void batadv_skb_set_flow_hash(struct sk_buff *skb, int offset);
 int batadv_batman_skb_recv(struct sk_buff *skb, struct net_device *dev,
 			   struct packet_type *ptype,
 			   struct net_device *orig_dev);
+void batadv_rx_backlog_flush(void);
+void batadv_recv_handler_call(struct sk_buff *skb,
+			      struct batadv_hard_iface *hard_iface);
 int
 batadv_recv_handler_register(u8 packet_type,
 			     int (*recv_handler)(struct sk_buff *,
@@ -359,6 +560,21 @@ static inline bool batadv_has_timed_out(unsigned long timestamp,
  */
 #define batadv_seq_after(x, y) batadv_seq_before(y, x)
 
+/**
+ * batadv_cache_zalloc() - Allocate a zeroed object on the NUMA node of a mesh
+ * @bat_priv: the bat priv with all the soft interface information
+ * @cache: slab cache to allocate the object from
+ * @flags: the type of memory to allocate
+ *
+ * Return: the new object or NULL on errors
+ */
+static inline void *batadv_cache_zalloc(struct batadv_priv *bat_priv,
+					struct kmem_cache *cache, gfp_t flags)
+{
+	return kmem_cache_alloc_node(cache, flags | __GFP_ZERO,
+				     READ_ONCE(bat_priv->numa_node));
+}
+
 /**
  * batadv_add_counter() - Add to per cpu statistics counter of soft interface
  * @bat_priv: the bat priv with all the soft interface information
@@ -391,6 +607,30 @@ static inline void batadv_add_counter(struct batadv_priv *bat_priv, size_t idx,
  */
 #define BATADV_SKB_CB(__skb)       ((struct batadv_skb_cb *)&((__skb)->cb[0]))
 
+/**
+ * batadv_skb_cb_classified() - get the cached classification of a frame
+ * @skb: the buffer containing the frame
+ * @header_len: offset of the ethernet header of the frame in skb->data
+ *
+ * Return: the control buffer filled by batadv_skb_classify() if it describes
+ * the ethernet header at @header_len, NULL otherwise
+ */
+static inline struct batadv_skb_cb *
+batadv_skb_cb_classified(struct sk_buff *skb, size_t header_len)
+{
+	struct batadv_skb_cb *cb = BATADV_SKB_CB(skb);
+
+	if (!cb->classified)
+		return NULL;
+
+	if (skb->data + header_len != skb_mac_header(skb))
+		return NULL;
+
+	return cb;
+}
+
+void batadv_skb_classify(struct sk_buff *skb);
+
 unsigned short batadv_get_vid(struct sk_buff *skb, size_t header_len);
 bool batadv_vlan_ap_isola_get(struct batadv_priv *bat_priv, unsigned short vid);
 
@@ -21,11 +21,15 @@
 
 #include <linux/atomic.h>
 #include <linux/bitops.h>
+#include <linux/bottom_half.h>
 #include <linux/bug.h>
 #include <linux/byteorder/generic.h>
+#include <linux/compiler.h>
 #include <linux/errno.h>
 #include <linux/etherdevice.h>
 #include <linux/gfp.h>
+#include <linux/hash.h>
+#include <linux/hashtable.h>
 #include <linux/icmpv6.h>
 #include <linux/if_bridge.h>
 #include <linux/if_ether.h>
@@ -34,6 +38,7 @@
 #include <linux/in6.h>
 #include <linux/ip.h>
 #include <linux/ipv6.h>
+#include <linux/jhash.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
 #include <linux/kref.h>
@@ -41,6 +46,7 @@
 #include <linux/lockdep.h>
 #include <linux/netdevice.h>
 #include <linux/netlink.h>
+#include <linux/percpu.h>
 #include <linux/printk.h>
 #include <linux/rculist.h>
 #include <linux/rcupdate.h>
@@ -66,6 +72,7 @@
 #include "hash.h"
 #include "log.h"
 #include "netlink.h"
+#include "send.h"
 #include "soft-interface.h"
 #include "translation-table.h"
 #include "tvlv.h"
@@ -78,8 +85,28 @@ static void batadv_mcast_mla_update(struct work_struct *work);
  */
 static void batadv_mcast_start_timer(struct batadv_priv *bat_priv)
 {
-	queue_delayed_work(batadv_event_workqueue, &bat_priv->mcast.work,
-			   msecs_to_jiffies(BATADV_MCAST_WORK_PERIOD));
+	unsigned int period = READ_ONCE(bat_priv->mcast.work_period);
+
+	queue_delayed_work(bat_priv->event_wq, &bat_priv->mcast.work,
+			   msecs_to_jiffies(period));
+}
+
+/**
+ * batadv_mcast_mla_trigger() - schedule an update of the own MLAs soon
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * Called when the multicast listeners of the soft interface or the bridge on
+ * top of it may have changed, so that they don't have to wait for the next
+ * periodic update. Can be called from atomic context.
+ */
+void batadv_mcast_mla_trigger(struct batadv_priv *bat_priv)
+{
+	if (atomic_read(&bat_priv->mesh_state) != BATADV_MESH_ACTIVE)
+		return;
+
+	WRITE_ONCE(bat_priv->mcast.work_period, BATADV_MCAST_WORK_PERIOD);
+	mod_delayed_work(bat_priv->event_wq, &bat_priv->mcast.work,
+			 msecs_to_jiffies(BATADV_MCAST_TRIGGER_DELAY));
 }
 
 /**
@@ -136,11 +163,43 @@ static bool batadv_mcast_addr_is_ipv6(const u8 *addr)
 	return memcmp(prefix, addr, sizeof(prefix)) == 0;
 }
 
+/* number of buckets of a hashed set of multicast addresses */
+#define BATADV_MCAST_MLA_BUCKETS (1 << BATADV_MCAST_MLA_HASH_BITS)
+
+/**
+ * batadv_mcast_mla_bucket() - get the bucket of a multicast address
+ * @mcast_list: the hashed set of multicast addresses
+ * @mcast_addr: the multicast address
+ *
+ * Return: the bucket of @mcast_list which holds @mcast_addr if present
+ */
+static struct hlist_head *batadv_mcast_mla_bucket(struct hlist_head *mcast_list,
+						  const u8 *mcast_addr)
+{
+	u32 key = jhash(mcast_addr, ETH_ALEN, 0);
+
+	return &mcast_list[hash_32(key, BATADV_MCAST_MLA_HASH_BITS)];
+}
+
+/**
+ * batadv_mcast_mla_list_add() - add an entry to a set of multicast addresses
+ * @mcast_list: the hashed set of multicast addresses
+ * @mcast_entry: the entry to add
+ */
+static void batadv_mcast_mla_list_add(struct hlist_head *mcast_list,
+				      struct batadv_hw_addr *mcast_entry)
+{
+	struct hlist_head *head;
+
+	head = batadv_mcast_mla_bucket(mcast_list, mcast_entry->addr);
+	hlist_add_head(&mcast_entry->list, head);
+}
+
 /**
  * batadv_mcast_mla_softif_get() - get softif multicast listeners
  * @bat_priv: the bat priv with all the soft interface information
  * @dev: the device to collect multicast addresses from
- * @mcast_list: a list to put found addresses into
+ * @mcast_list: a hashed set to put found addresses into
  *
  * Collects multicast addresses of multicast listeners residing
  * on this kernel on the given soft interface, dev, in
@@ -181,7 +240,7 @@ static int batadv_mcast_mla_softif_get(struct batadv_priv *bat_priv,
 		}
 
 		ether_addr_copy(new->addr, mc_list_entry->addr);
-		hlist_add_head(&new->list, mcast_list);
+		batadv_mcast_mla_list_add(mcast_list, new);
 		ret++;
 	}
 	netif_addr_unlock_bh(bridge ? bridge : dev);
@@ -193,19 +252,21 @@ static int batadv_mcast_mla_softif_get(struct batadv_priv *bat_priv,
 }
 
 /**
- * batadv_mcast_mla_is_duplicate() - check whether an address is in a list
+ * batadv_mcast_mla_is_duplicate() - check whether an address is in a set
  * @mcast_addr: the multicast address to check
- * @mcast_list: the list with multicast addresses to search in
+ * @mcast_list: the hashed set with multicast addresses to search in
  *
- * Return: true if the given address is already in the given list.
+ * Return: true if the given address is already in the given set.
  * Otherwise returns false.
  */
 static bool batadv_mcast_mla_is_duplicate(u8 *mcast_addr,
 					  struct hlist_head *mcast_list)
 {
 	struct batadv_hw_addr *mcast_entry;
+	struct hlist_head *head;
 
-	hlist_for_each_entry(mcast_entry, mcast_list, list)
+	head = batadv_mcast_mla_bucket(mcast_list, mcast_addr);
+	hlist_for_each_entry(mcast_entry, head, list)
 		if (batadv_compare_eth(mcast_entry->addr, mcast_addr))
 			return true;
 
@@ -240,7 +301,7 @@ static void batadv_mcast_mla_br_addr_cpy(char *dst, const struct br_ip *src)
  * batadv_mcast_mla_bridge_get() - get bridged-in multicast listeners
  * @bat_priv: the bat priv with all the soft interface information
  * @dev: a bridge slave whose bridge to collect multicast addresses from
- * @mcast_list: a list to put found addresses into
+ * @mcast_list: a hashed set to put found addresses into
  *
  * Collects multicast addresses of multicast listeners residing
  * on foreign, non-mesh devices which we gave access to our mesh via
@@ -287,7 +348,7 @@ static int batadv_mcast_mla_bridge_get(struct batadv_priv *bat_priv,
 		}
 
 		ether_addr_copy(new->addr, mcast_addr);
-		hlist_add_head(&new->list, mcast_list);
+		batadv_mcast_mla_list_add(mcast_list, new);
 	}
 
 out:
@@ -300,8 +361,8 @@ out:
 }
 
 /**
- * batadv_mcast_mla_list_free() - free a list of multicast addresses
- * @mcast_list: the list to free
+ * batadv_mcast_mla_list_free() - free a set of multicast addresses
+ * @mcast_list: the hashed set to free
  *
  * Removes and frees all items in the given mcast_list.
  */
@@ -309,35 +370,41 @@ static void batadv_mcast_mla_list_free(struct hlist_head *mcast_list)
 {
 	struct batadv_hw_addr *mcast_entry;
 	struct hlist_node *tmp;
+	u32 i;
 
-	hlist_for_each_entry_safe(mcast_entry, tmp, mcast_list, list) {
-		hlist_del(&mcast_entry->list);
-		kfree(mcast_entry);
+	for (i = 0; i < BATADV_MCAST_MLA_BUCKETS; i++) {
+		hlist_for_each_entry_safe(mcast_entry, tmp, &mcast_list[i],
+					  list) {
+			hlist_del(&mcast_entry->list);
+			kfree(mcast_entry);
+		}
 	}
 }
 
 /**
  * batadv_mcast_mla_tt_retract() - clean up multicast listener announcements
  * @bat_priv: the bat priv with all the soft interface information
- * @mcast_list: a list of addresses which should _not_ be removed
+ * @mcast_list: a hashed set of addresses which should _not_ be removed
  *
  * Retracts the announcement of any multicast listener from the
- * translation table except the ones listed in the given mcast_list.
+ * translation table except the ones contained in the given mcast_list.
  *
  * If mcast_list is NULL then all are retracted.
  *
  * Do not call outside of the mcast worker! (or cancel mcast worker first)
+ *
+ * Return: the number of retracted announcements
  */
-static void batadv_mcast_mla_tt_retract(struct batadv_priv *bat_priv,
-					struct hlist_head *mcast_list)
+static int batadv_mcast_mla_tt_retract(struct batadv_priv *bat_priv,
+				       struct hlist_head *mcast_list)
 {
 	struct batadv_hw_addr *mcast_entry;
 	struct hlist_node *tmp;
+	int retracted = 0;
+	int bkt;
 
-	WARN_ON(delayed_work_pending(&bat_priv->mcast.work));
-
-	hlist_for_each_entry_safe(mcast_entry, tmp, &bat_priv->mcast.mla_list,
-				  list) {
+	hash_for_each_safe(bat_priv->mcast.mla_list, bkt, tmp, mcast_entry,
+			   list) {
 		if (mcast_list &&
 		    batadv_mcast_mla_is_duplicate(mcast_entry->addr,
 						  mcast_list))
@@ -349,43 +416,57 @@ static void batadv_mcast_mla_tt_retract(struct batadv_priv *bat_priv,
 
 		hlist_del(&mcast_entry->list);
 		kfree(mcast_entry);
+		retracted++;
 	}
+
+	return retracted;
 }
 
 /**
  * batadv_mcast_mla_tt_add() - add multicast listener announcements
  * @bat_priv: the bat priv with all the soft interface information
- * @mcast_list: a list of addresses which are going to get added
+ * @mcast_list: a hashed set of addresses which are going to get added
  *
  * Adds multicast listener announcements from the given mcast_list to the
  * translation table if they have not been added yet.
  *
  * Do not call outside of the mcast worker! (or cancel mcast worker first)
+ *
+ * Return: the number of added announcements
  */
-static void batadv_mcast_mla_tt_add(struct batadv_priv *bat_priv,
-				    struct hlist_head *mcast_list)
+static int batadv_mcast_mla_tt_add(struct batadv_priv *bat_priv,
+				   struct hlist_head *mcast_list)
 {
+	struct hlist_head *mla_list = bat_priv->mcast.mla_list;
 	struct batadv_hw_addr *mcast_entry;
 	struct hlist_node *tmp;
-
-	WARN_ON(delayed_work_pending(&bat_priv->mcast.work));
+	int added = 0;
+	u32 i;
 
 	if (!mcast_list)
-		return;
+		return 0;
 
-	hlist_for_each_entry_safe(mcast_entry, tmp, mcast_list, list) {
-		if (batadv_mcast_mla_is_duplicate(mcast_entry->addr,
-						  &bat_priv->mcast.mla_list))
-			continue;
+	for (i = 0; i < BATADV_MCAST_MLA_BUCKETS; i++) {
+		hlist_for_each_entry_safe(mcast_entry, tmp, &mcast_list[i],
+					  list) {
+			if (batadv_mcast_mla_is_duplicate(mcast_entry->addr,
+							  mla_list))
+				continue;
 
-		if (!batadv_tt_local_add(bat_priv->soft_iface,
-					 mcast_entry->addr, BATADV_NO_FLAGS,
-					 BATADV_NULL_IFINDEX, BATADV_NO_MARK))
-			continue;
+			if (!batadv_tt_local_add(bat_priv->soft_iface,
+						 mcast_entry->addr,
+						 BATADV_NO_FLAGS,
+						 BATADV_NULL_IFINDEX,
+						 BATADV_NO_MARK))
+				continue;
 
-		hlist_del(&mcast_entry->list);
-		hlist_add_head(&mcast_entry->list, &bat_priv->mcast.mla_list);
+			hlist_del(&mcast_entry->list);
+			batadv_mcast_mla_list_add(mla_list, mcast_entry);
+			added++;
+		}
 	}
+
+	return added;
 }
 
 /**
@@ -613,30 +694,45 @@ update:
  * in batadv_mcast_mla_tt_retract() and batadv_mcast_mla_tt_add() are
  * ensured by the non-parallel execution of the worker this function
  * belongs to.
+ *
+ * Return: true if the announced flags or listeners changed, false otherwise
  */
-static void __batadv_mcast_mla_update(struct batadv_priv *bat_priv)
+static bool __batadv_mcast_mla_update(struct batadv_priv *bat_priv)
 {
 	struct net_device *soft_iface = bat_priv->soft_iface;
-	struct hlist_head mcast_list = HLIST_HEAD_INIT;
+	DECLARE_HASHTABLE(mcast_list, BATADV_MCAST_MLA_HASH_BITS);
+	bool enabled = bat_priv->mcast.enabled;
+	u8 flags = bat_priv->mcast.flags;
+	bool changed = false;
 	int ret;
 
+	hash_init(mcast_list);
+
 	if (!batadv_mcast_mla_tvlv_update(bat_priv))
 		goto update;
 
-	ret = batadv_mcast_mla_softif_get(bat_priv, soft_iface, &mcast_list);
+	ret = batadv_mcast_mla_softif_get(bat_priv, soft_iface, mcast_list);
 	if (ret < 0)
 		goto out;
 
-	ret = batadv_mcast_mla_bridge_get(bat_priv, soft_iface, &mcast_list);
+	ret = batadv_mcast_mla_bridge_get(bat_priv, soft_iface, mcast_list);
 	if (ret < 0)
 		goto out;
 
 update:
-	batadv_mcast_mla_tt_retract(bat_priv, &mcast_list);
-	batadv_mcast_mla_tt_add(bat_priv, &mcast_list);
+	if (batadv_mcast_mla_tt_retract(bat_priv, mcast_list))
+		changed = true;
+
+	if (batadv_mcast_mla_tt_add(bat_priv, mcast_list))
+		changed = true;
 
 out:
-	batadv_mcast_mla_list_free(&mcast_list);
+	batadv_mcast_mla_list_free(mcast_list);
+
+	if (!enabled || flags != bat_priv->mcast.flags)
+		changed = true;
+
+	return changed;
 }
 
 /**
@@ -646,19 +742,29 @@ out:
  * Updates the own multicast listener announcements in the translation
  * table as well as the own, announced multicast tvlv container.
  *
- * In the end, reschedules the work timer.
+ * In the end, reschedules the work timer. The interval is doubled up to
+ * BATADV_MCAST_WORK_PERIOD_MAX while nothing changes. Changes of the
+ * listeners which are noticed directly shorten it again via
+ * batadv_mcast_mla_trigger().
  */
 static void batadv_mcast_mla_update(struct work_struct *work)
 {
 	struct delayed_work *delayed_work;
 	struct batadv_priv_mcast *priv_mcast;
 	struct batadv_priv *bat_priv;
+	unsigned int period;
 
 	delayed_work = to_delayed_work(work);
 	priv_mcast = container_of(delayed_work, struct batadv_priv_mcast, work);
 	bat_priv = container_of(priv_mcast, struct batadv_priv, mcast);
 
-	__batadv_mcast_mla_update(bat_priv);
+	if (__batadv_mcast_mla_update(bat_priv))
+		period = BATADV_MCAST_WORK_PERIOD;
+	else
+		period = min_t(unsigned int, priv_mcast->work_period * 2,
+			       BATADV_MCAST_WORK_PERIOD_MAX);
+
+	WRITE_ONCE(priv_mcast->work_period, period);
 	batadv_mcast_start_timer(bat_priv);
 }
 
@@ -704,14 +810,21 @@ static int batadv_mcast_forw_mode_check_ipv4(struct batadv_priv *bat_priv,
 					     struct sk_buff *skb,
 					     bool *is_unsnoopable)
 {
+	struct batadv_skb_cb *cb;
 	struct iphdr *iphdr;
 
+	cb = batadv_skb_cb_classified(skb, 0);
+
 	/* We might fail due to out-of-memory -> drop it */
-	if (!pskb_may_pull(skb, sizeof(struct ethhdr) + sizeof(*iphdr)))
+	if ((!cb || !cb->transport_offset) &&
+	    !pskb_may_pull(skb, sizeof(struct ethhdr) + sizeof(*iphdr)))
 		return -ENOMEM;
 
-	if (batadv_mcast_is_report_ipv4(skb))
+	/* the bridge may have learned a new listener from it */
+	if (batadv_mcast_is_report_ipv4(skb)) {
+		batadv_mcast_mla_trigger(bat_priv);
 		return -EINVAL;
+	}
 
 	iphdr = ip_hdr(skb);
 
@@ -769,14 +882,21 @@ static int batadv_mcast_forw_mode_check_ipv6(struct batadv_priv *bat_priv,
 					     struct sk_buff *skb,
 					     bool *is_unsnoopable)
 {
+	struct batadv_skb_cb *cb;
 	struct ipv6hdr *ip6hdr;
 
+	cb = batadv_skb_cb_classified(skb, 0);
+
 	/* We might fail due to out-of-memory -> drop it */
-	if (!pskb_may_pull(skb, sizeof(struct ethhdr) + sizeof(*ip6hdr)))
+	if ((!cb || !cb->transport_offset) &&
+	    !pskb_may_pull(skb, sizeof(struct ethhdr) + sizeof(*ip6hdr)))
 		return -ENOMEM;
 
-	if (batadv_mcast_is_report_ipv6(skb))
+	/* the bridge may have learned a new listener from it */
+	if (batadv_mcast_is_report_ipv6(skb)) {
+		batadv_mcast_mla_trigger(bat_priv);
 		return -EINVAL;
+	}
 
 	ip6hdr = ipv6_hdr(skb);
 
@@ -854,6 +974,75 @@ static int batadv_mcast_forw_want_all_ip_count(struct batadv_priv *bat_priv,
 	}
 }
 
+/**
+ * batadv_mcast_forw_cache_entry() - get the per-CPU cache slot of a group
+ * @bat_priv: the bat priv with all the soft interface information
+ * @addr: the multicast destination MAC address
+ *
+ * Has to be called with bottom halves disabled.
+ *
+ * Return: the slot of the current CPU the group is cached in
+ */
+static struct batadv_mcast_forw_cache_entry *
+batadv_mcast_forw_cache_entry(struct batadv_priv *bat_priv, const u8 *addr)
+{
+	u32 index = jhash(addr, ETH_ALEN, 0) % BATADV_MCAST_CACHE_SIZE;
+
+	return &this_cpu_ptr(bat_priv->mcast.forw_cache)->entries[index];
+}
+
+/**
+ * batadv_mcast_forw_tt_count() - count the originators announcing a group
+ * @bat_priv: the bat priv with all the soft interface information
+ * @ethhdr: the ether header containing the multicast destination
+ *
+ * The count only changes together with the orig list of the matching global
+ * TT entry, which invalidates the TT lookup cache. Steady multicast streams
+ * therefore usually get the count from a per-CPU cache validated against
+ * tt.tx_cache_gen instead of searching the global table for every frame.
+ * Unused slots never match as their address is not a multicast one.
+ *
+ * Return: the number of originators announcing the multicast destination
+ * via TT (excluding ourself).
+ */
+static int batadv_mcast_forw_tt_count(struct batadv_priv *bat_priv,
+				      struct ethhdr *ethhdr)
+{
+	struct batadv_mcast_forw_cache_entry *entry;
+	int tt_count = -1;
+	u32 gen;
+
+	if (!bat_priv->mcast.forw_cache)
+		return batadv_tt_global_hash_count(bat_priv, ethhdr->h_dest,
+						   BATADV_NO_FLAGS);
+
+	/* changes done during the lookup have to invalidate its result */
+	gen = (u32)atomic_read(&bat_priv->tt.tx_cache_gen);
+	smp_rmb();
+
+	local_bh_disable();
+	entry = batadv_mcast_forw_cache_entry(bat_priv, ethhdr->h_dest);
+	if (entry->tt_gen == gen &&
+	    batadv_compare_eth(entry->addr, ethhdr->h_dest))
+		tt_count = entry->tt_count;
+	local_bh_enable();
+
+	if (tt_count >= 0)
+		return tt_count;
+
+	tt_count = batadv_tt_global_hash_count(bat_priv, ethhdr->h_dest,
+					       BATADV_NO_FLAGS);
+
+	local_bh_disable();
+	entry = batadv_mcast_forw_cache_entry(bat_priv, ethhdr->h_dest);
+	ether_addr_copy(entry->addr, ethhdr->h_dest);
+	entry->tt_gen = gen;
+	entry->tt_count = tt_count;
+	local_bh_enable();
+
+	return tt_count;
+}
+
 /**
  * batadv_mcast_forw_tt_node_get() - get a multicast tt node
  * @bat_priv: the bat priv with all the soft interface information
@@ -989,7 +1178,7 @@ enum batadv_forw_mode
 batadv_mcast_forw_mode(struct batadv_priv *bat_priv, struct sk_buff *skb,
 		       struct batadv_orig_node **orig)
 {
-	int ret, tt_count, ip_count, unsnoop_count, total_count;
+	int ret, tt_count, ip_count, unsnoop_count, total_count, mcast_fanout;
 	bool is_unsnoopable = false;
 	struct ethhdr *ethhdr;
 
@@ -1001,8 +1190,7 @@ batadv_mcast_forw_mode(struct batadv_priv *bat_priv, struct sk_buff *skb,
 
 	ethhdr = eth_hdr(skb);
 
-	tt_count = batadv_tt_global_hash_count(bat_priv, ethhdr->h_dest,
-					       BATADV_NO_FLAGS);
+	tt_count = batadv_mcast_forw_tt_count(bat_priv, ethhdr);
 	ip_count = batadv_mcast_forw_want_all_ip_count(bat_priv, ethhdr);
 	unsnoop_count = !is_unsnoopable ? 0 :
 			atomic_read(&bat_priv->mcast.num_want_all_unsnoopables);
@@ -1025,8 +1213,232 @@ batadv_mcast_forw_mode(struct batadv_priv *bat_priv, struct sk_buff *skb,
 	case 0:
 		return BATADV_FORW_NONE;
 	default:
-		return BATADV_FORW_ALL;
+		mcast_fanout = atomic_read(&bat_priv->multicast_fanout);
+
+		/* unsnoopable listeners can't be enumerated by the
+		 * multicast-to-unicast conversion
+		 */
+		if (!unsnoop_count && total_count <= mcast_fanout)
+			return BATADV_FORW_SOME;
 	}
+
+	return BATADV_FORW_ALL;
+}
+
+/**
+ * batadv_mcast_want_all_ip_flag() - get the want-all flag matching a packet
+ * @ethhdr: an ethernet header to determine the protocol family from
+ *
+ * Return: BATADV_MCAST_WANT_ALL_IPV4 or BATADV_MCAST_WANT_ALL_IPV6 depending
+ * on the provided ethhdr or 0 for any other protocol.
+ */
+static u8 batadv_mcast_want_all_ip_flag(struct ethhdr *ethhdr)
+{
+	switch (ntohs(ethhdr->h_proto)) {
+	case ETH_P_IP:
+		return BATADV_MCAST_WANT_ALL_IPV4;
+	case ETH_P_IPV6:
+		return BATADV_MCAST_WANT_ALL_IPV6;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * batadv_mcast_forw_tt() - forwards a packet to multicast listeners
+ * @bat_priv: the bat priv with all the soft interface information
+ * @skb: the multicast packet to transmit
+ * @vid: the vlan identifier
+ *
+ * Sends copies of a frame with multicast destination to any multicast
+ * listener registered in the translation table. A transmission is performed
+ * via a batman-adv unicast packet for each such destination node. Nodes
+ * which want all multicast traffic of the packet's protocol family are
+ * skipped, they are served by batadv_mcast_forw_want_all().
+ *
+ * Return: NET_XMIT_DROP on memory allocation failure, NET_XMIT_SUCCESS
+ * otherwise.
+ */
+static int
+batadv_mcast_forw_tt(struct batadv_priv *bat_priv, struct sk_buff *skb,
+		     unsigned short vid)
+{
+	u8 want_all_flag = batadv_mcast_want_all_ip_flag(eth_hdr(skb));
+	const u8 *addr = eth_hdr(skb)->h_dest;
+	struct batadv_tt_orig_list_entry *orig_entry;
+	struct batadv_tt_global_entry *tt_global;
+	struct batadv_orig_node *orig_node;
+	int ret = NET_XMIT_SUCCESS;
+	struct sk_buff *newskb;
+
+	tt_global = batadv_tt_global_hash_find(bat_priv, addr,
+					       BATADV_NO_FLAGS);
+	if (!tt_global)
+		goto out;
+
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(orig_entry, &tt_global->orig_list, list) {
+		orig_node = orig_entry->orig_node;
+		if (orig_node->mcast_flags & want_all_flag)
+			continue;
+
+		newskb = skb_copy(skb, GFP_ATOMIC);
+		if (!newskb) {
+			ret = NET_XMIT_DROP;
+			break;
+		}
+
+		batadv_send_skb_unicast(bat_priv, newskb, BATADV_UNICAST, 0,
+					orig_node, vid);
+	}
+	rcu_read_unlock();
+
+	batadv_tt_global_entry_put(tt_global);
+
+out:
+	return ret;
+}
+
+/**
+ * batadv_mcast_forw_want_all_ipv4() - forward to nodes with want-all-ipv4
+ * @bat_priv: the bat priv with all the soft interface information
+ * @skb: the multicast packet to transmit
+ * @vid: the vlan identifier
+ *
+ * Sends copies of a frame with multicast destination to any node with a
+ * BATADV_MCAST_WANT_ALL_IPV4 flag set. A transmission is performed via a
+ * batman-adv unicast packet for each such destination node.
+ *
+ * Return: NET_XMIT_DROP on memory allocation failure, NET_XMIT_SUCCESS
+ * otherwise.
+ */
+static int
+batadv_mcast_forw_want_all_ipv4(struct batadv_priv *bat_priv,
+				struct sk_buff *skb, unsigned short vid)
+{
+	struct batadv_orig_node *orig_node;
+	int ret = NET_XMIT_SUCCESS;
+	struct sk_buff *newskb;
+
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(orig_node,
+				 &bat_priv->mcast.want_all_ipv4_list,
+				 mcast_want_all_ipv4_node) {
+		newskb = skb_copy(skb, GFP_ATOMIC);
+		if (!newskb) {
+			ret = NET_XMIT_DROP;
+			break;
+		}
+
+		batadv_send_skb_unicast(bat_priv, newskb, BATADV_UNICAST, 0,
+					orig_node, vid);
+	}
+	rcu_read_unlock();
+	return ret;
+}
+
+/**
+ * batadv_mcast_forw_want_all_ipv6() - forward to nodes with want-all-ipv6
+ * @bat_priv: the bat priv with all the soft interface information
+ * @skb: The multicast packet to transmit
+ * @vid: the vlan identifier
+ *
+ * Sends copies of a frame with multicast destination to any node with a
+ * BATADV_MCAST_WANT_ALL_IPV6 flag set. A transmission is performed via a
+ * batman-adv unicast packet for each such destination node.
+ *
+ * Return: NET_XMIT_DROP on memory allocation failure, NET_XMIT_SUCCESS
+ * otherwise.
+ */
+static int
+batadv_mcast_forw_want_all_ipv6(struct batadv_priv *bat_priv,
+				struct sk_buff *skb, unsigned short vid)
+{
+	struct batadv_orig_node *orig_node;
+	int ret = NET_XMIT_SUCCESS;
+	struct sk_buff *newskb;
+
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(orig_node,
+				 &bat_priv->mcast.want_all_ipv6_list,
+				 mcast_want_all_ipv6_node) {
+		newskb = skb_copy(skb, GFP_ATOMIC);
+		if (!newskb) {
+			ret = NET_XMIT_DROP;
+			break;
+		}
+
+		batadv_send_skb_unicast(bat_priv, newskb, BATADV_UNICAST, 0,
+					orig_node, vid);
+	}
+	rcu_read_unlock();
+	return ret;
+}
+
+/**
+ * batadv_mcast_forw_want_all() - forward packet to nodes in a want-all list
+ * @bat_priv: the bat priv with all the soft interface information
+ * @skb: the multicast packet to transmit
+ * @vid: the vlan identifier
+ *
+ * Sends copies of a frame with multicast destination to any node with a
+ * BATADV_MCAST_WANT_ALL_IPV4 or BATADV_MCAST_WANT_ALL_IPV6 flag set. A
+ * transmission is performed via a batman-adv unicast packet for each such
+ * destination node.
+ *
+ * Return: NET_XMIT_DROP on memory allocation failure or if the protocol family
+ * is neither IPv4 nor IPv6. NET_XMIT_SUCCESS otherwise.
+ */
+static int
+batadv_mcast_forw_want_all(struct batadv_priv *bat_priv,
+			   struct sk_buff *skb, unsigned short vid)
+{
+	switch (ntohs(eth_hdr(skb)->h_proto)) {
+	case ETH_P_IP:
+		return batadv_mcast_forw_want_all_ipv4(bat_priv, skb, vid);
+	case ETH_P_IPV6:
+		return batadv_mcast_forw_want_all_ipv6(bat_priv, skb, vid);
+	default:
+		/* we shouldn't be here... */
+		return NET_XMIT_DROP;
+	}
+}
+
+/**
+ * batadv_mcast_forw_send() - send packet to any detected multicast recipient
+ * @bat_priv: the bat priv with all the soft interface information
+ * @skb: the multicast packet to transmit
+ * @vid: the vlan identifier
+ *
+ * Sends copies of a frame with multicast destination to any node that signaled
+ * interest in it, that is either via the translation table or the according
+ * want-all flags. A transmission is performed via a batman-adv unicast packet
+ * for each such destination node.
+ *
+ * The given skb is consumed/freed.
+ *
+ * Return: NET_XMIT_DROP on memory allocation failure or if the protocol family
+ * is neither IPv4 nor IPv6. NET_XMIT_SUCCESS otherwise.
+ */
+int batadv_mcast_forw_send(struct batadv_priv *bat_priv, struct sk_buff *skb,
+			   unsigned short vid)
+{
+	int ret;
+
+	ret = batadv_mcast_forw_tt(bat_priv, skb, vid);
+	if (ret != NET_XMIT_SUCCESS) {
+		kfree_skb(skb);
+		return ret;
+	}
+
+	ret = batadv_mcast_forw_want_all(bat_priv, skb, vid);
+	if (ret != NET_XMIT_SUCCESS) {
+		kfree_skb(skb);
+		return ret;
+	}
+
+	consume_skb(skb);
+	return ret;
 }
 
 /**
@@ -1213,15 +1625,26 @@ static void batadv_mcast_tvlv_ogm_handler(struct batadv_priv *bat_priv,
 /**
  * batadv_mcast_init() - initialize the multicast optimizations structures
  * @bat_priv: the bat priv with all the soft interface information
+ *
+ * Return: 0 on success or negative error number in case of failure.
  */
-void batadv_mcast_init(struct batadv_priv *bat_priv)
+int batadv_mcast_init(struct batadv_priv *bat_priv)
 {
+	bat_priv->mcast.work_period = BATADV_MCAST_WORK_PERIOD;
+	INIT_DELAYED_WORK(&bat_priv->mcast.work, batadv_mcast_mla_update);
+
+	bat_priv->mcast.forw_cache =
+		alloc_percpu(struct batadv_mcast_forw_cache);
+	if (!bat_priv->mcast.forw_cache)
+		return -ENOMEM;
+
 	batadv_tvlv_handler_register(bat_priv, batadv_mcast_tvlv_ogm_handler,
 				     NULL, BATADV_TVLV_MCAST, 2,
 				     BATADV_TVLV_HANDLER_OGM_CIFNOTFND);
 
-	INIT_DELAYED_WORK(&bat_priv->mcast.work, batadv_mcast_mla_update);
 	batadv_mcast_start_timer(bat_priv);
+
+	return 0;
 }
 
 #ifdef CONFIG_BATMAN_ADV_DEBUGFS
@@ -1293,10 +1716,9 @@ int batadv_mcast_flags_seq_print_text(struct seq_file *seq, void *offset)
 
 	batadv_mcast_flags_print_header(bat_priv, seq);
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-
+	for (i = 0; i < batadv_hash_size(hash); i++) {
 		rcu_read_lock();
+		head = batadv_hash_bucket_rcu(hash, i);
 		hlist_for_each_entry_rcu(orig_node, head, hash_entry) {
 			if (!test_bit(BATADV_ORIG_CAPA_HAS_MCAST,
 				      &orig_node->capa_initialized))
@@ -1406,19 +1828,23 @@ batadv_mcast_flags_dump_entry(struct sk_buff *msg, u32 portid, u32 seq,
  * @msg: buffer for the message
  * @portid: netlink port
  * @seq: Sequence number of netlink message
- * @head: bucket to dump
+ * @hash: hash to dump
+ * @bucket: bucket index to dump
  * @idx_skip: How many entries to skip
  *
  * Return: 0 or error code.
  */
 static int
 batadv_mcast_flags_dump_bucket(struct sk_buff *msg, u32 portid, u32 seq,
-			       struct hlist_head *head, long *idx_skip)
+			       struct batadv_hashtable *hash, u32 bucket,
+			       long *idx_skip)
 {
 	struct batadv_orig_node *orig_node;
+	struct hlist_head *head;
 	long idx = 0;
 
 	rcu_read_lock();
+	head = batadv_hash_bucket_rcu(hash, bucket);
 	hlist_for_each_entry_rcu(orig_node, head, hash_entry) {
 		if (!test_bit(BATADV_ORIG_CAPA_HAS_MCAST,
 			      &orig_node->capa_initialized))
@@ -1460,14 +1886,11 @@ __batadv_mcast_flags_dump(struct sk_buff *msg, u32 portid, u32 seq,
 {
 	struct batadv_hashtable *hash = bat_priv->orig_hash;
 	long bucket_tmp = *bucket;
-	struct hlist_head *head;
 	long idx_tmp = *idx;
 
-	while (bucket_tmp < hash->size) {
-		head = &hash->table[bucket_tmp];
-
-		if (batadv_mcast_flags_dump_bucket(msg, portid, seq, head,
-						   &idx_tmp))
+	while (bucket_tmp < batadv_hash_size(hash)) {
+		if (batadv_mcast_flags_dump_bucket(msg, portid, seq, hash,
+						   bucket_tmp, &idx_tmp))
 			break;
 
 		bucket_tmp++;
@@ -1570,6 +1993,9 @@ void batadv_mcast_free(struct batadv_priv *bat_priv)
 
 	/* safely calling outside of worker, as worker was canceled above */
 	batadv_mcast_mla_tt_retract(bat_priv, NULL);
+
+	free_percpu(bat_priv->mcast.forw_cache);
+	bat_priv->mcast.forw_cache = NULL;
 }
 
 /**
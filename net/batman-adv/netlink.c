@@ -20,13 +20,19 @@
 #include "main.h"
 
 #include <linux/atomic.h>
+#include <linux/bitmap.h>
+#include <linux/bitops.h>
+#include <linux/bottom_half.h>
 #include <linux/byteorder/generic.h>
 #include <linux/cache.h>
 #include <linux/errno.h>
+#include <linux/etherdevice.h>
 #include <linux/export.h>
 #include <linux/genetlink.h>
 #include <linux/gfp.h>
+#include <linux/if.h>
 #include <linux/if_ether.h>
+#include <linux/in6.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
 #include <linux/netdevice.h>
@@ -34,7 +40,10 @@
 #include <linux/printk.h>
 #include <linux/rculist.h>
 #include <linux/rcupdate.h>
+#include <linux/rtnetlink.h>
+#include <linux/sched.h>
 #include <linux/skbuff.h>
+#include <linux/slab.h>
 #include <linux/stddef.h>
 #include <linux/types.h>
 #include <net/genetlink.h>
@@ -48,8 +57,11 @@
 #include "distributed-arp-table.h"
 #include "gateway_client.h"
 #include "hard-interface.h"
+#include "log.h"
 #include "multicast.h"
+#include "network-coding.h"
 #include "originator.h"
+#include "ping.h"
 #include "soft-interface.h"
 #include "tp_meter.h"
 #include "translation-table.h"
@@ -59,10 +71,12 @@ struct genl_family batadv_netlink_family;
 /* multicast groups */
 enum batadv_netlink_multicast_groups {
 	BATADV_NL_MCGRP_TPMETER,
+	BATADV_NL_MCGRP_EVENTS,
 };
 
 static const struct genl_multicast_group batadv_netlink_mcgrps[] = {
 	[BATADV_NL_MCGRP_TPMETER] = { .name = BATADV_NL_MCAST_GROUP_TPMETER },
+	[BATADV_NL_MCGRP_EVENTS] = { .name = BATADV_NL_MCAST_GROUP_EVENTS },
 };
 
 static const struct nla_policy batadv_netlink_policy[NUM_BATADV_ATTR] = {
@@ -104,6 +118,43 @@ static const struct nla_policy batadv_netlink_policy[NUM_BATADV_ATTR] = {
 	[BATADV_ATTR_DAT_CACHE_VID]		= { .type = NLA_U16 },
 	[BATADV_ATTR_MCAST_FLAGS]		= { .type = NLA_U32 },
 	[BATADV_ATTR_MCAST_FLAGS_PRIV]		= { .type = NLA_U32 },
+	[BATADV_ATTR_TPMETER_STREAMS]		= { .type = NLA_U8 },
+	[BATADV_ATTR_TPMETER_PACKET_LEN]	= { .type = NLA_U16 },
+	[BATADV_ATTR_TPMETER_LATENCY]		= { .type = NLA_FLAG },
+	[BATADV_ATTR_TPMETER_RTT_MIN]		= { .type = NLA_U32 },
+	[BATADV_ATTR_TPMETER_RTT_AVG]		= { .type = NLA_U32 },
+	[BATADV_ATTR_TPMETER_RTT_P99]		= { .type = NLA_U32 },
+	[BATADV_ATTR_TPMETER_JITTER]		= { .type = NLA_U32 },
+	[BATADV_ATTR_TPMETER_REORDERED]		= { .type = NLA_U32 },
+	[BATADV_ATTR_STATS_NAME]		= { .type = NLA_STRING },
+	[BATADV_ATTR_STATS_VALUE]		= { .type = NLA_U64 },
+	[BATADV_ATTR_TT_GENERATION]		= { .type = NLA_U32 },
+	[BATADV_ATTR_TT_DELETED]		= { .type = NLA_FLAG },
+	[BATADV_ATTR_EVENT]			= { .type = NLA_U8 },
+	[BATADV_ATTR_DAT_CACHE_IP6ADDRESS]	= { .len = sizeof(struct in6_addr) },
+	[BATADV_ATTR_INJECT_FRAME]		= { .type = NLA_BINARY },
+	[BATADV_ATTR_INJECT_COUNT]		= { .type = NLA_U32 },
+	[BATADV_ATTR_TT_CHANGE]			= {
+		.len = sizeof(struct batadv_tvlv_tt_change)
+	},
+	[BATADV_ATTR_PATH_MTU]			= { .type = NLA_U16 },
+	[BATADV_ATTR_PING_TIMEOUT]		= { .type = NLA_U32 },
+	[BATADV_ATTR_PING_TTL]			= { .type = NLA_U8 },
+	[BATADV_ATTR_PING_TRACEROUTE]		= { .type = NLA_FLAG },
+	[BATADV_ATTR_PING_STATUS]		= { .type = NLA_U8 },
+	[BATADV_ATTR_PING_RTT]			= { .type = NLA_U32 },
+	[BATADV_ATTR_PING_RESPONDER]		= { .len = ETH_ALEN },
+	[BATADV_ATTR_OFFLOAD_STABLE]		= { .type = NLA_U32 },
+	[BATADV_ATTR_NEIGH_TX_BYTES]		= { .type = NLA_U64 },
+	[BATADV_ATTR_NEIGH_TX_PACKETS]		= { .type = NLA_U64 },
+	[BATADV_ATTR_NEIGH_TX_DROPPED]		= { .type = NLA_U64 },
+	[BATADV_ATTR_NEIGH_TX_RETRIES]		= { .type = NLA_U32 },
+	[BATADV_ATTR_NEIGH_TX_FAILED]		= { .type = NLA_U32 },
+	[BATADV_ATTR_NEIGH_UTILIZATION]		= { .type = NLA_U8 },
+	[BATADV_ATTR_NEIGH_CAPACITY]		= { .type = NLA_U32 },
+	[BATADV_ATTR_CONFIG]			= { .type = NLA_NESTED },
+	[BATADV_ATTR_CONFIG_NAME]		= { .type = NLA_STRING },
+	[BATADV_ATTR_CONFIG_VALUE]		= { .type = NLA_U32 },
 };
 
 /**
@@ -121,6 +172,29 @@ batadv_netlink_get_ifindex(const struct nlmsghdr *nlh, int attrtype)
 	return attr ? nla_get_u32(attr) : 0;
 }
 
+/**
+ * batadv_netlink_dump_check() - Flag possibly inconsistent dumps
+ * @msg: Netlink message the current dump round was written to
+ * @cb: Control block of the dump, cb->seq set to the generation of the dumped
+ *  data when the round was started
+ * @start: length of @msg before the current dump round
+ *
+ * Marks the first message of the round with NLM_F_DUMP_INTR when the
+ * generation changed since the previous round. Userspace can then restart the
+ * dump because elements might have been skipped or duplicated.
+ */
+void batadv_netlink_dump_check(struct sk_buff *msg, struct netlink_callback *cb,
+			       int start)
+{
+	struct nlmsghdr *nlh;
+
+	if (msg->len <= start)
+		return;
+
+	nlh = (struct nlmsghdr *)(msg->data + start);
+	nl_dump_check_consistent(cb, nlh);
+}
+
 /**
  * batadv_netlink_mesh_info_put() - fill in generic information about mesh
  *  interface
@@ -264,12 +338,14 @@ batadv_netlink_tp_meter_put(struct sk_buff *msg, u32 cookie)
  * @test_time: total time ot the tp_meter session
  * @total_bytes: bytes acked to the receiver
  * @cookie: cookie of tp_meter session
+ * @rtt: RTT results of the tp_meter session, NULL if none were collected
  *
  * Return: 0 on success, < 0 on error
  */
 int batadv_netlink_tpmeter_notify(struct batadv_priv *bat_priv, const u8 *dst,
 				  u8 result, u32 test_time, u64 total_bytes,
-				  u32 cookie)
+				  u32 cookie,
+				  const struct batadv_tp_rtt_summary *rtt)
 {
 	struct sk_buff *msg;
 	void *hdr;
@@ -302,6 +378,16 @@ int batadv_netlink_tpmeter_notify(struct batadv_priv *bat_priv, const u8 *dst,
 	if (nla_put(msg, BATADV_ATTR_ORIG_ADDRESS, ETH_ALEN, dst))
 		goto nla_put_failure;
 
+	if (rtt) {
+		if (nla_put_u32(msg, BATADV_ATTR_TPMETER_RTT_MIN, rtt->min) ||
+		    nla_put_u32(msg, BATADV_ATTR_TPMETER_RTT_AVG, rtt->avg) ||
+		    nla_put_u32(msg, BATADV_ATTR_TPMETER_RTT_P99, rtt->p99) ||
+		    nla_put_u32(msg, BATADV_ATTR_TPMETER_JITTER, rtt->jitter) ||
+		    nla_put_u32(msg, BATADV_ATTR_TPMETER_REORDERED,
+				rtt->reordered))
+			goto nla_put_failure;
+	}
+
 	genlmsg_end(msg, hdr);
 
 	genlmsg_multicast_netns(&batadv_netlink_family,
@@ -319,6 +405,195 @@ err_genlmsg:
 	return ret;
 }
 
+/**
+ * batadv_netlink_event_new() - Prepare a mesh state change notification
+ * @bat_priv: the bat priv with all the soft interface information
+ * @event: type of the state change
+ * @hdr: returns the genetlink header of the message
+ *
+ * Return: new message with the common attributes or NULL when nobody listens
+ *  to the events multicast group or no memory is available
+ */
+static struct sk_buff *
+batadv_netlink_event_new(struct batadv_priv *bat_priv,
+			 enum batadv_nl_event event, void **hdr)
+{
+	struct net_device *soft_iface = bat_priv->soft_iface;
+	struct sk_buff *msg;
+
+	if (!genl_has_listeners(&batadv_netlink_family, dev_net(soft_iface),
+				BATADV_NL_MCGRP_EVENTS))
+		return NULL;
+
+	msg = genlmsg_new(BATADV_NL_EVENT_SIZE, GFP_ATOMIC);
+	if (!msg)
+		return NULL;
+
+	*hdr = genlmsg_put(msg, 0, 0, &batadv_netlink_family, 0,
+			   BATADV_CMD_EVENT);
+	if (!*hdr)
+		goto err_free;
+
+	if (nla_put_u8(msg, BATADV_ATTR_EVENT, event) ||
+	    nla_put_u32(msg, BATADV_ATTR_MESH_IFINDEX, soft_iface->ifindex))
+		goto err_free;
+
+	return msg;
+
+err_free:
+	nlmsg_free(msg);
+	return NULL;
+}
+
+/**
+ * batadv_netlink_event_send() - Send a mesh state change notification
+ * @bat_priv: the bat priv with all the soft interface information
+ * @msg: message returned by batadv_netlink_event_new()
+ * @hdr: genetlink header returned by batadv_netlink_event_new()
+ */
+static void batadv_netlink_event_send(struct batadv_priv *bat_priv,
+				      struct sk_buff *msg, void *hdr)
+{
+	genlmsg_end(msg, hdr);
+
+	genlmsg_multicast_netns(&batadv_netlink_family,
+				dev_net(bat_priv->soft_iface), msg, 0,
+				BATADV_NL_MCGRP_EVENTS, GFP_ATOMIC);
+}
+
+/**
+ * batadv_netlink_notify_orig() - Notify about a changed originator
+ * @bat_priv: the bat priv with all the soft interface information
+ * @event: type of the state change
+ * @orig: address of the originator
+ * @router: new router towards the originator, NULL if none
+ */
+void batadv_netlink_notify_orig(struct batadv_priv *bat_priv,
+				enum batadv_nl_event event, const u8 *orig,
+				const struct batadv_neigh_node *router)
+{
+	struct sk_buff *msg;
+	void *hdr;
+
+	msg = batadv_netlink_event_new(bat_priv, event, &hdr);
+	if (!msg)
+		return;
+
+	if (nla_put(msg, BATADV_ATTR_ORIG_ADDRESS, ETH_ALEN, orig))
+		goto err_free;
+
+	if (router &&
+	    (nla_put(msg, BATADV_ATTR_ROUTER, ETH_ALEN, router->addr) ||
+	     nla_put_u32(msg, BATADV_ATTR_HARD_IFINDEX,
+			 router->if_incoming->net_dev->ifindex)))
+		goto err_free;
+
+	batadv_netlink_event_send(bat_priv, msg, hdr);
+	return;
+
+err_free:
+	nlmsg_free(msg);
+}
+
+/**
+ * batadv_netlink_notify_tt() - Notify about a changed translation table client
+ * @bat_priv: the bat priv with all the soft interface information
+ * @event: type of the state change
+ * @addr: mac address of the client
+ * @vid: VLAN identifier of the client
+ * @flags: TT client flags (see &enum batadv_tt_client_flags)
+ * @orig: originator announcing the client, NULL for local clients
+ */
+void batadv_netlink_notify_tt(struct batadv_priv *bat_priv,
+			      enum batadv_nl_event event, const u8 *addr,
+			      unsigned short vid, u16 flags, const u8 *orig)
+{
+	struct sk_buff *msg;
+	void *hdr;
+
+	msg = batadv_netlink_event_new(bat_priv, event, &hdr);
+	if (!msg)
+		return;
+
+	if (nla_put(msg, BATADV_ATTR_TT_ADDRESS, ETH_ALEN, addr) ||
+	    nla_put_u16(msg, BATADV_ATTR_TT_VID, vid) ||
+	    nla_put_u32(msg, BATADV_ATTR_TT_FLAGS, flags))
+		goto err_free;
+
+	if (orig && nla_put(msg, BATADV_ATTR_ORIG_ADDRESS, ETH_ALEN, orig))
+		goto err_free;
+
+	batadv_netlink_event_send(bat_priv, msg, hdr);
+	return;
+
+err_free:
+	nlmsg_free(msg);
+}
+
+/**
+ * batadv_netlink_notify_gw() - Notify about a changed gateway
+ * @bat_priv: the bat priv with all the soft interface information
+ * @event: type of the state change
+ * @gw_node: the gateway, NULL if no gateway is selected anymore
+ */
+void batadv_netlink_notify_gw(struct batadv_priv *bat_priv,
+			      enum batadv_nl_event event,
+			      const struct batadv_gw_node *gw_node)
+{
+	struct sk_buff *msg;
+	void *hdr;
+
+	msg = batadv_netlink_event_new(bat_priv, event, &hdr);
+	if (!msg)
+		return;
+
+	if (gw_node &&
+	    (nla_put(msg, BATADV_ATTR_ORIG_ADDRESS, ETH_ALEN,
+		     gw_node->orig_node->orig) ||
+	     nla_put_u32(msg, BATADV_ATTR_BANDWIDTH_DOWN,
+			 gw_node->bandwidth_down) ||
+	     nla_put_u32(msg, BATADV_ATTR_BANDWIDTH_UP,
+			 gw_node->bandwidth_up)))
+		goto err_free;
+
+	batadv_netlink_event_send(bat_priv, msg, hdr);
+	return;
+
+err_free:
+	nlmsg_free(msg);
+}
+
+/**
+ * batadv_netlink_notify_claim() - Notify about a changed BLA claim
+ * @bat_priv: the bat priv with all the soft interface information
+ * @event: type of the state change
+ * @addr: mac address of the claimed client
+ * @vid: VLAN identifier of the claim
+ * @backbone: address of the backbone gateway owning the claim
+ */
+void batadv_netlink_notify_claim(struct batadv_priv *bat_priv,
+				 enum batadv_nl_event event, const u8 *addr,
+				 unsigned short vid, const u8 *backbone)
+{
+	struct sk_buff *msg;
+	void *hdr;
+
+	msg = batadv_netlink_event_new(bat_priv, event, &hdr);
+	if (!msg)
+		return;
+
+	if (nla_put(msg, BATADV_ATTR_BLA_ADDRESS, ETH_ALEN, addr) ||
+	    nla_put_u16(msg, BATADV_ATTR_BLA_VID, vid) ||
+	    nla_put(msg, BATADV_ATTR_BLA_BACKBONE, ETH_ALEN, backbone))
+		goto err_free;
+
+	batadv_netlink_event_send(bat_priv, msg, hdr);
+	return;
+
+err_free:
+	nlmsg_free(msg);
+}
+
 /**
  * batadv_netlink_tp_meter_start() - Start a new tp_meter session
  * @skb: received netlink message
@@ -335,6 +610,10 @@ batadv_netlink_tp_meter_start(struct sk_buff *skb, struct genl_info *info)
 	struct sk_buff *msg = NULL;
 	u32 test_length;
 	void *msg_head;
+	u16 packet_len = BATADV_TP_PACKET_LEN;
+	struct nlattr *attr;
+	u8 streams = 1;
+	bool latency;
 	int ifindex;
 	u32 cookie;
 	u8 *dst;
@@ -357,6 +636,22 @@ batadv_netlink_tp_meter_start(struct sk_buff *skb, struct genl_info *info)
 
 	test_length = nla_get_u32(info->attrs[BATADV_ATTR_TPMETER_TEST_TIME]);
 
+	if (info->attrs[BATADV_ATTR_TPMETER_STREAMS])
+		streams = nla_get_u8(info->attrs[BATADV_ATTR_TPMETER_STREAMS]);
+
+	if (!streams || streams > BATADV_TP_MAX_STREAMS)
+		return -EINVAL;
+
+	attr = info->attrs[BATADV_ATTR_TPMETER_PACKET_LEN];
+	if (attr)
+		packet_len = nla_get_u16(attr);
+
+	if (packet_len < BATADV_TP_MIN_PACKET_LEN ||
+	    packet_len > BATADV_TP_MAX_PACKET_LEN)
+		return -EINVAL;
+
+	latency = nla_get_flag(info->attrs[BATADV_ATTR_TPMETER_LATENCY]);
+
 	soft_iface = dev_get_by_index(net, ifindex);
 	if (!soft_iface || !batadv_softif_is_valid(soft_iface)) {
 		ret = -ENODEV;
@@ -378,7 +673,8 @@ batadv_netlink_tp_meter_start(struct sk_buff *skb, struct genl_info *info)
 	}
 
 	bat_priv = netdev_priv(soft_iface);
-	batadv_tp_start(bat_priv, dst, test_length, &cookie);
+	batadv_tp_start(bat_priv, dst, test_length, streams, packet_len,
+			latency, &cookie);
 
 	ret = batadv_netlink_tp_meter_put(msg, cookie);
 
@@ -541,6 +837,605 @@ batadv_netlink_dump_hardifs(struct sk_buff *msg, struct netlink_callback *cb)
 	return msg->len;
 }
 
+/**
+ * struct batadv_netlink_setting - setting of a mesh interface which can be
+ *  changed via BATADV_CMD_SET_CONFIG
+ */
+struct batadv_netlink_setting {
+	/** @name: name of the setting, same as its sysfs file */
+	const char *name;
+
+	/**
+	 * @offset: offset of the atomic_t holding the value in &batadv_priv
+	 *  or, for VLAN settings, in &batadv_softif_vlan
+	 */
+	size_t offset;
+
+	/** @vlan: whether this is a setting of a VLAN */
+	bool vlan;
+
+	/** @min: smallest allowed value */
+	u32 min;
+
+	/** @max: largest allowed value */
+	u32 max;
+
+	/** @post_func: called once at the end of the request if changed */
+	void (*post_func)(struct net_device *net_dev);
+};
+
+#define BATADV_NETLINK_SETTING(_name, _var, _min, _max, _post_func)	\
+	{								\
+		.name = __stringify(_name),				\
+		.offset = offsetof(struct batadv_priv, _var),		\
+		.min = _min,						\
+		.max = _max,						\
+		.post_func = _post_func,				\
+	}
+
+#define BATADV_NETLINK_SETTING_BOOL(_name, _post_func)			\
+	BATADV_NETLINK_SETTING(_name, _name, 0, 1, _post_func)
+
+#define BATADV_NETLINK_SETTING_VLAN_BOOL(_name)				\
+	{								\
+		.name = __stringify(_name),				\
+		.offset = offsetof(struct batadv_softif_vlan, _name),	\
+		.vlan = true,						\
+		.min = 0,						\
+		.max = 1,						\
+	}
+
+/* same names and limits as the corresponding sysfs files */
+static const struct batadv_netlink_setting batadv_netlink_settings[] = {
+	BATADV_NETLINK_SETTING_BOOL(aggregated_ogms, NULL),
+	BATADV_NETLINK_SETTING(unicast_agg_delay, unicast_agg_delay, 0,
+			       BATADV_UNICAST_AGG_DELAY_MAX, NULL),
+	BATADV_NETLINK_SETTING(bcast_suppress_arp,
+			       bcast_suppress.window[BATADV_BCAST_CLASS_ARP], 0,
+			       BATADV_BCAST_SUPPRESS_WINDOW_MAX, NULL),
+	BATADV_NETLINK_SETTING(bcast_suppress_dhcp,
+			       bcast_suppress.window[BATADV_BCAST_CLASS_DHCP], 0,
+			       BATADV_BCAST_SUPPRESS_WINDOW_MAX, NULL),
+	BATADV_NETLINK_SETTING(bcast_suppress_mdns,
+			       bcast_suppress.window[BATADV_BCAST_CLASS_MDNS], 0,
+			       BATADV_BCAST_SUPPRESS_WINDOW_MAX, NULL),
+	BATADV_NETLINK_SETTING_BOOL(bonding, NULL),
+	BATADV_NETLINK_SETTING_BOOL(rx_steering, NULL),
+#ifdef CONFIG_BATMAN_ADV_BATMAN_V
+	BATADV_NETLINK_SETTING_BOOL(passive_capacity, NULL),
+#endif
+#ifdef CONFIG_BATMAN_ADV_BLA
+	BATADV_NETLINK_SETTING_BOOL(bridge_loop_avoidance,
+				    batadv_bla_status_update),
+#endif
+#ifdef CONFIG_BATMAN_ADV_DAT
+	BATADV_NETLINK_SETTING_BOOL(distributed_arp_table,
+				    batadv_dat_status_update),
+	BATADV_NETLINK_SETTING(dat_max_entries, dat.max_entries, 0, INT_MAX,
+			       NULL),
+#endif
+	BATADV_NETLINK_SETTING_BOOL(fragmentation, batadv_update_min_mtu),
+	BATADV_NETLINK_SETTING(orig_interval, orig_interval, 2 * BATADV_JITTER,
+			       INT_MAX, NULL),
+	BATADV_NETLINK_SETTING(orig_interval_max, orig_interval_max, 0,
+			       INT_MAX, NULL),
+	BATADV_NETLINK_SETTING(orig_max_entries, orig_max_entries, 0, INT_MAX,
+			       NULL),
+	BATADV_NETLINK_SETTING(tt_global_max_entries, tt.global_max_entries, 0,
+			       INT_MAX, NULL),
+	BATADV_NETLINK_SETTING(fisheye_hops, fisheye_hops, 0, BATADV_TTL, NULL),
+	BATADV_NETLINK_SETTING(hop_penalty, hop_penalty, 0, BATADV_TQ_MAX_VALUE,
+			       NULL),
+	BATADV_NETLINK_SETTING(gw_balance, gw.balance, 0, BATADV_GW_BALANCE_MAX,
+			       NULL),
+#ifdef CONFIG_BATMAN_ADV_MCAST
+	BATADV_NETLINK_SETTING_BOOL(multicast_mode, NULL),
+	BATADV_NETLINK_SETTING(multicast_fanout, multicast_fanout, 1, INT_MAX,
+			       NULL),
+#endif
+#ifdef CONFIG_BATMAN_ADV_DEBUG
+	BATADV_NETLINK_SETTING(log_level, log_level, 0, BATADV_DBG_ALL, NULL),
+#endif
+#ifdef CONFIG_BATMAN_ADV_NC
+	BATADV_NETLINK_SETTING_BOOL(network_coding, batadv_nc_status_update),
+#endif
+	BATADV_NETLINK_SETTING_VLAN_BOOL(ap_isolation),
+};
+
+/**
+ * batadv_netlink_config_parse() - parse a setting of a BATADV_CMD_SET_CONFIG
+ *  request
+ * @bat_priv: the bat priv with all the soft interface information
+ * @attr: the BATADV_ATTR_CONFIG attribute to parse
+ * @index: pointer to store the index of the setting in batadv_netlink_settings
+ * @var: pointer to store the variable holding the setting
+ * @value: pointer to store the new value of the setting
+ *
+ * Return: 0 on success, < 0 on error
+ */
+static int batadv_netlink_config_parse(struct batadv_priv *bat_priv,
+				       const struct nlattr *attr,
+				       unsigned int *index, atomic_t **var,
+				       u32 *value)
+{
+	const struct batadv_netlink_setting *setting = NULL;
+	unsigned short vid = BATADV_NO_FLAGS;
+	struct nlattr *tb[NUM_BATADV_ATTR];
+	struct batadv_softif_vlan *vlan;
+	unsigned int i;
+	int ret;
+
+	ret = nla_parse_nested(tb, BATADV_ATTR_MAX, attr, batadv_netlink_policy,
+			       NULL);
+	if (ret < 0)
+		return ret;
+
+	if (!tb[BATADV_ATTR_CONFIG_NAME] || !tb[BATADV_ATTR_CONFIG_VALUE])
+		return -EINVAL;
+
+	for (i = 0; i < ARRAY_SIZE(batadv_netlink_settings); i++) {
+		if (nla_strcmp(tb[BATADV_ATTR_CONFIG_NAME],
+			       batadv_netlink_settings[i].name) == 0) {
+			setting = &batadv_netlink_settings[i];
+			break;
+		}
+	}
+
+	if (!setting)
+		return -EOPNOTSUPP;
+
+	*value = nla_get_u32(tb[BATADV_ATTR_CONFIG_VALUE]);
+	if (*value < setting->min || *value > setting->max)
+		return -ERANGE;
+
+	*index = i;
+
+	if (!setting->vlan) {
+		if (tb[BATADV_ATTR_TT_VID])
+			return -EINVAL;
+
+		*var = (atomic_t *)((u8 *)bat_priv + setting->offset);
+		return 0;
+	}
+
+	/* same vid as in the translation table dumps */
+	if (tb[BATADV_ATTR_TT_VID])
+		vid = nla_get_u16(tb[BATADV_ATTR_TT_VID]);
+
+	vlan = batadv_softif_vlan_get(bat_priv, vid);
+	if (!vlan)
+		return -ENOENT;
+
+	/* the VLAN is not freed while rtnl is held */
+	*var = (atomic_t *)((u8 *)vlan + setting->offset);
+	batadv_softif_vlan_put(vlan);
+
+	return 0;
+}
+
+/**
+ * batadv_netlink_config_hardif() - look up a hard interface of a
+ *  BATADV_CMD_SET_CONFIG request
+ * @net: the applicable net namespace
+ * @attr: the BATADV_ATTR_HARD_IFINDEX attribute of the interface
+ *
+ * Return: the hard interface with increased refcount, NULL when the ifindex
+ * does not belong to an interface batman-adv can use
+ */
+static struct batadv_hard_iface *
+batadv_netlink_config_hardif(struct net *net, const struct nlattr *attr)
+{
+	struct net_device *hard_dev;
+
+	ASSERT_RTNL();
+
+	hard_dev = __dev_get_by_index(net, nla_get_u32(attr));
+	if (!hard_dev)
+		return NULL;
+
+	return batadv_hardif_get_by_netdev(hard_dev);
+}
+
+/**
+ * struct batadv_netlink_config_undo - value of a setting before it was changed
+ *  by a BATADV_CMD_SET_CONFIG request
+ */
+struct batadv_netlink_config_undo {
+	/** @var: the changed setting */
+	atomic_t *var;
+
+	/** @value: value to restore when the request fails */
+	u32 value;
+};
+
+/**
+ * batadv_netlink_config_check() - validate a BATADV_CMD_SET_CONFIG request
+ * @bat_priv: the bat priv with all the soft interface information
+ * @info: receiver information
+ * @num_settings: returns the number of settings in the request
+ * @num_ifaces: returns the number of hard interfaces in the request
+ *
+ * Return: 0 when all settings and hard interfaces of the request can be
+ * applied, < 0 on error
+ */
+static int batadv_netlink_config_check(struct batadv_priv *bat_priv,
+				       struct genl_info *info,
+				       unsigned int *num_settings,
+				       unsigned int *num_ifaces)
+{
+	struct net *net = genl_info_net(info);
+	struct batadv_hard_iface *hard_iface;
+	struct nlattr *attr;
+	unsigned int index;
+	atomic_t *var;
+	u32 value;
+	int ret;
+	int rem;
+
+	*num_settings = 0;
+	*num_ifaces = 0;
+
+	nlmsg_for_each_attr(attr, info->nlhdr, GENL_HDRLEN, rem) {
+		switch (nla_type(attr)) {
+		case BATADV_ATTR_CONFIG:
+			ret = batadv_netlink_config_parse(bat_priv, attr,
+							  &index, &var, &value);
+			if (ret < 0)
+				return ret;
+
+			(*num_settings)++;
+			break;
+		case BATADV_ATTR_HARD_IFINDEX:
+			hard_iface = batadv_netlink_config_hardif(net, attr);
+			if (!hard_iface)
+				return -ENODEV;
+
+			batadv_hardif_put(hard_iface);
+			(*num_ifaces)++;
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * batadv_netlink_config_rollback() - undo the changes of a failed
+ *  BATADV_CMD_SET_CONFIG request
+ * @undo: the old values of the changed settings
+ * @num_undo: number of entries in @undo
+ * @added: the hard interfaces added to the mesh interface
+ * @num_added: number of entries in @added
+ *
+ * Interfaces which were moved from another mesh interface are not added to it
+ * again.
+ */
+static void
+batadv_netlink_config_rollback(const struct batadv_netlink_config_undo *undo,
+			       unsigned int num_undo,
+			       struct batadv_hard_iface **added,
+			       unsigned int num_added)
+{
+	while (num_added--)
+		batadv_hardif_disable_interface(added[num_added],
+						BATADV_IF_CLEANUP_KEEP);
+
+	while (num_undo--)
+		atomic_set(undo[num_undo].var, undo[num_undo].value);
+}
+
+/**
+ * batadv_netlink_config_finish() - run the recalculations deferred during a
+ *  BATADV_CMD_SET_CONFIG request
+ * @soft_iface: the configured mesh interface
+ * @changed: bitmap of the changed entries of batadv_netlink_settings
+ */
+static void batadv_netlink_config_finish(struct net_device *soft_iface,
+					 const unsigned long *changed)
+{
+	struct batadv_priv *bat_priv = netdev_priv(soft_iface);
+	const struct batadv_netlink_setting *setting;
+	unsigned int i, j;
+
+	for_each_set_bit(i, changed, ARRAY_SIZE(batadv_netlink_settings)) {
+		setting = &batadv_netlink_settings[i];
+		if (!setting->post_func)
+			continue;
+
+		/* settings sharing a post_func need it only once */
+		for_each_set_bit(j, changed, i) {
+			if (batadv_netlink_settings[j].post_func ==
+			    setting->post_func)
+				break;
+		}
+
+		if (j == i)
+			setting->post_func(soft_iface);
+	}
+
+	WRITE_ONCE(bat_priv->config_batch, false);
+
+	if (bat_priv->config_mtu_pending) {
+		bat_priv->config_mtu_pending = false;
+		batadv_update_min_mtu(soft_iface);
+	}
+}
+
+/**
+ * batadv_netlink_set_config() - handle incoming BATADV_CMD_SET_CONFIG
+ * @skb: received netlink message
+ * @info: receiver information
+ *
+ * Creates the mesh interface BATADV_ATTR_MESH_IFNAME when it does not exist
+ * yet, changes all its BATADV_ATTR_CONFIG settings and adds all
+ * BATADV_ATTR_HARD_IFINDEX interfaces to it. Everything is validated before
+ * the first change is made and applied under a single rtnl lock. When adding
+ * an interface fails anyway, a mesh interface created by the request is
+ * removed again. Otherwise the settings are reset and the interfaces added so
+ * far are removed. Derived state like the MTU, the TVLV containers of toggled
+ * features or the translation table size limit is recalculated only once at
+ * the end instead of after every setting and interface.
+ *
+ * Return: 0 on success, < 0 on error
+ */
+static int
+batadv_netlink_set_config(struct sk_buff *skb, struct genl_info *info)
+{
+	DECLARE_BITMAP(changed, ARRAY_SIZE(batadv_netlink_settings));
+	struct batadv_netlink_config_undo *undo = NULL;
+	unsigned int num_undo = 0, num_added = 0;
+	struct batadv_hard_iface **added = NULL;
+	unsigned int num_settings, num_ifaces;
+	struct net *net = genl_info_net(info);
+	struct batadv_hard_iface *hard_iface;
+	struct net_device *soft_iface;
+	struct batadv_priv *bat_priv;
+	char ifname[IFNAMSIZ];
+	bool created = false;
+	struct nlattr *attr;
+	unsigned int index;
+	unsigned int i;
+	atomic_t *var;
+	u32 value;
+	int ret = 0;
+	int rem;
+
+	if (!info->attrs[BATADV_ATTR_MESH_IFNAME])
+		return -EINVAL;
+
+	nla_strlcpy(ifname, info->attrs[BATADV_ATTR_MESH_IFNAME],
+		    sizeof(ifname));
+	bitmap_zero(changed, ARRAY_SIZE(batadv_netlink_settings));
+
+	rtnl_lock();
+
+	soft_iface = __dev_get_by_name(net, ifname);
+	if (!soft_iface) {
+		soft_iface = batadv_softif_create(net, ifname);
+		if (!soft_iface) {
+			ret = -ENOMEM;
+			goto unlock;
+		}
+
+		created = true;
+	}
+
+	if (!batadv_softif_is_valid(soft_iface)) {
+		ret = -EINVAL;
+		goto unlock;
+	}
+
+	bat_priv = netdev_priv(soft_iface);
+
+	ret = batadv_netlink_config_check(bat_priv, info, &num_settings,
+					  &num_ifaces);
+	if (ret < 0)
+		goto destroy;
+
+	undo = kcalloc(num_settings, sizeof(*undo), GFP_KERNEL);
+	added = kcalloc(num_ifaces, sizeof(*added), GFP_KERNEL);
+	if ((num_settings && !undo) || (num_ifaces && !added)) {
+		ret = -ENOMEM;
+		goto destroy;
+	}
+
+	WRITE_ONCE(bat_priv->config_batch, true);
+
+	/* settings first, so that the interfaces join the configured mesh */
+	nlmsg_for_each_attr(attr, info->nlhdr, GENL_HDRLEN, rem) {
+		if (nla_type(attr) != BATADV_ATTR_CONFIG)
+			continue;
+
+		ret = batadv_netlink_config_parse(bat_priv, attr, &index, &var,
+						  &value);
+		if (ret < 0)
+			goto finish;
+
+		if (atomic_read(var) == value)
+			continue;
+
+		undo[num_undo].var = var;
+		undo[num_undo].value = atomic_read(var);
+		num_undo++;
+
+		atomic_set(var, value);
+		set_bit(index, changed);
+	}
+
+	nlmsg_for_each_attr(attr, info->nlhdr, GENL_HDRLEN, rem) {
+		if (nla_type(attr) != BATADV_ATTR_HARD_IFINDEX)
+			continue;
+
+		hard_iface = batadv_netlink_config_hardif(net, attr);
+		if (!hard_iface) {
+			ret = -ENODEV;
+			goto finish;
+		}
+
+		if (hard_iface->soft_iface == soft_iface) {
+			batadv_hardif_put(hard_iface);
+			continue;
+		}
+
+		if (hard_iface->if_status != BATADV_IF_NOT_IN_USE)
+			batadv_hardif_disable_interface(hard_iface,
+							BATADV_IF_CLEANUP_AUTO);
+
+		ret = batadv_hardif_enable_interface(hard_iface, net, ifname);
+		if (ret < 0) {
+			batadv_hardif_put(hard_iface);
+			goto finish;
+		}
+
+		/* keeps the reference until the request is done */
+		added[num_added++] = hard_iface;
+	}
+
+finish:
+	if (ret < 0 && !created)
+		batadv_netlink_config_rollback(undo, num_undo, added,
+					       num_added);
+
+	/* reset settings may need the recalculation as well */
+	batadv_netlink_config_finish(soft_iface, changed);
+
+	if (ret < 0)
+		goto destroy;
+
+	batadv_info(soft_iface,
+		    "Applied %u settings (%u changed) and %u interfaces\n",
+		    num_settings,
+		    bitmap_weight(changed, ARRAY_SIZE(batadv_netlink_settings)),
+		    num_ifaces);
+
+destroy:
+	if (ret < 0 && created)
+		soft_iface->rtnl_link_ops->dellink(soft_iface, NULL);
+
+unlock:
+	rtnl_unlock();
+
+	for (i = 0; i < num_added; i++)
+		batadv_hardif_put(added[i]);
+	kfree(added);
+	kfree(undo);
+
+	return ret;
+}
+
+#ifdef CONFIG_BATMAN_ADV_INJECT
+
+/**
+ * batadv_netlink_inject_frame() - receive a synthetic frame on a hard interface
+ * @hard_iface: interface to receive the frame on
+ * @attr: attribute holding the ethernet frame
+ *
+ * The frame is passed to the same function the network stack calls for
+ * received batman-adv frames.
+ *
+ * Return: 0 on success, < 0 on error
+ */
+static int batadv_netlink_inject_frame(struct batadv_hard_iface *hard_iface,
+				       const struct nlattr *attr)
+{
+	struct net_device *net_dev = hard_iface->net_dev;
+	int len = nla_len(attr);
+	struct sk_buff *skb;
+
+	/* packet type and version have to follow the ethernet header */
+	if (len < ETH_HLEN + 2)
+		return -EINVAL;
+
+	skb = netdev_alloc_skb_ip_align(net_dev, len);
+	if (!skb)
+		return -ENOMEM;
+
+	skb_put_data(skb, nla_data(attr), len);
+	skb->protocol = eth_type_trans(skb, net_dev);
+	if (skb->protocol != htons(ETH_P_BATMAN)) {
+		kfree_skb(skb);
+		return -EINVAL;
+	}
+
+	skb_reset_network_header(skb);
+	skb_reset_mac_len(skb);
+
+	/* same context as the receive path of the network stack */
+	local_bh_disable();
+	rcu_read_lock();
+	batadv_batman_skb_recv(skb, net_dev, &hard_iface->batman_adv_ptype,
+			       net_dev);
+	rcu_read_unlock();
+	local_bh_enable();
+
+	return 0;
+}
+
+/**
+ * batadv_netlink_inject() - handle incoming BATADV_CMD_INJECT
+ * @skb: received netlink message
+ * @info: receiver information
+ *
+ * All BATADV_ATTR_INJECT_FRAME attributes of the message are received in
+ * order on the hard interface, BATADV_ATTR_INJECT_COUNT times. Userspace
+ * controls the rate by the number of frames per message and the interval
+ * between the messages.
+ *
+ * Return: 0 on success, < 0 on error
+ */
+static int batadv_netlink_inject(struct sk_buff *skb, struct genl_info *info)
+{
+	struct batadv_hard_iface *hard_iface = NULL;
+	struct net *net = genl_info_net(info);
+	struct net_device *hard_dev;
+	struct nlattr *attr;
+	u32 count = 1;
+	int ifindex;
+	int ret = 0;
+	u32 i;
+	int rem;
+
+	if (!info->attrs[BATADV_ATTR_HARD_IFINDEX] ||
+	    !info->attrs[BATADV_ATTR_INJECT_FRAME])
+		return -EINVAL;
+
+	if (info->attrs[BATADV_ATTR_INJECT_COUNT])
+		count = nla_get_u32(info->attrs[BATADV_ATTR_INJECT_COUNT]);
+
+	ifindex = nla_get_u32(info->attrs[BATADV_ATTR_HARD_IFINDEX]);
+	hard_dev = dev_get_by_index(net, ifindex);
+	if (!hard_dev)
+		return -ENODEV;
+
+	hard_iface = batadv_hardif_get_by_netdev(hard_dev);
+	if (!hard_iface || !hard_iface->soft_iface) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	for (i = 0; i < count; i++) {
+		nlmsg_for_each_attr(attr, info->nlhdr, GENL_HDRLEN, rem) {
+			if (nla_type(attr) != BATADV_ATTR_INJECT_FRAME)
+				continue;
+
+			ret = batadv_netlink_inject_frame(hard_iface, attr);
+			if (ret < 0)
+				goto out;
+		}
+
+		cond_resched();
+	}
+
+out:
+	if (hard_iface)
+		batadv_hardif_put(hard_iface);
+	dev_put(hard_dev);
+
+	return ret;
+}
+
+#endif /* CONFIG_BATMAN_ADV_INJECT */
+
 static const struct genl_ops batadv_netlink_ops[] = {
 	{
 		.cmd = BATADV_CMD_GET_MESH_INFO,
@@ -626,6 +1521,50 @@ static const struct genl_ops batadv_netlink_ops[] = {
 		.policy = batadv_netlink_policy,
 		.dumpit = batadv_mcast_flags_dump,
 	},
+	{
+		.cmd = BATADV_CMD_GET_STATS,
+		.flags = GENL_ADMIN_PERM,
+		.policy = batadv_netlink_policy,
+		.dumpit = batadv_softif_stats_dump,
+	},
+	{
+		.cmd = BATADV_CMD_GET_NEXTHOPS,
+		.flags = GENL_ADMIN_PERM,
+		.policy = batadv_netlink_policy,
+		.dumpit = batadv_orig_nexthop_dump,
+	},
+	{
+		.cmd = BATADV_CMD_RESTORE_TT,
+		.flags = GENL_ADMIN_PERM,
+		.policy = batadv_netlink_policy,
+		.doit = batadv_tt_restore,
+	},
+	{
+		.cmd = BATADV_CMD_PING,
+		.flags = GENL_ADMIN_PERM,
+		.policy = batadv_netlink_policy,
+		.doit = batadv_ping_start,
+	},
+	{
+		.cmd = BATADV_CMD_GET_OFFLOAD_FLOWS,
+		.flags = GENL_ADMIN_PERM,
+		.policy = batadv_netlink_policy,
+		.dumpit = batadv_tt_offload_dump,
+	},
+	{
+		.cmd = BATADV_CMD_SET_CONFIG,
+		.flags = GENL_ADMIN_PERM,
+		.policy = batadv_netlink_policy,
+		.doit = batadv_netlink_set_config,
+	},
+#ifdef CONFIG_BATMAN_ADV_INJECT
+	{
+		.cmd = BATADV_CMD_INJECT,
+		.flags = GENL_ADMIN_PERM,
+		.policy = batadv_netlink_policy,
+		.doit = batadv_netlink_inject,
+	},
+#endif
 
 };
 
@@ -23,16 +23,35 @@
 
 #include <linux/types.h>
 #include <net/genetlink.h>
+#include <uapi/linux/batman_adv.h>
 
+struct netlink_callback;
 struct nlmsghdr;
+struct sk_buff;
 
 void batadv_netlink_register(void);
 void batadv_netlink_unregister(void);
 int batadv_netlink_get_ifindex(const struct nlmsghdr *nlh, int attrtype);
+void batadv_netlink_dump_check(struct sk_buff *msg, struct netlink_callback *cb,
+			       int start);
 
 int batadv_netlink_tpmeter_notify(struct batadv_priv *bat_priv, const u8 *dst,
 				  u8 result, u32 test_time, u64 total_bytes,
-				  u32 cookie);
+				  u32 cookie,
+				  const struct batadv_tp_rtt_summary *rtt);
+
+void batadv_netlink_notify_orig(struct batadv_priv *bat_priv,
+				enum batadv_nl_event event, const u8 *orig,
+				const struct batadv_neigh_node *router);
+void batadv_netlink_notify_tt(struct batadv_priv *bat_priv,
+			      enum batadv_nl_event event, const u8 *addr,
+			      unsigned short vid, u16 flags, const u8 *orig);
+void batadv_netlink_notify_gw(struct batadv_priv *bat_priv,
+			      enum batadv_nl_event event,
+			      const struct batadv_gw_node *gw_node);
+void batadv_netlink_notify_claim(struct batadv_priv *bat_priv,
+				 enum batadv_nl_event event, const u8 *addr,
+				 unsigned short vid, const u8 *backbone);
 
 extern struct genl_family batadv_netlink_family;
 
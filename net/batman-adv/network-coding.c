@@ -22,11 +22,14 @@
 #include <linux/atomic.h>
 #include <linux/bitops.h>
 #include <linux/byteorder/generic.h>
+#include <linux/cache.h>
 #include <linux/compiler.h>
 #include <linux/debugfs.h>
 #include <linux/errno.h>
 #include <linux/etherdevice.h>
 #include <linux/gfp.h>
+#include <linux/hashtable.h>
+#include <linux/hrtimer.h>
 #include <linux/if_ether.h>
 #include <linux/if_packet.h>
 #include <linux/init.h>
@@ -34,7 +37,9 @@
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
 #include <linux/kref.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
+#include <linux/llist.h>
 #include <linux/lockdep.h>
 #include <linux/net.h>
 #include <linux/netdevice.h>
@@ -49,6 +54,7 @@
 #include <linux/stddef.h>
 #include <linux/string.h>
 #include <linux/workqueue.h>
+#include <asm/unaligned.h>
 #include <uapi/linux/batadv_packet.h>
 
 #include "hard-interface.h"
@@ -62,9 +68,16 @@
 static struct lock_class_key batadv_nc_coding_hash_lock_class_key;
 static struct lock_class_key batadv_nc_decoding_hash_lock_class_key;
 
+static struct kmem_cache *batadv_nc_packet_cache __read_mostly;
+
 static void batadv_nc_worker(struct work_struct *work);
+static enum hrtimer_restart batadv_nc_fwd_timer(struct hrtimer *timer);
+static void batadv_nc_fwd_work(struct work_struct *work);
+static u32 batadv_nc_hash_choose_node(const struct hlist_node *node, u32 size);
 static int batadv_nc_recv_coded_packet(struct sk_buff *skb,
 				       struct batadv_hard_iface *recv_if);
+static int batadv_nc_recv_coded_multi_packet(struct sk_buff *skb,
+					     struct batadv_hard_iface *recv_if);
 
 /**
  * batadv_nc_init() - one-time initialization for network coding
@@ -78,6 +91,11 @@ int __init batadv_nc_init(void)
 	/* Register our packet type */
 	ret = batadv_recv_handler_register(BATADV_CODED,
 					   batadv_nc_recv_coded_packet);
+	if (ret < 0)
+		return ret;
+
+	ret = batadv_recv_handler_register(BATADV_CODED_MULTI,
+					   batadv_nc_recv_coded_multi_packet);
 
 	return ret;
 }
@@ -88,7 +106,7 @@ int __init batadv_nc_init(void)
  */
 static void batadv_nc_start_timer(struct batadv_priv *bat_priv)
 {
-	queue_delayed_work(batadv_event_workqueue, &bat_priv->nc.work,
+	queue_delayed_work(bat_priv->event_wq, &bat_priv->nc.work,
 			   msecs_to_jiffies(10));
 }
 
@@ -106,10 +124,13 @@ static void batadv_nc_tvlv_container_update(struct batadv_priv *bat_priv)
 	switch (nc_mode) {
 	case 0:
 		batadv_tvlv_container_unregister(bat_priv, BATADV_TVLV_NC, 1);
+		batadv_tvlv_container_unregister(bat_priv, BATADV_TVLV_NC, 2);
 		break;
 	case 1:
 		batadv_tvlv_container_register(bat_priv, BATADV_TVLV_NC, 1,
 					       NULL, 0);
+		batadv_tvlv_container_register(bat_priv, BATADV_TVLV_NC, 2,
+					       NULL, 0);
 		break;
 	}
 }
@@ -145,6 +166,26 @@ static void batadv_nc_tvlv_ogm_handler_v1(struct batadv_priv *bat_priv,
 		set_bit(BATADV_ORIG_CAPA_HAS_NC, &orig->capabilities);
 }
 
+/**
+ * batadv_nc_tvlv_ogm_handler_v2() - process incoming nc tvlv container
+ *  announcing the ability to decode multi coded packets
+ * @bat_priv: the bat priv with all the soft interface information
+ * @orig: the orig_node of the ogm
+ * @flags: flags indicating the tvlv state (see batadv_tvlv_handler_flags)
+ * @tvlv_value: tvlv buffer containing the gateway data
+ * @tvlv_value_len: tvlv buffer length
+ */
+static void batadv_nc_tvlv_ogm_handler_v2(struct batadv_priv *bat_priv,
+					  struct batadv_orig_node *orig,
+					  u8 flags,
+					  void *tvlv_value, u16 tvlv_value_len)
+{
+	if (flags & BATADV_TVLV_HANDLER_OGM_CIFNOTFND)
+		clear_bit(BATADV_ORIG_CAPA_HAS_NC_MULTI, &orig->capabilities);
+	else
+		set_bit(BATADV_ORIG_CAPA_HAS_NC_MULTI, &orig->capabilities);
+}
+
 /**
  * batadv_nc_mesh_init() - initialise coding hash table and start house keeping
  * @bat_priv: the bat priv with all the soft interface information
@@ -155,18 +196,25 @@ int batadv_nc_mesh_init(struct batadv_priv *bat_priv)
 {
 	bat_priv->nc.timestamp_fwd_flush = jiffies;
 	bat_priv->nc.timestamp_sniffed_purge = jiffies;
+	hash_init(bat_priv->nc.coding_index);
+	spin_lock_init(&bat_priv->nc.coding_index_lock);
+	hrtimer_init(&bat_priv->nc.fwd_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	bat_priv->nc.fwd_timer.function = batadv_nc_fwd_timer;
+	INIT_WORK(&bat_priv->nc.fwd_work, batadv_nc_fwd_work);
 
 	if (bat_priv->nc.coding_hash || bat_priv->nc.decoding_hash)
 		return 0;
 
-	bat_priv->nc.coding_hash = batadv_hash_new(128);
+	bat_priv->nc.coding_hash = batadv_hash_new(128,
+						   batadv_nc_hash_choose_node);
 	if (!bat_priv->nc.coding_hash)
 		goto err;
 
 	batadv_hash_set_lock_class(bat_priv->nc.coding_hash,
 				   &batadv_nc_coding_hash_lock_class_key);
 
-	bat_priv->nc.decoding_hash = batadv_hash_new(128);
+	bat_priv->nc.decoding_hash =
+		batadv_hash_new(128, batadv_nc_hash_choose_node);
 	if (!bat_priv->nc.decoding_hash)
 		goto err;
 
@@ -179,6 +227,9 @@ int batadv_nc_mesh_init(struct batadv_priv *bat_priv)
 	batadv_tvlv_handler_register(bat_priv, batadv_nc_tvlv_ogm_handler_v1,
 				     NULL, BATADV_TVLV_NC, 1,
 				     BATADV_TVLV_HANDLER_OGM_CIFNOTFND);
+	batadv_tvlv_handler_register(bat_priv, batadv_nc_tvlv_ogm_handler_v2,
+				     NULL, BATADV_TVLV_NC, 2,
+				     BATADV_TVLV_HANDLER_OGM_CIFNOTFND);
 	batadv_nc_tvlv_container_update(bat_priv);
 	return 0;
 
@@ -273,7 +324,42 @@ static void batadv_nc_packet_free(struct batadv_nc_packet *nc_packet,
 		consume_skb(nc_packet->skb);
 
 	batadv_nc_path_put(nc_packet->nc_path);
-	kfree(nc_packet);
+	kmem_cache_free(batadv_nc_packet_cache, nc_packet);
+}
+
+/**
+ * batadv_nc_path_splice() - move the packets added without lock to the packet
+ *  list of a path
+ * @nc_path: the nc path to update
+ *
+ * Caller needs to hold the nc_path->packet_list_lock.
+ */
+static void batadv_nc_path_splice(struct batadv_nc_path *nc_path)
+{
+	struct batadv_nc_packet *nc_packet, *nc_packet_tmp;
+	struct llist_node *first;
+
+	lockdep_assert_held(&nc_path->packet_list_lock);
+
+	/* the lockless list is LIFO - restore the order of arrival */
+	first = llist_del_all(&nc_path->packet_llist);
+	first = llist_reverse_order(first);
+
+	llist_for_each_entry_safe(nc_packet, nc_packet_tmp, first, llnode)
+		list_add_tail(&nc_packet->list, &nc_path->packet_list);
+}
+
+/**
+ * batadv_nc_path_empty() - check whether a path holds no buffered packets
+ * @nc_path: the nc path to check
+ *
+ * Return: true if neither the packet list nor the lockless list of the path
+ * hold a packet
+ */
+static bool batadv_nc_path_empty(struct batadv_nc_path *nc_path)
+{
+	return list_empty(&nc_path->packet_list) &&
+	       llist_empty(&nc_path->packet_llist);
 }
 
 /**
@@ -413,10 +499,9 @@ static void batadv_nc_purge_orig_hash(struct batadv_priv *bat_priv)
 		return;
 
 	/* For each orig_node */
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-
+	for (i = 0; i < batadv_hash_size(hash); i++) {
 		rcu_read_lock();
+		head = batadv_hash_bucket_rcu(hash, i);
 		hlist_for_each_entry_rcu(orig_node, head, hash_entry)
 			batadv_nc_purge_orig(bat_priv, orig_node,
 					     batadv_nc_to_purge_nc_node);
@@ -445,25 +530,25 @@ static void batadv_nc_purge_paths(struct batadv_priv *bat_priv,
 	spinlock_t *lock; /* Protects lists in hash */
 	u32 i;
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-		lock = &hash->list_locks[i];
-
+	for (i = 0; i < batadv_hash_size(hash); i++) {
 		/* For each nc_path in this bin */
-		spin_lock_bh(lock);
+		head = batadv_hash_lock_bucket(hash, i, &lock);
 		hlist_for_each_entry_safe(nc_path, node_tmp, head, hash_entry) {
 			/* if an helper function has been passed as parameter,
 			 * ask it if the entry has to be purged or not
 			 */
-			if (to_purge && !to_purge(bat_priv, nc_path))
+			if (to_purge && !to_purge(bat_priv, nc_path)) {
+				batadv_hash_age_note(hash, nc_path->last_valid);
 				continue;
+			}
 
 			/* purging an non-empty nc_path should never happen, but
 			 * is observed under high CPU load. Delay the purging
 			 * until next iteration to allow the packet_list to be
 			 * emptied first.
 			 */
-			if (!unlikely(list_empty(&nc_path->packet_list))) {
+			if (!unlikely(batadv_nc_path_empty(nc_path))) {
+				batadv_hash_age_note(hash, nc_path->last_valid);
 				net_ratelimited_function(printk,
 							 KERN_WARNING
 							 "Skipping free of non-empty nc_path (%pM -> %pM)!\n",
@@ -476,11 +561,73 @@ static void batadv_nc_purge_paths(struct batadv_priv *bat_priv,
 			batadv_dbg(BATADV_DBG_NC, bat_priv,
 				   "Remove nc_path %pM -> %pM\n",
 				   nc_path->prev_hop, nc_path->next_hop);
-			hlist_del_rcu(&nc_path->hash_entry);
+			batadv_hash_del(hash, &nc_path->hash_entry);
 			batadv_nc_path_put(nc_path);
 		}
-		spin_unlock_bh(lock);
+		batadv_hash_unlock_bucket(hash, lock);
+	}
+}
+
+/**
+ * batadv_nc_index_key() - compute the coding_index key of a previous hop
+ * @prev_hop: the previous hop address of a coding path
+ *
+ * Return: the key of the paths of prev_hop in &batadv_priv_nc.coding_index
+ */
+static u32 batadv_nc_index_key(const u8 *prev_hop)
+{
+	return jhash(prev_hop, ETH_ALEN, 0);
+}
+
+/**
+ * batadv_nc_index_add() - add a coding path with buffered packets to the
+ *  coding opportunity index
+ * @bat_priv: the bat priv with all the soft interface information
+ * @nc_path: the coding path to add
+ */
+static void batadv_nc_index_add(struct batadv_priv *bat_priv,
+				struct batadv_nc_path *nc_path)
+{
+	spin_lock_bh(&bat_priv->nc.coding_index_lock);
+	if (!nc_path->indexed) {
+		kref_get(&nc_path->refcount);
+		hash_add(bat_priv->nc.coding_index, &nc_path->index_entry,
+			 batadv_nc_index_key(nc_path->prev_hop));
+		nc_path->indexed = true;
 	}
+	spin_unlock_bh(&bat_priv->nc.coding_index_lock);
+}
+
+/**
+ * batadv_nc_index_del() - remove a coding path from the coding opportunity
+ *  index
+ * @nc_path: the coding path to remove
+ *
+ * Caller needs to hold the bat_priv->nc.coding_index_lock.
+ */
+static void batadv_nc_index_del(struct batadv_nc_path *nc_path)
+{
+	hash_del(&nc_path->index_entry);
+	nc_path->indexed = false;
+	batadv_nc_path_put(nc_path);
+}
+
+/**
+ * batadv_nc_index_free() - remove all coding paths from the coding
+ *  opportunity index
+ * @bat_priv: the bat priv with all the soft interface information
+ */
+static void batadv_nc_index_free(struct batadv_priv *bat_priv)
+{
+	struct batadv_nc_path *nc_path;
+	struct hlist_node *node_tmp;
+	int bkt;
+
+	spin_lock_bh(&bat_priv->nc.coding_index_lock);
+	hash_for_each_safe(bat_priv->nc.coding_index, bkt, node_tmp, nc_path,
+			   index_entry)
+		batadv_nc_index_del(nc_path);
+	spin_unlock_bh(&bat_priv->nc.coding_index_lock);
 }
 
 /**
@@ -514,6 +661,22 @@ static u32 batadv_nc_hash_choose(const void *data, u32 size)
 	return hash % size;
 }
 
+/**
+ * batadv_nc_hash_choose_node() - compute the hash value for a stored nc path
+ * @node: hash_entry of the nc path
+ * @size: size of the hash table
+ *
+ * Return: the selected index in the hash table for the given nc path.
+ */
+static u32 batadv_nc_hash_choose_node(const struct hlist_node *node, u32 size)
+{
+	const struct batadv_nc_path *nc_path;
+
+	nc_path = container_of(node, struct batadv_nc_path, hash_entry);
+
+	return batadv_nc_hash_choose(nc_path, size);
+}
+
 /**
  * batadv_nc_hash_compare() - comparing function used in the network coding hash
  *  tables
@@ -553,25 +716,27 @@ batadv_nc_hash_find(struct batadv_hashtable *hash,
 {
 	struct hlist_head *head;
 	struct batadv_nc_path *nc_path, *nc_path_tmp = NULL;
-	int index;
+	unsigned int seq;
 
 	if (!hash)
 		return NULL;
 
-	index = batadv_nc_hash_choose(data, hash->size);
-	head = &hash->table[index];
-
 	rcu_read_lock();
-	hlist_for_each_entry_rcu(nc_path, head, hash_entry) {
-		if (!batadv_nc_hash_compare(&nc_path->hash_entry, data))
-			continue;
+	do {
+		seq = batadv_hash_read_begin(hash);
+		head = batadv_hash_head_rcu(hash, batadv_nc_hash_choose, data);
 
-		if (!kref_get_unless_zero(&nc_path->refcount))
-			continue;
+		hlist_for_each_entry_rcu(nc_path, head, hash_entry) {
+			if (!batadv_nc_hash_compare(&nc_path->hash_entry, data))
+				continue;
 
-		nc_path_tmp = nc_path;
-		break;
-	}
+			if (!kref_get_unless_zero(&nc_path->refcount))
+				continue;
+
+			nc_path_tmp = nc_path;
+			break;
+		}
+	} while (!nc_path_tmp && batadv_hash_read_retry(hash, seq));
 	rcu_read_unlock();
 
 	return nc_path_tmp;
@@ -628,12 +793,12 @@ out:
 }
 
 /**
- * batadv_nc_fwd_flush() - Checks the timestamp of the given nc packet.
+ * batadv_nc_fwd_flush() - Checks the deadline of the given nc packet.
  * @bat_priv: the bat priv with all the soft interface information
  * @nc_path: the nc path the packet belongs to
  * @nc_packet: the nc packet to be checked
  *
- * Checks whether the given nc packet has hit its forward timeout. If so, the
+ * Checks whether the given nc packet has hit its forward deadline. If so, the
  * packet is no longer delayed, immediately sent and the entry deleted from the
  * queue. Has to be called with the appropriate locks.
  *
@@ -644,15 +809,13 @@ static bool batadv_nc_fwd_flush(struct batadv_priv *bat_priv,
 				struct batadv_nc_path *nc_path,
 				struct batadv_nc_packet *nc_packet)
 {
-	unsigned long timeout = bat_priv->nc.max_fwd_delay;
-
 	lockdep_assert_held(&nc_path->packet_list_lock);
 
 	/* Packets are added to tail, so the remaining packets did not time
 	 * out and we can stop processing the current queue
 	 */
 	if (atomic_read(&bat_priv->mesh_state) == BATADV_MESH_ACTIVE &&
-	    !batadv_has_timed_out(nc_packet->timestamp, timeout))
+	    ktime_before(ktime_get(), nc_packet->deadline))
 		return false;
 
 	/* Send packet */
@@ -691,14 +854,14 @@ batadv_nc_process_nc_paths(struct batadv_priv *bat_priv,
 		return;
 
 	/* Loop hash table bins */
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-
+	for (i = 0; i < batadv_hash_size(hash); i++) {
 		/* Loop coding paths */
 		rcu_read_lock();
+		head = batadv_hash_bucket_rcu(hash, i);
 		hlist_for_each_entry_rcu(nc_path, head, hash_entry) {
 			/* Loop packets */
 			spin_lock_bh(&nc_path->packet_list_lock);
+			batadv_nc_path_splice(nc_path);
 			list_for_each_entry_safe(nc_packet, nc_packet_tmp,
 						 &nc_path->packet_list, list) {
 				ret = process_fn(bat_priv, nc_path, nc_packet);
@@ -711,6 +874,107 @@ batadv_nc_process_nc_paths(struct batadv_priv *bat_priv,
 	}
 }
 
+/**
+ * batadv_nc_fwd_timer_arm() - make sure the forward timer fires at a deadline
+ * @bat_priv: the bat priv with all the soft interface information
+ * @deadline: time at which buffered packets have to be forwarded
+ */
+static void batadv_nc_fwd_timer_arm(struct batadv_priv *bat_priv,
+				    ktime_t deadline)
+{
+	struct hrtimer *timer = &bat_priv->nc.fwd_timer;
+
+	if (hrtimer_is_queued(timer) &&
+	    !ktime_before(deadline, hrtimer_get_expires(timer)))
+		return;
+
+	hrtimer_start(timer, deadline, HRTIMER_MODE_ABS);
+}
+
+/**
+ * batadv_nc_fwd_timer() - forward timer callback
+ * @timer: the forward timer of the mesh
+ *
+ * Return: HRTIMER_NORESTART as the timer is armed again by the forward work
+ */
+static enum hrtimer_restart batadv_nc_fwd_timer(struct hrtimer *timer)
+{
+	struct batadv_priv_nc *priv_nc;
+	struct batadv_priv *bat_priv;
+
+	priv_nc = container_of(timer, struct batadv_priv_nc, fwd_timer);
+	bat_priv = container_of(priv_nc, struct batadv_priv, nc);
+
+	/* packets cannot be sent from hard interrupt context */
+	queue_work(bat_priv->event_wq, &bat_priv->nc.fwd_work);
+
+	return HRTIMER_NORESTART;
+}
+
+/**
+ * batadv_nc_fwd_process() - forward the packets buffered for coding whose
+ *  deadline has passed
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * Only the paths in the coding opportunity index hold packets and have to be
+ * looked at. The forward timer is armed again for the earliest deadline of
+ * the remaining packets.
+ */
+static void batadv_nc_fwd_process(struct batadv_priv *bat_priv)
+{
+	struct batadv_nc_packet *nc_packet, *nc_packet_tmp;
+	struct batadv_nc_path *nc_path;
+	struct hlist_node *node_tmp;
+	ktime_t next = ktime_set(0, 0);
+	bool pending = false;
+	bool empty;
+	int bkt;
+
+	rcu_read_lock();
+	spin_lock_bh(&bat_priv->nc.coding_index_lock);
+	hash_for_each_safe(bat_priv->nc.coding_index, bkt, node_tmp, nc_path,
+			   index_entry) {
+		spin_lock_bh(&nc_path->packet_list_lock);
+		batadv_nc_path_splice(nc_path);
+		list_for_each_entry_safe(nc_packet, nc_packet_tmp,
+					 &nc_path->packet_list, list) {
+			if (batadv_nc_fwd_flush(bat_priv, nc_path, nc_packet))
+				continue;
+
+			if (!pending || ktime_before(nc_packet->deadline, next))
+				next = nc_packet->deadline;
+
+			pending = true;
+			break;
+		}
+		empty = batadv_nc_path_empty(nc_path);
+		spin_unlock_bh(&nc_path->packet_list_lock);
+
+		if (empty)
+			batadv_nc_index_del(nc_path);
+	}
+	spin_unlock_bh(&bat_priv->nc.coding_index_lock);
+	rcu_read_unlock();
+
+	if (pending)
+		batadv_nc_fwd_timer_arm(bat_priv, next);
+}
+
+/**
+ * batadv_nc_fwd_work() - forward the packets whose deadline has passed
+ * @work: kernel work struct
+ */
+static void batadv_nc_fwd_work(struct work_struct *work)
+{
+	struct batadv_priv_nc *priv_nc;
+	struct batadv_priv *bat_priv;
+
+	priv_nc = container_of(work, struct batadv_priv_nc, fwd_work);
+	bat_priv = container_of(priv_nc, struct batadv_priv, nc);
+
+	batadv_nc_fwd_process(bat_priv);
+}
+
 /**
  * batadv_nc_worker() - periodic task for house keeping related to network
  *  coding
@@ -728,16 +992,23 @@ static void batadv_nc_worker(struct work_struct *work)
 	bat_priv = container_of(priv_nc, struct batadv_priv, nc);
 
 	batadv_nc_purge_orig_hash(bat_priv);
-	batadv_nc_purge_paths(bat_priv, bat_priv->nc.coding_hash,
-			      batadv_nc_to_purge_nc_path_coding);
-	batadv_nc_purge_paths(bat_priv, bat_priv->nc.decoding_hash,
-			      batadv_nc_to_purge_nc_path_decoding);
+
+	timeout = bat_priv->nc.max_fwd_delay;
+	if (batadv_hash_age_purge_begin(bat_priv->nc.coding_hash, timeout * 10))
+		batadv_nc_purge_paths(bat_priv, bat_priv->nc.coding_hash,
+				      batadv_nc_to_purge_nc_path_coding);
+
+	timeout = bat_priv->nc.max_buffer_time;
+	if (batadv_hash_age_purge_begin(bat_priv->nc.decoding_hash,
+					timeout * 10))
+		batadv_nc_purge_paths(bat_priv, bat_priv->nc.decoding_hash,
+				      batadv_nc_to_purge_nc_path_decoding);
 
 	timeout = bat_priv->nc.max_fwd_delay;
 
 	if (batadv_has_timed_out(bat_priv->nc.timestamp_fwd_flush, timeout)) {
-		batadv_nc_process_nc_paths(bat_priv, bat_priv->nc.coding_hash,
-					   batadv_nc_fwd_flush);
+		/* normally done by the forward timer already */
+		batadv_nc_fwd_process(bat_priv);
 		bat_priv->nc.timestamp_fwd_flush = jiffies;
 	}
 
@@ -1037,13 +1308,66 @@ static u8 batadv_nc_random_weight_tq(u8 tq)
  * @dst: byte array to XOR into
  * @src: byte array to XOR from
  * @len: length of destination array
+ *
+ * The bulk of the data is processed in native machine words. Only the bytes
+ * in front of the first word aligned destination address and the remaining
+ * tail are XORed byte by byte. The source does not have to share the
+ * alignment of the destination.
+ */
+static void batadv_nc_memxor(u8 *dst, const u8 *src, unsigned int len)
+{
+	unsigned long *dst_word;
+
+	while (len && !IS_ALIGNED((unsigned long)dst, sizeof(*dst_word))) {
+		*dst++ ^= *src++;
+		len--;
+	}
+
+	while (len >= sizeof(*dst_word)) {
+		dst_word = (unsigned long *)dst;
+		*dst_word ^= get_unaligned((const unsigned long *)src);
+
+		dst += sizeof(*dst_word);
+		src += sizeof(*dst_word);
+		len -= sizeof(*dst_word);
+	}
+
+	while (len--)
+		*dst++ ^= *src++;
+}
+
+/**
+ * batadv_nc_skb_xor() - XOR skb data into a linear destination buffer
+ * @dst: byte array to XOR into
+ * @skb: skb to XOR from
+ * @offset: offset of the first byte in @skb to XOR from
+ * @len: number of bytes to XOR
+ *
+ * The source data may be spread over the paged fragments of @skb and
+ * therefore doesn't have to be linearized first. XORing stops early when
+ * @skb holds less than @offset + @len bytes.
  */
-static void batadv_nc_memxor(char *dst, const char *src, unsigned int len)
+static void batadv_nc_skb_xor(u8 *dst, struct sk_buff *skb,
+			      unsigned int offset, unsigned int len)
 {
-	unsigned int i;
+	struct skb_seq_state st;
+	unsigned int consumed = 0;
+	unsigned int block_len;
+	const u8 *block;
+
+	skb_prepare_seq_read(skb, offset, offset + len, &st);
+
+	while (consumed < len) {
+		block_len = skb_seq_read(consumed, &block, &st);
+		if (!block_len)
+			return;
 
-	for (i = 0; i < len; ++i)
-		dst[i] ^= src[i];
+		block_len = min(block_len, len - consumed);
+		batadv_nc_memxor(dst + consumed, block, block_len);
+		consumed += block_len;
+	}
+
+	skb_abort_seq_read(&st);
 }
 
 /**
@@ -1151,7 +1475,10 @@ static bool batadv_nc_code_packets(struct batadv_priv *bat_priv,
 	/* coding_len is used when decoding the packet shorter packet */
 	coding_len = skb_src->len - unicast_size;
 
-	if (skb_linearize(skb_dest) < 0 || skb_linearize(skb_src) < 0)
+	/* only the destination is modified, skb_src is read by
+	 * batadv_nc_skb_xor() which handles paged data
+	 */
+	if (skb_linearize(skb_dest) < 0)
 		goto out;
 
 	skb_push(skb_dest, header_add);
@@ -1179,8 +1506,8 @@ static bool batadv_nc_code_packets(struct batadv_priv *bat_priv,
 	coded_packet->coded_len = htons(coding_len);
 
 	/* This is where the magic happens: Code skb_src into skb_dest */
-	batadv_nc_memxor(skb_dest->data + coded_size,
-			 skb_src->data + unicast_size, coding_len);
+	batadv_nc_skb_xor(skb_dest->data + coded_size, skb_src, unicast_size,
+			  coding_len);
 
 	/* Update counters accordingly */
 	if (BATADV_SKB_CB(skb_src)->decoded &&
@@ -1239,6 +1566,147 @@ out:
 	return res;
 }
 
+/**
+ * batadv_nc_weighted_tq() - get the randomly weighted link quality towards the
+ *  destination of a coded packet
+ * @neigh_node: next hop of the packet
+ *
+ * Return: the weighted tq or 0 if no route is known
+ */
+static u8 batadv_nc_weighted_tq(struct batadv_neigh_node *neigh_node)
+{
+	struct batadv_neigh_ifinfo *router_ifinfo;
+	struct batadv_neigh_node *router;
+	u8 tq = 0;
+
+	router = batadv_orig_router_get(neigh_node->orig_node,
+					BATADV_IF_DEFAULT);
+	if (!router)
+		return tq;
+
+	router_ifinfo = batadv_neigh_ifinfo_get(router, BATADV_IF_DEFAULT);
+	if (router_ifinfo) {
+		tq = batadv_nc_random_weight_tq(router_ifinfo->bat_iv.tq_avg);
+		batadv_neigh_ifinfo_put(router_ifinfo);
+	}
+
+	batadv_neigh_node_put(router);
+	return tq;
+}
+
+/**
+ * batadv_nc_code_multi() - code a received unicast_packet with several nc
+ *  packets into a multi coded packet and send it
+ * @bat_priv: the bat priv with all the soft interface information
+ * @skb: data skb to forward
+ * @ethhdr: pointer to the ethernet header inside the skb
+ * @nc_packets: the buffered packets the skb is coded with
+ * @num: number of packets in nc_packets
+ * @neigh_node: next hop to forward skb to
+ *
+ * All packets are XORed into the largest one. The receiver with the weakest
+ * link is selected for the MAC header, all other receivers overhear the coded
+ * packet.
+ *
+ * Return: true if all packets are consumed, false otherwise.
+ */
+static bool batadv_nc_code_multi(struct batadv_priv *bat_priv,
+				 struct sk_buff *skb,
+				 struct ethhdr *ethhdr,
+				 struct batadv_nc_packet **nc_packets,
+				 int num,
+				 struct batadv_neigh_node *neigh_node)
+{
+	struct batadv_coded_multi_entry entries[BATADV_NC_MULTI_MAX];
+	struct batadv_neigh_node *dests[BATADV_NC_MULTI_MAX];
+	struct sk_buff *skbs[BATADV_NC_MULTI_MAX];
+	struct batadv_coded_multi_packet *coded_packet;
+	struct batadv_unicast_packet *unicast_packet;
+	struct batadv_neigh_node *mac_dest = NULL;
+	int unicast_size = sizeof(*unicast_packet);
+	int coded_size, header_add;
+	struct sk_buff *skb_dest;
+	int i, total = num + 1;
+	size_t count = 0;
+	u8 tq, tq_min = 0;
+	int dest = 0;
+
+	skbs[0] = skb;
+	dests[0] = neigh_node;
+	ether_addr_copy(entries[0].source, ethhdr->h_source);
+	entries[0].crc = batadv_skb_crc32(skb, skb->data + unicast_size);
+
+	for (i = 0; i < num; i++) {
+		skbs[i + 1] = nc_packets[i]->skb;
+		dests[i + 1] = nc_packets[i]->neigh_node;
+		ether_addr_copy(entries[i + 1].source,
+				nc_packets[i]->nc_path->prev_hop);
+		entries[i + 1].crc = nc_packets[i]->packet_id;
+	}
+
+	for (i = 0; i < total; i++) {
+		unicast_packet = (struct batadv_unicast_packet *)skbs[i]->data;
+		ether_addr_copy(entries[i].dest, dests[i]->addr);
+		ether_addr_copy(entries[i].orig_dest, unicast_packet->dest);
+		entries[i].ttl = unicast_packet->ttl;
+		entries[i].ttvn = unicast_packet->ttvn;
+		entries[i].len = htons(skbs[i]->len - unicast_size);
+		count += skbs[i]->len + ETH_HLEN;
+
+		/* Instead of zero padding, we code into the largest packet */
+		if (skbs[i]->len > skbs[dest]->len)
+			dest = i;
+
+		tq = batadv_nc_weighted_tq(dests[i]);
+		if (!mac_dest || tq < tq_min) {
+			mac_dest = dests[i];
+			tq_min = tq;
+		}
+	}
+
+	coded_size = sizeof(*coded_packet) + total * sizeof(entries[0]);
+	header_add = coded_size - unicast_size;
+	skb_dest = skbs[dest];
+
+	if (skb_linearize(skb_dest) < 0)
+		return false;
+
+	if (skb_cow_head(skb_dest, header_add) < 0)
+		return false;
+
+	skb_push(skb_dest, header_add);
+	skb_reset_mac_header(skb_dest);
+
+	coded_packet = (struct batadv_coded_multi_packet *)skb_dest->data;
+	coded_packet->packet_type = BATADV_CODED_MULTI;
+	coded_packet->version = BATADV_COMPAT_VERSION;
+	coded_packet->num_packets = total;
+	coded_packet->reserved = 0;
+	memcpy(coded_packet + 1, entries, total * sizeof(entries[0]));
+
+	for (i = 0; i < total; i++) {
+		if (i == dest)
+			continue;
+
+		batadv_nc_skb_xor(skb_dest->data + coded_size, skbs[i],
+				  unicast_size, ntohs(entries[i].len));
+		consume_skb(skbs[i]);
+	}
+
+	/* the skbs are either consumed or sent as coded packet */
+	for (i = 0; i < num; i++) {
+		nc_packets[i]->skb = NULL;
+		batadv_nc_packet_free(nc_packets[i], false);
+	}
+
+	/* recoded packets are never part of a multi coded packet */
+	batadv_add_counter(bat_priv, BATADV_CNT_NC_CODE, total);
+	batadv_add_counter(bat_priv, BATADV_CNT_NC_CODE_BYTES, count);
+
+	batadv_send_unicast_skb(skb_dest, mac_dest);
+	return true;
+}
+
 /**
  * batadv_nc_skb_coding_possible() - true if a decoded skb is available at dst.
  * @skb: data skb to forward
@@ -1264,52 +1732,76 @@ static bool batadv_nc_skb_coding_possible(struct sk_buff *skb, u8 *dst, u8 *src)
 }
 
 /**
- * batadv_nc_path_search() - Find the coding path matching in_nc_node and
- *  out_nc_node to retrieve a buffered packet that can be used for coding.
+ * batadv_nc_out_node_known() - check whether a node overhears an originator
+ * @orig_node: the originator which is overheard
+ * @addr: address of the node which may overhear orig_node
+ *
+ * Has to be called with rcu_read_lock held.
+ *
+ * Return: true if addr is in the out_coding_list of orig_node
+ */
+static bool batadv_nc_out_node_known(struct batadv_orig_node *orig_node,
+				     const u8 *addr)
+{
+	struct batadv_nc_node *out_nc_node;
+
+	list_for_each_entry_rcu(out_nc_node, &orig_node->out_coding_list, list) {
+		if (batadv_compare_eth(out_nc_node->addr, addr))
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * batadv_nc_index_search() - Find a buffered packet which was received from
+ *  in_nc_node and can be coded with the skb
  * @bat_priv: the bat priv with all the soft interface information
  * @in_nc_node: pointer to skb next hop's neighbor nc node
- * @out_nc_node: pointer to skb source's neighbor nc node
+ * @orig_node: the skb's sender (may be equal to the originator)
  * @skb: data skb to forward
  * @eth_dst: next hop mac address of skb
+ * @eth_src: source mac address of skb
+ *
+ * Only the coding paths of in_nc_node which are holding packets are looked
+ * at. The next hop of such a path has to overhear the sender of the skb.
+ * Paths found empty are dropped from the index on the way.
+ *
+ * Has to be called with rcu_read_lock held.
  *
- * Return: true if coding of a decoded skb is allowed.
+ * Return: an nc packet if a suitable coding packet was found, NULL otherwise.
  */
 static struct batadv_nc_packet *
-batadv_nc_path_search(struct batadv_priv *bat_priv,
-		      struct batadv_nc_node *in_nc_node,
-		      struct batadv_nc_node *out_nc_node,
-		      struct sk_buff *skb,
-		      u8 *eth_dst)
+batadv_nc_index_search(struct batadv_priv *bat_priv,
+		       struct batadv_nc_node *in_nc_node,
+		       struct batadv_orig_node *orig_node,
+		       struct sk_buff *skb,
+		       u8 *eth_dst,
+		       u8 *eth_src)
 {
-	struct batadv_nc_path *nc_path, nc_path_key;
 	struct batadv_nc_packet *nc_packet_out = NULL;
 	struct batadv_nc_packet *nc_packet, *nc_packet_tmp;
-	struct batadv_hashtable *hash = bat_priv->nc.coding_hash;
-	int idx;
-
-	if (!hash)
-		return NULL;
-
-	/* Create almost path key */
-	batadv_nc_hash_key_gen(&nc_path_key, in_nc_node->addr,
-			       out_nc_node->addr);
-	idx = batadv_nc_hash_choose(&nc_path_key, hash->size);
+	struct batadv_nc_path *nc_path;
+	struct hlist_node *node_tmp;
+	bool empty;
 
-	/* Check for coding opportunities in this nc_path */
-	rcu_read_lock();
-	hlist_for_each_entry_rcu(nc_path, &hash->table[idx], hash_entry) {
+	spin_lock_bh(&bat_priv->nc.coding_index_lock);
+	hash_for_each_possible_safe(bat_priv->nc.coding_index, nc_path,
+				    node_tmp, index_entry,
+				    batadv_nc_index_key(in_nc_node->addr)) {
 		if (!batadv_compare_eth(nc_path->prev_hop, in_nc_node->addr))
 			continue;
 
-		if (!batadv_compare_eth(nc_path->next_hop, out_nc_node->addr))
+		if (!batadv_nc_out_node_known(orig_node, nc_path->next_hop))
 			continue;
 
-		spin_lock_bh(&nc_path->packet_list_lock);
-		if (list_empty(&nc_path->packet_list)) {
-			spin_unlock_bh(&nc_path->packet_list_lock);
+		/* Check if the skb is decoded and if recoding is possible */
+		if (!batadv_nc_skb_coding_possible(skb, nc_path->next_hop,
+						   eth_src))
 			continue;
-		}
 
+		spin_lock_bh(&nc_path->packet_list_lock);
+		batadv_nc_path_splice(nc_path);
 		list_for_each_entry_safe(nc_packet, nc_packet_tmp,
 					 &nc_path->packet_list, list) {
 			if (!batadv_nc_skb_coding_possible(nc_packet->skb,
@@ -1322,59 +1814,211 @@ batadv_nc_path_search(struct batadv_priv *bat_priv,
 			nc_packet_out = nc_packet;
 			break;
 		}
-
+		empty = batadv_nc_path_empty(nc_path);
 		spin_unlock_bh(&nc_path->packet_list_lock);
-		break;
+
+		if (empty)
+			batadv_nc_index_del(nc_path);
+
+		if (nc_packet_out)
+			break;
 	}
-	rcu_read_unlock();
+	spin_unlock_bh(&bat_priv->nc.coding_index_lock);
 
 	return nc_packet_out;
 }
 
 /**
- * batadv_nc_skb_src_search() - Loops through the list of neighoring nodes of
- *  the skb's sender (may be equal to the originator).
+ * batadv_nc_overhears() - check whether a node overhears the packets of a
+ *  sender
  * @bat_priv: the bat priv with all the soft interface information
- * @skb: data skb to forward
- * @eth_dst: next hop mac address of skb
- * @eth_src: source mac address of skb
- * @in_nc_node: pointer to skb next hop's neighbor nc node
+ * @addr: address of the node which may overhear the sender
+ * @sender: address of the sender
  *
- * Return: an nc packet if a suitable coding packet was found, NULL otherwise.
+ * Has to be called with rcu_read_lock held.
+ *
+ * Return: true if addr is the sender itself or overhears it
  */
-static struct batadv_nc_packet *
-batadv_nc_skb_src_search(struct batadv_priv *bat_priv,
-			 struct sk_buff *skb,
-			 u8 *eth_dst,
-			 u8 *eth_src,
-			 struct batadv_nc_node *in_nc_node)
+static bool batadv_nc_overhears(struct batadv_priv *bat_priv, const u8 *addr,
+				const u8 *sender)
 {
 	struct batadv_orig_node *orig_node;
-	struct batadv_nc_node *out_nc_node;
-	struct batadv_nc_packet *nc_packet = NULL;
+	bool known;
+
+	if (batadv_compare_eth(addr, sender))
+		return true;
 
-	orig_node = batadv_orig_hash_find(bat_priv, eth_src);
+	orig_node = batadv_orig_hash_find(bat_priv, sender);
 	if (!orig_node)
-		return NULL;
+		return false;
+
+	known = batadv_nc_out_node_known(orig_node, addr);
+	batadv_orig_node_put(orig_node);
+
+	return known;
+}
+
+/**
+ * batadv_nc_multi_capable() - check whether a next hop decodes multi coded
+ *  packets
+ * @bat_priv: the bat priv with all the soft interface information
+ * @neigh_node: the next hop to check
+ *
+ * Return: true if the originator of the next hop announced the capability
+ */
+static bool batadv_nc_multi_capable(struct batadv_priv *bat_priv,
+				    struct batadv_neigh_node *neigh_node)
+{
+	struct batadv_orig_node *orig_node;
+	bool capable;
+
+	orig_node = batadv_orig_hash_find(bat_priv,
+					  neigh_node->hardif_neigh->orig);
+	if (!orig_node)
+		return false;
+
+	capable = test_bit(BATADV_ORIG_CAPA_HAS_NC_MULTI,
+			   &orig_node->capabilities);
+	batadv_orig_node_put(orig_node);
+
+	return capable;
+}
+
+/**
+ * batadv_nc_multi_path_fits() - check whether the packets of a path can join
+ *  a group of packets coded together
+ * @bat_priv: the bat priv with all the soft interface information
+ * @nc_path: the candidate path
+ * @eth_src: source mac address of the skb to forward
+ * @neigh_node: next hop of the skb to forward
+ * @nc_packets: the buffered packets already selected for coding
+ * @num: number of packets in nc_packets
+ *
+ * The next hop of the path has to overhear the senders of all selected packets
+ * and the next hops of all selected packets have to overhear the sender of the
+ * path. Every next hop may only receive a single packet of the group.
+ *
+ * Has to be called with rcu_read_lock held.
+ *
+ * Return: true if a packet of the path can be added to the group
+ */
+static bool batadv_nc_multi_path_fits(struct batadv_priv *bat_priv,
+				      struct batadv_nc_path *nc_path,
+				      u8 *eth_src,
+				      struct batadv_neigh_node *neigh_node,
+				      struct batadv_nc_packet **nc_packets,
+				      int num)
+{
+	struct batadv_nc_path *path;
+	int i;
+
+	if (batadv_compare_eth(nc_path->next_hop, neigh_node->addr))
+		return false;
+
+	if (!batadv_nc_overhears(bat_priv, nc_path->next_hop, eth_src))
+		return false;
+
+	if (!batadv_nc_overhears(bat_priv, neigh_node->addr,
+				 nc_path->prev_hop))
+		return false;
+
+	for (i = 0; i < num; i++) {
+		path = nc_packets[i]->nc_path;
+
+		if (batadv_compare_eth(nc_path->next_hop, path->next_hop))
+			return false;
+
+		if (!batadv_nc_overhears(bat_priv, nc_path->next_hop,
+					 path->prev_hop))
+			return false;
+
+		if (!batadv_nc_overhears(bat_priv, path->next_hop,
+					 nc_path->prev_hop))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * batadv_nc_multi_search() - find further buffered packets which can be coded
+ *  together with a coding pair
+ * @bat_priv: the bat priv with all the soft interface information
+ * @skb: data skb to forward
+ * @ethhdr: pointer to the ethernet header inside the skb
+ * @neigh_node: next hop to forward skb to
+ * @nc_packets: array of BATADV_NC_MULTI_MAX - 1 buffered packets, the first
+ *  entry holds the coding partner of the skb
+ *
+ * Only packets which were not decoded by this node are coded with more than
+ * one partner and all next hops have to announce the capability to decode
+ * multi coded packets.
+ *
+ * Return: number of packets in nc_packets
+ */
+static int batadv_nc_multi_search(struct batadv_priv *bat_priv,
+				  struct sk_buff *skb,
+				  struct ethhdr *ethhdr,
+				  struct batadv_neigh_node *neigh_node,
+				  struct batadv_nc_packet **nc_packets)
+{
+	struct batadv_nc_packet *nc_packet, *nc_packet_tmp, *found;
+	struct batadv_nc_path *nc_path;
+	struct hlist_node *node_tmp;
+	bool empty;
+	int num = 1;
+	int bkt;
+
+	if (BATADV_SKB_CB(skb)->decoded ||
+	    BATADV_SKB_CB(nc_packets[0]->skb)->decoded)
+		return num;
+
+	if (!batadv_nc_multi_capable(bat_priv, neigh_node) ||
+	    !batadv_nc_multi_capable(bat_priv, nc_packets[0]->neigh_node))
+		return num;
 
 	rcu_read_lock();
-	list_for_each_entry_rcu(out_nc_node,
-				&orig_node->out_coding_list, list) {
-		/* Check if the skb is decoded and if recoding is possible */
-		if (!batadv_nc_skb_coding_possible(skb,
-						   out_nc_node->addr, eth_src))
+	spin_lock_bh(&bat_priv->nc.coding_index_lock);
+	hash_for_each_safe(bat_priv->nc.coding_index, bkt, node_tmp, nc_path,
+			   index_entry) {
+		if (num == BATADV_NC_MULTI_MAX - 1)
+			break;
+
+		if (!batadv_nc_multi_path_fits(bat_priv, nc_path,
+					       ethhdr->h_source, neigh_node,
+					       nc_packets, num))
 			continue;
 
-		/* Search for an opportunity in this nc_path */
-		nc_packet = batadv_nc_path_search(bat_priv, in_nc_node,
-						  out_nc_node, skb, eth_dst);
-		if (nc_packet)
+		found = NULL;
+		spin_lock_bh(&nc_path->packet_list_lock);
+		batadv_nc_path_splice(nc_path);
+		list_for_each_entry_safe(nc_packet, nc_packet_tmp,
+					 &nc_path->packet_list, list) {
+			/* all packets of the path share the next hop */
+			if (!batadv_nc_multi_capable(bat_priv,
+						     nc_packet->neigh_node))
+				break;
+
+			if (BATADV_SKB_CB(nc_packet->skb)->decoded)
+				continue;
+
+			list_del(&nc_packet->list);
+			found = nc_packet;
 			break;
+		}
+		empty = batadv_nc_path_empty(nc_path);
+		spin_unlock_bh(&nc_path->packet_list_lock);
+
+		if (empty)
+			batadv_nc_index_del(nc_path);
+
+		if (found)
+			nc_packets[num++] = found;
 	}
+	spin_unlock_bh(&bat_priv->nc.coding_index_lock);
 	rcu_read_unlock();
 
-	batadv_orig_node_put(orig_node);
-	return nc_packet;
+	return num;
 }
 
 /**
@@ -1432,15 +2076,27 @@ static bool batadv_nc_skb_dst_search(struct sk_buff *skb,
 	struct net_device *netdev = neigh_node->if_incoming->soft_iface;
 	struct batadv_priv *bat_priv = netdev_priv(netdev);
 	struct batadv_orig_node *orig_node = neigh_node->orig_node;
+	struct batadv_orig_node *src_orig_node;
+	struct batadv_nc_packet *nc_packets[BATADV_NC_MULTI_MAX - 1];
 	struct batadv_nc_node *nc_node;
 	struct batadv_nc_packet *nc_packet = NULL;
+	int num, i;
+
+	/* nothing is buffered which could be coded with the skb */
+	if (hash_empty(bat_priv->nc.coding_index))
+		return false;
+
+	src_orig_node = batadv_orig_hash_find(bat_priv, ethhdr->h_source);
+	if (!src_orig_node)
+		return false;
 
 	rcu_read_lock();
 	list_for_each_entry_rcu(nc_node, &orig_node->in_coding_list, list) {
 		/* Search for coding opportunity with this in_nc_node */
-		nc_packet = batadv_nc_skb_src_search(bat_priv, skb,
-						     neigh_node->addr,
-						     ethhdr->h_source, nc_node);
+		nc_packet = batadv_nc_index_search(bat_priv, nc_node,
+						   src_orig_node, skb,
+						   neigh_node->addr,
+						   ethhdr->h_source);
 
 		/* Opportunity was found, so stop searching */
 		if (nc_packet)
@@ -1448,25 +2104,41 @@ static bool batadv_nc_skb_dst_search(struct sk_buff *skb,
 	}
 	rcu_read_unlock();
 
+	batadv_orig_node_put(src_orig_node);
+
 	if (!nc_packet)
 		return false;
 
+	/* Try to add further packets to the coding pair */
+	nc_packets[0] = nc_packet;
+	num = batadv_nc_multi_search(bat_priv, skb, ethhdr, neigh_node,
+				     nc_packets);
+
 	/* Save packets for later decoding */
 	batadv_nc_skb_store_before_coding(bat_priv, skb,
 					  neigh_node->addr);
-	batadv_nc_skb_store_before_coding(bat_priv, nc_packet->skb,
-					  nc_packet->neigh_node->addr);
+	for (i = 0; i < num; i++) {
+		nc_packet = nc_packets[i];
+		batadv_nc_skb_store_before_coding(bat_priv, nc_packet->skb,
+						  nc_packet->neigh_node->addr);
+	}
 
 	/* Code and send packets */
-	if (batadv_nc_code_packets(bat_priv, skb, ethhdr, nc_packet,
-				   neigh_node))
+	if (num > 1) {
+		if (batadv_nc_code_multi(bat_priv, skb, ethhdr, nc_packets,
+					 num, neigh_node))
+			return true;
+	} else if (batadv_nc_code_packets(bat_priv, skb, ethhdr,
+					  nc_packets[0], neigh_node)) {
 		return true;
+	}
 
-	/* out of mem ? Coding failed - we have to free the buffered packet
+	/* out of mem ? Coding failed - we have to free the buffered packets
 	 * to avoid memleaks. The skb passed as argument will be dealt with
 	 * by the calling function.
 	 */
-	batadv_nc_send_packet(nc_packet);
+	for (i = 0; i < num; i++)
+		batadv_nc_send_packet(nc_packets[i]);
 	return false;
 }
 
@@ -1476,31 +2148,34 @@ static bool batadv_nc_skb_dst_search(struct sk_buff *skb,
  * @nc_path: path to add skb to
  * @neigh_node: next hop to forward packet to
  * @packet_id: checksum to identify packet
+ * @deadline: time at which a packet buffered for coding is forwarded uncoded
+ *
+ * The packet is added without taking the packet list lock of the path. It is
+ * moved to the packet list by the next reader of the path.
  *
  * Return: true if the packet was buffered or false in case of an error.
  */
 static bool batadv_nc_skb_add_to_path(struct sk_buff *skb,
 				      struct batadv_nc_path *nc_path,
 				      struct batadv_neigh_node *neigh_node,
-				      __be32 packet_id)
+				      __be32 packet_id, ktime_t deadline)
 {
 	struct batadv_nc_packet *nc_packet;
 
-	nc_packet = kzalloc(sizeof(*nc_packet), GFP_ATOMIC);
+	nc_packet = kmem_cache_zalloc(batadv_nc_packet_cache, GFP_ATOMIC);
 	if (!nc_packet)
 		return false;
 
 	/* Initialize nc_packet */
 	nc_packet->timestamp = jiffies;
+	nc_packet->deadline = deadline;
 	nc_packet->packet_id = packet_id;
 	nc_packet->skb = skb;
 	nc_packet->neigh_node = neigh_node;
 	nc_packet->nc_path = nc_path;
 
 	/* Add coding packet to list */
-	spin_lock_bh(&nc_path->packet_list_lock);
-	list_add_tail(&nc_packet->list, &nc_path->packet_list);
-	spin_unlock_bh(&nc_path->packet_list_lock);
+	llist_add(&nc_packet->llnode, &nc_path->packet_llist);
 
 	return true;
 }
@@ -1522,6 +2197,7 @@ bool batadv_nc_skb_forward(struct sk_buff *skb,
 	struct batadv_nc_path *nc_path;
 	struct ethhdr *ethhdr = eth_hdr(skb);
 	__be32 packet_id;
+	ktime_t deadline;
 	u8 *payload;
 
 	/* Check if network coding is enabled */
@@ -1549,9 +2225,15 @@ bool batadv_nc_skb_forward(struct sk_buff *skb,
 
 	/* Add skb to nc_path */
 	packet_id = batadv_skb_crc32(skb, payload + sizeof(*packet));
-	if (!batadv_nc_skb_add_to_path(skb, nc_path, neigh_node, packet_id))
+	deadline = ktime_add_ms(ktime_get(), bat_priv->nc.max_fwd_delay);
+	if (!batadv_nc_skb_add_to_path(skb, nc_path, neigh_node, packet_id,
+				       deadline))
 		goto free_nc_path;
 
+	/* make the buffered packet visible to the coding opportunity search */
+	batadv_nc_index_add(bat_priv, nc_path);
+	batadv_nc_fwd_timer_arm(bat_priv, deadline);
+
 	/* Packet is consumed */
 	return true;
 
@@ -1573,7 +2255,7 @@ void batadv_nc_skb_store_for_decoding(struct batadv_priv *bat_priv,
 {
 	struct batadv_unicast_packet *packet;
 	struct batadv_nc_path *nc_path;
-	struct ethhdr *ethhdr = eth_hdr(skb);
+	struct ethhdr *ethhdr;
 	__be32 packet_id;
 	u8 *payload;
 
@@ -1587,6 +2269,18 @@ void batadv_nc_skb_store_for_decoding(struct batadv_priv *bat_priv,
 	if (packet->packet_type != BATADV_UNICAST)
 		goto out;
 
+	/* the stored copy has to match the frame on the air, which carries the
+	 * checksum the device would only fill in for the sent skb
+	 */
+	if (skb->ip_summed == CHECKSUM_PARTIAL) {
+		if (skb_checksum_help(skb) < 0)
+			goto out;
+
+		payload = skb_network_header(skb);
+	}
+
+	ethhdr = eth_hdr(skb);
+
 	/* Find existing nc_path or create a new */
 	nc_path = batadv_nc_get_path(bat_priv,
 				     bat_priv->nc.decoding_hash,
@@ -1609,7 +2303,8 @@ void batadv_nc_skb_store_for_decoding(struct batadv_priv *bat_priv,
 
 	/* Add skb to nc_path */
 	packet_id = batadv_skb_crc32(skb, payload + sizeof(*packet));
-	if (!batadv_nc_skb_add_to_path(skb, nc_path, NULL, packet_id))
+	if (!batadv_nc_skb_add_to_path(skb, nc_path, NULL, packet_id,
+				       ktime_set(0, 0)))
 		goto free_skb;
 
 	batadv_inc_counter(bat_priv, BATADV_CNT_NC_BUFFER);
@@ -1714,9 +2409,8 @@ batadv_nc_skb_decode_packet(struct batadv_priv *bat_priv, struct sk_buff *skb,
 	/* Here the magic is reversed:
 	 *   extract the missing packet from the received coded packet
 	 */
-	batadv_nc_memxor(skb->data + h_size,
-			 nc_packet->skb->data + h_size,
-			 coding_len);
+	batadv_nc_skb_xor(skb->data + h_size, nc_packet->skb, h_size,
+			  coding_len);
 
 	/* Resize decoded skb if decoded with larger packet */
 	if (nc_packet->skb->len > coding_len + h_size) {
@@ -1738,61 +2432,56 @@ batadv_nc_skb_decode_packet(struct batadv_priv *bat_priv, struct sk_buff *skb,
 }
 
 /**
- * batadv_nc_find_decoding_packet() - search through buffered decoding data to
- *  find the data needed to decode the coded packet
+ * batadv_nc_find_decoding_id() - search through buffered decoding data for a
+ *  packet with the given checksum
  * @bat_priv: the bat priv with all the soft interface information
- * @ethhdr: pointer to the ethernet header inside the coded packet
- * @coded: coded packet we try to find decode data for
+ * @source: sender of the buffered packet
+ * @dest: receiver of the buffered packet (the coding relay)
+ * @packet_id: checksum of the buffered packet
  *
  * Return: pointer to nc packet if the needed data was found or NULL otherwise.
  */
 static struct batadv_nc_packet *
-batadv_nc_find_decoding_packet(struct batadv_priv *bat_priv,
-			       struct ethhdr *ethhdr,
-			       struct batadv_coded_packet *coded)
+batadv_nc_find_decoding_id(struct batadv_priv *bat_priv, const u8 *source,
+			   const u8 *dest, __be32 packet_id)
 {
 	struct batadv_hashtable *hash = bat_priv->nc.decoding_hash;
 	struct batadv_nc_packet *tmp_nc_packet, *nc_packet = NULL;
 	struct batadv_nc_path *nc_path, nc_path_key;
-	u8 *dest, *source;
-	__be32 packet_id;
-	int index;
+	struct hlist_head *head;
+	unsigned int seq;
 
 	if (!hash)
 		return NULL;
 
-	/* Select the correct packet id based on the location of our mac-addr */
-	dest = ethhdr->h_source;
-	if (!batadv_is_my_mac(bat_priv, coded->second_dest)) {
-		source = coded->second_source;
-		packet_id = coded->second_crc;
-	} else {
-		source = coded->first_source;
-		packet_id = coded->first_crc;
-	}
-
 	batadv_nc_hash_key_gen(&nc_path_key, source, dest);
-	index = batadv_nc_hash_choose(&nc_path_key, hash->size);
 
 	/* Search for matching coding path */
 	rcu_read_lock();
-	hlist_for_each_entry_rcu(nc_path, &hash->table[index], hash_entry) {
-		/* Find matching nc_packet */
-		spin_lock_bh(&nc_path->packet_list_lock);
-		list_for_each_entry(tmp_nc_packet,
-				    &nc_path->packet_list, list) {
-			if (packet_id == tmp_nc_packet->packet_id) {
-				list_del(&tmp_nc_packet->list);
+	do {
+		seq = batadv_hash_read_begin(hash);
+		head = batadv_hash_head_rcu(hash, batadv_nc_hash_choose,
+					    &nc_path_key);
 
-				nc_packet = tmp_nc_packet;
-				break;
+		hlist_for_each_entry_rcu(nc_path, head, hash_entry) {
+			/* Find matching nc_packet */
+			spin_lock_bh(&nc_path->packet_list_lock);
+			batadv_nc_path_splice(nc_path);
+			list_for_each_entry(tmp_nc_packet,
+					    &nc_path->packet_list, list) {
+				if (packet_id == tmp_nc_packet->packet_id) {
+					list_del(&tmp_nc_packet->list);
+
+					nc_packet = tmp_nc_packet;
+					break;
+				}
 			}
-		}
-		spin_unlock_bh(&nc_path->packet_list_lock);
+			spin_unlock_bh(&nc_path->packet_list_lock);
 
-		if (nc_packet)
-			break;
-	}
+			if (nc_packet)
+				break;
+		}
+	} while (!nc_packet && batadv_hash_read_retry(hash, seq));
 	rcu_read_unlock();
 
 	if (!nc_packet)
@@ -1802,6 +2491,36 @@ batadv_nc_find_decoding_packet(struct batadv_priv *bat_priv,
 	return nc_packet;
 }
 
+/**
+ * batadv_nc_find_decoding_packet() - search through buffered decoding data to
+ *  find the data needed to decode the coded packet
+ * @bat_priv: the bat priv with all the soft interface information
+ * @ethhdr: pointer to the ethernet header inside the coded packet
+ * @coded: coded packet we try to find decode data for
+ *
+ * Return: pointer to nc packet if the needed data was found or NULL otherwise.
+ */
+static struct batadv_nc_packet *
+batadv_nc_find_decoding_packet(struct batadv_priv *bat_priv,
+			       struct ethhdr *ethhdr,
+			       struct batadv_coded_packet *coded)
+{
+	u8 *dest, *source;
+	__be32 packet_id;
+
+	/* Select the correct packet id based on the location of our mac-addr */
+	dest = ethhdr->h_source;
+	if (!batadv_is_my_mac(bat_priv, coded->second_dest)) {
+		source = coded->second_source;
+		packet_id = coded->second_crc;
+	} else {
+		source = coded->first_source;
+		packet_id = coded->first_crc;
+	}
+
+	return batadv_nc_find_decoding_id(bat_priv, source, dest, packet_id);
+}
+
 /**
  * batadv_nc_recv_coded_packet() - try to decode coded packet and enqueue the
  *  resulting unicast packet
@@ -1848,13 +2567,12 @@ static int batadv_nc_recv_coded_packet(struct sk_buff *skb,
 		goto free_skb;
 	}
 
-	/* Make skb's linear, because decoding accesses the entire buffer */
+	/* Make skb linear, because decoding modifies the entire buffer. The
+	 * buffered packet is only read and may stay fragmented.
+	 */
 	if (skb_linearize(skb) < 0)
 		goto free_nc_packet;
 
-	if (skb_linearize(nc_packet->skb) < 0)
-		goto free_nc_packet;
-
 	/* Decode the packet */
 	unicast_packet = batadv_nc_skb_decode_packet(bat_priv, skb, nc_packet);
 	if (!unicast_packet) {
@@ -1877,6 +2595,195 @@ free_skb:
 	return NET_RX_DROP;
 }
 
+/**
+ * batadv_nc_skb_decode_multi() - decode a received multi coded packet
+ * @skb: linear skb holding the multi coded packet
+ * @entries: copy of the packet descriptors of the coded packet
+ * @num: number of packets coded into the skb
+ * @own: index of the descriptor addressed to this node
+ * @nc_packets: the buffered packets matching the descriptors (NULL for the
+ *  own descriptor)
+ *
+ * Return: pointer to the decoded unicast packet or NULL on failure
+ */
+static struct batadv_unicast_packet *
+batadv_nc_skb_decode_multi(struct sk_buff *skb,
+			   struct batadv_coded_multi_entry *entries, int num,
+			   int own, struct batadv_nc_packet **nc_packets)
+{
+	const int h_size = sizeof(struct batadv_unicast_packet);
+	struct batadv_unicast_packet *unicast_packet;
+	struct ethhdr *ethhdr, ethhdr_tmp;
+	unsigned int coded_size, len;
+	int i;
+
+	coded_size = sizeof(struct batadv_coded_multi_packet);
+	coded_size += num * sizeof(entries[0]);
+	len = ntohs(entries[own].len);
+	if (coded_size + len > skb->len)
+		return NULL;
+
+	/* Save header temporarily */
+	memcpy(&ethhdr_tmp, skb_mac_header(skb), sizeof(ethhdr_tmp));
+
+	if (skb_cow(skb, 0) < 0)
+		return NULL;
+
+	/* Here the magic is reversed:
+	 *   remove all other packets from the coded payload
+	 */
+	for (i = 0; i < num; i++) {
+		if (i == own)
+			continue;
+
+		batadv_nc_skb_xor(skb->data + coded_size, nc_packets[i]->skb,
+				  h_size, min_t(unsigned int, len,
+						ntohs(entries[i].len)));
+	}
+
+	if (unlikely(!skb_pull_rcsum(skb, coded_size - h_size)))
+		return NULL;
+
+	if (pskb_trim_rcsum(skb, h_size + len))
+		return NULL;
+
+	/* Data points to batman header, so set mac header 14 bytes before
+	 * and network to data
+	 */
+	skb_set_mac_header(skb, -ETH_HLEN);
+	skb_reset_network_header(skb);
+
+	/* Reconstruct original mac header - unless we are the MAC destination
+	 * the packet was overheard
+	 */
+	ethhdr = eth_hdr(skb);
+	*ethhdr = ethhdr_tmp;
+	ether_addr_copy(ethhdr->h_dest, entries[own].dest);
+	skb->pkt_type = PACKET_HOST;
+
+	/* Create decoded unicast packet */
+	unicast_packet = (struct batadv_unicast_packet *)skb->data;
+	unicast_packet->packet_type = BATADV_UNICAST;
+	unicast_packet->version = BATADV_COMPAT_VERSION;
+	unicast_packet->ttl = entries[own].ttl;
+	ether_addr_copy(unicast_packet->dest, entries[own].orig_dest);
+	unicast_packet->ttvn = entries[own].ttvn;
+
+	return unicast_packet;
+}
+
+/**
+ * batadv_nc_recv_coded_multi_packet() - try to decode and receive a multi
+ *  coded packet
+ * @skb: incoming coded packet
+ * @recv_if: pointer to interface this packet was received on
+ *
+ * All packets but the one addressed to this node have to be found in the
+ * decoding buffer.
+ *
+ * Return: NET_RX_SUCCESS if the packet has been consumed or NET_RX_DROP
+ * otherwise.
+ */
+static int batadv_nc_recv_coded_multi_packet(struct sk_buff *skb,
+					     struct batadv_hard_iface *recv_if)
+{
+	struct batadv_priv *bat_priv = netdev_priv(recv_if->soft_iface);
+	struct batadv_nc_packet *nc_packets[BATADV_NC_MULTI_MAX] = { NULL };
+	struct batadv_coded_multi_entry entries[BATADV_NC_MULTI_MAX];
+	struct batadv_coded_multi_packet *coded_packet;
+	struct batadv_unicast_packet *unicast_packet;
+	int hdr_size = sizeof(*coded_packet);
+	struct ethhdr *ethhdr;
+	int num, own = -1;
+	int i;
+
+	/* Check if network coding is enabled */
+	if (!atomic_read(&bat_priv->network_coding))
+		goto free_skb;
+
+	/* Make sure we can access (and remove) header */
+	if (unlikely(!pskb_may_pull(skb, hdr_size)))
+		goto free_skb;
+
+	coded_packet = (struct batadv_coded_multi_packet *)skb->data;
+	num = coded_packet->num_packets;
+	if (num < 2 || num > BATADV_NC_MULTI_MAX)
+		goto free_skb;
+
+	hdr_size += num * sizeof(entries[0]);
+	if (unlikely(!pskb_may_pull(skb, hdr_size)))
+		goto free_skb;
+
+	coded_packet = (struct batadv_coded_multi_packet *)skb->data;
+	memcpy(entries, coded_packet + 1, num * sizeof(entries[0]));
+	ethhdr = eth_hdr(skb);
+
+	/* Verify one of the packets is destined for us */
+	for (i = 0; i < num; i++) {
+		if (batadv_is_my_mac(bat_priv, entries[i].dest)) {
+			own = i;
+			break;
+		}
+	}
+
+	if (own < 0)
+		goto free_skb;
+
+	/* Update stat counter */
+	if (!batadv_is_my_mac(bat_priv, ethhdr->h_dest))
+		batadv_inc_counter(bat_priv, BATADV_CNT_NC_SNIFFED);
+
+	/* All other packets are needed to decode ours */
+	for (i = 0; i < num; i++) {
+		if (i == own)
+			continue;
+
+		nc_packets[i] = batadv_nc_find_decoding_id(bat_priv,
+							   entries[i].source,
+							   ethhdr->h_source,
+							   entries[i].crc);
+		if (!nc_packets[i]) {
+			batadv_inc_counter(bat_priv,
+					   BATADV_CNT_NC_DECODE_FAILED);
+			goto free_nc_packets;
+		}
+	}
+
+	/* Make skb linear, because decoding modifies the entire buffer */
+	if (skb_linearize(skb) < 0)
+		goto free_nc_packets;
+
+	/* Decode the packet */
+	unicast_packet = batadv_nc_skb_decode_multi(skb, entries, num, own,
+						    nc_packets);
+	if (!unicast_packet) {
+		batadv_inc_counter(bat_priv, BATADV_CNT_NC_DECODE_FAILED);
+		goto free_nc_packets;
+	}
+
+	for (i = 0; i < num; i++) {
+		if (nc_packets[i])
+			batadv_nc_packet_free(nc_packets[i], false);
+	}
+
+	/* Mark packet as decoded to do correct recoding when forwarding */
+	BATADV_SKB_CB(skb)->decoded = true;
+	batadv_inc_counter(bat_priv, BATADV_CNT_NC_DECODE);
+	batadv_add_counter(bat_priv, BATADV_CNT_NC_DECODE_BYTES,
+			   skb->len + ETH_HLEN);
+	return batadv_recv_unicast_packet(skb, recv_if);
+
+free_nc_packets:
+	for (i = 0; i < num; i++) {
+		if (nc_packets[i])
+			batadv_nc_packet_free(nc_packets[i], true);
+	}
+free_skb:
+	kfree_skb(skb);
+
+	return NET_RX_DROP;
+}
+
 /**
  * batadv_nc_mesh_free() - clean up network coding memory
  * @bat_priv: the bat priv with all the soft interface information
@@ -1884,9 +2791,17 @@ free_skb:
 void batadv_nc_mesh_free(struct batadv_priv *bat_priv)
 {
 	batadv_tvlv_container_unregister(bat_priv, BATADV_TVLV_NC, 1);
+	batadv_tvlv_container_unregister(bat_priv, BATADV_TVLV_NC, 2);
 	batadv_tvlv_handler_unregister(bat_priv, BATADV_TVLV_NC, 1);
+	batadv_tvlv_handler_unregister(bat_priv, BATADV_TVLV_NC, 2);
 	cancel_delayed_work_sync(&bat_priv->nc.work);
 
+	/* the forward work may arm the timer again */
+	hrtimer_cancel(&bat_priv->nc.fwd_timer);
+	cancel_work_sync(&bat_priv->nc.fwd_work);
+	hrtimer_cancel(&bat_priv->nc.fwd_timer);
+
+	batadv_nc_index_free(bat_priv);
 	batadv_nc_purge_paths(bat_priv, bat_priv->nc.coding_hash, NULL);
 	batadv_hash_destroy(bat_priv->nc.coding_hash);
 	batadv_nc_purge_paths(bat_priv, bat_priv->nc.decoding_hash, NULL);
@@ -1917,11 +2832,10 @@ int batadv_nc_nodes_seq_print_text(struct seq_file *seq, void *offset)
 		goto out;
 
 	/* Traverse list of originators */
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-
+	for (i = 0; i < batadv_hash_size(hash); i++) {
 		/* For each orig_node in this bin */
 		rcu_read_lock();
+		head = batadv_hash_bucket_rcu(hash, i);
 		hlist_for_each_entry_rcu(orig_node, head, hash_entry) {
 			/* no need to print the orig node if it does not have
 			 * network coding neighbors
@@ -1991,3 +2905,29 @@ out:
 	return -ENOMEM;
 }
 #endif
+
+/**
+ * batadv_nc_cache_init() - Initialize network coding packet memory object cache
+ *
+ * Return: 0 on success or negative error number in case of failure.
+ */
+int __init batadv_nc_cache_init(void)
+{
+	size_t size = sizeof(struct batadv_nc_packet);
+
+	batadv_nc_packet_cache =
+		kmem_cache_create("batadv_nc_packet_cache", size, 0,
+				  SLAB_HWCACHE_ALIGN, NULL);
+	if (!batadv_nc_packet_cache)
+		return -ENOMEM;
+
+	return 0;
+}
+
+/**
+ * batadv_nc_cache_destroy() - Destroy network coding packet memory object cache
+ */
+void batadv_nc_cache_destroy(void)
+{
+	kmem_cache_destroy(batadv_nc_packet_cache);
+}
@@ -53,6 +53,8 @@ void batadv_nc_skb_store_sniffed_unicast(struct batadv_priv *bat_priv,
 					 struct sk_buff *skb);
 int batadv_nc_nodes_seq_print_text(struct seq_file *seq, void *offset);
 int batadv_nc_init_debugfs(struct batadv_priv *bat_priv);
+int batadv_nc_cache_init(void);
+void batadv_nc_cache_destroy(void);
 
 #else /* ifdef CONFIG_BATMAN_ADV_NC */
 
@@ -128,6 +130,15 @@ static inline int batadv_nc_init_debugfs(struct batadv_priv *bat_priv)
 	return 0;
 }
 
+static inline int batadv_nc_cache_init(void)
+{
+	return 0;
+}
+
+static inline void batadv_nc_cache_destroy(void)
+{
+}
+
 #endif /* ifdef CONFIG_BATMAN_ADV_NC */
 
 #endif /* _NET_BATMAN_ADV_NETWORK_CODING_H_ */
@@ -20,9 +20,12 @@
 #include "main.h"
 
 #include <linux/atomic.h>
+#include <linux/cache.h>
 #include <linux/errno.h>
 #include <linux/etherdevice.h>
 #include <linux/gfp.h>
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
 #include <linux/kref.h>
@@ -35,13 +38,16 @@
 #include <linux/seq_file.h>
 #include <linux/skbuff.h>
 #include <linux/slab.h>
+#include <linux/sort.h>
 #include <linux/spinlock.h>
 #include <linux/stddef.h>
 #include <linux/workqueue.h>
+#include <net/genetlink.h>
 #include <net/sock.h>
 #include <uapi/linux/batman_adv.h>
 
 #include "bat_algo.h"
+#include "bitarray.h"
 #include "distributed-arp-table.h"
 #include "fragmentation.h"
 #include "gateway_client.h"
@@ -52,12 +58,18 @@
 #include "netlink.h"
 #include "network-coding.h"
 #include "routing.h"
+#include "send.h"
 #include "soft-interface.h"
+#include "trace.h"
 #include "translation-table.h"
 
 /* hash class keys */
 static struct lock_class_key batadv_orig_hash_lock_class_key;
 
+static struct kmem_cache *batadv_orig_cache __read_mostly;
+static struct kmem_cache *batadv_neigh_cache __read_mostly;
+static struct kmem_cache *batadv_neigh_ifinfo_cache __read_mostly;
+
 /**
  * batadv_orig_hash_find() - Find and return originator from orig_hash
  * @bat_priv: the bat priv with all the soft interface information
@@ -71,25 +83,27 @@ batadv_orig_hash_find(struct batadv_priv *bat_priv, const void *data)
 	struct batadv_hashtable *hash = bat_priv->orig_hash;
 	struct hlist_head *head;
 	struct batadv_orig_node *orig_node, *orig_node_tmp = NULL;
-	int index;
+	unsigned int seq;
 
 	if (!hash)
 		return NULL;
 
-	index = batadv_choose_orig(data, hash->size);
-	head = &hash->table[index];
-
 	rcu_read_lock();
-	hlist_for_each_entry_rcu(orig_node, head, hash_entry) {
-		if (!batadv_compare_eth(orig_node, data))
-			continue;
+	do {
+		seq = batadv_hash_read_begin(hash);
+		head = batadv_hash_head_rcu(hash, batadv_choose_orig, data);
 
-		if (!kref_get_unless_zero(&orig_node->refcount))
-			continue;
+		hlist_for_each_entry_rcu(orig_node, head, hash_entry) {
+			if (!batadv_compare_eth(orig_node, data))
+				continue;
 
-		orig_node_tmp = orig_node;
-		break;
-	}
+			if (!kref_get_unless_zero(&orig_node->refcount))
+				continue;
+
+			orig_node_tmp = orig_node;
+			break;
+		}
+	} while (!orig_node_tmp && batadv_hash_read_retry(hash, seq));
 	rcu_read_unlock();
 
 	return orig_node_tmp;
@@ -112,6 +126,22 @@ bool batadv_compare_orig(const struct hlist_node *node, const void *data2)
 	return batadv_compare_eth(data1, data2);
 }
 
+/**
+ * batadv_choose_orig_node() - Return the index of an orig_node in the hash
+ * @node: hash_entry of the orig_node
+ * @size: the size of the hash table
+ *
+ * Return: the hash index where the orig_node should be stored at
+ */
+static u32 batadv_choose_orig_node(const struct hlist_node *node, u32 size)
+{
+	const struct batadv_orig_node *orig_node;
+
+	orig_node = container_of(node, struct batadv_orig_node, hash_entry);
+
+	return batadv_choose_orig(orig_node->orig, size);
+}
+
 /**
  * batadv_orig_node_vlan_get() - get an orig_node_vlan object
  * @orig_node: the originator serving the VLAN
@@ -127,7 +157,7 @@ batadv_orig_node_vlan_get(struct batadv_orig_node *orig_node,
 	struct batadv_orig_node_vlan *vlan = NULL, *tmp;
 
 	rcu_read_lock();
-	hlist_for_each_entry_rcu(tmp, &orig_node->vlan_list, list) {
+	hash_for_each_possible_rcu(orig_node->vlan_hash, tmp, hash_entry, vid) {
 		if (tmp->vid != vid)
 			continue;
 
@@ -174,9 +204,11 @@ batadv_orig_node_vlan_new(struct batadv_orig_node *orig_node,
 
 	kref_init(&vlan->refcount);
 	vlan->vid = vid;
+	spin_lock_init(&vlan->tt.crc_lock);
 
 	kref_get(&vlan->refcount);
 	hlist_add_head_rcu(&vlan->list, &orig_node->vlan_list);
+	hash_add_rcu(orig_node->vlan_hash, &vlan->hash_entry, vid);
 
 out:
 	spin_unlock_bh(&orig_node->vlan_list_lock);
@@ -208,6 +240,163 @@ void batadv_orig_node_vlan_put(struct batadv_orig_node_vlan *orig_vlan)
 	kref_put(&orig_vlan->refcount, batadv_orig_node_vlan_release);
 }
 
+#ifdef CONFIG_BATMAN_ADV_DAT
+
+/**
+ * batadv_orig_dat_ring_free_rcu() - release the originators of a DAT ring and
+ *  free it
+ * @rcu: rcu pointer of the ring
+ */
+static void batadv_orig_dat_ring_free_rcu(struct rcu_head *rcu)
+{
+	struct batadv_orig_dat_ring *ring;
+	u32 i;
+
+	ring = container_of(rcu, struct batadv_orig_dat_ring, rcu);
+
+	for (i = 0; i < ring->num; i++)
+		batadv_orig_node_put(ring->nodes[i]);
+
+	kfree(ring);
+}
+
+/**
+ * batadv_orig_dat_ring_cmp() - compare the DHT addresses of two originators
+ * @a: pointer to the first originator pointer
+ * @b: pointer to the second originator pointer
+ *
+ * Return: <0, 0 or >0 when the DHT address of @a is smaller, equal or larger
+ * than the one of @b
+ */
+static int batadv_orig_dat_ring_cmp(const void *a, const void *b)
+{
+	const struct batadv_orig_node *orig_a = *(struct batadv_orig_node **)a;
+	const struct batadv_orig_node *orig_b = *(struct batadv_orig_node **)b;
+
+	return (int)orig_a->dat_addr - (int)orig_b->dat_addr;
+}
+
+/**
+ * batadv_orig_dat_ring_rebuild() - rebuild the DHT address sorted originator
+ *  index
+ * @work: work queue item
+ */
+static void batadv_orig_dat_ring_rebuild(struct work_struct *work)
+{
+	struct batadv_orig_dat_ring *ring, *ring_old;
+	struct batadv_orig_node *orig_node;
+	struct batadv_priv_dat *priv_dat;
+	struct batadv_priv *bat_priv;
+	struct batadv_hashtable *hash;
+	struct hlist_head *head;
+	u32 i, max;
+
+	priv_dat = container_of(work, struct batadv_priv_dat, ring_work);
+	bat_priv = container_of(priv_dat, struct batadv_priv, dat);
+	hash = bat_priv->orig_hash;
+
+	/* leave some room for originators added while filling the ring */
+	max = atomic_read(&hash->count) + 16;
+
+	ring = kmalloc(sizeof(*ring) + max * sizeof(ring->nodes[0]),
+		       GFP_KERNEL);
+	if (!ring)
+		return;
+
+	ring->num = 0;
+
+	rcu_read_lock();
+	batadv_hash_walk_begin(hash);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
+		head = batadv_hash_bucket_rcu(hash, i);
+		hlist_for_each_entry_rcu(orig_node, head, hash_entry) {
+			if (ring->num == max)
+				break;
+
+			if (!kref_get_unless_zero(&orig_node->refcount))
+				continue;
+
+			ring->nodes[ring->num++] = orig_node;
+		}
+	}
+	batadv_hash_walk_end(hash);
+	rcu_read_unlock();
+
+	/* the hash grew too fast, try again with a larger ring */
+	if (ring->num == max)
+		queue_work(bat_priv->event_wq, &bat_priv->dat.ring_work);
+
+	sort(ring->nodes, ring->num, sizeof(ring->nodes[0]),
+	     batadv_orig_dat_ring_cmp, NULL);
+
+	/* only modified by this work item on the ordered mesh workqueue or
+	 * after it was cancelled
+	 */
+	ring_old = rcu_dereference_protected(bat_priv->dat.ring, true);
+	rcu_assign_pointer(bat_priv->dat.ring, ring);
+
+	if (ring_old)
+		call_rcu(&ring_old->rcu, batadv_orig_dat_ring_free_rcu);
+}
+
+/**
+ * batadv_orig_dat_ring_schedule() - schedule an update of the DHT address
+ *  sorted originator index
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * Has to be called whenever an originator was added to or removed from the
+ * originator hash.
+ */
+void batadv_orig_dat_ring_schedule(struct batadv_priv *bat_priv)
+{
+	queue_work(bat_priv->event_wq, &bat_priv->dat.ring_work);
+}
+
+/**
+ * batadv_orig_dat_ring_init() - initialize the DHT address sorted originator
+ *  index
+ * @bat_priv: the bat priv with all the soft interface information
+ */
+static void batadv_orig_dat_ring_init(struct batadv_priv *bat_priv)
+{
+	RCU_INIT_POINTER(bat_priv->dat.ring, NULL);
+	INIT_WORK(&bat_priv->dat.ring_work, batadv_orig_dat_ring_rebuild);
+}
+
+/**
+ * batadv_orig_dat_ring_free() - free the DHT address sorted originator index
+ * @bat_priv: the bat priv with all the soft interface information
+ */
+static void batadv_orig_dat_ring_free(struct batadv_priv *bat_priv)
+{
+	struct batadv_orig_dat_ring *ring;
+
+	cancel_work_sync(&bat_priv->dat.ring_work);
+
+	ring = rcu_dereference_protected(bat_priv->dat.ring, true);
+	RCU_INIT_POINTER(bat_priv->dat.ring, NULL);
+
+	if (ring)
+		call_rcu(&ring->rcu, batadv_orig_dat_ring_free_rcu);
+
+	/* the originators referenced by the current and all previous rings
+	 * must be released while the mesh interface is still around
+	 */
+	rcu_barrier();
+}
+
+#else
+
+static void batadv_orig_dat_ring_init(struct batadv_priv *bat_priv)
+{
+}
+
+static void batadv_orig_dat_ring_free(struct batadv_priv *bat_priv)
+{
+}
+
+#endif /* CONFIG_BATMAN_ADV_DAT */
+
 /**
  * batadv_originator_init() - Initialize all originator structures
  * @bat_priv: the bat priv with all the soft interface information
@@ -219,7 +408,7 @@ int batadv_originator_init(struct batadv_priv *bat_priv)
 	if (bat_priv->orig_hash)
 		return 0;
 
-	bat_priv->orig_hash = batadv_hash_new(1024);
+	bat_priv->orig_hash = batadv_hash_new(128, batadv_choose_orig_node);
 
 	if (!bat_priv->orig_hash)
 		goto err;
@@ -227,8 +416,11 @@ int batadv_originator_init(struct batadv_priv *bat_priv)
 	batadv_hash_set_lock_class(bat_priv->orig_hash,
 				   &batadv_orig_hash_lock_class_key);
 
+	batadv_orig_dat_ring_init(bat_priv);
+
+	bat_priv->orig_purge_next = 0;
 	INIT_DELAYED_WORK(&bat_priv->orig_work, batadv_purge_orig);
-	queue_delayed_work(batadv_event_workqueue,
+	queue_delayed_work(bat_priv->event_wq,
 			   &bat_priv->orig_work,
 			   msecs_to_jiffies(BATADV_ORIG_WORK_PERIOD));
 
@@ -238,6 +430,19 @@ err:
 	return -ENOMEM;
 }
 
+/**
+ * batadv_neigh_ifinfo_free_rcu() - free the neigh_ifinfo
+ * @rcu: rcu pointer of the neigh_ifinfo
+ */
+static void batadv_neigh_ifinfo_free_rcu(struct rcu_head *rcu)
+{
+	struct batadv_neigh_ifinfo *neigh_ifinfo;
+
+	neigh_ifinfo = container_of(rcu, struct batadv_neigh_ifinfo, rcu);
+
+	kmem_cache_free(batadv_neigh_ifinfo_cache, neigh_ifinfo);
+}
+
 /**
  * batadv_neigh_ifinfo_release() - release neigh_ifinfo from lists and queue for
  *  free after rcu grace period
@@ -252,7 +457,7 @@ static void batadv_neigh_ifinfo_release(struct kref *ref)
 	if (neigh_ifinfo->if_outgoing != BATADV_IF_DEFAULT)
 		batadv_hardif_put(neigh_ifinfo->if_outgoing);
 
-	kfree_rcu(neigh_ifinfo, rcu);
+	call_rcu(&neigh_ifinfo->rcu, batadv_neigh_ifinfo_free_rcu);
 }
 
 /**
@@ -279,6 +484,8 @@ static void batadv_hardif_neigh_release(struct kref *ref)
 
 	spin_lock_bh(&hardif_neigh->if_incoming->neigh_list_lock);
 	hlist_del_init_rcu(&hardif_neigh->list);
+	hash_del_rcu(&hardif_neigh->hash_entry);
+	atomic_dec(&hardif_neigh->if_incoming->num_neighs);
 	spin_unlock_bh(&hardif_neigh->if_incoming->neigh_list_lock);
 
 	batadv_hardif_put(hardif_neigh->if_incoming);
@@ -295,6 +502,19 @@ void batadv_hardif_neigh_put(struct batadv_hardif_neigh_node *hardif_neigh)
 	kref_put(&hardif_neigh->refcount, batadv_hardif_neigh_release);
 }
 
+/**
+ * batadv_neigh_node_free_rcu() - free the neigh_node
+ * @rcu: rcu pointer of the neigh_node
+ */
+static void batadv_neigh_node_free_rcu(struct rcu_head *rcu)
+{
+	struct batadv_neigh_node *neigh_node;
+
+	neigh_node = container_of(rcu, struct batadv_neigh_node, rcu);
+
+	kmem_cache_free(batadv_neigh_cache, neigh_node);
+}
+
 /**
  * batadv_neigh_node_release() - release neigh_node from lists and queue for
  *  free after rcu grace period
@@ -317,7 +537,64 @@ static void batadv_neigh_node_release(struct kref *ref)
 
 	batadv_hardif_put(neigh_node->if_incoming);
 
-	kfree_rcu(neigh_node, rcu);
+	call_rcu(&neigh_node->rcu, batadv_neigh_node_free_rcu);
+}
+
+/**
+ * batadv_orig_bonding_set_free_rcu() - release the routers of a bonding set
+ *  and free it
+ * @rcu: rcu pointer of the bonding set
+ */
+static void batadv_orig_bonding_set_free_rcu(struct rcu_head *rcu)
+{
+	struct batadv_orig_bonding_set *bonding_set;
+	u32 i;
+
+	bonding_set = container_of(rcu, struct batadv_orig_bonding_set, rcu);
+
+	for (i = 0; i < bonding_set->num; i++)
+		batadv_neigh_node_put(bonding_set->cands[i].router);
+
+	kfree(bonding_set);
+}
+
+/**
+ * batadv_orig_bonding_set_free() - free a bonding set after the RCU grace
+ *  period
+ * @bonding_set: the bonding set to free (or NULL)
+ */
+void batadv_orig_bonding_set_free(struct batadv_orig_bonding_set *bonding_set)
+{
+	if (!bonding_set)
+		return;
+
+	call_rcu(&bonding_set->rcu, batadv_orig_bonding_set_free_rcu);
+}
+
+/**
+ * batadv_orig_bonding_set_replace() - replace the bonding candidates of an
+ *  originator
+ * @orig_node: the originator
+ * @bonding_set: the new bonding set (or NULL to drop the current one)
+ *
+ * Caller must hold orig_node->neigh_list_lock.
+ *
+ * Return: the previous bonding set which has to be released via
+ * batadv_orig_bonding_set_free()
+ */
+struct batadv_orig_bonding_set *
+batadv_orig_bonding_set_replace(struct batadv_orig_node *orig_node,
+				struct batadv_orig_bonding_set *bonding_set)
+{
+	struct batadv_orig_bonding_set *bonding_set_old;
+
+	lockdep_assert_held(&orig_node->neigh_list_lock);
+
+	bonding_set_old = rcu_dereference_protected(orig_node->bonding_set,
+						    true);
+	rcu_assign_pointer(orig_node->bonding_set, bonding_set);
+
+	return bonding_set_old;
 }
 
 /**
@@ -497,7 +774,7 @@ batadv_neigh_ifinfo_new(struct batadv_neigh_node *neigh,
 	if (neigh_ifinfo)
 		goto out;
 
-	neigh_ifinfo = kzalloc(sizeof(*neigh_ifinfo), GFP_ATOMIC);
+	neigh_ifinfo = kmem_cache_zalloc(batadv_neigh_ifinfo_cache, GFP_ATOMIC);
 	if (!neigh_ifinfo)
 		goto out;
 
@@ -554,6 +831,17 @@ batadv_neigh_node_get(const struct batadv_orig_node *orig_node,
 	return res;
 }
 
+/**
+ * batadv_hardif_neigh_key() - compute the neigh_hash key of a neighbour
+ * @neigh_addr: the address of the neighbour
+ *
+ * Return: the key of the neighbour in &batadv_hard_iface.neigh_hash
+ */
+static u32 batadv_hardif_neigh_key(const u8 *neigh_addr)
+{
+	return jhash(neigh_addr, ETH_ALEN, 0);
+}
+
 /**
  * batadv_hardif_neigh_create() - create a hardif neighbour node
  * @hard_iface: the interface this neighbour is connected to
@@ -583,17 +871,26 @@ batadv_hardif_neigh_create(struct batadv_hard_iface *hard_iface,
 
 	kref_get(&hard_iface->refcount);
 	INIT_HLIST_NODE(&hardif_neigh->list);
+	INIT_HLIST_NODE(&hardif_neigh->hash_entry);
 	ether_addr_copy(hardif_neigh->addr, neigh_addr);
 	ether_addr_copy(hardif_neigh->orig, orig_node->orig);
 	hardif_neigh->if_incoming = hard_iface;
 	hardif_neigh->last_seen = jiffies;
+	skb_queue_head_init(&hardif_neigh->agg_queue);
+	spin_lock_init(&hardif_neigh->agg_lock);
+	INIT_DELAYED_WORK(&hardif_neigh->agg_work, batadv_send_unicast_agg_work);
 
 	kref_init(&hardif_neigh->refcount);
 
 	if (bat_priv->algo_ops->neigh.hardif_init)
 		bat_priv->algo_ops->neigh.hardif_init(hardif_neigh);
 
+	batadv_topology_changed(bat_priv);
+
 	hlist_add_head_rcu(&hardif_neigh->list, &hard_iface->neigh_list);
+	hash_add_rcu(hard_iface->neigh_hash, &hardif_neigh->hash_entry,
+		     batadv_hardif_neigh_key(neigh_addr));
+	atomic_inc(&hard_iface->num_neighs);
 
 out:
 	spin_unlock_bh(&hard_iface->neigh_list_lock);
@@ -638,10 +935,11 @@ batadv_hardif_neigh_get(const struct batadv_hard_iface *hard_iface,
 			const u8 *neigh_addr)
 {
 	struct batadv_hardif_neigh_node *tmp_hardif_neigh, *hardif_neigh = NULL;
+	u32 key = batadv_hardif_neigh_key(neigh_addr);
 
 	rcu_read_lock();
-	hlist_for_each_entry_rcu(tmp_hardif_neigh,
-				 &hard_iface->neigh_list, list) {
+	hash_for_each_possible_rcu(hard_iface->neigh_hash, tmp_hardif_neigh,
+				   hash_entry, key) {
 		if (!batadv_compare_eth(tmp_hardif_neigh->addr, neigh_addr))
 			continue;
 
@@ -685,7 +983,8 @@ batadv_neigh_node_create(struct batadv_orig_node *orig_node,
 	if (!hardif_neigh)
 		goto out;
 
-	neigh_node = kzalloc(sizeof(*neigh_node), GFP_ATOMIC);
+	neigh_node = batadv_cache_zalloc(orig_node->bat_priv, batadv_neigh_cache,
+					 GFP_ATOMIC);
 	if (!neigh_node)
 		goto out;
 
@@ -908,7 +1207,8 @@ static void batadv_orig_node_free_rcu(struct rcu_head *rcu)
 		orig_node->bat_priv->algo_ops->orig.free(orig_node);
 
 	kfree(orig_node->tt_buff);
-	kfree(orig_node);
+	kfree(rcu_dereference_protected(orig_node->last_tvlv, 1));
+	kmem_cache_free(batadv_orig_cache, orig_node);
 }
 
 /**
@@ -923,7 +1223,7 @@ static void batadv_orig_node_release(struct kref *ref)
 	struct batadv_orig_node *orig_node;
 	struct batadv_orig_ifinfo *orig_ifinfo;
 	struct batadv_orig_node_vlan *vlan;
-	struct batadv_orig_ifinfo *last_candidate;
+	struct batadv_orig_bonding_set *bonding_set;
 
 	orig_node = container_of(ref, struct batadv_orig_node, refcount);
 
@@ -942,16 +1242,15 @@ static void batadv_orig_node_release(struct kref *ref)
 		batadv_orig_ifinfo_put(orig_ifinfo);
 	}
 
-	last_candidate = orig_node->last_bonding_candidate;
-	orig_node->last_bonding_candidate = NULL;
+	bonding_set = batadv_orig_bonding_set_replace(orig_node, NULL);
 	spin_unlock_bh(&orig_node->neigh_list_lock);
 
-	if (last_candidate)
-		batadv_orig_ifinfo_put(last_candidate);
+	batadv_orig_bonding_set_free(bonding_set);
 
 	spin_lock_bh(&orig_node->vlan_list_lock);
 	hlist_for_each_entry_safe(vlan, node_tmp, &orig_node->vlan_list, list) {
 		hlist_del_rcu(&vlan->list);
+		hash_del_rcu(&vlan->hash_entry);
 		batadv_orig_node_vlan_put(vlan);
 	}
 	spin_unlock_bh(&orig_node->vlan_list_lock);
@@ -989,20 +1288,18 @@ void batadv_originator_free(struct batadv_priv *bat_priv)
 		return;
 
 	cancel_delayed_work_sync(&bat_priv->orig_work);
+	batadv_orig_dat_ring_free(bat_priv);
 
 	bat_priv->orig_hash = NULL;
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-		list_lock = &hash->list_locks[i];
-
-		spin_lock_bh(list_lock);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
+		head = batadv_hash_lock_bucket(hash, i, &list_lock);
 		hlist_for_each_entry_safe(orig_node, node_tmp,
 					  head, hash_entry) {
-			hlist_del_rcu(&orig_node->hash_entry);
+			batadv_hash_del(hash, &orig_node->hash_entry);
 			batadv_orig_node_put(orig_node);
 		}
-		spin_unlock_bh(list_lock);
+		batadv_hash_unlock_bucket(hash, list_lock);
 	}
 
 	batadv_hash_destroy(hash);
@@ -1024,23 +1321,32 @@ struct batadv_orig_node *batadv_orig_node_new(struct batadv_priv *bat_priv,
 	struct batadv_orig_node *orig_node;
 	struct batadv_orig_node_vlan *vlan;
 	unsigned long reset_time;
-	int i;
+	int max_entries;
+
+	max_entries = atomic_read(&bat_priv->orig_max_entries);
+	if (max_entries > 0 &&
+	    atomic_read(&bat_priv->orig_hash->count) >= max_entries) {
+		batadv_inc_counter(bat_priv, BATADV_CNT_ORIG_LIMIT_DROP);
+		return NULL;
+	}
 
 	batadv_dbg(BATADV_DBG_BATMAN, bat_priv,
 		   "Creating new originator: %pM\n", addr);
 
-	orig_node = kzalloc(sizeof(*orig_node), GFP_ATOMIC);
+	orig_node = batadv_cache_zalloc(bat_priv, batadv_orig_cache, GFP_ATOMIC);
 	if (!orig_node)
 		return NULL;
 
 	INIT_HLIST_HEAD(&orig_node->neigh_list);
 	INIT_HLIST_HEAD(&orig_node->vlan_list);
+	hash_init(orig_node->vlan_hash);
 	INIT_HLIST_HEAD(&orig_node->ifinfo_list);
 	spin_lock_init(&orig_node->bcast_seqno_lock);
 	spin_lock_init(&orig_node->neigh_list_lock);
 	spin_lock_init(&orig_node->tt_buff_lock);
 	spin_lock_init(&orig_node->tt_lock);
 	spin_lock_init(&orig_node->vlan_list_lock);
+	spin_lock_init(&orig_node->last_tvlv_lock);
 
 	batadv_nc_init_orig(orig_node);
 
@@ -1051,11 +1357,16 @@ struct batadv_orig_node *batadv_orig_node_new(struct batadv_priv *bat_priv,
 	ether_addr_copy(orig_node->orig, addr);
 	batadv_dat_init_orig_node_addr(orig_node);
 	atomic_set(&orig_node->last_ttvn, 0);
+	atomic_set(&orig_node->tt_global_num, 0);
+	orig_node->tt_over_limit = false;
 	orig_node->tt_buff = NULL;
 	orig_node->tt_buff_len = 0;
 	orig_node->last_seen = jiffies;
+	orig_node->router_changed = jiffies;
+	RCU_INIT_POINTER(orig_node->last_tvlv, NULL);
 	reset_time = jiffies - 1 - msecs_to_jiffies(BATADV_RESET_PROTECTION_MS);
 	orig_node->bcast_seqno_reset = reset_time;
+	batadv_seqno_window_reset(&orig_node->bcast_window, 0);
 
 #ifdef CONFIG_BATMAN_ADV_MCAST
 	orig_node->mcast_flags = BATADV_NO_FLAGS;
@@ -1075,15 +1386,11 @@ struct batadv_orig_node *batadv_orig_node_new(struct batadv_priv *bat_priv,
 	 */
 	batadv_orig_node_vlan_put(vlan);
 
-	for (i = 0; i < BATADV_FRAG_BUFFER_COUNT; i++) {
-		INIT_HLIST_HEAD(&orig_node->fragments[i].fragment_list);
-		spin_lock_init(&orig_node->fragments[i].lock);
-		orig_node->fragments[i].size = 0;
-	}
+	spin_lock_init(&orig_node->frag_lock);
 
 	return orig_node;
 free_orig_node:
-	kfree(orig_node);
+	kmem_cache_free(batadv_orig_cache, orig_node);
 	return NULL;
 }
 
@@ -1139,6 +1446,7 @@ static bool
 batadv_purge_orig_ifinfo(struct batadv_priv *bat_priv,
 			 struct batadv_orig_node *orig_node)
 {
+	struct batadv_orig_bonding_set *bonding_set = NULL;
 	struct batadv_orig_ifinfo *orig_ifinfo;
 	struct batadv_hard_iface *if_outgoing;
 	struct hlist_node *node_tmp;
@@ -1169,14 +1477,16 @@ batadv_purge_orig_ifinfo(struct batadv_priv *bat_priv,
 
 		hlist_del_rcu(&orig_ifinfo->list);
 		batadv_orig_ifinfo_put(orig_ifinfo);
-		if (orig_node->last_bonding_candidate == orig_ifinfo) {
-			orig_node->last_bonding_candidate = NULL;
-			batadv_orig_ifinfo_put(orig_ifinfo);
-		}
 	}
 
+	/* the bonding candidates may use the router of a purged ifinfo */
+	if (ifinfo_purged)
+		bonding_set = batadv_orig_bonding_set_replace(orig_node, NULL);
+
 	spin_unlock_bh(&orig_node->neigh_list_lock);
 
+	batadv_orig_bonding_set_free(bonding_set);
+
 	return ifinfo_purged;
 }
 
@@ -1296,6 +1606,8 @@ static bool batadv_purge_orig_node(struct batadv_priv *bat_priv,
 			   "Originator timeout: originator %pM, last_seen %u\n",
 			   orig_node->orig,
 			   jiffies_to_msecs(orig_node->last_seen));
+		batadv_netlink_notify_orig(bat_priv, BATADV_EVENT_ORIG_DEL,
+					   orig_node->orig, NULL);
 		return true;
 	}
 	changed_ifinfo = batadv_purge_orig_ifinfo(bat_priv, orig_node);
@@ -1340,10 +1652,14 @@ static bool batadv_purge_orig_node(struct batadv_priv *bat_priv,
 }
 
 /**
- * batadv_purge_orig_ref() - Purge all outdated originators
+ * batadv_purge_orig_buckets() - Purge the outdated originators of a range of
+ *  orig_hash buckets
  * @bat_priv: the bat priv with all the soft interface information
+ * @first: index of the first bucket to purge
+ * @count: number of buckets to purge
  */
-void batadv_purge_orig_ref(struct batadv_priv *bat_priv)
+static void batadv_purge_orig_buckets(struct batadv_priv *bat_priv, u32 first,
+				      u32 count)
 {
 	struct batadv_hashtable *hash = bat_priv->orig_hash;
 	struct hlist_node *node_tmp;
@@ -1352,20 +1668,14 @@ void batadv_purge_orig_ref(struct batadv_priv *bat_priv)
 	struct batadv_orig_node *orig_node;
 	u32 i;
 
-	if (!hash)
-		return;
-
-	/* for all origins... */
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-		list_lock = &hash->list_locks[i];
-
-		spin_lock_bh(list_lock);
+	for (i = first; i - first < count && i < batadv_hash_size(hash); i++) {
+		head = batadv_hash_lock_bucket(hash, i, &list_lock);
 		hlist_for_each_entry_safe(orig_node, node_tmp,
 					  head, hash_entry) {
 			if (batadv_purge_orig_node(bat_priv, orig_node)) {
 				batadv_gw_node_delete(bat_priv, orig_node);
-				hlist_del_rcu(&orig_node->hash_entry);
+				batadv_hash_del(hash, &orig_node->hash_entry);
+				batadv_orig_dat_ring_schedule(bat_priv);
 				batadv_tt_global_del_orig(orig_node->bat_priv,
 							  orig_node, -1,
 							  "originator timed out");
@@ -1376,9 +1686,51 @@ void batadv_purge_orig_ref(struct batadv_priv *bat_priv)
 			batadv_frag_purge_orig(orig_node,
 					       batadv_frag_check_entry);
 		}
-		spin_unlock_bh(list_lock);
+		batadv_hash_unlock_bucket(hash, list_lock);
 	}
+}
+
+/**
+ * batadv_purge_orig_ref() - Purge all outdated originators
+ * @bat_priv: the bat priv with all the soft interface information
+ */
+void batadv_purge_orig_ref(struct batadv_priv *bat_priv)
+{
+	struct batadv_hashtable *hash = bat_priv->orig_hash;
+
+	if (!hash)
+		return;
+
+	/* for all origins... */
+	batadv_purge_orig_buckets(bat_priv, 0, batadv_hash_size(hash));
+
+	batadv_gw_election(bat_priv);
+}
+
+/**
+ * batadv_purge_orig_slice() - Purge the outdated originators of the next
+ *  slice of the orig_hash
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * A full sweep over the orig_hash is split into BATADV_ORIG_PURGE_SLICES runs
+ * of orig_work to limit the time a single run occupies the workqueue.
+ */
+static void batadv_purge_orig_slice(struct batadv_priv *bat_priv)
+{
+	struct batadv_hashtable *hash = bat_priv->orig_hash;
+	u32 size = batadv_hash_size(hash);
+	u32 slice = DIV_ROUND_UP(size, BATADV_ORIG_PURGE_SLICES);
+
+	batadv_purge_orig_buckets(bat_priv, bat_priv->orig_purge_next, slice);
+
+	/* the hash may have been resized in between, a sweep only has to
+	 * visit the buckets it finds
+	 */
+	bat_priv->orig_purge_next += slice;
+	if (bat_priv->orig_purge_next < size)
+		return;
 
+	bat_priv->orig_purge_next = 0;
 	batadv_gw_election(bat_priv);
 }
 
@@ -1386,13 +1738,19 @@ static void batadv_purge_orig(struct work_struct *work)
 {
 	struct delayed_work *delayed_work;
 	struct batadv_priv *bat_priv;
+	u64 start = 0;
+
+	if (trace_batadv_purge_orig_enabled())
+		start = batadv_trace_clock();
 
 	delayed_work = to_delayed_work(work);
 	bat_priv = container_of(delayed_work, struct batadv_priv, orig_work);
-	batadv_purge_orig_ref(bat_priv);
-	queue_delayed_work(batadv_event_workqueue,
+	batadv_purge_orig_slice(bat_priv);
+	trace_batadv_purge_orig(bat_priv->soft_iface, start);
+	queue_delayed_work(bat_priv->event_wq,
 			   &bat_priv->orig_work,
-			   msecs_to_jiffies(BATADV_ORIG_WORK_PERIOD));
+			   msecs_to_jiffies(BATADV_ORIG_WORK_PERIOD /
+					    BATADV_ORIG_PURGE_SLICES));
 }
 
 #ifdef CONFIG_BATMAN_ADV_DEBUGFS
@@ -1556,6 +1914,171 @@ int batadv_orig_dump(struct sk_buff *msg, struct netlink_callback *cb)
 	return ret;
 }
 
+/**
+ * batadv_orig_nexthop_dump_entry() - dump the next hop towards an originator
+ *  into a message
+ * @msg: buffer for the message
+ * @portid: netlink port
+ * @seq: Sequence number of netlink message
+ * @orig_node: originator to dump
+ *
+ * Originators without a router are skipped.
+ *
+ * Return: 0 or error code.
+ */
+static int
+batadv_orig_nexthop_dump_entry(struct sk_buff *msg, u32 portid, u32 seq,
+			       struct batadv_orig_node *orig_node)
+{
+	struct batadv_neigh_node *router;
+	void *hdr;
+	int ret = 0;
+
+	router = batadv_orig_router_get(orig_node, BATADV_IF_DEFAULT);
+	if (!router)
+		return 0;
+
+	hdr = genlmsg_put(msg, portid, seq, &batadv_netlink_family,
+			  NLM_F_MULTI, BATADV_CMD_GET_NEXTHOPS);
+	if (!hdr) {
+		ret = -ENOBUFS;
+		goto out;
+	}
+
+	if (nla_put(msg, BATADV_ATTR_ORIG_ADDRESS, ETH_ALEN, orig_node->orig) ||
+	    nla_put(msg, BATADV_ATTR_ROUTER, ETH_ALEN, router->addr) ||
+	    nla_put_u32(msg, BATADV_ATTR_HARD_IFINDEX,
+			router->if_incoming->net_dev->ifindex)) {
+		genlmsg_cancel(msg, hdr);
+		ret = -EMSGSIZE;
+		goto out;
+	}
+
+	genlmsg_end(msg, hdr);
+out:
+	batadv_neigh_node_put(router);
+	return ret;
+}
+
+/**
+ * batadv_orig_nexthop_dump_bucket() - dump the next hops of one bucket of the
+ *  originator hash into a message
+ * @msg: buffer for the message
+ * @portid: netlink port
+ * @seq: Sequence number of netlink message
+ * @hash: hash to dump
+ * @bucket: bucket index to dump
+ * @idx_skip: How many entries to skip
+ *
+ * Return: 0 or error code.
+ */
+static int
+batadv_orig_nexthop_dump_bucket(struct sk_buff *msg, u32 portid, u32 seq,
+				struct batadv_hashtable *hash, u32 bucket,
+				int *idx_skip)
+{
+	struct batadv_orig_node *orig_node;
+	struct hlist_head *head;
+	int idx = 0;
+
+	rcu_read_lock();
+	head = batadv_hash_bucket_rcu(hash, bucket);
+	hlist_for_each_entry_rcu(orig_node, head, hash_entry) {
+		if (idx < *idx_skip)
+			goto skip;
+
+		if (batadv_orig_nexthop_dump_entry(msg, portid, seq,
+						   orig_node)) {
+			rcu_read_unlock();
+			*idx_skip = idx;
+
+			return -EMSGSIZE;
+		}
+
+skip:
+		idx++;
+	}
+	rcu_read_unlock();
+
+	return 0;
+}
+
+/**
+ * batadv_orig_nexthop_dump() - dump the next hop towards every originator to a
+ *  netlink socket
+ * @msg: buffer for the message
+ * @cb: callback structure containing arguments
+ *
+ * Together with the BATADV_EVENT_ORIG_ROUTER events, this allows to mirror the
+ * forwarding decisions of the mesh interface outside of batman-adv, e.g. into
+ * the map of an XDP program forwarding transit unicast packets (see
+ * samples/batman-adv/).
+ *
+ * Return: message length.
+ */
+int batadv_orig_nexthop_dump(struct sk_buff *msg, struct netlink_callback *cb)
+{
+	struct batadv_hard_iface *primary_if = NULL;
+	int portid = NETLINK_CB(cb->skb).portid;
+	struct net *net = sock_net(cb->skb->sk);
+	struct net_device *soft_iface;
+	struct batadv_hashtable *hash;
+	struct batadv_priv *bat_priv;
+	int bucket = cb->args[0];
+	int idx = cb->args[1];
+	int start = msg->len;
+	int ifindex;
+	int ret = 0;
+
+	ifindex = batadv_netlink_get_ifindex(cb->nlh,
+					     BATADV_ATTR_MESH_IFINDEX);
+	if (!ifindex)
+		return -EINVAL;
+
+	soft_iface = dev_get_by_index(net, ifindex);
+	if (!soft_iface || !batadv_softif_is_valid(soft_iface)) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	bat_priv = netdev_priv(soft_iface);
+	hash = bat_priv->orig_hash;
+
+	primary_if = batadv_primary_if_get_selected(bat_priv);
+	if (!primary_if || primary_if->if_status != BATADV_IF_ACTIVE) {
+		ret = -ENOENT;
+		goto out;
+	}
+
+	cb->seq = batadv_hash_generation(hash) << 1 | 1;
+
+	while (bucket < batadv_hash_size(hash)) {
+		if (batadv_orig_nexthop_dump_bucket(msg, portid,
+						    cb->nlh->nlmsg_seq, hash,
+						    bucket, &idx))
+			break;
+
+		bucket++;
+		idx = 0;
+	}
+
+	batadv_netlink_dump_check(msg, cb, start);
+
+	cb->args[0] = bucket;
+	cb->args[1] = idx;
+
+	ret = msg->len;
+
+out:
+	if (primary_if)
+		batadv_hardif_put(primary_if);
+
+	if (soft_iface)
+		dev_put(soft_iface);
+
+	return ret;
+}
+
 /**
  * batadv_orig_hash_add_if() - Add interface to originators in orig_hash
  * @hard_iface: hard interface to add (already slave of the soft interface)
@@ -1574,27 +2097,30 @@ int batadv_orig_hash_add_if(struct batadv_hard_iface *hard_iface,
 	u32 i;
 	int ret;
 
-	/* resize all orig nodes because orig_node->bcast_own(_sum) depend on
-	 * if_num
-	 */
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
+	if (!bao->orig.add_if)
+		return 0;
 
+	/* resize all orig nodes because the algorithm private data may depend
+	 * on if_num
+	 */
+	batadv_hash_walk_begin(hash);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
 		rcu_read_lock();
+		head = batadv_hash_bucket_rcu(hash, i);
 		hlist_for_each_entry_rcu(orig_node, head, hash_entry) {
-			ret = 0;
-			if (bao->orig.add_if)
-				ret = bao->orig.add_if(orig_node, max_if_num);
+			ret = bao->orig.add_if(orig_node, max_if_num);
 			if (ret == -ENOMEM)
 				goto err;
 		}
 		rcu_read_unlock();
 	}
+	batadv_hash_walk_end(hash);
 
 	return 0;
 
 err:
 	rcu_read_unlock();
+	batadv_hash_walk_end(hash);
 	return -ENOMEM;
 }
 
@@ -1617,23 +2143,22 @@ int batadv_orig_hash_del_if(struct batadv_hard_iface *hard_iface,
 	u32 i;
 	int ret;
 
-	/* resize all orig nodes because orig_node->bcast_own(_sum) depend on
-	 * if_num
+	/* resize all orig nodes because the algorithm private data may depend
+	 * on if_num
 	 */
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-
+	batadv_hash_walk_begin(hash);
+	for (i = 0; bao->orig.del_if && i < batadv_hash_size(hash); i++) {
 		rcu_read_lock();
+		head = batadv_hash_bucket_rcu(hash, i);
 		hlist_for_each_entry_rcu(orig_node, head, hash_entry) {
-			ret = 0;
-			if (bao->orig.del_if)
-				ret = bao->orig.del_if(orig_node, max_if_num,
-						       hard_iface->if_num);
+			ret = bao->orig.del_if(orig_node, max_if_num,
+					       hard_iface->if_num);
 			if (ret == -ENOMEM)
 				goto err;
 		}
 		rcu_read_unlock();
 	}
+	batadv_hash_walk_end(hash);
 
 	/* renumber remaining batman interfaces _inside_ of orig_hash_lock */
 	rcu_read_lock();
@@ -1657,5 +2182,57 @@ int batadv_orig_hash_del_if(struct batadv_hard_iface *hard_iface,
 
 err:
 	rcu_read_unlock();
+	batadv_hash_walk_end(hash);
+	return -ENOMEM;
+}
+
+/**
+ * batadv_orig_cache_init() - Initialize originator memory object caches
+ *
+ * Return: 0 on success or negative error number in case of failure.
+ */
+int __init batadv_orig_cache_init(void)
+{
+	size_t orig_size = sizeof(struct batadv_orig_node);
+	size_t neigh_size = sizeof(struct batadv_neigh_node);
+	size_t neigh_ifinfo_size = sizeof(struct batadv_neigh_ifinfo);
+
+	batadv_orig_cache = kmem_cache_create("batadv_orig_cache", orig_size,
+					      0, SLAB_HWCACHE_ALIGN, NULL);
+	if (!batadv_orig_cache)
+		return -ENOMEM;
+
+	batadv_neigh_cache = kmem_cache_create("batadv_neigh_cache",
+					       neigh_size, 0,
+					       SLAB_HWCACHE_ALIGN, NULL);
+	if (!batadv_neigh_cache)
+		goto err_orig_destroy;
+
+	batadv_neigh_ifinfo_cache =
+		kmem_cache_create("batadv_neigh_ifinfo_cache",
+				  neigh_ifinfo_size, 0, SLAB_HWCACHE_ALIGN,
+				  NULL);
+	if (!batadv_neigh_ifinfo_cache)
+		goto err_neigh_destroy;
+
+	return 0;
+
+err_neigh_destroy:
+	kmem_cache_destroy(batadv_neigh_cache);
+	batadv_neigh_cache = NULL;
+err_orig_destroy:
+	kmem_cache_destroy(batadv_orig_cache);
+	batadv_orig_cache = NULL;
+
 	return -ENOMEM;
 }
+
+/**
+ * batadv_orig_cache_destroy() - Destroy originator memory object caches
+ */
+void batadv_orig_cache_destroy(void)
+{
+	kmem_cache_destroy(batadv_orig_cache);
+	kmem_cache_destroy(batadv_neigh_cache);
+	kmem_cache_destroy(batadv_neigh_ifinfo_cache);
+}
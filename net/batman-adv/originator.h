@@ -71,6 +71,7 @@ void batadv_orig_ifinfo_put(struct batadv_orig_ifinfo *orig_ifinfo);
 
 int batadv_orig_seq_print_text(struct seq_file *seq, void *offset);
 int batadv_orig_dump(struct sk_buff *msg, struct netlink_callback *cb);
+int batadv_orig_nexthop_dump(struct sk_buff *msg, struct netlink_callback *cb);
 int batadv_orig_hardif_seq_print_text(struct seq_file *seq, void *offset);
 int batadv_orig_hash_add_if(struct batadv_hard_iface *hard_iface,
 			    unsigned int max_if_num);
@@ -83,6 +84,21 @@ struct batadv_orig_node_vlan *
 batadv_orig_node_vlan_get(struct batadv_orig_node *orig_node,
 			  unsigned short vid);
 void batadv_orig_node_vlan_put(struct batadv_orig_node_vlan *orig_vlan);
+#ifdef CONFIG_BATMAN_ADV_DAT
+void batadv_orig_dat_ring_schedule(struct batadv_priv *bat_priv);
+#else
+static inline void batadv_orig_dat_ring_schedule(struct batadv_priv *bat_priv)
+{
+}
+#endif
+
+struct batadv_orig_bonding_set *
+batadv_orig_bonding_set_replace(struct batadv_orig_node *orig_node,
+				struct batadv_orig_bonding_set *bonding_set);
+void batadv_orig_bonding_set_free(struct batadv_orig_bonding_set *bonding_set);
+
+int batadv_orig_cache_init(void);
+void batadv_orig_cache_destroy(void);
 
 /**
  * batadv_choose_orig() - Return the index of the orig entry in the hash table
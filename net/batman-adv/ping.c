@@ -0,0 +1,642 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (C) 2018  B.A.T.M.A.N. contributors:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ping.h"
+#include "main.h"
+
+#include <linux/atomic.h>
+#include <linux/byteorder/generic.h>
+#include <linux/errno.h>
+#include <linux/etherdevice.h>
+#include <linux/gfp.h>
+#include <linux/if_ether.h>
+#include <linux/jiffies.h>
+#include <linux/kernel.h>
+#include <linux/kref.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+#include <linux/netdevice.h>
+#include <linux/netlink.h>
+#include <linux/pkt_sched.h>
+#include <linux/rculist.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/skbuff.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/stddef.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+#include <net/genetlink.h>
+#include <net/netlink.h>
+#include <uapi/linux/batadv_packet.h>
+#include <uapi/linux/batman_adv.h>
+
+#include "hard-interface.h"
+#include "netlink.h"
+#include "originator.h"
+#include "send.h"
+#include "soft-interface.h"
+
+/**
+ * batadv_ping_batch_free_rcu() - free a ping batch after an RCU grace period
+ * @rcu: rcu pointer of the ping batch
+ */
+static void batadv_ping_batch_free_rcu(struct rcu_head *rcu)
+{
+	struct batadv_ping_batch *batch;
+
+	batch = container_of(rcu, struct batadv_ping_batch, rcu);
+	kvfree(batch);
+}
+
+/**
+ * batadv_ping_batch_release() - release ping batch from lists and queue for
+ *  free after rcu grace period
+ * @ref: kref pointer of the ping batch
+ */
+static void batadv_ping_batch_release(struct kref *ref)
+{
+	struct batadv_ping_batch *batch;
+
+	batch = container_of(ref, struct batadv_ping_batch, refcount);
+	call_rcu(&batch->rcu, batadv_ping_batch_free_rcu);
+}
+
+/**
+ * batadv_ping_batch_put() - decrement the ping batch refcounter and possibly
+ *  release it
+ * @batch: ping batch to be free'd
+ */
+static void batadv_ping_batch_put(struct batadv_ping_batch *batch)
+{
+	kref_put(&batch->refcount, batadv_ping_batch_release);
+}
+
+/**
+ * batadv_ping_batch_get() - find the ping batch an ICMP sequence number
+ *  belongs to
+ * @bat_priv: the bat priv with all the soft interface information
+ * @seqno: ICMP sequence number of the echo request
+ *
+ * Return: ping batch with increased refcounter, NULL if none was found
+ */
+static struct batadv_ping_batch *
+batadv_ping_batch_get(struct batadv_priv *bat_priv, u16 seqno)
+{
+	struct batadv_ping_batch *batch, *batch_tmp = NULL;
+
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(batch, &bat_priv->ping_list, list) {
+		if ((u16)(seqno - batch->first_seqno) >= batch->num_probes)
+			continue;
+
+		if (!kref_get_unless_zero(&batch->refcount))
+			continue;
+
+		batch_tmp = batch;
+		break;
+	}
+	rcu_read_unlock();
+
+	return batch_tmp;
+}
+
+/**
+ * batadv_ping_probe_done() - store the result of an echo request
+ * @batch: the ping batch the echo request belongs to
+ * @probe: the echo request
+ * @status: result of the echo request
+ * @responder: originator which answered, NULL if none did
+ *
+ * Only the first result of each echo request is stored. The results are sent
+ * right away once all echo requests of the batch have one.
+ */
+static void batadv_ping_probe_done(struct batadv_ping_batch *batch,
+				   struct batadv_ping_probe *probe,
+				   enum batadv_ping_status status,
+				   const u8 *responder)
+{
+	struct batadv_priv *bat_priv = batch->bat_priv;
+
+	spin_lock_bh(&batch->lock);
+
+	if (batch->done || probe->status != BATADV_PING_TIMEOUT)
+		goto unlock;
+
+	probe->status = status;
+	if (responder) {
+		probe->rtt = ktime_us_delta(ktime_get(), probe->sent);
+		ether_addr_copy(probe->responder, responder);
+	}
+
+	batch->pending--;
+	if (!batch->pending)
+		mod_delayed_work(bat_priv->event_wq, &batch->finish_work, 0);
+
+unlock:
+	spin_unlock_bh(&batch->lock);
+}
+
+/**
+ * batadv_ping_recv() - handle an answer to an echo request of a ping batch
+ * @bat_priv: the bat priv with all the soft interface information
+ * @icmph: pointer to the header of the linear icmp packet
+ * @icmp_len: total length of the icmp packet
+ */
+void batadv_ping_recv(struct batadv_priv *bat_priv,
+		      struct batadv_icmp_header *icmph, size_t icmp_len)
+{
+	struct batadv_icmp_packet *icmp_packet;
+	struct batadv_ping_probe *probe;
+	struct batadv_ping_batch *batch;
+	enum batadv_ping_status status;
+	u16 seqno;
+
+	if (icmp_len < sizeof(*icmp_packet))
+		return;
+
+	icmp_packet = (struct batadv_icmp_packet *)icmph;
+
+	switch (icmp_packet->msg_type) {
+	case BATADV_ECHO_REPLY:
+		status = BATADV_PING_REPLY;
+		break;
+	case BATADV_DESTINATION_UNREACHABLE:
+		status = BATADV_PING_UNREACHABLE;
+		break;
+	case BATADV_TTL_EXCEEDED:
+		status = BATADV_PING_TTL_EXCEEDED;
+		break;
+	default:
+		return;
+	}
+
+	seqno = ntohs(icmp_packet->seqno);
+	batch = batadv_ping_batch_get(bat_priv, seqno);
+	if (!batch)
+		return;
+
+	probe = &batch->probes[(u16)(seqno - batch->first_seqno)];
+
+	/* only the destination itself can answer with an echo reply */
+	if (status == BATADV_PING_REPLY &&
+	    !batadv_compare_eth(icmp_packet->orig, probe->dst))
+		goto out;
+
+	batadv_ping_probe_done(batch, probe, status, icmp_packet->orig);
+
+out:
+	batadv_ping_batch_put(batch);
+}
+
+/**
+ * batadv_ping_send_probe() - send one echo request of a ping batch
+ * @batch: the ping batch the echo request belongs to
+ * @idx: index of the echo request in the batch
+ * @src: address of the primary interface of this node
+ */
+static void batadv_ping_send_probe(struct batadv_ping_batch *batch, u16 idx,
+				   const u8 *src)
+{
+	struct batadv_ping_probe *probe = &batch->probes[idx];
+	struct batadv_priv *bat_priv = batch->bat_priv;
+	struct batadv_icmp_packet *icmp_packet;
+	struct batadv_orig_node *orig_node;
+	struct sk_buff *skb;
+	int ret;
+
+	orig_node = batadv_orig_hash_find(bat_priv, probe->dst);
+	if (!orig_node)
+		goto unreachable;
+
+	skb = netdev_alloc_skb_ip_align(NULL, sizeof(*icmp_packet) + ETH_HLEN);
+	if (!skb) {
+		batadv_orig_node_put(orig_node);
+		goto unreachable;
+	}
+
+	skb->priority = TC_PRIO_CONTROL;
+	skb_reserve(skb, ETH_HLEN);
+	icmp_packet = skb_put(skb, sizeof(*icmp_packet));
+
+	icmp_packet->packet_type = BATADV_ICMP;
+	icmp_packet->version = BATADV_COMPAT_VERSION;
+	icmp_packet->ttl = probe->ttl;
+	icmp_packet->msg_type = BATADV_ECHO_REQUEST;
+	ether_addr_copy(icmp_packet->dst, probe->dst);
+	ether_addr_copy(icmp_packet->orig, src);
+	icmp_packet->uid = BATADV_ICMP_UID_PING;
+	icmp_packet->reserved = 0;
+	icmp_packet->seqno = htons(batch->first_seqno + idx);
+
+	probe->sent = ktime_get();
+
+	ret = batadv_send_skb_to_orig(skb, orig_node, NULL);
+	batadv_orig_node_put(orig_node);
+
+	if (ret >= 0 || ret == -EINPROGRESS)
+		return;
+
+unreachable:
+	batadv_ping_probe_done(batch, probe, BATADV_PING_UNREACHABLE, NULL);
+}
+
+/**
+ * batadv_ping_result_put() - put the result of an echo request into a message
+ * @msg: netlink message to put the result into
+ * @batch: the ping batch the echo request belongs to
+ * @probe: the echo request
+ *
+ * Return: 0 on success, -EMSGSIZE if the message is full
+ */
+static int batadv_ping_result_put(struct sk_buff *msg,
+				  struct batadv_ping_batch *batch,
+				  const struct batadv_ping_probe *probe)
+{
+	struct net_device *soft_iface = batch->bat_priv->soft_iface;
+	void *hdr;
+
+	hdr = genlmsg_put(msg, batch->portid, batch->seq,
+			  &batadv_netlink_family, NLM_F_MULTI,
+			  BATADV_CMD_PING);
+	if (!hdr)
+		return -EMSGSIZE;
+
+	if (nla_put_u32(msg, BATADV_ATTR_MESH_IFINDEX, soft_iface->ifindex) ||
+	    nla_put(msg, BATADV_ATTR_ORIG_ADDRESS, ETH_ALEN, probe->dst) ||
+	    nla_put_u8(msg, BATADV_ATTR_PING_TTL, probe->ttl) ||
+	    nla_put_u8(msg, BATADV_ATTR_PING_STATUS, probe->status))
+		goto nla_put_failure;
+
+	if (probe->status == BATADV_PING_REPLY ||
+	    probe->status == BATADV_PING_TTL_EXCEEDED) {
+		if (nla_put_u32(msg, BATADV_ATTR_PING_RTT, probe->rtt) ||
+		    nla_put(msg, BATADV_ATTR_PING_RESPONDER, ETH_ALEN,
+			    probe->responder))
+			goto nla_put_failure;
+	}
+
+	genlmsg_end(msg, hdr);
+	return 0;
+
+nla_put_failure:
+	genlmsg_cancel(msg, hdr);
+	return -EMSGSIZE;
+}
+
+/**
+ * batadv_ping_send_results() - send the results of a ping batch to the
+ *  netlink socket which started it
+ * @batch: the finished ping batch
+ *
+ * The results are sent as one multipart message, split over as many netlink
+ * messages as needed and terminated by NLMSG_DONE.
+ */
+static void batadv_ping_send_results(struct batadv_ping_batch *batch)
+{
+	struct net *net = dev_net(batch->bat_priv->soft_iface);
+	struct sk_buff *msg = NULL;
+	struct nlmsghdr *nlh;
+	u16 i = 0;
+
+	while (i < batch->num_probes) {
+		if (!msg) {
+			msg = nlmsg_new(NLMSG_GOODSIZE, GFP_KERNEL);
+			if (!msg)
+				return;
+		}
+
+		if (!batadv_ping_result_put(msg, batch, &batch->probes[i])) {
+			i++;
+			continue;
+		}
+
+		/* a single result has to fit into an empty message */
+		if (!msg->len)
+			goto err_free;
+
+		if (genlmsg_unicast(net, msg, batch->portid) < 0)
+			return;
+
+		msg = NULL;
+	}
+
+	if (!msg) {
+		msg = nlmsg_new(NLMSG_GOODSIZE, GFP_KERNEL);
+		if (!msg)
+			return;
+	}
+
+	nlh = nlmsg_put(msg, batch->portid, batch->seq, NLMSG_DONE,
+			sizeof(int), NLM_F_MULTI);
+	if (!nlh) {
+		if (genlmsg_unicast(net, msg, batch->portid) < 0)
+			return;
+
+		msg = nlmsg_new(NLMSG_GOODSIZE, GFP_KERNEL);
+		if (!msg)
+			return;
+
+		nlh = nlmsg_put(msg, batch->portid, batch->seq, NLMSG_DONE,
+				sizeof(int), NLM_F_MULTI);
+		if (!nlh)
+			goto err_free;
+	}
+
+	*(int *)nlmsg_data(nlh) = 0;
+	genlmsg_unicast(net, msg, batch->portid);
+	return;
+
+err_free:
+	nlmsg_free(msg);
+}
+
+/**
+ * batadv_ping_finish() - send the results of a ping batch
+ * @work: work queue item of the ping batch
+ *
+ * Runs when all echo requests of the batch have a result or the timeout
+ * expired. Echo requests without answer are reported as timed out.
+ */
+static void batadv_ping_finish(struct work_struct *work)
+{
+	struct delayed_work *delayed_work = to_delayed_work(work);
+	struct batadv_ping_batch *batch;
+	struct batadv_priv *bat_priv;
+	bool owner;
+
+	batch = container_of(delayed_work, struct batadv_ping_batch,
+			     finish_work);
+	bat_priv = batch->bat_priv;
+
+	spin_lock_bh(&batch->lock);
+	batch->done = true;
+	spin_unlock_bh(&batch->lock);
+
+	/* the last answer may have queued the work again while it was running
+	 * for the timeout
+	 */
+	cancel_delayed_work(&batch->finish_work);
+
+	spin_lock_bh(&bat_priv->ping_list_lock);
+	owner = !hlist_unhashed(&batch->list);
+	if (owner)
+		hlist_del_init_rcu(&batch->list);
+	spin_unlock_bh(&bat_priv->ping_list_lock);
+
+	/* the mesh is shut down and drops the batch itself */
+	if (!owner)
+		return;
+
+	batadv_ping_send_results(batch);
+	batadv_ping_batch_put(batch);
+}
+
+/**
+ * batadv_ping_batch_new() - create a ping batch from a BATADV_CMD_PING request
+ * @bat_priv: the bat priv with all the soft interface information
+ * @info: the netlink request
+ * @num_probes: number of echo requests of the batch
+ * @ttl: TTL of the echo requests, the maximum TTL for traceroutes
+ * @traceroute: whether one echo request per TTL is sent to each originator
+ *
+ * Return: the new ping batch, NULL on memory allocation errors
+ */
+static struct batadv_ping_batch *
+batadv_ping_batch_new(struct batadv_priv *bat_priv, struct genl_info *info,
+		      u16 num_probes, u8 ttl, bool traceroute)
+{
+	struct batadv_ping_batch *batch;
+	struct batadv_ping_probe *probe;
+	struct nlattr *attr;
+	size_t size;
+	u8 probe_ttl;
+	int rem;
+
+	size = sizeof(*batch) + num_probes * sizeof(*probe);
+	batch = kzalloc(size, GFP_KERNEL | __GFP_NOWARN);
+	if (!batch)
+		batch = vzalloc(size);
+	if (!batch)
+		return NULL;
+
+	kref_init(&batch->refcount);
+	spin_lock_init(&batch->lock);
+	INIT_DELAYED_WORK(&batch->finish_work, batadv_ping_finish);
+	batch->bat_priv = bat_priv;
+	batch->portid = info->snd_portid;
+	batch->seq = info->snd_seq;
+	batch->num_probes = num_probes;
+	batch->pending = num_probes;
+
+	probe = batch->probes;
+	nlmsg_for_each_attr(attr, info->nlhdr, GENL_HDRLEN, rem) {
+		if (nla_type(attr) != BATADV_ATTR_ORIG_ADDRESS)
+			continue;
+
+		probe_ttl = traceroute ? 1 : ttl;
+		for (; probe_ttl <= ttl; probe_ttl++) {
+			ether_addr_copy(probe->dst, nla_data(attr));
+			probe->ttl = probe_ttl;
+			probe->status = BATADV_PING_TIMEOUT;
+			probe++;
+		}
+	}
+
+	return batch;
+}
+
+/**
+ * batadv_ping_batch_add() - reserve the sequence numbers of a ping batch and
+ *  start its timeout
+ * @bat_priv: the bat priv with all the soft interface information
+ * @batch: the new ping batch
+ * @timeout: time in milliseconds to wait for the answers
+ *
+ * Return: 0 on success, -EBUSY if too many ping batches are running
+ */
+static int batadv_ping_batch_add(struct batadv_priv *bat_priv,
+				 struct batadv_ping_batch *batch, u32 timeout)
+{
+	struct batadv_ping_batch *batch_tmp;
+	unsigned int num_batches = 0;
+	u16 seqno;
+	int ret = -EBUSY;
+
+	spin_lock_bh(&bat_priv->ping_list_lock);
+
+	/* batadv_ping_free() may already have emptied the list */
+	if (atomic_read(&bat_priv->mesh_state) != BATADV_MESH_ACTIVE) {
+		ret = -ENOENT;
+		goto unlock;
+	}
+
+	seqno = bat_priv->ping_seqno;
+
+	hlist_for_each_entry(batch_tmp, &bat_priv->ping_list, list) {
+		if (++num_batches >= BATADV_PING_MAX_NUM)
+			goto unlock;
+
+		/* answers to a running batch must not be mistaken for ours */
+		if ((u16)(batch_tmp->first_seqno - seqno) < batch->num_probes ||
+		    (u16)(seqno - batch_tmp->first_seqno) <
+		    batch_tmp->num_probes)
+			goto unlock;
+	}
+
+	batch->first_seqno = seqno;
+	bat_priv->ping_seqno = seqno + batch->num_probes;
+
+	kref_get(&batch->refcount);
+	hlist_add_head_rcu(&batch->list, &bat_priv->ping_list);
+	queue_delayed_work(bat_priv->event_wq, &batch->finish_work,
+			   msecs_to_jiffies(timeout));
+	ret = 0;
+
+unlock:
+	spin_unlock_bh(&bat_priv->ping_list_lock);
+
+	return ret;
+}
+
+/**
+ * batadv_ping_start() - handle incoming BATADV_CMD_PING
+ * @skb: received netlink message
+ * @info: receiver information
+ *
+ * Sends an echo request to every originator given as
+ * BATADV_ATTR_ORIG_ADDRESS, or with BATADV_ATTR_PING_TRACEROUTE one echo
+ * request per TTL up to BATADV_ATTR_PING_TTL. The results are sent to the
+ * requesting socket as one multipart message with the sequence number of the
+ * request after all echo requests were answered or BATADV_ATTR_PING_TIMEOUT
+ * expired.
+ *
+ * Return: 0 on success, < 0 on error
+ */
+int batadv_ping_start(struct sk_buff *skb, struct genl_info *info)
+{
+	struct batadv_hard_iface *primary_if = NULL;
+	struct batadv_ping_batch *batch = NULL;
+	struct net *net = genl_info_net(info);
+	u32 timeout = BATADV_PING_DEF_TIMEOUT;
+	struct net_device *soft_iface;
+	struct batadv_priv *bat_priv;
+	unsigned int num_probes = 0;
+	struct nlattr *attr;
+	u8 ttl = BATADV_TTL;
+	bool traceroute;
+	int ifindex;
+	int ret;
+	int rem;
+	u16 i;
+
+	if (!info->attrs[BATADV_ATTR_MESH_IFINDEX] ||
+	    !info->attrs[BATADV_ATTR_ORIG_ADDRESS])
+		return -EINVAL;
+
+	ifindex = nla_get_u32(info->attrs[BATADV_ATTR_MESH_IFINDEX]);
+
+	if (info->attrs[BATADV_ATTR_PING_TIMEOUT])
+		timeout = nla_get_u32(info->attrs[BATADV_ATTR_PING_TIMEOUT]);
+
+	if (!timeout || timeout > BATADV_PING_MAX_TIMEOUT)
+		return -EINVAL;
+
+	if (info->attrs[BATADV_ATTR_PING_TTL])
+		ttl = nla_get_u8(info->attrs[BATADV_ATTR_PING_TTL]);
+
+	if (!ttl)
+		return -EINVAL;
+
+	traceroute = nla_get_flag(info->attrs[BATADV_ATTR_PING_TRACEROUTE]);
+
+	nlmsg_for_each_attr(attr, info->nlhdr, GENL_HDRLEN, rem) {
+		if (nla_type(attr) != BATADV_ATTR_ORIG_ADDRESS)
+			continue;
+
+		num_probes += traceroute ? ttl : 1;
+		if (num_probes > BATADV_PING_MAX_PROBES)
+			return -E2BIG;
+	}
+
+	soft_iface = dev_get_by_index(net, ifindex);
+	if (!soft_iface || !batadv_softif_is_valid(soft_iface)) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	bat_priv = netdev_priv(soft_iface);
+
+	primary_if = batadv_primary_if_get_selected(bat_priv);
+	if (!primary_if) {
+		ret = -ENOENT;
+		goto out;
+	}
+
+	batch = batadv_ping_batch_new(bat_priv, info, num_probes, ttl,
+				      traceroute);
+	if (!batch) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = batadv_ping_batch_add(bat_priv, batch, timeout);
+	if (ret < 0)
+		goto out;
+
+	for (i = 0; i < batch->num_probes; i++) {
+		batadv_ping_send_probe(batch, i,
+				       primary_if->net_dev->dev_addr);
+		cond_resched();
+	}
+
+out:
+	if (batch)
+		batadv_ping_batch_put(batch);
+	if (primary_if)
+		batadv_hardif_put(primary_if);
+	if (soft_iface)
+		dev_put(soft_iface);
+
+	return ret;
+}
+
+/**
+ * batadv_ping_free() - drop all running ping batches of a mesh
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * The results of the dropped batches are not sent anymore.
+ */
+void batadv_ping_free(struct batadv_priv *bat_priv)
+{
+	struct batadv_ping_batch *batch;
+
+	while (true) {
+		spin_lock_bh(&bat_priv->ping_list_lock);
+		batch = hlist_entry_safe(bat_priv->ping_list.first,
+					 struct batadv_ping_batch, list);
+		if (batch)
+			hlist_del_init_rcu(&batch->list);
+		spin_unlock_bh(&bat_priv->ping_list_lock);
+
+		if (!batch)
+			break;
+
+		cancel_delayed_work_sync(&batch->finish_work);
+		batadv_ping_batch_put(batch);
+	}
+}
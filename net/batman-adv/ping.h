@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright (C) 2018  B.A.T.M.A.N. contributors:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _NET_BATMAN_ADV_PING_H_
+#define _NET_BATMAN_ADV_PING_H_
+
+#include "main.h"
+
+#include <linux/types.h>
+
+struct batadv_icmp_header;
+struct genl_info;
+struct sk_buff;
+
+int batadv_ping_start(struct sk_buff *skb, struct genl_info *info);
+void batadv_ping_recv(struct batadv_priv *bat_priv,
+		      struct batadv_icmp_header *icmph, size_t icmp_len);
+void batadv_ping_free(struct batadv_priv *bat_priv);
+
+#endif /* _NET_BATMAN_ADV_PING_H_ */
@@ -20,18 +20,24 @@
 #include "main.h"
 
 #include <linux/atomic.h>
+#include <linux/bitops.h>
 #include <linux/byteorder/generic.h>
 #include <linux/compiler.h>
 #include <linux/errno.h>
 #include <linux/etherdevice.h>
+#include <linux/hash.h>
 #include <linux/if_ether.h>
+#include <linux/jhash.h>
 #include <linux/jiffies.h>
+#include <linux/kernel.h>
 #include <linux/kref.h>
+#include <linux/log2.h>
 #include <linux/netdevice.h>
 #include <linux/printk.h>
 #include <linux/rculist.h>
 #include <linux/rcupdate.h>
 #include <linux/skbuff.h>
+#include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/stddef.h>
 #include <uapi/linux/batadv_packet.h>
@@ -43,17 +49,131 @@
 #include "hard-interface.h"
 #include "icmp_socket.h"
 #include "log.h"
+#include "netlink.h"
 #include "network-coding.h"
 #include "originator.h"
+#include "ping.h"
 #include "send.h"
 #include "soft-interface.h"
 #include "tp_meter.h"
+#include "trace.h"
 #include "translation-table.h"
 #include "tvlv.h"
 
 static int batadv_route_unicast_packet(struct sk_buff *skb,
 				       struct batadv_hard_iface *recv_if);
 
+/**
+ * batadv_topology_changed() - speed up the own OGMs after a topology change
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * Resets the adaptive OGM intervals of the mesh back to orig_interval to
+ * propagate the change quickly.
+ */
+void batadv_topology_changed(struct batadv_priv *bat_priv)
+{
+	atomic_inc(&bat_priv->topology_gen);
+}
+
+/**
+ * batadv_ogm_rearm() - don't hold back the next own OGMs by the backoff
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * Called for local TT changes: the own OGMs which are scheduled for later are
+ * sent within orig_interval instead.
+ */
+void batadv_ogm_rearm(struct batadv_priv *bat_priv)
+{
+	/* no OGM is scheduled later than orig_interval without backoff */
+	if (atomic_read(&bat_priv->orig_interval_max) <=
+	    atomic_read(&bat_priv->orig_interval))
+		return;
+
+	if (bat_priv->algo_ops->iface.ogm_rearm)
+		bat_priv->algo_ops->iface.ogm_rearm(bat_priv);
+}
+
+/**
+ * batadv_ogm_interval() - get the interval until the next own OGM
+ * @bat_priv: the bat priv with all the soft interface information
+ * @backoff: the adaptive interval state of the OGM sender
+ *
+ * While neither the routes, the neighbors nor the local TT change, the
+ * interval is doubled after each OGM up to orig_interval_max. Any change
+ * resets it to orig_interval.
+ *
+ * Return: the interval in milliseconds (without jitter)
+ */
+unsigned int batadv_ogm_interval(struct batadv_priv *bat_priv,
+				 struct batadv_ogm_backoff *backoff)
+{
+	unsigned int interval = atomic_read(&bat_priv->orig_interval);
+	unsigned int max_interval = atomic_read(&bat_priv->orig_interval_max);
+	u32 gen = (u32)atomic_read(&bat_priv->topology_gen);
+
+	/* the TT diff is repeated in the next OGMs, don't delay them */
+	if (max_interval <= interval || gen != backoff->topology_gen ||
+	    atomic_read(&bat_priv->tt.ogm_append_cnt) > 0)
+		backoff->interval = interval;
+	else
+		backoff->interval = clamp(backoff->interval * 2, interval,
+					  max_interval);
+
+	backoff->topology_gen = gen;
+
+	return backoff->interval;
+}
+
+/**
+ * batadv_ogm_fisheye_forward() - check whether to forward the OGM of a distant
+ *  originator
+ * @bat_priv: the bat priv with all the soft interface information
+ * @orig_node: the originator of the OGM
+ * @ttl: the TTL of the received OGM
+ * @seqno: the sequence number of the received OGM
+ *
+ * The OGMs of originators up to fisheye_hops hops away are all forwarded.
+ * Every further fisheye_hops hops only every second OGM of the previous ring
+ * is forwarded, down to every 2^BATADV_FISHEYE_MAX_SHIFT-th OGM. The OGMs are
+ * picked by their sequence number, so that all nodes forward the same nested
+ * subsets. OGMs announcing a new TT version are always forwarded to spare the
+ * distant nodes from requesting the changes they would have missed.
+ *
+ * The fisheye state of the orig_node is not synchronized, a race only causes
+ * an OGM to be forwarded or dropped additionally.
+ *
+ * Return: true if the OGM should be forwarded, false otherwise
+ */
+bool batadv_ogm_fisheye_forward(struct batadv_priv *bat_priv,
+				struct batadv_orig_node *orig_node, u8 ttl,
+				u32 seqno)
+{
+	u32 radius = atomic_read(&bat_priv->fisheye_hops);
+	u8 ttvn = (u8)atomic_read(&orig_node->last_ttvn);
+	u32 hops, shift;
+
+	if (!radius || ttl >= BATADV_TTL)
+		return true;
+
+	/* the OGM left its originator with BATADV_TTL */
+	hops = BATADV_TTL - ttl + 1;
+	if (hops <= radius)
+		return true;
+
+	/* the same OGM is checked for every outgoing interface */
+	if (ttvn != orig_node->fisheye_ttvn) {
+		orig_node->fisheye_ttvn = ttvn;
+		orig_node->fisheye_seqno = seqno;
+	}
+
+	if (orig_node->fisheye_seqno == seqno)
+		return true;
+
+	shift = min_t(u32, (hops - 1) / radius, BATADV_FISHEYE_MAX_SHIFT);
+
+	return !(seqno & (BIT(shift) - 1));
+}
+
 /**
  * _batadv_update_route() - set the router for this originator
  * @bat_priv: the bat priv with all the soft interface information
@@ -68,6 +188,7 @@ static void _batadv_update_route(struct batadv_priv *bat_priv,
 				 struct batadv_hard_iface *recv_if,
 				 struct batadv_neigh_node *neigh_node)
 {
+	struct batadv_orig_bonding_set *bonding_set;
 	struct batadv_orig_ifinfo *orig_ifinfo;
 	struct batadv_neigh_node *curr_router;
 
@@ -90,8 +211,16 @@ static void _batadv_update_route(struct batadv_priv *bat_priv,
 		kref_get(&neigh_node->refcount);
 
 	rcu_assign_pointer(orig_ifinfo->router, neigh_node);
+
+	/* the bonding candidates have to be recomputed */
+	bonding_set = batadv_orig_bonding_set_replace(orig_node, NULL);
 	spin_unlock_bh(&orig_node->neigh_list_lock);
 	batadv_orig_ifinfo_put(orig_ifinfo);
+	batadv_orig_bonding_set_free(bonding_set);
+
+	/* the best originator of a multi-homed client may have changed */
+	batadv_tt_tx_cache_invalidate(bat_priv);
+	batadv_topology_changed(bat_priv);
 
 	/* route deleted */
 	if (curr_router && !neigh_node) {
@@ -113,6 +242,12 @@ static void _batadv_update_route(struct batadv_priv *bat_priv,
 			   curr_router->addr);
 	}
 
+	if (recv_if == BATADV_IF_DEFAULT) {
+		WRITE_ONCE(orig_node->router_changed, jiffies);
+		batadv_netlink_notify_orig(bat_priv, BATADV_EVENT_ORIG_ROUTER,
+					   orig_node->orig, neigh_node);
+	}
+
 	/* decrease refcount of previous best neighbor */
 	if (curr_router)
 		batadv_neigh_node_put(curr_router);
@@ -213,7 +348,10 @@ bool batadv_check_management_packet(struct sk_buff *skb,
 	if (skb_cow(skb, 0) < 0)
 		return false;
 
-	/* keep skb linear */
+	/* keep skb linear - aggregated OGMs and their TVLVs are parsed in
+	 * place. Management packets are never merged by batadv_gro_receive(),
+	 * this only copies when the lower device received into page fragments
+	 */
 	if (skb_linearize(skb) < 0)
 		return false;
 
@@ -242,9 +380,18 @@ static int batadv_recv_my_icmp_packet(struct batadv_priv *bat_priv,
 	case BATADV_ECHO_REPLY:
 	case BATADV_DESTINATION_UNREACHABLE:
 	case BATADV_TTL_EXCEEDED:
-		/* receive the packet */
-		if (skb_linearize(skb) < 0)
+		/* receive the packet - the socket queue and the ping code
+		 * never look beyond the first BATADV_ICMP_MAX_PACKET_SIZE bytes
+		 */
+		if (!pskb_may_pull(skb, min_t(unsigned int, skb->len,
+					      BATADV_ICMP_MAX_PACKET_SIZE)))
+			break;
+
+		icmph = (struct batadv_icmp_header *)skb->data;
+		if (icmph->uid == BATADV_ICMP_UID_PING) {
+			batadv_ping_recv(bat_priv, icmph, skb->len);
 			break;
+		}
 
 		batadv_socket_receive_packet(icmph, skb->len);
 		break;
@@ -398,7 +545,7 @@ int batadv_recv_icmp_packet(struct sk_buff *skb,
 	if ((icmph->msg_type == BATADV_ECHO_REPLY ||
 	     icmph->msg_type == BATADV_ECHO_REQUEST) &&
 	    skb->len >= sizeof(struct batadv_icmp_packet_rr)) {
-		if (skb_linearize(skb) < 0)
+		if (!pskb_may_pull(skb, sizeof(struct batadv_icmp_packet_rr)))
 			goto free_skb;
 
 		/* create a copy of the skb, if needed, to modify it. */
@@ -494,49 +641,200 @@ static int batadv_check_unicast_packet(struct batadv_priv *bat_priv,
 }
 
 /**
- * batadv_last_bonding_get() - Get last_bonding_candidate of orig_node
- * @orig_node: originator node whose last bonding candidate should be retrieved
+ * batadv_bonding_set_build() - compute the bonding candidates towards an
+ *  originator
+ * @bat_priv: the bat priv with all the soft interface information
+ * @orig_node: the destination node
+ * @router: the router of the default interface towards @orig_node
  *
- * Return: last bonding candidate of router or NULL if not found
+ * Collect the routers of all outgoing interfaces which are similar or better
+ * than @router, each one only once. Every router is weighted by the metric of
+ * its path, so that better links carry a larger share of the flows. Has to be
+ * called with rcu_read_lock held.
  *
- * The object is returned with refcounter increased by 1.
+ * Return: the new bonding set or NULL on allocation failure
  */
-static struct batadv_orig_ifinfo *
-batadv_last_bonding_get(struct batadv_orig_node *orig_node)
+static struct batadv_orig_bonding_set *
+batadv_bonding_set_build(struct batadv_priv *bat_priv,
+			 struct batadv_orig_node *orig_node,
+			 struct batadv_neigh_node *router)
 {
-	struct batadv_orig_ifinfo *last_bonding_candidate;
+	struct batadv_algo_ops *bao = bat_priv->algo_ops;
+	struct batadv_orig_bonding_set *bonding_set;
+	struct batadv_neigh_node *cand_router;
+	struct batadv_orig_ifinfo *cand;
+	u32 i, max = 0, weight;
+
+	hlist_for_each_entry_rcu(cand, &orig_node->ifinfo_list, list)
+		max++;
+
+	bonding_set = kmalloc(sizeof(*bonding_set) +
+			      max * sizeof(bonding_set->cands[0]),
+			      GFP_ATOMIC);
+	if (!bonding_set)
+		return NULL;
 
-	spin_lock_bh(&orig_node->neigh_list_lock);
-	last_bonding_candidate = orig_node->last_bonding_candidate;
+	bonding_set->timestamp = jiffies;
+	bonding_set->num = 0;
 
-	if (last_bonding_candidate)
-		kref_get(&last_bonding_candidate->refcount);
-	spin_unlock_bh(&orig_node->neigh_list_lock);
+	hlist_for_each_entry_rcu(cand, &orig_node->ifinfo_list, list) {
+		if (bonding_set->num == max)
+			break;
 
-	return last_bonding_candidate;
+		cand_router = rcu_dereference(cand->router);
+		if (!cand_router)
+			continue;
+
+		/* alternative candidate should be good enough to be
+		 * considered
+		 */
+		if (!bao->neigh.is_similar_or_better(cand_router,
+						     cand->if_outgoing, router,
+						     BATADV_IF_DEFAULT))
+			continue;
+
+		/* don't use the same router twice */
+		for (i = 0; i < bonding_set->num; i++)
+			if (bonding_set->cands[i].router == cand_router)
+				break;
+
+		if (i < bonding_set->num)
+			continue;
+
+		if (!kref_get_unless_zero(&cand_router->refcount))
+			continue;
+
+		weight = 1;
+		if (bao->neigh.metric)
+			weight = max_t(u32, weight,
+				       bao->neigh.metric(cand_router,
+							 cand->if_outgoing));
+
+		bonding_set->cands[bonding_set->num].router = cand_router;
+		bonding_set->cands[bonding_set->num].weight = weight;
+		bonding_set->cands[bonding_set->num].key =
+			jhash(cand_router->addr, ETH_ALEN,
+			      cand_router->if_incoming->net_dev->ifindex);
+		bonding_set->num++;
+	}
+
+	return bonding_set;
 }
 
 /**
- * batadv_last_bonding_replace() - Replace last_bonding_candidate of orig_node
- * @orig_node: originator node whose bonding candidates should be replaced
- * @new_candidate: new bonding candidate or NULL
+ * batadv_bonding_set_get() - get the current bonding candidates towards an
+ *  originator
+ * @bat_priv: the bat priv with all the soft interface information
+ * @orig_node: the destination node
+ * @router: the router of the default interface towards @orig_node
+ *
+ * The candidates are recomputed when a router towards @orig_node changed or
+ * when they are older than BATADV_BONDING_SET_MAX_AGE to follow the metric.
+ * Has to be called with rcu_read_lock held.
+ *
+ * Return: the bonding set or NULL if none is available
  */
-static void
-batadv_last_bonding_replace(struct batadv_orig_node *orig_node,
-			    struct batadv_orig_ifinfo *new_candidate)
+static struct batadv_orig_bonding_set *
+batadv_bonding_set_get(struct batadv_priv *bat_priv,
+		       struct batadv_orig_node *orig_node,
+		       struct batadv_neigh_node *router)
 {
-	struct batadv_orig_ifinfo *old_candidate;
+	struct batadv_orig_bonding_set *bonding_set, *bonding_set_old;
 
-	spin_lock_bh(&orig_node->neigh_list_lock);
-	old_candidate = orig_node->last_bonding_candidate;
+	bonding_set = rcu_dereference(orig_node->bonding_set);
+	if (bonding_set &&
+	    !batadv_has_timed_out(bonding_set->timestamp,
+				  BATADV_BONDING_SET_MAX_AGE))
+		return bonding_set;
+
+	bonding_set = batadv_bonding_set_build(bat_priv, orig_node, router);
+	if (!bonding_set)
+		return NULL;
 
-	if (new_candidate)
-		kref_get(&new_candidate->refcount);
-	orig_node->last_bonding_candidate = new_candidate;
+	spin_lock_bh(&orig_node->neigh_list_lock);
+	bonding_set_old = batadv_orig_bonding_set_replace(orig_node,
+							  bonding_set);
 	spin_unlock_bh(&orig_node->neigh_list_lock);
 
-	if (old_candidate)
-		batadv_orig_ifinfo_put(old_candidate);
+	batadv_orig_bonding_set_free(bonding_set_old);
+
+	return bonding_set;
+}
+
+/**
+ * batadv_bonding_neg_log2() - fixed point -log2() of a 32 bit fraction
+ * @x: numerator of the fraction x / 2^32, not 0
+ *
+ * The mantissa is interpolated linearly, which is precise enough to spread
+ * the flows according to the weights of the bonding candidates.
+ *
+ * Return: -log2(x / 2^32) with 16 fractional bits, at least 1
+ */
+static u32 batadv_bonding_neg_log2(u32 x)
+{
+	unsigned int exp = ilog2(x);
+	u32 frac = x - BIT(exp);
+
+	/* the bits below the leading one, scaled to 16 bits */
+	if (exp >= 16)
+		frac >>= exp - 16;
+	else
+		frac <<= 16 - exp;
+
+	return max_t(u32, ((32 - exp) << 16) - frac, 1);
+}
+
+/**
+ * batadv_bonding_set_select() - select the bonding candidate for a packet
+ * @bonding_set: the bonding candidates towards the destination
+ * @orig_node: the destination node
+ * @skb: the packet to send (or NULL)
+ *
+ * The packets of a flow always take the same candidate to avoid reordering.
+ * Flows are distributed according to the weights of the candidates. Without a
+ * packet (or flow hash), the candidates are alternated.
+ *
+ * The candidate is chosen by weighted rendezvous hashing: each candidate gets
+ * the score weight / -ln(u) for a pseudo random u derived from the flow and
+ * the candidate, the highest score wins. A changed weight or a candidate
+ * joining or leaving the set therefore only moves flows from or to the
+ * changed candidate, all other flows keep their link.
+ *
+ * Return: the selected router
+ */
+static struct batadv_neigh_node *
+batadv_bonding_set_select(struct batadv_orig_bonding_set *bonding_set,
+			  struct batadv_orig_node *orig_node,
+			  struct sk_buff *skb)
+{
+	struct batadv_orig_bonding_cand *cand, *best = NULL;
+	u32 cost, best_cost = 0;
+	u32 hash = 0;
+	u32 i;
+
+	if (skb)
+		hash = skb_get_hash(skb);
+
+	if (!hash)
+		hash = (u32)atomic_inc_return(&orig_node->bonding_rr) *
+		       GOLDEN_RATIO_32;
+
+	for (i = 0; i < bonding_set->num; i++) {
+		cand = &bonding_set->cands[i];
+
+		/* the logarithm base doesn't change the order of the scores */
+		cost = batadv_bonding_neg_log2(jhash_2words(hash, cand->key,
+							    0) | 1);
+
+		/* cand->weight / cost > best->weight / best_cost */
+		if (!best ||
+		    (u64)cand->weight * best_cost > (u64)best->weight * cost) {
+			best = cand;
+			best_cost = cost;
+		}
+	}
+
+	return best->router;
 }
 
 /**
@@ -544,6 +842,8 @@ batadv_last_bonding_replace(struct batadv_orig_node *orig_node,
  * @bat_priv: the bat priv with all the soft interface information
  * @orig_node: the destination node
  * @recv_if: pointer to interface this packet was received on
+ * @skb: the packet which is going to be sent (or NULL), used to keep the
+ *  packets of a flow on the same router when bonding
  *
  * Return: the router which should be used for this orig_node on
  * this interface, or NULL if not available.
@@ -551,17 +851,11 @@ batadv_last_bonding_replace(struct batadv_orig_node *orig_node,
 struct batadv_neigh_node *
 batadv_find_router(struct batadv_priv *bat_priv,
 		   struct batadv_orig_node *orig_node,
-		   struct batadv_hard_iface *recv_if)
+		   struct batadv_hard_iface *recv_if,
+		   struct sk_buff *skb)
 {
-	struct batadv_algo_ops *bao = bat_priv->algo_ops;
-	struct batadv_neigh_node *first_candidate_router = NULL;
-	struct batadv_neigh_node *next_candidate_router = NULL;
-	struct batadv_neigh_node *router, *cand_router = NULL;
-	struct batadv_neigh_node *last_cand_router = NULL;
-	struct batadv_orig_ifinfo *cand, *first_candidate = NULL;
-	struct batadv_orig_ifinfo *next_candidate = NULL;
-	struct batadv_orig_ifinfo *last_candidate;
-	bool last_candidate_found = false;
+	struct batadv_orig_bonding_set *bonding_set;
+	struct batadv_neigh_node *router, *cand_router;
 
 	if (!orig_node)
 		return NULL;
@@ -577,115 +871,63 @@ batadv_find_router(struct batadv_priv *bat_priv,
 	if (!(recv_if == BATADV_IF_DEFAULT && atomic_read(&bat_priv->bonding)))
 		return router;
 
-	/* bonding: loop through the list of possible routers found
-	 * for the various outgoing interfaces and find a candidate after
-	 * the last chosen bonding candidate (next_candidate). If no such
-	 * router is found, use the first candidate found (the previously
-	 * chosen bonding candidate might have been the last one in the list).
-	 * If this can't be found either, return the previously chosen
-	 * router - obviously there are no other candidates.
+	/* bonding: distribute the flows over the routers of the various
+	 * outgoing interfaces which are similar or better than the default
+	 * router. If no such router is found, return the default router -
+	 * obviously there are no other candidates.
 	 */
 	rcu_read_lock();
-	last_candidate = batadv_last_bonding_get(orig_node);
-	if (last_candidate)
-		last_cand_router = rcu_dereference(last_candidate->router);
-
-	hlist_for_each_entry_rcu(cand, &orig_node->ifinfo_list, list) {
-		/* acquire some structures and references ... */
-		if (!kref_get_unless_zero(&cand->refcount))
-			continue;
-
-		cand_router = rcu_dereference(cand->router);
-		if (!cand_router)
-			goto next;
-
-		if (!kref_get_unless_zero(&cand_router->refcount)) {
-			cand_router = NULL;
-			goto next;
-		}
-
-		/* alternative candidate should be good enough to be
-		 * considered
-		 */
-		if (!bao->neigh.is_similar_or_better(cand_router,
-						     cand->if_outgoing, router,
-						     recv_if))
-			goto next;
-
-		/* don't use the same router twice */
-		if (last_cand_router == cand_router)
-			goto next;
-
-		/* mark the first possible candidate */
-		if (!first_candidate) {
-			kref_get(&cand_router->refcount);
-			kref_get(&cand->refcount);
-			first_candidate = cand;
-			first_candidate_router = cand_router;
-		}
+	bonding_set = batadv_bonding_set_get(bat_priv, orig_node, router);
+	if (bonding_set && bonding_set->num > 0) {
+		cand_router = batadv_bonding_set_select(bonding_set, orig_node,
+							skb);
 
-		/* check if the loop has already passed the previously selected
-		 * candidate ... this function should select the next candidate
-		 * AFTER the previously used bonding candidate.
+		/* the bonding set holds a reference until the end of the RCU
+		 * grace period
 		 */
-		if (!last_candidate || last_candidate_found) {
-			next_candidate = cand;
-			next_candidate_router = cand_router;
-			break;
-		}
-
-		if (last_candidate == cand)
-			last_candidate_found = true;
-next:
-		/* free references */
-		if (cand_router) {
-			batadv_neigh_node_put(cand_router);
-			cand_router = NULL;
-		}
-		batadv_orig_ifinfo_put(cand);
+		kref_get(&cand_router->refcount);
+		batadv_neigh_node_put(router);
+		router = cand_router;
 	}
 	rcu_read_unlock();
 
-	/* After finding candidates, handle the three cases:
-	 * 1) there is a next candidate, use that
-	 * 2) there is no next candidate, use the first of the list
-	 * 3) there is no candidate at all, return the default router
-	 */
-	if (next_candidate) {
-		batadv_neigh_node_put(router);
-
-		kref_get(&next_candidate_router->refcount);
-		router = next_candidate_router;
-		batadv_last_bonding_replace(orig_node, next_candidate);
-	} else if (first_candidate) {
-		batadv_neigh_node_put(router);
+	return router;
+}
 
-		kref_get(&first_candidate_router->refcount);
-		router = first_candidate_router;
-		batadv_last_bonding_replace(orig_node, first_candidate);
-	} else {
-		batadv_last_bonding_replace(orig_node, NULL);
-	}
+/**
+ * batadv_skb_cow_fwd() - make a received packet writable for forwarding
+ * @bat_priv: the bat priv with all the soft interface information
+ * @skb: the received packet
+ * @headroom: headroom needed in front of skb->data right away
+ *
+ * When the packet has to be copied anyway, the copy gets the worst case
+ * headroom of the forwarding path. The fragment, network coding and hard
+ * interface headers pushed later on then don't copy the packet again.
+ *
+ * Return: 0 on success or negative error number in case of failure
+ */
+static int batadv_skb_cow_fwd(struct batadv_priv *bat_priv,
+			      struct sk_buff *skb, unsigned int headroom)
+{
+	unsigned char *head = skb->head;
+	int ret;
 
-	/* cleanup of candidates */
-	if (first_candidate) {
-		batadv_neigh_node_put(first_candidate_router);
-		batadv_orig_ifinfo_put(first_candidate);
-	}
+	if (skb_cloned(skb) || skb_headroom(skb) < headroom)
+		headroom = max_t(unsigned int, headroom,
+				 READ_ONCE(bat_priv->fwd_headroom));
 
-	if (next_candidate) {
-		batadv_neigh_node_put(next_candidate_router);
-		batadv_orig_ifinfo_put(next_candidate);
-	}
+	ret = skb_cow(skb, headroom);
+	if (ret < 0)
+		return ret;
 
-	if (last_candidate)
-		batadv_orig_ifinfo_put(last_candidate);
+	if (skb->head != head)
+		batadv_inc_counter(bat_priv, BATADV_CNT_HEADROOM_FWD);
 
-	return router;
+	return 0;
 }
 
-static int batadv_route_unicast_packet(struct sk_buff *skb,
-				       struct batadv_hard_iface *recv_if)
+static int __batadv_route_unicast_packet(struct sk_buff *skb,
+					 struct batadv_hard_iface *recv_if)
 {
 	struct batadv_priv *bat_priv = netdev_priv(recv_if->soft_iface);
 	struct batadv_orig_node *orig_node = NULL;
@@ -710,7 +952,7 @@ static int batadv_route_unicast_packet(struct sk_buff *skb,
 		goto free_skb;
 
 	/* create a copy of the skb, if needed, to modify it. */
-	if (skb_cow(skb, ETH_HLEN) < 0)
+	if (batadv_skb_cow_fwd(bat_priv, skb, ETH_HLEN) < 0)
 		goto put_orig_node;
 
 	/* decrement ttl */
@@ -730,8 +972,10 @@ static int batadv_route_unicast_packet(struct sk_buff *skb,
 		break;
 	}
 
-	if (hdr_len > 0)
+	if (hdr_len > 0) {
 		batadv_skb_set_priority(skb, hdr_len);
+		batadv_skb_set_flow_hash(skb, hdr_len);
+	}
 
 	len = skb->len;
 	res = batadv_send_skb_to_orig(skb, orig_node, recv_if);
@@ -756,6 +1000,30 @@ free_skb:
 	return ret;
 }
 
+/**
+ * batadv_route_unicast_packet() - forward a unicast packet to the next hop
+ * @skb: the packet to forward
+ * @recv_if: the interface the packet was received on
+ *
+ * Return: NET_RX_SUCCESS if the packet was forwarded, NET_RX_DROP otherwise
+ */
+static int batadv_route_unicast_packet(struct sk_buff *skb,
+				       struct batadv_hard_iface *recv_if)
+{
+	unsigned int len = skb->len;
+	u64 start = 0;
+	int ret;
+
+	if (trace_batadv_route_unicast_enabled())
+		start = batadv_trace_clock();
+
+	ret = __batadv_route_unicast_packet(skb, recv_if);
+
+	trace_batadv_route_unicast(recv_if->net_dev, len, start);
+
+	return ret;
+}
+
 /**
  * batadv_reroute_unicast_packet() - update the unicast header for re-routing
  * @bat_priv: the bat priv with all the soft interface information
@@ -831,7 +1099,7 @@ static bool batadv_check_unicast_ttvn(struct batadv_priv *bat_priv,
 		return false;
 
 	/* create a copy of the skb (in case of for re-routing) to modify it. */
-	if (skb_cow(skb, sizeof(*unicast_packet)) < 0)
+	if (batadv_skb_cow_fwd(bat_priv, skb, sizeof(*unicast_packet)) < 0)
 		return false;
 
 	unicast_packet = (struct batadv_unicast_packet *)skb->data;
@@ -1042,6 +1310,12 @@ int batadv_recv_unicast_packet(struct sk_buff *skb,
 		if (batadv_dat_snoop_incoming_arp_reply(bat_priv, skb,
 							hdr_size))
 			goto rx_success;
+		if (batadv_dat_snoop_incoming_nd_request(bat_priv, skb,
+							 hdr_size))
+			goto rx_success;
+		if (batadv_dat_snoop_incoming_nd_reply(bat_priv, skb,
+						       hdr_size))
+			goto rx_success;
 
 		batadv_interface_rx(recv_if->soft_iface, skb, hdr_size,
 				    orig_node);
@@ -1063,6 +1337,95 @@ free_skb:
 	return ret;
 }
 
+/**
+ * batadv_recv_unicast_agg_packet() - receive and unpack a unicast aggregate
+ * @skb: unicast aggregate to process
+ * @recv_if: pointer to interface this packet was received on
+ *
+ * Every carried unicast packet is copied into its own buffer and handed to the
+ * receive handler of its type as if it had been received on its own.
+ *
+ * Return: NET_RX_SUCCESS if the aggregate was well formed or NET_RX_DROP
+ * otherwise.
+ */
+int batadv_recv_unicast_agg_packet(struct sk_buff *skb,
+				   struct batadv_hard_iface *recv_if)
+{
+	struct batadv_priv *bat_priv = netdev_priv(recv_if->soft_iface);
+	struct batadv_unicast_agg_packet *agg_packet;
+	int hdr_size = sizeof(*agg_packet);
+	struct sk_buff *skb_packet;
+	unsigned int num_packets;
+	unsigned int i, len, offset, packet_offset;
+	u8 packet_buf[2], *packet;
+	__be16 len_buf;
+
+	if (batadv_check_unicast_packet(bat_priv, skb, hdr_size) < 0)
+		goto free_skb;
+
+	/* the carried packets are copied out of the aggregate anyway, page
+	 * fragments are read in place instead of linearizing the aggregate
+	 */
+	agg_packet = (struct batadv_unicast_agg_packet *)skb->data;
+	num_packets = agg_packet->num_packets;
+	offset = hdr_size;
+
+	for (i = 0; i < num_packets; i++) {
+		if (skb_copy_bits(skb, offset, &len_buf, sizeof(len_buf)) < 0)
+			goto free_skb;
+
+		len = ntohs(len_buf);
+		offset += sizeof(len_buf);
+
+		/* packet should hold at least type and version */
+		if (len < 2 || len > skb->len - offset)
+			goto free_skb;
+
+		packet_offset = offset;
+		offset += len;
+
+		packet = skb_header_pointer(skb, packet_offset,
+					    sizeof(packet_buf), packet_buf);
+		if (!packet)
+			goto free_skb;
+
+		/* only unicast packets are aggregated - this also rules out
+		 * nested aggregates
+		 */
+		if (packet[0] < BATADV_UNICAST_MIN ||
+		    packet[0] > BATADV_UNICAST_MAX ||
+		    packet[1] != BATADV_COMPAT_VERSION)
+			continue;
+
+		skb_packet = netdev_alloc_skb_ip_align(skb->dev, ETH_HLEN + len);
+		if (!skb_packet)
+			continue;
+
+		skb_put_data(skb_packet, eth_hdr(skb), ETH_HLEN);
+		if (skb_copy_bits(skb, packet_offset, skb_put(skb_packet, len),
+				  len) < 0) {
+			kfree_skb(skb_packet);
+			goto free_skb;
+		}
+
+		skb_reset_mac_header(skb_packet);
+		__skb_pull(skb_packet, ETH_HLEN);
+		skb_reset_network_header(skb_packet);
+		skb_reset_mac_len(skb_packet);
+		skb_packet->protocol = htons(ETH_P_BATMAN);
+
+		batadv_recv_handler_call(skb_packet, recv_if);
+	}
+
+	consume_skb(skb);
+	return NET_RX_SUCCESS;
+
+free_skb:
+	kfree_skb(skb);
+
+	return NET_RX_DROP;
+}
+
 /**
  * batadv_recv_unicast_tvlv() - receive and process unicast tvlv packets
  * @skb: unicast tvlv packet to process
@@ -1085,21 +1448,22 @@ int batadv_recv_unicast_tvlv(struct sk_buff *skb,
 		goto free_skb;
 
 	/* the header is likely to be modified while forwarding */
-	if (skb_cow(skb, hdr_size) < 0)
-		goto free_skb;
-
-	/* packet needs to be linearized to access the tvlv content */
-	if (skb_linearize(skb) < 0)
+	if (batadv_skb_cow_fwd(bat_priv, skb, hdr_size) < 0)
 		goto free_skb;
 
 	unicast_tvlv_packet = (struct batadv_unicast_tvlv_packet *)skb->data;
-
-	tvlv_buff = (unsigned char *)(skb->data + hdr_size);
 	tvlv_buff_len = ntohs(unicast_tvlv_packet->tvlv_len);
 
 	if (tvlv_buff_len > skb->len - hdr_size)
 		goto free_skb;
 
+	/* only the tvlv content has to be linear - not the whole packet */
+	if (!pskb_may_pull(skb, hdr_size + tvlv_buff_len))
+		goto free_skb;
+
+	unicast_tvlv_packet = (struct batadv_unicast_tvlv_packet *)skb->data;
+	tvlv_buff = (unsigned char *)(skb->data + hdr_size);
+
 	ret = batadv_tvlv_containers_process(bat_priv, false, NULL,
 					     unicast_tvlv_packet->src,
 					     unicast_tvlv_packet->dst,
@@ -1183,6 +1547,47 @@ free_skb:
 	return ret;
 }
 
+/**
+ * batadv_bcast_window_restart() - check whether a broadcast outside of the
+ *  flood history is from a restarted originator
+ * @bat_priv: the bat priv with all the soft interface information
+ * @orig_node: the originator of the broadcast
+ * @seqno: sequence number of the broadcast
+ *
+ * Resets the flood history to the sequence number of the broadcast when the
+ * originator seems to have restarted and the reset protection time is over.
+ *
+ * Return: the state of the broadcast in the (possibly reset) flood history
+ */
+static enum batadv_seqno_state
+batadv_bcast_window_restart(struct batadv_priv *bat_priv,
+			    struct batadv_orig_node *orig_node, u32 seqno)
+{
+	struct batadv_seqno_window *win = &orig_node->bcast_window;
+	enum batadv_seqno_state state = BATADV_SEQNO_OLD;
+	s32 seq_diff;
+
+	spin_lock_bh(&orig_node->bcast_seqno_lock);
+
+	seq_diff = seqno - (u32)atomic_read(&win->last_seqno);
+
+	/* check whether the packet is old and the host just restarted. */
+	if (batadv_window_protected(bat_priv, seq_diff, BATADV_BCAST_MAX_AGE,
+				    &orig_node->bcast_seqno_reset, NULL))
+		goto unlock;
+
+	if (seq_diff <= -BATADV_BCAST_MAX_AGE ||
+	    seq_diff >= BATADV_EXPECTED_SEQNO_RANGE)
+		batadv_seqno_window_reset(win, seqno);
+
+	state = batadv_seqno_window_mark(win, seqno);
+
+unlock:
+	spin_unlock_bh(&orig_node->bcast_seqno_lock);
+
+	return state;
+}
+
 /**
  * batadv_recv_bcast_packet() - Process incoming broadcast packet
  * @skb: incoming packet buffer
@@ -1198,8 +1603,9 @@ int batadv_recv_bcast_packet(struct sk_buff *skb,
 	struct batadv_bcast_packet *bcast_packet;
 	struct ethhdr *ethhdr;
 	int hdr_size = sizeof(*bcast_packet);
+	enum batadv_seqno_state state;
 	int ret = NET_RX_DROP;
-	s32 seq_diff;
+	atomic_t *dups;
 	u32 seqno;
 
 	/* drop packet if it has not necessary minimum size */
@@ -1234,35 +1640,35 @@ int batadv_recv_bcast_packet(struct sk_buff *skb,
 	if (!orig_node)
 		goto free_skb;
 
-	spin_lock_bh(&orig_node->bcast_seqno_lock);
-
 	seqno = ntohl(bcast_packet->seqno);
-	/* check whether the packet is a duplicate */
-	if (batadv_test_bit(orig_node->bcast_bits, orig_node->last_bcast_seqno,
-			    seqno))
-		goto spin_unlock;
-
-	seq_diff = seqno - orig_node->last_bcast_seqno;
-
-	/* check whether the packet is old and the host just restarted. */
-	if (batadv_window_protected(bat_priv, seq_diff,
-				    BATADV_BCAST_MAX_AGE,
-				    &orig_node->bcast_seqno_reset, NULL))
-		goto spin_unlock;
+	dups = &orig_node->bcast_dups[seqno % BATADV_BCAST_MAX_AGE];
 
 	/* mark broadcast in flood history, update window position
 	 * if required.
 	 */
-	if (batadv_bit_get_packet(bat_priv, orig_node->bcast_bits, seq_diff, 1))
-		orig_node->last_bcast_seqno = seqno;
+	state = batadv_seqno_window_mark(&orig_node->bcast_window, seqno);
+	if (state == BATADV_SEQNO_OLD)
+		state = batadv_bcast_window_restart(bat_priv, orig_node, seqno);
 
-	spin_unlock_bh(&orig_node->bcast_seqno_lock);
+	/* check whether the packet is a duplicate, the count of them tells
+	 * whether our own retransmissions are still needed
+	 */
+	if (state == BATADV_SEQNO_DUP) {
+		atomic_add_unless(dups, 1, U8_MAX);
+		goto free_skb;
+	}
+
+	if (state != BATADV_SEQNO_NEW)
+		goto free_skb;
+
+	atomic_set(dups, 0);
 
 	/* check whether this has been sent by another originator before */
 	if (batadv_bla_check_bcast_duplist(bat_priv, skb))
 		goto free_skb;
 
 	batadv_skb_set_priority(skb, sizeof(struct batadv_bcast_packet));
+	batadv_skb_set_flow_hash(skb, sizeof(struct batadv_bcast_packet));
 
 	/* rebroadcast packet */
 	batadv_add_bcast_packet_to_list(bat_priv, skb, 1, false);
@@ -1277,6 +1683,10 @@ int batadv_recv_bcast_packet(struct sk_buff *skb,
 		goto rx_success;
 	if (batadv_dat_snoop_incoming_arp_reply(bat_priv, skb, hdr_size))
 		goto rx_success;
+	if (batadv_dat_snoop_incoming_nd_request(bat_priv, skb, hdr_size))
+		goto rx_success;
+	if (batadv_dat_snoop_incoming_nd_reply(bat_priv, skb, hdr_size))
+		goto rx_success;
 
 	/* broadcast for me */
 	batadv_interface_rx(recv_if->soft_iface, skb, hdr_size, orig_node);
@@ -1285,8 +1695,6 @@ rx_success:
 	ret = NET_RX_SUCCESS;
 	goto out;
 
-spin_unlock:
-	spin_unlock_bh(&orig_node->bcast_seqno_lock);
 free_skb:
 	kfree_skb(skb);
 out:
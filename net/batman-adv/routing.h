@@ -32,6 +32,13 @@ void batadv_update_route(struct batadv_priv *bat_priv,
 			 struct batadv_orig_node *orig_node,
 			 struct batadv_hard_iface *recv_if,
 			 struct batadv_neigh_node *neigh_node);
+void batadv_topology_changed(struct batadv_priv *bat_priv);
+void batadv_ogm_rearm(struct batadv_priv *bat_priv);
+unsigned int batadv_ogm_interval(struct batadv_priv *bat_priv,
+				 struct batadv_ogm_backoff *backoff);
+bool batadv_ogm_fisheye_forward(struct batadv_priv *bat_priv,
+				struct batadv_orig_node *orig_node, u8 ttl,
+				u32 seqno);
 int batadv_recv_icmp_packet(struct sk_buff *skb,
 			    struct batadv_hard_iface *recv_if);
 int batadv_recv_unicast_packet(struct sk_buff *skb,
@@ -46,12 +53,15 @@ int batadv_recv_roam_adv(struct sk_buff *skb,
 			 struct batadv_hard_iface *recv_if);
 int batadv_recv_unicast_tvlv(struct sk_buff *skb,
 			     struct batadv_hard_iface *recv_if);
+int batadv_recv_unicast_agg_packet(struct sk_buff *skb,
+				   struct batadv_hard_iface *recv_if);
 int batadv_recv_unhandled_unicast_packet(struct sk_buff *skb,
 					 struct batadv_hard_iface *recv_if);
 struct batadv_neigh_node *
 batadv_find_router(struct batadv_priv *bat_priv,
 		   struct batadv_orig_node *orig_node,
-		   struct batadv_hard_iface *recv_if);
+		   struct batadv_hard_iface *recv_if,
+		   struct sk_buff *skb);
 bool batadv_window_protected(struct batadv_priv *bat_priv, s32 seq_num_diff,
 			     s32 seq_old_max_diff, unsigned long *last_reset,
 			     bool *protection_started);
@@ -22,6 +22,8 @@
 #include <linux/atomic.h>
 #include <linux/bug.h>
 #include <linux/byteorder/generic.h>
+#include <linux/cache.h>
+#include <linux/err.h>
 #include <linux/errno.h>
 #include <linux/etherdevice.h>
 #include <linux/gfp.h>
@@ -31,16 +33,20 @@
 #include <linux/kernel.h>
 #include <linux/kref.h>
 #include <linux/list.h>
+#include <linux/lockdep.h>
 #include <linux/netdevice.h>
 #include <linux/printk.h>
 #include <linux/rculist.h>
 #include <linux/rcupdate.h>
+#include <linux/sched.h>
 #include <linux/skbuff.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/stddef.h>
 #include <linux/workqueue.h>
+#include <uapi/linux/batadv_packet.h>
 
+#include "bitarray.h"
 #include "distributed-arp-table.h"
 #include "fragmentation.h"
 #include "gateway_client.h"
@@ -50,12 +56,57 @@
 #include "originator.h"
 #include "routing.h"
 #include "soft-interface.h"
+#include "trace.h"
 #include "translation-table.h"
+#include "tvlv.h"
 
-static void batadv_send_outstanding_bcast_packet(struct work_struct *work);
+static struct kmem_cache *batadv_forw_packet_cache __read_mostly;
+
+static void
+batadv_send_outstanding_bcast_packet(struct batadv_forw_packet *forw_packet);
 
 /**
- * batadv_send_skb_packet() - send an already prepared packet
+ * batadv_send_skb_is_ctrl() - check whether a packet manages the mesh
+ * @skb: the packet to check (with batadv header and no outer eth header)
+ *
+ * Return: true if the packet is a routing protocol, TVLV or DAT DHT message
+ */
+static bool batadv_send_skb_is_ctrl(struct sk_buff *skb)
+{
+	struct batadv_unicast_4addr_packet *unicast_4addr;
+	struct batadv_ogm_packet *batadv_packet;
+
+	if (skb_headlen(skb) < sizeof(*batadv_packet))
+		return false;
+
+	batadv_packet = (struct batadv_ogm_packet *)skb->data;
+
+	switch (batadv_packet->packet_type) {
+	case BATADV_IV_OGM:
+	case BATADV_ELP:
+	case BATADV_OGM2:
+	case BATADV_UNICAST_TVLV:
+		return true;
+	case BATADV_UNICAST_4ADDR:
+		if (skb_headlen(skb) < sizeof(*unicast_4addr))
+			return false;
+
+		unicast_4addr = (struct batadv_unicast_4addr_packet *)skb->data;
+
+		switch (unicast_4addr->subtype) {
+		case BATADV_P_DAT_DHT_GET:
+		case BATADV_P_DAT_DHT_PUT:
+			return true;
+		default:
+			return false;
+		}
+	default:
+		return false;
+	}
+}
+
+/**
+ * __batadv_send_skb_packet() - send an already prepared packet
  * @skb: the packet to send
  * @hard_iface: the interface to use to send the broadcast packet
  * @dst_addr: the payload destination
@@ -72,9 +123,9 @@ static void batadv_send_outstanding_bcast_packet(struct work_struct *work);
  * guarantee the frame will be transmitted as it may be dropped due
  * to congestion or traffic shaping.
  */
-int batadv_send_skb_packet(struct sk_buff *skb,
-			   struct batadv_hard_iface *hard_iface,
-			   const u8 *dst_addr)
+static int __batadv_send_skb_packet(struct sk_buff *skb,
+				    struct batadv_hard_iface *hard_iface,
+				    const u8 *dst_addr)
 {
 	struct batadv_priv *bat_priv;
 	struct ethhdr *ethhdr;
@@ -94,12 +145,22 @@ int batadv_send_skb_packet(struct sk_buff *skb,
 		goto send_skb_err;
 	}
 
+	/* keep the mesh together when the link is busy with client data */
+	if (batadv_send_skb_is_ctrl(skb)) {
+		skb->priority = BATADV_PRIO_CONTROL;
+		batadv_inc_counter(bat_priv, BATADV_CNT_CTRL_TX);
+	}
+
 	/* push to the ethernet header. */
-	if (batadv_skb_head_push(skb, ETH_HLEN) < 0)
+	if (batadv_skb_head_push(bat_priv, skb, ETH_HLEN,
+				 BATADV_CNT_HEADROOM_LL) < 0)
 		goto send_skb_err;
 
 	skb_reset_mac_header(skb);
 
+	/* the classification describes the client frame, not the mesh frame */
+	BATADV_SKB_CB(skb)->classified = 0;
+
 	ethhdr = eth_hdr(skb);
 	ether_addr_copy(ethhdr->h_source, hard_iface->net_dev->dev_addr);
 	ether_addr_copy(ethhdr->h_dest, dst_addr);
@@ -113,6 +174,10 @@ int batadv_send_skb_packet(struct sk_buff *skb,
 	/* Save a clone of the skb to use when decoding coded packets */
 	batadv_nc_skb_store_for_decoding(bat_priv, skb);
 
+	batadv_hardif_inc_counter(hard_iface, BATADV_HARDIF_CNT_TX);
+	batadv_hardif_add_counter(hard_iface, BATADV_HARDIF_CNT_TX_BYTES,
+				  skb->len);
+
 	/* dev_queue_xmit() returns a negative result on error.	 However on
 	 * congestion and traffic shaping, it drops and returns NET_XMIT_DROP
 	 * (which is > 0). This will not be treated as an error.
@@ -124,6 +189,36 @@ send_skb_err:
 	return NET_XMIT_DROP;
 }
 
+/**
+ * batadv_send_skb_packet() - send an already prepared packet
+ * @skb: the packet to send
+ * @hard_iface: the interface to use to send the broadcast packet
+ * @dst_addr: the payload destination
+ *
+ * Regardless of the return value, the skb is consumed.
+ *
+ * Return: A negative errno code is returned on a failure. A success does not
+ * guarantee the frame will be transmitted as it may be dropped due
+ * to congestion or traffic shaping.
+ */
+int batadv_send_skb_packet(struct sk_buff *skb,
+			   struct batadv_hard_iface *hard_iface,
+			   const u8 *dst_addr)
+{
+	unsigned int len = skb->len;
+	u64 start = 0;
+	int ret;
+
+	if (trace_batadv_send_skb_enabled())
+		start = batadv_trace_clock();
+
+	ret = __batadv_send_skb_packet(skb, hard_iface, dst_addr);
+
+	trace_batadv_send_skb(hard_iface->net_dev, len, start);
+
+	return ret;
+}
+
 /**
  * batadv_send_broadcast_skb() - Send broadcast packet via hard interface
  * @skb: packet to be transmitted (with batadv header and no outer eth header)
@@ -139,6 +234,32 @@ int batadv_send_broadcast_skb(struct sk_buff *skb,
 	return batadv_send_skb_packet(skb, hard_iface, batadv_broadcast_addr);
 }
 
+/**
+ * batadv_send_neigh_tx_account() - account a unicast transmission towards a
+ *  neighbor
+ * @hardif_neigh: the neighbor the packet was sent to
+ * @len: length of the transmitted packet
+ * @ret: return value of the transmission
+ *
+ * The per neighbor counters are the base of the passive capacity estimation of
+ * BATMAN V and allow it to skip the probing of busy links.
+ */
+static void
+batadv_send_neigh_tx_account(struct batadv_hardif_neigh_node *hardif_neigh,
+			     unsigned int len, int ret)
+{
+#ifdef CONFIG_BATMAN_ADV_BATMAN_V
+	if (ret == NET_XMIT_DROP || ret < 0) {
+		atomic64_inc(&hardif_neigh->bat_v.tx_dropped);
+		return;
+	}
+
+	hardif_neigh->bat_v.last_unicast_tx = jiffies;
+	atomic64_add(len, &hardif_neigh->bat_v.tx_bytes);
+	atomic64_inc(&hardif_neigh->bat_v.tx_packets);
+#endif
+}
+
 /**
  * batadv_send_unicast_skb() - Send unicast packet to neighbor
  * @skb: packet to be transmitted (with batadv header and no outer eth header)
@@ -153,6 +274,7 @@ int batadv_send_unicast_skb(struct sk_buff *skb,
 {
 #ifdef CONFIG_BATMAN_ADV_BATMAN_V
 	struct batadv_hardif_neigh_node *hardif_neigh;
+	unsigned int len = skb->len;
 #endif
 	int ret;
 
@@ -161,16 +283,411 @@ int batadv_send_unicast_skb(struct sk_buff *skb,
 #ifdef CONFIG_BATMAN_ADV_BATMAN_V
 	hardif_neigh = batadv_hardif_neigh_get(neigh->if_incoming, neigh->addr);
 
-	if (hardif_neigh && ret != NET_XMIT_DROP)
-		hardif_neigh->bat_v.last_unicast_tx = jiffies;
-
-	if (hardif_neigh)
+	if (hardif_neigh) {
+		batadv_send_neigh_tx_account(hardif_neigh, len, ret);
 		batadv_hardif_neigh_put(hardif_neigh);
+	}
 #endif
 
 	return ret;
 }
 
+/**
+ * batadv_send_unicast_agg_list_free() - free all packets in an aggregation
+ *  queue
+ * @hardif_neigh: the neighbor holding the aggregation queue
+ *
+ * Caller needs to hold the hardif_neigh->agg_lock.
+ */
+static void
+batadv_send_unicast_agg_list_free(struct batadv_hardif_neigh_node *hardif_neigh)
+{
+	lockdep_assert_held(&hardif_neigh->agg_lock);
+
+	__skb_queue_purge(&hardif_neigh->agg_queue);
+	hardif_neigh->agg_len = 0;
+}
+
+/**
+ * batadv_send_unicast_agg_send() - flush & send the unicast aggregation queue
+ *  of a neighbor
+ * @bat_priv: the bat priv with all the soft interface information
+ * @hardif_neigh: the neighbor with the aggregation queue to flush
+ *
+ * A single queued packet is transmitted as it is, several ones are packed
+ * into one BATADV_UNICAST_AGG frame.
+ *
+ * The aggregation queue is empty after this call.
+ *
+ * Caller needs to hold the hardif_neigh->agg_lock.
+ */
+static void
+batadv_send_unicast_agg_send(struct batadv_priv *bat_priv,
+			     struct batadv_hardif_neigh_node *hardif_neigh)
+{
+	struct batadv_unicast_agg_packet *agg_packet;
+	unsigned int num_packets, len;
+	struct sk_buff *skb_agg;
+	struct sk_buff *skb;
+	__be16 *skb_len;
+	int ret;
+
+	lockdep_assert_held(&hardif_neigh->agg_lock);
+
+	num_packets = skb_queue_len(&hardif_neigh->agg_queue);
+	if (!num_packets)
+		return;
+
+	if (num_packets == 1) {
+		skb_agg = __skb_dequeue(&hardif_neigh->agg_queue);
+		hardif_neigh->agg_len = 0;
+		goto send;
+	}
+
+	len = ETH_HLEN + sizeof(*agg_packet) + hardif_neigh->agg_len;
+	skb_agg = netdev_alloc_skb_ip_align(NULL, len);
+	if (!skb_agg) {
+		batadv_send_unicast_agg_list_free(hardif_neigh);
+		return;
+	}
+
+	skb_reserve(skb_agg, ETH_HLEN);
+
+	agg_packet = skb_put(skb_agg, sizeof(*agg_packet));
+	agg_packet->packet_type = BATADV_UNICAST_AGG;
+	agg_packet->version = BATADV_COMPAT_VERSION;
+	agg_packet->num_packets = num_packets;
+	agg_packet->reserved = 0;
+
+	while ((skb = __skb_dequeue(&hardif_neigh->agg_queue))) {
+		skb_len = skb_put(skb_agg, sizeof(*skb_len));
+		*skb_len = htons(skb->len);
+
+		skb_copy_bits(skb, 0, skb_put(skb_agg, skb->len), skb->len);
+		consume_skb(skb);
+	}
+
+	hardif_neigh->agg_len = 0;
+
+	batadv_inc_counter(bat_priv, BATADV_CNT_AGG_TX);
+	batadv_add_counter(bat_priv, BATADV_CNT_AGG_TX_PACKETS, num_packets);
+
+send:
+	len = skb_agg->len;
+	ret = batadv_send_skb_packet(skb_agg, hardif_neigh->if_incoming,
+				     hardif_neigh->addr);
+
+	batadv_send_neigh_tx_account(hardif_neigh, len, ret);
+}
+
+/**
+ * batadv_send_unicast_agg_work() - send the unicast packets which were queued
+ *  for a neighbor once the aggregation delay has passed
+ * @work: work queue item
+ */
+void batadv_send_unicast_agg_work(struct work_struct *work)
+{
+	struct batadv_hardif_neigh_node *hardif_neigh;
+	struct batadv_hard_iface *hard_iface;
+	struct net_device *soft_iface;
+	struct delayed_work *delayed_work;
+
+	delayed_work = to_delayed_work(work);
+	hardif_neigh = container_of(delayed_work,
+				    struct batadv_hardif_neigh_node, agg_work);
+	hard_iface = hardif_neigh->if_incoming;
+
+	spin_lock_bh(&hardif_neigh->agg_lock);
+	soft_iface = hard_iface->soft_iface;
+	if (soft_iface)
+		batadv_send_unicast_agg_send(netdev_priv(soft_iface),
+					     hardif_neigh);
+	else
+		batadv_send_unicast_agg_list_free(hardif_neigh);
+	spin_unlock_bh(&hardif_neigh->agg_lock);
+
+	/* the reference was taken when the work was queued */
+	batadv_hardif_neigh_put(hardif_neigh);
+}
+
+/**
+ * batadv_send_unicast_agg_capable() - check whether a neighbor is able to
+ *  receive unicast aggregates
+ * @bat_priv: the bat priv with all the soft interface information
+ * @hardif_neigh: the neighbor to check
+ *
+ * Return: true if the originator of the neighbor announced the capability
+ */
+static bool
+batadv_send_unicast_agg_capable(struct batadv_priv *bat_priv,
+				struct batadv_hardif_neigh_node *hardif_neigh)
+{
+	struct batadv_orig_node *orig_node;
+	bool capable;
+
+	orig_node = batadv_orig_hash_find(bat_priv, hardif_neigh->orig);
+	if (!orig_node)
+		return false;
+
+	capable = test_bit(BATADV_ORIG_CAPA_HAS_UNICAST_AGG,
+			   &orig_node->capabilities);
+	batadv_orig_node_put(orig_node);
+
+	return capable;
+}
+
+/**
+ * batadv_send_unicast_agg_queue() - queue a unicast packet for aggregation
+ * @bat_priv: the bat priv with all the soft interface information
+ * @skb: packet to be transmitted (with batadv header and no outer eth header)
+ * @neigh_node: next hop the packet is sent to
+ *
+ * Small packets are held back for up to unicast_agg_delay milliseconds when
+ * the next hop is able to receive unicast aggregates, so that further packets
+ * for the same neighbor can share their frame. The queue is flushed early as
+ * soon as the next packet would not fit into the outgoing MTU anymore.
+ *
+ * Return: true if the skb was queued (and thus consumed), false if it has to
+ * be sent right away
+ */
+static bool batadv_send_unicast_agg_queue(struct batadv_priv *bat_priv,
+					  struct sk_buff *skb,
+					  struct batadv_neigh_node *neigh_node)
+{
+	struct batadv_hardif_neigh_node *hardif_neigh = neigh_node->hardif_neigh;
+	struct batadv_hard_iface *hard_iface = neigh_node->if_incoming;
+	unsigned int delay, max, len;
+
+	delay = atomic_read(&bat_priv->unicast_agg_delay);
+	if (!delay || skb->len > BATADV_UNICAST_AGG_PACKET_MAX)
+		return false;
+
+	if (atomic_read(&bat_priv->mesh_state) != BATADV_MESH_ACTIVE ||
+	    hard_iface->if_status != BATADV_IF_ACTIVE)
+		return false;
+
+	if (!batadv_send_unicast_agg_capable(bat_priv, hardif_neigh))
+		return false;
+
+	/* the packet is copied into the aggregate, the device can't fill in
+	 * its checksum anymore
+	 */
+	if (skb->ip_summed == CHECKSUM_PARTIAL && skb_checksum_help(skb) < 0)
+		return false;
+
+	max = hard_iface->net_dev->mtu - sizeof(struct batadv_unicast_agg_packet);
+	len = sizeof(__be16) + skb->len;
+
+	spin_lock_bh(&hardif_neigh->agg_lock);
+	if (hardif_neigh->agg_len + len > max ||
+	    skb_queue_len(&hardif_neigh->agg_queue) == U8_MAX)
+		batadv_send_unicast_agg_send(bat_priv, hardif_neigh);
+
+	/* the first packet of an aggregate starts its delay - the work keeps
+	 * the neighbor alive until then
+	 */
+	if (skb_queue_empty(&hardif_neigh->agg_queue)) {
+		kref_get(&hardif_neigh->refcount);
+		if (!queue_delayed_work(bat_priv->event_wq,
+					&hardif_neigh->agg_work,
+					msecs_to_jiffies(delay)))
+			batadv_hardif_neigh_put(hardif_neigh);
+	}
+
+	hardif_neigh->agg_len += len;
+	__skb_queue_tail(&hardif_neigh->agg_queue, skb);
+	spin_unlock_bh(&hardif_neigh->agg_lock);
+
+	return true;
+}
+
+/**
+ * batadv_send_unicast_agg_purge() - drop the queued unicast aggregates of an
+ *  interface
+ * @hard_iface: the interface whose neighbors should be purged
+ */
+static void
+batadv_send_unicast_agg_purge(const struct batadv_hard_iface *hard_iface)
+{
+	struct batadv_hardif_neigh_node *hardif_neigh;
+
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(hardif_neigh, &hard_iface->neigh_list, list) {
+		/* a running work flushes the queue on its own */
+		if (!cancel_delayed_work(&hardif_neigh->agg_work))
+			continue;
+
+		spin_lock_bh(&hardif_neigh->agg_lock);
+		batadv_send_unicast_agg_list_free(hardif_neigh);
+		spin_unlock_bh(&hardif_neigh->agg_lock);
+
+		batadv_hardif_neigh_put(hardif_neigh);
+	}
+	rcu_read_unlock();
+}
+
+/**
+ * batadv_send_unicast_agg_tvlv_ogm_handler_v1() - process incoming unicast
+ *  aggregation tvlv container
+ * @bat_priv: the bat priv with all the soft interface information
+ * @orig: the orig_node of the ogm
+ * @flags: flags indicating the tvlv state (see batadv_tvlv_handler_flags)
+ * @tvlv_value: tvlv buffer containing the unicast aggregation data
+ * @tvlv_value_len: tvlv buffer length
+ */
+static void
+batadv_send_unicast_agg_tvlv_ogm_handler_v1(struct batadv_priv *bat_priv,
+					    struct batadv_orig_node *orig,
+					    u8 flags, void *tvlv_value,
+					    u16 tvlv_value_len)
+{
+	if (flags & BATADV_TVLV_HANDLER_OGM_CIFNOTFND)
+		clear_bit(BATADV_ORIG_CAPA_HAS_UNICAST_AGG, &orig->capabilities);
+	else
+		set_bit(BATADV_ORIG_CAPA_HAS_UNICAST_AGG, &orig->capabilities);
+}
+
+/**
+ * batadv_send_unicast_agg_init() - announce the ability to receive unicast
+ *  aggregates and learn it from other nodes
+ * @bat_priv: the bat priv with all the soft interface information
+ */
+void batadv_send_unicast_agg_init(struct batadv_priv *bat_priv)
+{
+	batadv_tvlv_handler_register(bat_priv,
+				     batadv_send_unicast_agg_tvlv_ogm_handler_v1,
+				     NULL, BATADV_TVLV_UNICAST_AGG, 1,
+				     BATADV_TVLV_HANDLER_OGM_CIFNOTFND);
+	batadv_tvlv_container_register(bat_priv, BATADV_TVLV_UNICAST_AGG, 1,
+				       NULL, 0);
+}
+
+/**
+ * batadv_send_unicast_agg_free() - stop announcing the ability to receive
+ *  unicast aggregates
+ * @bat_priv: the bat priv with all the soft interface information
+ */
+void batadv_send_unicast_agg_free(struct batadv_priv *bat_priv)
+{
+	batadv_tvlv_container_unregister(bat_priv, BATADV_TVLV_UNICAST_AGG, 1);
+	batadv_tvlv_handler_unregister(bat_priv, BATADV_TVLV_UNICAST_AGG, 1);
+}
+
+/**
+ * batadv_send_skb_to_neigh() - transmit skb via an already selected next-hop
+ * @skb: Packet to be transmitted.
+ * @orig_node: Final destination of the packet.
+ * @neigh_node: next-hop towards orig_node
+ * @recv_if: Interface used when receiving the packet (can be NULL).
+ *
+ * Regardless of the return value, the skb is consumed.
+ *
+ * Return: negative errno code on a failure, -EINPROGRESS if the skb is
+ * buffered for later transmit or the NET_XMIT status returned by the
+ * lower routine if the packet has been passed down.
+ */
+static int batadv_send_skb_to_neigh(struct sk_buff *skb,
+				    struct batadv_orig_node *orig_node,
+				    struct batadv_neigh_node *neigh_node,
+				    struct batadv_hard_iface *recv_if)
+{
+	struct batadv_priv *bat_priv = orig_node->bat_priv;
+
+	/* Check if the skb is too large to send in one piece and fragment
+	 * it if needed.
+	 */
+	if (atomic_read(&bat_priv->fragmentation) &&
+	    skb->len > batadv_frag_path_mtu(orig_node, neigh_node))
+		return batadv_frag_send_packet(skb, orig_node, neigh_node);
+
+	/* try to network code the packet, if it is received on an interface
+	 * (i.e. being forwarded). If the packet originates from this node or if
+	 * network coding fails, then send the packet as usual.
+	 */
+	if (recv_if && batadv_nc_skb_forward(skb, neigh_node))
+		return -EINPROGRESS;
+
+	/* small packets may share a frame with others for the same next-hop */
+	if (batadv_send_unicast_agg_queue(bat_priv, skb, neigh_node))
+		return NET_XMIT_SUCCESS;
+
+	return batadv_send_unicast_skb(skb, neigh_node);
+}
+
+/**
+ * batadv_send_skb_segment() - split an encapsulated GSO frame into segments
+ * @bat_priv: the bat priv with all the soft interface information
+ * @skb: unicast GSO packet with the batman-adv header at skb->data
+ *
+ * The payload is segmented like any other ethernet frame and the batman-adv
+ * unicast header is copied in front of every segment. The checksums of the
+ * segments are computed in software because no lower device is able to
+ * offload them through the batman-adv header.
+ *
+ * Regardless of the return value, the skb is consumed.
+ *
+ * Return: the list of encapsulated segments or an ERR_PTR on failure
+ */
+static struct sk_buff *batadv_send_skb_segment(struct batadv_priv *bat_priv,
+						struct sk_buff *skb)
+{
+	struct batadv_unicast_4addr_packet hdr;
+	struct sk_buff *segs, *seg;
+	unsigned int hdr_len;
+	__be16 protocol;
+
+	switch (skb->data[0]) {
+	case BATADV_UNICAST:
+		hdr_len = sizeof(struct batadv_unicast_packet);
+		break;
+	case BATADV_UNICAST_4ADDR:
+		hdr_len = sizeof(struct batadv_unicast_4addr_packet);
+		break;
+	default:
+		segs = ERR_PTR(-EINVAL);
+		goto free_skb;
+	}
+
+	if (!pskb_may_pull(skb, hdr_len + ETH_HLEN)) {
+		segs = ERR_PTR(-ENOMEM);
+		goto free_skb;
+	}
+
+	memcpy(&hdr, skb->data, hdr_len);
+	protocol = skb->protocol;
+
+	/* let the generic code see the encapsulated ethernet frame */
+	__skb_pull(skb, hdr_len);
+	skb_reset_mac_header(skb);
+	skb_set_network_header(skb, ETH_HLEN);
+	skb->protocol = eth_hdr(skb)->h_proto;
+
+	segs = skb_gso_segment(skb, 0);
+	if (IS_ERR_OR_NULL(segs)) {
+		segs = segs ? segs : ERR_PTR(-EINVAL);
+		goto free_skb;
+	}
+
+	for (seg = segs; seg; seg = seg->next) {
+		if (batadv_skb_head_push(bat_priv, seg, hdr_len,
+					 BATADV_CNT_HEADROOM_ENCAP) < 0) {
+			kfree_skb_list(segs);
+			segs = ERR_PTR(-ENOMEM);
+			goto free_skb;
+		}
+
+		memcpy(seg->data, &hdr, hdr_len);
+		seg->protocol = protocol;
+	}
+
+	consume_skb(skb);
+	return segs;
+
+free_skb:
+	kfree_skb(skb);
+	return segs;
+}
+
 /**
  * batadv_send_skb_to_orig() - Lookup next-hop and transmit skb.
  * @skb: Packet to be transmitted.
@@ -192,40 +709,49 @@ int batadv_send_skb_to_orig(struct sk_buff *skb,
 {
 	struct batadv_priv *bat_priv = orig_node->bat_priv;
 	struct batadv_neigh_node *neigh_node;
-	int ret;
+	struct sk_buff *segs, *next;
+	int ret, seg_ret;
 
 	/* batadv_find_router() increases neigh_nodes refcount if found. */
-	neigh_node = batadv_find_router(bat_priv, orig_node, recv_if);
+	neigh_node = batadv_find_router(bat_priv, orig_node, recv_if, skb);
 	if (!neigh_node) {
 		ret = -EINVAL;
 		goto free_skb;
 	}
 
-	/* Check if the skb is too large to send in one piece and fragment
-	 * it if needed.
-	 */
-	if (atomic_read(&bat_priv->fragmentation) &&
-	    skb->len > neigh_node->if_incoming->net_dev->mtu) {
-		/* Fragment and send packet. */
-		ret = batadv_frag_send_packet(skb, orig_node, neigh_node);
+	if (!skb_is_gso(skb)) {
+		ret = batadv_send_skb_to_neigh(skb, orig_node, neigh_node,
+					       recv_if);
 		/* skb was consumed */
 		skb = NULL;
 
 		goto put_neigh_node;
 	}
 
-	/* try to network code the packet, if it is received on an interface
-	 * (i.e. being forwarded). If the packet originates from this node or if
-	 * network coding fails, then send the packet as usual.
+	/* the frame was encapsulated and routed only once - now split it into
+	 * segments which all follow the same next-hop
 	 */
-	if (recv_if && batadv_nc_skb_forward(skb, neigh_node))
-		ret = -EINPROGRESS;
-	else
-		ret = batadv_send_unicast_skb(skb, neigh_node);
-
+	segs = batadv_send_skb_segment(bat_priv, skb);
 	/* skb was consumed */
 	skb = NULL;
 
+	if (IS_ERR(segs)) {
+		ret = PTR_ERR(segs);
+		goto put_neigh_node;
+	}
+
+	/* report the first segment which could not be sent */
+	ret = NET_XMIT_SUCCESS;
+	for (; segs; segs = next) {
+		next = segs->next;
+		segs->next = NULL;
+
+		seg_ret = batadv_send_skb_to_neigh(segs, orig_node, neigh_node,
+						   recv_if);
+		if (ret == NET_XMIT_SUCCESS)
+			ret = seg_ret;
+	}
+
 put_neigh_node:
 	batadv_neigh_node_put(neigh_node);
 free_skb:
@@ -250,7 +776,8 @@ batadv_send_skb_push_fill_unicast(struct sk_buff *skb, int hdr_size,
 	struct batadv_unicast_packet *unicast_packet;
 	u8 ttvn = (u8)atomic_read(&orig_node->last_ttvn);
 
-	if (batadv_skb_head_push(skb, hdr_size) < 0)
+	if (batadv_skb_head_push(orig_node->bat_priv, skb, hdr_size,
+				 BATADV_CNT_HEADROOM_ENCAP) < 0)
 		return false;
 
 	unicast_packet = (struct batadv_unicast_packet *)skb->data;
@@ -449,23 +976,29 @@ int batadv_send_skb_via_tt_generic(struct batadv_priv *bat_priv,
  * @skb: payload to send
  * @vid: the vid to be used to search the translation table
  *
- * Look up the currently selected gateway. Wrap the given skb into a batman-adv
- * unicast header and send this frame to this gateway node.
+ * Look up the gateway serving the sender of the frame (usually the currently
+ * selected gateway). Wrap the given skb into a batman-adv unicast header and
+ * send this frame to this gateway node.
  *
  * Return: NET_XMIT_DROP in case of error or NET_XMIT_SUCCESS otherwise.
  */
 int batadv_send_skb_via_gw(struct batadv_priv *bat_priv, struct sk_buff *skb,
 			   unsigned short vid)
 {
-	struct batadv_orig_node *orig_node;
+	struct ethhdr *ethhdr = (struct ethhdr *)skb->data;
+	struct batadv_orig_node *orig_node = NULL;
+	struct batadv_gw_node *gw_node;
 	int ret;
 
-	orig_node = batadv_gw_get_selected_orig(bat_priv);
+	gw_node = batadv_gw_get_client_gw_node(bat_priv, ethhdr->h_source);
+	if (gw_node)
+		orig_node = gw_node->orig_node;
+
 	ret = batadv_send_skb_unicast(bat_priv, skb, BATADV_UNICAST_4ADDR,
 				      BATADV_P_DATA, orig_node, vid);
 
-	if (orig_node)
-		batadv_orig_node_put(orig_node);
+	if (gw_node)
+		batadv_gw_node_put(gw_node);
 
 	return ret;
 }
@@ -492,7 +1025,7 @@ void batadv_forw_packet_free(struct batadv_forw_packet *forw_packet,
 		batadv_hardif_put(forw_packet->if_outgoing);
 	if (forw_packet->queue_left)
 		atomic_inc(forw_packet->queue_left);
-	kfree(forw_packet);
+	kmem_cache_free(batadv_forw_packet_cache, forw_packet);
 }
 
 /**
@@ -534,7 +1067,7 @@ batadv_forw_packet_alloc(struct batadv_hard_iface *if_incoming,
 		return NULL;
 	}
 
-	forw_packet = kmalloc(sizeof(*forw_packet), GFP_ATOMIC);
+	forw_packet = kmem_cache_alloc(batadv_forw_packet_cache, GFP_ATOMIC);
 	if (!forw_packet)
 		goto err;
 
@@ -544,7 +1077,8 @@ batadv_forw_packet_alloc(struct batadv_hard_iface *if_incoming,
 	if (if_outgoing)
 		kref_get(&if_outgoing->refcount);
 
-	INIT_HLIST_NODE(&forw_packet->list);
+	INIT_LIST_HEAD(&forw_packet->list);
+	INIT_LIST_HEAD(&forw_packet->aggr_list);
 	INIT_HLIST_NODE(&forw_packet->cleanup_list);
 	forw_packet->skb = skb;
 	forw_packet->queue_left = queue_left;
@@ -598,7 +1132,8 @@ bool batadv_forw_packet_steal(struct batadv_forw_packet *forw_packet,
 		return false;
 	}
 
-	hlist_del_init(&forw_packet->list);
+	list_del_init(&forw_packet->list);
+	list_del_init(&forw_packet->aggr_list);
 
 	/* Just to spot misuse of this function */
 	hlist_add_fake(&forw_packet->cleanup_list);
@@ -621,15 +1156,13 @@ bool batadv_forw_packet_steal(struct batadv_forw_packet *forw_packet,
  * by that allows already running threads to notice the claiming.
  */
 static void
-batadv_forw_packet_list_steal(struct hlist_head *forw_list,
+batadv_forw_packet_list_steal(struct list_head *forw_list,
 			      struct hlist_head *cleanup_list,
 			      const struct batadv_hard_iface *hard_iface)
 {
-	struct batadv_forw_packet *forw_packet;
-	struct hlist_node *safe_tmp_node;
+	struct batadv_forw_packet *forw_packet, *safe;
 
-	hlist_for_each_entry_safe(forw_packet, safe_tmp_node,
-				  forw_list, list) {
+	list_for_each_entry_safe(forw_packet, safe, forw_list, list) {
 		/* if purge_outstanding_packets() was called with an argument
 		 * we delete only packets belonging to the given interface
 		 */
@@ -638,7 +1171,8 @@ batadv_forw_packet_list_steal(struct hlist_head *forw_list,
 		    forw_packet->if_outgoing != hard_iface)
 			continue;
 
-		hlist_del(&forw_packet->list);
+		list_del_init(&forw_packet->list);
+		list_del_init(&forw_packet->aggr_list);
 		hlist_add_head(&forw_packet->cleanup_list, cleanup_list);
 	}
 }
@@ -647,11 +1181,8 @@ batadv_forw_packet_list_steal(struct hlist_head *forw_list,
  * batadv_forw_packet_list_free() - free a list of forward packets
  * @head: a list of to be freed forw_packets
  *
- * This function cancels the scheduling of any packet in the provided list,
- * waits for any possibly running packet forwarding thread to finish and
- * finally, safely frees this forward packet.
- *
- * This function might sleep.
+ * The scheduler of the packets must not send them anymore, see
+ * batadv_forw_sched_purge().
  */
 static void batadv_forw_packet_list_free(struct hlist_head *head)
 {
@@ -660,18 +1191,181 @@ static void batadv_forw_packet_list_free(struct hlist_head *head)
 
 	hlist_for_each_entry_safe(forw_packet, safe_tmp_node, head,
 				  cleanup_list) {
-		cancel_delayed_work_sync(&forw_packet->delayed_work);
-
 		hlist_del(&forw_packet->cleanup_list);
 		batadv_forw_packet_free(forw_packet, true);
 	}
 }
 
+/**
+ * batadv_forw_sched_arm() - wake up the scheduler when its first packet is due
+ * @sched: the scheduler to arm
+ *
+ * Caller must hold @sched->lock.
+ */
+static void batadv_forw_sched_arm(struct batadv_forw_sched *sched)
+{
+	struct batadv_forw_packet *first;
+	unsigned long delay = 0;
+
+	lockdep_assert_held(&sched->lock);
+
+	first = list_first_entry_or_null(&sched->list,
+					 struct batadv_forw_packet, list);
+	if (!first)
+		return;
+
+	if (time_after(first->send_time, jiffies))
+		delay = first->send_time - jiffies;
+
+	mod_delayed_work(sched->wq, &sched->work, delay);
+}
+
+/**
+ * batadv_forw_sched_work() - send all due packets of a scheduler
+ * @work: work queue item
+ *
+ * The due packets are moved to the due list in one batch. Their send function
+ * removes them from there by either requeuing or freeing them, so that
+ * batadv_forw_sched_purge() can still claim the packets which were not sent
+ * yet.
+ */
+static void batadv_forw_sched_work(struct work_struct *work)
+{
+	struct batadv_forw_packet *forw_packet, *safe;
+	struct delayed_work *delayed_work;
+	struct batadv_forw_sched *sched;
+
+	delayed_work = to_delayed_work(work);
+	sched = container_of(delayed_work, struct batadv_forw_sched, work);
+
+	spin_lock_bh(&sched->lock);
+	list_for_each_entry_safe(forw_packet, safe, &sched->list, list) {
+		if (time_before(jiffies, forw_packet->send_time))
+			break;
+
+		list_move_tail(&forw_packet->list, &sched->due);
+
+		/* nothing must be added to a packet which is being sent */
+		list_del_init(&forw_packet->aggr_list);
+	}
+
+	while ((forw_packet = list_first_entry_or_null(&sched->due,
+						       struct batadv_forw_packet,
+						       list))) {
+		spin_unlock_bh(&sched->lock);
+
+		batadv_send_delay_add(sched->bat_priv, sched->delay_cnt,
+				      forw_packet->send_time);
+		forw_packet->send(forw_packet);
+		cond_resched();
+
+		spin_lock_bh(&sched->lock);
+	}
+
+	batadv_forw_sched_arm(sched);
+	spin_unlock_bh(&sched->lock);
+}
+
+/**
+ * batadv_send_delay_add() - account how late a scheduled message is sent
+ * @bat_priv: the bat priv with all the soft interface information
+ * @idx: counter summing up the delays in microseconds
+ * @due: time (jiffies) the message was supposed to be sent
+ */
+void batadv_send_delay_add(struct batadv_priv *bat_priv,
+			   enum batadv_counters idx, unsigned long due)
+{
+	if (!time_after(jiffies, due))
+		return;
+
+	batadv_add_counter(bat_priv, idx, jiffies_to_usecs(jiffies - due));
+}
+
+/**
+ * batadv_forw_sched_init() - initialize a forwarding packet scheduler
+ * @bat_priv: the bat priv with all the soft interface information
+ * @sched: the scheduler to initialize
+ * @wq: workqueue to send the packets from
+ * @delay_cnt: counter summing up how late the packets were sent
+ */
+void batadv_forw_sched_init(struct batadv_priv *bat_priv,
+			    struct batadv_forw_sched *sched,
+			    struct workqueue_struct *wq,
+			    enum batadv_counters delay_cnt)
+{
+	INIT_LIST_HEAD(&sched->list);
+	INIT_LIST_HEAD(&sched->due);
+	spin_lock_init(&sched->lock);
+	INIT_DELAYED_WORK(&sched->work, batadv_forw_sched_work);
+	sched->wq = wq;
+	sched->delay_cnt = delay_cnt;
+	sched->bat_priv = bat_priv;
+}
+
+/**
+ * batadv_forw_sched_purge() - claim and free the packets of a scheduler
+ * @sched: the scheduler to purge
+ * @hard_iface: the interface to purge packets of, NULL for all packets
+ *
+ * The queued packets and the not yet sent packets of a running batch are
+ * claimed together under the lock of the scheduler. The packets are only freed
+ * after the running batch finished, as one of them may still be in the hands
+ * of its send function.
+ *
+ * This function might sleep.
+ */
+static void batadv_forw_sched_purge(struct batadv_forw_sched *sched,
+				    const struct batadv_hard_iface *hard_iface)
+{
+	struct hlist_head head = HLIST_HEAD_INIT;
+
+	spin_lock_bh(&sched->lock);
+	batadv_forw_packet_list_steal(&sched->list, &head, hard_iface);
+	batadv_forw_packet_list_steal(&sched->due, &head, hard_iface);
+	spin_unlock_bh(&sched->lock);
+
+	cancel_delayed_work_sync(&sched->work);
+
+	spin_lock_bh(&sched->lock);
+	batadv_forw_sched_arm(sched);
+	spin_unlock_bh(&sched->lock);
+
+	batadv_forw_packet_list_free(&head);
+}
+
+/**
+ * batadv_forw_sched_insert() - insert a packet into the sorted queue
+ * @sched: the scheduler to queue the packet on
+ * @forw_packet: the forwarding packet to insert (not queued)
+ * @send_time: timestamp (jiffies) when the packet is to be sent
+ *
+ * Caller must hold @sched->lock.
+ */
+static void batadv_forw_sched_insert(struct batadv_forw_sched *sched,
+				     struct batadv_forw_packet *forw_packet,
+				     unsigned long send_time)
+{
+	struct list_head *prev = &sched->list;
+	struct batadv_forw_packet *pos;
+
+	lockdep_assert_held(&sched->lock);
+
+	forw_packet->send_time = send_time;
+
+	/* new packets are mostly due last, search their position from the end */
+	list_for_each_entry_reverse(pos, &sched->list, list) {
+		if (!time_before(send_time, pos->send_time)) {
+			prev = &pos->list;
+			break;
+		}
+	}
+	list_add(&forw_packet->list, prev);
+}
+
 /**
  * batadv_forw_packet_queue() - try to queue a forwarding packet
+ * @sched: the scheduler to queue the packet on
  * @forw_packet: the forwarding packet to queue
- * @lock: a key to the store (e.g. forw_{bat,bcast}_list_lock)
- * @head: the shelve to queue it on (e.g. forw_{bat,bcast}_list)
  * @send_time: timestamp (jiffies) when the packet is to be sent
  *
  * This function tries to (re)queue a forwarding packet. Requeuing
@@ -682,13 +1376,13 @@ static void batadv_forw_packet_list_free(struct hlist_head *head)
  * Calling batadv_forw_packet_queue() after a call to
  * batadv_forw_packet_steal() is forbidden!
  *
- * Caller needs to ensure that forw_packet->delayed_work was initialized.
+ * Caller needs to ensure that forw_packet->send was set.
  */
-static void batadv_forw_packet_queue(struct batadv_forw_packet *forw_packet,
-				     spinlock_t *lock, struct hlist_head *head,
+static void batadv_forw_packet_queue(struct batadv_forw_sched *sched,
+				     struct batadv_forw_packet *forw_packet,
 				     unsigned long send_time)
 {
-	spin_lock_bh(lock);
+	spin_lock_bh(&sched->lock);
 
 	/* did purging routine steal it from us? */
 	if (batadv_forw_packet_was_stolen(forw_packet)) {
@@ -698,17 +1392,18 @@ static void batadv_forw_packet_queue(struct batadv_forw_packet *forw_packet,
 		WARN_ONCE(hlist_fake(&forw_packet->cleanup_list),
 			  "Requeuing after batadv_forw_packet_steal() not allowed!\n");
 
-		spin_unlock_bh(lock);
+		spin_unlock_bh(&sched->lock);
 		return;
 	}
 
-	hlist_del_init(&forw_packet->list);
-	hlist_add_head(&forw_packet->list, head);
+	list_del_init(&forw_packet->list);
+	batadv_forw_sched_insert(sched, forw_packet, send_time);
 
-	queue_delayed_work(batadv_event_workqueue,
-			   &forw_packet->delayed_work,
-			   send_time - jiffies);
-	spin_unlock_bh(lock);
+	/* only a new first packet changes the wake up time */
+	if (sched->list.next == &forw_packet->list)
+		batadv_forw_sched_arm(sched);
+
+	spin_unlock_bh(&sched->lock);
 }
 
 /**
@@ -719,15 +1414,14 @@ static void batadv_forw_packet_queue(struct batadv_forw_packet *forw_packet,
  *
  * This function tries to (re)queue a broadcast packet.
  *
- * Caller needs to ensure that forw_packet->delayed_work was initialized.
+ * Caller needs to ensure that forw_packet->send was set.
  */
 static void
 batadv_forw_packet_bcast_queue(struct batadv_priv *bat_priv,
 			       struct batadv_forw_packet *forw_packet,
 			       unsigned long send_time)
 {
-	batadv_forw_packet_queue(forw_packet, &bat_priv->forw_bcast_list_lock,
-				 &bat_priv->forw_bcast_list, send_time);
+	batadv_forw_packet_queue(&bat_priv->forw_bcast, forw_packet, send_time);
 }
 
 /**
@@ -738,14 +1432,47 @@ batadv_forw_packet_bcast_queue(struct batadv_priv *bat_priv,
  *
  * This function tries to (re)queue an OGMv1 packet.
  *
- * Caller needs to ensure that forw_packet->delayed_work was initialized.
+ * Caller needs to ensure that forw_packet->send was set.
  */
 void batadv_forw_packet_ogmv1_queue(struct batadv_priv *bat_priv,
 				    struct batadv_forw_packet *forw_packet,
 				    unsigned long send_time)
 {
-	batadv_forw_packet_queue(forw_packet, &bat_priv->forw_bat_list_lock,
-				 &bat_priv->forw_bat_list, send_time);
+	batadv_forw_packet_queue(&bat_priv->forw_bat, forw_packet, send_time);
+}
+
+/**
+ * batadv_forw_packet_ogmv1_advance() - send the queued own OGMv1 packets
+ *  earlier
+ * @bat_priv: the bat priv with all the soft interface information
+ * @send_time: timestamp (jiffies) the own OGMs have to be sent at the latest
+ *
+ * The own OGMs which are due after @send_time are rescheduled to @send_time.
+ */
+void batadv_forw_packet_ogmv1_advance(struct batadv_priv *bat_priv,
+				      unsigned long send_time)
+{
+	struct batadv_forw_sched *sched = &bat_priv->forw_bat;
+	struct batadv_forw_packet *forw_packet, *safe;
+	LIST_HEAD(advanced);
+
+	spin_lock_bh(&sched->lock);
+	list_for_each_entry_safe_reverse(forw_packet, safe, &sched->list,
+					 list) {
+		if (!time_after(forw_packet->send_time, send_time))
+			break;
+
+		if (forw_packet->own)
+			list_move(&forw_packet->list, &advanced);
+	}
+
+	list_for_each_entry_safe(forw_packet, safe, &advanced, list) {
+		list_del_init(&forw_packet->list);
+		batadv_forw_sched_insert(sched, forw_packet, send_time);
+	}
+
+	batadv_forw_sched_arm(sched);
+	spin_unlock_bh(&sched->lock);
 }
 
 /**
@@ -758,13 +1485,19 @@ void batadv_forw_packet_ogmv1_queue(struct batadv_priv *bat_priv,
  * add a broadcast packet to the queue and setup timers. broadcast packets
  * are sent multiple times to increase probability for being received.
  *
+ * Self-generated broadcasts whose header is not shared with anyone else are
+ * only cloned: the TTL is rewritten in place and the payload is shared with
+ * the original skb, which the caller is expected to drop right away. All
+ * other packets get a private copy of the linear header area while the paged
+ * payload is still shared.
+ *
  * The skb is not consumed, so the caller should make sure that the
  * skb is freed.
  *
  * Return: NETDEV_TX_OK on success and NETDEV_TX_BUSY on errors.
  */
 int batadv_add_bcast_packet_to_list(struct batadv_priv *bat_priv,
-				    const struct sk_buff *skb,
+				    struct sk_buff *skb,
 				    unsigned long delay,
 				    bool own_packet)
 {
@@ -777,7 +1510,16 @@ int batadv_add_bcast_packet_to_list(struct batadv_priv *bat_priv,
 	if (!primary_if)
 		goto err;
 
-	newskb = skb_copy(skb, GFP_ATOMIC);
+	/* a received broadcast is still handed up by the caller after this
+	 * function returned and skb_pull_rcsum() would stumble over a modified
+	 * header. Someone else (e.g. a packet socket) might also read the
+	 * header of an already cloned skb
+	 */
+	if (own_packet && !skb_header_cloned(skb))
+		newskb = skb_clone(skb, GFP_ATOMIC);
+	else
+		newskb = pskb_copy(skb, GFP_ATOMIC);
+
 	if (!newskb) {
 		batadv_hardif_put(primary_if);
 		goto err;
@@ -790,14 +1532,13 @@ int batadv_add_bcast_packet_to_list(struct batadv_priv *bat_priv,
 	if (!forw_packet)
 		goto err_packet_free;
 
-	/* as we have a copy now, it is safe to decrease the TTL */
+	/* nobody else reads this header anymore, decreasing the TTL is safe */
 	bcast_packet = (struct batadv_bcast_packet *)newskb->data;
 	bcast_packet->ttl--;
 
 	forw_packet->own = own_packet;
 
-	INIT_DELAYED_WORK(&forw_packet->delayed_work,
-			  batadv_send_outstanding_bcast_packet);
+	forw_packet->send = batadv_send_outstanding_bcast_packet;
 
 	batadv_forw_packet_bcast_queue(bat_priv, forw_packet, jiffies + delay);
 	return NETDEV_TX_OK;
@@ -811,29 +1552,56 @@ err:
 /**
  * batadv_forw_packet_bcasts_left() - check if a retransmission is necessary
  * @forw_packet: the forwarding packet to check
- * @hard_iface: the interface to check on
+ * @num_bcasts: number of transmissions on the interface to check on, see
+ *  batadv_hardif_num_bcasts()
  *
  * Checks whether a given packet has any (re)transmissions left on the provided
  * interface.
  *
- * hard_iface may be NULL: In that case the number of transmissions this skb had
- * so far is compared with the maximum amount of retransmissions independent of
- * any interface instead.
- *
  * Return: True if (re)transmissions are left, false otherwise.
  */
 static bool
 batadv_forw_packet_bcasts_left(struct batadv_forw_packet *forw_packet,
-			       struct batadv_hard_iface *hard_iface)
+			       unsigned int num_bcasts)
 {
-	unsigned int max;
+	return BATADV_SKB_CB(forw_packet->skb)->num_bcasts < num_bcasts;
+}
 
-	if (hard_iface)
-		max = hard_iface->num_bcasts;
-	else
-		max = BATADV_NUM_BCASTS_MAX;
+/**
+ * batadv_forw_packet_bcast_dups() - get the number of duplicates received of
+ *  a forwarded broadcast
+ * @bat_priv: the bat priv with all the soft interface information
+ * @forw_packet: the broadcast packet
+ *
+ * Return: the number of copies of the broadcast which were received from
+ * other neighbors after the first one, 0 for own broadcasts.
+ */
+static u8 batadv_forw_packet_bcast_dups(struct batadv_priv *bat_priv,
+					struct batadv_forw_packet *forw_packet)
+{
+	struct batadv_bcast_packet *bcast_packet;
+	struct batadv_orig_node *orig_node;
+	atomic_t *dups_cnt;
+	u8 dups = 0;
+	u32 seqno;
+
+	if (forw_packet->own)
+		return 0;
+
+	bcast_packet = (struct batadv_bcast_packet *)forw_packet->skb->data;
+	orig_node = batadv_orig_hash_find(bat_priv, bcast_packet->orig);
+	if (!orig_node)
+		return 0;
+
+	seqno = ntohl(bcast_packet->seqno);
+	dups_cnt = &orig_node->bcast_dups[seqno % BATADV_BCAST_MAX_AGE];
+
+	if (batadv_seqno_window_seen(&orig_node->bcast_window, seqno))
+		dups = atomic_read(dups_cnt);
 
-	return BATADV_SKB_CB(forw_packet->skb)->num_bcasts < max;
+	batadv_orig_node_put(orig_node);
+
+	return dups;
 }
 
 /**
@@ -858,25 +1626,24 @@ bool batadv_forw_packet_is_rebroadcast(struct batadv_forw_packet *forw_packet)
 	return BATADV_SKB_CB(forw_packet->skb)->num_bcasts > 0;
 }
 
-static void batadv_send_outstanding_bcast_packet(struct work_struct *work)
+static void
+batadv_send_outstanding_bcast_packet(struct batadv_forw_packet *forw_packet)
 {
 	struct batadv_hard_iface *hard_iface;
 	struct batadv_hardif_neigh_node *neigh_node;
-	struct delayed_work *delayed_work;
-	struct batadv_forw_packet *forw_packet;
 	struct batadv_bcast_packet *bcast_packet;
 	struct sk_buff *skb1;
 	struct net_device *soft_iface;
 	struct batadv_priv *bat_priv;
 	unsigned long send_time = jiffies + msecs_to_jiffies(5);
+	unsigned int num_bcasts;
 	bool dropped = false;
+	bool again = false;
 	u8 *neigh_addr;
 	u8 *orig_neigh;
 	int ret = 0;
+	u8 dups = 0;
 
-	delayed_work = to_delayed_work(work);
-	forw_packet = container_of(delayed_work, struct batadv_forw_packet,
-				   delayed_work);
 	soft_iface = forw_packet->if_incoming->soft_iface;
 	bat_priv = netdev_priv(soft_iface);
 
@@ -892,15 +1659,31 @@ static void batadv_send_outstanding_bcast_packet(struct work_struct *work)
 
 	bcast_packet = (struct batadv_bcast_packet *)forw_packet->skb->data;
 
+	if (batadv_forw_packet_is_rebroadcast(forw_packet))
+		dups = batadv_forw_packet_bcast_dups(bat_priv, forw_packet);
+
 	/* rebroadcast packet */
 	rcu_read_lock();
 	list_for_each_entry_rcu(hard_iface, &batadv_hardif_list, list) {
 		if (hard_iface->soft_iface != soft_iface)
 			continue;
 
-		if (!batadv_forw_packet_bcasts_left(forw_packet, hard_iface))
+		num_bcasts = batadv_hardif_num_bcasts(hard_iface);
+		if (!batadv_forw_packet_bcasts_left(forw_packet, num_bcasts))
 			continue;
 
+		/* a retransmission is redundant once the packet was heard from
+		 * as many neighbors as the interface has
+		 */
+		if (dups > 0 &&
+		    dups + 1 >= atomic_read(&hard_iface->num_neighs)) {
+			batadv_dbg(BATADV_DBG_BATMAN, bat_priv,
+				   "BCAST packet from orig %pM on %s suppressed: %u duplicates heard\n",
+				   bcast_packet->orig,
+				   hard_iface->net_dev->name, dups);
+			continue;
+		}
+
 		if (forw_packet->own) {
 			neigh_node = NULL;
 		} else {
@@ -953,13 +1736,17 @@ static void batadv_send_outstanding_bcast_packet(struct work_struct *work)
 			batadv_send_broadcast_skb(skb1, hard_iface);
 
 		batadv_hardif_put(hard_iface);
+
+		/* retransmissions left on this interface after this one */
+		if (batadv_forw_packet_bcasts_left(forw_packet, num_bcasts - 1))
+			again = true;
 	}
 	rcu_read_unlock();
 
 	batadv_forw_packet_bcasts_inc(forw_packet);
 
 	/* if we still have some more bcasts to send */
-	if (batadv_forw_packet_bcasts_left(forw_packet, NULL)) {
+	if (again) {
 		batadv_forw_packet_bcast_queue(bat_priv, forw_packet,
 					       send_time);
 		return;
@@ -967,8 +1754,7 @@ static void batadv_send_outstanding_bcast_packet(struct work_struct *work)
 
 out:
 	/* do we get something for free()? */
-	if (batadv_forw_packet_steal(forw_packet,
-				     &bat_priv->forw_bcast_list_lock))
+	if (batadv_forw_packet_steal(forw_packet, &bat_priv->forw_bcast.lock))
 		batadv_forw_packet_free(forw_packet, dropped);
 }
 
@@ -987,7 +1773,7 @@ void
 batadv_purge_outstanding_packets(struct batadv_priv *bat_priv,
 				 const struct batadv_hard_iface *hard_iface)
 {
-	struct hlist_head head = HLIST_HEAD_INIT;
+	struct batadv_hard_iface *tmp_iface;
 
 	if (hard_iface)
 		batadv_dbg(BATADV_DBG_BATMAN, bat_priv,
@@ -997,18 +1783,45 @@ batadv_purge_outstanding_packets(struct batadv_priv *bat_priv,
 		batadv_dbg(BATADV_DBG_BATMAN, bat_priv,
 			   "%s()\n", __func__);
 
-	/* claim bcast list for free() */
-	spin_lock_bh(&bat_priv->forw_bcast_list_lock);
-	batadv_forw_packet_list_steal(&bat_priv->forw_bcast_list, &head,
-				      hard_iface);
-	spin_unlock_bh(&bat_priv->forw_bcast_list_lock);
+	batadv_forw_sched_purge(&bat_priv->forw_bcast, hard_iface);
+	batadv_forw_sched_purge(&bat_priv->forw_bat, hard_iface);
 
-	/* claim batman packet list for free() */
-	spin_lock_bh(&bat_priv->forw_bat_list_lock);
-	batadv_forw_packet_list_steal(&bat_priv->forw_bat_list, &head,
-				      hard_iface);
-	spin_unlock_bh(&bat_priv->forw_bat_list_lock);
+	/* drop the unicast packets still waiting for aggregation */
+	if (hard_iface) {
+		batadv_send_unicast_agg_purge(hard_iface);
+		return;
+	}
 
-	/* then cancel or wait for packet workers to finish and free */
-	batadv_forw_packet_list_free(&head);
+	rcu_read_lock();
+	list_for_each_entry_rcu(tmp_iface, &batadv_hardif_list, list) {
+		if (tmp_iface->soft_iface == bat_priv->soft_iface)
+			batadv_send_unicast_agg_purge(tmp_iface);
+	}
+	rcu_read_unlock();
+}
+
+/**
+ * batadv_forw_packet_cache_init() - Initialize forw_packet memory object cache
+ *
+ * Return: 0 on success or negative error number in case of failure.
+ */
+int __init batadv_forw_packet_cache_init(void)
+{
+	size_t size = sizeof(struct batadv_forw_packet);
+
+	batadv_forw_packet_cache =
+		kmem_cache_create("batadv_forw_packet_cache", size, 0,
+				  SLAB_HWCACHE_ALIGN, NULL);
+	if (!batadv_forw_packet_cache)
+		return -ENOMEM;
+
+	return 0;
+}
+
+/**
+ * batadv_forw_packet_cache_destroy() - Destroy forw_packet memory object cache
+ */
+void batadv_forw_packet_cache_destroy(void)
+{
+	kmem_cache_destroy(batadv_forw_packet_cache);
 }
@@ -27,6 +27,8 @@
 #include <uapi/linux/batadv_packet.h>
 
 struct sk_buff;
+struct work_struct;
+struct workqueue_struct;
 
 void batadv_forw_packet_free(struct batadv_forw_packet *forw_packet,
 			     bool dropped);
@@ -37,6 +39,14 @@ batadv_forw_packet_alloc(struct batadv_hard_iface *if_incoming,
 			 struct batadv_priv *bat_priv,
 			 struct sk_buff *skb);
 bool batadv_forw_packet_steal(struct batadv_forw_packet *packet, spinlock_t *l);
+void batadv_forw_sched_init(struct batadv_priv *bat_priv,
+			    struct batadv_forw_sched *sched,
+			    struct workqueue_struct *wq,
+			    enum batadv_counters delay_cnt);
+void batadv_send_delay_add(struct batadv_priv *bat_priv,
+			   enum batadv_counters idx, unsigned long due);
+void batadv_forw_packet_ogmv1_advance(struct batadv_priv *bat_priv,
+				      unsigned long send_time);
 void batadv_forw_packet_ogmv1_queue(struct batadv_priv *bat_priv,
 				    struct batadv_forw_packet *forw_packet,
 				    unsigned long send_time);
@@ -52,8 +62,11 @@ int batadv_send_broadcast_skb(struct sk_buff *skb,
 			      struct batadv_hard_iface *hard_iface);
 int batadv_send_unicast_skb(struct sk_buff *skb,
 			    struct batadv_neigh_node *neigh_node);
+void batadv_send_unicast_agg_work(struct work_struct *work);
+void batadv_send_unicast_agg_init(struct batadv_priv *bat_priv);
+void batadv_send_unicast_agg_free(struct batadv_priv *bat_priv);
 int batadv_add_bcast_packet_to_list(struct batadv_priv *bat_priv,
-				    const struct sk_buff *skb,
+				    struct sk_buff *skb,
 				    unsigned long delay,
 				    bool own_packet);
 void
@@ -72,6 +85,8 @@ int batadv_send_skb_via_tt_generic(struct batadv_priv *bat_priv,
 				   struct sk_buff *skb, int packet_type,
 				   int packet_subtype, u8 *dst_hint,
 				   unsigned short vid);
+int batadv_forw_packet_cache_init(void);
+void batadv_forw_packet_cache_destroy(void);
 int batadv_send_skb_via_gw(struct batadv_priv *bat_priv, struct sk_buff *skb,
 			   unsigned short vid);
 
@@ -0,0 +1,501 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (C) 2018  B.A.T.M.A.N. contributors:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "snapshot.h"
+#include "main.h"
+
+#include <linux/atomic.h>
+#include <linux/compiler.h>
+#include <linux/etherdevice.h>
+#include <linux/jiffies.h>
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/netdevice.h>
+#include <linux/rculist.h>
+#include <linux/rcupdate.h>
+#include <linux/seq_file.h>
+#include <linux/socket.h>
+#include <linux/stddef.h>
+#include <linux/string.h>
+#include <linux/types.h>
+#include <uapi/linux/batman_adv.h>
+
+#include "hash.h"
+#include "originator.h"
+
+/**
+ * batadv_snapshot_age() - Get the time since a timestamp in milliseconds
+ * @timestamp: time in jiffies
+ *
+ * Return: milliseconds passed since @timestamp
+ */
+static u32 batadv_snapshot_age(unsigned long timestamp)
+{
+	return jiffies_to_msecs(jiffies - timestamp);
+}
+
+/**
+ * batadv_snapshot_section_start() - Start a new table in the snapshot
+ * @seq: seq file the snapshot is written to
+ * @type: type of the table (see &enum batadv_snapshot_type)
+ * @entry_len: length of each entry of the table
+ *
+ * Return: offset of the section header, required by
+ *  batadv_snapshot_section_end()
+ */
+static size_t batadv_snapshot_section_start(struct seq_file *seq, u16 type,
+					    u16 entry_len)
+{
+	struct batadv_snapshot_section section = {
+		.type = type,
+		.entry_len = entry_len,
+	};
+	size_t offset = seq->count;
+
+	seq_write(seq, &section, sizeof(section));
+
+	return offset;
+}
+
+/**
+ * batadv_snapshot_section_end() - Finish a table in the snapshot
+ * @seq: seq file the snapshot is written to
+ * @offset: offset returned by batadv_snapshot_section_start()
+ * @num_entries: number of entries written to the table
+ *
+ * The seq_file core calls the writer again with a bigger buffer on overflows.
+ * Nothing has to be fixed up in this case.
+ */
+static void batadv_snapshot_section_end(struct seq_file *seq, size_t offset,
+					u32 num_entries)
+{
+	struct batadv_snapshot_section *section;
+
+	if (seq_has_overflowed(seq))
+		return;
+
+	section = (struct batadv_snapshot_section *)(seq->buf + offset);
+	section->num_entries = num_entries;
+}
+
+/**
+ * batadv_snapshot_origs() - Store the originator table in the snapshot
+ * @seq: seq file the snapshot is written to
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * Has to be called with rcu_read_lock held.
+ */
+static void batadv_snapshot_origs(struct seq_file *seq,
+				  struct batadv_priv *bat_priv)
+{
+	struct batadv_hashtable *hash = bat_priv->orig_hash;
+	struct batadv_snapshot_orig entry;
+	struct batadv_orig_node *orig_node;
+	struct batadv_neigh_node *router;
+	struct hlist_head *head;
+	u32 num_entries = 0;
+	size_t offset;
+	u32 i;
+
+	offset = batadv_snapshot_section_start(seq,
+					       BATADV_SNAPSHOT_ORIGINATORS,
+					       sizeof(entry));
+
+	batadv_hash_walk_begin(hash);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
+		head = batadv_hash_bucket_rcu(hash, i);
+
+		hlist_for_each_entry_rcu(orig_node, head, hash_entry) {
+			memset(&entry, 0, sizeof(entry));
+			ether_addr_copy(entry.orig, orig_node->orig);
+			entry.last_seen_msecs =
+				batadv_snapshot_age(orig_node->last_seen);
+
+			router = batadv_orig_router_get(orig_node,
+							BATADV_IF_DEFAULT);
+			if (router) {
+				ether_addr_copy(entry.router, router->addr);
+				entry.router_ifindex =
+					router->if_incoming->net_dev->ifindex;
+				batadv_neigh_node_put(router);
+			}
+
+			seq_write(seq, &entry, sizeof(entry));
+			num_entries++;
+		}
+	}
+	batadv_hash_walk_end(hash);
+
+	batadv_snapshot_section_end(seq, offset, num_entries);
+}
+
+/**
+ * batadv_snapshot_neighs() - Store the single hop neighbors in the snapshot
+ * @seq: seq file the snapshot is written to
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * Has to be called with rcu_read_lock held.
+ */
+static void batadv_snapshot_neighs(struct seq_file *seq,
+				   struct batadv_priv *bat_priv)
+{
+	struct batadv_hardif_neigh_node *hardif_neigh;
+	struct batadv_hard_iface *hard_iface;
+	struct batadv_snapshot_neigh entry;
+	u32 num_entries = 0;
+	size_t offset;
+
+	offset = batadv_snapshot_section_start(seq, BATADV_SNAPSHOT_NEIGHBORS,
+					       sizeof(entry));
+
+	list_for_each_entry_rcu(hard_iface, &batadv_hardif_list, list) {
+		if (hard_iface->soft_iface != bat_priv->soft_iface)
+			continue;
+
+		hlist_for_each_entry_rcu(hardif_neigh,
+					 &hard_iface->neigh_list, list) {
+			memset(&entry, 0, sizeof(entry));
+			ether_addr_copy(entry.addr, hardif_neigh->addr);
+			entry.ifindex = hard_iface->net_dev->ifindex;
+			entry.last_seen_msecs =
+				batadv_snapshot_age(hardif_neigh->last_seen);
+
+			seq_write(seq, &entry, sizeof(entry));
+			num_entries++;
+		}
+	}
+
+	batadv_snapshot_section_end(seq, offset, num_entries);
+}
+
+/**
+ * batadv_snapshot_tt_local() - Store the local translation table in the
+ *  snapshot
+ * @seq: seq file the snapshot is written to
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * Has to be called with rcu_read_lock held.
+ */
+static void batadv_snapshot_tt_local(struct seq_file *seq,
+				     struct batadv_priv *bat_priv)
+{
+	struct batadv_hashtable *hash = bat_priv->tt.local_hash;
+	struct batadv_tt_local_entry *tt_local;
+	struct batadv_tt_common_entry *common;
+	struct batadv_snapshot_tt_local entry;
+	struct hlist_head *head;
+	u32 num_entries = 0;
+	size_t offset;
+	u32 i;
+
+	offset = batadv_snapshot_section_start(seq,
+					       BATADV_SNAPSHOT_TRANSTABLE_LOCAL,
+					       sizeof(entry));
+
+	batadv_hash_walk_begin(hash);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
+		head = batadv_hash_bucket_rcu(hash, i);
+
+		hlist_for_each_entry_rcu(common, head, hash_entry) {
+			tt_local = container_of(common,
+						struct batadv_tt_local_entry,
+						common);
+
+			memset(&entry, 0, sizeof(entry));
+			ether_addr_copy(entry.addr, common->addr);
+			entry.vid = common->vid;
+			entry.flags = common->flags;
+			entry.last_seen_msecs =
+				batadv_snapshot_age(tt_local->last_seen);
+
+			seq_write(seq, &entry, sizeof(entry));
+			num_entries++;
+		}
+	}
+	batadv_hash_walk_end(hash);
+
+	batadv_snapshot_section_end(seq, offset, num_entries);
+}
+
+/**
+ * batadv_snapshot_tt_global() - Store the global translation table in the
+ *  snapshot
+ * @seq: seq file the snapshot is written to
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * Has to be called with rcu_read_lock held.
+ */
+static void batadv_snapshot_tt_global(struct seq_file *seq,
+				      struct batadv_priv *bat_priv)
+{
+	struct batadv_hashtable *hash = bat_priv->tt.global_hash;
+	struct batadv_tt_orig_list_entry *orig_entry;
+	struct batadv_tt_global_entry *tt_global;
+	struct batadv_snapshot_tt_global entry;
+	struct batadv_tt_common_entry *common;
+	struct hlist_head *head;
+	u32 num_entries = 0;
+	size_t offset;
+	u32 i;
+
+	offset = batadv_snapshot_section_start(seq,
+					BATADV_SNAPSHOT_TRANSTABLE_GLOBAL,
+					       sizeof(entry));
+
+	batadv_hash_walk_begin(hash);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
+		head = batadv_hash_bucket_rcu(hash, i);
+
+		hlist_for_each_entry_rcu(common, head, hash_entry) {
+			tt_global = container_of(common,
+						 struct batadv_tt_global_entry,
+						 common);
+
+			hlist_for_each_entry_rcu(orig_entry,
+						 &tt_global->orig_list, list) {
+				memset(&entry, 0, sizeof(entry));
+				ether_addr_copy(entry.addr, common->addr);
+				entry.vid = common->vid;
+				ether_addr_copy(entry.orig,
+						orig_entry->orig_node->orig);
+				entry.ttvn = orig_entry->ttvn;
+				entry.flags = common->flags | orig_entry->flags;
+
+				seq_write(seq, &entry, sizeof(entry));
+				num_entries++;
+			}
+		}
+	}
+	batadv_hash_walk_end(hash);
+
+	batadv_snapshot_section_end(seq, offset, num_entries);
+}
+
+#ifdef CONFIG_BATMAN_ADV_BLA
+/**
+ * batadv_snapshot_bla_claims() - Store the bridge loop avoidance claims in
+ *  the snapshot
+ * @seq: seq file the snapshot is written to
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * Has to be called with rcu_read_lock held.
+ */
+static void batadv_snapshot_bla_claims(struct seq_file *seq,
+				       struct batadv_priv *bat_priv)
+{
+	struct batadv_hashtable *hash = bat_priv->bla.claim_hash;
+	struct batadv_bla_backbone_gw *backbone_gw;
+	struct batadv_snapshot_bla_claim entry;
+	struct batadv_bla_claim *claim;
+	struct hlist_head *head;
+	u32 num_entries = 0;
+	size_t offset;
+	u32 i;
+
+	offset = batadv_snapshot_section_start(seq, BATADV_SNAPSHOT_BLA_CLAIMS,
+					       sizeof(entry));
+
+	batadv_hash_walk_begin(hash);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
+		head = batadv_hash_bucket_rcu(hash, i);
+
+		hlist_for_each_entry_rcu(claim, head, hash_entry) {
+			/* backbone gateways are freed after a grace period */
+			backbone_gw = READ_ONCE(claim->backbone_gw);
+
+			memset(&entry, 0, sizeof(entry));
+			ether_addr_copy(entry.addr, claim->addr);
+			entry.vid = claim->vid;
+			ether_addr_copy(entry.backbone, backbone_gw->orig);
+
+			seq_write(seq, &entry, sizeof(entry));
+			num_entries++;
+		}
+	}
+	batadv_hash_walk_end(hash);
+
+	batadv_snapshot_section_end(seq, offset, num_entries);
+}
+#endif
+
+#ifdef CONFIG_BATMAN_ADV_DAT
+/**
+ * batadv_snapshot_dat_cache() - Store the DAT cache in the snapshot
+ * @seq: seq file the snapshot is written to
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * Has to be called with rcu_read_lock held.
+ */
+static void batadv_snapshot_dat_cache(struct seq_file *seq,
+				      struct batadv_priv *bat_priv)
+{
+	struct batadv_hashtable *hash = bat_priv->dat.hash;
+	struct batadv_snapshot_dat entry;
+	struct batadv_dat_entry *dat_entry;
+	struct hlist_head *head;
+	u32 num_entries = 0;
+	size_t offset;
+	u32 i;
+
+	offset = batadv_snapshot_section_start(seq, BATADV_SNAPSHOT_DAT_CACHE,
+					       sizeof(entry));
+
+	batadv_hash_walk_begin(hash);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
+		head = batadv_hash_bucket_rcu(hash, i);
+
+		hlist_for_each_entry_rcu(dat_entry, head, hash_entry) {
+			/* the snapshot format only knows IPv4 entries */
+			if (dat_entry->family != AF_INET)
+				continue;
+
+			memset(&entry, 0, sizeof(entry));
+			entry.ip = dat_entry->ip;
+			ether_addr_copy(entry.mac, dat_entry->mac_addr);
+			entry.vid = dat_entry->vid;
+			entry.last_seen_msecs =
+				batadv_snapshot_age(dat_entry->last_update);
+
+			seq_write(seq, &entry, sizeof(entry));
+			num_entries++;
+		}
+	}
+	batadv_hash_walk_end(hash);
+
+	batadv_snapshot_section_end(seq, offset, num_entries);
+}
+#endif
+
+/**
+ * batadv_snapshot_gws() - Store the gateway list in the snapshot
+ * @seq: seq file the snapshot is written to
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * Has to be called with rcu_read_lock held.
+ */
+static void batadv_snapshot_gws(struct seq_file *seq,
+				struct batadv_priv *bat_priv)
+{
+	struct batadv_snapshot_gw entry;
+	struct batadv_gw_node *gw_node;
+	u32 num_entries = 0;
+	size_t offset;
+
+	offset = batadv_snapshot_section_start(seq, BATADV_SNAPSHOT_GATEWAYS,
+					       sizeof(entry));
+
+	hlist_for_each_entry_rcu(gw_node, &bat_priv->gw.gateway_list, list) {
+		memset(&entry, 0, sizeof(entry));
+		ether_addr_copy(entry.orig, gw_node->orig_node->orig);
+		entry.bandwidth_down = gw_node->bandwidth_down;
+		entry.bandwidth_up = gw_node->bandwidth_up;
+
+		seq_write(seq, &entry, sizeof(entry));
+		num_entries++;
+	}
+
+	batadv_snapshot_section_end(seq, offset, num_entries);
+}
+
+/**
+ * batadv_snapshot_seq_print() - Write a binary snapshot of the mesh state
+ * @seq: seq file the snapshot is written to
+ * @offset: not used
+ *
+ * All tables are walked in a single RCU read-side critical section without
+ * taking any of their locks. The format is described by
+ * &struct batadv_snapshot_hdr.
+ *
+ * Return: always 0
+ */
+int batadv_snapshot_seq_print(struct seq_file *seq, void *offset)
+{
+	struct net_device *net_dev = (struct net_device *)seq->private;
+	struct batadv_priv *bat_priv = netdev_priv(net_dev);
+	struct batadv_snapshot_hdr *hdr_pos;
+	struct batadv_snapshot_hdr hdr = {
+		.magic = BATADV_SNAPSHOT_MAGIC,
+		.version = BATADV_SNAPSHOT_VERSION,
+		.time_msecs = jiffies_to_msecs(jiffies - INITIAL_JIFFIES),
+	};
+	u16 num_sections = 0;
+
+	seq_write(seq, &hdr, sizeof(hdr));
+
+	rcu_read_lock();
+	batadv_snapshot_origs(seq, bat_priv);
+	num_sections++;
+	batadv_snapshot_neighs(seq, bat_priv);
+	num_sections++;
+	batadv_snapshot_tt_local(seq, bat_priv);
+	num_sections++;
+	batadv_snapshot_tt_global(seq, bat_priv);
+	num_sections++;
+#ifdef CONFIG_BATMAN_ADV_BLA
+	batadv_snapshot_bla_claims(seq, bat_priv);
+	num_sections++;
+#endif
+#ifdef CONFIG_BATMAN_ADV_DAT
+	batadv_snapshot_dat_cache(seq, bat_priv);
+	num_sections++;
+#endif
+	batadv_snapshot_gws(seq, bat_priv);
+	num_sections++;
+	rcu_read_unlock();
+
+	if (seq_has_overflowed(seq))
+		return 0;
+
+	hdr_pos = (struct batadv_snapshot_hdr *)seq->buf;
+	hdr_pos->num_sections = num_sections;
+
+	return 0;
+}
+
+/**
+ * batadv_snapshot_size() - Estimate the size of a snapshot
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * Used as initial buffer size to avoid that the tables have to be walked
+ * several times until the seq_file buffer is big enough.
+ *
+ * Return: expected size of the snapshot in bytes
+ */
+size_t batadv_snapshot_size(struct batadv_priv *bat_priv)
+{
+	size_t size = sizeof(struct batadv_snapshot_hdr);
+
+	size += 7 * sizeof(struct batadv_snapshot_section);
+
+	size += atomic_read(&bat_priv->orig_hash->count) *
+		(sizeof(struct batadv_snapshot_orig) +
+		 sizeof(struct batadv_snapshot_neigh));
+	size += atomic_read(&bat_priv->tt.local_hash->count) *
+		sizeof(struct batadv_snapshot_tt_local);
+	size += atomic_read(&bat_priv->tt.global_hash->count) *
+		sizeof(struct batadv_snapshot_tt_global);
+#ifdef CONFIG_BATMAN_ADV_BLA
+	size += atomic_read(&bat_priv->bla.claim_hash->count) *
+		sizeof(struct batadv_snapshot_bla_claim);
+#endif
+#ifdef CONFIG_BATMAN_ADV_DAT
+	size += atomic_read(&bat_priv->dat.hash->count) *
+		sizeof(struct batadv_snapshot_dat);
+#endif
+
+	/* leave room for entries added while the tables are walked */
+	return size + size / 4;
+}
@@ -0,0 +1,29 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright (C) 2018  B.A.T.M.A.N. contributors:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _NET_BATMAN_ADV_SNAPSHOT_H_
+#define _NET_BATMAN_ADV_SNAPSHOT_H_
+
+#include "main.h"
+
+#include <linux/types.h>
+
+struct seq_file;
+
+int batadv_snapshot_seq_print(struct seq_file *seq, void *offset);
+size_t batadv_snapshot_size(struct batadv_priv *bat_priv);
+
+#endif /* _NET_BATMAN_ADV_SNAPSHOT_H_ */
@@ -20,22 +20,30 @@
 #include "main.h"
 
 #include <linux/atomic.h>
+#include <linux/bug.h>
 #include <linux/byteorder/generic.h>
 #include <linux/cache.h>
 #include <linux/compiler.h>
 #include <linux/cpumask.h>
+#include <linux/err.h>
 #include <linux/errno.h>
 #include <linux/etherdevice.h>
 #include <linux/ethtool.h>
 #include <linux/gfp.h>
+#include <linux/hashtable.h>
 #include <linux/if_ether.h>
 #include <linux/if_vlan.h>
+#include <linux/in.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <linux/jhash.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
 #include <linux/kref.h>
 #include <linux/list.h>
 #include <linux/lockdep.h>
 #include <linux/netdevice.h>
+#include <linux/netlink.h>
 #include <linux/percpu.h>
 #include <linux/printk.h>
 #include <linux/random.h>
@@ -49,7 +57,13 @@
 #include <linux/stddef.h>
 #include <linux/string.h>
 #include <linux/types.h>
+#include <linux/udp.h>
+#include <net/genetlink.h>
+#include <net/ip.h>
+#include <net/netlink.h>
+#include <net/sock.h>
 #include <uapi/linux/batadv_packet.h>
+#include <uapi/linux/batman_adv.h>
 
 #include "bat_algo.h"
 #include "bridge_loop_avoidance.h"
@@ -58,22 +72,32 @@
 #include "gateway_client.h"
 #include "gateway_common.h"
 #include "hard-interface.h"
+#include "hash.h"
 #include "multicast.h"
+#include "netlink.h"
 #include "network-coding.h"
 #include "originator.h"
 #include "send.h"
 #include "sysfs.h"
+#include "trace.h"
 #include "translation-table.h"
 
+static netdev_tx_t batadv_interface_tx(struct sk_buff *skb,
+				       struct net_device *soft_iface);
+
 /**
  * batadv_skb_head_push() - Increase header size and move (push) head pointer
+ * @bat_priv: the bat priv with all the soft interface information
  * @skb: packet buffer which should be modified
  * @len: number of bytes to add
+ * @idx: counter increased when the packet had to be reallocated
  *
  * Return: 0 on success or negative error number in case of failure
  */
-int batadv_skb_head_push(struct sk_buff *skb, unsigned int len)
+int batadv_skb_head_push(struct batadv_priv *bat_priv, struct sk_buff *skb,
+			 unsigned int len, enum batadv_counters idx)
 {
+	unsigned char *head = skb->head;
 	int result;
 
 	/* TODO: We must check if we can release all references to non-payload
@@ -87,6 +111,9 @@ int batadv_skb_head_push(struct sk_buff *skb, unsigned int len)
 	if (result < 0)
 		return result;
 
+	if (skb->head != head)
+		batadv_inc_counter(bat_priv, idx);
+
 	skb_push(skb, len);
 	return 0;
 }
@@ -176,20 +203,172 @@ static int batadv_interface_change_mtu(struct net_device *dev, int new_mtu)
 	return 0;
 }
 
+/**
+ * batadv_interface_tx_segment() - transmit the segments of a GSO frame
+ * @skb: GSO frame to split
+ * @soft_iface: soft interface the frame was sent on
+ *
+ * Return: NETDEV_TX_OK, the skb is always consumed
+ */
+static netdev_tx_t batadv_interface_tx_segment(struct sk_buff *skb,
+					       struct net_device *soft_iface)
+{
+	struct batadv_priv *bat_priv = netdev_priv(soft_iface);
+	struct sk_buff *segs, *next;
+
+	segs = skb_gso_segment(skb, 0);
+	if (IS_ERR_OR_NULL(segs)) {
+		batadv_inc_counter(bat_priv, BATADV_CNT_TX_DROPPED);
+		kfree_skb(skb);
+		return NETDEV_TX_OK;
+	}
+
+	consume_skb(skb);
+
+	for (; segs; segs = next) {
+		next = segs->next;
+		segs->next = NULL;
+
+		batadv_interface_tx(segs, soft_iface);
+	}
+
+	return NETDEV_TX_OK;
+}
+
 /**
  * batadv_interface_set_rx_mode() - set the rx mode of a device
  * @dev: registered network device to modify
  *
  * We do not actually need to set any rx filters for the virtual batman
- * soft interface. However a dummy handler enables a user to set static
- * multicast listeners for instance.
+ * soft interface. However the handler enables a user to set static
+ * multicast listeners for instance, which are announced right away.
  */
 static void batadv_interface_set_rx_mode(struct net_device *dev)
 {
+	batadv_mcast_mla_trigger(netdev_priv(dev));
 }
 
-static netdev_tx_t batadv_interface_tx(struct sk_buff *skb,
-				       struct net_device *soft_iface)
+/**
+ * batadv_bcast_class_get() - get the suppression class of a client broadcast
+ * @skb: the broadcast frame, with the network header set
+ *
+ * Return: the &enum batadv_bcast_class of the frame or BATADV_BCAST_CLASS_NUM
+ * if it doesn't belong to any class.
+ */
+static int batadv_bcast_class_get(struct sk_buff *skb)
+{
+	int offset = skb_network_offset(skb);
+	struct udphdr udph_tmp, *udph;
+	struct ipv6hdr ip6h_tmp, *ip6h;
+	struct iphdr iph_tmp, *iph;
+	struct batadv_skb_cb *cb;
+	__be16 proto;
+	u8 l4proto;
+
+	cb = batadv_skb_cb_classified(skb, 0);
+	if (cb) {
+		proto = cb->l3_proto;
+	} else {
+		proto = eth_hdr(skb)->h_proto;
+		if (proto == htons(ETH_P_8021Q))
+			proto = vlan_eth_hdr(skb)->h_vlan_encapsulated_proto;
+	}
+
+	switch (ntohs(proto)) {
+	case ETH_P_ARP:
+		return BATADV_BCAST_CLASS_ARP;
+	case ETH_P_IP:
+		iph = skb_header_pointer(skb, offset, sizeof(iph_tmp),
+					 &iph_tmp);
+		if (!iph || iph->ihl < 5 || ip_is_fragment(iph))
+			return BATADV_BCAST_CLASS_NUM;
+
+		l4proto = iph->protocol;
+		offset += iph->ihl * 4;
+		break;
+	case ETH_P_IPV6:
+		ip6h = skb_header_pointer(skb, offset, sizeof(ip6h_tmp),
+					  &ip6h_tmp);
+		if (!ip6h)
+			return BATADV_BCAST_CLASS_NUM;
+
+		l4proto = ip6h->nexthdr;
+		offset += sizeof(*ip6h);
+		break;
+	default:
+		return BATADV_BCAST_CLASS_NUM;
+	}
+
+	if (l4proto != IPPROTO_UDP)
+		return BATADV_BCAST_CLASS_NUM;
+
+	udph = skb_header_pointer(skb, offset, sizeof(udph_tmp), &udph_tmp);
+	if (!udph)
+		return BATADV_BCAST_CLASS_NUM;
+
+	switch (ntohs(udph->dest)) {
+	case 67: /* DHCP server */
+	case 547: /* DHCPv6 servers and relay agents */
+		return BATADV_BCAST_CLASS_DHCP;
+	case 5353:
+		return BATADV_BCAST_CLASS_MDNS;
+	}
+
+	return BATADV_BCAST_CLASS_NUM;
+}
+
+/**
+ * batadv_bcast_suppress() - check whether a client broadcast repeats one which
+ *  was flooded shortly before
+ * @bat_priv: the bat priv with all the soft interface information
+ * @skb: the broadcast frame, with the network header set
+ *
+ * Frames are compared by a hash over their whole content, only identical
+ * repetitions of a class with a non-zero suppression window are dropped. A
+ * suppressed repetition doesn't extend the window: a client repeating a
+ * broadcast faster than the window still gets one copy per window flooded.
+ *
+ * Return: true if the frame must not be flooded, false otherwise.
+ */
+static bool batadv_bcast_suppress(struct batadv_priv *bat_priv,
+				  struct sk_buff *skb)
+{
+	struct batadv_priv_bcast_suppress *suppress = &bat_priv->bcast_suppress;
+	struct batadv_bcast_suppress_slot *slot;
+	unsigned long now = jiffies;
+	bool suppressed = false;
+	int bcast_class;
+	u32 window;
+	u32 hash;
+
+	bcast_class = batadv_bcast_class_get(skb);
+	if (bcast_class == BATADV_BCAST_CLASS_NUM)
+		return false;
+
+	window = atomic_read(&suppress->window[bcast_class]);
+	if (window == 0)
+		return false;
+
+	if (skb_linearize(skb) < 0)
+		return false;
+
+	hash = jhash(skb->data, skb->len, bcast_class);
+	slot = &suppress->slots[hash & (BATADV_BCAST_SUPPRESS_SLOTS - 1)];
+
+	spin_lock_bh(&suppress->lock);
+	if (slot->hash == hash && time_before(now, slot->expires)) {
+		suppressed = true;
+	} else {
+		slot->hash = hash;
+		slot->expires = now + msecs_to_jiffies(window);
+	}
+	spin_unlock_bh(&suppress->lock);
+
+	return suppressed;
+}
+
+static netdev_tx_t __batadv_interface_tx(struct sk_buff *skb,
+					 struct net_device *soft_iface)
 {
 	struct ethhdr *ethhdr;
 	struct batadv_priv *bat_priv = netdev_priv(soft_iface);
@@ -201,7 +380,7 @@ static netdev_tx_t batadv_interface_tx(struct sk_buff *skb,
 					       0x00, 0x00};
 	enum batadv_dhcp_recipient dhcp_rcp = BATADV_DHCP_NO;
 	u8 *dst_hint = NULL, chaddr[ETH_ALEN];
-	struct vlan_ethhdr *vhdr;
+	struct batadv_skb_cb *cb;
 	unsigned int header_len = 0;
 	int data_len = skb->len, ret;
 	unsigned long brd_delay = 1;
@@ -209,9 +388,8 @@ static netdev_tx_t batadv_interface_tx(struct sk_buff *skb,
 	unsigned short vid;
 	u32 seqno;
 	int gw_mode;
-	enum batadv_forw_mode forw_mode;
+	enum batadv_forw_mode forw_mode = BATADV_FORW_NONE;
 	struct batadv_orig_node *mcast_single_orig = NULL;
-	int network_offset = ETH_HLEN;
 
 	if (atomic_read(&bat_priv->mesh_state) != BATADV_MESH_ACTIVE)
 		goto dropped;
@@ -220,25 +398,27 @@ static netdev_tx_t batadv_interface_tx(struct sk_buff *skb,
 	memset(skb->cb, 0, sizeof(struct batadv_skb_cb));
 
 	netif_trans_update(soft_iface);
-	vid = batadv_get_vid(skb, 0);
-	ethhdr = eth_hdr(skb);
-
-	switch (ntohs(ethhdr->h_proto)) {
-	case ETH_P_8021Q:
-		vhdr = vlan_eth_hdr(skb);
 
-		/* drop batman-in-batman packets to prevent loops */
-		if (vhdr->h_vlan_encapsulated_proto != htons(ETH_P_BATMAN)) {
-			network_offset += VLAN_HLEN;
-			break;
-		}
+	/* parse the client frame once for all the features below */
+	batadv_skb_classify(skb);
+	cb = batadv_skb_cb_classified(skb, 0);
+	if (!cb)
+		goto dropped;
 
-		/* fall through */
-	case ETH_P_BATMAN:
+	/* drop batman-in-batman packets to prevent loops */
+	if (cb->l3_proto == htons(ETH_P_BATMAN))
 		goto dropped;
-	}
 
-	skb_set_network_header(skb, network_offset);
+	vid = cb->vid;
+	ethhdr = eth_hdr(skb);
+	skb_set_network_header(skb, cb->network_offset);
+
+	/* broadcasts and multicasts carry a per packet sequence number or are
+	 * replicated to several originators. Only unicast frames are
+	 * encapsulated as a whole and segmented just before transmission
+	 */
+	if (skb_is_gso(skb) && is_multicast_ether_addr(ethhdr->h_dest))
+		return batadv_interface_tx_segment(skb, soft_iface);
 
 	if (batadv_bla_tx(bat_priv, skb, vid))
 		goto dropped;
@@ -306,27 +486,42 @@ send:
 			if (forw_mode == BATADV_FORW_NONE)
 				goto dropped;
 
-			if (forw_mode == BATADV_FORW_SINGLE)
+			if (forw_mode == BATADV_FORW_SINGLE ||
+			    forw_mode == BATADV_FORW_SOME)
 				do_bcast = false;
 		}
 	}
 
 	batadv_skb_set_priority(skb, 0);
 
+	/* calculate the flow hash on the client frame: the encapsulated frame
+	 * can't be dissected anymore when the transmit queue is selected
+	 */
+	skb_get_hash(skb);
+
 	/* ethernet packet should be broadcasted */
 	if (do_bcast) {
 		primary_if = batadv_primary_if_get_selected(bat_priv);
 		if (!primary_if)
 			goto dropped;
 
-		/* in case of ARP request, we do not immediately broadcasti the
-		 * packet, instead we first wait for DAT to try to retrieve the
-		 * correct ARP entry
+		if (batadv_bcast_suppress(bat_priv, skb)) {
+			batadv_inc_counter(bat_priv,
+					   BATADV_CNT_TX_BCAST_SUPPRESSED);
+			consume_skb(skb);
+			goto end;
+		}
+
+		/* in case of ARP request or neighbor solicitation, we do not
+		 * immediately broadcasti the packet, instead we first wait for
+		 * DAT to try to retrieve the correct ARP/ND entry
 		 */
-		if (batadv_dat_snoop_outgoing_arp_request(bat_priv, skb))
+		if (batadv_dat_snoop_outgoing_arp_request(bat_priv, skb) ||
+		    batadv_dat_snoop_outgoing_nd_request(bat_priv, skb))
 			brd_delay = msecs_to_jiffies(ARP_REQ_DELAY);
 
-		if (batadv_skb_head_push(skb, sizeof(*bcast_packet)) < 0)
+		if (batadv_skb_head_push(bat_priv, skb, sizeof(*bcast_packet),
+					 BATADV_CNT_HEADROOM_ENCAP) < 0)
 			goto dropped;
 
 		bcast_packet = (struct batadv_bcast_packet *)skb->data;
@@ -349,7 +544,7 @@ send:
 
 		batadv_add_bcast_packet_to_list(bat_priv, skb, brd_delay, true);
 
-		/* a copy is stored in the bcast list, therefore removing
+		/* a reference is stored in the bcast list, therefore removing
 		 * the original skb.
 		 */
 		consume_skb(skb);
@@ -366,12 +561,15 @@ send:
 			ret = batadv_send_skb_unicast(bat_priv, skb,
 						      BATADV_UNICAST, 0,
 						      mcast_single_orig, vid);
+		} else if (forw_mode == BATADV_FORW_SOME) {
+			ret = batadv_mcast_forw_send(bat_priv, skb, vid);
 		} else {
 			if (batadv_dat_snoop_outgoing_arp_request(bat_priv,
 								  skb))
 				goto dropped;
 
 			batadv_dat_snoop_outgoing_arp_reply(bat_priv, skb);
+			batadv_dat_snoop_outgoing_nd_reply(bat_priv, skb);
 
 			ret = batadv_send_skb_via_tt(bat_priv, skb, dst_hint,
 						     vid);
@@ -396,6 +594,30 @@ end:
 	return NETDEV_TX_OK;
 }
 
+/**
+ * batadv_interface_tx() - transmit a frame of the soft interface into the mesh
+ * @skb: the frame to transmit
+ * @soft_iface: the soft interface the frame was sent on
+ *
+ * Return: NETDEV_TX_OK in any case, the skb is always consumed
+ */
+static netdev_tx_t batadv_interface_tx(struct sk_buff *skb,
+				       struct net_device *soft_iface)
+{
+	unsigned int len = skb->len;
+	netdev_tx_t ret;
+	u64 start = 0;
+
+	if (trace_batadv_interface_tx_enabled())
+		start = batadv_trace_clock();
+
+	ret = __batadv_interface_tx(skb, soft_iface);
+
+	trace_batadv_interface_tx(soft_iface, len, start);
+
+	return ret;
+}
+
 /**
  * batadv_interface_rx() - receive ethernet frame on local batman-adv interface
  * @soft_iface: local interface which will receive the ethernet frame
@@ -419,7 +641,7 @@ void batadv_interface_rx(struct net_device *soft_iface,
 {
 	struct batadv_bcast_packet *batadv_bcast_packet;
 	struct batadv_priv *bat_priv = netdev_priv(soft_iface);
-	struct vlan_ethhdr *vhdr;
+	struct batadv_skb_cb *cb;
 	struct ethhdr *ethhdr;
 	unsigned short vid;
 	bool is_bcast;
@@ -435,27 +657,17 @@ void batadv_interface_rx(struct net_device *soft_iface,
 	 */
 	nf_reset(skb);
 
-	if (unlikely(!pskb_may_pull(skb, ETH_HLEN)))
+	batadv_skb_classify(skb);
+	cb = batadv_skb_cb_classified(skb, 0);
+	if (unlikely(!cb))
 		goto dropped;
 
-	vid = batadv_get_vid(skb, 0);
-	ethhdr = eth_hdr(skb);
-
-	switch (ntohs(ethhdr->h_proto)) {
-	case ETH_P_8021Q:
-		if (!pskb_may_pull(skb, VLAN_ETH_HLEN))
-			goto dropped;
-
-		vhdr = (struct vlan_ethhdr *)skb->data;
-
-		/* drop batman-in-batman packets to prevent loops */
-		if (vhdr->h_vlan_encapsulated_proto != htons(ETH_P_BATMAN))
-			break;
-
-		/* fall through */
-	case ETH_P_BATMAN:
+	/* drop batman-in-batman packets to prevent loops */
+	if (cb->l3_proto == htons(ETH_P_BATMAN))
 		goto dropped;
-	}
+
+	vid = cb->vid;
+	ethhdr = eth_hdr(skb);
 
 	/* skb->dev & skb->pkt_type are set here */
 	skb->protocol = eth_type_trans(skb, soft_iface);
@@ -515,6 +727,7 @@ static void batadv_softif_vlan_release(struct kref *ref)
 
 	spin_lock_bh(&vlan->bat_priv->softif_vlan_list_lock);
 	hlist_del_rcu(&vlan->list);
+	hash_del_rcu(&vlan->hash_entry);
 	spin_unlock_bh(&vlan->bat_priv->softif_vlan_list_lock);
 
 	kfree_rcu(vlan, rcu);
@@ -547,7 +760,8 @@ struct batadv_softif_vlan *batadv_softif_vlan_get(struct batadv_priv *bat_priv,
 	struct batadv_softif_vlan *vlan_tmp, *vlan = NULL;
 
 	rcu_read_lock();
-	hlist_for_each_entry_rcu(vlan_tmp, &bat_priv->softif_vlan_list, list) {
+	hash_for_each_possible_rcu(bat_priv->softif_vlan_hash, vlan_tmp,
+				   hash_entry, vid) {
 		if (vlan_tmp->vid != vid)
 			continue;
 
@@ -587,6 +801,7 @@ int batadv_softif_create_vlan(struct batadv_priv *bat_priv, unsigned short vid)
 	vlan->bat_priv = bat_priv;
 	vlan->vid = vid;
 	kref_init(&vlan->refcount);
+	spin_lock_init(&vlan->tt.crc_lock);
 
 	atomic_set(&vlan->ap_isolation, 0);
 
@@ -599,6 +814,7 @@ int batadv_softif_create_vlan(struct batadv_priv *bat_priv, unsigned short vid)
 	spin_lock_bh(&bat_priv->softif_vlan_list_lock);
 	kref_get(&vlan->refcount);
 	hlist_add_head_rcu(&vlan->list, &bat_priv->softif_vlan_list);
+	hash_add_rcu(bat_priv->softif_vlan_hash, &vlan->hash_entry, vid);
 	spin_unlock_bh(&bat_priv->softif_vlan_list_lock);
 
 	/* add a new TT local entry. This one will be marked with the NOPURGE
@@ -766,7 +982,7 @@ static int batadv_softif_init_late(struct net_device *dev)
 {
 	struct batadv_priv *bat_priv;
 	u32 random_seqno;
-	int ret;
+	int ret, i;
 	size_t cnt_len = sizeof(u64) * BATADV_CNT_NUM;
 
 	batadv_set_lockdep_class(dev);
@@ -782,12 +998,19 @@ static int batadv_softif_init_late(struct net_device *dev)
 		return -ENOMEM;
 
 	atomic_set(&bat_priv->aggregated_ogms, 1);
+	atomic_set(&bat_priv->unicast_agg_delay, 0);
 	atomic_set(&bat_priv->bonding, 0);
+	atomic_set(&bat_priv->rx_steering, 0);
+	atomic_set(&bat_priv->passive_capacity, 0);
+	spin_lock_init(&bat_priv->bcast_suppress.lock);
+	for (i = 0; i < BATADV_BCAST_CLASS_NUM; i++)
+		atomic_set(&bat_priv->bcast_suppress.window[i], 0);
 #ifdef CONFIG_BATMAN_ADV_BLA
 	atomic_set(&bat_priv->bridge_loop_avoidance, 1);
 #endif
 #ifdef CONFIG_BATMAN_ADV_DAT
 	atomic_set(&bat_priv->distributed_arp_table, 1);
+	atomic_set(&bat_priv->dat.max_entries, 8192);
 #endif
 #ifdef CONFIG_BATMAN_ADV_MCAST
 	bat_priv->mcast.querier_ipv4.exists = false;
@@ -796,14 +1019,21 @@ static int batadv_softif_init_late(struct net_device *dev)
 	bat_priv->mcast.querier_ipv6.shadowing = false;
 	bat_priv->mcast.flags = BATADV_NO_FLAGS;
 	atomic_set(&bat_priv->multicast_mode, 1);
+	atomic_set(&bat_priv->multicast_fanout, 16);
 	atomic_set(&bat_priv->mcast.num_want_all_unsnoopables, 0);
 	atomic_set(&bat_priv->mcast.num_want_all_ipv4, 0);
 	atomic_set(&bat_priv->mcast.num_want_all_ipv6, 0);
 #endif
 	atomic_set(&bat_priv->gw.mode, BATADV_GW_MODE_OFF);
+	atomic_set(&bat_priv->gw.balance, 0);
 	atomic_set(&bat_priv->gw.bandwidth_down, 100);
 	atomic_set(&bat_priv->gw.bandwidth_up, 20);
 	atomic_set(&bat_priv->orig_interval, 1000);
+	atomic_set(&bat_priv->orig_interval_max, 0);
+	atomic_set(&bat_priv->orig_max_entries, 0);
+	atomic_set(&bat_priv->tt.global_max_entries, 0);
+	atomic_set(&bat_priv->topology_gen, 0);
+	atomic_set(&bat_priv->fisheye_hops, 0);
 	atomic_set(&bat_priv->hop_penalty, 30);
 #ifdef CONFIG_BATMAN_ADV_DEBUG
 	atomic_set(&bat_priv->log_level, 0);
@@ -818,6 +1048,7 @@ static int batadv_softif_init_late(struct net_device *dev)
 	atomic_set(&bat_priv->tt.vn, 0);
 	atomic_set(&bat_priv->tt.local_changes, 0);
 	atomic_set(&bat_priv->tt.ogm_append_cnt, 0);
+	atomic_set(&bat_priv->tt.global_gen, 0);
 #ifdef CONFIG_BATMAN_ADV_BLA
 	atomic_set(&bat_priv->bla.num_requests, 0);
 #endif
@@ -831,6 +1062,7 @@ static int batadv_softif_init_late(struct net_device *dev)
 	/* randomize initial seqno to avoid collision */
 	get_random_bytes(&random_seqno, sizeof(random_seqno));
 	atomic_set(&bat_priv->frag_seqno, random_seqno);
+	atomic_set(&bat_priv->frag_mem, 0);
 
 	bat_priv->primary_if = NULL;
 	bat_priv->num_ifaces = 0;
@@ -950,6 +1182,7 @@ static const struct {
 	{ "tx" },
 	{ "tx_bytes" },
 	{ "tx_dropped" },
+	{ "tx_bcast_suppressed" },
 	{ "rx" },
 	{ "rx_bytes" },
 	{ "forward" },
@@ -958,24 +1191,55 @@ static const struct {
 	{ "mgmt_tx_bytes" },
 	{ "mgmt_rx" },
 	{ "mgmt_rx_bytes" },
+	{ "rx_drop_version" },
+	{ "rx_drop_unknown" },
+	{ "rx_drop_ogm" },
+	{ "rx_drop_ogm2" },
+	{ "rx_drop_elp" },
+	{ "rx_drop_bcast" },
+	{ "rx_drop_coded" },
+	{ "rx_drop_icmp" },
+	{ "rx_drop_unicast" },
+	{ "rx_drop_unicast_frag" },
+	{ "rx_drop_unicast_4addr" },
+	{ "rx_drop_unicast_tvlv" },
+	{ "rx_drop_unicast_agg" },
 	{ "frag_tx" },
 	{ "frag_tx_bytes" },
 	{ "frag_rx" },
 	{ "frag_rx_bytes" },
 	{ "frag_fwd" },
 	{ "frag_fwd_bytes" },
+	{ "frag_evict" },
+	{ "frag_mem_drop" },
+	{ "agg_tx" },
+	{ "agg_tx_packets" },
+	{ "headroom_encap" },
+	{ "headroom_fwd" },
+	{ "headroom_ll" },
+	{ "ctrl_tx" },
+	{ "ctrl_delay_us" },
+	{ "bcast_delay_us" },
 	{ "tt_request_tx" },
 	{ "tt_request_rx" },
 	{ "tt_response_tx" },
 	{ "tt_response_rx" },
 	{ "tt_roam_adv_tx" },
 	{ "tt_roam_adv_rx" },
+	{ "tt_global_limit_drop" },
+	{ "orig_limit_drop" },
+#ifdef CONFIG_BATMAN_ADV_BLA
+	{ "bla_drop" },
+#endif
 #ifdef CONFIG_BATMAN_ADV_DAT
 	{ "dat_get_tx" },
 	{ "dat_get_rx" },
 	{ "dat_put_tx" },
 	{ "dat_put_rx" },
 	{ "dat_cached_reply_tx" },
+	{ "dat_cache_hit" },
+	{ "dat_cache_miss" },
+	{ "dat_cache_evict" },
 #endif
 #ifdef CONFIG_BATMAN_ADV_NC
 	{ "nc_code" },
@@ -1015,6 +1279,312 @@ static int batadv_get_sset_count(struct net_device *dev, int stringset)
 	return -EOPNOTSUPP;
 }
 
+static const char * const batadv_hardif_counters_strings[] = {
+	"tx",
+	"tx_bytes",
+	"rx",
+	"rx_bytes",
+};
+
+/**
+ * batadv_hardif_sum_counter() - Sum the cpu-local counters of a hard interface
+ *  for index 'idx'
+ * @hard_iface: the hard interface to sum the counters of
+ * @idx: index of counter to sum up
+ *
+ * Return: sum of all cpu-local counters
+ */
+static u64 batadv_hardif_sum_counter(struct batadv_hard_iface *hard_iface,
+				     size_t idx)
+{
+	u64 *counters, sum = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		counters = per_cpu_ptr(hard_iface->counters, cpu);
+		sum += counters[idx];
+	}
+
+	return sum;
+}
+
+/**
+ * enum batadv_mem_table - tables of a mesh whose memory usage is reported
+ */
+enum batadv_mem_table {
+	/** @BATADV_MEM_ORIG: originators */
+	BATADV_MEM_ORIG,
+
+	/** @BATADV_MEM_NEIGH: neighbors of the hard interfaces */
+	BATADV_MEM_NEIGH,
+
+	/** @BATADV_MEM_TT_LOCAL: local translation table */
+	BATADV_MEM_TT_LOCAL,
+
+	/** @BATADV_MEM_TT_GLOBAL: global translation table */
+	BATADV_MEM_TT_GLOBAL,
+
+	/** @BATADV_MEM_FRAG: buffered fragments */
+	BATADV_MEM_FRAG,
+
+	/** @BATADV_MEM_NC: network coding paths */
+	BATADV_MEM_NC,
+
+	/** @BATADV_MEM_DAT: distributed ARP table cache */
+	BATADV_MEM_DAT,
+
+	/** @BATADV_MEM_BLA_CLAIM: bridge loop avoidance claims */
+	BATADV_MEM_BLA_CLAIM,
+
+	/** @BATADV_MEM_NUM: number of reported tables */
+	BATADV_MEM_NUM,
+};
+
+/* names of the number of entries and the bytes used by each table, tables
+ * without countable entries only report their bytes
+ */
+static const char * const batadv_mem_strings[BATADV_MEM_NUM][2] = {
+	[BATADV_MEM_ORIG] = { "mem_orig_entries", "mem_orig_bytes" },
+	[BATADV_MEM_NEIGH] = { "mem_neigh_entries", "mem_neigh_bytes" },
+	[BATADV_MEM_TT_LOCAL] = { "mem_tt_local_entries",
+				  "mem_tt_local_bytes" },
+	[BATADV_MEM_TT_GLOBAL] = { "mem_tt_global_entries",
+				   "mem_tt_global_bytes" },
+	[BATADV_MEM_FRAG] = { NULL, "mem_frag_bytes" },
+	[BATADV_MEM_NC] = { "mem_nc_entries", "mem_nc_bytes" },
+	[BATADV_MEM_DAT] = { "mem_dat_entries", "mem_dat_bytes" },
+	[BATADV_MEM_BLA_CLAIM] = { "mem_bla_claim_entries",
+				   "mem_bla_claim_bytes" },
+};
+
+/**
+ * batadv_softif_mem_hash() - Add the memory used by a hashtable to a table
+ * @usage: entries and bytes of the table
+ * @hash: hash table
+ * @entry_size: size of each stored element
+ */
+static void batadv_softif_mem_hash(u64 *usage, struct batadv_hashtable *hash,
+				   size_t entry_size)
+{
+	if (!hash)
+		return;
+
+	usage[0] += atomic_read(&hash->count);
+	usage[1] += batadv_hash_mem(hash, entry_size);
+}
+
+/**
+ * batadv_softif_mem_usage() - Collect the memory used by the tables of a mesh
+ * @bat_priv: the bat priv with all the soft interface information
+ * @usage: returns the entries and bytes of each &enum batadv_mem_table
+ *
+ * The bytes are estimated from the number of entries and do not include
+ * memory referenced by the entries, except for the buffered fragments.
+ */
+static void batadv_softif_mem_usage(struct batadv_priv *bat_priv,
+				    u64 usage[BATADV_MEM_NUM][2])
+{
+	struct batadv_hard_iface *hard_iface;
+	u64 *neigh = usage[BATADV_MEM_NEIGH];
+
+	memset(usage, 0, sizeof(u64) * BATADV_MEM_NUM * 2);
+
+	batadv_softif_mem_hash(usage[BATADV_MEM_ORIG], bat_priv->orig_hash,
+			       sizeof(struct batadv_orig_node));
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(hard_iface, &batadv_hardif_list, list) {
+		if (hard_iface->soft_iface != bat_priv->soft_iface)
+			continue;
+
+		neigh[0] += atomic_read(&hard_iface->num_neighs);
+	}
+	rcu_read_unlock();
+	neigh[1] = neigh[0] * sizeof(struct batadv_hardif_neigh_node);
+
+	batadv_softif_mem_hash(usage[BATADV_MEM_TT_LOCAL],
+			       bat_priv->tt.local_hash,
+			       sizeof(struct batadv_tt_local_entry));
+	batadv_softif_mem_hash(usage[BATADV_MEM_TT_GLOBAL],
+			       bat_priv->tt.global_hash,
+			       sizeof(struct batadv_tt_global_entry));
+
+	usage[BATADV_MEM_FRAG][1] = atomic_read(&bat_priv->frag_mem);
+
+#ifdef CONFIG_BATMAN_ADV_NC
+	batadv_softif_mem_hash(usage[BATADV_MEM_NC], bat_priv->nc.coding_hash,
+			       sizeof(struct batadv_nc_path));
+	batadv_softif_mem_hash(usage[BATADV_MEM_NC],
+			       bat_priv->nc.decoding_hash,
+			       sizeof(struct batadv_nc_path));
+#endif
+#ifdef CONFIG_BATMAN_ADV_DAT
+	batadv_softif_mem_hash(usage[BATADV_MEM_DAT], bat_priv->dat.hash,
+			       sizeof(struct batadv_dat_entry));
+#endif
+#ifdef CONFIG_BATMAN_ADV_BLA
+	batadv_softif_mem_hash(usage[BATADV_MEM_BLA_CLAIM],
+			       bat_priv->bla.claim_hash,
+			       sizeof(struct batadv_bla_claim));
+#endif
+}
+
+/**
+ * batadv_softif_stats_dump_entry() - Dump one statistics counter into a
+ *  message
+ * @msg: Netlink message to dump into
+ * @portid: Port making netlink request
+ * @seq: Sequence number of netlink message
+ * @hard_iface: hard interface the counter belongs to, NULL for mesh counters
+ * @name: name of the counter
+ * @value: value of the counter
+ *
+ * Return: error code, or 0 on success
+ */
+static int
+batadv_softif_stats_dump_entry(struct sk_buff *msg, u32 portid, u32 seq,
+			       struct batadv_hard_iface *hard_iface,
+			       const char *name, u64 value)
+{
+	void *hdr;
+
+	hdr = genlmsg_put(msg, portid, seq, &batadv_netlink_family, NLM_F_MULTI,
+			  BATADV_CMD_GET_STATS);
+	if (!hdr)
+		return -EMSGSIZE;
+
+	if (hard_iface &&
+	    nla_put_u32(msg, BATADV_ATTR_HARD_IFINDEX,
+			hard_iface->net_dev->ifindex))
+		goto nla_put_failure;
+
+	if (nla_put_string(msg, BATADV_ATTR_STATS_NAME, name) ||
+	    nla_put_u64_64bit(msg, BATADV_ATTR_STATS_VALUE, value,
+			      BATADV_ATTR_PAD))
+		goto nla_put_failure;
+
+	genlmsg_end(msg, hdr);
+	return 0;
+
+ nla_put_failure:
+	genlmsg_cancel(msg, hdr);
+	return -EMSGSIZE;
+}
+
+/**
+ * batadv_softif_stats_dump() - Dump the statistics counters of a mesh and its
+ *  hard interfaces into messages
+ * @msg: Netlink message to dump into
+ * @cb: Parameters from query
+ *
+ * Every counter is dumped as a single message. The mesh wide counters come
+ * first, followed by the memory used by the tables of the mesh and the
+ * counters of each hard interface which carry the BATADV_ATTR_HARD_IFINDEX of
+ * the interface.
+ *
+ * Return: error code, or length of reply message on success
+ */
+int batadv_softif_stats_dump(struct sk_buff *msg, struct netlink_callback *cb)
+{
+	struct net *net = sock_net(cb->skb->sk);
+	int portid = NETLINK_CB(cb->skb).portid;
+	u64 mem_usage[BATADV_MEM_NUM][2];
+	struct batadv_hard_iface *hard_iface;
+	int seq = cb->nlh->nlmsg_seq;
+	struct net_device *soft_iface;
+	struct batadv_priv *bat_priv;
+	long *scope = &cb->args[0];
+	long *idx = &cb->args[1];
+	const char *name;
+	long pos = 2;
+	int ifindex;
+	u64 value;
+
+	ifindex = batadv_netlink_get_ifindex(cb->nlh,
+					     BATADV_ATTR_MESH_IFINDEX);
+	if (!ifindex)
+		return -EINVAL;
+
+	soft_iface = dev_get_by_index(net, ifindex);
+	if (!soft_iface)
+		return -ENODEV;
+
+	if (!batadv_softif_is_valid(soft_iface)) {
+		dev_put(soft_iface);
+		return -ENODEV;
+	}
+
+	bat_priv = netdev_priv(soft_iface);
+
+	/* scope 0 are the mesh wide counters */
+	if (*scope == 0) {
+		for (; *idx < BATADV_CNT_NUM; (*idx)++) {
+			name = batadv_counters_strings[*idx].string;
+			value = batadv_sum_counter(bat_priv, *idx);
+
+			if (batadv_softif_stats_dump_entry(msg, portid, seq,
+							   NULL, name, value))
+				goto out;
+		}
+
+		*idx = 0;
+		*scope = 1;
+	}
+
+	/* scope 1 is the memory used by the tables */
+	if (*scope == 1) {
+		batadv_softif_mem_usage(bat_priv, mem_usage);
+
+		for (; *idx < BATADV_MEM_NUM * 2; (*idx)++) {
+			name = batadv_mem_strings[*idx / 2][*idx % 2];
+			if (!name)
+				continue;
+
+			value = mem_usage[*idx / 2][*idx % 2];
+
+			if (batadv_softif_stats_dump_entry(msg, portid, seq,
+							   NULL, name, value))
+				goto out;
+		}
+
+		*idx = 0;
+		*scope = 2;
+	}
+
+	BUILD_BUG_ON(ARRAY_SIZE(batadv_hardif_counters_strings) !=
+		     BATADV_HARDIF_CNT_NUM);
+
+	/* followed by one scope per hard interface of the mesh */
+	rcu_read_lock();
+	list_for_each_entry_rcu(hard_iface, &batadv_hardif_list, list) {
+		if (hard_iface->soft_iface != soft_iface)
+			continue;
+
+		if (pos++ < *scope)
+			continue;
+
+		for (; *idx < BATADV_HARDIF_CNT_NUM; (*idx)++) {
+			name = batadv_hardif_counters_strings[*idx];
+			value = batadv_hardif_sum_counter(hard_iface, *idx);
+
+			if (batadv_softif_stats_dump_entry(msg, portid, seq,
+							   hard_iface, name,
+							   value))
+				goto out_unlock;
+		}
+
+		*idx = 0;
+		(*scope)++;
+	}
+out_unlock:
+	rcu_read_unlock();
+
+out:
+	dev_put(soft_iface);
+
+	return msg->len;
+}
+
 static const struct ethtool_ops batadv_ethtool_ops = {
 	.get_drvinfo = batadv_get_drvinfo,
 	.get_link = ethtool_op_get_link,
@@ -1051,6 +1621,14 @@ static void batadv_softif_init_early(struct net_device *dev)
 	dev->needs_free_netdev = true;
 	dev->priv_destructor = batadv_softif_free;
 	dev->features |= NETIF_F_HW_VLAN_CTAG_FILTER | NETIF_F_NETNS_LOCAL;
+
+	/* TCP super frames are encapsulated and routed once and only split
+	 * into segments when handed to the next-hop
+	 */
+	dev->hw_features |= NETIF_F_SG | NETIF_F_HW_CSUM | NETIF_F_TSO |
+			    NETIF_F_TSO6;
+	dev->features |= dev->hw_features;
+	dev->vlan_features |= dev->hw_features;
 	dev->priv_flags |= IFF_NO_QUEUE;
 
 	/* can't call min_mtu, because the needed variables
@@ -26,9 +26,11 @@
 
 struct net_device;
 struct net;
+struct netlink_callback;
 struct sk_buff;
 
-int batadv_skb_head_push(struct sk_buff *skb, unsigned int len);
+int batadv_skb_head_push(struct batadv_priv *bat_priv, struct sk_buff *skb,
+			 unsigned int len, enum batadv_counters idx);
 void batadv_interface_rx(struct net_device *soft_iface,
 			 struct sk_buff *skb, int hdr_size,
 			 struct batadv_orig_node *orig_node);
@@ -40,5 +42,6 @@ int batadv_softif_create_vlan(struct batadv_priv *bat_priv, unsigned short vid);
 void batadv_softif_vlan_put(struct batadv_softif_vlan *softif_vlan);
 struct batadv_softif_vlan *batadv_softif_vlan_get(struct batadv_priv *bat_priv,
 						  unsigned short vid);
+int batadv_softif_stats_dump(struct sk_buff *msg, struct netlink_callback *cb);
 
 #endif /* _NET_BATMAN_ADV_SOFT_INTERFACE_H_ */
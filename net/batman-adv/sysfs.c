@@ -421,6 +421,7 @@ static void batadv_post_gw_reselect(struct net_device *net_dev)
 {
 	struct batadv_priv *bat_priv = netdev_priv(net_dev);
 
+	batadv_gw_rank_refresh(bat_priv);
 	batadv_gw_reselect(bat_priv);
 }
 
@@ -433,7 +434,7 @@ static ssize_t batadv_show_gw_mode(struct kobject *kobj, struct attribute *attr,
 	/* GW mode is not available if the routing algorithm in use does not
 	 * implement the GW API
 	 */
-	if (!bat_priv->algo_ops->gw.get_best_gw_node ||
+	if (!bat_priv->algo_ops->gw.metric ||
 	    !bat_priv->algo_ops->gw.is_eligible)
 		return -ENOENT;
 
@@ -467,7 +468,7 @@ static ssize_t batadv_store_gw_mode(struct kobject *kobj,
 	/* toggling GW mode is allowed only if the routing algorithm in use
 	 * provides the GW API
 	 */
-	if (!bat_priv->algo_ops->gw.get_best_gw_node ||
+	if (!bat_priv->algo_ops->gw.metric ||
 	    !bat_priv->algo_ops->gw.is_eligible)
 		return -EINVAL;
 
@@ -538,7 +539,7 @@ static ssize_t batadv_show_gw_sel_class(struct kobject *kobj,
 	/* GW selection class is not available if the routing algorithm in use
 	 * does not implement the GW API
 	 */
-	if (!bat_priv->algo_ops->gw.get_best_gw_node ||
+	if (!bat_priv->algo_ops->gw.metric ||
 	    !bat_priv->algo_ops->gw.is_eligible)
 		return -ENOENT;
 
@@ -557,7 +558,7 @@ static ssize_t batadv_store_gw_sel_class(struct kobject *kobj,
 	/* setting the GW selection class is allowed only if the routing
 	 * algorithm in use implements the GW API
 	 */
-	if (!bat_priv->algo_ops->gw.get_best_gw_node ||
+	if (!bat_priv->algo_ops->gw.metric ||
 	    !bat_priv->algo_ops->gw.is_eligible)
 		return -EINVAL;
 
@@ -668,26 +669,54 @@ static ssize_t batadv_store_isolation_mark(struct kobject *kobj,
 }
 
 BATADV_ATTR_SIF_BOOL(aggregated_ogms, 0644, NULL);
+BATADV_ATTR_SIF_UINT(unicast_agg_delay, unicast_agg_delay, 0644, 0,
+		     BATADV_UNICAST_AGG_DELAY_MAX, NULL);
+BATADV_ATTR_SIF_UINT(bcast_suppress_arp,
+		     bcast_suppress.window[BATADV_BCAST_CLASS_ARP], 0644, 0,
+		     BATADV_BCAST_SUPPRESS_WINDOW_MAX, NULL);
+BATADV_ATTR_SIF_UINT(bcast_suppress_dhcp,
+		     bcast_suppress.window[BATADV_BCAST_CLASS_DHCP], 0644, 0,
+		     BATADV_BCAST_SUPPRESS_WINDOW_MAX, NULL);
+BATADV_ATTR_SIF_UINT(bcast_suppress_mdns,
+		     bcast_suppress.window[BATADV_BCAST_CLASS_MDNS], 0644, 0,
+		     BATADV_BCAST_SUPPRESS_WINDOW_MAX, NULL);
 BATADV_ATTR_SIF_BOOL(bonding, 0644, NULL);
+BATADV_ATTR_SIF_BOOL(rx_steering, 0644, NULL);
+#ifdef CONFIG_BATMAN_ADV_BATMAN_V
+BATADV_ATTR_SIF_BOOL(passive_capacity, 0644, NULL);
+#endif
 #ifdef CONFIG_BATMAN_ADV_BLA
 BATADV_ATTR_SIF_BOOL(bridge_loop_avoidance, 0644, batadv_bla_status_update);
 #endif
 #ifdef CONFIG_BATMAN_ADV_DAT
 BATADV_ATTR_SIF_BOOL(distributed_arp_table, 0644, batadv_dat_status_update);
+BATADV_ATTR_SIF_UINT(dat_max_entries, dat.max_entries, 0644, 0, INT_MAX,
+		     NULL);
 #endif
 BATADV_ATTR_SIF_BOOL(fragmentation, 0644, batadv_update_min_mtu);
 static BATADV_ATTR(routing_algo, 0444, batadv_show_bat_algo, NULL);
 static BATADV_ATTR(gw_mode, 0644, batadv_show_gw_mode, batadv_store_gw_mode);
 BATADV_ATTR_SIF_UINT(orig_interval, orig_interval, 0644, 2 * BATADV_JITTER,
 		     INT_MAX, NULL);
+BATADV_ATTR_SIF_UINT(orig_interval_max, orig_interval_max, 0644, 0, INT_MAX,
+		     NULL);
+BATADV_ATTR_SIF_UINT(orig_max_entries, orig_max_entries, 0644, 0, INT_MAX,
+		     NULL);
+BATADV_ATTR_SIF_UINT(tt_global_max_entries, tt.global_max_entries, 0644, 0,
+		     INT_MAX, NULL);
+BATADV_ATTR_SIF_UINT(fisheye_hops, fisheye_hops, 0644, 0, BATADV_TTL, NULL);
 BATADV_ATTR_SIF_UINT(hop_penalty, hop_penalty, 0644, 0, BATADV_TQ_MAX_VALUE,
 		     NULL);
 static BATADV_ATTR(gw_sel_class, 0644, batadv_show_gw_sel_class,
 		   batadv_store_gw_sel_class);
 static BATADV_ATTR(gw_bandwidth, 0644, batadv_show_gw_bwidth,
 		   batadv_store_gw_bwidth);
+BATADV_ATTR_SIF_UINT(gw_balance, gw.balance, 0644, 0, BATADV_GW_BALANCE_MAX,
+		     NULL);
 #ifdef CONFIG_BATMAN_ADV_MCAST
 BATADV_ATTR_SIF_BOOL(multicast_mode, 0644, NULL);
+BATADV_ATTR_SIF_UINT(multicast_fanout, multicast_fanout, 0644, 1, INT_MAX,
+		     NULL);
 #endif
 #ifdef CONFIG_BATMAN_ADV_DEBUG
 BATADV_ATTR_SIF_UINT(log_level, log_level, 0644, 0, BATADV_DBG_ALL, NULL);
@@ -700,23 +729,38 @@ static BATADV_ATTR(isolation_mark, 0644, batadv_show_isolation_mark,
 
 static struct batadv_attribute *batadv_mesh_attrs[] = {
 	&batadv_attr_aggregated_ogms,
+	&batadv_attr_unicast_agg_delay,
+	&batadv_attr_bcast_suppress_arp,
+	&batadv_attr_bcast_suppress_dhcp,
+	&batadv_attr_bcast_suppress_mdns,
 	&batadv_attr_bonding,
 #ifdef CONFIG_BATMAN_ADV_BLA
 	&batadv_attr_bridge_loop_avoidance,
 #endif
 #ifdef CONFIG_BATMAN_ADV_DAT
 	&batadv_attr_distributed_arp_table,
+	&batadv_attr_dat_max_entries,
 #endif
 #ifdef CONFIG_BATMAN_ADV_MCAST
 	&batadv_attr_multicast_mode,
+	&batadv_attr_multicast_fanout,
 #endif
+	&batadv_attr_fisheye_hops,
 	&batadv_attr_fragmentation,
 	&batadv_attr_routing_algo,
+	&batadv_attr_rx_steering,
+#ifdef CONFIG_BATMAN_ADV_BATMAN_V
+	&batadv_attr_passive_capacity,
+#endif
 	&batadv_attr_gw_mode,
 	&batadv_attr_orig_interval,
+	&batadv_attr_orig_interval_max,
+	&batadv_attr_orig_max_entries,
+	&batadv_attr_tt_global_max_entries,
 	&batadv_attr_hop_penalty,
 	&batadv_attr_gw_sel_class,
 	&batadv_attr_gw_bandwidth,
+	&batadv_attr_gw_balance,
 #ifdef CONFIG_BATMAN_ADV_DEBUG
 	&batadv_attr_log_level,
 #endif
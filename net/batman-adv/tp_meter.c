@@ -34,6 +34,9 @@
 #include <linux/kref.h>
 #include <linux/kthread.h>
 #include <linux/list.h>
+#include <linux/lockdep.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
 #include <linux/netdevice.h>
 #include <linux/param.h>
 #include <linux/printk.h>
@@ -91,11 +94,25 @@
 /**
  * BATADV_TP_PLEN - length of the payload (data after the batadv_unicast header)
  *  to simulate
+ * @packet_len: length of the simulated client frame
  */
-#define BATADV_TP_PLEN (BATADV_TP_PACKET_LEN - ETH_HLEN - \
-			sizeof(struct batadv_unicast_packet))
+#define BATADV_TP_PLEN(packet_len) ((packet_len) - ETH_HLEN - \
+				    sizeof(struct batadv_unicast_packet))
 
-static u8 batadv_tp_prerandom[4096] __read_mostly;
+/**
+ * BATADV_TP_PRERANDOM_ORDER - allocation order of the prerandom buffer
+ */
+#define BATADV_TP_PRERANDOM_ORDER 2
+
+/**
+ * BATADV_TP_PRERANDOM_LEN - size of the prerandom buffer
+ */
+#define BATADV_TP_PRERANDOM_LEN (PAGE_SIZE << BATADV_TP_PRERANDOM_ORDER)
+
+/* random payload which is attached to all tp meter messages */
+static struct page *batadv_tp_prerandom __read_mostly;
+
+static struct kmem_cache *batadv_tp_unacked_cache __read_mostly;
 
 /**
  * batadv_tp_session_cookie() - generate session cookie based on session ids
@@ -212,6 +229,104 @@ static void batadv_tp_update_rto(struct batadv_tp_vars *tp_vars,
 	tp_vars->rto = (tp_vars->srtt >> 3) + tp_vars->rttvar;
 }
 
+/**
+ * batadv_tp_rtt_sample() - account a new RTT sample in the session statistics
+ * @tp_vars: the private data of the current TP meter session
+ * @new_rtt: new roundtrip time in msec
+ */
+static void batadv_tp_rtt_sample(struct batadv_tp_vars *tp_vars, u32 new_rtt)
+{
+	struct batadv_tp_rtt_stats *stats = &tp_vars->rtt;
+	u32 delta;
+
+	spin_lock_bh(&tp_vars->rtt_lock);
+
+	if (stats->count) {
+		if (new_rtt > stats->last)
+			delta = new_rtt - stats->last;
+		else
+			delta = stats->last - new_rtt;
+
+		/* J = J + (|D| - J) / 16 (Section 6.4.1 of RFC3550) */
+		stats->jitter += delta - (stats->jitter >> 4);
+	}
+
+	if (!stats->count || new_rtt < stats->min)
+		stats->min = new_rtt;
+	stats->max = max_t(u32, stats->max, new_rtt);
+	stats->sum += new_rtt;
+	stats->last = new_rtt;
+	stats->count++;
+	stats->hist[min_t(u32, new_rtt, BATADV_TP_RTT_HIST_LEN - 1)]++;
+
+	spin_unlock_bh(&tp_vars->rtt_lock);
+}
+
+/**
+ * batadv_tp_rtt_merge() - add the RTT statistics of a stream to another one
+ * @dst: the statistics to extend
+ * @src: the statistics to add to @dst
+ */
+static void batadv_tp_rtt_merge(struct batadv_tp_rtt_stats *dst,
+				const struct batadv_tp_rtt_stats *src)
+{
+	u64 jitter;
+	size_t i;
+
+	dst->reordered += src->reordered;
+
+	if (!src->count)
+		return;
+
+	/* weight the jitter of each stream by its number of samples */
+	jitter = (u64)dst->jitter * dst->count + (u64)src->jitter * src->count;
+	dst->jitter = div_u64(jitter, dst->count + src->count);
+
+	if (!dst->count || src->min < dst->min)
+		dst->min = src->min;
+	dst->max = max_t(u32, dst->max, src->max);
+	dst->sum += src->sum;
+	dst->count += src->count;
+
+	for (i = 0; i < BATADV_TP_RTT_HIST_LEN; i++)
+		dst->hist[i] += src->hist[i];
+}
+
+/**
+ * batadv_tp_rtt_summarize() - compute the RTT results reported to the client
+ * @stats: the collected RTT statistics
+ * @summary: the results to fill
+ *
+ * Return: true if RTT samples were collected, false otherwise
+ */
+static bool batadv_tp_rtt_summarize(const struct batadv_tp_rtt_stats *stats,
+				    struct batadv_tp_rtt_summary *summary)
+{
+	u32 rank, seen = 0;
+	size_t i;
+
+	if (!stats->count)
+		return false;
+
+	summary->min = stats->min;
+	summary->avg = div_u64(stats->sum, stats->count);
+	summary->jitter = stats->jitter >> 4;
+	summary->reordered = stats->reordered;
+
+	/* the last bucket is open ended, fall back to the biggest sample */
+	summary->p99 = stats->max;
+	rank = stats->count - stats->count / 100;
+	for (i = 0; i < BATADV_TP_RTT_HIST_LEN - 1; i++) {
+		seen += stats->hist[i];
+		if (seen >= rank) {
+			summary->p99 = i;
+			break;
+		}
+	}
+
+	return true;
+}
+
 /**
  * batadv_tp_batctl_notify() - send client status result to client
  * @reason: reason for tp meter session stop
@@ -220,11 +335,13 @@ static void batadv_tp_update_rto(struct batadv_tp_vars *tp_vars,
  * @start_time: start of transmission in jiffies
  * @total_sent: bytes acked to the receiver
  * @cookie: cookie of tp_meter session
+ * @rtt: RTT results of the session, NULL if none were collected
  */
 static void batadv_tp_batctl_notify(enum batadv_tp_meter_reason reason,
 				    const u8 *dst, struct batadv_priv *bat_priv,
 				    unsigned long start_time, u64 total_sent,
-				    u32 cookie)
+				    u32 cookie,
+				    const struct batadv_tp_rtt_summary *rtt)
 {
 	u32 test_time;
 	u8 result;
@@ -238,10 +355,11 @@ static void batadv_tp_batctl_notify(enum batadv_tp_meter_reason reason,
 		result = reason;
 		test_time = 0;
 		total_bytes = 0;
+		rtt = NULL;
 	}
 
 	batadv_netlink_tpmeter_notify(bat_priv, dst, result, test_time,
-				      total_bytes, cookie);
+				      total_bytes, cookie, rtt);
 }
 
 /**
@@ -256,7 +374,7 @@ static void batadv_tp_batctl_error_notify(enum batadv_tp_meter_reason reason,
 					  struct batadv_priv *bat_priv,
 					  u32 cookie)
 {
-	batadv_tp_batctl_notify(reason, dst, bat_priv, 0, 0, cookie);
+	batadv_tp_batctl_notify(reason, dst, bat_priv, 0, 0, cookie, NULL);
 }
 
 /**
@@ -336,6 +454,69 @@ batadv_tp_list_find_session(struct batadv_priv *bat_priv, const u8 *dst,
 	return tp_vars;
 }
 
+/**
+ * batadv_tp_group_release() - release a batadv_tp_group
+ * @ref: kref pointer of the batadv_tp_group
+ */
+static void batadv_tp_group_release(struct kref *ref)
+{
+	struct batadv_tp_group *group;
+
+	group = container_of(ref, struct batadv_tp_group, refcount);
+	kfree(group);
+}
+
+/**
+ * batadv_tp_group_put() - decrement the batadv_tp_group refcounter and
+ *  possibly release it
+ * @group: the tp meter test to be free'd
+ */
+static void batadv_tp_group_put(struct batadv_tp_group *group)
+{
+	kref_put(&group->refcount, batadv_tp_group_release);
+}
+
+/**
+ * batadv_tp_group_end() - account a finished stream and inform the client
+ *  once all streams of the test have finished
+ * @bat_priv: the bat priv with all the soft interface information
+ * @tp_vars: the private data of the finished stream
+ */
+static void batadv_tp_group_end(struct batadv_priv *bat_priv,
+				struct batadv_tp_vars *tp_vars)
+{
+	struct batadv_tp_group *group = tp_vars->group;
+	struct batadv_tp_rtt_summary summary;
+	bool has_rtt;
+
+	atomic64_add(atomic64_read(&tp_vars->tot_sent), &group->tot_sent);
+
+	spin_lock_bh(&group->rtt_lock);
+	spin_lock(&tp_vars->rtt_lock);
+	batadv_tp_rtt_merge(&group->rtt, &tp_vars->rtt);
+	spin_unlock(&tp_vars->rtt_lock);
+	spin_unlock_bh(&group->rtt_lock);
+
+	if (!batadv_tp_is_error(tp_vars->reason))
+		atomic_set(&group->reason, tp_vars->reason);
+	else
+		atomic_cmpxchg(&group->reason, 0, tp_vars->reason);
+
+	if (!atomic_dec_and_test(&group->pending))
+		return;
+
+	/* all streams are done, nobody else touches the group statistics */
+	has_rtt = batadv_tp_rtt_summarize(&group->rtt, &summary);
+
+	batadv_tp_batctl_notify(atomic_read(&group->reason),
+				group->other_end,
+				bat_priv,
+				group->start_time,
+				atomic64_read(&group->tot_sent),
+				group->cookie,
+				has_rtt ? &summary : NULL);
+}
+
 /**
  * batadv_tp_vars_release() - release batadv_tp_vars from lists and queue for
  *  free after rcu grace period
@@ -354,10 +535,13 @@ static void batadv_tp_vars_release(struct kref *ref)
 	spin_lock_bh(&tp_vars->unacked_lock);
 	list_for_each_entry_safe(un, safe, &tp_vars->unacked_list, list) {
 		list_del(&un->list);
-		kfree(un);
+		kmem_cache_free(batadv_tp_unacked_cache, un);
 	}
 	spin_unlock_bh(&tp_vars->unacked_lock);
 
+	if (tp_vars->group)
+		batadv_tp_group_put(tp_vars->group);
+
 	kfree_rcu(tp_vars, rcu);
 }
 
@@ -409,8 +593,6 @@ static void batadv_tp_sender_cleanup(struct batadv_priv *bat_priv,
 static void batadv_tp_sender_end(struct batadv_priv *bat_priv,
 				 struct batadv_tp_vars *tp_vars)
 {
-	u32 session_cookie;
-
 	batadv_dbg(BATADV_DBG_TP_METER, bat_priv,
 		   "Test towards %pM finished..shutting down (reason=%d)\n",
 		   tp_vars->other_end, tp_vars->reason);
@@ -423,15 +605,7 @@ static void batadv_tp_sender_end(struct batadv_priv *bat_priv,
 		   "Final values: cwnd=%u ss_threshold=%u\n",
 		   tp_vars->cwnd, tp_vars->ss_threshold);
 
-	session_cookie = batadv_tp_session_cookie(tp_vars->session,
-						  tp_vars->icmp_uid);
-
-	batadv_tp_batctl_notify(tp_vars->reason,
-				tp_vars->other_end,
-				bat_priv,
-				tp_vars->start_time,
-				atomic64_read(&tp_vars->tot_sent),
-				session_cookie);
+	batadv_tp_group_end(bat_priv, tp_vars);
 }
 
 /**
@@ -442,7 +616,10 @@ static void batadv_tp_sender_end(struct batadv_priv *bat_priv,
 static void batadv_tp_sender_shutdown(struct batadv_tp_vars *tp_vars,
 				      enum batadv_tp_meter_reason reason)
 {
-	if (!atomic_dec_and_test(&tp_vars->sending))
+	/* the session might already be stopping, e.g. when all streams
+	 * towards a destination are cancelled
+	 */
+	if (atomic_cmpxchg(&tp_vars->sending, 1, 0) != 1)
 		return;
 
 	tp_vars->reason = reason;
@@ -513,15 +690,15 @@ static void batadv_tp_sender_timeout(struct timer_list *t)
 	spin_lock_bh(&tp_vars->cwnd_lock);
 
 	tp_vars->ss_threshold = tp_vars->cwnd >> 1;
-	if (tp_vars->ss_threshold < BATADV_TP_PLEN * 2)
-		tp_vars->ss_threshold = BATADV_TP_PLEN * 2;
+	if (tp_vars->ss_threshold < tp_vars->plen * 2)
+		tp_vars->ss_threshold = tp_vars->plen * 2;
 
 	batadv_dbg(BATADV_DBG_TP_METER, bat_priv,
 		   "Meter: RTO fired during test towards %pM! cwnd=%u new ss_thr=%u, resetting last_sent to %u\n",
 		   tp_vars->other_end, tp_vars->cwnd, tp_vars->ss_threshold,
 		   atomic_read(&tp_vars->last_acked));
 
-	tp_vars->cwnd = BATADV_TP_PLEN * 3;
+	tp_vars->cwnd = tp_vars->plen * 3;
 
 	spin_unlock_bh(&tp_vars->cwnd_lock);
 
@@ -533,35 +710,31 @@ static void batadv_tp_sender_timeout(struct timer_list *t)
 }
 
 /**
- * batadv_tp_fill_prerandom() - Fill buffer with prefetched random bytes
+ * batadv_tp_attach_prerandom() - attach prefetched random bytes to a message
  * @tp_vars: the private TP meter data for this session
- * @buf: Buffer to fill with bytes
+ * @skb: message to attach the payload to
  * @nbytes: amount of pseudorandom bytes
+ *
+ * The payload references the shared prerandom pages instead of being copied.
+ * The offset is advanced atomically because retransmissions are also sent
+ * from the ACK receive path.
  */
-static void batadv_tp_fill_prerandom(struct batadv_tp_vars *tp_vars,
-				     u8 *buf, size_t nbytes)
+static void batadv_tp_attach_prerandom(struct batadv_tp_vars *tp_vars,
+				       struct sk_buff *skb, size_t nbytes)
 {
-	u32 local_offset;
-	size_t bytes_inbuf;
-	size_t to_copy;
-	size_t pos = 0;
-
-	spin_lock_bh(&tp_vars->prerandom_lock);
-	local_offset = tp_vars->prerandom_offset;
-	tp_vars->prerandom_offset += nbytes;
-	tp_vars->prerandom_offset %= sizeof(batadv_tp_prerandom);
-	spin_unlock_bh(&tp_vars->prerandom_lock);
-
-	while (nbytes) {
-		local_offset %= sizeof(batadv_tp_prerandom);
-		bytes_inbuf = sizeof(batadv_tp_prerandom) - local_offset;
-		to_copy = min(nbytes, bytes_inbuf);
-
-		memcpy(&buf[pos], &batadv_tp_prerandom[local_offset], to_copy);
-		pos += to_copy;
-		nbytes -= to_copy;
-		local_offset = 0;
-	}
+	u32 offset;
+
+	if (!nbytes)
+		return;
+
+	offset = atomic_add_return(nbytes, &tp_vars->prerandom_offset);
+	offset %= BATADV_TP_PRERANDOM_LEN - nbytes;
+
+	get_page(batadv_tp_prerandom);
+	skb_add_rx_frag(skb, 0, batadv_tp_prerandom, offset, nbytes, nbytes);
+
+	/* nobody must modify the payload of the other messages */
+	skb_shinfo(skb)->tx_flags |= SKBTX_SHARED_FRAG;
 }
 
 /**
@@ -589,10 +762,9 @@ static int batadv_tp_send_msg(struct batadv_tp_vars *tp_vars, const u8 *src,
 	struct batadv_icmp_tp_packet *icmp;
 	struct sk_buff *skb;
 	int r;
-	u8 *data;
-	size_t data_len;
 
-	skb = netdev_alloc_skb_ip_align(NULL, len + ETH_HLEN);
+	/* only the header is stored in the linear part */
+	skb = netdev_alloc_skb_ip_align(NULL, sizeof(*icmp) + ETH_HLEN);
 	if (unlikely(!skb))
 		return BATADV_TP_REASON_MEMORY_ERROR;
 
@@ -613,9 +785,7 @@ static int batadv_tp_send_msg(struct batadv_tp_vars *tp_vars, const u8 *src,
 	icmp->seqno = htonl(seqno);
 	icmp->timestamp = htonl(timestamp);
 
-	data_len = len - sizeof(*icmp);
-	data = skb_put(skb, data_len);
-	batadv_tp_fill_prerandom(tp_vars, data, data_len);
+	batadv_tp_attach_prerandom(tp_vars, skb, len - sizeof(*icmp));
 
 	r = batadv_send_skb_to_orig(skb, orig_node, NULL);
 	if (r == NET_XMIT_SUCCESS)
@@ -624,6 +794,54 @@ static int batadv_tp_send_msg(struct batadv_tp_vars *tp_vars, const u8 *src,
 	return BATADV_TP_REASON_CANT_SEND;
 }
 
+/**
+ * batadv_tp_update_sacked() - store the selective acknowledgment blocks of an
+ *  ACK
+ * @tp_vars: the private data of the current TP meter session
+ * @skb: the buffer containing the received ACK
+ * @recv_ack: the cumulative ACK carried by @skb
+ */
+static void batadv_tp_update_sacked(struct batadv_tp_vars *tp_vars,
+				    const struct sk_buff *skb, u32 recv_ack)
+{
+	struct batadv_icmp_tp_sack sack_buf;
+	const struct batadv_icmp_tp_sack *sack;
+	struct batadv_tp_sack *stored;
+	u32 prev_end = recv_ack;
+	u32 start, end;
+	int offset;
+	u8 num;
+
+	spin_lock_bh(&tp_vars->cwnd_lock);
+
+	tp_vars->sacked_bytes = 0;
+	for (num = 0; num < BATADV_TP_SACK_BLOCKS; num++) {
+		offset = sizeof(struct batadv_icmp_tp_packet);
+		offset += num * sizeof(*sack);
+		sack = skb_header_pointer(skb, offset, sizeof(*sack),
+					  &sack_buf);
+		if (!sack)
+			break;
+
+		start = ntohl(sack->start);
+		end = ntohl(sack->end);
+
+		/* blocks must be above the cumulative ACK and ascending */
+		if (!batadv_seq_after(start, prev_end) ||
+		    !batadv_seq_after(end, start))
+			break;
+
+		stored = &tp_vars->sacked[num];
+		stored->start = start;
+		stored->end = end;
+		tp_vars->sacked_bytes += end - start;
+		prev_end = end;
+	}
+	tp_vars->num_sacked = num;
+
+	spin_unlock_bh(&tp_vars->cwnd_lock);
+}
+
 /**
  * batadv_tp_recv_ack() - ACK receiving function
  * @bat_priv: the bat priv with all the soft interface information
@@ -642,10 +860,6 @@ static void batadv_tp_recv_ack(struct batadv_priv *bat_priv,
 	u32 rtt, recv_ack, cwnd;
 	unsigned char *dev_addr;
 
-	packet_len = BATADV_TP_PLEN;
-	mss = BATADV_TP_PLEN;
-	packet_len += sizeof(struct batadv_unicast_packet);
-
 	icmp = (struct batadv_icmp_tp_packet *)skb->data;
 
 	/* find the tp_vars */
@@ -654,13 +868,20 @@ static void batadv_tp_recv_ack(struct batadv_priv *bat_priv,
 	if (unlikely(!tp_vars))
 		return;
 
+	mss = tp_vars->plen;
+	packet_len = mss + sizeof(struct batadv_unicast_packet);
+
 	if (unlikely(atomic_read(&tp_vars->sending) == 0))
 		goto out;
 
-	/* old ACK? silently drop it.. */
+	/* old ACK? count the reordering and drop it.. */
 	if (batadv_seq_before(ntohl(icmp->seqno),
-			      (u32)atomic_read(&tp_vars->last_acked)))
+			      (u32)atomic_read(&tp_vars->last_acked))) {
+		spin_lock_bh(&tp_vars->rtt_lock);
+		tp_vars->rtt.reordered++;
+		spin_unlock_bh(&tp_vars->rtt_lock);
 		goto out;
+	}
 
 	primary_if = batadv_primary_if_get_selected(bat_priv);
 	if (unlikely(!primary_if))
@@ -675,10 +896,15 @@ static void batadv_tp_recv_ack(struct batadv_priv *bat_priv,
 	if (icmp->timestamp && rtt)
 		batadv_tp_update_rto(tp_vars, rtt);
 
+	/* sub-msec RTTs are valid samples for the latency statistics */
+	if (icmp->timestamp)
+		batadv_tp_rtt_sample(tp_vars, rtt);
+
 	/* ACK for new data... reset the timer */
 	batadv_tp_reset_sender_timer(tp_vars);
 
 	recv_ack = ntohl(icmp->seqno);
+	batadv_tp_update_sacked(tp_vars, skb, recv_ack);
 
 	/* check if this ACK is a duplicate */
 	if (atomic_read(&tp_vars->last_acked) == recv_ack) {
@@ -776,9 +1002,20 @@ out:
 static bool batadv_tp_avail(struct batadv_tp_vars *tp_vars,
 			    size_t payload_len)
 {
-	u32 win_left, win_limit;
+	u32 win_left, win_limit, cwnd;
+
+	/* a latency test never queues more than one message on the path */
+	if (tp_vars->latency)
+		cwnd = payload_len;
+	else
+		cwnd = tp_vars->cwnd;
+
+	/* selectively acknowledged data is not in flight anymore */
+	win_limit = atomic_read(&tp_vars->last_acked) + cwnd;
+	win_limit += tp_vars->sacked_bytes;
+	if (batadv_seq_before(win_limit, tp_vars->last_sent))
+		return false;
 
-	win_limit = atomic_read(&tp_vars->last_acked) + tp_vars->cwnd;
 	win_left = win_limit - tp_vars->last_sent;
 
 	return win_left >= payload_len;
@@ -806,6 +1043,32 @@ static int batadv_tp_wait_available(struct batadv_tp_vars *tp_vars, size_t plen)
 	return ret;
 }
 
+/**
+ * batadv_tp_skip_sacked() - move the transmit window over data which was
+ *  already selectively acknowledged by the receiver
+ * @tp_vars: the private data of the current TP meter session
+ *
+ * This turns the go-back-N behaviour of Fast Retransmit and RTO into a
+ * selective repeat of the gaps the receiver is still missing.
+ */
+static void batadv_tp_skip_sacked(struct batadv_tp_vars *tp_vars)
+{
+	struct batadv_tp_sack *sack;
+	u8 i;
+
+	spin_lock_bh(&tp_vars->cwnd_lock);
+	for (i = 0; i < tp_vars->num_sacked; i++) {
+		sack = &tp_vars->sacked[i];
+
+		if (batadv_seq_before(tp_vars->last_sent, sack->start))
+			break;
+
+		if (batadv_seq_before(tp_vars->last_sent, sack->end))
+			tp_vars->last_sent = sack->end;
+	}
+	spin_unlock_bh(&tp_vars->cwnd_lock);
+}
+
 /**
  * batadv_tp_send() - main sending thread of a tp meter session
  * @arg: address of the related tp_vars
@@ -847,8 +1110,8 @@ static int batadv_tp_send(void *arg)
 	 * should be used.
 	 * Now, try to send the packet as it is
 	 */
-	payload_len = BATADV_TP_PLEN;
-	BUILD_BUG_ON(sizeof(struct batadv_icmp_tp_packet) > BATADV_TP_PLEN);
+	payload_len = tp_vars->plen;
+	BUILD_BUG_ON(BATADV_TP_MAX_PACKET_LEN > BATADV_TP_PRERANDOM_LEN);
 
 	batadv_tp_reset_sender_timer(tp_vars);
 
@@ -857,6 +1120,8 @@ static int batadv_tp_send(void *arg)
 			   msecs_to_jiffies(tp_vars->test_length));
 
 	while (atomic_read(&tp_vars->sending) != 0) {
+		batadv_tp_skip_sacked(tp_vars);
+
 		if (unlikely(!batadv_tp_avail(tp_vars, payload_len))) {
 			batadv_tp_wait_available(tp_vars, payload_len);
 			continue;
@@ -914,17 +1179,13 @@ static void batadv_tp_start_kthread(struct batadv_tp_vars *tp_vars)
 {
 	struct task_struct *kthread;
 	struct batadv_priv *bat_priv = tp_vars->bat_priv;
-	u32 session_cookie;
 
 	kref_get(&tp_vars->refcount);
 	kthread = kthread_create(batadv_tp_send, tp_vars, "kbatadv_tp_meter");
 	if (IS_ERR(kthread)) {
-		session_cookie = batadv_tp_session_cookie(tp_vars->session,
-							  tp_vars->icmp_uid);
 		pr_err("batadv: cannot create tp meter kthread\n");
-		batadv_tp_batctl_error_notify(BATADV_TP_REASON_MEMORY_ERROR,
-					      tp_vars->other_end,
-					      bat_priv, session_cookie);
+		tp_vars->reason = BATADV_TP_REASON_MEMORY_ERROR;
+		batadv_tp_group_end(bat_priv, tp_vars);
 
 		/* drop reserved reference for kthread */
 		batadv_tp_vars_put(tp_vars);
@@ -938,76 +1199,51 @@ static void batadv_tp_start_kthread(struct batadv_tp_vars *tp_vars)
 }
 
 /**
- * batadv_tp_start() - start a new tp meter session
+ * batadv_tp_sender_init() - initialize a new sender stream
  * @bat_priv: the bat priv with all the soft interface information
- * @dst: the receiver MAC address
+ * @tp_vars: the private data of the new stream
+ * @group: the test the stream belongs to
+ * @session_id: session identifier of the stream
+ * @icmp_uid: local ICMP "socket" index
  * @test_length: test length in milliseconds
- * @cookie: session cookie
+ * @packet_len: length of the simulated client frames
+ * @latency: whether to keep only a single message in flight
+ *
+ * Caller must hold bat_priv->tp_list_lock.
  */
-void batadv_tp_start(struct batadv_priv *bat_priv, const u8 *dst,
-		     u32 test_length, u32 *cookie)
+static void batadv_tp_sender_init(struct batadv_priv *bat_priv,
+				  struct batadv_tp_vars *tp_vars,
+				  struct batadv_tp_group *group,
+				  const u8 *session_id, u8 icmp_uid,
+				  u32 test_length, u16 packet_len,
+				  bool latency)
 {
-	struct batadv_tp_vars *tp_vars;
-	u8 session_id[2];
-	u8 icmp_uid;
-	u32 session_cookie;
-
-	get_random_bytes(session_id, sizeof(session_id));
-	get_random_bytes(&icmp_uid, 1);
-	session_cookie = batadv_tp_session_cookie(session_id, icmp_uid);
-	*cookie = session_cookie;
-
-	/* look for an already existing test towards this node */
-	spin_lock_bh(&bat_priv->tp_list_lock);
-	tp_vars = batadv_tp_list_find(bat_priv, dst);
-	if (tp_vars) {
-		spin_unlock_bh(&bat_priv->tp_list_lock);
-		batadv_tp_vars_put(tp_vars);
-		batadv_dbg(BATADV_DBG_TP_METER, bat_priv,
-			   "Meter: test to or from the same node already ongoing, aborting\n");
-		batadv_tp_batctl_error_notify(BATADV_TP_REASON_ALREADY_ONGOING,
-					      dst, bat_priv, session_cookie);
-		return;
-	}
-
-	if (!atomic_add_unless(&bat_priv->tp_num, 1, BATADV_TP_MAX_NUM)) {
-		spin_unlock_bh(&bat_priv->tp_list_lock);
-		batadv_dbg(BATADV_DBG_TP_METER, bat_priv,
-			   "Meter: too many ongoing sessions, aborting (SEND)\n");
-		batadv_tp_batctl_error_notify(BATADV_TP_REASON_TOO_MANY, dst,
-					      bat_priv, session_cookie);
-		return;
-	}
-
-	tp_vars = kmalloc(sizeof(*tp_vars), GFP_ATOMIC);
-	if (!tp_vars) {
-		spin_unlock_bh(&bat_priv->tp_list_lock);
-		batadv_dbg(BATADV_DBG_TP_METER, bat_priv,
-			   "Meter: %s cannot allocate list elements\n",
-			   __func__);
-		batadv_tp_batctl_error_notify(BATADV_TP_REASON_MEMORY_ERROR,
-					      dst, bat_priv, session_cookie);
-		return;
-	}
+	lockdep_assert_held(&bat_priv->tp_list_lock);
 
 	/* initialize tp_vars */
-	ether_addr_copy(tp_vars->other_end, dst);
+	ether_addr_copy(tp_vars->other_end, group->other_end);
 	kref_init(&tp_vars->refcount);
 	tp_vars->role = BATADV_TP_SENDER;
 	atomic_set(&tp_vars->sending, 1);
-	memcpy(tp_vars->session, session_id, sizeof(session_id));
+	memcpy(tp_vars->session, session_id, sizeof(tp_vars->session));
 	tp_vars->icmp_uid = icmp_uid;
 
+	kref_get(&group->refcount);
+	tp_vars->group = group;
+
 	tp_vars->last_sent = BATADV_TP_FIRST_SEQ;
 	atomic_set(&tp_vars->last_acked, BATADV_TP_FIRST_SEQ);
 	tp_vars->fast_recovery = false;
 	tp_vars->recover = BATADV_TP_FIRST_SEQ;
+	tp_vars->num_sacked = 0;
+	tp_vars->sacked_bytes = 0;
+	tp_vars->plen = BATADV_TP_PLEN(packet_len);
 
 	/* initialise the CWND to 3*MSS (Section 3.1 in RFC5681).
 	 * For batman-adv the MSS is the size of the payload received by the
 	 * soft_interface, hence its MTU
 	 */
-	tp_vars->cwnd = BATADV_TP_PLEN * 3;
+	tp_vars->cwnd = tp_vars->plen * 3;
 	/* at the beginning initialise the SS threshold to the biggest possible
 	 * window size, hence the AWND size
 	 */
@@ -1020,6 +1256,10 @@ void batadv_tp_start(struct batadv_priv *bat_priv, const u8 *dst,
 	tp_vars->srtt = 0;
 	tp_vars->rttvar = 0;
 
+	memset(&tp_vars->rtt, 0, sizeof(tp_vars->rtt));
+	spin_lock_init(&tp_vars->rtt_lock);
+	tp_vars->latency = latency;
+
 	atomic64_set(&tp_vars->tot_sent, 0);
 
 	kref_get(&tp_vars->refcount);
@@ -1035,31 +1275,132 @@ void batadv_tp_start(struct batadv_priv *bat_priv, const u8 *dst,
 
 	spin_lock_init(&tp_vars->cwnd_lock);
 
-	tp_vars->prerandom_offset = 0;
-	spin_lock_init(&tp_vars->prerandom_lock);
-
-	kref_get(&tp_vars->refcount);
-	hlist_add_head_rcu(&tp_vars->list, &bat_priv->tp_list);
-	spin_unlock_bh(&bat_priv->tp_list_lock);
+	atomic_set(&tp_vars->prerandom_offset, 0);
 
 	tp_vars->test_length = test_length;
 	if (!tp_vars->test_length)
 		tp_vars->test_length = BATADV_TP_DEF_TEST_LENGTH;
 
-	batadv_dbg(BATADV_DBG_TP_METER, bat_priv,
-		   "Meter: starting throughput meter towards %pM (length=%ums)\n",
-		   dst, test_length);
-
 	/* init work item for finished tp tests */
 	INIT_DELAYED_WORK(&tp_vars->finish_work, batadv_tp_sender_finish);
 
-	/* start tp kthread. This way the write() call issued from userspace can
-	 * happily return and avoid to block
+	kref_get(&tp_vars->refcount);
+	hlist_add_head_rcu(&tp_vars->list, &bat_priv->tp_list);
+}
+
+/**
+ * batadv_tp_start() - start a new tp meter session
+ * @bat_priv: the bat priv with all the soft interface information
+ * @dst: the receiver MAC address
+ * @test_length: test length in milliseconds
+ * @streams: number of parallel streams towards @dst
+ * @packet_len: length of the simulated client frames
+ * @latency: whether to run a latency test with a single message in flight
+ * @cookie: session cookie
+ *
+ * Every stream is an independent session with its own sender thread, so the
+ * receiver doesn't need to know about parallel tests. The client is informed
+ * once with the aggregated result of all streams.
+ */
+void batadv_tp_start(struct batadv_priv *bat_priv, const u8 *dst,
+		     u32 test_length, u8 streams, u16 packet_len,
+		     bool latency, u32 *cookie)
+{
+	struct batadv_tp_vars *tp_vars[BATADV_TP_MAX_STREAMS];
+	struct batadv_tp_group *group;
+	struct batadv_tp_vars *found;
+	u8 session_id[2];
+	u8 icmp_uid;
+	u32 session_cookie;
+	u8 i;
+
+	get_random_bytes(session_id, sizeof(session_id));
+	get_random_bytes(&icmp_uid, 1);
+	session_cookie = batadv_tp_session_cookie(session_id, icmp_uid);
+	*cookie = session_cookie;
+
+	/* look for an already existing test towards this node */
+	spin_lock_bh(&bat_priv->tp_list_lock);
+	found = batadv_tp_list_find(bat_priv, dst);
+	if (found) {
+		spin_unlock_bh(&bat_priv->tp_list_lock);
+		batadv_tp_vars_put(found);
+		batadv_dbg(BATADV_DBG_TP_METER, bat_priv,
+			   "Meter: test to or from the same node already ongoing, aborting\n");
+		batadv_tp_batctl_error_notify(BATADV_TP_REASON_ALREADY_ONGOING,
+					      dst, bat_priv, session_cookie);
+		return;
+	}
+
+	/* tp_num is only increased with tp_list_lock held */
+	if (atomic_read(&bat_priv->tp_num) + streams > BATADV_TP_MAX_NUM) {
+		spin_unlock_bh(&bat_priv->tp_list_lock);
+		batadv_dbg(BATADV_DBG_TP_METER, bat_priv,
+			   "Meter: too many ongoing sessions, aborting (SEND)\n");
+		batadv_tp_batctl_error_notify(BATADV_TP_REASON_TOO_MANY, dst,
+					      bat_priv, session_cookie);
+		return;
+	}
+
+	group = kmalloc(sizeof(*group), GFP_ATOMIC);
+	if (!group)
+		goto err_alloc;
+
+	for (i = 0; i < streams; i++) {
+		tp_vars[i] = kmalloc(sizeof(*tp_vars[i]), GFP_ATOMIC);
+		if (!tp_vars[i])
+			goto err_alloc_streams;
+	}
+
+	atomic_add(streams, &bat_priv->tp_num);
+
+	ether_addr_copy(group->other_end, dst);
+	group->start_time = jiffies;
+	group->cookie = session_cookie;
+	atomic_set(&group->pending, streams);
+	atomic64_set(&group->tot_sent, 0);
+	atomic_set(&group->reason, 0);
+	memset(&group->rtt, 0, sizeof(group->rtt));
+	spin_lock_init(&group->rtt_lock);
+	kref_init(&group->refcount);
+
+	/* consecutive session ids keep the streams distinguishable */
+	for (i = 0; i < streams; i++) {
+		batadv_tp_sender_init(bat_priv, tp_vars[i], group, session_id,
+				      icmp_uid, test_length, packet_len,
+				      latency);
+		session_id[1]++;
+	}
+	spin_unlock_bh(&bat_priv->tp_list_lock);
+
+	batadv_dbg(BATADV_DBG_TP_METER, bat_priv,
+		   "Meter: starting %s meter towards %pM (length=%ums, streams=%u, packet_len=%u)\n",
+		   latency ? "latency" : "throughput", dst, test_length,
+		   streams, packet_len);
+
+	/* start tp kthreads. This way the write() call issued from userspace
+	 * can happily return and avoid to block
 	 */
-	batadv_tp_start_kthread(tp_vars);
+	for (i = 0; i < streams; i++) {
+		batadv_tp_start_kthread(tp_vars[i]);
 
-	/* don't return reference to new tp_vars */
-	batadv_tp_vars_put(tp_vars);
+		/* don't return reference to new tp_vars */
+		batadv_tp_vars_put(tp_vars[i]);
+	}
+
+	batadv_tp_group_put(group);
+	return;
+
+err_alloc_streams:
+	while (i--)
+		kfree(tp_vars[i]);
+	kfree(group);
+err_alloc:
+	spin_unlock_bh(&bat_priv->tp_list_lock);
+	batadv_dbg(BATADV_DBG_TP_METER, bat_priv,
+		   "Meter: %s cannot allocate list elements\n", __func__);
+	batadv_tp_batctl_error_notify(BATADV_TP_REASON_MEMORY_ERROR, dst,
+				      bat_priv, session_cookie);
 }
 
 /**
@@ -1073,6 +1414,7 @@ void batadv_tp_stop(struct batadv_priv *bat_priv, const u8 *dst,
 {
 	struct batadv_orig_node *orig_node;
 	struct batadv_tp_vars *tp_vars;
+	bool found = false;
 
 	batadv_dbg(BATADV_DBG_TP_METER, bat_priv,
 		   "Meter: stopping test towards %pM\n", dst);
@@ -1081,16 +1423,24 @@ void batadv_tp_stop(struct batadv_priv *bat_priv, const u8 *dst,
 	if (!orig_node)
 		return;
 
-	tp_vars = batadv_tp_list_find(bat_priv, orig_node->orig);
-	if (!tp_vars) {
+	/* stop all parallel streams of the test */
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(tp_vars, &bat_priv->tp_list, list) {
+		if (tp_vars->role != BATADV_TP_SENDER)
+			continue;
+
+		if (!batadv_compare_eth(tp_vars->other_end, orig_node->orig))
+			continue;
+
+		batadv_tp_sender_shutdown(tp_vars, return_value);
+		found = true;
+	}
+	rcu_read_unlock();
+
+	if (!found)
 		batadv_dbg(BATADV_DBG_TP_METER, bat_priv,
 			   "Meter: trying to interrupt an already over connection\n");
-		goto out;
-	}
 
-	batadv_tp_sender_shutdown(tp_vars, return_value);
-	batadv_tp_vars_put(tp_vars);
-out:
 	batadv_orig_node_put(orig_node);
 }
 
@@ -1143,7 +1493,7 @@ static void batadv_tp_receiver_shutdown(struct timer_list *t)
 	spin_lock_bh(&tp_vars->unacked_lock);
 	list_for_each_entry_safe(un, safe, &tp_vars->unacked_list, list) {
 		list_del(&un->list);
-		kfree(un);
+		kmem_cache_free(batadv_tp_unacked_cache, un);
 	}
 	spin_unlock_bh(&tp_vars->unacked_lock);
 
@@ -1159,19 +1509,25 @@ static void batadv_tp_receiver_shutdown(struct timer_list *t)
  * @timestamp: the timestamp to echo back in the ACK
  * @session: session identifier
  * @socket_index: local ICMP socket identifier
+ * @sack: selective acknowledgment blocks in ascending order
+ * @num_sack: number of blocks in @sack
  *
  * Return: 0 on success, a positive integer representing the reason of the
  * failure otherwise
  */
 static int batadv_tp_send_ack(struct batadv_priv *bat_priv, const u8 *dst,
 			      u32 seq, __be32 timestamp, const u8 *session,
-			      int socket_index)
+			      int socket_index,
+			      const struct batadv_tp_sack *sack, u8 num_sack)
 {
 	struct batadv_hard_iface *primary_if = NULL;
+	struct batadv_icmp_tp_sack *sack_packet;
 	struct batadv_orig_node *orig_node;
 	struct batadv_icmp_tp_packet *icmp;
 	struct sk_buff *skb;
+	size_t len;
 	int r, ret;
+	u8 i;
 
 	orig_node = batadv_orig_hash_find(bat_priv, dst);
 	if (unlikely(!orig_node)) {
@@ -1185,7 +1541,8 @@ static int batadv_tp_send_ack(struct batadv_priv *bat_priv, const u8 *dst,
 		goto out;
 	}
 
-	skb = netdev_alloc_skb_ip_align(NULL, sizeof(*icmp) + ETH_HLEN);
+	len = sizeof(*icmp) + num_sack * sizeof(*sack_packet);
+	skb = netdev_alloc_skb_ip_align(NULL, len + ETH_HLEN);
 	if (unlikely(!skb)) {
 		ret = BATADV_TP_REASON_MEMORY_ERROR;
 		goto out;
@@ -1206,6 +1563,12 @@ static int batadv_tp_send_ack(struct batadv_priv *bat_priv, const u8 *dst,
 	icmp->seqno = htonl(seq);
 	icmp->timestamp = timestamp;
 
+	for (i = 0; i < num_sack; i++) {
+		sack_packet = skb_put(skb, sizeof(*sack_packet));
+		sack_packet->start = htonl(sack[i].start);
+		sack_packet->end = htonl(sack[i].end);
+	}
+
 	/* send the ack */
 	r = batadv_send_skb_to_orig(skb, orig_node, NULL);
 	if (unlikely(r < 0) || r == NET_XMIT_DROP) {
@@ -1230,7 +1593,9 @@ out:
  *
  * Store the out of order packet in the unacked list for late processing. This
  * packets are kept in this list so that they can be ACKed at once as soon as
- * all the previous packets have been received
+ * all the previous packets have been received. Overlapping and adjacent
+ * packets are merged into a single range, so the list only grows with the
+ * number of gaps in the received data
  *
  * Return: true if the packed has been successfully processed, false otherwise
  */
@@ -1238,65 +1603,110 @@ static bool batadv_tp_handle_out_of_order(struct batadv_tp_vars *tp_vars,
 					  const struct sk_buff *skb)
 {
 	const struct batadv_icmp_tp_packet *icmp;
-	struct batadv_tp_unacked *un, *new;
-	u32 payload_len;
-	bool added = false;
-
-	new = kmalloc(sizeof(*new), GFP_ATOMIC);
-	if (unlikely(!new))
-		return false;
+	struct batadv_tp_unacked *un, *safe, *merged = NULL;
+	struct list_head *pos = &tp_vars->unacked_list;
+	u32 start, end, un_end;
+	bool ret = true;
 
 	icmp = (struct batadv_icmp_tp_packet *)skb->data;
 
-	new->seqno = ntohl(icmp->seqno);
-	payload_len = skb->len - sizeof(struct batadv_unicast_packet);
-	new->len = payload_len;
+	start = ntohl(icmp->seqno);
+	end = start + skb->len - sizeof(struct batadv_unicast_packet);
 
 	spin_lock_bh(&tp_vars->unacked_lock);
-	/* if the list is empty immediately attach this new object */
-	if (list_empty(&tp_vars->unacked_list)) {
-		list_add(&new->list, &tp_vars->unacked_list);
-		goto out;
-	}
 
-	/* otherwise loop over the list and either drop the packet because this
-	 * is a duplicate or store it at the right position.
-	 *
-	 * The iteration is done in the reverse way because it is likely that
+	/* The iteration is done in the reverse way because it is likely that
 	 * the last received packet (the one being processed now) has a bigger
-	 * seqno than all the others already stored.
+	 * seqno than all the others already stored. In the common case it
+	 * simply extends the last range
 	 */
-	list_for_each_entry_reverse(un, &tp_vars->unacked_list, list) {
-		/* check for duplicates */
-		if (new->seqno == un->seqno) {
-			if (new->len > un->len)
-				un->len = new->len;
-			kfree(new);
-			added = true;
+	list_for_each_entry_safe_reverse(un, safe, &tp_vars->unacked_list,
+					 list) {
+		un_end = un->seqno + un->len;
+
+		/* the list is ordered, all remaining ranges are in front of
+		 * the new data
+		 */
+		if (batadv_seq_before(un_end, start))
 			break;
-		}
 
-		/* look for the right position */
-		if (batadv_seq_before(new->seqno, un->seqno))
+		/* range behind the new data, the new one goes in front of it */
+		if (batadv_seq_before(end, un->seqno)) {
+			pos = &un->list;
 			continue;
+		}
 
-		/* as soon as an entry having a bigger seqno is found, the new
-		 * one is attached _after_ it. In this way the list is kept in
-		 * ascending order
+		/* overlapping or adjacent range, merge it with the new data.
+		 * The ranges bridged by the new data are merged into the one
+		 * with the smallest seqno
 		 */
-		list_add_tail(&new->list, &un->list);
-		added = true;
-		break;
+		if (batadv_seq_before(un->seqno, start))
+			start = un->seqno;
+		if (batadv_seq_after(un_end, end))
+			end = un_end;
+
+		if (merged) {
+			list_del(&merged->list);
+			kmem_cache_free(batadv_tp_unacked_cache, merged);
+		}
+		merged = un;
 	}
 
-	/* received packet with smallest seqno out of order; add it to front */
-	if (!added)
-		list_add(&new->list, &tp_vars->unacked_list);
+	if (!merged) {
+		merged = kmem_cache_alloc(batadv_tp_unacked_cache, GFP_ATOMIC);
+		if (unlikely(!merged)) {
+			ret = false;
+			goto out;
+		}
+
+		list_add_tail(&merged->list, pos);
+	}
+
+	merged->seqno = start;
+	merged->len = end - start;
 
 out:
 	spin_unlock_bh(&tp_vars->unacked_lock);
 
-	return true;
+	return ret;
+}
+
+/**
+ * batadv_tp_get_sack() - collect the selective acknowledgment blocks of a
+ *  receiver
+ * @tp_vars: the private data of the current TP meter session
+ * @sack: array of BATADV_TP_SACK_BLOCKS blocks to fill
+ *
+ * The blocks with the highest seqnos are reported because the sender already
+ * learned about the lower ones with the previous ACKs.
+ *
+ * Return: number of blocks stored in @sack in ascending order
+ */
+static u8 batadv_tp_get_sack(struct batadv_tp_vars *tp_vars,
+			     struct batadv_tp_sack *sack)
+{
+	struct batadv_tp_unacked *un;
+	u8 num = 0;
+	u8 i;
+
+	spin_lock_bh(&tp_vars->unacked_lock);
+	list_for_each_entry_reverse(un, &tp_vars->unacked_list, list) {
+		if (num == BATADV_TP_SACK_BLOCKS)
+			break;
+
+		num++;
+		i = BATADV_TP_SACK_BLOCKS - num;
+		sack[i].start = un->seqno;
+		sack[i].end = un->seqno + un->len;
+	}
+	spin_unlock_bh(&tp_vars->unacked_lock);
+
+	/* move the filled blocks to the front of the array */
+	if (num < BATADV_TP_SACK_BLOCKS)
+		memmove(sack, &sack[BATADV_TP_SACK_BLOCKS - num],
+			num * sizeof(*sack));
+
+	return num;
 }
 
 /**
@@ -1327,7 +1737,7 @@ static void batadv_tp_ack_unordered(struct batadv_tp_vars *tp_vars)
 			tp_vars->last_recv += to_ack;
 
 		list_del(&un->list);
-		kfree(un);
+		kmem_cache_free(batadv_tp_unacked_cache, un);
 	}
 	spin_unlock_bh(&tp_vars->unacked_lock);
 }
@@ -1363,6 +1773,7 @@ batadv_tp_init_recv(struct batadv_priv *bat_priv,
 
 	ether_addr_copy(tp_vars->other_end, icmp->orig);
 	tp_vars->role = BATADV_TP_RECEIVER;
+	tp_vars->group = NULL;
 	memcpy(tp_vars->session, icmp->session, sizeof(tp_vars->session));
 	tp_vars->last_recv = BATADV_TP_FIRST_SEQ;
 	tp_vars->bat_priv = bat_priv;
@@ -1395,9 +1806,11 @@ out_unlock:
 static void batadv_tp_recv_msg(struct batadv_priv *bat_priv,
 			       const struct sk_buff *skb)
 {
+	struct batadv_tp_sack sack[BATADV_TP_SACK_BLOCKS];
 	const struct batadv_icmp_tp_packet *icmp;
 	struct batadv_tp_vars *tp_vars;
 	size_t packet_size;
+	u8 num_sack;
 	u32 seqno;
 
 	icmp = (struct batadv_icmp_tp_packet *)skb->data;
@@ -1461,10 +1874,14 @@ static void batadv_tp_recv_msg(struct batadv_priv *bat_priv,
 send_ack:
 	/* send the ACK. If the received packet was out of order, the ACK that
 	 * is going to be sent is a duplicate (the sender will count them and
-	 * possibly enter Fast Retransmit as soon as it has reached 3)
+	 * possibly enter Fast Retransmit as soon as it has reached 3). The
+	 * data received after the gaps is reported as well so that the sender
+	 * only retransmits what is missing
 	 */
+	num_sack = batadv_tp_get_sack(tp_vars, sack);
 	batadv_tp_send_ack(bat_priv, icmp->orig, tp_vars->last_recv,
-			   icmp->timestamp, icmp->session, icmp->uid);
+			   icmp->timestamp, icmp->session, icmp->uid,
+			   sack, num_sack);
 out:
 	if (likely(tp_vars))
 		batadv_tp_vars_put(tp_vars);
@@ -1497,9 +1914,39 @@ void batadv_tp_meter_recv(struct batadv_priv *bat_priv, struct sk_buff *skb)
 }
 
 /**
- * batadv_tp_meter_init() - initialize global tp_meter structures
+ * batadv_tp_cache_init() - Initialize tp_meter unacked memory object cache
+ *
+ * Return: 0 on success or negative error number in case of failure.
+ */
+int __init batadv_tp_cache_init(void)
+{
+	size_t size = sizeof(struct batadv_tp_unacked);
+
+	batadv_tp_unacked_cache =
+		kmem_cache_create("batadv_tp_unacked_cache", size, 0,
+				  SLAB_HWCACHE_ALIGN, NULL);
+	if (!batadv_tp_unacked_cache)
+		return -ENOMEM;
+
+	batadv_tp_prerandom = alloc_pages(GFP_KERNEL | __GFP_COMP,
+					  BATADV_TP_PRERANDOM_ORDER);
+	if (!batadv_tp_prerandom) {
+		kmem_cache_destroy(batadv_tp_unacked_cache);
+		return -ENOMEM;
+	}
+
+	get_random_bytes(page_address(batadv_tp_prerandom),
+			 BATADV_TP_PRERANDOM_LEN);
+
+	return 0;
+}
+
+/**
+ * batadv_tp_cache_destroy() - Destroy tp_meter unacked memory object cache
  */
-void __init batadv_tp_meter_init(void)
+void batadv_tp_cache_destroy(void)
 {
-	get_random_bytes(batadv_tp_prerandom, sizeof(batadv_tp_prerandom));
+	/* messages which are still queued keep their own page reference */
+	__free_pages(batadv_tp_prerandom, BATADV_TP_PRERANDOM_ORDER);
+	kmem_cache_destroy(batadv_tp_unacked_cache);
 }
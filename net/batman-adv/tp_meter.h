@@ -25,9 +25,11 @@
 
 struct sk_buff;
 
-void batadv_tp_meter_init(void);
+int batadv_tp_cache_init(void);
+void batadv_tp_cache_destroy(void);
 void batadv_tp_start(struct batadv_priv *bat_priv, const u8 *dst,
-		     u32 test_length, u32 *cookie);
+		     u32 test_length, u8 streams, u16 packet_len,
+		     bool latency, u32 *cookie);
 void batadv_tp_stop(struct batadv_priv *bat_priv, const u8 *dst,
 		    u8 return_value);
 void batadv_tp_meter_recv(struct batadv_priv *bat_priv, struct sk_buff *skb);
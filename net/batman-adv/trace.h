@@ -0,0 +1,190 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright (C) 2018  B.A.T.M.A.N. contributors:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined(_NET_BATMAN_ADV_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _NET_BATMAN_ADV_TRACE_H_
+
+#include "main.h"
+
+#include <linux/if_ether.h>
+#include <linux/ktime.h>
+#include <linux/netdevice.h>
+#include <linux/string.h>
+#include <linux/tracepoint.h>
+#include <linux/types.h>
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM batadv
+
+#ifndef TRACE_HEADER_MULTI_READ
+
+/**
+ * batadv_trace_clock() - get the time base of the batman-adv tracepoints
+ *
+ * Return: monotonic time in nanoseconds
+ */
+static inline u64 batadv_trace_clock(void)
+{
+	return ktime_to_ns(ktime_get());
+}
+
+#endif /* TRACE_HEADER_MULTI_READ */
+
+/* provide dummy functions when tracing is disabled */
+#if !defined(CONFIG_BATMAN_ADV_TRACING)
+
+#undef DECLARE_EVENT_CLASS
+#define DECLARE_EVENT_CLASS(name, proto, ...)
+
+#undef DEFINE_EVENT
+#define DEFINE_EVENT(template, name, proto, ...) \
+	static inline void trace_ ## name(proto) {} \
+	static inline bool trace_ ## name ## _enabled(void) { return false; }
+
+#endif /* CONFIG_BATMAN_ADV_TRACING */
+
+/* The events below are emitted when leaving a hot path function. They carry
+ * the time spent in the function, which can be turned into a histogram in the
+ * kernel using hist triggers, e.g.:
+ *
+ *   echo 'hist:keys=device,duration.log2' > \
+ *     /sys/kernel/debug/tracing/events/batadv/batadv_skb_recv/trigger
+ *
+ * The start time is only taken when the event is enabled. A duration of 0 is
+ * reported when the event got enabled while the function was running.
+ */
+
+DECLARE_EVENT_CLASS(batadv_skb_timing,
+
+	TP_PROTO(const struct net_device *dev, unsigned int len, u64 start),
+
+	TP_ARGS(dev, len, start),
+
+	TP_STRUCT__entry(
+		__string(device, dev->name)
+		__field(unsigned int, len)
+		__field(u64, duration)
+	),
+
+	TP_fast_assign(
+		__assign_str(device, dev->name);
+		__entry->len = len;
+		__entry->duration = start ? batadv_trace_clock() - start : 0;
+	),
+
+	TP_printk("%s: len=%u duration=%lluns",
+		  __get_str(device), __entry->len,
+		  (unsigned long long)__entry->duration)
+);
+
+DEFINE_EVENT(batadv_skb_timing, batadv_skb_recv,
+	TP_PROTO(const struct net_device *dev, unsigned int len, u64 start),
+	TP_ARGS(dev, len, start)
+);
+
+DEFINE_EVENT(batadv_skb_timing, batadv_route_unicast,
+	TP_PROTO(const struct net_device *dev, unsigned int len, u64 start),
+	TP_ARGS(dev, len, start)
+);
+
+DEFINE_EVENT(batadv_skb_timing, batadv_interface_tx,
+	TP_PROTO(const struct net_device *dev, unsigned int len, u64 start),
+	TP_ARGS(dev, len, start)
+);
+
+DEFINE_EVENT(batadv_skb_timing, batadv_send_skb,
+	TP_PROTO(const struct net_device *dev, unsigned int len, u64 start),
+	TP_ARGS(dev, len, start)
+);
+
+DECLARE_EVENT_CLASS(batadv_ogm_timing,
+
+	TP_PROTO(const struct net_device *dev, const u8 *orig, u64 start),
+
+	TP_ARGS(dev, orig, start),
+
+	TP_STRUCT__entry(
+		__string(device, dev->name)
+		__array(u8, orig, ETH_ALEN)
+		__field(u64, duration)
+	),
+
+	TP_fast_assign(
+		__assign_str(device, dev->name);
+		memcpy(__entry->orig, orig, ETH_ALEN);
+		__entry->duration = start ? batadv_trace_clock() - start : 0;
+	),
+
+	TP_printk("%s: orig=%pM duration=%lluns",
+		  __get_str(device), __entry->orig,
+		  (unsigned long long)__entry->duration)
+);
+
+DEFINE_EVENT(batadv_ogm_timing, batadv_iv_ogm_process,
+	TP_PROTO(const struct net_device *dev, const u8 *orig, u64 start),
+	TP_ARGS(dev, orig, start)
+);
+
+DEFINE_EVENT(batadv_ogm_timing, batadv_v_ogm_process,
+	TP_PROTO(const struct net_device *dev, const u8 *orig, u64 start),
+	TP_ARGS(dev, orig, start)
+);
+
+DECLARE_EVENT_CLASS(batadv_purge_timing,
+
+	TP_PROTO(const struct net_device *soft_iface, u64 start),
+
+	TP_ARGS(soft_iface, start),
+
+	TP_STRUCT__entry(
+		__string(device, soft_iface->name)
+		__field(u64, duration)
+	),
+
+	TP_fast_assign(
+		__assign_str(device, soft_iface->name);
+		__entry->duration = start ? batadv_trace_clock() - start : 0;
+	),
+
+	TP_printk("%s: duration=%lluns",
+		  __get_str(device), (unsigned long long)__entry->duration)
+);
+
+DEFINE_EVENT(batadv_purge_timing, batadv_purge_orig,
+	TP_PROTO(const struct net_device *soft_iface, u64 start),
+	TP_ARGS(soft_iface, start)
+);
+
+DEFINE_EVENT(batadv_purge_timing, batadv_purge_tt,
+	TP_PROTO(const struct net_device *soft_iface, u64 start),
+	TP_ARGS(soft_iface, start)
+);
+
+DEFINE_EVENT(batadv_purge_timing, batadv_purge_dat,
+	TP_PROTO(const struct net_device *soft_iface, u64 start),
+	TP_ARGS(soft_iface, start)
+);
+
+#endif /* _NET_BATMAN_ADV_TRACE_H_ || TRACE_HEADER_MULTI_READ */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE trace
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
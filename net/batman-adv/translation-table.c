@@ -21,6 +21,8 @@
 
 #include <linux/atomic.h>
 #include <linux/bitops.h>
+#include <linux/bottom_half.h>
+#include <linux/bug.h>
 #include <linux/build_bug.h>
 #include <linux/byteorder/generic.h>
 #include <linux/cache.h>
@@ -29,6 +31,8 @@
 #include <linux/errno.h>
 #include <linux/etherdevice.h>
 #include <linux/gfp.h>
+#include <linux/hash.h>
+#include <linux/hashtable.h>
 #include <linux/if_ether.h>
 #include <linux/init.h>
 #include <linux/jhash.h>
@@ -37,11 +41,14 @@
 #include <linux/kref.h>
 #include <linux/list.h>
 #include <linux/lockdep.h>
+#include <linux/log2.h>
 #include <linux/net.h>
 #include <linux/netdevice.h>
 #include <linux/netlink.h>
+#include <linux/percpu.h>
 #include <linux/rculist.h>
 #include <linux/rcupdate.h>
+#include <linux/sched.h>
 #include <linux/seq_file.h>
 #include <linux/skbuff.h>
 #include <linux/slab.h>
@@ -61,7 +68,9 @@
 #include "log.h"
 #include "netlink.h"
 #include "originator.h"
+#include "routing.h"
 #include "soft-interface.h"
+#include "trace.h"
 #include "tvlv.h"
 
 static struct kmem_cache *batadv_tl_cache __read_mostly;
@@ -71,6 +80,34 @@ static struct kmem_cache *batadv_tt_change_cache __read_mostly;
 static struct kmem_cache *batadv_tt_req_cache __read_mostly;
 static struct kmem_cache *batadv_tt_roam_cache __read_mostly;
 
+#ifdef CONFIG_BATMAN_ADV_TT_COMPACT
+/* pack the table entries instead of aligning them to cache lines */
+#define BATADV_TT_SLAB_FLAGS 0
+
+/* locks protecting the orig_list of the global entries hashed to them */
+static spinlock_t batadv_tt_list_locks[1 << BATADV_TT_LIST_LOCK_BITS];
+#else
+#define BATADV_TT_SLAB_FLAGS SLAB_HWCACHE_ALIGN
+#endif
+
+/**
+ * batadv_tt_global_list_lock() - get the lock protecting the orig_list of a
+ *  global entry
+ * @tt_global: the global entry to get the lock for
+ *
+ * Return: the lock protecting &batadv_tt_global_entry.orig_list of @tt_global
+ */
+static spinlock_t *
+batadv_tt_global_list_lock(struct batadv_tt_global_entry *tt_global)
+{
+#ifdef CONFIG_BATMAN_ADV_TT_COMPACT
+	return &batadv_tt_list_locks[hash_ptr(tt_global,
+					      BATADV_TT_LIST_LOCK_BITS)];
+#else
+	return &tt_global->list_lock;
+#endif
+}
+
 /* hash class keys */
 static struct lock_class_key batadv_tt_local_hash_lock_class_key;
 static struct lock_class_key batadv_tt_global_hash_lock_class_key;
@@ -126,6 +163,140 @@ static inline u32 batadv_choose_tt(const void *data, u32 size)
 	return hash % size;
 }
 
+/**
+ * batadv_choose_tt_node() - Return the index of a tt entry in the hash table
+ * @node: hash_entry of the tt_common_entry
+ * @size: the size of the hash table
+ *
+ * Return: the hash index where the tt entry should be stored at
+ */
+static u32 batadv_choose_tt_node(const struct hlist_node *node, u32 size)
+{
+	const struct batadv_tt_common_entry *tt;
+
+	tt = container_of(node, struct batadv_tt_common_entry, hash_entry);
+
+	return batadv_choose_tt(tt, size);
+}
+
+/**
+ * batadv_tt_bloom_new() - allocate an empty TT bloom filter
+ *
+ * Return: the new bloom filter or NULL on allocation failure
+ */
+static struct batadv_tt_bloom *batadv_tt_bloom_new(void)
+{
+	struct batadv_tt_bloom *bloom;
+
+	bloom = kzalloc(sizeof(*bloom), GFP_ATOMIC);
+	if (!bloom)
+		return NULL;
+
+	spin_lock_init(&bloom->lock);
+
+	return bloom;
+}
+
+/**
+ * batadv_tt_bloom_index() - compute the bloom filter counters of a client
+ * @addr: the mac address of the client
+ * @vid: VLAN identifier
+ * @index: array receiving the two counter indices
+ */
+static void batadv_tt_bloom_index(const u8 *addr, unsigned short vid,
+				  u32 index[2])
+{
+	u32 hash = 0;
+
+	hash = jhash(addr, ETH_ALEN, hash);
+	hash = jhash(&vid, sizeof(vid), hash);
+
+	index[0] = hash & (BATADV_TT_BLOOM_SIZE - 1);
+	index[1] = hash_32(hash, ilog2(BATADV_TT_BLOOM_SIZE));
+}
+
+/**
+ * batadv_tt_bloom_add() - add a client to a TT bloom filter
+ * @bloom: the bloom filter (may be NULL)
+ * @tt: the client which is going to be added to the hash
+ *
+ * Has to be called before the client becomes visible in the hash.
+ */
+static void batadv_tt_bloom_add(struct batadv_tt_bloom *bloom,
+				const struct batadv_tt_common_entry *tt)
+{
+	u32 index[2];
+	int i;
+
+	if (!bloom)
+		return;
+
+	batadv_tt_bloom_index(tt->addr, tt->vid, index);
+
+	spin_lock_bh(&bloom->lock);
+	for (i = 0; i < ARRAY_SIZE(index); i++) {
+		if (bloom->counters[index[i]] == U8_MAX)
+			continue;
+
+		WRITE_ONCE(bloom->counters[index[i]],
+			   bloom->counters[index[i]] + 1);
+	}
+	spin_unlock_bh(&bloom->lock);
+}
+
+/**
+ * batadv_tt_bloom_del() - remove a client from a TT bloom filter
+ * @bloom: the bloom filter (may be NULL)
+ * @tt: the client which was removed from the hash
+ */
+static void batadv_tt_bloom_del(struct batadv_tt_bloom *bloom,
+				const struct batadv_tt_common_entry *tt)
+{
+	u32 index[2];
+	int i;
+
+	if (!bloom)
+		return;
+
+	batadv_tt_bloom_index(tt->addr, tt->vid, index);
+
+	spin_lock_bh(&bloom->lock);
+	for (i = 0; i < ARRAY_SIZE(index); i++) {
+		/* the real number of clients is unknown after saturation */
+		if (bloom->counters[index[i]] == U8_MAX)
+			continue;
+
+		if (WARN_ON(!bloom->counters[index[i]]))
+			continue;
+
+		WRITE_ONCE(bloom->counters[index[i]],
+			   bloom->counters[index[i]] - 1);
+	}
+	spin_unlock_bh(&bloom->lock);
+}
+
+/**
+ * batadv_tt_bloom_check() - check whether a client may be in a TT hash
+ * @bloom: the bloom filter (may be NULL)
+ * @addr: the mac address of the client to look for
+ * @vid: VLAN identifier
+ *
+ * Return: false if the client is definitely not in the hash, true otherwise
+ */
+static bool batadv_tt_bloom_check(struct batadv_tt_bloom *bloom,
+				  const u8 *addr, unsigned short vid)
+{
+	u32 index[2];
+
+	if (!bloom)
+		return true;
+
+	batadv_tt_bloom_index(addr, vid, index);
+
+	return READ_ONCE(bloom->counters[index[0]]) &&
+	       READ_ONCE(bloom->counters[index[1]]);
+}
+
 /**
  * batadv_tt_hash_find() - look for a client in the given hash table
  * @hash: the hash table to search
@@ -141,7 +312,7 @@ batadv_tt_hash_find(struct batadv_hashtable *hash, const u8 *addr,
 {
 	struct hlist_head *head;
 	struct batadv_tt_common_entry to_search, *tt, *tt_tmp = NULL;
-	u32 index;
+	unsigned int seq;
 
 	if (!hash)
 		return NULL;
@@ -149,23 +320,25 @@ batadv_tt_hash_find(struct batadv_hashtable *hash, const u8 *addr,
 	ether_addr_copy(to_search.addr, addr);
 	to_search.vid = vid;
 
-	index = batadv_choose_tt(&to_search, hash->size);
-	head = &hash->table[index];
-
 	rcu_read_lock();
-	hlist_for_each_entry_rcu(tt, head, hash_entry) {
-		if (!batadv_compare_eth(tt, addr))
-			continue;
+	do {
+		seq = batadv_hash_read_begin(hash);
+		head = batadv_hash_head_rcu(hash, batadv_choose_tt, &to_search);
 
-		if (tt->vid != vid)
-			continue;
+		hlist_for_each_entry_rcu(tt, head, hash_entry) {
+			if (!batadv_compare_eth(tt, addr))
+				continue;
 
-		if (!kref_get_unless_zero(&tt->refcount))
-			continue;
+			if (tt->vid != vid)
+				continue;
 
-		tt_tmp = tt;
-		break;
-	}
+			if (!kref_get_unless_zero(&tt->refcount))
+				continue;
+
+			tt_tmp = tt;
+			break;
+		}
+	} while (!tt_tmp && batadv_hash_read_retry(hash, seq));
 	rcu_read_unlock();
 
 	return tt_tmp;
@@ -187,6 +360,9 @@ batadv_tt_local_hash_find(struct batadv_priv *bat_priv, const u8 *addr,
 	struct batadv_tt_common_entry *tt_common_entry;
 	struct batadv_tt_local_entry *tt_local_entry = NULL;
 
+	if (!batadv_tt_bloom_check(bat_priv->tt.local_bloom, addr, vid))
+		return NULL;
+
 	tt_common_entry = batadv_tt_hash_find(bat_priv->tt.local_hash, addr,
 					      vid);
 	if (tt_common_entry)
@@ -205,13 +381,16 @@ batadv_tt_local_hash_find(struct batadv_priv *bat_priv, const u8 *addr,
  * Return: a pointer to the corresponding tt_global_entry struct if the client
  * is found, NULL otherwise.
  */
-static struct batadv_tt_global_entry *
+struct batadv_tt_global_entry *
 batadv_tt_global_hash_find(struct batadv_priv *bat_priv, const u8 *addr,
 			   unsigned short vid)
 {
 	struct batadv_tt_common_entry *tt_common_entry;
 	struct batadv_tt_global_entry *tt_global_entry = NULL;
 
+	if (!batadv_tt_bloom_check(bat_priv->tt.global_bloom, addr, vid))
+		return NULL;
+
 	tt_common_entry = batadv_tt_hash_find(bat_priv->tt.global_hash, addr,
 					      vid);
 	if (tt_common_entry)
@@ -300,8 +479,7 @@ static void batadv_tt_global_entry_release(struct kref *ref)
  *  possibly release it
  * @tt_global_entry: tt_global_entry to be free'd
  */
-static void
-batadv_tt_global_entry_put(struct batadv_tt_global_entry *tt_global_entry)
+void batadv_tt_global_entry_put(struct batadv_tt_global_entry *tt_global_entry)
 {
 	kref_put(&tt_global_entry->common.refcount,
 		 batadv_tt_global_entry_release);
@@ -389,6 +567,8 @@ static void batadv_tt_global_size_mod(struct batadv_orig_node *orig_node,
 {
 	struct batadv_orig_node_vlan *vlan;
 
+	atomic_add(v, &orig_node->tt_global_num);
+
 	vlan = batadv_orig_node_vlan_new(orig_node, vid);
 	if (!vlan)
 		return;
@@ -397,6 +577,7 @@ static void batadv_tt_global_size_mod(struct batadv_orig_node *orig_node,
 		spin_lock_bh(&orig_node->vlan_list_lock);
 		if (!hlist_unhashed(&vlan->list)) {
 			hlist_del_init_rcu(&vlan->list);
+			hash_del_rcu(&vlan->hash_entry);
 			batadv_orig_node_vlan_put(vlan);
 		}
 		spin_unlock_bh(&orig_node->vlan_list_lock);
@@ -429,6 +610,150 @@ static void batadv_tt_global_size_dec(struct batadv_orig_node *orig_node,
 	batadv_tt_global_size_mod(orig_node, vid, -1);
 }
 
+/**
+ * batadv_tt_entry_crc() - calculates the checksum of a single TT entry
+ * @vid: VLAN identifier of the entry
+ * @flags: the flags of the entry that have to be kept in sync among nodes
+ * @addr: the mac address of the entry
+ *
+ * The checksum of a table is computed as follows: For each client the CRC32C
+ * of the MAC address and the VID is computed and then all the CRC32Cs of the
+ * various clients are xor'ed together.
+ *
+ * The idea behind is that CRC32C should be used as much as possible in order to
+ * produce a unique hash of the table, but since the order which is used to feed
+ * the CRC32C function affects the result and since every node in the network
+ * probably sorts the clients differently, the hash function cannot be directly
+ * computed over the entire table. Hence the CRC32C is used only on
+ * the single client entry, while all the results are then xor'ed together
+ * because the XOR operation can combine them all while trying to reduce the
+ * noise as much as possible.
+ *
+ * The XOR also allows to maintain the checksum of a table incrementally: the
+ * CRC32C of an entry is merged into the checksum of its VLAN when the entry
+ * starts to be part of the table and again (removing it) when it leaves the
+ * table or changes its flags.
+ *
+ * Return: the checksum of the entry.
+ */
+static u32 batadv_tt_entry_crc(unsigned short vid, u8 flags, const u8 *addr)
+{
+	__be16 tmp_vid;
+	u32 crc;
+
+	/* use network order to read the VID: this ensures that every node
+	 * reads the bytes in the same order.
+	 */
+	tmp_vid = htons(vid);
+	crc = crc32c(0, &tmp_vid, sizeof(tmp_vid));
+
+	/* compute the CRC on flags that have to be kept in sync among nodes */
+	crc = crc32c(crc, &flags, sizeof(flags));
+
+	return crc32c(crc, addr, ETH_ALEN);
+}
+
+/**
+ * batadv_tt_local_crc_sync() - update the contribution of a local entry to the
+ *  checksum of its VLAN
+ * @tt_local: the local entry which was added, removed or modified
+ *
+ * Has to be called after the entry was removed from the local hash or the
+ * flags relevant for the checksum were changed.
+ */
+static void batadv_tt_local_crc_sync(struct batadv_tt_local_entry *tt_local)
+{
+	struct batadv_tt_common_entry *common = &tt_local->common;
+	struct batadv_vlan_tt *vlan_tt = &tt_local->vlan->tt;
+	u32 crc = 0;
+	u8 flags;
+
+	/* not yet committed clients have not to be taken into account while
+	 * computing the CRC
+	 */
+	if (!(common->flags & BATADV_TT_CLIENT_NEW)) {
+		flags = common->flags & BATADV_TT_SYNC_MASK;
+		crc = batadv_tt_entry_crc(common->vid, flags, common->addr);
+	}
+
+	spin_lock_bh(&vlan_tt->crc_lock);
+	/* entries removed from the table are not part of the CRC anymore */
+	if (hlist_unhashed(&common->hash_entry))
+		crc = 0;
+
+	vlan_tt->crc_acc ^= tt_local->crc ^ crc;
+	tt_local->crc = crc;
+	spin_unlock_bh(&vlan_tt->crc_lock);
+}
+
+/**
+ * batadv_tt_global_crc_set() - update the contribution of a TT orig entry to
+ *  the checksum of the VLAN of its orig_node
+ * @orig_entry: the orig entry to update
+ * @vid: VLAN identifier of the global entry
+ * @crc: new checksum of the orig entry (0 when it is not part of the table)
+ *
+ * Caller must hold the list_lock of the global entry @orig_entry belongs to.
+ */
+static void
+batadv_tt_global_crc_set(struct batadv_tt_orig_list_entry *orig_entry,
+			 unsigned short vid, u32 crc)
+{
+	struct batadv_orig_node_vlan *vlan;
+
+	if (orig_entry->crc == crc)
+		return;
+
+	vlan = batadv_orig_node_vlan_get(orig_entry->orig_node, vid);
+	if (!vlan)
+		return;
+
+	spin_lock_bh(&vlan->tt.crc_lock);
+	vlan->tt.crc_acc ^= orig_entry->crc ^ crc;
+	spin_unlock_bh(&vlan->tt.crc_lock);
+
+	orig_entry->crc = crc;
+	batadv_orig_node_vlan_put(vlan);
+}
+
+/**
+ * batadv_tt_global_crc_sync() - update the contribution of a global entry to
+ *  the checksums of the VLANs of all originators announcing it
+ * @tt_global: the global entry which was added or modified
+ */
+static void
+batadv_tt_global_crc_sync(struct batadv_tt_global_entry *tt_global)
+{
+	struct batadv_tt_common_entry *common = &tt_global->common;
+	struct batadv_tt_orig_list_entry *orig_entry;
+	unsigned short vid = common->vid;
+	bool skip;
+	u32 crc;
+
+	/* Roaming clients are in the global table for consistency only. They
+	 * don't have to be taken into account while computing the global crc.
+	 * Temporary clients have not been announced yet, so they have to be
+	 * skipped as well
+	 */
+	skip = common->flags & (BATADV_TT_CLIENT_ROAM | BATADV_TT_CLIENT_TEMP);
+
+	spin_lock_bh(batadv_tt_global_list_lock(tt_global));
+
+	/* entries removed from the table are not part of the CRC anymore */
+	if (hlist_unhashed(&common->hash_entry))
+		skip = true;
+
+	hlist_for_each_entry(orig_entry, &tt_global->orig_list, list) {
+		crc = 0;
+		if (!skip)
+			crc = batadv_tt_entry_crc(vid, orig_entry->flags,
+						  common->addr);
+
+		batadv_tt_global_crc_set(orig_entry, vid, crc);
+	}
+	spin_unlock_bh(batadv_tt_global_list_lock(tt_global));
+}
+
 /**
  * batadv_tt_orig_list_entry_free_rcu() - free the orig_entry
  * @rcu: rcu pointer of the orig_entry
@@ -455,6 +780,13 @@ static void batadv_tt_orig_list_entry_release(struct kref *ref)
 				  refcount);
 
 	batadv_orig_node_put(orig_entry->orig_node);
+
+#ifdef CONFIG_BATMAN_ADV_TT_COMPACT
+	/* the embedded entry is freed together with its global entry */
+	if (orig_entry->embedded)
+		return;
+#endif
+
 	call_rcu(&orig_entry->rcu, batadv_tt_orig_list_entry_free_rcu);
 }
 
@@ -469,41 +801,125 @@ batadv_tt_orig_list_entry_put(struct batadv_tt_orig_list_entry *orig_entry)
 	kref_put(&orig_entry->refcount, batadv_tt_orig_list_entry_release);
 }
 
+/**
+ * batadv_tt_orig_list_entry_alloc() - allocate an orig entry for a global entry
+ * @tt_global: the global entry the orig entry is going to be added to
+ *
+ * In compact mode the first originator of a global entry is stored in
+ * &batadv_tt_global_entry.orig_inline instead of a separate allocation. This
+ * slot is used only once and lives as long as the global entry itself.
+ *
+ * Return: a zeroed orig entry or NULL on allocation failure
+ */
+static struct batadv_tt_orig_list_entry *
+batadv_tt_orig_list_entry_alloc(struct batadv_tt_global_entry *tt_global)
+{
+#ifdef CONFIG_BATMAN_ADV_TT_COMPACT
+	struct batadv_tt_orig_list_entry *orig_entry = &tt_global->orig_inline;
+	spinlock_t *list_lock = batadv_tt_global_list_lock(tt_global);
+	bool claimed = false;
+
+	spin_lock_bh(list_lock);
+	if (!orig_entry->embedded) {
+		orig_entry->embedded = true;
+		claimed = true;
+	}
+	spin_unlock_bh(list_lock);
+
+	if (claimed)
+		return orig_entry;
+#endif
+
+	return kmem_cache_zalloc(batadv_tt_orig_cache, GFP_ATOMIC);
+}
+
+/**
+ * batadv_tt_change_key() - compute the changes_hash key of a client
+ * @addr: the mac address of the client
+ * @vid: VLAN identifier of the client
+ *
+ * Return: the key of the client in &batadv_priv_tt.changes_hash
+ */
+static u32 batadv_tt_change_key(const u8 *addr, unsigned short vid)
+{
+	return jhash(addr, ETH_ALEN, vid);
+}
+
+/**
+ * batadv_tt_change_find() - find the pending change of a client
+ * @bat_priv: the bat priv with all the soft interface information
+ * @addr: the mac address of the client
+ * @vid: VLAN identifier of the client
+ *
+ * Caller must hold &batadv_priv_tt.changes_list_lock.
+ *
+ * Return: the change queued for the client in the current originator interval
+ *  or NULL if there is none
+ */
+static struct batadv_tt_change_node *
+batadv_tt_change_find(struct batadv_priv *bat_priv, const u8 *addr,
+		      unsigned short vid)
+{
+	struct batadv_tt_change_node *entry;
+	u32 key = batadv_tt_change_key(addr, vid);
+
+	lockdep_assert_held(&bat_priv->tt.changes_list_lock);
+
+	hash_for_each_possible(bat_priv->tt.changes_hash, entry, hash_entry,
+			       key) {
+		if (!batadv_compare_eth(entry->change.addr, addr))
+			continue;
+
+		if (ntohs(entry->change.vid) != vid)
+			continue;
+
+		return entry;
+	}
+
+	return NULL;
+}
+
+/**
+ * batadv_tt_change_del() - remove a change from the changes list and free it
+ * @entry: the change to remove
+ *
+ * Caller must hold &batadv_priv_tt.changes_list_lock.
+ */
+static void batadv_tt_change_del(struct batadv_tt_change_node *entry)
+{
+	hash_del(&entry->hash_entry);
+	list_del(&entry->list);
+	kmem_cache_free(batadv_tt_change_cache, entry);
+}
+
 /**
  * batadv_tt_local_event() - store a local TT event (ADD/DEL)
  * @bat_priv: the bat priv with all the soft interface information
  * @tt_local_entry: the TT entry involved in the event
  * @event_flags: flags to store in the event structure
+ *
+ * At most one change per client is kept for each originator interval: the
+ * events of a client are coalesced with the one already queued for it.
  */
 static void batadv_tt_local_event(struct batadv_priv *bat_priv,
 				  struct batadv_tt_local_entry *tt_local_entry,
 				  u8 event_flags)
 {
-	struct batadv_tt_change_node *tt_change_node, *entry, *safe;
+	struct batadv_tt_change_node *tt_change_node, *entry;
 	struct batadv_tt_common_entry *common = &tt_local_entry->common;
 	u8 flags = common->flags | event_flags;
 	bool event_removed = false;
+	bool event_added = false;
 	bool del_op_requested, del_op_entry;
-
-	tt_change_node = kmem_cache_alloc(batadv_tt_change_cache, GFP_ATOMIC);
-	if (!tt_change_node)
-		return;
-
-	tt_change_node->change.flags = flags;
-	memset(tt_change_node->change.reserved, 0,
-	       sizeof(tt_change_node->change.reserved));
-	ether_addr_copy(tt_change_node->change.addr, common->addr);
-	tt_change_node->change.vid = htons(common->vid);
+	u32 key;
 
 	del_op_requested = flags & BATADV_TT_CLIENT_DEL;
 
-	/* check for ADD+DEL or DEL+ADD events */
 	spin_lock_bh(&bat_priv->tt.changes_list_lock);
-	list_for_each_entry_safe(entry, safe, &bat_priv->tt.changes_list,
-				 list) {
-		if (!batadv_compare_eth(entry->change.addr, common->addr))
-			continue;
 
+	/* check for ADD+DEL or DEL+ADD events */
+	entry = batadv_tt_change_find(bat_priv, common->addr, common->vid);
+	if (entry) {
 		/* DEL+ADD in the same orig interval have no effect and can be
 		 * removed to avoid silly behaviour on the receiver side. The
 		 * other way around (ADD+DEL) can happen in case of roaming of
@@ -512,36 +928,49 @@ static void batadv_tt_local_event(struct batadv_priv *bat_priv,
 		 * clients
 		 */
 		del_op_entry = entry->change.flags & BATADV_TT_CLIENT_DEL;
-		if (!del_op_requested && del_op_entry)
-			goto del;
-		if (del_op_requested && !del_op_entry)
-			goto del;
+		if (del_op_requested != del_op_entry) {
+			batadv_tt_change_del(entry);
+			event_removed = true;
+			goto unlock;
+		}
 
-		/* this is a second add in the same originator interval. It
-		 * means that flags have been changed: update them!
+		/* this is a second add (or del) in the same originator
+		 * interval. It means that flags have been changed: update them!
 		 */
-		if (!del_op_requested && !del_op_entry)
-			entry->change.flags = flags;
-
-		continue;
-del:
-		list_del(&entry->list);
-		kmem_cache_free(batadv_tt_change_cache, entry);
-		kmem_cache_free(batadv_tt_change_cache, tt_change_node);
-		event_removed = true;
+		entry->change.flags = flags;
 		goto unlock;
 	}
 
+	tt_change_node = kmem_cache_alloc(batadv_tt_change_cache, GFP_ATOMIC);
+	if (!tt_change_node)
+		goto unlock;
+
+	tt_change_node->change.flags = flags;
+	memset(tt_change_node->change.reserved, 0,
+	       sizeof(tt_change_node->change.reserved));
+	ether_addr_copy(tt_change_node->change.addr, common->addr);
+	tt_change_node->change.vid = htons(common->vid);
+
 	/* track the change in the OGMinterval list */
+	key = batadv_tt_change_key(common->addr, common->vid);
+	hash_add(bat_priv->tt.changes_hash, &tt_change_node->hash_entry, key);
 	list_add_tail(&tt_change_node->list, &bat_priv->tt.changes_list);
+	event_added = true;
 
 unlock:
 	spin_unlock_bh(&bat_priv->tt.changes_list_lock);
 
-	if (event_removed)
+	if (event_removed) {
 		atomic_dec(&bat_priv->tt.local_changes);
-	else
+	} else if (event_added) {
 		atomic_inc(&bat_priv->tt.local_changes);
+		batadv_ogm_rearm(bat_priv);
+	}
+
+	batadv_netlink_notify_tt(bat_priv,
+				 del_op_requested ? BATADV_EVENT_TT_LOCAL_DEL :
+						    BATADV_EVENT_TT_LOCAL_ADD,
+				 common->addr, common->vid, flags, NULL);
 }
 
 /**
@@ -601,7 +1030,7 @@ static int batadv_tt_local_init(struct batadv_priv *bat_priv)
 	if (bat_priv->tt.local_hash)
 		return 0;
 
-	bat_priv->tt.local_hash = batadv_hash_new(1024);
+	bat_priv->tt.local_hash = batadv_hash_new(128, batadv_choose_tt_node);
 
 	if (!bat_priv->tt.local_hash)
 		return -ENOMEM;
@@ -609,20 +1038,92 @@ static int batadv_tt_local_init(struct batadv_priv *bat_priv)
 	batadv_hash_set_lock_class(bat_priv->tt.local_hash,
 				   &batadv_tt_local_hash_lock_class_key);
 
+	bat_priv->tt.local_bloom = batadv_tt_bloom_new();
+	if (!bat_priv->tt.local_bloom)
+		return -ENOMEM;
+
 	return 0;
 }
 
-static void batadv_tt_global_free(struct batadv_priv *bat_priv,
-				  struct batadv_tt_global_entry *tt_global,
-				  const char *message)
+/**
+ * batadv_tt_tx_cache_invalidate() - invalidate all cached TT lookups
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * Has to be called whenever the result of batadv_transtable_search() may
+ * change without the client being looked up again, i.e. when an orig entry
+ * is added to or removed from a global entry, a global entry is removed or a
+ * route to an originator changes.
+ */
+void batadv_tt_tx_cache_invalidate(struct batadv_priv *bat_priv)
 {
-	batadv_dbg(BATADV_DBG_TT, bat_priv,
-		   "Deleting global tt entry %pM (vid: %d): %s\n",
-		   tt_global->common.addr,
-		   batadv_print_vid(tt_global->common.vid), message);
+	/* order the table change before the generation update */
+	smp_mb__before_atomic();
+	atomic_inc(&bat_priv->tt.tx_cache_gen);
+}
+
+/**
+ * batadv_tt_global_changed() - stamp a global entry with a new generation
+ * @bat_priv: the bat priv with all the soft interface information
+ * @tt_global: the global entry which was changed
+ *
+ * Has to be called after the flags or the orig list of a global entry were
+ * modified to make the entry show up in delta dumps.
+ */
+static void batadv_tt_global_changed(struct batadv_priv *bat_priv,
+				     struct batadv_tt_global_entry *tt_global)
+{
+	u32 gen = atomic_inc_return(&bat_priv->tt.global_gen);
+
+	WRITE_ONCE(tt_global->generation, gen);
+}
+
+/**
+ * batadv_tt_global_tombstone() - remember the removal of a global entry
+ * @bat_priv: the bat priv with all the soft interface information
+ * @common: tt common data of the removed global entry
+ *
+ * Delta dumps report the removal until the tombstone is overwritten by
+ * BATADV_TT_TOMBSTONES newer removals.
+ */
+static void batadv_tt_global_tombstone(struct batadv_priv *bat_priv,
+				       struct batadv_tt_common_entry *common)
+{
+	struct batadv_tt_tombstone *tombstone;
+	unsigned long index;
+
+	spin_lock_bh(&bat_priv->tt.tombstones_lock);
+	index = bat_priv->tt.tombstones_head++ % BATADV_TT_TOMBSTONES;
+	tombstone = &bat_priv->tt.tombstones[index];
 
-	batadv_hash_remove(bat_priv->tt.global_hash, batadv_compare_tt,
-			   batadv_choose_tt, &tt_global->common);
+	if (tombstone->generation)
+		bat_priv->tt.tombstones_lost = tombstone->generation;
+
+	ether_addr_copy(tombstone->addr, common->addr);
+	tombstone->vid = common->vid;
+	tombstone->generation = atomic_inc_return(&bat_priv->tt.global_gen);
+	spin_unlock_bh(&bat_priv->tt.tombstones_lock);
+
+	batadv_netlink_notify_tt(bat_priv, BATADV_EVENT_TT_GLOBAL_DEL,
+				 common->addr, common->vid, common->flags,
+				 NULL);
+}
+
+static void batadv_tt_global_free(struct batadv_priv *bat_priv,
+				  struct batadv_tt_global_entry *tt_global,
+				  const char *message)
+{
+	batadv_dbg(BATADV_DBG_TT, bat_priv,
+		   "Deleting global tt entry %pM (vid: %d): %s\n",
+		   tt_global->common.addr,
+		   batadv_print_vid(tt_global->common.vid), message);
+
+	if (batadv_hash_remove(bat_priv->tt.global_hash, batadv_compare_tt,
+			       batadv_choose_tt, &tt_global->common)) {
+		batadv_tt_bloom_del(bat_priv->tt.global_bloom,
+				    &tt_global->common);
+		batadv_tt_global_tombstone(bat_priv, &tt_global->common);
+	}
+	batadv_tt_tx_cache_invalidate(bat_priv);
 	batadv_tt_global_entry_put(tt_global);
 }
 
@@ -709,7 +1210,7 @@ bool batadv_tt_local_add(struct net_device *soft_iface, const u8 *addr,
 		goto out;
 	}
 
-	tt_local = kmem_cache_alloc(batadv_tl_cache, GFP_ATOMIC);
+	tt_local = batadv_cache_zalloc(bat_priv, batadv_tl_cache, GFP_ATOMIC);
 	if (!tt_local)
 		goto out;
 
@@ -736,6 +1237,7 @@ bool batadv_tt_local_add(struct net_device *soft_iface, const u8 *addr,
 	 */
 	tt_local->common.flags = BATADV_TT_CLIENT_NEW;
 	tt_local->common.vid = vid;
+	tt_local->crc = 0;
 	if (batadv_is_wifi_hardif(in_hardif))
 		tt_local->common.flags |= BATADV_TT_CLIENT_WIFI;
 	kref_init(&tt_local->common.refcount);
@@ -751,11 +1253,14 @@ bool batadv_tt_local_add(struct net_device *soft_iface, const u8 *addr,
 		tt_local->common.flags |= BATADV_TT_CLIENT_NOPURGE;
 
 	kref_get(&tt_local->common.refcount);
+	batadv_tt_bloom_add(bat_priv->tt.local_bloom, &tt_local->common);
 	hash_added = batadv_hash_add(bat_priv->tt.local_hash, batadv_compare_tt,
 				     batadv_choose_tt, &tt_local->common,
 				     &tt_local->common.hash_entry);
 
 	if (unlikely(hash_added != 0)) {
+		batadv_tt_bloom_del(bat_priv->tt.local_bloom,
+				    &tt_local->common);
 		/* remove the reference for the hash */
 		batadv_tt_local_entry_put(tt_local);
 		goto out;
@@ -779,6 +1284,7 @@ check_roaming:
 		}
 		rcu_read_unlock();
 		if (roamed_back) {
+			batadv_tt_global_del_orig_list(tt_global);
 			batadv_tt_global_free(bat_priv, tt_global,
 					      "Roaming canceled");
 			tt_global = NULL;
@@ -788,6 +1294,13 @@ check_roaming:
 			 */
 			tt_global->common.flags |= BATADV_TT_CLIENT_ROAM;
 			tt_global->roam_at = jiffies;
+			batadv_tt_global_crc_sync(tt_global);
+			batadv_tt_global_changed(bat_priv, tt_global);
+			batadv_netlink_notify_tt(bat_priv, BATADV_EVENT_TT_ROAM,
+						 tt_global->common.addr,
+						 tt_global->common.vid,
+						 tt_global->common.flags,
+						 NULL);
 		}
 	}
 
@@ -815,8 +1328,10 @@ check_roaming:
 	/* if any "dynamic" flag has been modified, resend an ADD event for this
 	 * entry so that all the nodes can get the new flags
 	 */
-	if (remote_flags ^ (tt_local->common.flags & BATADV_TT_REMOTE_MASK))
+	if (remote_flags ^ (tt_local->common.flags & BATADV_TT_REMOTE_MASK)) {
 		batadv_tt_local_event(bat_priv, tt_local, BATADV_NO_FLAGS);
+		batadv_tt_local_crc_sync(tt_local);
+	}
 
 	ret = true;
 out:
@@ -1032,8 +1547,7 @@ static void batadv_tt_tvlv_container_update(struct batadv_priv *bat_priv)
 			       sizeof(struct batadv_tvlv_tt_change));
 			tt_diff_entries_count++;
 		}
-		list_del(&entry->list);
-		kmem_cache_free(batadv_tt_change_cache, entry);
+		batadv_tt_change_del(entry);
 	}
 	spin_unlock_bh(&bat_priv->tt.changes_list_lock);
 
@@ -1098,10 +1612,9 @@ int batadv_tt_local_seq_print_text(struct seq_file *seq, void *offset)
 	seq_puts(seq,
 		 "       Client         VID Flags    Last seen (CRC       )\n");
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-
+	for (i = 0; i < batadv_hash_size(hash); i++) {
 		rcu_read_lock();
+		head = batadv_hash_bucket_rcu(hash, i);
 		hlist_for_each_entry_rcu(tt_common_entry,
 					 head, hash_entry) {
 			tt_local = container_of(tt_common_entry,
@@ -1203,7 +1716,8 @@ batadv_tt_local_dump_entry(struct sk_buff *msg, u32 portid, u32 seq,
  * @portid: Port making netlink request
  * @seq: Sequence number of netlink message
  * @bat_priv: The bat priv with all the soft interface information
- * @head: Pointer to the list containing the local tt entries
+ * @hash: Hash table to dump
+ * @bucket: Index of the bucket to be dumped
  * @idx_s: Number of entries to skip
  *
  * Return: Error code, or 0 on success
@@ -1211,12 +1725,15 @@ batadv_tt_local_dump_entry(struct sk_buff *msg, u32 portid, u32 seq,
 static int
 batadv_tt_local_dump_bucket(struct sk_buff *msg, u32 portid, u32 seq,
 			    struct batadv_priv *bat_priv,
-			    struct hlist_head *head, int *idx_s)
+			    struct batadv_hashtable *hash, u32 bucket,
+			    int *idx_s)
 {
 	struct batadv_tt_common_entry *common;
+	struct hlist_head *head;
 	int idx = 0;
 
 	rcu_read_lock();
+	head = batadv_hash_bucket_rcu(hash, bucket);
 	hlist_for_each_entry_rcu(common, head, hash_entry) {
 		if (idx++ < *idx_s)
 			continue;
@@ -1248,7 +1765,6 @@ int batadv_tt_local_dump(struct sk_buff *msg, struct netlink_callback *cb)
 	struct batadv_priv *bat_priv;
 	struct batadv_hard_iface *primary_if = NULL;
 	struct batadv_hashtable *hash;
-	struct hlist_head *head;
 	int ret;
 	int ifindex;
 	int bucket = cb->args[0];
@@ -1275,11 +1791,9 @@ int batadv_tt_local_dump(struct sk_buff *msg, struct netlink_callback *cb)
 
 	hash = bat_priv->tt.local_hash;
 
-	while (bucket < hash->size) {
-		head = &hash->table[bucket];
-
+	while (bucket < batadv_hash_size(hash)) {
 		if (batadv_tt_local_dump_bucket(msg, portid, cb->nlh->nlmsg_seq,
-						bat_priv, head, &idx))
+						bat_priv, hash, bucket, &idx))
 			break;
 
 		bucket++;
@@ -1370,6 +1884,9 @@ u16 batadv_tt_local_remove(struct batadv_priv *bat_priv, const u8 *addr,
 	if (!tt_entry_exists)
 		goto out;
 
+	batadv_tt_bloom_del(bat_priv->tt.local_bloom, &tt_local_entry->common);
+	batadv_tt_local_crc_sync(tt_local_entry);
+
 	/* extra call to free the local tt entry */
 	batadv_tt_local_entry_put(tt_local_entry);
 
@@ -1407,8 +1924,11 @@ static void batadv_tt_local_purge_list(struct batadv_priv *bat_priv,
 		if (tt_local_entry->common.flags & BATADV_TT_CLIENT_PENDING)
 			continue;
 
-		if (!batadv_has_timed_out(tt_local_entry->last_seen, timeout))
+		if (!batadv_has_timed_out(tt_local_entry->last_seen, timeout)) {
+			batadv_hash_age_note(bat_priv->tt.local_hash,
+					     tt_local_entry->last_seen);
 			continue;
+		}
 
 		batadv_tt_local_set_pending(bat_priv, tt_local_entry,
 					    BATADV_TT_CLIENT_DEL, "timed out");
@@ -1429,13 +1949,10 @@ static void batadv_tt_local_purge(struct batadv_priv *bat_priv,
 	spinlock_t *list_lock; /* protects write access to the hash lists */
 	u32 i;
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-		list_lock = &hash->list_locks[i];
-
-		spin_lock_bh(list_lock);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
+		head = batadv_hash_lock_bucket(hash, i, &list_lock);
 		batadv_tt_local_purge_list(bat_priv, head, timeout);
-		spin_unlock_bh(list_lock);
+		batadv_hash_unlock_bucket(hash, list_lock);
 	}
 }
 
@@ -1454,26 +1971,26 @@ static void batadv_tt_local_table_free(struct batadv_priv *bat_priv)
 
 	hash = bat_priv->tt.local_hash;
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-		list_lock = &hash->list_locks[i];
-
-		spin_lock_bh(list_lock);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
+		head = batadv_hash_lock_bucket(hash, i, &list_lock);
 		hlist_for_each_entry_safe(tt_common_entry, node_tmp,
 					  head, hash_entry) {
-			hlist_del_rcu(&tt_common_entry->hash_entry);
+			batadv_hash_del(hash, &tt_common_entry->hash_entry);
 			tt_local = container_of(tt_common_entry,
 						struct batadv_tt_local_entry,
 						common);
 
 			batadv_tt_local_entry_put(tt_local);
 		}
-		spin_unlock_bh(list_lock);
+		batadv_hash_unlock_bucket(hash, list_lock);
 	}
 
 	batadv_hash_destroy(hash);
 
 	bat_priv->tt.local_hash = NULL;
+
+	kfree(bat_priv->tt.local_bloom);
+	bat_priv->tt.local_bloom = NULL;
 }
 
 static int batadv_tt_global_init(struct batadv_priv *bat_priv)
@@ -1481,7 +1998,7 @@ static int batadv_tt_global_init(struct batadv_priv *bat_priv)
 	if (bat_priv->tt.global_hash)
 		return 0;
 
-	bat_priv->tt.global_hash = batadv_hash_new(1024);
+	bat_priv->tt.global_hash = batadv_hash_new(256, batadv_choose_tt_node);
 
 	if (!bat_priv->tt.global_hash)
 		return -ENOMEM;
@@ -1489,6 +2006,10 @@ static int batadv_tt_global_init(struct batadv_priv *bat_priv)
 	batadv_hash_set_lock_class(bat_priv->tt.global_hash,
 				   &batadv_tt_global_hash_lock_class_key);
 
+	bat_priv->tt.global_bloom = batadv_tt_bloom_new();
+	if (!bat_priv->tt.global_bloom)
+		return -ENOMEM;
+
 	return 0;
 }
 
@@ -1499,10 +2020,8 @@ static void batadv_tt_changes_list_free(struct batadv_priv *bat_priv)
 	spin_lock_bh(&bat_priv->tt.changes_list_lock);
 
 	list_for_each_entry_safe(entry, safe, &bat_priv->tt.changes_list,
-				 list) {
-		list_del(&entry->list);
-		kmem_cache_free(batadv_tt_change_cache, entry);
-	}
+				 list)
+		batadv_tt_change_del(entry);
 
 	atomic_set(&bat_priv->tt.local_changes, 0);
 	spin_unlock_bh(&bat_priv->tt.changes_list_lock);
@@ -1623,7 +2142,7 @@ batadv_tt_global_orig_entry_add(struct batadv_tt_global_entry *tt_global,
 		goto sync_flags;
 	}
 
-	orig_entry = kmem_cache_zalloc(batadv_tt_orig_cache, GFP_ATOMIC);
+	orig_entry = batadv_tt_orig_list_entry_alloc(tt_global);
 	if (!orig_entry)
 		goto out;
 
@@ -1635,12 +2154,13 @@ batadv_tt_global_orig_entry_add(struct batadv_tt_global_entry *tt_global,
 	orig_entry->flags = flags;
 	kref_init(&orig_entry->refcount);
 
-	spin_lock_bh(&tt_global->list_lock);
+	spin_lock_bh(batadv_tt_global_list_lock(tt_global));
 	kref_get(&orig_entry->refcount);
 	hlist_add_head_rcu(&orig_entry->list,
 			   &tt_global->orig_list);
-	spin_unlock_bh(&tt_global->list_lock);
+	spin_unlock_bh(batadv_tt_global_list_lock(tt_global));
 	atomic_inc(&tt_global->orig_list_count);
+	batadv_tt_tx_cache_invalidate(orig_node->bat_priv);
 
 sync_flags:
 	batadv_tt_global_sync_flags(tt_global);
@@ -1679,6 +2199,7 @@ static bool batadv_tt_global_add(struct batadv_priv *bat_priv,
 	int hash_added;
 	struct batadv_tt_common_entry *common;
 	u16 local_flags;
+	int max_entries;
 
 	/* ignore global entries from backbone nodes */
 	if (batadv_bla_is_backbone_gw_orig(bat_priv, orig_node->orig, vid))
@@ -1695,9 +2216,26 @@ static bool batadv_tt_global_add(struct batadv_priv *bat_priv,
 	    !(tt_local_entry->common.flags & BATADV_TT_CLIENT_NEW))
 		goto out;
 
+	/* a node announcing more clients than allowed only loses the ones
+	 * above its own limit. Its TT CRC can then never match, so it is
+	 * marked to keep its table from being requested over and over
+	 */
+	max_entries = atomic_read(&bat_priv->tt.global_max_entries);
+	if (max_entries > 0 &&
+	    atomic_read(&orig_node->tt_global_num) >= max_entries &&
+	    !(tt_global_entry &&
+	      batadv_tt_global_entry_has_orig(tt_global_entry, orig_node,
+					      NULL))) {
+		batadv_inc_counter(bat_priv, BATADV_CNT_TT_GLOBAL_LIMIT_DROP);
+		WRITE_ONCE(orig_node->tt_over_limit_at, jiffies);
+		WRITE_ONCE(orig_node->tt_over_limit, true);
+		goto out;
+	}
+
 	if (!tt_global_entry) {
-		tt_global_entry = kmem_cache_zalloc(batadv_tg_cache,
-						    GFP_ATOMIC);
+		tt_global_entry = batadv_cache_zalloc(bat_priv,
+						      batadv_tg_cache,
+						      GFP_ATOMIC);
 		if (!tt_global_entry)
 			goto out;
 
@@ -1720,15 +2258,19 @@ static bool batadv_tt_global_add(struct batadv_priv *bat_priv,
 
 		INIT_HLIST_HEAD(&tt_global_entry->orig_list);
 		atomic_set(&tt_global_entry->orig_list_count, 0);
+#ifndef CONFIG_BATMAN_ADV_TT_COMPACT
 		spin_lock_init(&tt_global_entry->list_lock);
+#endif
 
 		kref_get(&common->refcount);
+		batadv_tt_bloom_add(bat_priv->tt.global_bloom, common);
 		hash_added = batadv_hash_add(bat_priv->tt.global_hash,
 					     batadv_compare_tt,
 					     batadv_choose_tt, common,
 					     &common->hash_entry);
 
 		if (unlikely(hash_added != 0)) {
+			batadv_tt_bloom_del(bat_priv->tt.global_bloom, common);
 			/* remove the reference for the hash */
 			batadv_tt_global_entry_put(tt_global_entry);
 			goto out_remove;
@@ -1795,6 +2337,9 @@ add_orig_entry:
 		   "Creating new global tt entry: %pM (vid: %d, via %pM)\n",
 		   common->addr, batadv_print_vid(common->vid),
 		   orig_node->orig);
+	batadv_netlink_notify_tt(bat_priv, BATADV_EVENT_TT_GLOBAL_ADD,
+				 common->addr, common->vid, common->flags,
+				 orig_node->orig);
 	ret = true;
 
 out_remove:
@@ -1802,7 +2347,7 @@ out_remove:
 	 * global additions
 	 */
 	if (is_multicast_ether_addr(tt_addr))
-		goto out;
+		goto sync_crc;
 
 	/* remove address from local hash if present */
 	local_flags = batadv_tt_local_remove(bat_priv, tt_addr, vid,
@@ -1816,6 +2361,13 @@ out_remove:
 		 */
 		tt_global_entry->common.flags &= ~BATADV_TT_CLIENT_ROAM;
 
+sync_crc:
+	/* flags merged into an existing entry may let it expire by an old
+	 * timestamp
+	 */
+	batadv_tt_global_age_note(bat_priv, tt_global_entry);
+	batadv_tt_global_crc_sync(tt_global_entry);
+	batadv_tt_global_changed(bat_priv, tt_global_entry);
 out:
 	if (tt_global_entry)
 		batadv_tt_global_entry_put(tt_global_entry);
@@ -1982,10 +2534,9 @@ int batadv_tt_global_seq_print_text(struct seq_file *seq, void *offset)
 	seq_puts(seq,
 		 "       Client         VID  (TTVN)       Originator      (Curr TTVN) (CRC       ) Flags\n");
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-
+	for (i = 0; i < batadv_hash_size(hash); i++) {
 		rcu_read_lock();
+		head = batadv_hash_bucket_rcu(hash, i);
 		hlist_for_each_entry_rcu(tt_common_entry,
 					 head, hash_entry) {
 			tt_global = container_of(tt_common_entry,
@@ -2010,6 +2561,7 @@ out:
  * @common: tt local & tt global common data
  * @orig: Originator node announcing a non-mesh client
  * @best: Is the best originator for the TT entry
+ * @gen: Generation of the global table when the dump was started
  *
  * Return: Error code, or 0 on success
  */
@@ -2017,7 +2569,7 @@ static int
 batadv_tt_global_dump_subentry(struct sk_buff *msg, u32 portid, u32 seq,
 			       struct batadv_tt_common_entry *common,
 			       struct batadv_tt_orig_list_entry *orig,
-			       bool best)
+			       bool best, u32 gen)
 {
 	u16 flags = (common->flags & (~BATADV_TT_SYNC_MASK)) | orig->flags;
 	void *hdr;
@@ -2049,7 +2601,8 @@ batadv_tt_global_dump_subentry(struct sk_buff *msg, u32 portid, u32 seq,
 	    nla_put_u8(msg, BATADV_ATTR_TT_LAST_TTVN, last_ttvn) ||
 	    nla_put_u32(msg, BATADV_ATTR_TT_CRC32, crc) ||
 	    nla_put_u16(msg, BATADV_ATTR_TT_VID, common->vid) ||
-	    nla_put_u32(msg, BATADV_ATTR_TT_FLAGS, flags))
+	    nla_put_u32(msg, BATADV_ATTR_TT_FLAGS, flags) ||
+	    nla_put_u32(msg, BATADV_ATTR_TT_GENERATION, gen))
 		goto nla_put_failure;
 
 	if (best && nla_put_flag(msg, BATADV_ATTR_FLAG_BEST))
@@ -2071,6 +2624,8 @@ batadv_tt_global_dump_subentry(struct sk_buff *msg, u32 portid, u32 seq,
  * @bat_priv: The bat priv with all the soft interface information
  * @common: tt local & tt global common data
  * @sub_s: Number of entries to skip
+ * @since: Only dump the entry when it was changed after this generation
+ * @gen: Generation of the global table when the dump was started
  *
  * This function assumes the caller holds rcu_read_lock().
  *
@@ -2079,7 +2634,8 @@ batadv_tt_global_dump_subentry(struct sk_buff *msg, u32 portid, u32 seq,
 static int
 batadv_tt_global_dump_entry(struct sk_buff *msg, u32 portid, u32 seq,
 			    struct batadv_priv *bat_priv,
-			    struct batadv_tt_common_entry *common, int *sub_s)
+			    struct batadv_tt_common_entry *common, int *sub_s,
+			    u32 since, u32 gen)
 {
 	struct batadv_tt_orig_list_entry *orig_entry, *best_entry;
 	struct batadv_tt_global_entry *global;
@@ -2088,6 +2644,9 @@ batadv_tt_global_dump_entry(struct sk_buff *msg, u32 portid, u32 seq,
 	bool best;
 
 	global = container_of(common, struct batadv_tt_global_entry, common);
+	if (since && READ_ONCE(global->generation) <= since)
+		return 0;
+
 	best_entry = batadv_transtable_best_orig(bat_priv, global);
 	head = &global->orig_list;
 
@@ -2098,7 +2657,7 @@ batadv_tt_global_dump_entry(struct sk_buff *msg, u32 portid, u32 seq,
 		best = (orig_entry == best_entry);
 
 		if (batadv_tt_global_dump_subentry(msg, portid, seq, common,
-						   orig_entry, best)) {
+						   orig_entry, best, gen)) {
 			*sub_s = sub - 1;
 			return -EMSGSIZE;
 		}
@@ -2114,27 +2673,33 @@ batadv_tt_global_dump_entry(struct sk_buff *msg, u32 portid, u32 seq,
  * @portid: Port making netlink request
  * @seq: Sequence number of netlink message
  * @bat_priv: The bat priv with all the soft interface information
- * @head: Pointer to the list containing the global tt entries
+ * @hash: Hash table to dump
+ * @bucket: Index of the bucket to be dumped
  * @idx_s: Number of entries to skip
  * @sub: Number of entries to skip
+ * @since: Only dump entries which were changed after this generation
+ * @gen: Generation of the global table when the dump was started
  *
  * Return: Error code, or 0 on success
  */
 static int
 batadv_tt_global_dump_bucket(struct sk_buff *msg, u32 portid, u32 seq,
 			     struct batadv_priv *bat_priv,
-			     struct hlist_head *head, int *idx_s, int *sub)
+			     struct batadv_hashtable *hash, u32 bucket,
+			     int *idx_s, int *sub, u32 since, u32 gen)
 {
 	struct batadv_tt_common_entry *common;
+	struct hlist_head *head;
 	int idx = 0;
 
 	rcu_read_lock();
+	head = batadv_hash_bucket_rcu(hash, bucket);
 	hlist_for_each_entry_rcu(common, head, hash_entry) {
 		if (idx++ < *idx_s)
 			continue;
 
 		if (batadv_tt_global_dump_entry(msg, portid, seq, bat_priv,
-						common, sub)) {
+						common, sub, since, gen)) {
 			rcu_read_unlock();
 			*idx_s = idx - 1;
 			return -EMSGSIZE;
@@ -2147,11 +2712,106 @@ batadv_tt_global_dump_bucket(struct sk_buff *msg, u32 portid, u32 seq,
 	return 0;
 }
 
+/**
+ * batadv_tt_global_dump_tombstone() - Dump one removed TT global entry into a
+ *  message
+ * @msg: Netlink message to dump into
+ * @portid: Port making netlink request
+ * @seq: Sequence number of netlink message
+ * @tombstone: The removed entry
+ * @gen: Generation of the global table when the dump was started
+ *
+ * Return: Error code, or 0 on success
+ */
+static int
+batadv_tt_global_dump_tombstone(struct sk_buff *msg, u32 portid, u32 seq,
+				const struct batadv_tt_tombstone *tombstone,
+				u32 gen)
+{
+	void *hdr;
+
+	hdr = genlmsg_put(msg, portid, seq, &batadv_netlink_family,
+			  NLM_F_MULTI,
+			  BATADV_CMD_GET_TRANSTABLE_GLOBAL);
+	if (!hdr)
+		return -ENOBUFS;
+
+	if (nla_put(msg, BATADV_ATTR_TT_ADDRESS, ETH_ALEN, tombstone->addr) ||
+	    nla_put_u16(msg, BATADV_ATTR_TT_VID, tombstone->vid) ||
+	    nla_put_u32(msg, BATADV_ATTR_TT_GENERATION, gen) ||
+	    nla_put_flag(msg, BATADV_ATTR_TT_DELETED))
+		goto nla_put_failure;
+
+	genlmsg_end(msg, hdr);
+	return 0;
+
+ nla_put_failure:
+	genlmsg_cancel(msg, hdr);
+	return -EMSGSIZE;
+}
+
+/**
+ * batadv_tt_global_dump_tombstones() - Dump removed TT global entries into a
+ *  message
+ * @msg: Netlink message to dump into
+ * @portid: Port making netlink request
+ * @seq: Sequence number of netlink message
+ * @bat_priv: The bat priv with all the soft interface information
+ * @since: Only dump entries which were removed after this generation
+ * @gen: Generation of the global table when the dump was started
+ * @pos: Index of the next tombstone to dump
+ *
+ * Return: -ESTALE when removals after @since were already forgotten, other
+ *  error code when the message is full, or 0 on success
+ */
+static int
+batadv_tt_global_dump_tombstones(struct sk_buff *msg, u32 portid, u32 seq,
+				 struct batadv_priv *bat_priv, u32 since,
+				 u32 gen, unsigned long *pos)
+{
+	struct batadv_tt_tombstone *tombstone;
+	unsigned long head, index;
+	int ret = 0;
+
+	spin_lock_bh(&bat_priv->tt.tombstones_lock);
+
+	if (bat_priv->tt.tombstones_lost > since) {
+		ret = -ESTALE;
+		goto unlock;
+	}
+
+	head = bat_priv->tt.tombstones_head;
+	if (head - *pos > BATADV_TT_TOMBSTONES)
+		*pos = head - BATADV_TT_TOMBSTONES;
+
+	for (; *pos != head; (*pos)++) {
+		index = *pos % BATADV_TT_TOMBSTONES;
+		tombstone = &bat_priv->tt.tombstones[index];
+		if (tombstone->generation <= since)
+			continue;
+
+		ret = batadv_tt_global_dump_tombstone(msg, portid, seq,
+						      tombstone, gen);
+		if (ret)
+			break;
+	}
+
+unlock:
+	spin_unlock_bh(&bat_priv->tt.tombstones_lock);
+
+	return ret;
+}
+
 /**
  * batadv_tt_global_dump() -  Dump TT global entries into a message
  * @msg: Netlink message to dump into
  * @cb: Parameters from query
  *
+ * When the request carries BATADV_ATTR_TT_GENERATION, only the entries which
+ * were changed or removed since this generation are dumped. -ESTALE is
+ * returned when the removals since then are no longer known and a full dump
+ * is required.
+ *
  * Return: Error code, or length of message on success
  */
 int batadv_tt_global_dump(struct sk_buff *msg, struct netlink_callback *cb)
@@ -2161,18 +2821,27 @@ int batadv_tt_global_dump(struct sk_buff *msg, struct netlink_callback *cb)
 	struct batadv_priv *bat_priv;
 	struct batadv_hard_iface *primary_if = NULL;
 	struct batadv_hashtable *hash;
-	struct hlist_head *head;
+	struct nlattr *attr;
 	int ret;
 	int ifindex;
 	int bucket = cb->args[0];
 	int idx = cb->args[1];
 	int sub = cb->args[2];
+	u32 gen = cb->args[3];
+	unsigned long pos = cb->args[4];
+	int state = cb->args[5];
 	int portid = NETLINK_CB(cb->skb).portid;
+	int start = msg->len;
+	u32 since = 0;
 
 	ifindex = batadv_netlink_get_ifindex(cb->nlh, BATADV_ATTR_MESH_IFINDEX);
 	if (!ifindex)
 		return -EINVAL;
 
+	attr = nlmsg_find_attr(cb->nlh, GENL_HDRLEN, BATADV_ATTR_TT_GENERATION);
+	if (attr)
+		since = nla_get_u32(attr);
+
 	soft_iface = dev_get_by_index(net, ifindex);
 	if (!soft_iface || !batadv_softif_is_valid(soft_iface)) {
 		ret = -ENODEV;
@@ -2188,18 +2857,38 @@ int batadv_tt_global_dump(struct sk_buff *msg, struct netlink_callback *cb)
 	}
 
 	hash = bat_priv->tt.global_hash;
+	cb->seq = batadv_hash_generation(hash) << 1 | 1;
+
+	/* state 0: dump not started, 1: dumping removals, 2: dumping entries */
+	if (state == 0) {
+		gen = atomic_read(&bat_priv->tt.global_gen);
+		state = attr ? 1 : 2;
+	}
 
-	while (bucket < hash->size) {
-		head = &hash->table[bucket];
+	if (state == 1) {
+		ret = batadv_tt_global_dump_tombstones(msg, portid,
+						       cb->nlh->nlmsg_seq,
+						       bat_priv, since, gen,
+						       &pos);
+		if (ret == -ESTALE)
+			goto out;
+
+		if (ret == 0)
+			state = 2;
+	}
 
+	while (state == 2 && bucket < batadv_hash_size(hash)) {
 		if (batadv_tt_global_dump_bucket(msg, portid,
 						 cb->nlh->nlmsg_seq, bat_priv,
-						 head, &idx, &sub))
+						 hash, bucket, &idx, &sub,
+						 since, gen))
 			break;
 
 		bucket++;
 	}
 
+	batadv_netlink_dump_check(msg, cb, start);
+
 	ret = msg->len;
 
  out:
@@ -2211,6 +2900,215 @@ int batadv_tt_global_dump(struct sk_buff *msg, struct netlink_callback *cb)
 	cb->args[0] = bucket;
 	cb->args[1] = idx;
 	cb->args[2] = sub;
+	cb->args[3] = gen;
+	cb->args[4] = pos;
+	cb->args[5] = state;
+
+	return ret;
+}
+
+/**
+ * batadv_tt_offload_dump_entry() - Dump the forwarding state of one TT global
+ *  entry into a message
+ * @msg: Netlink message to dump into
+ * @portid: Port making netlink request
+ * @seq: Sequence number of netlink message
+ * @bat_priv: The bat priv with all the soft interface information
+ * @common: tt local & tt global common data
+ * @stable: time in milliseconds the route must not have changed
+ *
+ * Roaming, temporary and isolated clients as well as clients which were added
+ * or whose route changed recently are skipped.
+ *
+ * This function assumes the caller holds rcu_read_lock().
+ *
+ * Return: Error code, or 0 on success
+ */
+static int
+batadv_tt_offload_dump_entry(struct sk_buff *msg, u32 portid, u32 seq,
+			     struct batadv_priv *bat_priv,
+			     struct batadv_tt_common_entry *common, u32 stable)
+{
+	u16 unstable = BATADV_TT_CLIENT_ROAM | BATADV_TT_CLIENT_TEMP |
+		       BATADV_TT_CLIENT_ISOLA;
+	struct batadv_tt_orig_list_entry *best_entry;
+	struct batadv_tt_global_entry *global;
+	struct batadv_orig_node *orig_node;
+	struct batadv_neigh_node *router;
+	int ret = 0;
+	u8 ttvn;
+	void *hdr;
+
+	if (common->flags & unstable)
+		return 0;
+
+	if (!batadv_has_timed_out(common->added_at, stable))
+		return 0;
+
+	global = container_of(common, struct batadv_tt_global_entry, common);
+	best_entry = batadv_transtable_best_orig(bat_priv, global);
+	if (!best_entry)
+		return 0;
+
+	orig_node = best_entry->orig_node;
+	if (!batadv_has_timed_out(READ_ONCE(orig_node->router_changed), stable))
+		return 0;
+
+	router = batadv_orig_router_get(orig_node, BATADV_IF_DEFAULT);
+	if (!router)
+		return 0;
+
+	hdr = genlmsg_put(msg, portid, seq, &batadv_netlink_family,
+			  NLM_F_MULTI, BATADV_CMD_GET_OFFLOAD_FLOWS);
+	if (!hdr) {
+		ret = -ENOBUFS;
+		goto out;
+	}
+
+	ttvn = atomic_read(&orig_node->last_ttvn);
+
+	if (nla_put(msg, BATADV_ATTR_TT_ADDRESS, ETH_ALEN, common->addr) ||
+	    nla_put_u16(msg, BATADV_ATTR_TT_VID, common->vid) ||
+	    nla_put(msg, BATADV_ATTR_ORIG_ADDRESS, ETH_ALEN, orig_node->orig) ||
+	    nla_put_u8(msg, BATADV_ATTR_TT_TTVN, ttvn) ||
+	    nla_put(msg, BATADV_ATTR_ROUTER, ETH_ALEN, router->addr) ||
+	    nla_put_u32(msg, BATADV_ATTR_HARD_IFINDEX,
+			router->if_incoming->net_dev->ifindex)) {
+		genlmsg_cancel(msg, hdr);
+		ret = -EMSGSIZE;
+		goto out;
+	}
+
+	genlmsg_end(msg, hdr);
+out:
+	batadv_neigh_node_put(router);
+	return ret;
+}
+
+/**
+ * batadv_tt_offload_dump_bucket() - Dump the forwarding state of one TT
+ *  global bucket into a message
+ * @msg: Netlink message to dump into
+ * @portid: Port making netlink request
+ * @seq: Sequence number of netlink message
+ * @bat_priv: The bat priv with all the soft interface information
+ * @hash: Hash table to dump
+ * @bucket: Index of the bucket to be dumped
+ * @idx_s: Number of entries to skip
+ * @stable: time in milliseconds the route must not have changed
+ *
+ * Return: Error code, or 0 on success
+ */
+static int
+batadv_tt_offload_dump_bucket(struct sk_buff *msg, u32 portid, u32 seq,
+			      struct batadv_priv *bat_priv,
+			      struct batadv_hashtable *hash, u32 bucket,
+			      int *idx_s, u32 stable)
+{
+	struct batadv_tt_common_entry *common;
+	struct hlist_head *head;
+	int idx = 0;
+
+	rcu_read_lock();
+	head = batadv_hash_bucket_rcu(hash, bucket);
+	hlist_for_each_entry_rcu(common, head, hash_entry) {
+		if (idx++ < *idx_s)
+			continue;
+
+		if (batadv_tt_offload_dump_entry(msg, portid, seq, bat_priv,
+						 common, stable)) {
+			rcu_read_unlock();
+			*idx_s = idx - 1;
+			return -EMSGSIZE;
+		}
+	}
+	rcu_read_unlock();
+
+	*idx_s = 0;
+	return 0;
+}
+
+/**
+ * batadv_tt_offload_dump() - Dump the forwarding state of the stable TT global
+ *  entries into a message
+ * @msg: Netlink message to dump into
+ * @cb: Parameters from query
+ *
+ * Each entry carries everything needed to encapsulate a unicast frame for the
+ * client: the originator and its ttvn for the batman-adv header as well as the
+ * router and the outgoing interface for the ethernet header. Together with the
+ * BATADV_EVENT_ORIG_ROUTER and BATADV_EVENT_TT_* events, this allows a vendor
+ * agent to program established flows into a switch ASIC which can push the
+ * batman-adv unicast header itself, while all other packets are still handled
+ * by batman-adv. Neither such an agent nor a TC based offload is provided:
+ * no TC action can add the batman-adv header. The request can carry
+ * BATADV_ATTR_OFFLOAD_STABLE to override the time the route must not have
+ * changed.
+ *
+ * Return: Error code, or length of message on success
+ */
+int batadv_tt_offload_dump(struct sk_buff *msg, struct netlink_callback *cb)
+{
+	struct batadv_hard_iface *primary_if = NULL;
+	int portid = NETLINK_CB(cb->skb).portid;
+	struct net *net = sock_net(cb->skb->sk);
+	u32 stable = BATADV_OFFLOAD_STABLE_TIME;
+	struct net_device *soft_iface;
+	struct batadv_hashtable *hash;
+	struct batadv_priv *bat_priv;
+	int bucket = cb->args[0];
+	int idx = cb->args[1];
+	int start = msg->len;
+	struct nlattr *attr;
+	int ifindex;
+	int ret;
+
+	ifindex = batadv_netlink_get_ifindex(cb->nlh, BATADV_ATTR_MESH_IFINDEX);
+	if (!ifindex)
+		return -EINVAL;
+
+	attr = nlmsg_find_attr(cb->nlh, GENL_HDRLEN, BATADV_ATTR_OFFLOAD_STABLE);
+	if (attr)
+		stable = nla_get_u32(attr);
+
+	soft_iface = dev_get_by_index(net, ifindex);
+	if (!soft_iface || !batadv_softif_is_valid(soft_iface)) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	bat_priv = netdev_priv(soft_iface);
+
+	primary_if = batadv_primary_if_get_selected(bat_priv);
+	if (!primary_if || primary_if->if_status != BATADV_IF_ACTIVE) {
+		ret = -ENOENT;
+		goto out;
+	}
+
+	hash = bat_priv->tt.global_hash;
+	cb->seq = batadv_hash_generation(hash) << 1 | 1;
+
+	while (bucket < batadv_hash_size(hash)) {
+		if (batadv_tt_offload_dump_bucket(msg, portid,
+						  cb->nlh->nlmsg_seq, bat_priv,
+						  hash, bucket, &idx, stable))
+			break;
+
+		bucket++;
+	}
+
+	batadv_netlink_dump_check(msg, cb, start);
+
+	ret = msg->len;
+
+ out:
+	if (primary_if)
+		batadv_hardif_put(primary_if);
+	if (soft_iface)
+		dev_put(soft_iface);
+
+	cb->args[0] = bucket;
+	cb->args[1] = idx;
 
 	return ret;
 }
@@ -2223,22 +3121,27 @@ int batadv_tt_global_dump(struct sk_buff *msg, struct netlink_callback *cb)
  * Remove an orig_entry from its list in the given tt_global_entry and
  * free this orig_entry afterwards.
  *
- * Caller must hold tt_global_entry->list_lock and ensure orig_entry->list is
- * part of a list.
+ * Caller must hold the list lock of tt_global_entry and ensure orig_entry->list
+ * is part of a list.
  */
 static void
 _batadv_tt_global_del_orig_entry(struct batadv_tt_global_entry *tt_global_entry,
 				 struct batadv_tt_orig_list_entry *orig_entry)
 {
-	lockdep_assert_held(&tt_global_entry->list_lock);
+	lockdep_assert_held(batadv_tt_global_list_lock(tt_global_entry));
 
+	batadv_tt_global_crc_set(orig_entry, tt_global_entry->common.vid, 0);
 	batadv_tt_global_size_dec(orig_entry->orig_node,
 				  tt_global_entry->common.vid);
 	atomic_dec(&tt_global_entry->orig_list_count);
-	/* requires holding tt_global_entry->list_lock and orig_entry->list
-	 * being part of a list
+	/* requires holding the list lock of tt_global_entry and
+	 * orig_entry->list being part of a list
 	 */
 	hlist_del_rcu(&orig_entry->list);
+	/* lookups started before this point must not be cached */
+	batadv_tt_tx_cache_invalidate(orig_entry->orig_node->bat_priv);
+	batadv_tt_global_changed(orig_entry->orig_node->bat_priv,
+				 tt_global_entry);
 	batadv_tt_orig_list_entry_put(orig_entry);
 }
 
@@ -2250,11 +3153,11 @@ batadv_tt_global_del_orig_list(struct batadv_tt_global_entry *tt_global_entry)
 	struct hlist_node *safe;
 	struct batadv_tt_orig_list_entry *orig_entry;
 
-	spin_lock_bh(&tt_global_entry->list_lock);
+	spin_lock_bh(batadv_tt_global_list_lock(tt_global_entry));
 	head = &tt_global_entry->orig_list;
 	hlist_for_each_entry_safe(orig_entry, safe, head, list)
 		_batadv_tt_global_del_orig_entry(tt_global_entry, orig_entry);
-	spin_unlock_bh(&tt_global_entry->list_lock);
+	spin_unlock_bh(batadv_tt_global_list_lock(tt_global_entry));
 }
 
 /**
@@ -2278,7 +3181,7 @@ batadv_tt_global_del_orig_node(struct batadv_priv *bat_priv,
 	struct batadv_tt_orig_list_entry *orig_entry;
 	unsigned short vid;
 
-	spin_lock_bh(&tt_global_entry->list_lock);
+	spin_lock_bh(batadv_tt_global_list_lock(tt_global_entry));
 	head = &tt_global_entry->orig_list;
 	hlist_for_each_entry_safe(orig_entry, safe, head, list) {
 		if (orig_entry->orig_node == orig_node) {
@@ -2292,7 +3195,7 @@ batadv_tt_global_del_orig_node(struct batadv_priv *bat_priv,
 							 orig_entry);
 		}
 	}
-	spin_unlock_bh(&tt_global_entry->list_lock);
+	spin_unlock_bh(batadv_tt_global_list_lock(tt_global_entry));
 }
 
 /* If the client is to be deleted, we check if it is the last origantor entry
@@ -2327,6 +3230,13 @@ batadv_tt_global_del_roaming(struct batadv_priv *bat_priv,
 		/* its the last one, mark for roaming. */
 		tt_global_entry->common.flags |= BATADV_TT_CLIENT_ROAM;
 		tt_global_entry->roam_at = jiffies;
+		batadv_tt_global_crc_sync(tt_global_entry);
+		batadv_tt_global_changed(bat_priv, tt_global_entry);
+		batadv_netlink_notify_tt(bat_priv, BATADV_EVENT_TT_ROAM,
+					 tt_global_entry->common.addr,
+					 tt_global_entry->common.vid,
+					 tt_global_entry->common.flags,
+					 orig_node->orig);
 	} else {
 		/* there is another entry, we can simply delete this
 		 * one and can still use the other one.
@@ -2428,11 +3338,8 @@ void batadv_tt_global_del_orig(struct batadv_priv *bat_priv,
 	if (!hash)
 		return;
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-		list_lock = &hash->list_locks[i];
-
-		spin_lock_bh(list_lock);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
+		head = batadv_hash_lock_bucket(hash, i, &list_lock);
 		hlist_for_each_entry_safe(tt_common_entry, safe,
 					  head, hash_entry) {
 			/* remove only matching entries */
@@ -2447,21 +3354,44 @@ void batadv_tt_global_del_orig(struct batadv_priv *bat_priv,
 						       orig_node, message);
 
 			if (hlist_empty(&tt_global->orig_list)) {
+				batadv_tt_global_tombstone(bat_priv,
+							   tt_common_entry);
 				vid = tt_global->common.vid;
 				batadv_dbg(BATADV_DBG_TT, bat_priv,
 					   "Deleting global tt entry %pM (vid: %d): %s\n",
 					   tt_global->common.addr,
 					   batadv_print_vid(vid), message);
-				hlist_del_rcu(&tt_common_entry->hash_entry);
+				batadv_hash_del(hash,
+						&tt_common_entry->hash_entry);
+				batadv_tt_bloom_del(bat_priv->tt.global_bloom,
+						    tt_common_entry);
 				batadv_tt_global_entry_put(tt_global);
 			}
 		}
-		spin_unlock_bh(list_lock);
+		batadv_hash_unlock_bucket(hash, list_lock);
 	}
 	clear_bit(BATADV_ORIG_CAPA_HAS_TT, &orig_node->capa_initialized);
 }
 
-static bool batadv_tt_global_to_purge(struct batadv_tt_global_entry *tt_global,
+/**
+ * batadv_tt_global_age_note() - record the timestamps a global entry may
+ *  expire by
+ * @bat_priv: the bat priv with all the soft interface information
+ * @tt_global: the global entry to record
+ */
+static void batadv_tt_global_age_note(struct batadv_priv *bat_priv,
+				      struct batadv_tt_global_entry *tt_global)
+{
+	struct batadv_hashtable *hash = bat_priv->tt.global_hash;
+
+	if (tt_global->common.flags & BATADV_TT_CLIENT_ROAM)
+		batadv_hash_age_note(hash, tt_global->roam_at);
+
+	if (tt_global->common.flags & BATADV_TT_CLIENT_TEMP)
+		batadv_hash_age_note(hash, tt_global->common.added_at);
+}
+
+static bool batadv_tt_global_to_purge(struct batadv_tt_global_entry *tt_global,
 				      char **msg)
 {
 	bool purge = false;
@@ -2494,19 +3424,18 @@ static void batadv_tt_global_purge(struct batadv_priv *bat_priv)
 	struct batadv_tt_common_entry *tt_common;
 	struct batadv_tt_global_entry *tt_global;
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-		list_lock = &hash->list_locks[i];
-
-		spin_lock_bh(list_lock);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
+		head = batadv_hash_lock_bucket(hash, i, &list_lock);
 		hlist_for_each_entry_safe(tt_common, node_tmp, head,
 					  hash_entry) {
 			tt_global = container_of(tt_common,
 						 struct batadv_tt_global_entry,
 						 common);
 
-			if (!batadv_tt_global_to_purge(tt_global, &msg))
+			if (!batadv_tt_global_to_purge(tt_global, &msg)) {
+				batadv_tt_global_age_note(bat_priv, tt_global);
 				continue;
+			}
 
 			batadv_dbg(BATADV_DBG_TT, bat_priv,
 				   "Deleting global tt entry %pM (vid: %d): %s\n",
@@ -2514,11 +3443,15 @@ static void batadv_tt_global_purge(struct batadv_priv *bat_priv)
 				   batadv_print_vid(tt_global->common.vid),
 				   msg);
 
-			hlist_del_rcu(&tt_common->hash_entry);
+			batadv_hash_del(hash, &tt_common->hash_entry);
+			batadv_tt_bloom_del(bat_priv->tt.global_bloom,
+					    tt_common);
+			batadv_tt_global_tombstone(bat_priv, tt_common);
+			batadv_tt_tx_cache_invalidate(bat_priv);
 
 			batadv_tt_global_entry_put(tt_global);
 		}
-		spin_unlock_bh(list_lock);
+		batadv_hash_unlock_bucket(hash, list_lock);
 	}
 }
 
@@ -2537,25 +3470,25 @@ static void batadv_tt_global_table_free(struct batadv_priv *bat_priv)
 
 	hash = bat_priv->tt.global_hash;
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-		list_lock = &hash->list_locks[i];
-
-		spin_lock_bh(list_lock);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
+		head = batadv_hash_lock_bucket(hash, i, &list_lock);
 		hlist_for_each_entry_safe(tt_common_entry, node_tmp,
 					  head, hash_entry) {
-			hlist_del_rcu(&tt_common_entry->hash_entry);
+			batadv_hash_del(hash, &tt_common_entry->hash_entry);
 			tt_global = container_of(tt_common_entry,
 						 struct batadv_tt_global_entry,
 						 common);
 			batadv_tt_global_entry_put(tt_global);
 		}
-		spin_unlock_bh(list_lock);
+		batadv_hash_unlock_bucket(hash, list_lock);
 	}
 
 	batadv_hash_destroy(hash);
 
 	bat_priv->tt.global_hash = NULL;
+
+	kfree(bat_priv->tt.global_bloom);
+	bat_priv->tt.global_bloom = NULL;
 }
 
 static bool
@@ -2574,6 +3507,109 @@ _batadv_is_ap_isolated(struct batadv_tt_local_entry *tt_local_entry,
 	return false;
 }
 
+/**
+ * batadv_tt_tx_cache_entry() - get the per-CPU cache slot of a client
+ * @bat_priv: the bat priv with all the soft interface information
+ * @addr: the mac address of the client
+ * @vid: VLAN identifier
+ *
+ * Has to be called with bottom halves disabled.
+ *
+ * Return: the slot of the current CPU the client is cached in
+ */
+static struct batadv_tt_tx_cache_entry *
+batadv_tt_tx_cache_entry(struct batadv_priv *bat_priv, const u8 *addr,
+			 unsigned short vid)
+{
+	struct batadv_tt_common_entry to_search;
+	u32 index;
+
+	ether_addr_copy(to_search.addr, addr);
+	to_search.vid = vid;
+	index = batadv_choose_tt(&to_search, BATADV_TT_TX_CACHE_SIZE);
+
+	return &this_cpu_ptr(bat_priv->tt.tx_cache)->entries[index];
+}
+
+/**
+ * batadv_tt_tx_cache_get() - look up a client in the TT lookup cache
+ * @bat_priv: the bat priv with all the soft interface information
+ * @addr: the mac address of the client
+ * @vid: VLAN identifier
+ *
+ * An originator can only be released after it was removed from all global
+ * entries, which invalidates the cache. The cached pointer can therefore be
+ * used while the generation is unchanged within the same RCU read-side
+ * critical section.
+ *
+ * Return: the cached (and referenced) originator serving the client or NULL
+ * when no valid lookup result was cached.
+ */
+static struct batadv_orig_node *
+batadv_tt_tx_cache_get(struct batadv_priv *bat_priv, const u8 *addr,
+		       unsigned short vid)
+{
+	struct batadv_tt_tx_cache_entry *entry;
+	struct batadv_orig_node *orig_node = NULL;
+	u32 gen;
+
+	if (!bat_priv->tt.tx_cache)
+		return NULL;
+
+	rcu_read_lock();
+	gen = (u32)atomic_read(&bat_priv->tt.tx_cache_gen);
+	smp_rmb();
+
+	local_bh_disable();
+	entry = batadv_tt_tx_cache_entry(bat_priv, addr, vid);
+	if (entry->orig_node && entry->gen == gen && entry->vid == vid &&
+	    batadv_compare_eth(entry->addr, addr))
+		orig_node = entry->orig_node;
+	local_bh_enable();
+
+	if (orig_node && !kref_get_unless_zero(&orig_node->refcount))
+		orig_node = NULL;
+	rcu_read_unlock();
+
+	return orig_node;
+}
+
+/**
+ * batadv_tt_tx_cache_set() - store the result of a TT lookup in the cache
+ * @bat_priv: the bat priv with all the soft interface information
+ * @addr: the mac address of the client
+ * @vid: VLAN identifier
+ * @gen: value of tt.tx_cache_gen before the lookup was started
+ * @orig_node: the (referenced) originator serving the client
+ */
+static void batadv_tt_tx_cache_set(struct batadv_priv *bat_priv,
+				   const u8 *addr, unsigned short vid, u32 gen,
+				   struct batadv_orig_node *orig_node)
+{
+	struct batadv_tt_tx_cache_entry *entry;
+
+	if (!bat_priv->tt.tx_cache)
+		return;
+
+	local_bh_disable();
+	entry = batadv_tt_tx_cache_entry(bat_priv, addr, vid);
+	ether_addr_copy(entry->addr, addr);
+	entry->vid = vid;
+	entry->gen = gen;
+	entry->orig_node = orig_node;
+	local_bh_enable();
+}
+
+/**
+ * batadv_tt_tx_cache_free() - free the TT lookup cache
+ * @bat_priv: the bat priv with all the soft interface information
+ */
+static void batadv_tt_tx_cache_free(struct batadv_priv *bat_priv)
+{
+	free_percpu(bat_priv->tt.tx_cache);
+	bat_priv->tt.tx_cache = NULL;
+}
+
 /**
  * batadv_transtable_search() - get the mesh destination for a given client
  * @bat_priv: the bat priv with all the soft interface information
@@ -2597,14 +3633,29 @@ struct batadv_orig_node *batadv_transtable_search(struct batadv_priv *bat_priv,
 	struct batadv_tt_global_entry *tt_global_entry = NULL;
 	struct batadv_orig_node *orig_node = NULL;
 	struct batadv_tt_orig_list_entry *best_entry;
+	bool cache = true;
+	u32 gen;
 
 	if (src && batadv_vlan_ap_isola_get(bat_priv, vid)) {
+		/* the result depends on the source client */
+		cache = false;
+
 		tt_local_entry = batadv_tt_local_hash_find(bat_priv, src, vid);
 		if (!tt_local_entry ||
 		    (tt_local_entry->common.flags & BATADV_TT_CLIENT_PENDING))
 			goto out;
 	}
 
+	if (cache) {
+		orig_node = batadv_tt_tx_cache_get(bat_priv, addr, vid);
+		if (orig_node)
+			return orig_node;
+	}
+
+	/* changes done during the lookup have to invalidate its result */
+	gen = (u32)atomic_read(&bat_priv->tt.tx_cache_gen);
+	smp_rmb();
+
 	tt_global_entry = batadv_tt_global_hash_find(bat_priv, addr, vid);
 	if (!tt_global_entry)
 		goto out;
@@ -2625,6 +3676,9 @@ struct batadv_orig_node *batadv_transtable_search(struct batadv_priv *bat_priv,
 		orig_node = NULL;
 	rcu_read_unlock();
 
+	if (cache && orig_node)
+		batadv_tt_tx_cache_set(bat_priv, addr, vid, gen, orig_node);
+
 out:
 	if (tt_global_entry)
 		batadv_tt_global_entry_put(tt_global_entry);
@@ -2635,191 +3689,87 @@ out:
 }
 
 /**
- * batadv_tt_global_crc() - calculates the checksum of the local table belonging
- *  to the given orig_node
- * @bat_priv: the bat priv with all the soft interface information
- * @orig_node: originator for which the CRC should be computed
- * @vid: VLAN identifier for which the CRC32 has to be computed
- *
- * This function computes the checksum for the global table corresponding to a
- * specific originator. In particular, the checksum is computed as follows: For
- * each client connected to the originator the CRC32C of the MAC address and the
- * VID is computed and then all the CRC32Cs of the various clients are xor'ed
- * together.
- *
- * The idea behind is that CRC32C should be used as much as possible in order to
- * produce a unique hash of the table, but since the order which is used to feed
- * the CRC32C function affects the result and since every node in the network
- * probably sorts the clients differently, the hash function cannot be directly
- * computed over the entire table. Hence the CRC32C is used only on
- * the single client entry, while all the results are then xor'ed together
- * because the XOR operation can combine them all while trying to reduce the
- * noise as much as possible.
- *
- * Return: the checksum of the global table of a given originator.
+ * batadv_tt_req_node_release() - free tt_req node entry
+ * @ref: kref pointer of the tt req_node entry
  */
-static u32 batadv_tt_global_crc(struct batadv_priv *bat_priv,
-				struct batadv_orig_node *orig_node,
-				unsigned short vid)
+static void batadv_tt_req_node_release(struct kref *ref)
 {
-	struct batadv_hashtable *hash = bat_priv->tt.global_hash;
-	struct batadv_tt_orig_list_entry *tt_orig;
-	struct batadv_tt_common_entry *tt_common;
-	struct batadv_tt_global_entry *tt_global;
-	struct hlist_head *head;
-	u32 i, crc_tmp, crc = 0;
-	u8 flags;
-	__be16 tmp_vid;
-
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-
-		rcu_read_lock();
-		hlist_for_each_entry_rcu(tt_common, head, hash_entry) {
-			tt_global = container_of(tt_common,
-						 struct batadv_tt_global_entry,
-						 common);
-			/* compute the CRC only for entries belonging to the
-			 * VLAN identified by the vid passed as parameter
-			 */
-			if (tt_common->vid != vid)
-				continue;
-
-			/* Roaming clients are in the global table for
-			 * consistency only. They don't have to be
-			 * taken into account while computing the
-			 * global crc
-			 */
-			if (tt_common->flags & BATADV_TT_CLIENT_ROAM)
-				continue;
-			/* Temporary clients have not been announced yet, so
-			 * they have to be skipped while computing the global
-			 * crc
-			 */
-			if (tt_common->flags & BATADV_TT_CLIENT_TEMP)
-				continue;
-
-			/* find out if this global entry is announced by this
-			 * originator
-			 */
-			tt_orig = batadv_tt_global_orig_entry_find(tt_global,
-								   orig_node);
-			if (!tt_orig)
-				continue;
-
-			/* use network order to read the VID: this ensures that
-			 * every node reads the bytes in the same order.
-			 */
-			tmp_vid = htons(tt_common->vid);
-			crc_tmp = crc32c(0, &tmp_vid, sizeof(tmp_vid));
-
-			/* compute the CRC on flags that have to be kept in sync
-			 * among nodes
-			 */
-			flags = tt_orig->flags;
-			crc_tmp = crc32c(crc_tmp, &flags, sizeof(flags));
+	struct batadv_tt_req_node *tt_req_node;
 
-			crc ^= crc32c(crc_tmp, tt_common->addr, ETH_ALEN);
+	tt_req_node = container_of(ref, struct batadv_tt_req_node, refcount);
 
-			batadv_tt_orig_list_entry_put(tt_orig);
-		}
-		rcu_read_unlock();
-	}
+	kmem_cache_free(batadv_tt_req_cache, tt_req_node);
+}
 
-	return crc;
+/**
+ * batadv_tt_req_node_put() - decrement the tt_req_node refcounter and
+ *  possibly release it
+ * @tt_req_node: tt_req_node to be free'd
+ */
+static void batadv_tt_req_node_put(struct batadv_tt_req_node *tt_req_node)
+{
+	kref_put(&tt_req_node->refcount, batadv_tt_req_node_release);
 }
 
 /**
- * batadv_tt_local_crc() - calculates the checksum of the local table
- * @bat_priv: the bat priv with all the soft interface information
- * @vid: VLAN identifier for which the CRC32 has to be computed
- *
- * For details about the computation, please refer to the documentation for
- * batadv_tt_global_crc().
+ * batadv_tt_addr_key() - compute the req_hash/roam_hash key of an address
+ * @addr: the mac address of the originator or client
  *
- * Return: the checksum of the local table
+ * Return: the key of the address in &batadv_priv_tt.req_hash or
+ *  &batadv_priv_tt.roam_hash
  */
-static u32 batadv_tt_local_crc(struct batadv_priv *bat_priv,
-			       unsigned short vid)
+static u32 batadv_tt_addr_key(const u8 *addr)
 {
-	struct batadv_hashtable *hash = bat_priv->tt.local_hash;
-	struct batadv_tt_common_entry *tt_common;
-	struct hlist_head *head;
-	u32 i, crc_tmp, crc = 0;
-	u8 flags;
-	__be16 tmp_vid;
-
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-
-		rcu_read_lock();
-		hlist_for_each_entry_rcu(tt_common, head, hash_entry) {
-			/* compute the CRC only for entries belonging to the
-			 * VLAN identified by vid
-			 */
-			if (tt_common->vid != vid)
-				continue;
-
-			/* not yet committed clients have not to be taken into
-			 * account while computing the CRC
-			 */
-			if (tt_common->flags & BATADV_TT_CLIENT_NEW)
-				continue;
-
-			/* use network order to read the VID: this ensures that
-			 * every node reads the bytes in the same order.
-			 */
-			tmp_vid = htons(tt_common->vid);
-			crc_tmp = crc32c(0, &tmp_vid, sizeof(tmp_vid));
-
-			/* compute the CRC on flags that have to be kept in sync
-			 * among nodes
-			 */
-			flags = tt_common->flags & BATADV_TT_SYNC_MASK;
-			crc_tmp = crc32c(crc_tmp, &flags, sizeof(flags));
-
-			crc ^= crc32c(crc_tmp, tt_common->addr, ETH_ALEN);
-		}
-		rcu_read_unlock();
-	}
-
-	return crc;
+	return jhash(addr, ETH_ALEN, 0);
 }
 
 /**
- * batadv_tt_req_node_release() - free tt_req node entry
- * @ref: kref pointer of the tt req_node entry
+ * batadv_tt_req_node_del() - remove a tt_req_node from the pending requests
+ * @tt_req_node: the tt_req_node to remove
+ *
+ * Caller must hold &batadv_priv_tt.req_list_lock.
  */
-static void batadv_tt_req_node_release(struct kref *ref)
+static void batadv_tt_req_node_del(struct batadv_tt_req_node *tt_req_node)
 {
-	struct batadv_tt_req_node *tt_req_node;
-
-	tt_req_node = container_of(ref, struct batadv_tt_req_node, refcount);
-
-	kmem_cache_free(batadv_tt_req_cache, tt_req_node);
+	list_del_init(&tt_req_node->list);
+	hash_del(&tt_req_node->hash_entry);
+	batadv_tt_req_node_put(tt_req_node);
 }
 
 /**
- * batadv_tt_req_node_put() - decrement the tt_req_node refcounter and
- *  possibly release it
- * @tt_req_node: tt_req_node to be free'd
+ * batadv_tt_req_node_find() - find the pending tt_req_node of an originator
+ * @bat_priv: the bat priv with all the soft interface information
+ * @addr: the address of the originator
+ *
+ * Caller must hold &batadv_priv_tt.req_list_lock.
+ *
+ * Return: the request sent to the originator or NULL if there is none
  */
-static void batadv_tt_req_node_put(struct batadv_tt_req_node *tt_req_node)
+static struct batadv_tt_req_node *
+batadv_tt_req_node_find(struct batadv_priv *bat_priv, const u8 *addr)
 {
-	kref_put(&tt_req_node->refcount, batadv_tt_req_node_release);
+	struct batadv_tt_req_node *tt_req_node;
+	u32 key = batadv_tt_addr_key(addr);
+
+	lockdep_assert_held(&bat_priv->tt.req_list_lock);
+
+	hash_for_each_possible(bat_priv->tt.req_hash, tt_req_node, hash_entry,
+			       key) {
+		if (batadv_compare_eth(tt_req_node->addr, addr))
+			return tt_req_node;
+	}
+
+	return NULL;
 }
 
 static void batadv_tt_req_list_free(struct batadv_priv *bat_priv)
 {
-	struct batadv_tt_req_node *node;
-	struct hlist_node *safe;
+	struct batadv_tt_req_node *node, *safe;
 
 	spin_lock_bh(&bat_priv->tt.req_list_lock);
 
-	hlist_for_each_entry_safe(node, safe, &bat_priv->tt.req_list, list) {
-		hlist_del_init(&node->list);
-		batadv_tt_req_node_put(node);
-	}
+	list_for_each_entry_safe(node, safe, &bat_priv->tt.req_list, list)
+		batadv_tt_req_node_del(node);
 
 	spin_unlock_bh(&bat_priv->tt.req_list_lock);
 }
@@ -2847,16 +3797,17 @@ static void batadv_tt_save_orig_buffer(struct batadv_priv *bat_priv,
 
 static void batadv_tt_req_purge(struct batadv_priv *bat_priv)
 {
-	struct batadv_tt_req_node *node;
-	struct hlist_node *safe;
+	struct batadv_tt_req_node *node, *safe;
 
 	spin_lock_bh(&bat_priv->tt.req_list_lock);
-	hlist_for_each_entry_safe(node, safe, &bat_priv->tt.req_list, list) {
-		if (batadv_has_timed_out(node->issued_at,
-					 BATADV_TT_REQUEST_TIMEOUT)) {
-			hlist_del_init(&node->list);
-			batadv_tt_req_node_put(node);
-		}
+	/* the oldest requests are at the tail, stop at the first pending one */
+	list_for_each_entry_safe_reverse(node, safe, &bat_priv->tt.req_list,
+					 list) {
+		if (!batadv_has_timed_out(node->issued_at,
+					  BATADV_TT_REQUEST_TIMEOUT))
+			break;
+
+		batadv_tt_req_node_del(node);
 	}
 	spin_unlock_bh(&bat_priv->tt.req_list_lock);
 }
@@ -2876,11 +3827,14 @@ batadv_tt_req_node_new(struct batadv_priv *bat_priv,
 	struct batadv_tt_req_node *tt_req_node_tmp, *tt_req_node = NULL;
 
 	spin_lock_bh(&bat_priv->tt.req_list_lock);
-	hlist_for_each_entry(tt_req_node_tmp, &bat_priv->tt.req_list, list) {
-		if (batadv_compare_eth(tt_req_node_tmp, orig_node) &&
-		    !batadv_has_timed_out(tt_req_node_tmp->issued_at,
+	tt_req_node_tmp = batadv_tt_req_node_find(bat_priv, orig_node->orig);
+	if (tt_req_node_tmp) {
+		if (!batadv_has_timed_out(tt_req_node_tmp->issued_at,
 					  BATADV_TT_REQUEST_TIMEOUT))
 			goto unlock;
+
+		/* the stale request is replaced by the new one */
+		batadv_tt_req_node_del(tt_req_node_tmp);
 	}
 
 	tt_req_node = kmem_cache_alloc(batadv_tt_req_cache, GFP_ATOMIC);
@@ -2892,7 +3846,9 @@ batadv_tt_req_node_new(struct batadv_priv *bat_priv,
 	tt_req_node->issued_at = jiffies;
 
 	kref_get(&tt_req_node->refcount);
-	hlist_add_head(&tt_req_node->list, &bat_priv->tt.req_list);
+	list_add(&tt_req_node->list, &bat_priv->tt.req_list);
+	hash_add(bat_priv->tt.req_hash, &tt_req_node->hash_entry,
+		 batadv_tt_addr_key(tt_req_node->addr));
 unlock:
 	spin_unlock_bh(&bat_priv->tt.req_list_lock);
 	return tt_req_node;
@@ -2992,8 +3948,9 @@ static void batadv_tt_tvlv_generate(struct batadv_priv *bat_priv,
 		return;
 
 	rcu_read_lock();
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
+	batadv_hash_walk_begin(hash);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
+		head = batadv_hash_bucket_rcu(hash, i);
 
 		hlist_for_each_entry_rcu(tt_common_entry,
 					 head, hash_entry) {
@@ -3014,9 +3971,136 @@ static void batadv_tt_tvlv_generate(struct batadv_priv *bat_priv,
 			tt_change++;
 		}
 	}
+	batadv_hash_walk_end(hash);
 	rcu_read_unlock();
 }
 
+/**
+ * batadv_tt_chunk_get() - get the chunk header of a chunked tt tvlv
+ * @tt_data: tt data with the BATADV_TT_CHUNKED flag set
+ *
+ * Return: pointer to the chunk header following the vlan data of @tt_data
+ */
+static struct batadv_tvlv_tt_chunk *
+batadv_tt_chunk_get(struct batadv_tvlv_tt_data *tt_data)
+{
+	struct batadv_tvlv_tt_vlan_data *tt_vlan;
+
+	tt_vlan = (struct batadv_tvlv_tt_vlan_data *)(tt_data + 1);
+
+	return (struct batadv_tvlv_tt_chunk *)(tt_vlan +
+					       ntohs(tt_data->num_vlan));
+}
+
+/**
+ * batadv_tt_send_chunks() - send a full table in multiple TT responses
+ * @bat_priv: the bat priv with all the soft interface information
+ * @tt_data: header of the responses including the tvlv_tt_vlan_data objects
+ * @hdr_len: length of @tt_data
+ * @hash: hash table containing the tt entries
+ * @valid_cb: function to filter tt change entries and to return TT flags
+ * @cb_data: data passed to the filter function as argument
+ * @src: source mac address of the responses
+ * @dst: destination mac address of the responses
+ * @offset: number of entries the requester already received
+ *
+ * Each chunk is sent as soon as BATADV_TT_CHUNK_SIZE is reached. Thus only a
+ * single chunk has to be allocated, independent of the size of the table.
+ *
+ * Return: true if the table could be sent, false otherwise
+ */
+static bool batadv_tt_send_chunks(struct batadv_priv *bat_priv,
+				  struct batadv_tvlv_tt_data *tt_data,
+				  u16 hdr_len, struct batadv_hashtable *hash,
+				  bool (*valid_cb)(const void *,
+						   const void *,
+						   u8 *flags),
+				  void *cb_data, u8 *src, u8 *dst, u32 offset)
+{
+	struct batadv_tt_common_entry *tt_common_entry;
+	struct batadv_tvlv_tt_change *tt_change;
+	struct batadv_tvlv_tt_chunk *chunk;
+	u16 num_entries = 0, chunk_entries;
+	struct hlist_head *head;
+	unsigned char *buff;
+	u32 index = 0;
+	int chunk_len;
+	u8 flags;
+	u32 i;
+
+	chunk_len = min_t(int, BATADV_TT_CHUNK_SIZE,
+			  atomic_read(&bat_priv->packet_size_max));
+	chunk_len -= sizeof(struct batadv_unicast_tvlv_packet);
+	chunk_len -= sizeof(struct batadv_tvlv_hdr);
+	chunk_len -= hdr_len + sizeof(*chunk);
+	if (chunk_len < batadv_tt_len(1))
+		return false;
+
+	chunk_entries = batadv_tt_entries(chunk_len);
+	chunk_len = hdr_len + sizeof(*chunk) + batadv_tt_len(chunk_entries);
+
+	buff = kmalloc(chunk_len, GFP_ATOMIC);
+	if (!buff)
+		return false;
+
+	memcpy(buff, tt_data, hdr_len);
+	chunk = (struct batadv_tvlv_tt_chunk *)(buff + hdr_len);
+	memset(chunk, 0, sizeof(*chunk));
+	chunk->offset = htonl(offset);
+	tt_change = (struct batadv_tvlv_tt_change *)(chunk + 1);
+
+	rcu_read_lock();
+	batadv_hash_walk_begin(hash);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
+		head = batadv_hash_bucket_rcu(hash, i);
+
+		hlist_for_each_entry_rcu(tt_common_entry,
+					 head, hash_entry) {
+			if (!valid_cb(tt_common_entry, cb_data, &flags))
+				continue;
+
+			/* skip what the requester received before */
+			if (index++ < offset)
+				continue;
+
+			if (num_entries == chunk_entries) {
+				batadv_inc_counter(bat_priv,
+						   BATADV_CNT_TT_RESPONSE_TX);
+				batadv_tvlv_unicast_send(bat_priv, src, dst,
+							 BATADV_TVLV_TT, 1,
+							 buff, chunk_len);
+
+				offset += num_entries;
+				chunk->offset = htonl(offset);
+				tt_change = (struct batadv_tvlv_tt_change *)
+					    (chunk + 1);
+				num_entries = 0;
+			}
+
+			ether_addr_copy(tt_change->addr, tt_common_entry->addr);
+			tt_change->flags = flags;
+			tt_change->vid = htons(tt_common_entry->vid);
+			memset(tt_change->reserved, 0,
+			       sizeof(tt_change->reserved));
+
+			num_entries++;
+			tt_change++;
+		}
+	}
+	batadv_hash_walk_end(hash);
+	rcu_read_unlock();
+
+	chunk->flags = BATADV_TT_CHUNK_LAST;
+	chunk_len = hdr_len + sizeof(*chunk) + batadv_tt_len(num_entries);
+
+	batadv_inc_counter(bat_priv, BATADV_CNT_TT_RESPONSE_TX);
+	batadv_tvlv_unicast_send(bat_priv, src, dst, BATADV_TVLV_TT, 1, buff,
+				 chunk_len);
+
+	kfree(buff);
+	return true;
+}
+
 /**
  * batadv_tt_global_check_crc() - check if all the CRCs are correct
  * @orig_node: originator for which the CRCs have to be checked
@@ -3082,10 +4166,12 @@ static void batadv_tt_local_update_crc(struct batadv_priv *bat_priv)
 {
 	struct batadv_softif_vlan *vlan;
 
-	/* recompute the global CRC for each VLAN */
+	/* publish the incrementally maintained CRC of each VLAN */
 	rcu_read_lock();
 	hlist_for_each_entry_rcu(vlan, &bat_priv->softif_vlan_list, list) {
-		vlan->tt.crc = batadv_tt_local_crc(bat_priv, vlan->vid);
+		spin_lock_bh(&vlan->tt.crc_lock);
+		vlan->tt.crc = vlan->tt.crc_acc;
+		spin_unlock_bh(&vlan->tt.crc_lock);
 	}
 	rcu_read_unlock();
 }
@@ -3099,9 +4185,8 @@ static void batadv_tt_global_update_crc(struct batadv_priv *bat_priv,
 					struct batadv_orig_node *orig_node)
 {
 	struct batadv_orig_node_vlan *vlan;
-	u32 crc;
 
-	/* recompute the global CRC for each VLAN */
+	/* publish the incrementally maintained CRC of each VLAN */
 	rcu_read_lock();
 	hlist_for_each_entry_rcu(vlan, &orig_node->vlan_list, list) {
 		/* if orig_node is a backbone node for this VLAN, don't compute
@@ -3111,10 +4196,14 @@ static void batadv_tt_global_update_crc(struct batadv_priv *bat_priv,
 						   vlan->vid))
 			continue;
 
-		crc = batadv_tt_global_crc(bat_priv, orig_node, vlan->vid);
-		vlan->tt.crc = crc;
+		spin_lock_bh(&vlan->tt.crc_lock);
+		vlan->tt.crc = vlan->tt.crc_acc;
+		spin_unlock_bh(&vlan->tt.crc_lock);
 	}
 	rcu_read_unlock();
+
+	/* invalidate the result of the last CRC check of its TT tvlv */
+	WRITE_ONCE(orig_node->tt_crc_gen, orig_node->tt_crc_gen + 1);
 }
 
 /**
@@ -3139,6 +4228,8 @@ static bool batadv_send_tt_request(struct batadv_priv *bat_priv,
 	struct batadv_tt_req_node *tt_req_node = NULL;
 	struct batadv_tvlv_tt_vlan_data *tt_vlan_req;
 	struct batadv_hard_iface *primary_if;
+	struct batadv_tvlv_tt_chunk *chunk;
+	u32 offset = 0;
 	bool ret = false;
 	int i, size;
 
@@ -3154,11 +4245,12 @@ static bool batadv_send_tt_request(struct batadv_priv *bat_priv,
 		goto out;
 
 	size = sizeof(*tvlv_tt_data) + sizeof(*tt_vlan_req) * num_vlan;
+	size += sizeof(*chunk);
 	tvlv_tt_data = kzalloc(size, GFP_ATOMIC);
 	if (!tvlv_tt_data)
 		goto out;
 
-	tvlv_tt_data->flags = BATADV_TT_REQUEST;
+	tvlv_tt_data->flags = BATADV_TT_REQUEST | BATADV_TT_CHUNKED;
 	tvlv_tt_data->ttvn = ttvn;
 	tvlv_tt_data->num_vlan = htons(num_vlan);
 
@@ -3177,8 +4269,18 @@ static bool batadv_send_tt_request(struct batadv_priv *bat_priv,
 	if (full_table)
 		tvlv_tt_data->flags |= BATADV_TT_FULL_TABLE;
 
-	batadv_dbg(BATADV_DBG_TT, bat_priv, "Sending TT_REQUEST to %pM [%c]\n",
-		   dst_orig_node->orig, full_table ? 'F' : '.');
+	/* resume an incomplete chunked transfer of the same table */
+	spin_lock_bh(&dst_orig_node->tt_lock);
+	if (dst_orig_node->tt_chunk_ttvn == ttvn)
+		offset = dst_orig_node->tt_chunk_next;
+	spin_unlock_bh(&dst_orig_node->tt_lock);
+
+	chunk = (struct batadv_tvlv_tt_chunk *)tt_vlan_req;
+	chunk->offset = htonl(offset);
+
+	batadv_dbg(BATADV_DBG_TT, bat_priv,
+		   "Sending TT_REQUEST to %pM [%c] (offset: %u)\n",
+		   dst_orig_node->orig, full_table ? 'F' : '.', offset);
 
 	batadv_inc_counter(bat_priv, BATADV_CNT_TT_REQUEST_TX);
 	batadv_tvlv_unicast_send(bat_priv, primary_if->net_dev->dev_addr,
@@ -3192,10 +4294,8 @@ out:
 
 	if (ret && tt_req_node) {
 		spin_lock_bh(&bat_priv->tt.req_list_lock);
-		if (!hlist_unhashed(&tt_req_node->list)) {
-			hlist_del_init(&tt_req_node->list);
-			batadv_tt_req_node_put(tt_req_node);
-		}
+		if (!list_empty(&tt_req_node->list))
+			batadv_tt_req_node_del(tt_req_node);
 		spin_unlock_bh(&bat_priv->tt.req_list_lock);
 	}
 
@@ -3225,6 +4325,7 @@ static bool batadv_send_other_tt_response(struct batadv_priv *bat_priv,
 	struct batadv_tvlv_tt_change *tt_change;
 	struct batadv_tvlv_tt_data *tvlv_tt_data = NULL;
 	struct batadv_tvlv_tt_vlan_data *tt_vlan;
+	struct batadv_tvlv_tt_chunk *chunk;
 	bool ret = false, full_table;
 	u8 orig_ttvn, req_ttvn;
 	u16 tvlv_len;
@@ -3261,6 +4362,35 @@ static bool batadv_send_other_tt_response(struct batadv_priv *bat_priv,
 	else
 		full_table = false;
 
+	if (full_table && tt_data->flags & BATADV_TT_CHUNKED) {
+		/* only the header is needed, the entries are sent in chunks */
+		tt_len = 0;
+		tvlv_len = batadv_tt_prepare_tvlv_global_data(req_dst_orig_node,
+							      &tvlv_tt_data,
+							      &tt_change,
+							      &tt_len);
+		if (!tvlv_tt_data)
+			goto out;
+
+		tvlv_tt_data->flags = BATADV_TT_RESPONSE | BATADV_TT_FULL_TABLE;
+		tvlv_tt_data->flags |= BATADV_TT_CHUNKED;
+		tvlv_tt_data->ttvn = req_ttvn;
+
+		batadv_dbg(BATADV_DBG_TT, bat_priv,
+			   "Sending chunked TT_RESPONSE %pM for %pM (ttvn: %u)\n",
+			   res_dst_orig_node->orig, req_dst_orig_node->orig,
+			   req_ttvn);
+
+		chunk = batadv_tt_chunk_get(tt_data);
+		ret = batadv_tt_send_chunks(bat_priv, tvlv_tt_data, tvlv_len,
+					    bat_priv->tt.global_hash,
+					    batadv_tt_global_valid,
+					    req_dst_orig_node,
+					    req_dst_orig_node->orig, req_src,
+					    ntohl(chunk->offset));
+		goto out;
+	}
+
 	/* TT fragmentation hasn't been implemented yet, so send as many
 	 * TT entries fit a single packet as possible only
 	 */
@@ -3355,10 +4485,12 @@ static bool batadv_send_my_tt_response(struct batadv_priv *bat_priv,
 	struct batadv_tvlv_tt_data *tvlv_tt_data = NULL;
 	struct batadv_hard_iface *primary_if = NULL;
 	struct batadv_tvlv_tt_change *tt_change;
+	struct batadv_tvlv_tt_chunk *chunk;
 	struct batadv_orig_node *orig_node;
 	u8 my_ttvn, req_ttvn;
 	u16 tvlv_len;
 	bool full_table;
+	u32 offset;
 	s32 tt_len;
 
 	batadv_dbg(BATADV_DBG_TT, bat_priv,
@@ -3388,6 +4520,38 @@ static bool batadv_send_my_tt_response(struct batadv_priv *bat_priv,
 	else
 		full_table = false;
 
+	if (full_table && tt_data->flags & BATADV_TT_CHUNKED) {
+		/* only the header is needed, the entries are sent in chunks */
+		tt_len = 0;
+		tvlv_len = batadv_tt_prepare_tvlv_local_data(bat_priv,
+							     &tvlv_tt_data,
+							     &tt_change,
+							     &tt_len);
+		if (!tvlv_len)
+			goto out;
+
+		/* the resume offset is only valid for the requested ttvn */
+		chunk = batadv_tt_chunk_get(tt_data);
+		offset = 0;
+		if (my_ttvn == req_ttvn)
+			offset = ntohl(chunk->offset);
+
+		tvlv_tt_data->flags = BATADV_TT_RESPONSE | BATADV_TT_FULL_TABLE;
+		tvlv_tt_data->flags |= BATADV_TT_CHUNKED;
+		tvlv_tt_data->ttvn = my_ttvn;
+
+		batadv_dbg(BATADV_DBG_TT, bat_priv,
+			   "Sending chunked TT_RESPONSE to %pM (ttvn: %u offset: %u)\n",
+			   orig_node->orig, my_ttvn, offset);
+
+		batadv_tt_send_chunks(bat_priv, tvlv_tt_data, tvlv_len,
+				      bat_priv->tt.local_hash,
+				      batadv_tt_local_valid, NULL,
+				      primary_if->net_dev->dev_addr, req_src,
+				      offset);
+		goto out;
+	}
+
 	/* TT fragmentation hasn't been implemented yet, so send as many
 	 * TT entries fit a single packet as possible only
 	 */
@@ -3402,130 +4566,419 @@ static bool batadv_send_my_tt_response(struct batadv_priv *bat_priv,
 		if (!tt_len || !tvlv_len)
 			goto unlock;
 
-		/* Copy the last orig_node's OGM buffer */
-		memcpy(tt_change, bat_priv->tt.last_changeset,
-		       bat_priv->tt.last_changeset_len);
-		spin_unlock_bh(&bat_priv->tt.last_changeset_lock);
-	} else {
-		req_ttvn = (u8)atomic_read(&bat_priv->tt.vn);
+		/* Copy the last orig_node's OGM buffer */
+		memcpy(tt_change, bat_priv->tt.last_changeset,
+		       bat_priv->tt.last_changeset_len);
+		spin_unlock_bh(&bat_priv->tt.last_changeset_lock);
+	} else {
+		req_ttvn = (u8)atomic_read(&bat_priv->tt.vn);
+
+		/* allocate the tvlv, put the tt_data and all the tt_vlan_data
+		 * in the initial part
+		 */
+		tt_len = -1;
+		tvlv_len = batadv_tt_prepare_tvlv_local_data(bat_priv,
+							     &tvlv_tt_data,
+							     &tt_change,
+							     &tt_len);
+		if (!tt_len || !tvlv_len)
+			goto out;
+
+		/* fill the rest of the tvlv with the real TT entries */
+		batadv_tt_tvlv_generate(bat_priv, bat_priv->tt.local_hash,
+					tt_change, tt_len,
+					batadv_tt_local_valid, NULL);
+	}
+
+	tvlv_tt_data->flags = BATADV_TT_RESPONSE;
+	tvlv_tt_data->ttvn = req_ttvn;
+
+	if (full_table)
+		tvlv_tt_data->flags |= BATADV_TT_FULL_TABLE;
+
+	batadv_dbg(BATADV_DBG_TT, bat_priv,
+		   "Sending TT_RESPONSE to %pM [%c] (ttvn: %u)\n",
+		   orig_node->orig, full_table ? 'F' : '.', req_ttvn);
+
+	batadv_inc_counter(bat_priv, BATADV_CNT_TT_RESPONSE_TX);
+
+	batadv_tvlv_unicast_send(bat_priv, primary_if->net_dev->dev_addr,
+				 req_src, BATADV_TVLV_TT, 1, tvlv_tt_data,
+				 tvlv_len);
+
+	goto out;
+
+unlock:
+	spin_unlock_bh(&bat_priv->tt.last_changeset_lock);
+out:
+	spin_unlock_bh(&bat_priv->tt.commit_lock);
+	if (orig_node)
+		batadv_orig_node_put(orig_node);
+	if (primary_if)
+		batadv_hardif_put(primary_if);
+	kfree(tvlv_tt_data);
+	/* The packet was for this host, so it doesn't need to be re-routed */
+	return true;
+}
+
+/**
+ * batadv_send_tt_response() - send reply to tt request
+ * @bat_priv: the bat priv with all the soft interface information
+ * @tt_data: tt data containing the tt request information
+ * @req_src: mac address of tt request sender
+ * @req_dst: mac address of tt request recipient
+ *
+ * Return: true if tt request reply was sent, false otherwise.
+ */
+static bool batadv_send_tt_response(struct batadv_priv *bat_priv,
+				    struct batadv_tvlv_tt_data *tt_data,
+				    u8 *req_src, u8 *req_dst)
+{
+	if (batadv_is_my_mac(bat_priv, req_dst))
+		return batadv_send_my_tt_response(bat_priv, tt_data, req_src);
+	return batadv_send_other_tt_response(bat_priv, tt_data, req_src,
+					     req_dst);
+}
+
+static void _batadv_tt_update_changes(struct batadv_priv *bat_priv,
+				      struct batadv_orig_node *orig_node,
+				      struct batadv_tvlv_tt_change *tt_change,
+				      u16 tt_num_changes, u8 ttvn)
+{
+	int i;
+	int roams;
+
+	for (i = 0; i < tt_num_changes; i++) {
+		if ((tt_change + i)->flags & BATADV_TT_CLIENT_DEL) {
+			roams = (tt_change + i)->flags & BATADV_TT_CLIENT_ROAM;
+			batadv_tt_global_del(bat_priv, orig_node,
+					     (tt_change + i)->addr,
+					     ntohs((tt_change + i)->vid),
+					     "tt removed by changes",
+					     roams);
+		} else {
+			if (!batadv_tt_global_add(bat_priv, orig_node,
+						  (tt_change + i)->addr,
+						  ntohs((tt_change + i)->vid),
+						  (tt_change + i)->flags, ttvn))
+				/* In case of problem while storing a
+				 * global_entry, we stop the updating
+				 * procedure without committing the
+				 * ttvn change. This will avoid to send
+				 * corrupted data on tt_request
+				 */
+				return;
+		}
+	}
+	set_bit(BATADV_ORIG_CAPA_HAS_TT, &orig_node->capa_initialized);
+}
+
+static void batadv_tt_fill_gtable(struct batadv_priv *bat_priv,
+				  struct batadv_tvlv_tt_change *tt_change,
+				  u8 ttvn, u8 *resp_src,
+				  u16 num_entries)
+{
+	struct batadv_orig_node *orig_node;
+
+	orig_node = batadv_orig_hash_find(bat_priv, resp_src);
+	if (!orig_node)
+		goto out;
+
+	/* Purge the old table first.. */
+	batadv_tt_global_del_orig(bat_priv, orig_node, -1,
+				  "Received full table");
+
+	_batadv_tt_update_changes(bat_priv, orig_node, tt_change, num_entries,
+				  ttvn);
+
+	spin_lock_bh(&orig_node->tt_buff_lock);
+	kfree(orig_node->tt_buff);
+	orig_node->tt_buff_len = 0;
+	orig_node->tt_buff = NULL;
+	spin_unlock_bh(&orig_node->tt_buff_lock);
+
+	atomic_set(&orig_node->last_ttvn, ttvn);
+
+out:
+	if (orig_node)
+		batadv_orig_node_put(orig_node);
+}
+
+/**
+ * batadv_tt_restore_client() - restore a single client of an originator
+ * @bat_priv: the bat priv with all the soft interface information
+ * @orig_node: the originator the client belongs to
+ * @addr: the mac address of the client
+ * @vid: VLAN identifier
+ * @flags: TT flags of the client as found in the restored table
+ * @ttvn: translation table version number of the table
+ * @count: number of clients restored so far
+ *
+ * The caller must hold orig_node->tt_lock. It is released every
+ * BATADV_TT_RESTORE_BATCH clients to not keep bottom halves disabled for the
+ * whole table.
+ *
+ * Return: 0 on success, < 0 on error
+ */
+static int batadv_tt_restore_client(struct batadv_priv *bat_priv,
+				    struct batadv_orig_node *orig_node,
+				    const u8 *addr, u16 vid, u32 flags, u8 ttvn,
+				    unsigned int *count)
+{
+	if (++(*count) % BATADV_TT_RESTORE_BATCH == 0) {
+		spin_unlock_bh(&orig_node->tt_lock);
+		cond_resched();
+		spin_lock_bh(&orig_node->tt_lock);
+
+		/* a table received from the mesh in the meantime is newer */
+		if (test_bit(BATADV_ORIG_CAPA_HAS_TT,
+			     &orig_node->capa_initialized))
+			return -EEXIST;
+	}
+
+	/* only the flags a node announces for its clients are restored, local
+	 * states like ROAM or TEMP found in a dump would not be cleared again
+	 */
+	flags &= BATADV_TT_SYNC_MASK;
+
+	if (!batadv_tt_global_add(bat_priv, orig_node, addr, vid, flags, ttvn))
+		return -ENOMEM;
+
+	return 0;
+}
+
+/**
+ * batadv_tt_restore_orig() - restore the global table of an originator
+ * @bat_priv: the bat priv with all the soft interface information
+ * @orig_node: the originator the table belongs to
+ * @info: netlink message holding the clients of the originator
+ * @ttvn: translation table version number of the table
+ *
+ * A client is either given as BATADV_ATTR_TT_CHANGE or, as found in the
+ * BATADV_CMD_GET_TRANSTABLE_GLOBAL dump, as BATADV_ATTR_TT_ADDRESS followed by
+ * its BATADV_ATTR_TT_VID and BATADV_ATTR_TT_FLAGS.
+ *
+ * Return: 0 on success, < 0 on error
+ */
+static int batadv_tt_restore_orig(struct batadv_priv *bat_priv,
+				  struct batadv_orig_node *orig_node,
+				  struct genl_info *info, u8 ttvn)
+{
+	struct batadv_tvlv_tt_change *tt_change;
+	unsigned int count = 0;
+	const u8 *addr = NULL;
+	struct nlattr *attr;
+	u32 flags = 0;
+	u16 vid = 0;
+	int ret = 0;
+	int rem;
+
+	spin_lock_bh(&orig_node->tt_lock);
+
+	/* never overwrite what was learned from the mesh */
+	if (test_bit(BATADV_ORIG_CAPA_HAS_TT, &orig_node->capa_initialized)) {
+		ret = -EEXIST;
+		goto unlock;
+	}
+
+	nlmsg_for_each_attr(attr, info->nlhdr, GENL_HDRLEN, rem) {
+		switch (nla_type(attr)) {
+		case BATADV_ATTR_TT_CHANGE:
+			if (nla_len(attr) != sizeof(*tt_change)) {
+				ret = -EINVAL;
+				break;
+			}
+
+			tt_change = nla_data(attr);
+			if (tt_change->flags & BATADV_TT_CLIENT_DEL) {
+				ret = -EINVAL;
+				break;
+			}
+
+			ret = batadv_tt_restore_client(bat_priv, orig_node,
+						       tt_change->addr,
+						       ntohs(tt_change->vid),
+						       tt_change->flags, ttvn,
+						       &count);
+			break;
+		case BATADV_ATTR_TT_ADDRESS:
+			if (nla_len(attr) != ETH_ALEN) {
+				ret = -EINVAL;
+				break;
+			}
+
+			/* the address starts the next client of a dump */
+			if (addr)
+				ret = batadv_tt_restore_client(bat_priv,
+							       orig_node, addr,
+							       vid, flags,
+							       ttvn, &count);
+
+			addr = nla_data(attr);
+			flags = 0;
+			vid = 0;
+			break;
+		case BATADV_ATTR_TT_VID:
+			vid = nla_get_u16(attr);
+			break;
+		case BATADV_ATTR_TT_FLAGS:
+			flags = nla_get_u32(attr);
+			break;
+		}
+
+		if (ret < 0)
+			break;
+	}
+
+	if (ret == 0 && addr)
+		ret = batadv_tt_restore_client(bat_priv, orig_node, addr, vid,
+					       flags, ttvn, &count);
+
+	if (ret == -EEXIST)
+		goto unlock;
+
+	if (ret < 0) {
+		batadv_tt_global_del_orig(bat_priv, orig_node, -1,
+					  "Restoring table failed");
+		goto unlock;
+	}
+
+	atomic_set(&orig_node->last_ttvn, ttvn);
+	batadv_tt_global_update_crc(bat_priv, orig_node);
+	set_bit(BATADV_ORIG_CAPA_HAS_TT, &orig_node->capa_initialized);
+
+unlock:
+	spin_unlock_bh(&orig_node->tt_lock);
+
+	return ret;
+}
+
+/**
+ * batadv_tt_restore() - handle incoming BATADV_CMD_RESTORE_TT
+ * @skb: received netlink message
+ * @info: receiver information
+ *
+ * Restores the global table of an originator as it was exported via
+ * BATADV_CMD_GET_TRANSTABLE_GLOBAL before a restart. The originator is
+ * created if it is not known yet. When its first OGM announces the restored
+ * ttvn and CRCs, the table is used without requesting it from the originator.
+ * Otherwise the mismatch is handled like any other TT inconsistency.
+ *
+ * Return: 0 on success, < 0 on error
+ */
+int batadv_tt_restore(struct sk_buff *skb, struct genl_info *info)
+{
+	struct batadv_orig_node *orig_node = NULL;
+	struct net *net = genl_info_net(info);
+	struct net_device *soft_iface;
+	struct batadv_priv *bat_priv;
+	int ifindex;
+	u8 *orig;
+	u8 ttvn;
+	int ret;
 
-		/* allocate the tvlv, put the tt_data and all the tt_vlan_data
-		 * in the initial part
-		 */
-		tt_len = -1;
-		tvlv_len = batadv_tt_prepare_tvlv_local_data(bat_priv,
-							     &tvlv_tt_data,
-							     &tt_change,
-							     &tt_len);
-		if (!tt_len || !tvlv_len)
-			goto out;
+	if (!info->attrs[BATADV_ATTR_MESH_IFINDEX] ||
+	    !info->attrs[BATADV_ATTR_ORIG_ADDRESS] ||
+	    !info->attrs[BATADV_ATTR_TT_LAST_TTVN])
+		return -EINVAL;
 
-		/* fill the rest of the tvlv with the real TT entries */
-		batadv_tt_tvlv_generate(bat_priv, bat_priv->tt.local_hash,
-					tt_change, tt_len,
-					batadv_tt_local_valid, NULL);
+	ifindex = nla_get_u32(info->attrs[BATADV_ATTR_MESH_IFINDEX]);
+	orig = nla_data(info->attrs[BATADV_ATTR_ORIG_ADDRESS]);
+	ttvn = nla_get_u8(info->attrs[BATADV_ATTR_TT_LAST_TTVN]);
+
+	soft_iface = dev_get_by_index(net, ifindex);
+	if (!soft_iface || !batadv_softif_is_valid(soft_iface)) {
+		ret = -ENODEV;
+		goto out;
 	}
 
-	tvlv_tt_data->flags = BATADV_TT_RESPONSE;
-	tvlv_tt_data->ttvn = req_ttvn;
+	bat_priv = netdev_priv(soft_iface);
 
-	if (full_table)
-		tvlv_tt_data->flags |= BATADV_TT_FULL_TABLE;
+	if (atomic_read(&bat_priv->mesh_state) != BATADV_MESH_ACTIVE) {
+		ret = -ENOENT;
+		goto out;
+	}
 
-	batadv_dbg(BATADV_DBG_TT, bat_priv,
-		   "Sending TT_RESPONSE to %pM [%c] (ttvn: %u)\n",
-		   orig_node->orig, full_table ? 'F' : '.', req_ttvn);
+	if (!bat_priv->algo_ops->orig.get) {
+		ret = -EOPNOTSUPP;
+		goto out;
+	}
 
-	batadv_inc_counter(bat_priv, BATADV_CNT_TT_RESPONSE_TX);
+	if (!is_valid_ether_addr(orig) || batadv_is_my_mac(bat_priv, orig)) {
+		ret = -EINVAL;
+		goto out;
+	}
 
-	batadv_tvlv_unicast_send(bat_priv, primary_if->net_dev->dev_addr,
-				 req_src, BATADV_TVLV_TT, 1, tvlv_tt_data,
-				 tvlv_len);
+	orig_node = bat_priv->algo_ops->orig.get(bat_priv, orig);
+	if (!orig_node) {
+		ret = -ENOMEM;
+		goto out;
+	}
 
-	goto out;
+	ret = batadv_tt_restore_orig(bat_priv, orig_node, info, ttvn);
 
-unlock:
-	spin_unlock_bh(&bat_priv->tt.last_changeset_lock);
 out:
-	spin_unlock_bh(&bat_priv->tt.commit_lock);
 	if (orig_node)
 		batadv_orig_node_put(orig_node);
-	if (primary_if)
-		batadv_hardif_put(primary_if);
-	kfree(tvlv_tt_data);
-	/* The packet was for this host, so it doesn't need to be re-routed */
-	return true;
+	if (soft_iface)
+		dev_put(soft_iface);
+
+	return ret;
 }
 
 /**
- * batadv_send_tt_response() - send reply to tt request
+ * batadv_tt_fill_gtable_chunk() - add a chunk of a full table to the global
+ *  table
  * @bat_priv: the bat priv with all the soft interface information
- * @tt_data: tt data containing the tt request information
- * @req_src: mac address of tt request sender
- * @req_dst: mac address of tt request recipient
+ * @orig_node: the originator the full table belongs to
+ * @tt_data: tt data of the chunk
+ * @tt_change: first entry of the chunk
+ * @num_entries: number of entries in the chunk
  *
- * Return: true if tt request reply was sent, false otherwise.
+ * Chunks following a lost one are ignored. The next TT request of this node
+ * asks for the missing ones again.
+ *
+ * Has to be called with orig_node->tt_lock held.
+ *
+ * Return: true if the full table was received completely, false otherwise
  */
-static bool batadv_send_tt_response(struct batadv_priv *bat_priv,
-				    struct batadv_tvlv_tt_data *tt_data,
-				    u8 *req_src, u8 *req_dst)
+static bool batadv_tt_fill_gtable_chunk(struct batadv_priv *bat_priv,
+					struct batadv_orig_node *orig_node,
+					struct batadv_tvlv_tt_data *tt_data,
+					struct batadv_tvlv_tt_change *tt_change,
+					u16 num_entries)
 {
-	if (batadv_is_my_mac(bat_priv, req_dst))
-		return batadv_send_my_tt_response(bat_priv, tt_data, req_src);
-	return batadv_send_other_tt_response(bat_priv, tt_data, req_src,
-					     req_dst);
-}
+	struct batadv_tvlv_tt_chunk *chunk = batadv_tt_chunk_get(tt_data);
+	u32 offset = ntohl(chunk->offset);
 
-static void _batadv_tt_update_changes(struct batadv_priv *bat_priv,
-				      struct batadv_orig_node *orig_node,
-				      struct batadv_tvlv_tt_change *tt_change,
-				      u16 tt_num_changes, u8 ttvn)
-{
-	int i;
-	int roams;
+	lockdep_assert_held(&orig_node->tt_lock);
 
-	for (i = 0; i < tt_num_changes; i++) {
-		if ((tt_change + i)->flags & BATADV_TT_CLIENT_DEL) {
-			roams = (tt_change + i)->flags & BATADV_TT_CLIENT_ROAM;
-			batadv_tt_global_del(bat_priv, orig_node,
-					     (tt_change + i)->addr,
-					     ntohs((tt_change + i)->vid),
-					     "tt removed by changes",
-					     roams);
-		} else {
-			if (!batadv_tt_global_add(bat_priv, orig_node,
-						  (tt_change + i)->addr,
-						  ntohs((tt_change + i)->vid),
-						  (tt_change + i)->flags, ttvn))
-				/* In case of problem while storing a
-				 * global_entry, we stop the updating
-				 * procedure without committing the
-				 * ttvn change. This will avoid to send
-				 * corrupted data on tt_request
-				 */
-				return;
-		}
+	if (offset == 0) {
+		/* Purge the old table first.. */
+		batadv_tt_global_del_orig(bat_priv, orig_node, -1,
+					  "Received full table");
+		orig_node->tt_chunk_ttvn = tt_data->ttvn;
+		orig_node->tt_chunk_next = 0;
 	}
-	set_bit(BATADV_ORIG_CAPA_HAS_TT, &orig_node->capa_initialized);
-}
 
-static void batadv_tt_fill_gtable(struct batadv_priv *bat_priv,
-				  struct batadv_tvlv_tt_change *tt_change,
-				  u8 ttvn, u8 *resp_src,
-				  u16 num_entries)
-{
-	struct batadv_orig_node *orig_node;
+	if (offset != orig_node->tt_chunk_next ||
+	    tt_data->ttvn != orig_node->tt_chunk_ttvn) {
+		batadv_dbg(BATADV_DBG_TT, bat_priv,
+			   "Ignoring TT chunk from %pM (ttvn: %u offset: %u expected: %u)\n",
+			   orig_node->orig, tt_data->ttvn, offset,
+			   orig_node->tt_chunk_next);
+		return false;
+	}
 
-	orig_node = batadv_orig_hash_find(bat_priv, resp_src);
-	if (!orig_node)
-		goto out;
+	_batadv_tt_update_changes(bat_priv, orig_node, tt_change, num_entries,
+				  tt_data->ttvn);
+	orig_node->tt_chunk_next += num_entries;
 
-	/* Purge the old table first.. */
-	batadv_tt_global_del_orig(bat_priv, orig_node, -1,
-				  "Received full table");
+	if (!(chunk->flags & BATADV_TT_CHUNK_LAST))
+		return false;
 
-	_batadv_tt_update_changes(bat_priv, orig_node, tt_change, num_entries,
-				  ttvn);
+	/* transfer complete - start from scratch the next time */
+	orig_node->tt_chunk_next = 0;
 
 	spin_lock_bh(&orig_node->tt_buff_lock);
 	kfree(orig_node->tt_buff);
@@ -3533,11 +4986,9 @@ static void batadv_tt_fill_gtable(struct batadv_priv *bat_priv,
 	orig_node->tt_buff = NULL;
 	spin_unlock_bh(&orig_node->tt_buff_lock);
 
-	atomic_set(&orig_node->last_ttvn, ttvn);
+	atomic_set(&orig_node->last_ttvn, tt_data->ttvn);
 
-out:
-	if (orig_node)
-		batadv_orig_node_put(orig_node);
+	return true;
 }
 
 static void batadv_tt_update_changes(struct batadv_priv *bat_priv,
@@ -3595,7 +5046,6 @@ static void batadv_handle_tt_response(struct batadv_priv *bat_priv,
 				      u8 *resp_src, u16 num_entries)
 {
 	struct batadv_tt_req_node *node;
-	struct hlist_node *safe;
 	struct batadv_orig_node *orig_node = NULL;
 	struct batadv_tvlv_tt_change *tt_change;
 	u8 *tvlv_ptr = (u8 *)tt_data;
@@ -3618,7 +5068,16 @@ static void batadv_handle_tt_response(struct batadv_priv *bat_priv,
 	tvlv_ptr += change_offset;
 
 	tt_change = (struct batadv_tvlv_tt_change *)tvlv_ptr;
-	if (tt_data->flags & BATADV_TT_FULL_TABLE) {
+	if (tt_data->flags & BATADV_TT_CHUNKED) {
+		tt_change = (struct batadv_tvlv_tt_change *)
+			    (batadv_tt_chunk_get(tt_data) + 1);
+		if (!batadv_tt_fill_gtable_chunk(bat_priv, orig_node, tt_data,
+						 tt_change, num_entries)) {
+			/* wait for the remaining chunks */
+			spin_unlock_bh(&orig_node->tt_lock);
+			goto out;
+		}
+	} else if (tt_data->flags & BATADV_TT_FULL_TABLE) {
 		batadv_tt_fill_gtable(bat_priv, tt_change, tt_data->ttvn,
 				      resp_src, num_entries);
 	} else {
@@ -3633,12 +5092,9 @@ static void batadv_handle_tt_response(struct batadv_priv *bat_priv,
 
 	/* Delete the tt_req_node from pending tt_requests list */
 	spin_lock_bh(&bat_priv->tt.req_list_lock);
-	hlist_for_each_entry_safe(node, safe, &bat_priv->tt.req_list, list) {
-		if (!batadv_compare_eth(node->addr, resp_src))
-			continue;
-		hlist_del_init(&node->list);
-		batadv_tt_req_node_put(node);
-	}
+	node = batadv_tt_req_node_find(bat_priv, resp_src);
+	if (node)
+		batadv_tt_req_node_del(node);
 
 	spin_unlock_bh(&bat_priv->tt.req_list_lock);
 out:
@@ -3646,16 +5102,53 @@ out:
 		batadv_orig_node_put(orig_node);
 }
 
+/**
+ * batadv_tt_roam_node_del() - remove and free a roaming client entry
+ * @tt_roam_node: the entry to remove
+ *
+ * Caller must hold &batadv_priv_tt.roam_list_lock.
+ */
+static void batadv_tt_roam_node_del(struct batadv_tt_roam_node *tt_roam_node)
+{
+	list_del(&tt_roam_node->list);
+	hash_del(&tt_roam_node->hash_entry);
+	kmem_cache_free(batadv_tt_roam_cache, tt_roam_node);
+}
+
+/**
+ * batadv_tt_roam_node_find() - find the roaming entry of a client
+ * @bat_priv: the bat priv with all the soft interface information
+ * @addr: the mac address of the client
+ *
+ * Caller must hold &batadv_priv_tt.roam_list_lock.
+ *
+ * Return: the entry of the client or NULL if there is none
+ */
+static struct batadv_tt_roam_node *
+batadv_tt_roam_node_find(struct batadv_priv *bat_priv, const u8 *addr)
+{
+	struct batadv_tt_roam_node *tt_roam_node;
+	u32 key = batadv_tt_addr_key(addr);
+
+	lockdep_assert_held(&bat_priv->tt.roam_list_lock);
+
+	hash_for_each_possible(bat_priv->tt.roam_hash, tt_roam_node,
+			       hash_entry, key) {
+		if (batadv_compare_eth(tt_roam_node->addr, addr))
+			return tt_roam_node;
+	}
+
+	return NULL;
+}
+
 static void batadv_tt_roam_list_free(struct batadv_priv *bat_priv)
 {
 	struct batadv_tt_roam_node *node, *safe;
 
 	spin_lock_bh(&bat_priv->tt.roam_list_lock);
 
-	list_for_each_entry_safe(node, safe, &bat_priv->tt.roam_list, list) {
-		list_del(&node->list);
-		kmem_cache_free(batadv_tt_roam_cache, node);
-	}
+	list_for_each_entry_safe(node, safe, &bat_priv->tt.roam_list, list)
+		batadv_tt_roam_node_del(node);
 
 	spin_unlock_bh(&bat_priv->tt.roam_list_lock);
 }
@@ -3665,13 +5158,14 @@ static void batadv_tt_roam_purge(struct batadv_priv *bat_priv)
 	struct batadv_tt_roam_node *node, *safe;
 
 	spin_lock_bh(&bat_priv->tt.roam_list_lock);
-	list_for_each_entry_safe(node, safe, &bat_priv->tt.roam_list, list) {
+	/* the oldest entries are at the tail, stop at the first active one */
+	list_for_each_entry_safe_reverse(node, safe, &bat_priv->tt.roam_list,
+					 list) {
 		if (!batadv_has_timed_out(node->first_time,
 					  BATADV_ROAMING_MAX_TIME))
-			continue;
+			break;
 
-		list_del(&node->list);
-		kmem_cache_free(batadv_tt_roam_cache, node);
+		batadv_tt_roam_node_del(node);
 	}
 	spin_unlock_bh(&bat_priv->tt.roam_list_lock);
 }
@@ -3693,39 +5187,35 @@ static bool batadv_tt_check_roam_count(struct batadv_priv *bat_priv, u8 *client)
 	bool ret = false;
 
 	spin_lock_bh(&bat_priv->tt.roam_list_lock);
-	/* The new tt_req will be issued only if I'm not waiting for a
-	 * reply from the same orig_node yet
-	 */
-	list_for_each_entry(tt_roam_node, &bat_priv->tt.roam_list, list) {
-		if (!batadv_compare_eth(tt_roam_node->addr, client))
-			continue;
-
-		if (batadv_has_timed_out(tt_roam_node->first_time,
-					 BATADV_ROAMING_MAX_TIME))
-			continue;
-
-		if (!batadv_atomic_dec_not_zero(&tt_roam_node->counter))
-			/* Sorry, you roamed too many times! */
-			goto unlock;
-		ret = true;
-		break;
+	tt_roam_node = batadv_tt_roam_node_find(bat_priv, client);
+	if (tt_roam_node &&
+	    !batadv_has_timed_out(tt_roam_node->first_time,
+				  BATADV_ROAMING_MAX_TIME)) {
+		/* Sorry, you roamed too many times! */
+		if (batadv_atomic_dec_not_zero(&tt_roam_node->counter))
+			ret = true;
+		goto unlock;
 	}
 
-	if (!ret) {
+	if (tt_roam_node) {
+		/* the entry of the last roaming phase is reused */
+		list_del(&tt_roam_node->list);
+	} else {
 		tt_roam_node = kmem_cache_alloc(batadv_tt_roam_cache,
 						GFP_ATOMIC);
 		if (!tt_roam_node)
 			goto unlock;
 
-		tt_roam_node->first_time = jiffies;
-		atomic_set(&tt_roam_node->counter,
-			   BATADV_ROAMING_MAX_COUNT - 1);
 		ether_addr_copy(tt_roam_node->addr, client);
-
-		list_add(&tt_roam_node->list, &bat_priv->tt.roam_list);
-		ret = true;
+		hash_add(bat_priv->tt.roam_hash, &tt_roam_node->hash_entry,
+			 batadv_tt_addr_key(client));
 	}
 
+	tt_roam_node->first_time = jiffies;
+	atomic_set(&tt_roam_node->counter, BATADV_ROAMING_MAX_COUNT - 1);
+	list_add(&tt_roam_node->list, &bat_priv->tt.roam_list);
+	ret = true;
+
 unlock:
 	spin_unlock_bh(&bat_priv->tt.roam_list_lock);
 	return ret;
@@ -3783,17 +5273,30 @@ static void batadv_tt_purge(struct work_struct *work)
 	struct delayed_work *delayed_work;
 	struct batadv_priv_tt *priv_tt;
 	struct batadv_priv *bat_priv;
+	u64 start = 0;
+
+	if (trace_batadv_purge_tt_enabled())
+		start = batadv_trace_clock();
 
 	delayed_work = to_delayed_work(work);
 	priv_tt = container_of(delayed_work, struct batadv_priv_tt, work);
 	bat_priv = container_of(priv_tt, struct batadv_priv, tt);
 
-	batadv_tt_local_purge(bat_priv, BATADV_TT_LOCAL_TIMEOUT);
-	batadv_tt_global_purge(bat_priv);
+	if (batadv_hash_age_purge_begin(bat_priv->tt.local_hash,
+					BATADV_TT_LOCAL_TIMEOUT))
+		batadv_tt_local_purge(bat_priv, BATADV_TT_LOCAL_TIMEOUT);
+
+	if (batadv_hash_age_purge_begin(bat_priv->tt.global_hash,
+					min(BATADV_TT_CLIENT_ROAM_TIMEOUT,
+					    BATADV_TT_CLIENT_TEMP_TIMEOUT)))
+		batadv_tt_global_purge(bat_priv);
+
 	batadv_tt_req_purge(bat_priv);
 	batadv_tt_roam_purge(bat_priv);
 
-	queue_delayed_work(batadv_event_workqueue, &bat_priv->tt.work,
+	trace_batadv_purge_tt(bat_priv->soft_iface, start);
+
+	queue_delayed_work(bat_priv->event_wq, &bat_priv->tt.work,
 			   msecs_to_jiffies(BATADV_TT_WORK_PERIOD));
 }
 
@@ -3808,6 +5311,7 @@ void batadv_tt_free(struct batadv_priv *bat_priv)
 
 	cancel_delayed_work_sync(&bat_priv->tt.work);
 
+	batadv_tt_tx_cache_free(bat_priv);
 	batadv_tt_local_table_free(bat_priv);
 	batadv_tt_global_table_free(bat_priv);
 	batadv_tt_req_list_free(bat_priv);
@@ -3830,16 +5334,17 @@ static void batadv_tt_local_set_flags(struct batadv_priv *bat_priv, u16 flags,
 {
 	struct batadv_hashtable *hash = bat_priv->tt.local_hash;
 	struct batadv_tt_common_entry *tt_common_entry;
+	struct batadv_tt_local_entry *tt_local;
 	struct hlist_head *head;
 	u32 i;
 
 	if (!hash)
 		return;
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-
+	batadv_hash_walk_begin(hash);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
 		rcu_read_lock();
+		head = batadv_hash_bucket_rcu(hash, i);
 		hlist_for_each_entry_rcu(tt_common_entry,
 					 head, hash_entry) {
 			if (enable) {
@@ -3852,6 +5357,11 @@ static void batadv_tt_local_set_flags(struct batadv_priv *bat_priv, u16 flags,
 				tt_common_entry->flags &= ~flags;
 			}
 
+			tt_local = container_of(tt_common_entry,
+						struct batadv_tt_local_entry,
+						common);
+			batadv_tt_local_crc_sync(tt_local);
+
 			if (!count)
 				continue;
 
@@ -3860,6 +5370,7 @@ static void batadv_tt_local_set_flags(struct batadv_priv *bat_priv, u16 flags,
 		}
 		rcu_read_unlock();
 	}
+	batadv_hash_walk_end(hash);
 }
 
 /* Purge out all the tt local entries marked with BATADV_TT_CLIENT_PENDING */
@@ -3876,11 +5387,8 @@ static void batadv_tt_local_purge_pending_clients(struct batadv_priv *bat_priv)
 	if (!hash)
 		return;
 
-	for (i = 0; i < hash->size; i++) {
-		head = &hash->table[i];
-		list_lock = &hash->list_locks[i];
-
-		spin_lock_bh(list_lock);
+	for (i = 0; i < batadv_hash_size(hash); i++) {
+		head = batadv_hash_lock_bucket(hash, i, &list_lock);
 		hlist_for_each_entry_safe(tt_common, node_tmp, head,
 					  hash_entry) {
 			if (!(tt_common->flags & BATADV_TT_CLIENT_PENDING))
@@ -3892,14 +5400,17 @@ static void batadv_tt_local_purge_pending_clients(struct batadv_priv *bat_priv)
 				   batadv_print_vid(tt_common->vid));
 
 			batadv_tt_local_size_dec(bat_priv, tt_common->vid);
-			hlist_del_rcu(&tt_common->hash_entry);
+			batadv_hash_del(hash, &tt_common->hash_entry);
+			batadv_tt_bloom_del(bat_priv->tt.local_bloom,
+					    tt_common);
 			tt_local = container_of(tt_common,
 						struct batadv_tt_local_entry,
 						common);
 
+			batadv_tt_local_crc_sync(tt_local);
 			batadv_tt_local_entry_put(tt_local);
 		}
-		spin_unlock_bh(list_lock);
+		batadv_hash_unlock_bucket(hash, list_lock);
 	}
 }
 
@@ -3991,6 +5502,89 @@ vlan_put:
 	return ret;
 }
 
+/**
+ * batadv_tt_ogm_unchanged() - check whether a TT tvlv was already found to be
+ *  consistent with the global table
+ * @orig_node: the orig_node of the ogm
+ * @digest: jhash of the TT tvlv
+ * @ttvn: translation table version number of the TT tvlv
+ *
+ * Return: true if the TT tvlv doesn't have to be processed again
+ */
+static bool batadv_tt_ogm_unchanged(struct batadv_orig_node *orig_node,
+				    u32 digest, u8 ttvn)
+{
+	bool unchanged;
+
+	if (!test_bit(BATADV_ORIG_CAPA_HAS_TT, &orig_node->capa_initialized))
+		return false;
+
+	if ((u8)atomic_read(&orig_node->last_ttvn) != ttvn)
+		return false;
+
+	spin_lock_bh(&orig_node->tt_lock);
+	unchanged = orig_node->tt_ogm_digest == digest &&
+		    orig_node->tt_ogm_gen == orig_node->tt_crc_gen &&
+		    !batadv_has_timed_out(orig_node->tt_ogm_checked,
+					  BATADV_TT_OGM_RECHECK_TIMEOUT);
+	spin_unlock_bh(&orig_node->tt_lock);
+
+	return unchanged;
+}
+
+/**
+ * batadv_tt_ogm_check_crc() - check the CRCs of a TT tvlv and remember the
+ *  result
+ * @orig_node: the orig_node of the ogm
+ * @tt_vlan: pointer to the first tvlv VLAN entry
+ * @num_vlan: number of tvlv VLAN entries
+ * @digest: jhash of the TT tvlv
+ *
+ * Return: true if the CRCs of the TT tvlv match the global table
+ */
+static bool batadv_tt_ogm_check_crc(struct batadv_orig_node *orig_node,
+				    struct batadv_tvlv_tt_vlan_data *tt_vlan,
+				    u16 num_vlan, u32 digest)
+{
+	u32 crc_gen = READ_ONCE(orig_node->tt_crc_gen);
+
+	if (!batadv_tt_global_check_crc(orig_node, tt_vlan, num_vlan))
+		return false;
+
+	spin_lock_bh(&orig_node->tt_lock);
+	orig_node->tt_ogm_digest = digest;
+	orig_node->tt_ogm_gen = crc_gen;
+	orig_node->tt_ogm_checked = jiffies;
+	spin_unlock_bh(&orig_node->tt_lock);
+
+	return true;
+}
+
+/**
+ * batadv_tt_orig_over_limit() - check whether the table of an originator is
+ *  knowingly out of sync
+ * @orig_node: the originator to check
+ *
+ * Entries of an originator above tt_global_max_entries are dropped, which
+ * leaves its TT CRC permanently mismatching. Its table is then only requested
+ * again every BATADV_TT_OVER_LIMIT_RETRY milliseconds, e.g. to notice that it
+ * shrunk below the limit.
+ *
+ * Return: true if no TT request should be sent to the originator
+ */
+static bool batadv_tt_orig_over_limit(struct batadv_orig_node *orig_node)
+{
+	if (!READ_ONCE(orig_node->tt_over_limit))
+		return false;
+
+	if (!batadv_has_timed_out(READ_ONCE(orig_node->tt_over_limit_at),
+				  BATADV_TT_OVER_LIMIT_RETRY))
+		return true;
+
+	WRITE_ONCE(orig_node->tt_over_limit, false);
+	return false;
+}
+
 /**
  * batadv_tt_update_orig() - update global translation table with new tt
  *  information received via ogms
@@ -4001,12 +5595,13 @@ vlan_put:
  * @tt_change: pointer to the first entry in the TT buffer
  * @tt_num_changes: number of tt changes inside the tt buffer
  * @ttvn: translation table version number of this changeset
+ * @digest: jhash of the complete TT tvlv
  */
 static void batadv_tt_update_orig(struct batadv_priv *bat_priv,
 				  struct batadv_orig_node *orig_node,
 				  const void *tt_buff, u16 tt_num_vlan,
 				  struct batadv_tvlv_tt_change *tt_change,
-				  u16 tt_num_changes, u8 ttvn)
+				  u16 tt_num_changes, u8 ttvn, u32 digest)
 {
 	u8 orig_ttvn = (u8)atomic_read(&orig_node->last_ttvn);
 	struct batadv_tvlv_tt_vlan_data *tt_vlan;
@@ -4053,21 +5648,24 @@ static void batadv_tt_update_orig(struct batadv_priv *bat_priv,
 		 * checking the CRC value is mandatory to detect the
 		 * inconsistency
 		 */
-		if (!batadv_tt_global_check_crc(orig_node, tt_vlan,
-						tt_num_vlan))
+		if (!batadv_tt_ogm_check_crc(orig_node, tt_vlan, tt_num_vlan,
+					     digest))
 			goto request_table;
 	} else {
 		/* if we missed more than one change or our tables are not
 		 * in sync anymore -> request fresh tt data
 		 */
 		if (!has_tt_init || ttvn != orig_ttvn ||
-		    !batadv_tt_global_check_crc(orig_node, tt_vlan,
-						tt_num_vlan)) {
+		    !batadv_tt_ogm_check_crc(orig_node, tt_vlan, tt_num_vlan,
+					     digest)) {
 request_table:
 			batadv_dbg(BATADV_DBG_TT, bat_priv,
 				   "TT inconsistency for %pM. Need to retrieve the correct information (ttvn: %u last_ttvn: %u num_changes: %u)\n",
 				   orig_node->orig, ttvn, orig_ttvn,
 				   tt_num_changes);
+			if (batadv_tt_orig_over_limit(orig_node))
+				return;
+
 			batadv_send_tt_request(bat_priv, orig_node, ttvn,
 					       tt_vlan, tt_num_vlan,
 					       full_table);
@@ -4218,11 +5816,20 @@ static void batadv_tt_tvlv_ogm_handler_v1(struct batadv_priv *bat_priv,
 	struct batadv_tvlv_tt_change *tt_change;
 	struct batadv_tvlv_tt_data *tt_data;
 	u16 num_entries, num_vlan;
+	u32 digest;
 
 	if (tvlv_value_len < sizeof(*tt_data))
 		return;
 
 	tt_data = (struct batadv_tvlv_tt_data *)tvlv_value;
+
+	/* nothing to do when the same tvlv was already found to be in sync
+	 * with the global table
+	 */
+	digest = jhash(tvlv_value, tvlv_value_len, 0);
+	if (batadv_tt_ogm_unchanged(orig, digest, tt_data->ttvn))
+		return;
+
 	tvlv_value_len -= sizeof(*tt_data);
 
 	num_vlan = ntohs(tt_data->num_vlan);
@@ -4237,7 +5844,7 @@ static void batadv_tt_tvlv_ogm_handler_v1(struct batadv_priv *bat_priv,
 	num_entries = batadv_tt_entries(tvlv_value_len);
 
 	batadv_tt_update_orig(bat_priv, orig, tt_vlan, num_vlan, tt_change,
-			      num_entries, tt_data->ttvn);
+			      num_entries, tt_data->ttvn, digest);
 }
 
 /**
@@ -4275,6 +5882,14 @@ static int batadv_tt_tvlv_unicast_handler_v1(struct batadv_priv *bat_priv,
 		return NET_RX_SUCCESS;
 
 	tvlv_value_len -= tt_vlan_len;
+
+	if (tt_data->flags & BATADV_TT_CHUNKED) {
+		if (tvlv_value_len < sizeof(struct batadv_tvlv_tt_chunk))
+			return NET_RX_SUCCESS;
+
+		tvlv_value_len -= sizeof(struct batadv_tvlv_tt_chunk);
+	}
+
 	tt_num_entries = batadv_tt_entries(tvlv_value_len);
 
 	switch (tt_data->flags & BATADV_TT_DATA_TYPE_MASK) {
@@ -4386,6 +6001,10 @@ int batadv_tt_init(struct batadv_priv *bat_priv)
 	/* synchronized flags must be remote */
 	BUILD_BUG_ON(!(BATADV_TT_SYNC_MASK & BATADV_TT_REMOTE_MASK));
 
+	bat_priv->tt.tx_cache = alloc_percpu(struct batadv_tt_tx_cache);
+	if (!bat_priv->tt.tx_cache)
+		return -ENOMEM;
+
 	ret = batadv_tt_local_init(bat_priv);
 	if (ret < 0)
 		return ret;
@@ -4396,14 +6015,15 @@ int batadv_tt_init(struct batadv_priv *bat_priv)
 
 	batadv_tvlv_handler_register(bat_priv, batadv_tt_tvlv_ogm_handler_v1,
 				     batadv_tt_tvlv_unicast_handler_v1,
-				     BATADV_TVLV_TT, 1, BATADV_NO_FLAGS);
+				     BATADV_TVLV_TT, 1,
+				     BATADV_TVLV_HANDLER_OGM_ALWAYS);
 
 	batadv_tvlv_handler_register(bat_priv, NULL,
 				     batadv_roam_tvlv_unicast_handler_v1,
 				     BATADV_TVLV_ROAM, 1, BATADV_NO_FLAGS);
 
 	INIT_DELAYED_WORK(&bat_priv->tt.work, batadv_tt_purge);
-	queue_delayed_work(batadv_event_workqueue, &bat_priv->tt.work,
+	queue_delayed_work(bat_priv->event_wq, &bat_priv->tt.work,
 			   msecs_to_jiffies(BATADV_TT_WORK_PERIOD));
 
 	return 1;
@@ -4448,20 +6068,26 @@ int __init batadv_tt_cache_init(void)
 	size_t tt_change_size = sizeof(struct batadv_tt_change_node);
 	size_t tt_req_size = sizeof(struct batadv_tt_req_node);
 	size_t tt_roam_size = sizeof(struct batadv_tt_roam_node);
+#ifdef CONFIG_BATMAN_ADV_TT_COMPACT
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(batadv_tt_list_locks); i++)
+		spin_lock_init(&batadv_tt_list_locks[i]);
+#endif
 
 	batadv_tl_cache = kmem_cache_create("batadv_tl_cache", tl_size, 0,
-					    SLAB_HWCACHE_ALIGN, NULL);
+					    BATADV_TT_SLAB_FLAGS, NULL);
 	if (!batadv_tl_cache)
 		return -ENOMEM;
 
 	batadv_tg_cache = kmem_cache_create("batadv_tg_cache", tg_size, 0,
-					    SLAB_HWCACHE_ALIGN, NULL);
+					    BATADV_TT_SLAB_FLAGS, NULL);
 	if (!batadv_tg_cache)
 		goto err_tt_tl_destroy;
 
 	batadv_tt_orig_cache = kmem_cache_create("batadv_tt_orig_cache",
 						 tt_orig_size, 0,
-						 SLAB_HWCACHE_ALIGN, NULL);
+						 BATADV_TT_SLAB_FLAGS, NULL);
 	if (!batadv_tt_orig_cache)
 		goto err_tt_tg_destroy;
 
@@ -65,6 +65,25 @@ static void batadv_tvlv_handler_put(struct batadv_tvlv_handler *tvlv_handler)
 	kref_put(&tvlv_handler->refcount, batadv_tvlv_handler_release);
 }
 
+/**
+ * batadv_tvlv_handler_index() - get the dispatch table index of a tvlv handler
+ * @type: tvlv handler type
+ * @version: tvlv handler version
+ *
+ * Return: index in &batadv_priv_tvlv.handler_table or -1 if the handler can
+ * only be found in the handler list
+ */
+static int batadv_tvlv_handler_index(u8 type, u8 version)
+{
+	if (type >= BATADV_TVLV_DISPATCH_TYPES)
+		return -1;
+
+	if (version >= BATADV_TVLV_DISPATCH_VERSIONS)
+		return -1;
+
+	return type * BATADV_TVLV_DISPATCH_VERSIONS + version;
+}
+
 /**
  * batadv_tvlv_handler_get() - retrieve tvlv handler from the tvlv handler list
  *  based on the provided type and version (both need to match)
@@ -78,10 +97,21 @@ static struct batadv_tvlv_handler *
 batadv_tvlv_handler_get(struct batadv_priv *bat_priv, u8 type, u8 version)
 {
 	struct batadv_tvlv_handler *tvlv_handler_tmp, *tvlv_handler = NULL;
+	struct batadv_priv_tvlv *tvlv = &bat_priv->tvlv;
+	int index = batadv_tvlv_handler_index(type, version);
 
 	rcu_read_lock();
+	if (index >= 0) {
+		tvlv_handler_tmp = rcu_dereference(tvlv->handler_table[index]);
+		if (tvlv_handler_tmp &&
+		    kref_get_unless_zero(&tvlv_handler_tmp->refcount))
+			tvlv_handler = tvlv_handler_tmp;
+
+		goto out;
+	}
+
 	hlist_for_each_entry_rcu(tvlv_handler_tmp,
-				 &bat_priv->tvlv.handler_list, list) {
+				 &tvlv->handler_list, list) {
 		if (tvlv_handler_tmp->type != type)
 			continue;
 
@@ -94,6 +124,8 @@ batadv_tvlv_handler_get(struct batadv_priv *bat_priv, u8 type, u8 version)
 		tvlv_handler = tvlv_handler_tmp;
 		break;
 	}
+
+out:
 	rcu_read_unlock();
 
 	return tvlv_handler;
@@ -198,6 +230,7 @@ static void batadv_tvlv_container_remove(struct batadv_priv *bat_priv,
 		return;
 
 	hlist_del(&tvlv->list);
+	bat_priv->tvlv.blob_dirty = true;
 
 	/* first call to decrement the counter, second call to free */
 	batadv_tvlv_container_put(tvlv);
@@ -222,6 +255,27 @@ void batadv_tvlv_container_unregister(struct batadv_priv *bat_priv,
 	spin_unlock_bh(&bat_priv->tvlv.container_list_lock);
 }
 
+/**
+ * batadv_tvlv_container_equal() - check whether a container has the given
+ *  content
+ * @tvlv: the tvlv container to check (may be NULL)
+ * @tvlv_value: tvlv container content
+ * @tvlv_value_len: tvlv container content length
+ *
+ * Return: true if @tvlv exists and carries exactly @tvlv_value
+ */
+static bool batadv_tvlv_container_equal(struct batadv_tvlv_container *tvlv,
+					void *tvlv_value, u16 tvlv_value_len)
+{
+	if (!tvlv)
+		return false;
+
+	if (ntohs(tvlv->tvlv_hdr.len) != tvlv_value_len)
+		return false;
+
+	return memcmp(tvlv + 1, tvlv_value, tvlv_value_len) == 0;
+}
+
 /**
  * batadv_tvlv_container_register() - register tvlv type, version and content
  *  to be propagated with each (primary interface) OGM
@@ -239,10 +293,25 @@ void batadv_tvlv_container_register(struct batadv_priv *bat_priv,
 				    void *tvlv_value, u16 tvlv_value_len)
 {
 	struct batadv_tvlv_container *tvlv_old, *tvlv_new;
+	bool unchanged;
 
 	if (!tvlv_value)
 		tvlv_value_len = 0;
 
+	/* most containers are refreshed every interval without any change.
+	 * Keep the old one and the serialized blob in this case
+	 */
+	spin_lock_bh(&bat_priv->tvlv.container_list_lock);
+	tvlv_old = batadv_tvlv_container_get(bat_priv, type, version);
+	unchanged = batadv_tvlv_container_equal(tvlv_old, tvlv_value,
+						tvlv_value_len);
+	if (tvlv_old)
+		batadv_tvlv_container_put(tvlv_old);
+	spin_unlock_bh(&bat_priv->tvlv.container_list_lock);
+
+	if (unchanged)
+		return;
+
 	tvlv_new = kzalloc(sizeof(*tvlv_new) + tvlv_value_len, GFP_ATOMIC);
 	if (!tvlv_new)
 		return;
@@ -261,12 +330,63 @@ void batadv_tvlv_container_register(struct batadv_priv *bat_priv,
 
 	kref_get(&tvlv_new->refcount);
 	hlist_add_head(&tvlv_new->list, &bat_priv->tvlv.container_list);
+	bat_priv->tvlv.blob_dirty = true;
 	spin_unlock_bh(&bat_priv->tvlv.container_list_lock);
 
 	/* don't return reference to new tvlv_container */
 	batadv_tvlv_container_put(tvlv_new);
 }
 
+/**
+ * batadv_tvlv_blob_update() - rebuild the serialized tvlv containers
+ * @bat_priv: the bat priv with all the soft interface information
+ *
+ * Has to be called with the appropriate locks being acquired
+ * (tvlv.container_list_lock).
+ *
+ * Return: true if the blob represents the current container list, false if it
+ * could not be rebuilt
+ */
+static bool batadv_tvlv_blob_update(struct batadv_priv *bat_priv)
+{
+	struct batadv_tvlv_container *tvlv;
+	struct batadv_tvlv_hdr *tvlv_hdr;
+	unsigned char *blob = NULL;
+	u16 tvlv_value_len;
+	void *tvlv_value;
+
+	lockdep_assert_held(&bat_priv->tvlv.container_list_lock);
+
+	if (!bat_priv->tvlv.blob_dirty)
+		return true;
+
+	tvlv_value_len = batadv_tvlv_container_list_size(bat_priv);
+	if (tvlv_value_len) {
+		blob = kmalloc(tvlv_value_len, GFP_ATOMIC);
+		if (!blob)
+			return false;
+	}
+
+	tvlv_value = blob;
+
+	hlist_for_each_entry(tvlv, &bat_priv->tvlv.container_list, list) {
+		tvlv_hdr = tvlv_value;
+		tvlv_hdr->type = tvlv->tvlv_hdr.type;
+		tvlv_hdr->version = tvlv->tvlv_hdr.version;
+		tvlv_hdr->len = tvlv->tvlv_hdr.len;
+		tvlv_value = tvlv_hdr + 1;
+		memcpy(tvlv_value, tvlv + 1, ntohs(tvlv->tvlv_hdr.len));
+		tvlv_value = (u8 *)tvlv_value + ntohs(tvlv->tvlv_hdr.len);
+	}
+
+	kfree(bat_priv->tvlv.blob);
+	bat_priv->tvlv.blob = blob;
+	bat_priv->tvlv.blob_len = tvlv_value_len;
+	bat_priv->tvlv.blob_dirty = false;
+
+	return true;
+}
+
 /**
  * batadv_tvlv_realloc_packet_buff() - reallocate packet buffer to accommodate
  *  requested packet size
@@ -286,6 +406,10 @@ static bool batadv_tvlv_realloc_packet_buff(unsigned char **packet_buff,
 {
 	unsigned char *new_buff;
 
+	/* buffer already has the right size - nothing to do */
+	if (*packet_buff_len == min_packet_len + additional_packet_len)
+		return true;
+
 	new_buff = kmalloc(min_packet_len + additional_packet_len, GFP_ATOMIC);
 
 	/* keep old buffer if kmalloc should fail */
@@ -310,7 +434,8 @@ static bool batadv_tvlv_realloc_packet_buff(unsigned char **packet_buff,
  * @packet_min_len: ogm header size to be preserved for the OGM itself
  *
  * The ogm packet might be enlarged or shrunk depending on the current size
- * and the size of the to-be-appended tvlv containers.
+ * and the size of the to-be-appended tvlv containers. The containers are only
+ * serialized again after they were modified.
  *
  * Return: size of all appended tvlv containers in bytes.
  */
@@ -318,41 +443,46 @@ u16 batadv_tvlv_container_ogm_append(struct batadv_priv *bat_priv,
 				     unsigned char **packet_buff,
 				     int *packet_buff_len, int packet_min_len)
 {
-	struct batadv_tvlv_container *tvlv;
-	struct batadv_tvlv_hdr *tvlv_hdr;
-	u16 tvlv_value_len;
-	void *tvlv_value;
+	u16 tvlv_value_len = 0;
 	bool ret;
 
 	spin_lock_bh(&bat_priv->tvlv.container_list_lock);
-	tvlv_value_len = batadv_tvlv_container_list_size(bat_priv);
+	if (!batadv_tvlv_blob_update(bat_priv))
+		goto end;
 
 	ret = batadv_tvlv_realloc_packet_buff(packet_buff, packet_buff_len,
-					      packet_min_len, tvlv_value_len);
+					      packet_min_len,
+					      bat_priv->tvlv.blob_len);
 
 	if (!ret)
 		goto end;
 
+	tvlv_value_len = bat_priv->tvlv.blob_len;
 	if (!tvlv_value_len)
 		goto end;
 
-	tvlv_value = (*packet_buff) + packet_min_len;
-
-	hlist_for_each_entry(tvlv, &bat_priv->tvlv.container_list, list) {
-		tvlv_hdr = tvlv_value;
-		tvlv_hdr->type = tvlv->tvlv_hdr.type;
-		tvlv_hdr->version = tvlv->tvlv_hdr.version;
-		tvlv_hdr->len = tvlv->tvlv_hdr.len;
-		tvlv_value = tvlv_hdr + 1;
-		memcpy(tvlv_value, tvlv + 1, ntohs(tvlv->tvlv_hdr.len));
-		tvlv_value = (u8 *)tvlv_value + ntohs(tvlv->tvlv_hdr.len);
-	}
+	memcpy(*packet_buff + packet_min_len, bat_priv->tvlv.blob,
+	       tvlv_value_len);
 
 end:
 	spin_unlock_bh(&bat_priv->tvlv.container_list_lock);
 	return tvlv_value_len;
 }
 
+/**
+ * batadv_tvlv_free() - free the serialized tvlv containers
+ * @bat_priv: the bat priv with all the soft interface information
+ */
+void batadv_tvlv_free(struct batadv_priv *bat_priv)
+{
+	spin_lock_bh(&bat_priv->tvlv.container_list_lock);
+	kfree(bat_priv->tvlv.blob);
+	bat_priv->tvlv.blob = NULL;
+	bat_priv->tvlv.blob_len = 0;
+	bat_priv->tvlv.blob_dirty = true;
+	spin_unlock_bh(&bat_priv->tvlv.container_list_lock);
+}
+
 /**
  * batadv_tvlv_call_handler() - parse the given tvlv buffer to call the
  *  appropriate handlers
@@ -364,6 +494,7 @@ end:
  * @dst: destination mac address of the unicast packet
  * @tvlv_value: tvlv content
  * @tvlv_value_len: tvlv content length
+ * @unchanged: the ogm tvlv buffer is the same as the last one of @orig_node
  *
  * Return: success if handler was not found or the return value of the handler
  * callback.
@@ -373,7 +504,8 @@ static int batadv_tvlv_call_handler(struct batadv_priv *bat_priv,
 				    bool ogm_source,
 				    struct batadv_orig_node *orig_node,
 				    u8 *src, u8 *dst,
-				    void *tvlv_value, u16 tvlv_value_len)
+				    void *tvlv_value, u16 tvlv_value_len,
+				    bool unchanged)
 {
 	if (!tvlv_handler)
 		return NET_RX_SUCCESS;
@@ -385,6 +517,10 @@ static int batadv_tvlv_call_handler(struct batadv_priv *bat_priv,
 		if (!orig_node)
 			return NET_RX_SUCCESS;
 
+		if (unchanged &&
+		    !(tvlv_handler->flags & BATADV_TVLV_HANDLER_OGM_ALWAYS))
+			return NET_RX_SUCCESS;
+
 		tvlv_handler->ogm_handler(bat_priv, orig_node,
 					  BATADV_NO_FLAGS,
 					  tvlv_value, tvlv_value_len);
@@ -407,6 +543,65 @@ static int batadv_tvlv_call_handler(struct batadv_priv *bat_priv,
 	return NET_RX_SUCCESS;
 }
 
+/**
+ * batadv_tvlv_ogm_unchanged() - check whether an OGM tvlv buffer is the same as
+ *  the last one processed for its originator
+ * @orig_node: orig node emitting the ogm packet
+ * @tvlv_value: tvlv content
+ * @tvlv_value_len: tvlv content length
+ *
+ * Return: true if the content is the same, false otherwise
+ */
+static bool batadv_tvlv_ogm_unchanged(struct batadv_orig_node *orig_node,
+				      const void *tvlv_value,
+				      u16 tvlv_value_len)
+{
+	struct batadv_tvlv_last *last;
+	bool unchanged = false;
+
+	rcu_read_lock();
+	last = rcu_dereference(orig_node->last_tvlv);
+	if (last && last->len == tvlv_value_len)
+		unchanged = !memcmp(last->value, tvlv_value, tvlv_value_len);
+	rcu_read_unlock();
+
+	return unchanged;
+}
+
+/**
+ * batadv_tvlv_ogm_remember() - keep a copy of the processed OGM tvlv buffer of
+ *  an originator
+ * @orig_node: orig node emitting the ogm packet
+ * @tvlv_value: tvlv content
+ * @tvlv_value_len: tvlv content length
+ *
+ * The next buffer is considered to be changed when the copy can't be
+ * allocated.
+ */
+static void batadv_tvlv_ogm_remember(struct batadv_orig_node *orig_node,
+				     const void *tvlv_value,
+				     u16 tvlv_value_len)
+{
+	spinlock_t *lock = &orig_node->last_tvlv_lock;
+	struct batadv_tvlv_last *last, *last_old;
+
+	last = kmalloc(sizeof(*last) + tvlv_value_len, GFP_ATOMIC);
+	if (last) {
+		last->len = tvlv_value_len;
+		memcpy(last->value, tvlv_value, tvlv_value_len);
+	}
+
+	/* OGMs of the same originator can be processed on several CPUs */
+	spin_lock_bh(lock);
+	last_old = rcu_dereference_protected(orig_node->last_tvlv,
+					     lockdep_is_held(lock));
+	rcu_assign_pointer(orig_node->last_tvlv, last);
+	spin_unlock_bh(lock);
+
+	if (last_old)
+		kfree_rcu(last_old, rcu);
+}
+
 /**
  * batadv_tvlv_containers_process() - parse the given tvlv buffer to call the
  *  appropriate handlers
@@ -418,6 +613,10 @@ static int batadv_tvlv_call_handler(struct batadv_priv *bat_priv,
  * @tvlv_value: tvlv content
  * @tvlv_value_len: tvlv content length
  *
+ * Handlers of OGM tvlvs are skipped when the tvlv buffer didn't change since
+ * the last OGM of @orig_node, unless they were registered with
+ * BATADV_TVLV_HANDLER_OGM_ALWAYS.
+ *
  * Return: success when processing an OGM or the return value of all called
  * handler callbacks.
  */
@@ -431,7 +630,14 @@ int batadv_tvlv_containers_process(struct batadv_priv *bat_priv,
 	struct batadv_tvlv_hdr *tvlv_hdr;
 	u16 tvlv_value_cont_len;
 	u8 cifnotfound = BATADV_TVLV_HANDLER_OGM_CIFNOTFND;
+	void *tvlv_buff = tvlv_value;
+	u16 tvlv_buff_len = tvlv_value_len;
 	int ret = NET_RX_SUCCESS;
+	bool unchanged = false;
+
+	if (ogm_source && orig_node)
+		unchanged = batadv_tvlv_ogm_unchanged(orig_node, tvlv_value,
+						      tvlv_value_len);
 
 	while (tvlv_value_len >= sizeof(*tvlv_hdr)) {
 		tvlv_hdr = tvlv_value;
@@ -449,7 +655,7 @@ int batadv_tvlv_containers_process(struct batadv_priv *bat_priv,
 		ret |= batadv_tvlv_call_handler(bat_priv, tvlv_handler,
 						ogm_source, orig_node,
 						src, dst, tvlv_value,
-						tvlv_value_cont_len);
+						tvlv_value_cont_len, unchanged);
 		if (tvlv_handler)
 			batadv_tvlv_handler_put(tvlv_handler);
 		tvlv_value = (u8 *)tvlv_value + tvlv_value_cont_len;
@@ -459,11 +665,15 @@ int batadv_tvlv_containers_process(struct batadv_priv *bat_priv,
 	if (!ogm_source)
 		return ret;
 
+	if (orig_node && !unchanged)
+		batadv_tvlv_ogm_remember(orig_node, tvlv_buff, tvlv_buff_len);
+
 	rcu_read_lock();
 	hlist_for_each_entry_rcu(tvlv_handler,
 				 &bat_priv->tvlv.handler_list, list) {
 		if ((tvlv_handler->flags & BATADV_TVLV_HANDLER_OGM_CIFNOTFND) &&
-		    !(tvlv_handler->flags & BATADV_TVLV_HANDLER_OGM_CALLED))
+		    !(tvlv_handler->flags & BATADV_TVLV_HANDLER_OGM_CALLED) &&
+		    !unchanged)
 			tvlv_handler->ogm_handler(bat_priv, orig_node,
 						  cifnotfound, NULL, 0);
 
@@ -527,6 +737,7 @@ void batadv_tvlv_handler_register(struct batadv_priv *bat_priv,
 					      u16 tvlv_value_len),
 				  u8 type, u8 version, u8 flags)
 {
+	int index = batadv_tvlv_handler_index(type, version);
 	struct batadv_tvlv_handler *tvlv_handler;
 
 	tvlv_handler = batadv_tvlv_handler_get(bat_priv, type, version);
@@ -550,6 +761,9 @@ void batadv_tvlv_handler_register(struct batadv_priv *bat_priv,
 	spin_lock_bh(&bat_priv->tvlv.handler_list_lock);
 	kref_get(&tvlv_handler->refcount);
 	hlist_add_head_rcu(&tvlv_handler->list, &bat_priv->tvlv.handler_list);
+	if (index >= 0)
+		rcu_assign_pointer(bat_priv->tvlv.handler_table[index],
+				   tvlv_handler);
 	spin_unlock_bh(&bat_priv->tvlv.handler_list_lock);
 
 	/* don't return reference to new tvlv_handler */
@@ -566,6 +780,7 @@ void batadv_tvlv_handler_register(struct batadv_priv *bat_priv,
 void batadv_tvlv_handler_unregister(struct batadv_priv *bat_priv,
 				    u8 type, u8 version)
 {
+	int index = batadv_tvlv_handler_index(type, version);
 	struct batadv_tvlv_handler *tvlv_handler;
 
 	tvlv_handler = batadv_tvlv_handler_get(bat_priv, type, version);
@@ -575,6 +790,8 @@ void batadv_tvlv_handler_unregister(struct batadv_priv *bat_priv,
 	batadv_tvlv_handler_put(tvlv_handler);
 	spin_lock_bh(&bat_priv->tvlv.handler_list_lock);
 	hlist_del_rcu(&tvlv_handler->list);
+	if (index >= 0)
+		RCU_INIT_POINTER(bat_priv->tvlv.handler_table[index], NULL);
 	spin_unlock_bh(&bat_priv->tvlv.handler_list_lock);
 	batadv_tvlv_handler_put(tvlv_handler);
 }
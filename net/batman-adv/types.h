@@ -25,12 +25,22 @@
 
 #include <linux/average.h>
 #include <linux/bitops.h>
+#include <linux/cache.h>
 #include <linux/compiler.h>
+#include <linux/hashtable.h>
+#include <linux/hrtimer.h>
+#include <linux/idr.h>
 #include <linux/if_ether.h>
+#include <linux/in6.h>
 #include <linux/kref.h>
+#include <linux/ktime.h>
+#include <linux/llist.h>
+#include <linux/mutex.h>
 #include <linux/netdevice.h>
 #include <linux/netlink.h>
 #include <linux/sched.h> /* for linux/wait.h */
+#include <linux/seqlock.h>
+#include <linux/skbuff.h>
 #include <linux/spinlock.h>
 #include <linux/types.h>
 #include <linux/wait.h>
@@ -79,6 +89,59 @@ enum batadv_dhcp_recipient {
  */
 #define BATADV_TT_SYNC_MASK	0x00F0
 
+/**
+ * struct batadv_iv_own_chunk - B.A.T.M.A.N. IV own OGM counters of a range of
+ *  originator slots on one hard-interface
+ */
+struct batadv_iv_own_chunk {
+	/**
+	 * @bcast_own: bitfields (one per originator slot) where each one counts
+	 * the number of our OGMs the originator rebroadcasted "back" to us
+	 * (relative to last_real_seqno). Every bitfield is
+	 * BATADV_TQ_LOCAL_WINDOW_SIZE bits long.
+	 */
+	unsigned long bcast_own[BATADV_IV_OWN_CHUNK_SLOTS][BATADV_NUM_WORDS];
+
+	/** @bcast_own_sum: sum of each bcast_own bitfield */
+	u8 bcast_own_sum[BATADV_IV_OWN_CHUNK_SLOTS];
+
+	/**
+	 * @bcast_own_seqno: own OGM sequence numbers up to which the
+	 * corresponding bcast_own bitfield was shifted. The bitfields are only
+	 * shifted when they are accessed.
+	 */
+	u32 bcast_own_seqno[BATADV_IV_OWN_CHUNK_SLOTS];
+};
+
+/**
+ * struct batadv_iv_own_slots - B.A.T.M.A.N. IV own OGM counters of all
+ *  originator slots on one hard-interface
+ */
+struct batadv_iv_own_slots {
+	/** @rcu: struct used for freeing in an RCU-safe manner */
+	struct rcu_head rcu;
+
+	/** @num_chunks: number of chunks in @chunks */
+	unsigned int num_chunks;
+
+	/** @chunks: counters of BATADV_IV_OWN_CHUNK_SLOTS slots each */
+	struct batadv_iv_own_chunk *chunks[];
+};
+
+/**
+ * struct batadv_ogm_backoff - state of an adaptive OGM interval
+ */
+struct batadv_ogm_backoff {
+	/**
+	 * @topology_gen: value of &batadv_priv.topology_gen when @interval was
+	 *  chosen
+	 */
+	u32 topology_gen;
+
+	/** @interval: current OGM interval in milliseconds (without jitter) */
+	unsigned int interval;
+};
+
 /**
  * struct batadv_hard_iface_bat_iv - per hard-interface B.A.T.M.A.N. IV data
  */
@@ -91,6 +154,22 @@ struct batadv_hard_iface_bat_iv {
 
 	/** @ogm_seqno: OGM sequence number - used to identify each OGM */
 	atomic_t ogm_seqno;
+
+	/**
+	 * @own_slots: own OGM counters of all originators on this interface,
+	 *  indexed by the originator slot
+	 */
+	struct batadv_iv_own_slots __rcu *own_slots;
+
+	/** @ogm_backoff: adaptive interval of the OGMs on this interface */
+	struct batadv_ogm_backoff ogm_backoff;
+
+	/**
+	 * @aggr_list: aggregated OGMs leaving on this interface which further
+	 *  OGMs can be added to, oldest first (protected by the lock of
+	 *  &batadv_priv.forw_bat)
+	 */
+	struct list_head aggr_list;
 };
 
 /**
@@ -124,15 +203,48 @@ struct batadv_hard_iface_bat_v {
 	/** @elp_skb: base skb containing the ELP message to send */
 	struct sk_buff *elp_skb;
 
+	/**
+	 * @elp_probe_skb: base skb containing the zero padded unicast ELP
+	 *  probe, with room for all headers of the outgoing interface
+	 */
+	struct sk_buff *elp_probe_skb;
+
 	/** @elp_wq: workqueue used to schedule ELP transmissions */
 	struct delayed_work elp_wq;
 
+	/** @elp_due: time (jiffies) the next ELP transmission is planned for */
+	unsigned long elp_due;
+
+	/** @aggr_wq: workqueue used to transmit queued OGM packets */
+	struct delayed_work aggr_wq;
+
+	/** @aggr_list: queue for to be aggregated OGM packets */
+	struct sk_buff_head aggr_list;
+
+	/** @aggr_len: size of the OGM aggregate (excluding ethernet header) */
+	unsigned int aggr_len;
+
+	/** @aggr_list_lock: protects aggr_list and aggr_len */
+	spinlock_t aggr_list_lock;
+
 	/**
 	 * @throughput_override: throughput override to disable link
 	 *  auto-detection
 	 */
 	atomic_t throughput_override;
 
+	/**
+	 * @link_throughput: link throughput reported by ethtool (in multiples
+	 *  of 100kbps, 0 if not available), shared by all neighbours
+	 */
+	u32 link_throughput;
+
+	/** @link_updated: time (jiffies) @link_throughput was queried at */
+	unsigned long link_updated;
+
+	/** @link_valid: whether @link_throughput was queried already */
+	bool link_valid;
+
 	/** @flags: interface specific flags */
 	u8 flags;
 };
@@ -160,6 +272,61 @@ enum batadv_hard_iface_wifi_flags {
 	BATADV_HARDIF_WIFI_CFG80211_INDIRECT = BIT(3),
 };
 
+/**
+ * struct batadv_hardif_addr - MAC address of a hard interface of a mesh
+ */
+struct batadv_hardif_addr {
+	/** @list: list node for &batadv_hardif_addrs.table */
+	struct hlist_node list;
+
+	/**
+	 * @hard_iface: the hard interface, valid as long as the set can be
+	 *  accessed
+	 */
+	const struct batadv_hard_iface *hard_iface;
+
+	/** @addr: MAC address of the hard interface */
+	u8 addr[ETH_ALEN];
+};
+
+/**
+ * struct batadv_hardif_addrs - set of MAC addresses of the hard interfaces
+ *  which are in use by a mesh
+ *
+ * The set is never modified after it was published. It is replaced as a whole
+ * when one of the hard interfaces changes its state or address.
+ */
+struct batadv_hardif_addrs {
+	/** @table: hash buckets containing the entries of @entries */
+	struct hlist_head table[BATADV_HARDIF_ADDR_BUCKETS];
+
+	/** @rcu: struct used for freeing in an RCU-safe manner */
+	struct rcu_head rcu;
+
+	/** @entries: the stored addresses */
+	struct batadv_hardif_addr entries[];
+};
+
+/**
+ * enum batadv_hardif_counters - per hard interface traffic counters
+ */
+enum batadv_hardif_counters {
+	/** @BATADV_HARDIF_CNT_TX: transmitted packet counter */
+	BATADV_HARDIF_CNT_TX,
+
+	/** @BATADV_HARDIF_CNT_TX_BYTES: transmitted bytes counter */
+	BATADV_HARDIF_CNT_TX_BYTES,
+
+	/** @BATADV_HARDIF_CNT_RX: received packet counter */
+	BATADV_HARDIF_CNT_RX,
+
+	/** @BATADV_HARDIF_CNT_RX_BYTES: received bytes counter */
+	BATADV_HARDIF_CNT_RX_BYTES,
+
+	/** @BATADV_HARDIF_CNT_NUM: number of hard interface counters */
+	BATADV_HARDIF_CNT_NUM,
+};
+
 /**
  * struct batadv_hard_iface - network device known to batman-adv
  */
@@ -228,8 +395,19 @@ struct batadv_hard_iface {
 	 */
 	struct hlist_head neigh_list;
 
-	/** @neigh_list_lock: lock protecting neigh_list */
+	/**
+	 * @neigh_hash: the entries of neigh_list hashed by neighbor address
+	 */
+	DECLARE_HASHTABLE(neigh_hash, BATADV_HARDIF_NEIGH_HASH_BITS);
+
+	/** @neigh_list_lock: lock protecting neigh_list and neigh_hash */
 	spinlock_t neigh_list_lock;
+
+	/** @num_neighs: number of entries in neigh_list */
+	atomic_t num_neighs;
+
+	/** @counters: per cpu traffic counters of the interface */
+	u64 __percpu *counters;
 };
 
 /**
@@ -271,12 +449,12 @@ struct batadv_frag_table_entry {
 	/** @fragment_list: head of list with fragments */
 	struct hlist_head fragment_list;
 
-	/** @lock: lock to protect the list of fragments */
-	spinlock_t lock;
-
 	/** @timestamp: time (jiffie) of last received fragment */
 	unsigned long timestamp;
 
+	/** @truesize: memory used by the fragments in the list */
+	unsigned int truesize;
+
 	/** @seqno: sequence number of the fragments in the list */
 	u16 seqno;
 
@@ -287,6 +465,20 @@ struct batadv_frag_table_entry {
 	u16 total_size;
 };
 
+/**
+ * struct batadv_frag_table - fragment buffer table of an originator
+ */
+struct batadv_frag_table {
+	/** @timestamp: time (jiffie) of last received fragment */
+	unsigned long timestamp;
+
+	/** @num_chains: number of entries in @chains */
+	u16 num_chains;
+
+	/** @chains: heads for fragment chains, indexed by seqno */
+	struct batadv_frag_table_entry chains[];
+};
+
 /**
  * struct batadv_frag_list_entry - entry in a list of fragments
  */
@@ -308,6 +500,15 @@ struct batadv_vlan_tt {
 	/** @crc: CRC32 checksum of the entries belonging to this vlan */
 	u32 crc;
 
+	/**
+	 * @crc_acc: xor of the CRC32C of all entries currently belonging to
+	 *  this vlan. Copied to @crc whenever the table is committed/updated
+	 */
+	u32 crc_acc;
+
+	/** @crc_lock: lock protecting @crc_acc */
+	spinlock_t crc_lock;
+
 	/** @num_entries: number of TT entries for this VLAN */
 	atomic_t num_entries;
 };
@@ -325,6 +526,9 @@ struct batadv_orig_node_vlan {
 	/** @list: list node for &batadv_orig_node.vlan_list */
 	struct hlist_node list;
 
+	/** @hash_entry: hlist node for &batadv_orig_node.vlan_hash */
+	struct hlist_node hash_entry;
+
 	/**
 	 * @refcount: number of context where this object is currently in use
 	 */
@@ -339,23 +543,85 @@ struct batadv_orig_node_vlan {
  */
 struct batadv_orig_bat_iv {
 	/**
-	 * @bcast_own: set of bitfields (one per hard-interface) where each one
-	 * counts the number of our OGMs this orig_node rebroadcasted "back" to
-	 * us  (relative to last_real_seqno). Every bitfield is
-	 * BATADV_TQ_LOCAL_WINDOW_SIZE bits long.
+	 * @own_slot: index of the own OGM counters of this orig_node in the
+	 *  per hard-interface own_slots or -1 if none was assigned
 	 */
-	unsigned long *bcast_own;
-
-	/** @bcast_own_sum: sum of bcast_own */
-	u8 *bcast_own_sum;
+	int own_slot;
 
 	/**
-	 * @ogm_cnt_lock: lock protecting bcast_own, bcast_own_sum,
+	 * @ogm_cnt_lock: lock protecting the own OGM counters of @own_slot,
 	 * neigh_node->bat_iv.real_bits & neigh_node->bat_iv.real_packet_count
 	 */
 	spinlock_t ogm_cnt_lock;
 };
 
+/**
+ * struct batadv_orig_bonding_cand - bonding candidate towards an originator
+ */
+struct batadv_orig_bonding_cand {
+	/** @router: referenced router of an outgoing interface */
+	struct batadv_neigh_node *router;
+
+	/** @weight: share of the flows towards the originator sent via @router */
+	u32 weight;
+
+	/**
+	 * @key: hash of the address and the interface of @router, stays the
+	 *  same when the set is rebuilt
+	 */
+	u32 key;
+};
+
+/**
+ * struct batadv_orig_bonding_set - precomputed bonding candidates towards an
+ *  originator
+ */
+struct batadv_orig_bonding_set {
+	/** @rcu: struct used for freeing in an RCU-safe manner */
+	struct rcu_head rcu;
+
+	/** @timestamp: when the candidates were computed (jiffies) */
+	unsigned long timestamp;
+
+	/** @num: number of candidates in @cands */
+	u32 num;
+
+	/**
+	 * @cands: routers which are similar or better than the router of the
+	 *  default interface
+	 */
+	struct batadv_orig_bonding_cand cands[];
+};
+
+/**
+ * struct batadv_seqno_window - sliding window of received sequence numbers
+ *  which can be updated without locks
+ */
+struct batadv_seqno_window {
+	/** @last_seqno: newest sequence number received */
+	atomic_t last_seqno;
+
+	/**
+	 * @seqnos: newest sequence number received per slot, indexed by the
+	 *  sequence number modulo BATADV_BCAST_MAX_AGE
+	 */
+	atomic_t seqnos[BATADV_BCAST_MAX_AGE];
+};
+
+/**
+ * struct batadv_tvlv_last - copy of the last OGM tvlv buffer of an originator
+ */
+struct batadv_tvlv_last {
+	/** @rcu: struct used for freeing in an RCU-safe manner */
+	struct rcu_head rcu;
+
+	/** @len: length of @value */
+	u16 len;
+
+	/** @value: the tvlv buffer */
+	u8 value[];
+};
+
 /**
  * struct batadv_orig_node - structure for orig_list maintaining nodes of mesh
  */
@@ -367,9 +633,13 @@ struct batadv_orig_node {
 	struct hlist_head ifinfo_list;
 
 	/**
-	 * @last_bonding_candidate: pointer to last ifinfo of last used router
+	 * @bonding_set: bonding candidates towards this originator, dropped
+	 *  whenever one of its routers changes
 	 */
-	struct batadv_orig_ifinfo *last_bonding_candidate;
+	struct batadv_orig_bonding_set __rcu *bonding_set;
+
+	/** @bonding_rr: round robin index into @bonding_set */
+	atomic_t bonding_rr;
 
 #ifdef CONFIG_BATMAN_ADV_DAT
 	/** @dat_addr: address of the orig node in the distributed hash */
@@ -379,6 +649,22 @@ struct batadv_orig_node {
 	/** @last_seen: time when last packet from this node was received */
 	unsigned long last_seen;
 
+	/**
+	 * @path_mtu: smallest MTU of the mesh interfaces on the path towards
+	 *  this node as announced in its OGMs received via the best next hop,
+	 *  0 if unknown
+	 */
+	u16 path_mtu;
+
+	/**
+	 * @last_tvlv: copy of the last tvlv buffer processed for an OGM of this
+	 *  node, NULL if none was processed yet
+	 */
+	struct batadv_tvlv_last __rcu *last_tvlv;
+
+	/** @last_tvlv_lock: lock protecting the replacement of @last_tvlv */
+	spinlock_t last_tvlv_lock;
+
 	/**
 	 * @bcast_seqno_reset: time when the broadcast seqno window was reset
 	 */
@@ -423,6 +709,64 @@ struct batadv_orig_node {
 	/** @last_ttvn: last seen translation table version number */
 	atomic_t last_ttvn;
 
+	/** @tt_global_num: number of global TT entries announced by this node */
+	atomic_t tt_global_num;
+
+	/**
+	 * @tt_over_limit: entries of this node were dropped because
+	 *  &batadv_priv_tt.global_max_entries was reached, its TT CRC cannot
+	 *  match
+	 */
+	bool tt_over_limit;
+
+	/** @tt_over_limit_at: time (jiffies) an entry was last dropped */
+	unsigned long tt_over_limit_at;
+
+	/**
+	 * @router_changed: time (jiffies) the router towards this originator
+	 *  on the default interface was last changed
+	 */
+	unsigned long router_changed;
+
+	/**
+	 * @fisheye_ttvn: translation table version of the last OGM which was
+	 *  forwarded because it announced a new version
+	 */
+	u8 fisheye_ttvn;
+
+	/** @fisheye_seqno: sequence number of the OGM with @fisheye_ttvn */
+	u32 fisheye_seqno;
+
+	/**
+	 * @tt_crc_gen: incremented whenever the global TT CRCs of this node are
+	 *  recomputed (protected by tt_lock)
+	 */
+	u32 tt_crc_gen;
+
+	/**
+	 * @tt_ogm_digest: jhash of the last TT tvlv of this node which was
+	 *  found to be consistent with the global table
+	 */
+	u32 tt_ogm_digest;
+
+	/** @tt_ogm_gen: value of @tt_crc_gen when @tt_ogm_digest was checked */
+	u32 tt_ogm_gen;
+
+	/** @tt_ogm_checked: time when @tt_ogm_digest was checked */
+	unsigned long tt_ogm_checked;
+
+	/**
+	 * @tt_chunk_next: number of entries received of an incomplete chunked
+	 *  full table transfer (protected by tt_lock)
+	 */
+	u32 tt_chunk_next;
+
+	/**
+	 * @tt_chunk_ttvn: ttvn of the incomplete chunked full table transfer
+	 *  (protected by tt_lock)
+	 */
+	u8 tt_chunk_ttvn;
+
 	/** @tt_buff: last tt changeset this node received from the orig node */
 	unsigned char *tt_buff;
 
@@ -445,17 +789,17 @@ struct batadv_orig_node {
 	spinlock_t tt_lock;
 
 	/**
-	 * @bcast_bits: bitfield containing the info which payload broadcast
-	 *  originated from this orig node this host already has seen (relative
-	 *  to last_bcast_seqno)
+	 * @bcast_window: payload broadcasts originated from this orig node
+	 *  which this host already has seen
 	 */
-	DECLARE_BITMAP(bcast_bits, BATADV_TQ_LOCAL_WINDOW_SIZE);
+	struct batadv_seqno_window bcast_window;
 
 	/**
-	 * @last_bcast_seqno: last broadcast sequence number received by this
-	 *  host
+	 * @bcast_dups: number of duplicates received of the broadcasts in
+	 *  bcast_window, indexed by the sequence number modulo
+	 *  BATADV_BCAST_MAX_AGE
 	 */
-	u32 last_bcast_seqno;
+	atomic_t bcast_dups[BATADV_BCAST_MAX_AGE];
 
 	/**
 	 * @neigh_list: list of potential next hop neighbor towards this orig
@@ -465,7 +809,7 @@ struct batadv_orig_node {
 
 	/**
 	 * @neigh_list_lock: lock protecting neigh_list, ifinfo_list,
-	 *  last_bonding_candidate and router
+	 *  bonding_set and router
 	 */
 	spinlock_t neigh_list_lock;
 
@@ -475,7 +819,10 @@ struct batadv_orig_node {
 	/** @bat_priv: pointer to soft_iface this orig node belongs to */
 	struct batadv_priv *bat_priv;
 
-	/** @bcast_seqno_lock: lock protecting bcast_bits & last_bcast_seqno */
+	/**
+	 * @bcast_seqno_lock: lock serializing the resets of bcast_window and
+	 *  bcast_seqno_reset when the originator restarted
+	 */
 	spinlock_t bcast_seqno_lock;
 
 	/** @refcount: number of contexts the object is used */
@@ -498,8 +845,14 @@ struct batadv_orig_node {
 	spinlock_t out_coding_list_lock;
 #endif
 
-	/** @fragments: array with heads for fragment chains */
-	struct batadv_frag_table_entry fragments[BATADV_FRAG_BUFFER_COUNT];
+	/** @frag_lock: lock protecting frag_table and its fragment chains */
+	spinlock_t frag_lock;
+
+	/**
+	 * @frag_table: fragment chains, only allocated when fragments are
+	 *  received from this originator
+	 */
+	struct batadv_frag_table *frag_table;
 
 	/**
 	 * @vlan_list: a list of orig_node_vlan structs, one per VLAN served by
@@ -507,7 +860,10 @@ struct batadv_orig_node {
 	 */
 	struct hlist_head vlan_list;
 
-	/** @vlan_list_lock: lock protecting vlan_list */
+	/** @vlan_hash: the entries of vlan_list hashed by VLAN identifier */
+	DECLARE_HASHTABLE(vlan_hash, BATADV_ORIG_VLAN_HASH_BITS);
+
+	/** @vlan_list_lock: lock protecting vlan_list and vlan_hash */
 	spinlock_t vlan_list_lock;
 
 	/** @bat_iv: B.A.T.M.A.N. IV private structure */
@@ -524,9 +880,21 @@ enum batadv_orig_capabilities {
 	 */
 	BATADV_ORIG_CAPA_HAS_DAT,
 
+	/**
+	 * @BATADV_ORIG_CAPA_HAS_DAT_ND: orig node also caches and answers IPv6
+	 *  neighbor discovery messages in its distributed arp table
+	 */
+	BATADV_ORIG_CAPA_HAS_DAT_ND,
+
 	/** @BATADV_ORIG_CAPA_HAS_NC: orig node has network coding enabled */
 	BATADV_ORIG_CAPA_HAS_NC,
 
+	/**
+	 * @BATADV_ORIG_CAPA_HAS_NC_MULTI: orig node is able to decode network
+	 *  coded packets combining more than two packets
+	 */
+	BATADV_ORIG_CAPA_HAS_NC_MULTI,
+
 	/** @BATADV_ORIG_CAPA_HAS_TT: orig node has tt capability */
 	BATADV_ORIG_CAPA_HAS_TT,
 
@@ -535,6 +903,12 @@ enum batadv_orig_capabilities {
 	 *  (= orig node announces a tvlv of type BATADV_TVLV_MCAST)
 	 */
 	BATADV_ORIG_CAPA_HAS_MCAST,
+
+	/**
+	 * @BATADV_ORIG_CAPA_HAS_UNICAST_AGG: orig node is able to receive
+	 *  aggregated unicast packets
+	 */
+	BATADV_ORIG_CAPA_HAS_UNICAST_AGG,
 };
 
 /**
@@ -553,6 +927,13 @@ struct batadv_gw_node {
 	/** @bandwidth_up: advertised uplink upload bandwidth */
 	u32 bandwidth_up;
 
+	/**
+	 * @metric: ranking of this gateway as computed by the gw.metric() op
+	 *  of the routing algorithm when its last OGM was processed (higher is
+	 *  better, 0 if it is unreachable)
+	 */
+	u64 metric;
+
 	/** @refcount: number of contexts the object is used */
 	struct kref refcount;
 
@@ -561,6 +942,7 @@ struct batadv_gw_node {
 };
 
 DECLARE_EWMA(throughput, 10, 8)
+DECLARE_EWMA(throughput_dev, 10, 4)
 
 /**
  * struct batadv_hardif_neigh_node_bat_v - B.A.T.M.A.N. V private neighbor
@@ -570,6 +952,12 @@ struct batadv_hardif_neigh_node_bat_v {
 	/** @throughput: ewma link throughput towards this neighbor */
 	struct ewma_throughput throughput;
 
+	/**
+	 * @throughput_dev: ewma of the deviation of the link throughput
+	 *  samples from @throughput
+	 */
+	struct ewma_throughput_dev throughput_dev;
+
 	/** @elp_interval: time interval between two ELP transmissions */
 	u32 elp_interval;
 
@@ -582,6 +970,54 @@ struct batadv_hardif_neigh_node_bat_v {
 	 */
 	unsigned long last_unicast_tx;
 
+	/** @tx_bytes: unicast bytes handed to the device for this neighbor */
+	atomic64_t tx_bytes;
+
+	/** @tx_packets: unicast packets handed to the device for this neighbor */
+	atomic64_t tx_packets;
+
+	/**
+	 * @tx_dropped: unicast packets towards this neighbor which were dropped
+	 *  by the device or its queueing discipline
+	 */
+	atomic64_t tx_dropped;
+
+	/**
+	 * @tx_retries: retransmissions towards this neighbor as reported by the
+	 *  wifi driver
+	 */
+	u32 tx_retries;
+
+	/**
+	 * @tx_failed: failed transmissions towards this neighbor as reported by
+	 *  the wifi driver
+	 */
+	u32 tx_failed;
+
+	/**
+	 * @tx_rate: ewma of the unicast rate sent to this neighbor (in multiples
+	 *  of 100kbps)
+	 */
+	struct ewma_throughput tx_rate;
+
+	/** @capacity_bytes: @tx_bytes at the last capacity estimation */
+	u64 capacity_bytes;
+
+	/** @capacity_time: jiffies of the last capacity estimation */
+	unsigned long capacity_time;
+
+	/**
+	 * @utilization: share (in percent) of the link throughput used by the
+	 *  unicast traffic towards this neighbor
+	 */
+	u32 utilization;
+
+	/**
+	 * @capacity: link throughput still available towards this neighbor (in
+	 *  multiples of 100kbps)
+	 */
+	u32 capacity;
+
 	/** @metric_work: work queue callback item for metric update */
 	struct work_struct metric_work;
 };
@@ -593,6 +1029,9 @@ struct batadv_hardif_neigh_node {
 	/** @list: list node for &batadv_hard_iface.neigh_list */
 	struct hlist_node list;
 
+	/** @hash_entry: hlist node for &batadv_hard_iface.neigh_hash */
+	struct hlist_node hash_entry;
+
 	/** @addr: the MAC address of the neighboring interface */
 	u8 addr[ETH_ALEN];
 
@@ -607,6 +1046,24 @@ struct batadv_hardif_neigh_node {
 	/** @last_seen: when last packet via this neighbor was received */
 	unsigned long last_seen;
 
+	/**
+	 * @agg_queue: small unicast packets waiting to be sent to this neighbor
+	 *  in one aggregate
+	 */
+	struct sk_buff_head agg_queue;
+
+	/**
+	 * @agg_len: size of the packets in agg_queue including their length
+	 *  fields
+	 */
+	unsigned int agg_len;
+
+	/** @agg_lock: protects agg_queue and agg_len */
+	spinlock_t agg_lock;
+
+	/** @agg_work: work item flushing agg_queue after the aggregation delay */
+	struct delayed_work agg_work;
+
 #ifdef CONFIG_BATMAN_ADV_BATMAN_V
 	/** @bat_v: B.A.T.M.A.N. V private data */
 	struct batadv_hardif_neigh_node_bat_v bat_v;
@@ -738,6 +1195,21 @@ struct batadv_bcast_duplist_entry {
 	/** @entrytime: time when the broadcast packet was received */
 	unsigned long entrytime;
 };
+
+/**
+ * struct batadv_bcast_duplist_bucket - set of broadcast duplicate entries
+ *  sharing the same crc based index
+ */
+struct batadv_bcast_duplist_bucket {
+	/** @seq: allows lockless readers to detect concurrent updates */
+	seqcount_t seq;
+
+	/** @lock: serializes writers of @entries */
+	spinlock_t lock;
+
+	/** @entries: recently received broadcast packets of this bucket */
+	struct batadv_bcast_duplist_entry entries[BATADV_DUPLIST_WAYS];
+} ____cacheline_aligned_in_smp;
 #endif
 
 /**
@@ -756,6 +1228,12 @@ enum batadv_counters {
 	 */
 	BATADV_CNT_TX_DROPPED,
 
+	/**
+	 * @BATADV_CNT_TX_BCAST_SUPPRESSED: repeated client broadcasts which
+	 *  were not flooded because an identical one was sent shortly before
+	 */
+	BATADV_CNT_TX_BCAST_SUPPRESSED,
+
 	/** @BATADV_CNT_RX: received payload traffic packet counter */
 	BATADV_CNT_RX,
 
@@ -793,6 +1271,61 @@ enum batadv_counters {
 	 */
 	BATADV_CNT_MGMT_RX_BYTES,
 
+	/**
+	 * @BATADV_CNT_RX_DROP_VERSION: received packets dropped because of an
+	 *  incompatible protocol version
+	 */
+	BATADV_CNT_RX_DROP_VERSION,
+
+	/**
+	 * @BATADV_CNT_RX_DROP_UNKNOWN: received packets dropped because of an
+	 *  unknown packet type
+	 */
+	BATADV_CNT_RX_DROP_UNKNOWN,
+
+	/** @BATADV_CNT_RX_DROP_OGM: received OGM packets dropped */
+	BATADV_CNT_RX_DROP_OGM,
+
+	/** @BATADV_CNT_RX_DROP_OGM2: received OGM2 packets dropped */
+	BATADV_CNT_RX_DROP_OGM2,
+
+	/** @BATADV_CNT_RX_DROP_ELP: received ELP packets dropped */
+	BATADV_CNT_RX_DROP_ELP,
+
+	/** @BATADV_CNT_RX_DROP_BCAST: received broadcast packets dropped */
+	BATADV_CNT_RX_DROP_BCAST,
+
+	/** @BATADV_CNT_RX_DROP_CODED: received network coded packets dropped */
+	BATADV_CNT_RX_DROP_CODED,
+
+	/** @BATADV_CNT_RX_DROP_ICMP: received ICMP packets dropped */
+	BATADV_CNT_RX_DROP_ICMP,
+
+	/** @BATADV_CNT_RX_DROP_UNICAST: received unicast packets dropped */
+	BATADV_CNT_RX_DROP_UNICAST,
+
+	/**
+	 * @BATADV_CNT_RX_DROP_UNICAST_FRAG: received fragment packets dropped
+	 */
+	BATADV_CNT_RX_DROP_UNICAST_FRAG,
+
+	/**
+	 * @BATADV_CNT_RX_DROP_UNICAST_4ADDR: received 4addr unicast packets
+	 *  dropped
+	 */
+	BATADV_CNT_RX_DROP_UNICAST_4ADDR,
+
+	/**
+	 * @BATADV_CNT_RX_DROP_UNICAST_TVLV: received unicast TVLV packets
+	 *  dropped
+	 */
+	BATADV_CNT_RX_DROP_UNICAST_TVLV,
+
+	/**
+	 * @BATADV_CNT_RX_DROP_UNICAST_AGG: received unicast aggregates dropped
+	 */
+	BATADV_CNT_RX_DROP_UNICAST_AGG,
+
 	/** @BATADV_CNT_FRAG_TX: transmitted fragment traffic packet counter */
 	BATADV_CNT_FRAG_TX,
 
@@ -818,7 +1351,64 @@ enum batadv_counters {
 	BATADV_CNT_FRAG_FWD_BYTES,
 
 	/**
-	 * @BATADV_CNT_TT_REQUEST_TX: transmitted tt req traffic packet counter
+	 * @BATADV_CNT_FRAG_EVICT: incomplete fragment chains evicted by a newer
+	 *  fragment sequence
+	 */
+	BATADV_CNT_FRAG_EVICT,
+
+	/**
+	 * @BATADV_CNT_FRAG_MEM_DROP: received fragments dropped because the
+	 *  fragment buffer memory limit was reached
+	 */
+	BATADV_CNT_FRAG_MEM_DROP,
+
+	/** @BATADV_CNT_AGG_TX: transmitted unicast aggregates counter */
+	BATADV_CNT_AGG_TX,
+
+	/**
+	 * @BATADV_CNT_AGG_TX_PACKETS: unicast packets transmitted as part of an
+	 *  aggregate
+	 */
+	BATADV_CNT_AGG_TX_PACKETS,
+
+	/**
+	 * @BATADV_CNT_HEADROOM_ENCAP: packets reallocated to push a batman-adv
+	 *  header in front of them
+	 */
+	BATADV_CNT_HEADROOM_ENCAP,
+
+	/**
+	 * @BATADV_CNT_HEADROOM_FWD: received packets reallocated to modify and
+	 *  forward them
+	 */
+	BATADV_CNT_HEADROOM_FWD,
+
+	/**
+	 * @BATADV_CNT_HEADROOM_LL: packets reallocated to push the header of the
+	 *  outgoing hard interface in front of them
+	 */
+	BATADV_CNT_HEADROOM_LL,
+
+	/**
+	 * @BATADV_CNT_CTRL_TX: transmitted routing protocol and other mesh
+	 *  management packets
+	 */
+	BATADV_CNT_CTRL_TX,
+
+	/**
+	 * @BATADV_CNT_CTRL_DELAY: microseconds the scheduled routing protocol
+	 *  messages were sent later than planned, in total
+	 */
+	BATADV_CNT_CTRL_DELAY,
+
+	/**
+	 * @BATADV_CNT_BCAST_DELAY: microseconds the scheduled broadcasts were
+	 *  sent later than planned, in total
+	 */
+	BATADV_CNT_BCAST_DELAY,
+
+	/**
+	 * @BATADV_CNT_TT_REQUEST_TX: transmitted tt req traffic packet counter
 	 */
 	BATADV_CNT_TT_REQUEST_TX,
 
@@ -847,6 +1437,26 @@ enum batadv_counters {
 	 */
 	BATADV_CNT_TT_ROAM_ADV_RX,
 
+	/**
+	 * @BATADV_CNT_TT_GLOBAL_LIMIT_DROP: global TT entries not added because
+	 *  their originator reached &batadv_priv_tt.global_max_entries
+	 */
+	BATADV_CNT_TT_GLOBAL_LIMIT_DROP,
+
+	/**
+	 * @BATADV_CNT_ORIG_LIMIT_DROP: originators not added because
+	 *  &batadv_priv.orig_max_entries was reached
+	 */
+	BATADV_CNT_ORIG_LIMIT_DROP,
+
+#ifdef CONFIG_BATMAN_ADV_BLA
+	/**
+	 * @BATADV_CNT_BLA_DROP: payload traffic packet counter handled and not
+	 *  forwarded by the bridge loop avoidance
+	 */
+	BATADV_CNT_BLA_DROP,
+#endif
+
 #ifdef CONFIG_BATMAN_ADV_DAT
 	/**
 	 * @BATADV_CNT_DAT_GET_TX: transmitted dht GET traffic packet counter
@@ -869,6 +1479,24 @@ enum batadv_counters {
 	 *  packet counter
 	 */
 	BATADV_CNT_DAT_CACHED_REPLY_TX,
+
+	/**
+	 * @BATADV_CNT_DAT_CACHE_HIT: ARP requests which could be resolved via
+	 *  the local DAT cache
+	 */
+	BATADV_CNT_DAT_CACHE_HIT,
+
+	/**
+	 * @BATADV_CNT_DAT_CACHE_MISS: ARP requests which could not be resolved
+	 *  via the local DAT cache
+	 */
+	BATADV_CNT_DAT_CACHE_MISS,
+
+	/**
+	 * @BATADV_CNT_DAT_CACHE_EVICT: DAT cache entries removed before their
+	 *  timeout to stay below &batadv_priv_dat.max_entries
+	 */
+	BATADV_CNT_DAT_CACHE_EVICT,
 #endif
 
 #ifdef CONFIG_BATMAN_ADV_NC
@@ -929,6 +1557,63 @@ enum batadv_counters {
 	BATADV_CNT_NUM,
 };
 
+/**
+ * struct batadv_tt_tx_cache_entry - cached result of a translation table
+ *  lookup
+ */
+struct batadv_tt_tx_cache_entry {
+	/** @addr: the MAC address of the client */
+	u8 addr[ETH_ALEN];
+
+	/** @vid: VLAN identifier */
+	unsigned short vid;
+
+	/** @gen: value of tt.tx_cache_gen when the lookup was done */
+	u32 gen;
+
+	/**
+	 * @orig_node: originator serving the client (not referenced, only
+	 *  valid as long as @gen is current)
+	 */
+	struct batadv_orig_node *orig_node;
+};
+
+/**
+ * struct batadv_tt_bloom - counting bloom filter over the clients of a TT hash
+ */
+struct batadv_tt_bloom {
+	/** @lock: serializes updates of @counters */
+	spinlock_t lock;
+
+	/**
+	 * @counters: number of clients mapped to each counter. Saturated
+	 *  counters (U8_MAX) are never decremented again
+	 */
+	u8 counters[BATADV_TT_BLOOM_SIZE];
+};
+
+/**
+ * struct batadv_tt_tx_cache - per-CPU translation table lookup cache
+ */
+struct batadv_tt_tx_cache {
+	/** @entries: cached lookups, indexed by a hash of addr and vid */
+	struct batadv_tt_tx_cache_entry entries[BATADV_TT_TX_CACHE_SIZE];
+};
+
+/**
+ * struct batadv_tt_tombstone - client removed from the global table
+ */
+struct batadv_tt_tombstone {
+	/** @addr: mac address of the removed client */
+	u8 addr[ETH_ALEN];
+
+	/** @vid: VLAN identifier of the removed client */
+	unsigned short vid;
+
+	/** @generation: generation of the global table after the removal */
+	u32 generation;
+};
+
 /**
  * struct batadv_priv_tt - per mesh interface translation table data
  */
@@ -936,6 +1621,27 @@ struct batadv_priv_tt {
 	/** @vn: translation table version number */
 	atomic_t vn;
 
+	/**
+	 * @global_max_entries: maximum number of entries in @global_hash
+	 *  announced by a single originator (0 = unlimited)
+	 */
+	atomic_t global_max_entries;
+
+	/** @local_bloom: bloom filter over the clients of @local_hash */
+	struct batadv_tt_bloom *local_bloom;
+
+	/** @global_bloom: bloom filter over the clients of @global_hash */
+	struct batadv_tt_bloom *global_bloom;
+
+	/** @tx_cache: per-CPU cache of batadv_transtable_search() results */
+	struct batadv_tt_tx_cache __percpu *tx_cache;
+
+	/**
+	 * @tx_cache_gen: generation of @tx_cache, increased whenever a TT
+	 *  orig list or a route changes
+	 */
+	atomic_t tx_cache_gen;
+
 	/**
 	 * @ogm_append_cnt: counter of number of OGMs containing the local tt
 	 *  diff
@@ -950,28 +1656,44 @@ struct batadv_priv_tt {
 	 */
 	struct list_head changes_list;
 
+	/**
+	 * @changes_hash: the entries of changes_list hashed by client mac
+	 *  address and VLAN to coalesce the changes of the same client
+	 */
+	DECLARE_HASHTABLE(changes_hash, BATADV_TT_CHANGES_HASH_BITS);
+
 	/** @local_hash: local translation table hash table */
 	struct batadv_hashtable *local_hash;
 
 	/** @global_hash: global translation table hash table */
 	struct batadv_hashtable *global_hash;
 
-	/** @req_list: list of pending & unanswered tt_requests */
-	struct hlist_head req_list;
+	/**
+	 * @req_list: list of pending & unanswered tt_requests, the most recent
+	 *  one first
+	 */
+	struct list_head req_list;
+
+	/** @req_hash: the entries of req_list hashed by originator address */
+	DECLARE_HASHTABLE(req_hash, BATADV_TT_REQ_HASH_BITS);
 
 	/**
 	 * @roam_list: list of the last roaming events of each client limiting
-	 *  the number of roaming events to avoid route flapping
+	 *  the number of roaming events to avoid route flapping, the most
+	 *  recent one first
 	 */
 	struct list_head roam_list;
 
-	/** @changes_list_lock: lock protecting changes_list */
+	/** @roam_hash: the entries of roam_list hashed by client address */
+	DECLARE_HASHTABLE(roam_hash, BATADV_TT_ROAM_HASH_BITS);
+
+	/** @changes_list_lock: lock protecting changes_list and changes_hash */
 	spinlock_t changes_list_lock;
 
-	/** @req_list_lock: lock protecting req_list */
+	/** @req_list_lock: lock protecting req_list and req_hash */
 	spinlock_t req_list_lock;
 
-	/** @roam_list_lock: lock protecting roam_list */
+	/** @roam_list_lock: lock protecting roam_list and roam_hash */
 	spinlock_t roam_list_lock;
 
 	/** @last_changeset: last tt changeset this host has generated */
@@ -998,6 +1720,27 @@ struct batadv_priv_tt {
 	 */
 	spinlock_t commit_lock;
 
+	/**
+	 * @global_gen: generation of the global table, increased whenever a
+	 *  global entry is changed or removed
+	 */
+	atomic_t global_gen;
+
+	/** @tombstones: ring of the last removed global entries */
+	struct batadv_tt_tombstone tombstones[BATADV_TT_TOMBSTONES];
+
+	/** @tombstones_head: number of tombstones ever added to the ring */
+	unsigned long tombstones_head;
+
+	/**
+	 * @tombstones_lost: generation of the newest removal which was already
+	 *  overwritten in @tombstones
+	 */
+	u32 tombstones_lost;
+
+	/** @tombstones_lock: lock protecting the tombstones_* fields */
+	spinlock_t tombstones_lock;
+
 	/** @work: work queue callback item for translation table purging */
 	struct delayed_work work;
 };
@@ -1036,22 +1779,10 @@ struct batadv_priv_bla {
 	atomic_t loopdetect_next;
 
 	/**
-	 * @bcast_duplist: recently received broadcast packets array (for
-	 *  broadcast duplicate suppression)
-	 */
-	struct batadv_bcast_duplist_entry bcast_duplist[BATADV_DUPLIST_SIZE];
-
-	/**
-	 * @bcast_duplist_curr: index of last broadcast packet added to
-	 *  bcast_duplist
+	 * @bcast_duplist: recently received broadcast packets, indexed by
+	 *  their crc (for broadcast duplicate suppression)
 	 */
-	int bcast_duplist_curr;
-
-	/**
-	 * @bcast_duplist_lock: lock protecting bcast_duplist &
-	 *  bcast_duplist_curr
-	 */
-	spinlock_t bcast_duplist_lock;
+	struct batadv_bcast_duplist_bucket *bcast_duplist;
 
 	/** @claim_dest: local claim data (e.g. claim group) */
 	struct batadv_bla_claim_dst claim_dest;
@@ -1063,21 +1794,61 @@ struct batadv_priv_bla {
 
 #ifdef CONFIG_BATMAN_ADV_DEBUG
 
+/**
+ * struct batadv_debug_log_entry - single record in a per cpu debug log ring
+ */
+struct batadv_debug_log_entry {
+	/**
+	 * @seq: global sequence number of the record, 0 while the slot is
+	 *  being (re)written
+	 */
+	u64 seq;
+
+	/** @time: time in ms when the record was written */
+	u32 time;
+
+	/** @len: length of the message in @msg */
+	u16 len;
+
+	/** @msg: message text (not NUL-terminated) */
+	char msg[BATADV_LOG_ENTRY_LEN - 14];
+};
+
+/**
+ * struct batadv_debug_log_ring - per cpu ring of debug log records
+ */
+struct batadv_debug_log_ring {
+	/** @head: index of next record to write (only modified by owner cpu) */
+	unsigned long head;
+
+	/** @tail: index of next record to read (only modified by reader) */
+	unsigned long tail;
+
+	/** @entries: the ring buffer holding the records */
+	struct batadv_debug_log_entry entries[BATADV_LOG_ENTRIES];
+};
+
 /**
  * struct batadv_priv_debug_log - debug logging data
  */
 struct batadv_priv_debug_log {
-	/** @log_buff: buffer holding the logs (ring bufer) */
-	char log_buff[BATADV_LOG_BUF_LEN];
+	/** @rings: per cpu rings holding the logs */
+	struct batadv_debug_log_ring __percpu *rings;
 
-	/** @log_start: index of next character to read */
-	unsigned long log_start;
+	/** @seq: last sequence number handed out to a record */
+	atomic64_t seq;
 
-	/** @log_end: index of next character to write */
-	unsigned long log_end;
+	/** @read_lock: lock serializing readers, protects the read_* fields */
+	struct mutex read_lock;
 
-	/** @lock: lock protecting log_buff, log_start & log_end */
-	spinlock_t lock;
+	/** @read_buf: formatted record which is currently read */
+	char read_buf[BATADV_LOG_ENTRY_LEN + 16];
+
+	/** @read_len: length of the formatted record in @read_buf */
+	size_t read_len;
+
+	/** @read_off: number of bytes of @read_buf already read */
+	size_t read_off;
 
 	/** @queue_wait: log reader's wait queue */
 	wait_queue_head_t queue_wait;
@@ -1091,12 +1862,18 @@ struct batadv_priv_gw {
 	/** @gateway_list: list of available gateway nodes */
 	struct hlist_head gateway_list;
 
-	/** @list_lock: lock protecting gateway_list & curr_gw */
+	/** @list_lock: lock protecting gateway_list, curr_gw & best_gw */
 	spinlock_t list_lock;
 
 	/** @curr_gw: pointer to currently selected gateway node */
 	struct batadv_gw_node __rcu *curr_gw;
 
+	/**
+	 * @best_gw: gateway node with the highest metric on gateway_list, kept
+	 *  up to date whenever the metric of a gateway changes
+	 */
+	struct batadv_gw_node __rcu *best_gw;
+
 	/**
 	 * @mode: gateway operation: off, client or server (see batadv_gw_modes)
 	 */
@@ -1105,6 +1882,12 @@ struct batadv_priv_gw {
 	/** @sel_class: gateway selection class (applies if gw_mode client) */
 	atomic_t sel_class;
 
+	/**
+	 * @balance: number of best ranked gateways the DHCP clients are spread
+	 *  across (applies if gw_mode client, 0 or 1 use the selected gateway)
+	 */
+	atomic_t balance;
+
 	/**
 	 * @bandwidth_down: advertised uplink download bandwidth (if gw_mode
 	 *  server)
@@ -1133,15 +1916,100 @@ struct batadv_priv_tvlv {
 	/** @handler_list: list of the various tvlv content handlers */
 	struct hlist_head handler_list;
 
+	/**
+	 * @handler_table: handlers of &handler_list indexed by type and
+	 *  version, only for types and versions below
+	 *  BATADV_TVLV_DISPATCH_TYPES and BATADV_TVLV_DISPATCH_VERSIONS
+	 */
+	struct batadv_tvlv_handler __rcu *
+		handler_table[BATADV_TVLV_DISPATCH_TYPES *
+			      BATADV_TVLV_DISPATCH_VERSIONS];
+
 	/** @container_list_lock: protects tvlv container list access */
 	spinlock_t container_list_lock;
 
 	/** @handler_list_lock: protects handler list access */
 	spinlock_t handler_list_lock;
+
+	/**
+	 * @blob: all containers of @container_list serialized in the layout in
+	 *  which they are appended to OGMs (protected by container_list_lock)
+	 */
+	unsigned char *blob;
+
+	/** @blob_len: length of @blob */
+	u16 blob_len;
+
+	/** @blob_dirty: @container_list changed since @blob was built */
+	bool blob_dirty;
 };
 
 #ifdef CONFIG_BATMAN_ADV_DAT
 
+/**
+ * struct batadv_orig_dat_ring - originators sorted by their DHT address
+ */
+struct batadv_orig_dat_ring {
+	/** @rcu: struct used for freeing in an RCU-safe manner */
+	struct rcu_head rcu;
+
+	/** @num: number of originators in @nodes */
+	u32 num;
+
+	/** @nodes: referenced originators in ascending dat_addr order */
+	struct batadv_orig_node *nodes[];
+};
+
+/**
+ * enum batadv_bcast_class - classes of client broadcasts which can be
+ *  suppressed when repeated
+ */
+enum batadv_bcast_class {
+	/** @BATADV_BCAST_CLASS_ARP: ARP requests and gratuitous ARP */
+	BATADV_BCAST_CLASS_ARP,
+
+	/** @BATADV_BCAST_CLASS_DHCP: DHCP and DHCPv6 client messages */
+	BATADV_BCAST_CLASS_DHCP,
+
+	/** @BATADV_BCAST_CLASS_MDNS: multicast DNS queries and announcements */
+	BATADV_BCAST_CLASS_MDNS,
+
+	/** @BATADV_BCAST_CLASS_NUM: number of broadcast classes */
+	BATADV_BCAST_CLASS_NUM,
+};
+
+/**
+ * struct batadv_bcast_suppress_slot - a recently flooded client broadcast
+ */
+struct batadv_bcast_suppress_slot {
+	/** @hash: hash over the class and the content of the broadcast */
+	u32 hash;
+
+	/** @expires: jiffies until which identical broadcasts are dropped */
+	unsigned long expires;
+};
+
+/**
+ * struct batadv_priv_bcast_suppress - per mesh interface data of the
+ *  suppression of repeated client broadcasts
+ */
+struct batadv_priv_bcast_suppress {
+	/**
+	 * @window: time in milliseconds an identical broadcast is not flooded
+	 *  again, per &enum batadv_bcast_class. 0 disables the suppression
+	 */
+	atomic_t window[BATADV_BCAST_CLASS_NUM];
+
+	/** @lock: lock protecting @slots */
+	spinlock_t lock;
+
+	/**
+	 * @slots: recently flooded broadcasts, indexed by the lower bits of
+	 *  their hash
+	 */
+	struct batadv_bcast_suppress_slot slots[BATADV_BCAST_SUPPRESS_SLOTS];
+};
+
 /**
  * struct batadv_priv_dat - per mesh interface DAT private data
  */
@@ -1154,6 +2022,23 @@ struct batadv_priv_dat {
 
 	/** @work: work queue callback item for cache purging */
 	struct delayed_work work;
+
+	/**
+	 * @max_entries: maximum number of entries in @hash (0 = unlimited)
+	 */
+	atomic_t max_entries;
+
+	/** @clock_hand: bucket of @hash the next eviction scan starts at */
+	atomic_t clock_hand;
+
+	/**
+	 * @ring: all originators sorted by their DHT address (for candidate
+	 *  selection)
+	 */
+	struct batadv_orig_dat_ring __rcu *ring;
+
+	/** @ring_work: work queue item rebuilding @ring */
+	struct work_struct ring_work;
 };
 #endif
 
@@ -1172,15 +2057,42 @@ struct batadv_mcast_querier_state {
 	unsigned char shadowing:1;
 };
 
+/**
+ * struct batadv_mcast_forw_cache_entry - cached number of multicast listeners
+ *  announced via TT
+ */
+struct batadv_mcast_forw_cache_entry {
+	/** @addr: the multicast destination MAC address */
+	u8 addr[ETH_ALEN];
+
+	/** @tt_gen: value of tt.tx_cache_gen when the listeners were counted */
+	u32 tt_gen;
+
+	/**
+	 * @tt_count: number of originators announcing @addr via TT (excluding
+	 *  ourself)
+	 */
+	int tt_count;
+};
+
+/**
+ * struct batadv_mcast_forw_cache - per-CPU cache of multicast listener counts
+ */
+struct batadv_mcast_forw_cache {
+	/** @entries: cached counts, indexed by a hash of addr */
+	struct batadv_mcast_forw_cache_entry entries[BATADV_MCAST_CACHE_SIZE];
+};
+
 /**
  * struct batadv_priv_mcast - per mesh interface mcast data
  */
 struct batadv_priv_mcast {
 	/**
-	 * @mla_list: list of multicast addresses we are currently announcing
-	 *  via TT
+	 * @mla_list: hashed set of multicast addresses we are currently
+	 *  announcing via TT
 	 */
-	struct hlist_head mla_list; /* see __batadv_mcast_mla_update() */
+	DECLARE_HASHTABLE(mla_list, BATADV_MCAST_MLA_HASH_BITS);
+	/* see __batadv_mcast_mla_update() */
 
 	/**
 	 * @want_all_unsnoopables_list: a list of orig_nodes wanting all
@@ -1233,8 +2145,20 @@ struct batadv_priv_mcast {
 	 */
 	spinlock_t want_lists_lock;
 
+	/**
+	 * @forw_cache: per-CPU cache of the listener counts looked up by
+	 *  batadv_mcast_forw_mode()
+	 */
+	struct batadv_mcast_forw_cache __percpu *forw_cache;
+
 	/** @work: work queue callback item for multicast TT and TVLV updates */
 	struct delayed_work work;
+
+	/**
+	 * @work_period: current interval of the periodic updates (in
+	 *  milliseconds), backed off while nothing changes
+	 */
+	unsigned int work_period;
 };
 #endif
 
@@ -1245,6 +2169,15 @@ struct batadv_priv_nc {
 	/** @work: work queue callback item for cleanup */
 	struct delayed_work work;
 
+	/**
+	 * @fwd_timer: timer firing at the earliest deadline of the packets
+	 *  buffered for coding
+	 */
+	struct hrtimer fwd_timer;
+
+	/** @fwd_work: work item forwarding the packets whose deadline passed */
+	struct work_struct fwd_work;
+
 #ifdef CONFIG_BATMAN_ADV_DEBUGFS
 	/**
 	 * @debug_dir: dentry for nc subdir in batman-adv directory in debugfs
@@ -1286,6 +2219,16 @@ struct batadv_priv_nc {
 	 */
 	struct batadv_hashtable *coding_hash;
 
+	/**
+	 * @coding_index: coding paths holding buffered packets, hashed by their
+	 *  previous hop, to find coding opportunities without probing every
+	 *  possible path in coding_hash
+	 */
+	DECLARE_HASHTABLE(coding_index, BATADV_NC_INDEX_HASH_BITS);
+
+	/** @coding_index_lock: protects coding_index */
+	spinlock_t coding_index_lock;
+
 	/**
 	 * @decoding_hash: Hash table used to buffer skbs that might be needed
 	 *  to decode a received coded skb. The buffer is used for 1) skbs
@@ -1298,16 +2241,17 @@ struct batadv_priv_nc {
 /**
  * struct batadv_tp_unacked - unacked packet meta-information
  *
- * This struct is supposed to represent a buffer unacked packet. However, since
- * the purpose of the TP meter is to count the traffic only, there is no need to
- * store the entire sk_buff, the starting offset and the length are enough
+ * This struct is supposed to represent a range of buffered unacked packets.
+ * However, since the purpose of the TP meter is to count the traffic only,
+ * there is no need to store the entire sk_buffs, the starting offset and the
+ * length are enough. Adjacent packets are merged into the same range
  */
 struct batadv_tp_unacked {
-	/** @seqno: seqno of the unacked packet */
+	/** @seqno: seqno of the first unacked packet of the range */
 	u32 seqno;
 
-	/** @len: length of the packet */
-	u16 len;
+	/** @len: length of the range */
+	u32 len;
 
 	/** @list: list node for &batadv_tp_vars.unacked_list */
 	struct list_head list;
@@ -1324,6 +2268,104 @@ enum batadv_tp_meter_role {
 	BATADV_TP_SENDER
 };
 
+/**
+ * struct batadv_tp_sack - data selectively acknowledged by a tp meter receiver
+ */
+struct batadv_tp_sack {
+	/** @start: seqno of the first acknowledged byte */
+	u32 start;
+
+	/** @end: seqno following the last acknowledged byte */
+	u32 end;
+};
+
+/**
+ * struct batadv_tp_rtt_stats - RTT samples collected by a tp meter sender
+ */
+struct batadv_tp_rtt_stats {
+	/** @count: number of RTT samples */
+	u32 count;
+
+	/** @min: smallest RTT sample in msec */
+	u32 min;
+
+	/** @max: biggest RTT sample in msec */
+	u32 max;
+
+	/** @sum: sum of all RTT samples in msec */
+	u64 sum;
+
+	/** @last: previous RTT sample in msec */
+	u32 last;
+
+	/**
+	 * @jitter: mean deviation of consecutive RTT samples (see Section
+	 *  6.4.1 of RFC3550) scaled by 2^4
+	 */
+	u32 jitter;
+
+	/** @reordered: number of ACKs overtaken by a newer ACK */
+	u32 reordered;
+
+	/** @hist: number of RTT samples per msec */
+	u32 hist[BATADV_TP_RTT_HIST_LEN];
+};
+
+/**
+ * struct batadv_tp_rtt_summary - RTT results reported for a tp meter test
+ */
+struct batadv_tp_rtt_summary {
+	/** @min: smallest RTT in msec */
+	u32 min;
+
+	/** @avg: average RTT in msec */
+	u32 avg;
+
+	/** @p99: 99th percentile of the RTT in msec */
+	u32 p99;
+
+	/** @jitter: mean deviation of consecutive RTT samples in msec */
+	u32 jitter;
+
+	/** @reordered: number of ACKs overtaken by a newer ACK */
+	u32 reordered;
+};
+
+/**
+ * struct batadv_tp_group - parallel tp meter streams started by one request
+ */
+struct batadv_tp_group {
+	/** @other_end: mac address of remote */
+	u8 other_end[ETH_ALEN];
+
+	/** @start_time: start time in jiffies */
+	unsigned long start_time;
+
+	/** @cookie: cookie reported to the client for the whole test */
+	u32 cookie;
+
+	/** @pending: number of streams which have not finished yet */
+	atomic_t pending;
+
+	/** @tot_sent: amount of data ACKed to all streams */
+	atomic64_t tot_sent;
+
+	/**
+	 * @reason: reason reported for the test, a stream which was not
+	 *  stopped by an error takes precedence over failed streams
+	 */
+	atomic_t reason;
+
+	/** @rtt: RTT samples of all finished streams */
+	struct batadv_tp_rtt_stats rtt;
+
+	/** @rtt_lock: lock to protect @rtt */
+	spinlock_t rtt_lock;
+
+	/** @refcount: number of streams referencing the group */
+	struct kref refcount;
+};
+
 /**
  * struct batadv_tp_vars - tp meter private variables per session
  */
@@ -1366,13 +2408,16 @@ struct batadv_tp_vars {
 
 	/* sender variables */
 
+	/** @group: the test this sender stream belongs to */
+	struct batadv_tp_group *group;
+
 	/** @dec_cwnd: decimal part of the cwnd used during linear growth */
 	u16 dec_cwnd;
 
 	/** @cwnd: current size of the congestion window */
 	u32 cwnd;
 
-	/** @cwnd_lock: lock do protect @cwnd & @dec_cwnd */
+	/** @cwnd_lock: lock do protect @cwnd, @dec_cwnd & @sacked */
 	spinlock_t cwnd_lock;
 
 	/**
@@ -1399,6 +2444,18 @@ struct batadv_tp_vars {
 	/** @recover: last sent seqno when entering Fast Recovery */
 	u32 recover;
 
+	/**
+	 * @sacked: selectively acknowledged blocks above @last_acked reported
+	 *  by the latest ACK, in ascending order
+	 */
+	struct batadv_tp_sack sacked[BATADV_TP_SACK_BLOCKS];
+
+	/** @num_sacked: number of valid entries in @sacked */
+	u8 num_sacked;
+
+	/** @sacked_bytes: amount of data covered by @sacked */
+	u32 sacked_bytes;
+
 	/** @rto: sender timeout */
 	u32 rto;
 
@@ -1408,37 +2465,116 @@ struct batadv_tp_vars {
 	/** @rttvar: RTT variation scaled by 2^2 */
 	u32 rttvar;
 
-	/**
-	 * @more_bytes: waiting queue anchor when waiting for more ack/retry
-	 *  timeout
-	 */
-	wait_queue_head_t more_bytes;
+	/** @rtt: RTT samples collected during the session */
+	struct batadv_tp_rtt_stats rtt;
+
+	/** @rtt_lock: lock to protect @rtt */
+	spinlock_t rtt_lock;
+
+	/**
+	 * @latency: keep only a single message in flight to measure the RTT
+	 *  without self induced queueing
+	 */
+	bool latency;
+
+	/**
+	 * @more_bytes: waiting queue anchor when waiting for more ack/retry
+	 *  timeout
+	 */
+	wait_queue_head_t more_bytes;
+
+	/** @prerandom_offset: offset inside the prerandom buffer */
+	atomic_t prerandom_offset;
+
+	/** @plen: payload length of a single message */
+	u32 plen;
+
+	/* receiver variables */
+
+	/** @last_recv: last in-order received packet */
+	u32 last_recv;
+
+	/** @unacked_list: list of unacked packets (meta-info only) */
+	struct list_head unacked_list;
+
+	/** @unacked_lock: protect unacked_list */
+	spinlock_t unacked_lock;
+
+	/** @last_recv_time: time time (jiffies) a msg was received */
+	unsigned long last_recv_time;
+
+	/** @refcount: number of context where the object is used */
+	struct kref refcount;
+
+	/** @rcu: struct used for freeing in an RCU-safe manner */
+	struct rcu_head rcu;
+};
+
+/**
+ * struct batadv_ping_probe - echo request of a ping batch
+ */
+struct batadv_ping_probe {
+	/** @dst: originator the echo request was sent to */
+	u8 dst[ETH_ALEN];
+
+	/** @responder: originator which answered the echo request */
+	u8 responder[ETH_ALEN];
+
+	/** @ttl: TTL of the echo request */
+	u8 ttl;
+
+	/** @status: result of the echo request, see &enum batadv_ping_status */
+	u8 status;
+
+	/** @rtt: round trip time in microseconds */
+	u32 rtt;
+
+	/** @sent: time the echo request was sent */
+	ktime_t sent;
+};
+
+/**
+ * struct batadv_ping_batch - echo requests sent by one BATADV_CMD_PING
+ */
+struct batadv_ping_batch {
+	/** @list: list node for &batadv_priv.ping_list */
+	struct hlist_node list;
+
+	/** @bat_priv: pointer to the mesh object */
+	struct batadv_priv *bat_priv;
+
+	/** @portid: netlink port the results are sent to */
+	u32 portid;
 
-	/** @prerandom_offset: offset inside the prerandom buffer */
-	u32 prerandom_offset;
+	/** @seq: sequence number of the netlink request */
+	u32 seq;
 
-	/** @prerandom_lock: spinlock protecting access to prerandom_offset */
-	spinlock_t prerandom_lock;
+	/** @first_seqno: ICMP sequence number of the first echo request */
+	u16 first_seqno;
 
-	/* receiver variables */
+	/** @num_probes: number of echo requests in @probes */
+	u16 num_probes;
 
-	/** @last_recv: last in-order received packet */
-	u32 last_recv;
+	/** @pending: number of echo requests without a result */
+	u16 pending;
 
-	/** @unacked_list: list of unacked packets (meta-info only) */
-	struct list_head unacked_list;
+	/** @done: whether the results were collected already */
+	bool done;
 
-	/** @unacked_lock: protect unacked_list */
-	spinlock_t unacked_lock;
+	/** @lock: lock protecting @probes, @pending and @done */
+	spinlock_t lock;
 
-	/** @last_recv_time: time time (jiffies) a msg was received */
-	unsigned long last_recv_time;
+	/** @finish_work: work item sending the results */
+	struct delayed_work finish_work;
 
-	/** @refcount: number of context where the object is used */
+	/** @refcount: number of contexts the object is used */
 	struct kref refcount;
 
 	/** @rcu: struct used for freeing in an RCU-safe manner */
 	struct rcu_head rcu;
+
+	/** @probes: the echo requests of the batch */
+	struct batadv_ping_probe probes[];
 };
 
 /**
@@ -1463,6 +2599,9 @@ struct batadv_softif_vlan {
 	/** @list: list node for &bat_priv.softif_vlan_list */
 	struct hlist_node list;
 
+	/** @hash_entry: hlist node for &bat_priv.softif_vlan_hash */
+	struct hlist_node hash_entry;
+
 	/**
 	 * @refcount: number of context where this object is currently in use
 	 */
@@ -1472,6 +2611,26 @@ struct batadv_softif_vlan {
 	struct rcu_head rcu;
 };
 
+/**
+ * struct batadv_priv_bat_iv - B.A.T.M.A.N. IV per soft-interface private data
+ */
+struct batadv_priv_bat_iv {
+	/** @own_slot_ida: allocator for the orig_node own_slot indices */
+	struct ida own_slot_ida;
+
+	/**
+	 * @own_chunks: number of own OGM counter chunks every hard-interface
+	 *  has to provide
+	 */
+	unsigned int own_chunks;
+
+	/**
+	 * @own_slots_lock: lock protecting @own_chunks and the resizing of the
+	 *  hard-interface own_slots
+	 */
+	spinlock_t own_slots_lock;
+};
+
 /**
  * struct batadv_priv_bat_v - B.A.T.M.A.N. V per soft-interface private data
  */
@@ -1487,6 +2646,44 @@ struct batadv_priv_bat_v {
 
 	/** @ogm_wq: workqueue used to schedule OGM transmissions */
 	struct delayed_work ogm_wq;
+
+	/** @ogm_due: time (jiffies) the next OGM transmission is planned for */
+	unsigned long ogm_due;
+
+	/** @ogm_backoff: adaptive interval of the own OGMs */
+	struct batadv_ogm_backoff ogm_backoff;
+};
+
+/**
+ * struct batadv_forw_sched - transmit scheduler of a forwarding packet queue
+ *
+ * A single work item sends all packets of the queue which are due at once
+ * instead of one work item per packet.
+ */
+struct batadv_forw_sched {
+	/** @list: queued packets, sorted by their send_time */
+	struct list_head list;
+
+	/** @due: packets of the running batch which were not sent yet */
+	struct list_head due;
+
+	/** @lock: lock protecting @list and @due */
+	spinlock_t lock;
+
+	/** @work: work queue callback item sending the due packets */
+	struct delayed_work work;
+
+	/** @wq: workqueue @work runs on */
+	struct workqueue_struct *wq;
+
+	/**
+	 * @delay_cnt: counter summing up how late the packets were sent (see
+	 *  &enum batadv_counters)
+	 */
+	enum batadv_counters delay_cnt;
+
+	/** @bat_priv: the mesh this scheduler belongs to */
+	struct batadv_priv *bat_priv;
 };
 
 /**
@@ -1499,6 +2696,25 @@ struct batadv_priv {
 	 */
 	atomic_t mesh_state;
 
+	/**
+	 * @event_wq: ordered workqueue running the periodic tasks of this mesh
+	 *  interface and of its hard-interfaces
+	 */
+	struct workqueue_struct *event_wq;
+
+	/**
+	 * @metric_wq: workqueue for the (possibly sleeping) link metric
+	 *  queries, which should not delay the tasks on @event_wq
+	 */
+	struct workqueue_struct *metric_wq;
+
+	/**
+	 * @ctrl_wq: ordered high priority workqueue sending the routing protocol
+	 *  messages of this mesh, which must not wait for the bulk tasks on
+	 *  @event_wq
+	 */
+	struct workqueue_struct *ctrl_wq;
+
 	/** @soft_iface: net device which holds this struct as private data */
 	struct net_device *soft_iface;
 
@@ -1513,9 +2729,34 @@ struct batadv_priv {
 	 */
 	atomic_t aggregated_ogms;
 
+	/**
+	 * @unicast_agg_delay: time (in ms) small unicast packets may wait to be
+	 *  aggregated with others for the same neighbor (0 = disabled)
+	 */
+	atomic_t unicast_agg_delay;
+
 	/** @bonding: bool indicating whether traffic bonding is enabled */
 	atomic_t bonding;
 
+	/**
+	 * @rx_steering: bool indicating whether OGMs and broadcasts are
+	 *  processed on a CPU chosen by their originator
+	 */
+	atomic_t rx_steering;
+
+	/**
+	 * @passive_capacity: bool indicating whether BATMAN V advertises the
+	 *  link throughput left over by the forwarded traffic instead of the
+	 *  full link throughput
+	 */
+	atomic_t passive_capacity;
+
+	/**
+	 * @numa_node: NUMA node of the primary interface, the tables and the
+	 *  steered packet processing of this mesh are placed on it
+	 */
+	int numa_node;
+
 	/**
 	 * @fragmentation: bool indicating whether traffic fragmentation is
 	 *  enabled
@@ -1529,12 +2770,22 @@ struct batadv_priv {
 	 */
 	atomic_t packet_size_max;
 
+	/**
+	 * @fwd_headroom: headroom reserved when a received packet has to be
+	 *  copied for forwarding, enough for the fragment or network coding
+	 *  header and the header of any hard interface
+	 */
+	unsigned short fwd_headroom;
+
 	/**
 	 * @frag_seqno: incremental counter to identify chains of egress
 	 *  fragments
 	 */
 	atomic_t frag_seqno;
 
+	/** @frag_mem: memory used by buffered fragments of all originators */
+	atomic_t frag_mem;
+
 #ifdef CONFIG_BATMAN_ADV_BLA
 	/**
 	 * @bridge_loop_avoidance: bool indicating whether bridge loop
@@ -1557,11 +2808,42 @@ struct batadv_priv {
 	 *  node's sender/originating side
 	 */
 	atomic_t multicast_mode;
+
+	/**
+	 * @multicast_fanout: Maximum number of packet copies to generate for a
+	 *  multicast-to-unicast conversion
+	 */
+	atomic_t multicast_fanout;
 #endif
 
 	/** @orig_interval: OGM broadcast interval in milliseconds */
 	atomic_t orig_interval;
 
+	/**
+	 * @orig_interval_max: upper bound in milliseconds the OGM interval is
+	 *  backed off to while the topology is stable (disabled if not above
+	 *  @orig_interval)
+	 */
+	atomic_t orig_interval_max;
+
+	/**
+	 * @orig_max_entries: maximum number of entries in @orig_hash
+	 *  (0 = unlimited)
+	 */
+	atomic_t orig_max_entries;
+
+	/**
+	 * @topology_gen: increased whenever a route or a neighbor changes to
+	 *  reset the adaptive OGM intervals
+	 */
+	atomic_t topology_gen;
+
+	/**
+	 * @fisheye_hops: distance (in hops) up to which all OGMs are forwarded,
+	 *  the OGMs of more distant originators are thinned out (0 to disable)
+	 */
+	atomic_t fisheye_hops;
+
 	/**
 	 * @hop_penalty: penalty which will be applied to an OGM's tq-field on
 	 *  every hop
@@ -1585,6 +2867,18 @@ struct batadv_priv {
 	 */
 	u32 isolation_mark_mask;
 
+	/**
+	 * @config_batch: whether a BATADV_CMD_SET_CONFIG request is applied,
+	 *  recalculations are then deferred to its end
+	 */
+	bool config_batch;
+
+	/**
+	 * @config_mtu_pending: whether the MTU has to be recalculated at the
+	 *  end of the BATADV_CMD_SET_CONFIG request
+	 */
+	bool config_mtu_pending;
+
 	/** @bcast_seqno: last sent broadcast packet sequence number */
 	atomic_t bcast_seqno;
 
@@ -1608,14 +2902,14 @@ struct batadv_priv {
 	struct dentry *debug_dir;
 #endif
 
-	/** @forw_bat_list: list of aggregated OGMs that will be forwarded */
-	struct hlist_head forw_bat_list;
+	/** @forw_bat: scheduler of aggregated OGMs that will be forwarded */
+	struct batadv_forw_sched forw_bat;
 
 	/**
-	 * @forw_bcast_list: list of broadcast packets that will be
+	 * @forw_bcast: scheduler of broadcast packets that will be
 	 *  rebroadcasted
 	 */
-	struct hlist_head forw_bcast_list;
+	struct batadv_forw_sched forw_bcast;
 
 	/** @tp_list: list of tp sessions */
 	struct hlist_head tp_list;
@@ -1624,26 +2918,43 @@ struct batadv_priv {
 	struct batadv_hashtable *orig_hash;
 
 	/** @orig_hash: hash table containing mesh participants (orig nodes) */
-	spinlock_t forw_bat_list_lock;
-
-	/** @forw_bat_list_lock: lock protecting forw_bat_list */
-	spinlock_t forw_bcast_list_lock;
-
-	/** @forw_bcast_list_lock: lock protecting forw_bcast_list */
 	spinlock_t tp_list_lock;
 
 	/** @tp_list_lock: spinlock protecting @tp_list */
 	atomic_t tp_num;
 
+	/** @ping_list: list of running ping batches */
+	struct hlist_head ping_list;
+
+	/**
+	 * @ping_list_lock: spinlock protecting @ping_list and @ping_seqno
+	 */
+	spinlock_t ping_list_lock;
+
+	/** @ping_seqno: ICMP sequence number of the next ping batch */
+	u16 ping_seqno;
+
 	/** @orig_work: work queue callback item for orig node purging */
 	struct delayed_work orig_work;
 
+	/**
+	 * @orig_purge_next: index of the orig_hash bucket the next purge slice
+	 *  of orig_work starts at
+	 */
+	u32 orig_purge_next;
+
 	/**
 	 * @primary_if: one of the hard-interfaces assigned to this mesh
 	 *  interface becomes the primary interface
 	 */
 	struct batadv_hard_iface __rcu *primary_if;  /* rcu protected pointer */
 
+	/**
+	 * @hardif_addrs: MAC addresses of the hard-interfaces of this mesh
+	 *  interface, NULL when no hard-interface is active
+	 */
+	struct batadv_hardif_addrs __rcu *hardif_addrs;
+
 	/** @algo_ops: routing algorithm used by this mesh interface */
 	struct batadv_algo_ops *algo_ops;
 
@@ -1653,7 +2964,16 @@ struct batadv_priv {
 	 */
 	struct hlist_head softif_vlan_list;
 
-	/** @softif_vlan_list_lock: lock protecting softif_vlan_list */
+	/**
+	 * @softif_vlan_hash: the entries of softif_vlan_list hashed by VLAN
+	 *  identifier
+	 */
+	DECLARE_HASHTABLE(softif_vlan_hash, BATADV_SOFTIF_VLAN_HASH_BITS);
+
+	/**
+	 * @softif_vlan_list_lock: lock protecting softif_vlan_list and
+	 *  softif_vlan_hash
+	 */
 	spinlock_t softif_vlan_list_lock;
 
 #ifdef CONFIG_BATMAN_ADV_BLA
@@ -1675,6 +2995,9 @@ struct batadv_priv {
 	/** @tvlv: type-version-length-value data */
 	struct batadv_priv_tvlv tvlv;
 
+	/** @bcast_suppress: suppression of repeated client broadcasts */
+	struct batadv_priv_bcast_suppress bcast_suppress;
+
 #ifdef CONFIG_BATMAN_ADV_DAT
 	/** @dat: distributed arp table data */
 	struct batadv_priv_dat dat;
@@ -1695,6 +3018,9 @@ struct batadv_priv {
 	struct batadv_priv_nc nc;
 #endif /* CONFIG_BATMAN_ADV_NC */
 
+	/** @bat_iv: B.A.T.M.A.N. IV per soft-interface private data */
+	struct batadv_priv_bat_iv bat_iv;
+
 #ifdef CONFIG_BATMAN_ADV_BATMAN_V
 	/** @bat_v: B.A.T.M.A.N. V per soft-interface private data */
 	struct batadv_priv_bat_v bat_v;
@@ -1781,7 +3107,13 @@ struct batadv_bla_backbone_gw {
 	/** @crc: crc16 checksum over all claims */
 	u16 crc;
 
-	/** @crc_lock: lock protecting crc */
+	/**
+	 * @crc_buckets: crc16 checksums over the claims of each bucket (see
+	 *  struct batadv_bla_announce_ext)
+	 */
+	u16 crc_buckets[BATADV_BLA_CRC_BUCKETS];
+
+	/** @crc_lock: lock protecting crc and crc_buckets */
 	spinlock_t crc_lock;
 
 	/** @report_work: work struct for reporting detected loops */
@@ -1834,21 +3166,21 @@ struct batadv_tt_common_entry {
 	/** @vid: VLAN identifier */
 	unsigned short vid;
 
+	/** @flags: various state handling flags (see batadv_tt_client_flags) */
+	u16 flags;
+
+	/** @refcount: number of contexts the object is used */
+	struct kref refcount;
+
 	/**
 	 * @hash_entry: hlist node for &batadv_priv_tt.local_hash or for
 	 *  &batadv_priv_tt.global_hash
 	 */
 	struct hlist_node hash_entry;
 
-	/** @flags: various state handling flags (see batadv_tt_client_flags) */
-	u16 flags;
-
 	/** @added_at: timestamp used for purging stale tt common entries */
 	unsigned long added_at;
 
-	/** @refcount: number of contexts the object is used */
-	struct kref refcount;
-
 	/** @rcu: struct used for freeing in an RCU-safe manner */
 	struct rcu_head rcu;
 };
@@ -1865,26 +3197,12 @@ struct batadv_tt_local_entry {
 
 	/** @vlan: soft-interface vlan of the entry */
 	struct batadv_softif_vlan *vlan;
-};
-
-/**
- * struct batadv_tt_global_entry - translation table global entry data
- */
-struct batadv_tt_global_entry {
-	/** @common: general translation table data */
-	struct batadv_tt_common_entry common;
-
-	/** @orig_list: list of orig nodes announcing this non-mesh client */
-	struct hlist_head orig_list;
 
-	/** @orig_list_count: number of items in the orig_list */
-	atomic_t orig_list_count;
-
-	/** @list_lock: lock protecting orig_list */
-	spinlock_t list_lock;
-
-	/** @roam_at: time at which TT_GLOBAL_ROAM was set */
-	unsigned long roam_at;
+	/**
+	 * @crc: CRC32C of this entry currently merged into the crc_acc of
+	 *  @vlan (protected by its crc_lock)
+	 */
+	u32 crc;
 };
 
 /**
@@ -1903,6 +3221,17 @@ struct batadv_tt_orig_list_entry {
 	/** @flags: per orig entry TT sync flags */
 	u8 flags;
 
+#ifdef CONFIG_BATMAN_ADV_TT_COMPACT
+	/** @embedded: entry is &batadv_tt_global_entry.orig_inline */
+	bool embedded;
+#endif
+
+	/**
+	 * @crc: CRC32C of this entry currently merged into the crc_acc of the
+	 *  orig_node vlan (protected by the list lock of the global entry)
+	 */
+	u32 crc;
+
 	/** @list: list node for &batadv_tt_global_entry.orig_list */
 	struct hlist_node list;
 
@@ -1913,6 +3242,40 @@ struct batadv_tt_orig_list_entry {
 	struct rcu_head rcu;
 };
 
+/**
+ * struct batadv_tt_global_entry - translation table global entry data
+ */
+struct batadv_tt_global_entry {
+	/** @common: general translation table data */
+	struct batadv_tt_common_entry common;
+
+	/** @orig_list: list of orig nodes announcing this non-mesh client */
+	struct hlist_head orig_list;
+
+	/** @orig_list_count: number of items in the orig_list */
+	atomic_t orig_list_count;
+
+	/**
+	 * @generation: generation of the global table when the entry was
+	 *  changed the last time
+	 */
+	u32 generation;
+
+	/** @roam_at: time at which TT_GLOBAL_ROAM was set */
+	unsigned long roam_at;
+
+#ifdef CONFIG_BATMAN_ADV_TT_COMPACT
+	/**
+	 * @orig_inline: storage for the first orig entry of orig_list, the list
+	 *  itself is protected by the hashed batadv_tt_global_list_lock()
+	 */
+	struct batadv_tt_orig_list_entry orig_inline;
+#else
+	/** @list_lock: lock protecting orig_list */
+	spinlock_t list_lock;
+#endif
+};
+
 /**
  * struct batadv_tt_change_node - structure for tt changes occurred
  */
@@ -1920,6 +3283,9 @@ struct batadv_tt_change_node {
 	/** @list: list node for &batadv_priv_tt.changes_list */
 	struct list_head list;
 
+	/** @hash_entry: hlist node for &batadv_priv_tt.changes_hash */
+	struct hlist_node hash_entry;
+
 	/** @change: holds the actual translation table diff data */
 	struct batadv_tvlv_tt_change change;
 };
@@ -1940,7 +3306,10 @@ struct batadv_tt_req_node {
 	struct kref refcount;
 
 	/** @list: list node for &batadv_priv_tt.req_list */
-	struct hlist_node list;
+	struct list_head list;
+
+	/** @hash_entry: hlist node for &batadv_priv_tt.req_hash */
+	struct hlist_node hash_entry;
 };
 
 /**
@@ -1963,6 +3332,9 @@ struct batadv_tt_roam_node {
 
 	/** @list: list node for &batadv_priv_tt.roam_list */
 	struct list_head list;
+
+	/** @hash_entry: hlist node for &batadv_priv_tt.roam_hash */
+	struct hlist_node hash_entry;
 };
 
 /**
@@ -1995,6 +3367,15 @@ struct batadv_nc_path {
 	/** @hash_entry: next and prev pointer for the list handling */
 	struct hlist_node hash_entry;
 
+	/** @index_entry: hlist node for &batadv_priv_nc.coding_index */
+	struct hlist_node index_entry;
+
+	/**
+	 * @indexed: whether the path is in &batadv_priv_nc.coding_index
+	 *  (protected by &batadv_priv_nc.coding_index_lock)
+	 */
+	bool indexed;
+
 	/** @rcu: struct used for freeing in an RCU-safe manner */
 	struct rcu_head rcu;
 
@@ -2004,6 +3385,12 @@ struct batadv_nc_path {
 	/** @packet_list: list of buffered packets for this path */
 	struct list_head packet_list;
 
+	/**
+	 * @packet_llist: packets added without taking packet_list_lock, moved
+	 *  to packet_list by the next reader of the path
+	 */
+	struct llist_head packet_llist;
+
 	/** @packet_list_lock: access lock for packet list */
 	spinlock_t packet_list_lock;
 
@@ -2025,6 +3412,9 @@ struct batadv_nc_packet {
 	/** @list: next and prev pointer for the list handling */
 	struct list_head list;
 
+	/** @llnode: list node for &batadv_nc_path.packet_llist */
+	struct llist_node llnode;
+
 	/** @packet_id: crc32 checksum of skb data */
 	__be32 packet_id;
 
@@ -2034,6 +3424,12 @@ struct batadv_nc_packet {
 	 */
 	unsigned long timestamp;
 
+	/**
+	 * @deadline: time at which a packet buffered for coding is forwarded
+	 *  uncoded
+	 */
+	ktime_t deadline;
+
 	/** @neigh_node: pointer to original next hop neighbor of skb */
 	struct batadv_neigh_node *neigh_node;
 
@@ -2055,8 +3451,45 @@ struct batadv_skb_cb {
 	 */
 	unsigned char decoded:1;
 
+	/**
+	 * @classified: Marks the fields below as filled by
+	 *  batadv_skb_classify() for the ethernet header at the mac header
+	 */
+	unsigned char classified:1;
+
+	/** @has_prio: Marks @prio as valid */
+	unsigned char has_prio:1;
+
 	/** @num_bcasts: Counter for broadcast packet retransmissions */
 	unsigned char num_bcasts;
+
+	/**
+	 * @recv_if: interface a packet in a &batadv_rx_backlog was received on,
+	 *  holding a reference
+	 */
+	struct batadv_hard_iface *recv_if;
+
+	/** @prio: 802.1d priority derived from the VLAN tag or the IP dsfield */
+	u8 prio;
+
+	/** @l4_proto: transport protocol of an IPv4/IPv6 frame, 0 otherwise */
+	u8 l4_proto;
+
+	/** @vid: VLAN identifier as returned by batadv_get_vid() */
+	unsigned short vid;
+
+	/** @l3_proto: ethertype following the ethernet and VLAN header */
+	__be16 l3_proto;
+
+	/** @network_offset: offset of the network header to the mac header */
+	u16 network_offset;
+
+	/**
+	 * @transport_offset: offset of the transport header to the mac header,
+	 *  only set for IPv4 and IPv6 frames with the IP header in the linear
+	 *  part of the skb
+	 */
+	u16 transport_offset;
 };
 
 /**
@@ -2064,15 +3497,21 @@ struct batadv_skb_cb {
  */
 struct batadv_forw_packet {
 	/**
-	 * @list: list node for &batadv_priv.forw.bcast_list and
-	 *  &batadv_priv.forw.bat_list
+	 * @list: list node for &batadv_forw_sched.list of
+	 *  &batadv_priv.forw_bcast and &batadv_priv.forw_bat
 	 */
-	struct hlist_node list;
+	struct list_head list;
 
 	/** @cleanup_list: list node for purging functions */
 	struct hlist_node cleanup_list;
 
-	/** @send_time: execution time for delayed_work (packet sending) */
+	/**
+	 * @aggr_list: list node for &batadv_hard_iface_bat_iv.aggr_list until
+	 *  the packet is due
+	 */
+	struct list_head aggr_list;
+
+	/** @send_time: time (jiffies) the packet is due to be sent */
 	unsigned long send_time;
 
 	/**
@@ -2093,8 +3532,11 @@ struct batadv_forw_packet {
 	/** @num_packets: counter for aggregated OGMv1 packets */
 	u8 num_packets;
 
-	/** @delayed_work: work queue callback item for packet sending */
-	struct delayed_work delayed_work;
+	/**
+	 * @send: called by the scheduler when the packet is due, has to either
+	 *  requeue or steal and free the packet
+	 */
+	void (*send)(struct batadv_forw_packet *forw_packet);
 
 	/**
 	 * @if_incoming: pointer to incoming hard-iface or primary iface if
@@ -2136,6 +3578,12 @@ struct batadv_algo_iface_ops {
 
 	/** @primary_set: called when primary interface is selected / changed */
 	void (*primary_set)(struct batadv_hard_iface *hard_iface);
+
+	/**
+	 * @ogm_rearm: send the next own OGMs within orig_interval instead of a
+	 *  backed off interval (optional)
+	 */
+	void (*ogm_rearm)(struct batadv_priv *bat_priv);
 };
 
 /**
@@ -2164,6 +3612,13 @@ struct batadv_algo_neigh_ops {
 				     struct batadv_neigh_node *neigh2,
 				     struct batadv_hard_iface *if_outgoing2);
 
+	/**
+	 * @metric: get the metric of the path via a neighbor for an outgoing
+	 *  interface, higher is better (optional)
+	 */
+	u32 (*metric)(struct batadv_neigh_node *neigh,
+		      struct batadv_hard_iface *if_outgoing);
+
 #ifdef CONFIG_BATMAN_ADV_DEBUGFS
 	/** @print: print the single hop neighbor list (optional) */
 	void (*print)(struct batadv_priv *priv, struct seq_file *seq);
@@ -2179,6 +3634,13 @@ struct batadv_algo_neigh_ops {
  * struct batadv_algo_orig_ops - mesh algorithm callbacks (originator specific)
  */
 struct batadv_algo_orig_ops {
+	/**
+	 * @get: retrieve or create (if it does not exist) an orig_node with
+	 *  the routing algorithm specific state initialised (optional)
+	 */
+	struct batadv_orig_node *(*get)(struct batadv_priv *bat_priv,
+					const u8 *addr);
+
 	/**
 	 * @free: free the resources allocated by the routing algorithm for an
 	 *  orig_node object (optional)
@@ -2231,19 +3693,19 @@ struct batadv_algo_gw_ops {
 	ssize_t (*show_sel_class)(struct batadv_priv *bat_priv, char *buff);
 
 	/**
-	 * @get_best_gw_node: select the best GW from the list of available
-	 *  nodes (optional)
+	 * @metric: compute the ranking of a GW, higher is better and 0 means
+	 *  that the GW cannot be selected (optional)
 	 */
-	struct batadv_gw_node *(*get_best_gw_node)
-		(struct batadv_priv *bat_priv);
+	u64 (*metric)(struct batadv_priv *bat_priv,
+		      struct batadv_gw_node *gw_node);
 
 	/**
-	 * @is_eligible: check if a newly discovered GW is a potential candidate
-	 *  for the election as best GW (optional)
+	 * @is_eligible: check if the best ranked GW should replace the
+	 *  currently selected GW (optional)
 	 */
 	bool (*is_eligible)(struct batadv_priv *bat_priv,
-			    struct batadv_orig_node *curr_gw_orig,
-			    struct batadv_orig_node *orig_node);
+			    struct batadv_gw_node *curr_gw,
+			    struct batadv_gw_node *gw_node);
 
 #ifdef CONFIG_BATMAN_ADV_DEBUGFS
 	/** @print: print the gateway table (optional) */
@@ -2286,12 +3748,29 @@ struct batadv_dat_entry {
 	/** @ip: the IPv4 corresponding to this DAT/ARP entry */
 	__be32 ip;
 
-	/** @mac_addr: the MAC address associated to the stored IPv4 */
+	/** @ip6: the IPv6 address corresponding to this DAT/ND entry */
+	struct in6_addr ip6;
+
+	/** @family: AF_INET for ARP entries, AF_INET6 for ND entries */
+	u8 family;
+
+	/**
+	 * @router: the owner of @ip6 announced itself as router in its neighbor
+	 *  advertisements
+	 */
+	bool router;
+
+	/** @mac_addr: the MAC address associated to the stored IP address */
 	u8 mac_addr[ETH_ALEN];
 
 	/** @vid: the vlan ID associated to this entry */
 	unsigned short vid;
 
+	/**
+	 * @referenced: entry was used since the last eviction scan passed it
+	 */
+	bool referenced;
+
 	/**
 	 * @last_update: time in jiffies when this entry was refreshed last time
 	 */
@@ -2311,7 +3790,7 @@ struct batadv_dat_entry {
  * struct batadv_hw_addr - a list entry for a MAC address
  */
 struct batadv_hw_addr {
-	/** @list: list node for the linking of entries */
+	/** @list: list node for the linking of entries in a bucket */
 	struct hlist_node list;
 
 	/** @addr: the MAC address of this list entry */
@@ -2406,6 +3885,28 @@ enum batadv_tvlv_handler_flags {
 	 *  BATADV_TVLV_HANDLER_OGM_CIFNOTFND flag was set
 	 */
 	BATADV_TVLV_HANDLER_OGM_CALLED = BIT(2),
+
+	/**
+	 * @BATADV_TVLV_HANDLER_OGM_ALWAYS: tvlv ogm processing function will
+	 *  call this handler even when the tvlv buffer of the OGM didn't change
+	 *  since the last OGM of the originator
+	 */
+	BATADV_TVLV_HANDLER_OGM_ALWAYS = BIT(3),
+};
+
+/**
+ * struct batadv_rx_backlog - per CPU queue of received packets steered to
+ *  this CPU
+ */
+struct batadv_rx_backlog {
+	/** @queue: packets waiting to be processed */
+	struct sk_buff_head queue;
+
+	/** @work: processes @queue, bound to @cpu */
+	struct work_struct work;
+
+	/** @cpu: the CPU owning this backlog */
+	unsigned int cpu;
 };
 
 /**
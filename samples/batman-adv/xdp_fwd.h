@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright (C) 2026  B.A.T.M.A.N. contributors:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SAMPLES_BATMAN_ADV_XDP_FWD_H_
+#define _SAMPLES_BATMAN_ADV_XDP_FWD_H_
+
+#include <linux/types.h>
+
+/*
+ * Map layout shared by xdp_fwd_kern.c and xdp_fwd_user.c:
+ *
+ *  nexthops: BPF_MAP_TYPE_HASH, struct xdp_fwd_orig -> struct xdp_fwd_nexthop
+ *	one entry per originator with a router, filled from the
+ *	BATADV_CMD_GET_NEXTHOPS dump and the BATADV_EVENT_ORIG_ROUTER and
+ *	BATADV_EVENT_ORIG_DEL events
+ *  hardifs: BPF_MAP_TYPE_HASH, __u32 ifindex -> struct xdp_fwd_hardif
+ *	one entry per active hard interface of the mesh interface, filled from
+ *	the BATADV_CMD_GET_HARDIFS dump
+ *  tx_ports: BPF_MAP_TYPE_DEVMAP_HASH, __u32 ifindex -> __u32 ifindex
+ *	redirect targets, same keys as hardifs
+ */
+
+#define XDP_FWD_MAX_ORIGS	4096
+#define XDP_FWD_MAX_HARDIFS	64
+
+/**
+ * struct xdp_fwd_orig - key of the nexthops map
+ * @addr: originator address, matched against batadv_unicast_packet::dest
+ */
+struct xdp_fwd_orig {
+	__u8 addr[6];
+};
+
+/**
+ * struct xdp_fwd_nexthop - value of the nexthops map
+ * @ifindex: outgoing hard interface (BATADV_ATTR_HARD_IFINDEX)
+ * @router: address of the next hop (BATADV_ATTR_ROUTER)
+ * @reserved: padding, always zero
+ */
+struct xdp_fwd_nexthop {
+	__u32 ifindex;
+	__u8 router[6];
+	__u16 reserved;
+};
+
+/**
+ * struct xdp_fwd_hardif - value of the hardifs map
+ * @addr: mac address of the hard interface (BATADV_ATTR_HARD_ADDRESS)
+ * @mtu: mtu of the hard interface
+ */
+struct xdp_fwd_hardif {
+	__u8 addr[6];
+	__u16 mtu;
+};
+
+#endif /* _SAMPLES_BATMAN_ADV_XDP_FWD_H_ */
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (C) 2026  B.A.T.M.A.N. contributors:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Reference XDP program forwarding transit batman-adv unicast packets on the
+ * hard interfaces of a mesh interface. The maps are kept in sync by
+ * xdp_fwd_user.c, see xdp_fwd.h for their layout.
+ *
+ * Only BATADV_UNICAST packets addressed to the receiving hard interface and
+ * destined to an originator with a known router are forwarded. Everything
+ * else, including all packets for this node, is passed on to batman-adv.
+ * Compared to batadv_route_unicast_packet() the forwarded packets skip:
+ *
+ *  - the rerouting of packets with an outdated ttvn, the next node which
+ *    still runs the packet through batman-adv reroutes them instead
+ *  - network coding and the per-incoming-interface router selection of
+ *    multi interface meshes, the router of BATADV_IF_DEFAULT is used
+ *  - the forward counters of "ethtool -S" on the mesh interface
+ *
+ * Build with:
+ *
+ *  clang -O2 -g -target bpf -I../../include/uapi -c xdp_fwd_kern.c \
+ *	-o xdp_fwd_kern.o
+ */
+
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/batadv_packet.h>
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_endian.h>
+
+#include "xdp_fwd.h"
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, XDP_FWD_MAX_ORIGS);
+	__type(key, struct xdp_fwd_orig);
+	__type(value, struct xdp_fwd_nexthop);
+} nexthops SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, XDP_FWD_MAX_HARDIFS);
+	__type(key, __u32);
+	__type(value, struct xdp_fwd_hardif);
+} hardifs SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_DEVMAP_HASH);
+	__uint(max_entries, XDP_FWD_MAX_HARDIFS);
+	__type(key, __u32);
+	__type(value, __u32);
+} tx_ports SEC(".maps");
+
+static __always_inline int xdp_fwd_addr_eq(const __u8 *a, const __u8 *b)
+{
+	return !((a[0] ^ b[0]) | (a[1] ^ b[1]) | (a[2] ^ b[2]) |
+		 (a[3] ^ b[3]) | (a[4] ^ b[4]) | (a[5] ^ b[5]));
+}
+
+SEC("xdp")
+int batadv_xdp_fwd(struct xdp_md *ctx)
+{
+	void *data_end = (void *)(long)ctx->data_end;
+	void *data = (void *)(long)ctx->data;
+	struct batadv_unicast_packet *unicast_packet;
+	__u32 ifindex = ctx->ingress_ifindex;
+	struct xdp_fwd_nexthop *nexthop;
+	struct xdp_fwd_hardif *hardif;
+	struct ethhdr *ethhdr = data;
+	struct xdp_fwd_orig orig;
+
+	unicast_packet = (struct batadv_unicast_packet *)(ethhdr + 1);
+	if ((void *)(unicast_packet + 1) > data_end)
+		return XDP_PASS;
+
+	if (ethhdr->h_proto != bpf_htons(ETH_P_BATMAN))
+		return XDP_PASS;
+
+	if (unicast_packet->packet_type != BATADV_UNICAST ||
+	    unicast_packet->version != BATADV_COMPAT_VERSION)
+		return XDP_PASS;
+
+	/* batman-adv drops and counts packets with an expired ttl */
+	if (unicast_packet->ttl < 2)
+		return XDP_PASS;
+
+	hardif = bpf_map_lookup_elem(&hardifs, &ifindex);
+	if (!hardif || !xdp_fwd_addr_eq(ethhdr->h_dest, hardif->addr))
+		return XDP_PASS;
+
+	__builtin_memcpy(orig.addr, unicast_packet->dest, ETH_ALEN);
+	nexthop = bpf_map_lookup_elem(&nexthops, &orig);
+	if (!nexthop)
+		return XDP_PASS;
+
+	ifindex = nexthop->ifindex;
+	hardif = bpf_map_lookup_elem(&hardifs, &ifindex);
+	if (!hardif)
+		return XDP_PASS;
+
+	/* leave the fragmentation to batman-adv */
+	if (data_end - (void *)unicast_packet > hardif->mtu)
+		return XDP_PASS;
+
+	unicast_packet->ttl--;
+	__builtin_memcpy(ethhdr->h_dest, nexthop->router, ETH_ALEN);
+	__builtin_memcpy(ethhdr->h_source, hardif->addr, ETH_ALEN);
+
+	return bpf_redirect_map(&tx_ports, ifindex, 0);
+}
+
+char _license[] SEC("license") = "GPL";
@@ -0,0 +1,368 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Copyright (C) 2026  B.A.T.M.A.N. contributors:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Loader for xdp_fwd_kern.o. It attaches the program to the active hard
+ * interfaces of a mesh interface and mirrors the router towards every
+ * originator into the nexthops map until SIGINT or SIGTERM is received:
+ *
+ *  1. subscribe to the "events" multicast group of the "batadv" family
+ *  2. dump BATADV_CMD_GET_HARDIFS into the hardifs and tx_ports maps
+ *  3. dump BATADV_CMD_GET_NEXTHOPS into the nexthops map
+ *  4. apply BATADV_EVENT_ORIG_ROUTER and BATADV_EVENT_ORIG_DEL events
+ *
+ * The subscription happens before the dump so that no change is lost in
+ * between. When the event socket overflows, the nexthops map is flushed and
+ * dumped again. Hard interfaces added to the mesh interface later are not
+ * picked up, the loader has to be restarted for them.
+ *
+ * Build with:
+ *
+ *  cc -O2 -I../../include/uapi $(pkg-config --cflags libnl-genl-3.0) \
+ *	xdp_fwd_user.c -o xdp_fwd_user \
+ *	$(pkg-config --libs libnl-genl-3.0 libbpf)
+ *
+ * Usage: xdp_fwd_user <mesh interface> [xdp_fwd_kern.o]
+ */
+
+#include <errno.h>
+#include <linux/batman_adv.h>
+#include <linux/if_ether.h>
+#include <linux/if_link.h>
+#include <net/if.h>
+#include <netlink/genl/ctrl.h>
+#include <netlink/genl/genl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+
+#include "xdp_fwd.h"
+
+#define XDP_FWD_ATTACH_FLAGS	XDP_FLAGS_UPDATE_IF_NOEXIST
+
+static volatile sig_atomic_t xdp_fwd_stop;
+static unsigned int mesh_ifindex;
+static int batadv_family;
+
+static int nexthops_fd;
+static int hardifs_fd;
+static int tx_ports_fd;
+
+static __u32 attached[XDP_FWD_MAX_HARDIFS];
+static unsigned int attached_num;
+
+static void xdp_fwd_signal(int sig)
+{
+	xdp_fwd_stop = 1;
+}
+
+static int xdp_fwd_parse(struct nl_msg *msg, struct nlattr **attrs)
+{
+	struct genlmsghdr *ghdr = nlmsg_data(nlmsg_hdr(msg));
+
+	return nla_parse(attrs, BATADV_ATTR_MAX, genlmsg_attrdata(ghdr, 0),
+			 genlmsg_attrlen(ghdr, 0), NULL);
+}
+
+static int xdp_fwd_has_addr(struct nlattr **attrs, int type)
+{
+	return attrs[type] && nla_len(attrs[type]) == ETH_ALEN;
+}
+
+static int xdp_fwd_get_mtu(__u32 ifindex, __u16 *mtu)
+{
+	struct ifreq ifr = {};
+	int sock;
+	int ret;
+
+	if (!if_indextoname(ifindex, ifr.ifr_name))
+		return -errno;
+
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sock < 0)
+		return -errno;
+
+	ret = ioctl(sock, SIOCGIFMTU, &ifr);
+	if (ret < 0)
+		ret = -errno;
+	else
+		*mtu = ifr.ifr_mtu;
+
+	close(sock);
+	return ret;
+}
+
+static int xdp_fwd_hardif_cb(struct nl_msg *msg, void *arg)
+{
+	struct nlattr *attrs[BATADV_ATTR_MAX + 1];
+	struct xdp_fwd_hardif hardif = {};
+	__u32 ifindex;
+
+	if (xdp_fwd_parse(msg, attrs) < 0)
+		return NL_SKIP;
+
+	if (!attrs[BATADV_ATTR_HARD_IFINDEX] ||
+	    !xdp_fwd_has_addr(attrs, BATADV_ATTR_HARD_ADDRESS) ||
+	    !attrs[BATADV_ATTR_ACTIVE])
+		return NL_SKIP;
+
+	if (attached_num == XDP_FWD_MAX_HARDIFS)
+		return NL_SKIP;
+
+	ifindex = nla_get_u32(attrs[BATADV_ATTR_HARD_IFINDEX]);
+	memcpy(hardif.addr, nla_data(attrs[BATADV_ATTR_HARD_ADDRESS]),
+	       ETH_ALEN);
+	if (xdp_fwd_get_mtu(ifindex, &hardif.mtu) < 0)
+		return NL_SKIP;
+
+	if (bpf_map_update_elem(hardifs_fd, &ifindex, &hardif, BPF_ANY) ||
+	    bpf_map_update_elem(tx_ports_fd, &ifindex, &ifindex, BPF_ANY))
+		return NL_SKIP;
+
+	attached[attached_num++] = ifindex;
+	return NL_OK;
+}
+
+static void xdp_fwd_nexthop_update(struct nlattr **attrs)
+{
+	struct xdp_fwd_nexthop nexthop = {};
+	struct xdp_fwd_orig orig;
+
+	memcpy(orig.addr, nla_data(attrs[BATADV_ATTR_ORIG_ADDRESS]), ETH_ALEN);
+
+	/* no router left, packets towards the originator go to batman-adv */
+	if (!xdp_fwd_has_addr(attrs, BATADV_ATTR_ROUTER) ||
+	    !attrs[BATADV_ATTR_HARD_IFINDEX]) {
+		bpf_map_delete_elem(nexthops_fd, &orig);
+		return;
+	}
+
+	nexthop.ifindex = nla_get_u32(attrs[BATADV_ATTR_HARD_IFINDEX]);
+	memcpy(nexthop.router, nla_data(attrs[BATADV_ATTR_ROUTER]), ETH_ALEN);
+	bpf_map_update_elem(nexthops_fd, &orig, &nexthop, BPF_ANY);
+}
+
+static int xdp_fwd_nexthop_cb(struct nl_msg *msg, void *arg)
+{
+	struct nlattr *attrs[BATADV_ATTR_MAX + 1];
+
+	if (xdp_fwd_parse(msg, attrs) < 0 ||
+	    !xdp_fwd_has_addr(attrs, BATADV_ATTR_ORIG_ADDRESS))
+		return NL_SKIP;
+
+	xdp_fwd_nexthop_update(attrs);
+	return NL_OK;
+}
+
+static int xdp_fwd_event_cb(struct nl_msg *msg, void *arg)
+{
+	struct genlmsghdr *ghdr = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *attrs[BATADV_ATTR_MAX + 1];
+	struct xdp_fwd_orig orig;
+
+	if (ghdr->cmd != BATADV_CMD_EVENT || xdp_fwd_parse(msg, attrs) < 0)
+		return NL_SKIP;
+
+	if (!attrs[BATADV_ATTR_EVENT] || !attrs[BATADV_ATTR_MESH_IFINDEX] ||
+	    nla_get_u32(attrs[BATADV_ATTR_MESH_IFINDEX]) != mesh_ifindex ||
+	    !xdp_fwd_has_addr(attrs, BATADV_ATTR_ORIG_ADDRESS))
+		return NL_SKIP;
+
+	switch (nla_get_u8(attrs[BATADV_ATTR_EVENT])) {
+	case BATADV_EVENT_ORIG_ROUTER:
+		xdp_fwd_nexthop_update(attrs);
+		break;
+	case BATADV_EVENT_ORIG_DEL:
+		memcpy(orig.addr, nla_data(attrs[BATADV_ATTR_ORIG_ADDRESS]),
+		       ETH_ALEN);
+		bpf_map_delete_elem(nexthops_fd, &orig);
+		break;
+	}
+
+	return NL_OK;
+}
+
+static int xdp_fwd_dump(struct nl_sock *sock, __u8 cmd,
+			nl_recvmsg_msg_cb_t cb)
+{
+	struct nl_msg *msg;
+	int ret;
+
+	do {
+		msg = nlmsg_alloc();
+		if (!msg)
+			return -NLE_NOMEM;
+
+		if (!genlmsg_put(msg, NL_AUTO_PORT, NL_AUTO_SEQ, batadv_family,
+				 0, NLM_F_DUMP, cmd, 1) ||
+		    nla_put_u32(msg, BATADV_ATTR_MESH_IFINDEX, mesh_ifindex)) {
+			nlmsg_free(msg);
+			return -NLE_NOMEM;
+		}
+
+		nl_socket_modify_cb(sock, NL_CB_VALID, NL_CB_CUSTOM, cb, NULL);
+		ret = nl_send_auto(sock, msg);
+		nlmsg_free(msg);
+		if (ret < 0)
+			return ret;
+
+		ret = nl_recvmsgs_default(sock);
+	} while (ret == -NLE_DUMP_INTR);
+
+	return ret;
+}
+
+static int xdp_fwd_resync(struct nl_sock *sock)
+{
+	struct xdp_fwd_orig key;
+
+	while (bpf_map_get_next_key(nexthops_fd, NULL, &key) == 0)
+		bpf_map_delete_elem(nexthops_fd, &key);
+
+	return xdp_fwd_dump(sock, BATADV_CMD_GET_NEXTHOPS, xdp_fwd_nexthop_cb);
+}
+
+static void xdp_fwd_detach(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < attached_num; i++)
+		bpf_xdp_detach(attached[i], XDP_FWD_ATTACH_FLAGS, NULL);
+}
+
+int main(int argc, char **argv)
+{
+	const char *obj_path = "xdp_fwd_kern.o";
+	struct nl_sock *evsock = NULL;
+	struct nl_sock *sock = NULL;
+	struct bpf_object *obj;
+	struct bpf_program *prog;
+	struct pollfd pfd;
+	unsigned int i;
+	int ret = 1;
+	int prog_fd;
+	int group;
+
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr, "Usage: %s <mesh interface> [xdp_fwd_kern.o]\n",
+			argv[0]);
+		return 1;
+	}
+
+	if (argc == 3)
+		obj_path = argv[2];
+
+	mesh_ifindex = if_nametoindex(argv[1]);
+	if (!mesh_ifindex) {
+		fprintf(stderr, "Unknown interface %s\n", argv[1]);
+		return 1;
+	}
+
+	obj = bpf_object__open_file(obj_path, NULL);
+	if (libbpf_get_error(obj)) {
+		fprintf(stderr, "Failed to open %s\n", obj_path);
+		return 1;
+	}
+
+	if (bpf_object__load(obj)) {
+		fprintf(stderr, "Failed to load %s\n", obj_path);
+		goto out;
+	}
+
+	prog = bpf_object__find_program_by_name(obj, "batadv_xdp_fwd");
+	nexthops_fd = bpf_object__find_map_fd_by_name(obj, "nexthops");
+	hardifs_fd = bpf_object__find_map_fd_by_name(obj, "hardifs");
+	tx_ports_fd = bpf_object__find_map_fd_by_name(obj, "tx_ports");
+	if (!prog || nexthops_fd < 0 || hardifs_fd < 0 || tx_ports_fd < 0) {
+		fprintf(stderr, "%s is not the batman-adv XDP program\n",
+			obj_path);
+		goto out;
+	}
+	prog_fd = bpf_program__fd(prog);
+
+	sock = nl_socket_alloc();
+	evsock = nl_socket_alloc();
+	if (!sock || !evsock || genl_connect(sock) || genl_connect(evsock))
+		goto out;
+
+	batadv_family = genl_ctrl_resolve(sock, BATADV_NL_NAME);
+	group = genl_ctrl_resolve_grp(sock, BATADV_NL_NAME,
+				      BATADV_NL_MCAST_GROUP_EVENTS);
+	if (batadv_family < 0 || group < 0) {
+		fprintf(stderr, "batman-adv netlink family not available\n");
+		goto out;
+	}
+
+	nl_socket_disable_seq_check(evsock);
+	nl_socket_modify_cb(evsock, NL_CB_VALID, NL_CB_CUSTOM,
+			    xdp_fwd_event_cb, NULL);
+	if (nl_socket_add_membership(evsock, group))
+		goto out;
+
+	if (xdp_fwd_dump(sock, BATADV_CMD_GET_HARDIFS, xdp_fwd_hardif_cb) < 0) {
+		fprintf(stderr, "Failed to query the hard interfaces\n");
+		goto out;
+	}
+
+	signal(SIGINT, xdp_fwd_signal);
+	signal(SIGTERM, xdp_fwd_signal);
+
+	for (i = 0; i < attached_num; i++) {
+		if (bpf_xdp_attach(attached[i], prog_fd, XDP_FWD_ATTACH_FLAGS,
+				   NULL)) {
+			fprintf(stderr, "Failed to attach to ifindex %u\n",
+				attached[i]);
+			attached_num = i;
+			goto out;
+		}
+	}
+
+	if (xdp_fwd_resync(sock) < 0) {
+		fprintf(stderr, "Failed to query the next hops\n");
+		goto out;
+	}
+
+	pfd.fd = nl_socket_get_fd(evsock);
+	pfd.events = POLLIN;
+
+	while (!xdp_fwd_stop) {
+		if (poll(&pfd, 1, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			goto out;
+		}
+
+		/* ENOBUFS, events were lost */
+		if (nl_recvmsgs_default(evsock) == -NLE_NOMEM &&
+		    xdp_fwd_resync(sock) < 0)
+			goto out;
+	}
+
+	ret = 0;
+out:
+	xdp_fwd_detach();
+	nl_socket_free(evsock);
+	nl_socket_free(sock);
+	bpf_object__close(obj);
+	return ret;
+}